@@ -0,0 +1,94 @@
+/**
+ * @file benchmarks/bench_audio_features.cpp
+ * @brief Feature extraction speed, as a multiple of real time
+ *
+ * Extracts MFCC and spectral features from synthetic stereo audio at
+ * 48 kHz (the ingest pipeline's default rate) in network-sized blocks,
+ * once on one thread and once on every core with an independent
+ * extractor per thread (as the ingest pipeline and extractFeatureFiles()
+ * do), on every instruction set the CPU supports.
+ *
+ * Usage: bench_audio_features [seconds] [threads]
+ */
+
+#include "audio_features.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    constexpr uint32_t RATE = 48000;
+
+    /**
+     * @brief Extracts features on a number of threads and returns the aggregate real-time factor
+     */
+    double run(const std::vector<float>& input, unsigned threads)
+    {
+        constexpr size_t BLOCK_FRAMES = 4096;
+        const size_t frames = input.size() / 2;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&]() {
+                FeatureExtractor extractor(2, RATE);
+                for (size_t offset = 0; offset < frames; offset += BLOCK_FRAMES)
+                {
+                    extractor.push(input.data() + offset * 2, std::min(BLOCK_FRAMES, frames - offset));
+                }
+                extractor.finish();
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(frames) / RATE * threads / seconds;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 60.0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1)
+    {
+        seconds = std::max(1, std::atoi(argv[1]));
+    }
+    if (argc > 2)
+    {
+        threads = static_cast<unsigned>(std::max(1, std::atoi(argv[2])));
+    }
+
+    std::vector<float> input(static_cast<size_t>(seconds * RATE) * 2);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        input[i] = static_cast<float>(0.5 * std::sin(0.001 * static_cast<double>(i * i % 100003)));
+    }
+
+    std::printf("%.0f s of 48 kHz stereo per run, %u threads\n", seconds, threads);
+    std::printf("%-8s %10s %10s\n", "level", "1 thread", "all");
+
+    const SimdLevel original = activeSimdLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (!setSimdLevel(level))
+        {
+            continue;
+        }
+        std::printf("%-8s %9.0fx %9.0fx\n", simdLevelName(level), run(input, 1), run(input, threads));
+    }
+    setSimdLevel(original);
+    return 0;
+}
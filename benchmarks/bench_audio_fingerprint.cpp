@@ -0,0 +1,137 @@
+/**
+ * @file benchmarks/bench_audio_fingerprint.cpp
+ * @brief Fingerprinting speed, lookup latency and duplicate detection rate
+ *
+ * Fingerprints synthetic tunes at 48 kHz stereo (the ingest pipeline's
+ * default format), indexes them, then looks up quieter mono copies of
+ * some of them at 44.1 kHz and tunes that were never indexed. Reports how
+ * many copies were recognised and how many new tunes were mistaken for
+ * duplicates, and times saving and mapping the index.
+ *
+ * Usage: bench_audio_fingerprint [sounds] [seconds]
+ */
+
+#include "audio_fingerprint.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    /**
+     * @brief Renders a random tune of overlapping notes; the same seed gives the same tune at any rate
+     */
+    std::vector<float> renderTune(unsigned seed, double seconds, uint32_t rate, unsigned channels, float gain)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> pitch(36.0, 100.0);
+        std::uniform_real_distribution<double> length(0.1, 0.5);
+        const size_t frames = static_cast<size_t>(seconds * rate);
+        std::vector<float> samples(frames * channels, 0.0f);
+        for (double start = 0.0; start < seconds; start += 0.12)
+        {
+            const double frequency = 440.0 * std::pow(2.0, (pitch(generator) - 69.0) / 12.0);
+            const double end = start + length(generator);
+            for (size_t i = static_cast<size_t>(start * rate); i < frames && i < end * rate; ++i)
+            {
+                const float value = gain * static_cast<float>(
+                    0.15 * std::sin(2.0 * PI * frequency * (static_cast<double>(i) / rate - start)));
+                for (unsigned c = 0; c < channels; ++c)
+                {
+                    samples[i * channels + c] += value;
+                }
+            }
+        }
+        return samples;
+    }
+
+    Fingerprint fingerprint(const std::vector<float>& samples, unsigned channels, uint32_t rate)
+    {
+        constexpr size_t BLOCK_FRAMES = 4096;
+        Fingerprinter fingerprinter(static_cast<uint16_t>(channels), rate);
+        const size_t frames = samples.size() / channels;
+        for (size_t offset = 0; offset < frames; offset += BLOCK_FRAMES)
+        {
+            fingerprinter.push(samples.data() + offset * channels, std::min(BLOCK_FRAMES, frames - offset));
+        }
+        return fingerprinter.finish();
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = 200;
+    double seconds = 30.0;
+    if (argc > 1)
+    {
+        count = static_cast<size_t>(std::max(1, std::atoi(argv[1])));
+    }
+    if (argc > 2)
+    {
+        seconds = std::max(1.0, std::atof(argv[2]));
+    }
+
+    FingerprintIndex index;
+    double fingerprint_seconds = 0.0;
+    size_t hashes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto samples = renderTune(static_cast<unsigned>(i), seconds, 48000, 2, 1.0f);
+        const auto start = std::chrono::steady_clock::now();
+        const auto print = fingerprint(samples, 2, 48000);
+        fingerprint_seconds += secondsSince(start);
+        hashes += print.hashes.size();
+        index.insert(static_cast<int>(i), print);
+    }
+    std::printf("%zu sounds of %.0f s: fingerprinted at %.0fx real time, %.1f hashes per second of audio\n", count,
+                seconds, count * seconds / fingerprint_seconds, hashes / (count * seconds));
+
+    const size_t probes = std::min<size_t>(count, 50);
+    size_t recognised = 0;
+    size_t mistaken = 0;
+    double lookup_seconds = 0.0;
+    for (size_t i = 0; i < probes; ++i)
+    {
+        const auto copy = fingerprint(renderTune(static_cast<unsigned>(i * count / probes), seconds, 44100, 1, 0.4f),
+                                      1, 44100);
+        const auto fresh = fingerprint(renderTune(static_cast<unsigned>(count + i), seconds, 44100, 1, 1.0f), 1, 44100);
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto found = index.findDuplicate(copy);
+        const auto wrong = index.findDuplicate(fresh);
+        lookup_seconds += secondsSince(start);
+        recognised += found && found->sound_id == static_cast<int>(i * count / probes) ? 1 : 0;
+        mistaken += wrong ? 1 : 0;
+    }
+    std::printf("lookups: %.0f us each; %zu/%zu copies recognised, %zu/%zu new sounds taken for duplicates\n",
+                lookup_seconds * 1e6 / (2 * probes), recognised, probes, mistaken, probes);
+
+    const auto path = (std::filesystem::temp_directory_path() / "bench_audio_fingerprint.fpi").string();
+    auto start = std::chrono::steady_clock::now();
+    if (index.save(path))
+    {
+        const double save_seconds = secondsSince(start);
+        FingerprintIndex reopened;
+        start = std::chrono::steady_clock::now();
+        const bool opened = reopened.open(path);
+        std::printf("save(): %.1f ms, open(): %s in %.1f ms (%.1f MiB file)\n", save_seconds * 1e3,
+                    opened ? "mapped" : "failed", secondsSince(start) * 1e3,
+                    std::filesystem::file_size(path) / 1048576.0);
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file benchmarks/bench_audio_kernels.cpp
+ * @brief Throughput of the sample kernels on every instruction set the CPU supports
+ *
+ * Each kernel runs over the same buffer of synthetic samples, a buffer
+ * large enough to leave the caches, and the rate is printed in millions
+ * of samples per second next to the scalar baseline.
+ *
+ * Usage: bench_audio_kernels [samples_mi] [repetitions]
+ */
+
+#include "audio_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    /**
+     * @brief Runs a kernel several times and returns millions of samples per second
+     */
+    double measure(size_t samples, int repetitions, const std::function<void()>& kernel)
+    {
+        kernel();  // warm-up, also faults the pages in
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            kernel();
+        }
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(samples) * repetitions / seconds / 1e6;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t samples = 16u << 20;
+    int repetitions = 10;
+    if (argc > 1)
+    {
+        samples = static_cast<size_t>(std::max(1, std::atoi(argv[1]))) << 20;
+    }
+    if (argc > 2)
+    {
+        repetitions = std::max(1, std::atoi(argv[2]));
+    }
+
+    std::vector<uint8_t> pcm(samples * 3);
+    for (size_t i = 0; i < pcm.size(); ++i)
+    {
+        pcm[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    std::vector<float> floats(samples);
+    pcmToFloat(pcm.data(), PcmEncoding::Int16, samples, floats.data());
+    std::vector<float> scratch(samples);
+    volatile float sink = 0.0f;
+
+    std::printf("%zu Mi samples x %d repetitions, automatic choice: %s\n",
+        samples >> 20, repetitions, simdLevelName(activeSimdLevel()));
+    std::printf("%-8s %12s %12s %12s %12s %12s %12s %12s\n",
+        "level", "int16>f32", "int24>f32", "int32>f32", "levels", "range", "gain", "2ch>1ch");
+
+    const SimdLevel original = activeSimdLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (!setSimdLevel(level))
+        {
+            continue;
+        }
+
+        const double int16 = measure(samples, repetitions, [&]() {
+            pcmToFloat(pcm.data(), PcmEncoding::Int16, samples, scratch.data());
+        });
+        const double int24 = measure(samples, repetitions, [&]() {
+            pcmToFloat(pcm.data(), PcmEncoding::Int24, samples, scratch.data());
+        });
+        const double int32 = measure(samples * 3 / 4, repetitions, [&]() {
+            pcmToFloat(pcm.data(), PcmEncoding::Int32, samples * 3 / 4, scratch.data());
+        });
+        const double levels = measure(samples, repetitions, [&]() {
+            sink = sink + measureLevels(floats.data(), samples).rms;
+        });
+        const double range = measure(samples, repetitions, [&]() {
+            sink = sink + measureRange(floats.data(), samples).max;
+        });
+        const double gain = measure(samples, repetitions, [&]() {
+            applyGain(scratch.data(), samples, 0.999f);
+        });
+        const double downmix = measure(samples, repetitions, [&]() {
+            scratch.assign(floats.begin(), floats.end());
+            remapChannels(scratch, 2, 1);
+        });
+
+        std::printf("%-8s %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f\n",
+            simdLevelName(level), int16, int24, int32, levels, range, gain, downmix);
+    }
+    setSimdLevel(original);
+    std::printf("(millions of samples per second)\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file benchmarks/bench_disk_writer.cpp
+ * @brief Disk throughput of many concurrent simulated downloads
+ *
+ * Each simulated download is a thread that receives its file in
+ * network-sized chunks and writes it to its own file. The same workload is
+ * run through std::ofstream, the pwrite DiskWriter backend and the io_uring
+ * backend (buffered and O_DIRECT), and the aggregate throughput is printed.
+ *
+ * Usage: bench_disk_writer [directory] [downloads] [file_mib] [chunk_kib]
+ */
+
+#include "atomic_file.h"
+#include "disk_writer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace FreesoundDownloader;
+
+namespace
+{
+    struct Workload
+    {
+        fs::path directory;
+        int downloads = 64;
+        size_t file_size = 8u << 20;
+        size_t chunk_size = 16u << 10;
+    };
+
+    /// Writes one file from network-sized chunks; returns false on failure
+    using FileWriter = std::function<bool(const fs::path&, const std::string& chunk, size_t file_size)>;
+
+    /**
+     * @brief Runs every simulated download concurrently and returns MiB/s
+     */
+    double run(const Workload& workload, const FileWriter& write_file)
+    {
+        fs::remove_all(workload.directory);
+        fs::create_directories(workload.directory);
+
+        std::string chunk(workload.chunk_size, '\0');
+        for (size_t i = 0; i < chunk.size(); ++i)
+        {
+            chunk[i] = static_cast<char>(i * 131 + 7);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        std::vector<int> results(workload.downloads, 0);
+        for (int i = 0; i < workload.downloads; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                const fs::path path = workload.directory / (std::to_string(i) + ".wav");
+                results[i] = write_file(path, chunk, workload.file_size) ? 1 : 0;
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        for (int result : results)
+        {
+            if (!result)
+            {
+                std::fprintf(stderr, "a simulated download failed\n");
+                break;
+            }
+        }
+
+        fs::remove_all(workload.directory);
+        const double mebibytes = static_cast<double>(workload.file_size) * workload.downloads / (1 << 20);
+        return mebibytes / seconds;
+    }
+
+    bool writeWithOfstream(const fs::path& path, const std::string& chunk, size_t file_size)
+    {
+        std::ofstream out(path, std::ios::binary);
+        for (size_t written = 0; written < file_size; written += chunk.size())
+        {
+            out.write(chunk.data(), static_cast<std::streamsize>(std::min(chunk.size(), file_size - written)));
+        }
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    FileWriter diskWriterBackend(std::shared_ptr<DiskWriter> writer)
+    {
+        return [writer](const fs::path& path, const std::string& chunk, size_t file_size) {
+            AtomicFile file;
+            if (!file.open(path.string()))
+            {
+                return false;
+            }
+
+            DiskWriter::File out(*writer, file.descriptor());
+            for (size_t written = 0; written < file_size; written += chunk.size())
+            {
+                if (!out.append(chunk.data(), std::min(chunk.size(), file_size - written)))
+                {
+                    return false;
+                }
+            }
+            return out.finish() && file.commit(false);
+        };
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Workload workload;
+    workload.directory = argc > 1 ? fs::path(argv[1]) : fs::current_path() / "bench_disk_writer.tmp";
+    if (argc > 2)
+    {
+        workload.downloads = std::max(1, std::atoi(argv[2]));
+    }
+    if (argc > 3)
+    {
+        workload.file_size = static_cast<size_t>(std::max(1, std::atoi(argv[3]))) << 20;
+    }
+    if (argc > 4)
+    {
+        workload.chunk_size = static_cast<size_t>(std::max(1, std::atoi(argv[4]))) << 10;
+    }
+
+    std::printf("%d downloads x %zu MiB in %zu KiB chunks -> %s\n",
+        workload.downloads, workload.file_size >> 20, workload.chunk_size >> 10,
+        workload.directory.string().c_str());
+
+    std::printf("%-22s %10.1f MiB/s\n", "ofstream", run(workload, writeWithOfstream));
+
+    DiskWriterOptions options;
+    options.backend = DiskWriterBackend::Pwrite;
+    std::printf("%-22s %10.1f MiB/s\n", "pwrite",
+        run(workload, diskWriterBackend(makeDiskWriter(options))));
+
+    options.backend = DiskWriterBackend::IoUring;
+    auto uring = makeDiskWriter(options);
+    const std::string label = uring->name();
+    std::printf("%-22s %10.1f MiB/s\n", label.c_str(), run(workload, diskWriterBackend(uring)));
+
+    options.direct_io = true;
+    uring = makeDiskWriter(options);
+    std::printf("%-22s %10.1f MiB/s\n", (label + " + O_DIRECT").c_str(),
+        run(workload, diskWriterBackend(uring)));
+    return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file benchmarks/bench_lossless_codec.cpp
+ * @brief Compression ratio and speed of the lossless PCM codec
+ *
+ * Codes a synthetic 44.1 kHz stereo recording (a random melody over a
+ * drone, with a little noise) as 16- and 24-bit WAV. Reports the size
+ * against the WAV, compression speed on every instruction set the CPU
+ * supports, and decompression speed on one thread and on all of them,
+ * in megabytes of WAV per second.
+ *
+ * Usage: bench_lossless_codec [seconds] [repetitions]
+ */
+
+#include "audio_kernels.h"
+#include "lossless_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    void putLe(std::vector<uint8_t>& out, uint32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    /**
+     * @brief Renders a stereo WAV of the given width
+     */
+    std::vector<uint8_t> renderWav(double seconds, unsigned bits)
+    {
+        constexpr uint32_t RATE = 44100;
+        const unsigned bytes = bits / 8;
+        const auto frames = static_cast<size_t>(seconds * RATE);
+        std::vector<uint8_t> out;
+        out.reserve(44 + frames * 2 * bytes);
+        out.insert(out.end(), {'R', 'I', 'F', 'F'});
+        putLe(out, static_cast<uint32_t>(36 + frames * 2 * bytes), 4);
+        out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        putLe(out, 16, 4);
+        putLe(out, 1, 2);
+        putLe(out, 2, 2);
+        putLe(out, RATE, 4);
+        putLe(out, RATE * 2 * bytes, 4);
+        putLe(out, 2 * bytes, 2);
+        putLe(out, bits, 2);
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        putLe(out, static_cast<uint32_t>(frames * 2 * bytes), 4);
+
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<double> pitch(55.0, 84.0);
+        std::normal_distribution<double> noise(0.0, 1e-4);
+        const double peak = std::ldexp(1.0, static_cast<int>(bits) - 1) - 1.0;
+        double frequency = 440.0;
+        for (size_t i = 0; i < frames; ++i)
+        {
+            if (i % (RATE / 4) == 0)
+            {
+                frequency = 440.0 * std::pow(2.0, (pitch(generator) - 69.0) / 12.0);
+            }
+            const double t = static_cast<double>(i) / RATE;
+            const double envelope = std::exp(-8.0 * static_cast<double>(i % (RATE / 4)) / RATE);
+            const double melody = 0.4 * envelope * std::sin(2.0 * PI * frequency * t);
+            const double drone = 0.2 * std::sin(2.0 * PI * 110.0 * t) + 0.05 * std::sin(2.0 * PI * 165.0 * t);
+            putLe(out, static_cast<uint32_t>(std::lround(peak * (melody + drone + noise(generator)))), bytes);
+            putLe(out, static_cast<uint32_t>(std::lround(peak * (0.7 * melody + drone + noise(generator)))), bytes);
+        }
+        return out;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 60.0;
+    int repetitions = 3;
+    if (argc > 1)
+    {
+        seconds = std::max(1.0, std::atof(argv[1]));
+    }
+    if (argc > 2)
+    {
+        repetitions = std::max(1, std::atoi(argv[2]));
+    }
+
+    const SimdLevel original = activeSimdLevel();
+    for (unsigned bits : {16u, 24u})
+    {
+        const auto wav = renderWav(seconds, bits);
+        const double megabytes = wav.size() / 1e6;
+        std::printf("%.0f s of %u-bit stereo (%.1f MB)\n", seconds, bits, megabytes);
+
+        std::vector<uint8_t> packed;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+        {
+            if (!setSimdLevel(level))
+            {
+                continue;
+            }
+            LosslessOptions options;
+            options.threads = 1;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repetitions; ++i)
+            {
+                packed = compressPcmFile(wav.data(), wav.size(), options).value_or(std::vector<uint8_t>());
+            }
+            std::printf("  compress, 1 thread, %-6s %8.1f MB/s\n", simdLevelName(level),
+                        megabytes * repetitions / secondsSince(start));
+        }
+        setSimdLevel(original);
+        if (packed.empty())
+        {
+            std::printf("  did not compress\n");
+            continue;
+        }
+        std::printf("  %.1f%% of the WAV\n", 100.0 * packed.size() / wav.size());
+
+        for (unsigned threads : {1u, 0u})
+        {
+            bool exact = true;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repetitions; ++i)
+            {
+                const auto unpacked = decompressPcmFile(packed.data(), packed.size(), threads);
+                exact = exact && unpacked && *unpacked == wav;
+            }
+            std::printf("  decompress, %s %8.1f MB/s%s\n", threads ? "1 thread,     " : "all threads,  ",
+                        megabytes * repetitions / secondsSince(start), exact ? "" : " (MISMATCH)");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file benchmarks/bench_resampler.cpp
+ * @brief Rate-conversion speed of each quality preset, as a multiple of real time
+ *
+ * Converts synthetic stereo audio between the rate pairs seen most often
+ * on Freesound, in network-sized blocks, once on one thread and once on
+ * every core with an independent resampler per thread (as the ingest
+ * pipeline does), and prints how many times faster than real time the
+ * conversion runs.
+ *
+ * Usage: bench_resampler [seconds] [threads]
+ */
+
+#include "audio_kernels.h"
+#include "resampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    struct Conversion
+    {
+        uint32_t from;
+        uint32_t to;
+    };
+
+    /**
+     * @brief Converts the input on a number of threads and returns the aggregate real-time factor
+     */
+    double run(const std::vector<float>& input, const Conversion& conversion, ResamplerQuality quality, unsigned threads)
+    {
+        constexpr size_t BLOCK_FRAMES = 4096;
+        const size_t frames = input.size() / 2;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&]() {
+                Resampler resampler(2, conversion.from, conversion.to, quality);
+                std::vector<float> output;
+                output.reserve(BLOCK_FRAMES * 2 * (conversion.to / conversion.from + 2));
+                for (size_t offset = 0; offset < frames; offset += BLOCK_FRAMES)
+                {
+                    output.clear();
+                    resampler.process(input.data() + offset * 2, std::min(BLOCK_FRAMES, frames - offset), output);
+                }
+                output.clear();
+                resampler.flush(output);
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(frames) / conversion.from * threads / seconds;
+    }
+
+    const char* qualityName(ResamplerQuality quality)
+    {
+        switch (quality)
+        {
+        case ResamplerQuality::Fast:
+            return "fast";
+        case ResamplerQuality::Balanced:
+            return "balanced";
+        case ResamplerQuality::Best:
+            return "best";
+        }
+        return "?";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 30.0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1)
+    {
+        seconds = std::max(1, std::atoi(argv[1]));
+    }
+    if (argc > 2)
+    {
+        threads = static_cast<unsigned>(std::max(1, std::atoi(argv[2])));
+    }
+
+    const Conversion conversions[] = {{44100, 48000}, {48000, 44100}, {96000, 48000}, {22050, 48000}, {192000, 44100}};
+
+    std::printf("%.0f s of stereo per run, %u threads, kernels: %s\n",
+        seconds, threads, simdLevelName(activeSimdLevel()));
+    std::printf("%-16s %-9s %10s %10s %8s\n", "conversion", "quality", "1 thread", "all", "bank");
+
+    for (const Conversion& conversion : conversions)
+    {
+        std::vector<float> input(static_cast<size_t>(seconds * conversion.from) * 2);
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            input[i] = static_cast<float>(0.5 * std::sin(0.001 * static_cast<double>(i * i % 100003)));
+        }
+
+        for (ResamplerQuality quality : {ResamplerQuality::Fast, ResamplerQuality::Balanced, ResamplerQuality::Best})
+        {
+            char label[32];
+            std::snprintf(label, sizeof(label), "%u>%u", conversion.from, conversion.to);
+            const bool bank = Resampler(2, conversion.from, conversion.to, quality).polyphase();
+            std::printf("%-16s %-9s %9.0fx %9.0fx %8s\n", label, qualityName(quality),
+                run(input, conversion, quality, 1), run(input, conversion, quality, threads), bank ? "yes" : "no");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file benchmarks/bench_similarity_index.cpp
+ * @brief Build rate, query latency and recall of the similarity index
+ *
+ * Indexes clustered synthetic vectors the size of feature embeddings, then
+ * answers 10-nearest-neighbour queries on every instruction set the CPU
+ * supports, and compares the results with an exact scan. It also saves the
+ * index and times how long open() takes to map it again.
+ *
+ * Usage: bench_similarity_index [vectors] [queries]
+ */
+
+#include "audio_kernels.h"
+#include "similarity_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace FreesoundDownloader;
+
+namespace
+{
+    constexpr size_t DIMENSIONS = 30;
+    constexpr size_t RESULTS = 10;
+
+    std::vector<float> makeVectors(size_t count, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::normal_distribution<float> spread(0.0f, 1.0f);
+        std::uniform_real_distribution<float> place(-10.0f, 10.0f);
+        std::vector<float> centres(1000 * DIMENSIONS);
+        for (float& value : centres)
+        {
+            value = place(generator);
+        }
+        std::vector<float> vectors(count * DIMENSIONS);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t centre = generator() % 1000;
+            for (size_t d = 0; d < DIMENSIONS; ++d)
+            {
+                vectors[i * DIMENSIONS + d] = centres[centre * DIMENSIONS + d] + spread(generator);
+            }
+        }
+        return vectors;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = 100000;
+    size_t query_count = 1000;
+    if (argc > 1)
+    {
+        count = static_cast<size_t>(std::max(1, std::atoi(argv[1])));
+    }
+    if (argc > 2)
+    {
+        query_count = static_cast<size_t>(std::max(1, std::atoi(argv[2])));
+    }
+
+    const auto vectors = makeVectors(count, 1);
+    const auto queries = makeVectors(query_count, 2);
+
+    SimilarityIndex index;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+        index.insert(static_cast<int>(i), vectors.data() + i * DIMENSIONS);
+    }
+    const double build_seconds = secondsSince(start);
+    std::printf("%zu vectors of %zu dimensions: built in %.2f s (%.0f inserts/s, %s)\n", count, DIMENSIONS,
+                build_seconds, count / build_seconds, simdLevelName(activeSimdLevel()));
+
+    // Exact answers for the recall measurement
+    std::vector<std::vector<int>> exact(query_count);
+    start = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < query_count; ++q)
+    {
+        std::vector<std::pair<float, int>> distances(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            distances[i] = {squaredDistance(queries.data() + q * DIMENSIONS, vectors.data() + i * DIMENSIONS,
+                                            DIMENSIONS), static_cast<int>(i)};
+        }
+        std::partial_sort(distances.begin(), distances.begin() + RESULTS, distances.end());
+        for (size_t r = 0; r < RESULTS; ++r)
+        {
+            exact[q].push_back(distances[r].second);
+        }
+    }
+    std::printf("exact scan: %.0f us per query\n\n", secondsSince(start) * 1e6 / query_count);
+
+    std::printf("%-8s %8s %12s %10s\n", "level", "breadth", "us/query", "recall@10");
+    const SimdLevel original = activeSimdLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+    {
+        if (!setSimdLevel(level))
+        {
+            continue;
+        }
+        for (size_t breadth : {16u, 64u, 256u})
+        {
+            size_t found = 0;
+            start = std::chrono::steady_clock::now();
+            for (size_t q = 0; q < query_count; ++q)
+            {
+                for (const auto& result : index.query(queries.data() + q * DIMENSIONS, RESULTS, breadth))
+                {
+                    found += std::count(exact[q].begin(), exact[q].end(), result.sound_id);
+                }
+            }
+            const double seconds = secondsSince(start);
+            std::printf("%-8s %8zu %12.1f %10.3f\n", simdLevelName(level), breadth, seconds * 1e6 / query_count,
+                        static_cast<double>(found) / (query_count * RESULTS));
+        }
+    }
+    setSimdLevel(original);
+
+    const auto path = (std::filesystem::temp_directory_path() / "bench_similarity_index.ann").string();
+    if (index.save(path))
+    {
+        SimilarityIndex reopened;
+        start = std::chrono::steady_clock::now();
+        const bool opened = reopened.open(path);
+        std::printf("\nopen(): %s in %.1f ms (%.1f MiB file)\n", opened ? "mapped" : "failed",
+                    secondsSince(start) * 1e3, std::filesystem::file_size(path) / 1048576.0);
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class ArrayView
+     * @brief Non-owning, read-only view over a contiguous array
+     *
+     * Used to hand out zero-copy access to data that lives in a memory-mapped
+     * file or a transport buffer. The view is only valid while the owner of
+     * the underlying memory is alive.
+     *
+     * @tparam T Element type
+     */
+    template <typename T>
+    class ArrayView
+    {
+    public:
+        ArrayView() = default;
+
+        /**
+         * @brief Constructs a view over count elements starting at data
+         *
+         * @param data Pointer to the first element
+         * @param count Number of elements in the view
+         */
+        ArrayView(const T* data, size_t count)
+            : m_data(data), m_size(count)
+        {
+        }
+
+        const T* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        const T* begin() const { return m_data; }
+        const T* end() const { return m_data + m_size; }
+
+        const T& operator[](size_t index) const { return m_data[index]; }
+
+        /**
+         * @brief Returns a view over a sub-range of this view
+         *
+         * @param offset Index of the first element of the sub-range
+         * @param count Number of elements, clamped to the end of the view
+         * @return ArrayView<T> View over the requested elements
+         */
+        ArrayView<T> subview(size_t offset, size_t count) const
+        {
+            if (offset > m_size)
+            {
+                return {};
+            }
+            return {m_data + offset, count < m_size - offset ? count : m_size - offset};
+        }
+
+    private:
+        const T* m_data = nullptr;
+        size_t m_size = 0;
+    };
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Durability guarantee applied when a downloaded file is committed
+     */
+    enum class SyncPolicy
+    {
+        /// Rename only; survives process crashes but not power loss
+        None,
+
+        /// fsync every file before it is renamed into place
+        PerFile,
+
+        /// Collect files and fsync them in one pass per group (batch downloads)
+        GroupCommit
+    };
+
+    /**
+     * @class AtomicFile
+     * @brief Writes a file under a temporary name and renames it into place on commit
+     *
+     * The temporary file lives next to the final path, so the rename is atomic
+     * and readers only ever see either the previous file or the complete new
+     * one. A file that is destroyed without commit() is removed.
+     *
+     * @note Move-only
+     */
+    class AtomicFile
+    {
+    public:
+        AtomicFile() = default;
+        ~AtomicFile();
+
+        AtomicFile(AtomicFile&& other) noexcept;
+        AtomicFile& operator=(AtomicFile&& other) noexcept;
+
+        AtomicFile(const AtomicFile&) = delete;
+        AtomicFile& operator=(const AtomicFile&) = delete;
+
+        /**
+         * @brief Creates the temporary file for a final path
+         *
+         * @param final_path Path the file will have after commit()
+         * @return bool True if the temporary file was created
+         */
+        bool open(const std::string& final_path);
+
+        /**
+         * @brief Appends bytes to the temporary file
+         *
+         * @param data Bytes to write
+         * @param size Number of bytes at data
+         * @return bool True if every byte was written
+         */
+        bool write(const void* data, size_t size);
+
+        /**
+         * @brief Writes bytes at an offset without moving the file position
+         *
+         * Safe to call from several threads at once for disjoint ranges.
+         * Does not count towards bytesWritten().
+         *
+         * @param data Bytes to write
+         * @param size Number of bytes at data
+         * @param offset Position in the file of the first byte
+         * @return bool True if every byte was written
+         */
+        bool writeAt(const void* data, size_t size, uint64_t offset);
+
+        /**
+         * @brief Reserves disk space for the expected file size
+         *
+         * Allocating the whole file up front lets the filesystem place it
+         * contiguously and reports a full disk before any data is sent.
+         * The file's length becomes size; call truncate() if fewer bytes
+         * end up being written. Filesystems without allocation support
+         * succeed without reserving anything.
+         *
+         * @param size Expected file size in bytes
+         * @return bool False if the space could not be reserved
+         */
+        bool preallocate(uint64_t size);
+
+        /**
+         * @brief Sets the length of the temporary file
+         *
+         * @param size New length in bytes
+         * @return bool True on success
+         */
+        bool truncate(uint64_t size);
+
+        /**
+         * @brief Asks the kernel to begin writing the file back without waiting
+         *
+         * Used by GroupCommitter so that the device works on many files at
+         * once before the individual fsync calls wait for them.
+         */
+        void startWriteback();
+
+        /**
+         * @brief Flushes the file contents to stable storage
+         *
+         * @return bool True if the flush succeeded
+         */
+        bool sync();
+
+        /**
+         * @brief Closes the temporary file and renames it to the final path
+         *
+         * @param sync_first Flush the contents before renaming
+         * @return bool True if the file is now visible under its final path
+         */
+        bool commit(bool sync_first);
+
+        /**
+         * @brief Closes and removes the temporary file
+         */
+        void abort();
+
+        /**
+         * @brief Returns the native file descriptor of the temporary file, or -1
+         */
+        int descriptor() const { return m_fd; }
+
+        /**
+         * @brief Returns the number of bytes written so far
+         */
+        uint64_t bytesWritten() const { return m_written; }
+
+        const std::string& finalPath() const { return m_final_path; }
+        const std::string& tempPath() const { return m_temp_path; }
+        bool isOpen() const { return m_fd >= 0; }
+
+        /**
+         * @brief Flushes a directory entry table so that renames inside it are durable
+         *
+         * @param directory Directory to flush
+         * @return bool True on success (always true where unsupported)
+         */
+        static bool syncDirectory(const std::string& directory);
+
+    private:
+        void closeDescriptor();
+
+        /// Descriptor of the temporary file
+        int m_fd = -1;
+
+        /// Bytes written to the temporary file
+        uint64_t m_written = 0;
+
+        /// Destination of the rename
+        std::string m_final_path;
+
+        /// Temporary file next to the destination
+        std::string m_temp_path;
+    };
+
+    /**
+     * @class GroupCommitter
+     * @brief Commits many AtomicFiles with a single durability pass
+     *
+     * Files are collected until the group is full (or flush() is called).
+     * The pass then starts writeback on every file, waits for each with
+     * fsync, renames them into place and flushes each affected directory
+     * once. Compared with a per-file fsync, the device sees one deep queue
+     * of writes instead of a sequence of synchronous round trips.
+     */
+    class GroupCommitter
+    {
+    public:
+        /**
+         * @brief Constructs a committer that flushes after group_size files
+         *
+         * @param group_size Files collected before an automatic flush (minimum 1)
+         */
+        explicit GroupCommitter(size_t group_size = 64);
+
+        /**
+         * @brief Flushes any files still pending
+         */
+        ~GroupCommitter();
+
+        GroupCommitter(const GroupCommitter&) = delete;
+        GroupCommitter& operator=(const GroupCommitter&) = delete;
+
+        /**
+         * @brief Queues a fully written file, flushing if the group is full
+         *
+         * @param file Open AtomicFile whose contents are complete
+         */
+        void add(AtomicFile&& file);
+
+        /**
+         * @brief Commits every pending file
+         *
+         * @return std::vector<std::string> Final paths that could not be committed
+         */
+        std::vector<std::string> flush();
+
+        /**
+         * @brief Returns the final paths of all failed commits since construction
+         */
+        const std::vector<std::string>& failures() const { return m_failures; }
+
+    private:
+        /// Files written but not yet committed
+        std::vector<AtomicFile> m_pending;
+
+        /// Flush threshold
+        size_t m_group_size;
+
+        /// Final paths whose commit failed
+        std::vector<std::string> m_failures;
+    };
+}
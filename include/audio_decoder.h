@@ -0,0 +1,100 @@
+#pragma once
+
+#include "audio_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct AudioStreamInfo
+     * @brief Layout of the samples a decoder produces
+     */
+    struct AudioStreamInfo
+    {
+        /// Frames per second
+        uint32_t sample_rate = 0;
+
+        /// Interleaved channels per frame
+        uint16_t channels = 0;
+
+        /// Resolution of the source samples (32 or 64 for floating point)
+        uint16_t bits_per_sample = 0;
+
+        /// Length of the stream in frames, if the header states it
+        std::optional<uint64_t> frames;
+    };
+
+    /**
+     * @class AudioDecoder
+     * @brief Incremental decoder fed with a file's bytes as they arrive
+     *
+     * The bytes can be pushed in chunks of any size (e.g. straight from a
+     * DownloadSink), so decoding overlaps the transfer and the file is never
+     * read back from disk. Decoded samples are appended to the caller's
+     * vector as interleaved floats in [-1, 1).
+     *
+     * Supported containers are WAV (PCM and IEEE float, including
+     * WAVE_FORMAT_EXTENSIBLE and RF64 with an open-ended data chunk), AIFF
+     * and AIFF-C (NONE, twos, sowt, fl32, fl64) and FLAC.
+     *
+     * @note Not thread-safe; each decoder is used by one thread at a time
+     */
+    class AudioDecoder
+    {
+    public:
+        virtual ~AudioDecoder() = default;
+
+        /**
+         * @brief Creates a decoder for a container format
+         *
+         * @param format Format of the file, e.g. from sniffAudioFormat()
+         * @return std::unique_ptr<AudioDecoder> Decoder, or nullptr if the
+         *         format cannot be decoded
+         */
+        static std::unique_ptr<AudioDecoder> create(AudioFormat format);
+
+        /**
+         * @brief Consumes the next bytes of the file
+         *
+         * @param data Bytes following those pushed before
+         * @param size Number of bytes at data
+         * @param samples Receives the samples decoded so far (appended)
+         * @return bool False once the file turned out to be malformed or unsupported
+         */
+        virtual bool push(const uint8_t* data, size_t size, std::vector<float>& samples) = 0;
+
+        /**
+         * @brief Decodes whatever is still buffered after the last byte
+         *
+         * @param samples Receives the remaining samples (appended)
+         * @return bool False if the file was malformed or ended early
+         */
+        virtual bool finish(std::vector<float>& samples) = 0;
+
+        /**
+         * @brief Returns the stream layout once the header has been parsed
+         */
+        const std::optional<AudioStreamInfo>& info() const { return m_info; }
+
+    protected:
+        std::optional<AudioStreamInfo> m_info;
+    };
+
+    /**
+     * @brief Decodes a file from disk in blocks, for tools that analyse a library
+     *
+     * @param path WAV, AIFF or FLAC file
+     * @param consumer Called after each block is read, once the stream layout is
+     *                 known, with the frames decoded from it (possibly none);
+     *                 returns false to stop
+     * @return bool True if the whole file was decoded and the consumer never stopped it
+     */
+    bool decodeAudioFile(const std::string& path,
+                         const std::function<bool(const AudioStreamInfo& info, const float* samples, size_t frames)>& consumer);
+}
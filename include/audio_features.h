@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    class Resampler;
+
+    /**
+     * @class RealFft
+     * @brief Power spectrum of real frames of a fixed power-of-two size
+     *
+     * A frame of N samples is transformed as a complex FFT of N/2 points
+     * followed by a split step. Real and imaginary parts are kept in
+     * separate arrays and each stage's twiddle factors are stored
+     * contiguously, so every stage runs through the vectorized
+     * fftButterflies() kernel.
+     *
+     * @note Not thread-safe; each instance is used by one thread at a time
+     */
+    class RealFft
+    {
+    public:
+        /**
+         * @brief Precomputes the twiddle factors and bit-reversal permutation
+         *
+         * @param size Frame length
+         * @throws std::invalid_argument If size is not a power of two of at least 4
+         */
+        explicit RealFft(size_t size);
+
+        /**
+         * @brief Computes |X[k]|^2 for k = 0 .. size/2
+         *
+         * @param frame size real samples
+         * @param power Receives size/2 + 1 values
+         */
+        void powerSpectrum(const float* frame, float* power);
+
+        size_t size() const { return m_size; }
+
+    private:
+        const size_t m_size;
+
+        /// Complex transform length (m_size / 2)
+        const size_t m_half;
+
+        std::vector<uint32_t> m_reversed;
+
+        /// Twiddles of the stage with span s start at index s - 1
+        std::vector<float> m_stage_re;
+        std::vector<float> m_stage_im;
+
+        /// exp(-2 pi i k / size) for the split step
+        std::vector<float> m_split_re;
+        std::vector<float> m_split_im;
+
+        std::vector<float> m_re;
+        std::vector<float> m_im;
+    };
+
+    /**
+     * @struct FeatureOptions
+     * @brief Analysis parameters of a FeatureExtractor
+     *
+     * Sounds are analysed as mono at one rate whatever their source format,
+     * so the features of different files can be compared.
+     */
+    struct FeatureOptions
+    {
+        /// Rate the audio is converted to before analysis
+        uint32_t analysis_rate = 22050;
+
+        /// Samples per analysis frame (a power of two)
+        uint32_t fft_size = 1024;
+
+        /// Samples between the starts of consecutive frames
+        uint32_t hop_size = 512;
+
+        /// Triangular mel filters between 0 Hz and the Nyquist frequency
+        uint32_t mel_bands = 40;
+    };
+
+    /**
+     * @struct AudioFeatures
+     * @brief Summary statistics of a sound's frame-wise spectral descriptors
+     */
+    struct AudioFeatures
+    {
+        /// Cepstral coefficients per frame, including c0 (overall log energy)
+        static constexpr size_t MFCC_COUNT = 13;
+
+        /// Length of embedding()
+        static constexpr size_t EMBEDDING_SIZE = 2 * MFCC_COUNT + 4;
+
+        /// Frames that contributed (silent frames are skipped)
+        uint64_t frames = 0;
+
+        /// Mean and standard deviation of each MFCC over the frames
+        std::array<float, MFCC_COUNT> mfcc_mean{};
+        std::array<float, MFCC_COUNT> mfcc_std{};
+
+        /// Spectral centroid in Hz
+        float centroid_mean = 0.0f;
+        float centroid_std = 0.0f;
+
+        /// Spectral flatness, geometric over arithmetic mean power (near 0 for tones, higher for noise)
+        float flatness_mean = 0.0f;
+        float flatness_std = 0.0f;
+
+        /// Nyquist frequency of the analysis, which scales the centroid in embedding()
+        float nyquist = 0.0f;
+
+        /**
+         * @brief Returns the fixed-length vector used to compare sounds
+         *
+         * MFCC means and deviations, then the centroid mean and deviation
+         * as fractions of the Nyquist frequency, then the flatness mean and
+         * deviation.
+         */
+        std::array<float, EMBEDDING_SIZE> embedding() const;
+
+        /**
+         * @brief Writes the features to a small binary file
+         *
+         * @param path Destination, usually featurePathFor() of the sound
+         * @param sync_first Flush the file to stable storage before it appears
+         * @return bool True if the file was written
+         */
+        bool save(const std::string& path, bool sync_first = false) const;
+
+        /**
+         * @brief Reads a file written by save()
+         *
+         * @param path Feature file
+         * @return std::optional<AudioFeatures> Features, or std::nullopt if the file is missing or malformed
+         */
+        static std::optional<AudioFeatures> load(const std::string& path);
+    };
+
+    /**
+     * @class FeatureExtractor
+     * @brief Computes MFCC and spectral descriptors of a sound as its samples are decoded
+     *
+     * Input is mixed to mono and converted to the analysis rate, cut into
+     * Hann-windowed frames and transformed with RealFft. Each frame yields
+     * 13 MFCCs (log mel energies through a DCT-II), the spectral centroid
+     * and the spectral flatness; their means and deviations over the
+     * sound form AudioFeatures.
+     *
+     * @note Not thread-safe; each extractor is used by one thread at a time
+     */
+    class FeatureExtractor
+    {
+    public:
+        /**
+         * @brief Prepares an extractor
+         *
+         * @param channels Interleaved channels per frame of the input
+         * @param sample_rate Rate of the input
+         * @param options Analysis parameters
+         * @throws std::invalid_argument If channels, sample_rate, analysis_rate, hop_size or mel_bands is zero,
+         *         fft_size is not a power of two of at least 64, or hop_size exceeds fft_size
+         */
+        FeatureExtractor(uint16_t channels, uint32_t sample_rate, const FeatureOptions& options = {});
+        ~FeatureExtractor();
+
+        FeatureExtractor(const FeatureExtractor&) = delete;
+        FeatureExtractor& operator=(const FeatureExtractor&) = delete;
+
+        /**
+         * @brief Adds the next frames of the sound
+         *
+         * @param samples Interleaved frames following those added before
+         * @param frames Number of frames at samples
+         */
+        void push(const float* samples, size_t frames);
+
+        /**
+         * @brief Analyses what is still buffered and returns the summary
+         *
+         * A sound shorter than one frame is analysed as one zero-padded frame.
+         *
+         * @return AudioFeatures Features of all frames pushed
+         */
+        AudioFeatures finish();
+
+    private:
+        struct MelBand
+        {
+            size_t first_bin;
+            std::vector<float> weights;
+        };
+
+        static const FeatureOptions& validated(uint16_t channels, uint32_t sample_rate, const FeatureOptions& options);
+        void analyseFrames();
+        void analyse(const float* frame);
+
+        const uint16_t m_channels;
+        const FeatureOptions m_options;
+
+        std::unique_ptr<Resampler> m_resampler;
+        RealFft m_fft;
+
+        std::vector<float> m_window;
+        std::vector<MelBand> m_bands;
+
+        /// MFCC_COUNT rows of mel_bands DCT-II weights
+        std::vector<float> m_dct;
+
+        /// Mono samples at the analysis rate not yet consumed, from m_pending_start on
+        std::vector<float> m_pending;
+        size_t m_pending_start = 0;
+
+        std::vector<float> m_mixed;
+        std::vector<float> m_frame;
+        std::vector<float> m_power;
+        std::vector<float> m_log_mel;
+
+        /// Sums and sums of squares of the MFCCs, centroid and flatness
+        std::array<double, AudioFeatures::MFCC_COUNT + 2> m_sum{};
+        std::array<double, AudioFeatures::MFCC_COUNT + 2> m_sum_squares{};
+        uint64_t m_frames = 0;
+        bool m_analysed_any = false;
+    };
+
+    /**
+     * @brief Returns the path of the feature file kept next to an audio file
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.features`
+     */
+    std::string featurePathFor(const std::string& audio_path);
+
+    /**
+     * @brief Decodes audio files in parallel and writes a feature file next to each
+     *
+     * @param paths WAV, AIFF or FLAC files
+     * @param options Analysis parameters
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::string> Paths whose features could not be extracted
+     */
+    std::vector<std::string> extractFeatureFiles(const std::vector<std::string>& paths,
+                                                 const FeatureOptions& options = {}, unsigned threads = 0);
+}
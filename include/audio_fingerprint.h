@@ -0,0 +1,320 @@
+#pragma once
+
+#include "audio_features.h"
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    class Resampler;
+
+    /**
+     * @struct FingerprintOptions
+     * @brief Analysis parameters of a Fingerprinter
+     *
+     * Fingerprints can only be compared with fingerprints made with the
+     * same options.
+     */
+    struct FingerprintOptions
+    {
+        /// Rate the audio is converted to before analysis
+        uint32_t analysis_rate = 11025;
+
+        /// Samples per analysis frame (a power of two from 64 to 1024)
+        uint32_t fft_size = 1024;
+
+        /// Samples between the starts of consecutive frames
+        uint32_t hop_size = 512;
+
+        /// Later peaks each peak is paired with
+        uint32_t fan_out = 4;
+    };
+
+    /**
+     * @struct FingerprintHash
+     * @brief One pair of spectral peaks
+     */
+    struct FingerprintHash
+    {
+        /// Frequency bins of both peaks and the frames between them
+        uint32_t hash;
+
+        /// Analysis frame of the first peak
+        uint32_t time;
+    };
+
+    /**
+     * @struct Fingerprint
+     * @brief Spectral-peak hashes of a sound, in time order
+     */
+    struct Fingerprint
+    {
+        std::vector<FingerprintHash> hashes;
+
+        /// Analysis frames the sound spans
+        uint32_t frames = 0;
+    };
+
+    /**
+     * @class Fingerprinter
+     * @brief Computes the fingerprint of a sound as its samples are decoded
+     *
+     * Input is mixed to mono and converted to the analysis rate, then
+     * transformed frame by frame with RealFft. Peaks are the bins that are
+     * the loudest in a neighbourhood of most of a second and a few hundred
+     * hertz around them. Each peak is paired with the next fan_out peaks
+     * that follow it closely in time and frequency, and every pair is
+     * hashed from the two frequencies and the time between them. These
+     * hashes depend neither on gain nor on the source format, and they
+     * mostly survive lossy re-encoding. Sounds that share many hashes at
+     * one consistent time offset contain the same audio.
+     *
+     * @note Not thread-safe; each fingerprinter is used by one thread at a time
+     */
+    class Fingerprinter
+    {
+    public:
+        /**
+         * @brief Prepares a fingerprinter
+         *
+         * @param channels Interleaved channels per frame of the input
+         * @param sample_rate Rate of the input
+         * @param options Analysis parameters
+         * @throws std::invalid_argument If channels, sample_rate, analysis_rate, hop_size or fan_out is zero,
+         *         fft_size is not a power of two from 64 to 1024, or hop_size exceeds fft_size
+         */
+        Fingerprinter(uint16_t channels, uint32_t sample_rate, const FingerprintOptions& options = {});
+        ~Fingerprinter();
+
+        Fingerprinter(const Fingerprinter&) = delete;
+        Fingerprinter& operator=(const Fingerprinter&) = delete;
+
+        /**
+         * @brief Adds the next frames of the sound
+         *
+         * @param samples Interleaved frames following those added before
+         * @param frames Number of frames at samples
+         */
+        void push(const float* samples, size_t frames);
+
+        /**
+         * @brief Analyses what is still buffered and returns the fingerprint
+         *
+         * @return Fingerprint Hashes of all frames pushed (none for silence or very short sounds)
+         */
+        Fingerprint finish();
+
+    private:
+        struct Peak
+        {
+            uint32_t frame;
+            uint32_t bin;
+        };
+
+        static const FingerprintOptions& validated(uint16_t channels, uint32_t sample_rate,
+                                                   const FingerprintOptions& options);
+        void analyseFrames();
+        void analyse(const float* frame);
+        void pickPeaks(uint32_t frame);
+
+        const uint16_t m_channels;
+        const FingerprintOptions m_options;
+
+        std::unique_ptr<Resampler> m_resampler;
+        RealFft m_fft;
+        std::vector<float> m_window;
+
+        /// Mono samples at the analysis rate not yet consumed, from m_pending_start on
+        std::vector<float> m_pending;
+        size_t m_pending_start = 0;
+
+        std::vector<float> m_mixed;
+        std::vector<float> m_frame;
+
+        /// Power spectra of the last frames, and each bin's maximum over its frequency neighbours
+        std::vector<float> m_spectra;
+        std::vector<float> m_neighbourhood;
+
+        /// Frames analysed so far
+        uint32_t m_frames = 0;
+
+        std::vector<Peak> m_peaks;
+    };
+
+    /**
+     * @struct FingerprintMatch
+     * @brief An indexed sound that shares audio with a fingerprint
+     */
+    struct FingerprintMatch
+    {
+        int sound_id;
+
+        /// Hashes that line up at the best time offset
+        uint32_t matched;
+
+        /// matched as a fraction of the hashes of the shorter of the two sounds
+        float score;
+
+        /// Frames into the indexed sound at which the fingerprinted audio starts
+        int32_t offset;
+    };
+
+    /**
+     * @class FingerprintIndex
+     * @brief Looks up sounds by fingerprint to find duplicates
+     *
+     * Hashes map to the sounds and times they occur at. A lookup counts
+     * the hashes that agree with each indexed sound at each time offset,
+     * so a trimmed or padded copy still matches its original.
+     *
+     * save() writes the hashes sorted, as fixed-size records; open() maps
+     * such a file and looks hashes up by binary search. Sounds inserted
+     * after open() are kept in memory until the next save().
+     *
+     * @note Thread-safe
+     */
+    class FingerprintIndex
+    {
+    public:
+        /// Default score above which a sound counts as a duplicate
+        static constexpr float DUPLICATE_SCORE = 0.25f;
+
+        /// Aligned hashes a match needs whatever its score, so short sounds do not match by chance
+        static constexpr uint32_t MIN_MATCHED = 8;
+
+        FingerprintIndex() = default;
+
+        FingerprintIndex(const FingerprintIndex&) = delete;
+        FingerprintIndex& operator=(const FingerprintIndex&) = delete;
+
+        /**
+         * @brief Adds the fingerprint of a sound
+         *
+         * @param sound_id Freesound sound ID
+         * @param fingerprint Its fingerprint
+         * @return bool True if added; false if the sound is already indexed
+         */
+        bool insert(int sound_id, const Fingerprint& fingerprint);
+
+        /**
+         * @brief Adds a sound unless it duplicates one already indexed
+         *
+         * The check and the insert happen under one lock, so two copies of
+         * a sound added at the same time cannot both miss each other.
+         *
+         * @param sound_id Freesound sound ID
+         * @param fingerprint Its fingerprint
+         * @param min_score Score from which a match counts as a duplicate
+         * @return std::optional<FingerprintMatch> The sound it duplicates (and it was not added),
+         *         or std::nullopt if it was added or was already indexed
+         */
+        std::optional<FingerprintMatch> insertIfUnique(int sound_id, const Fingerprint& fingerprint,
+                                                       float min_score = DUPLICATE_SCORE);
+
+        /**
+         * @brief Forgets a sound
+         *
+         * @param sound_id Freesound sound ID
+         * @return bool True if the sound was indexed
+         */
+        bool remove(int sound_id);
+
+        /**
+         * @brief Finds the indexed sounds that share the most audio with a fingerprint
+         *
+         * Hashes shared by more than 10000 occurrences are skipped: they
+         * describe nothing in particular and would make lookups slow.
+         *
+         * @param fingerprint Fingerprint to look up
+         * @param max_results Maximum number of matches
+         * @return std::vector<FingerprintMatch> Matches with at least MIN_MATCHED aligned hashes, best first
+         */
+        std::vector<FingerprintMatch> match(const Fingerprint& fingerprint, size_t max_results = 5) const;
+
+        /**
+         * @brief Returns the best match if it is close enough to count as a duplicate
+         *
+         * @param fingerprint Fingerprint to look up
+         * @param min_score Score from which a match counts as a duplicate
+         * @return std::optional<FingerprintMatch> Best match, or std::nullopt
+         */
+        std::optional<FingerprintMatch> findDuplicate(const Fingerprint& fingerprint,
+                                                      float min_score = DUPLICATE_SCORE) const;
+
+        bool contains(int sound_id) const;
+        size_t size() const;
+
+        /**
+         * @brief Writes every indexed sound to a file that open() can map
+         *
+         * @param path Destination
+         * @param sync_first Flush the file to stable storage before it appears
+         * @return bool True if the file was written
+         */
+        bool save(const std::string& path, bool sync_first = false) const;
+
+        /**
+         * @brief Replaces the contents of the index with a file written by save()
+         *
+         * @param path Index file
+         * @return bool True if the file was opened; false leaves the index unchanged
+         */
+        bool open(const std::string& path);
+
+    private:
+        struct Posting
+        {
+            int32_t sound_id;
+            uint32_t time;
+        };
+
+        std::optional<uint32_t> hashCount(int sound_id) const;
+        bool containsLocked(int sound_id) const;
+        void insertLocked(int sound_id, const Fingerprint& fingerprint);
+        std::vector<FingerprintMatch> matchLocked(const Fingerprint& fingerprint, size_t max_results) const;
+
+        mutable std::shared_mutex m_mutex;
+
+        /// Hash records and (sound ID, hash count) pairs of the mapped file, both sorted
+        MappedFile m_file;
+        const uint8_t* m_records = nullptr;
+        size_t m_record_count = 0;
+        const uint8_t* m_sounds = nullptr;
+        size_t m_sound_count = 0;
+
+        /// Sounds of the mapped file that were removed since
+        std::unordered_set<int> m_removed;
+
+        /// Sounds inserted since open(), by hash and by sound
+        std::unordered_map<uint32_t, std::vector<Posting>> m_postings;
+        std::unordered_map<int, std::vector<FingerprintHash>> m_added;
+    };
+
+    /**
+     * @brief Decodes audio files in parallel and fingerprints each
+     *
+     * @param paths WAV, AIFF or FLAC files
+     * @param options Analysis parameters
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::optional<Fingerprint>> One entry per path, std::nullopt where decoding failed
+     */
+    std::vector<std::optional<Fingerprint>> fingerprintFiles(const std::vector<std::string>& paths,
+                                                             const FingerprintOptions& options = {},
+                                                             unsigned threads = 0);
+
+    /**
+     * @brief Returns the path of the file that stands in for a duplicate sound
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.ref`
+     */
+    std::string referencePathFor(const std::string& audio_path);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Container formats of sounds served by Freesound
+     */
+    enum class AudioFormat : uint8_t
+    {
+        Unknown = 0,
+        Wav = 1,
+        Aiff = 2,
+        Flac = 3,
+        Ogg = 4,
+        Mp3 = 5
+    };
+
+    /// Number of leading bytes that sniffAudioFormat() needs for every format
+    constexpr size_t AUDIO_SNIFF_BYTES = 16;
+
+    /**
+     * @brief Identifies a container format from the first bytes of a file
+     *
+     * Sixteen bytes are enough for every supported format; fewer bytes may
+     * yield AudioFormat::Unknown.
+     *
+     * @param data Start of the file contents
+     * @param size Number of bytes available at data
+     * @return AudioFormat Detected format, or AudioFormat::Unknown
+     */
+    AudioFormat sniffAudioFormat(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Returns the conventional file extension for a format
+     *
+     * @param format Container format
+     * @return const char* Extension without the leading dot ("bin" for Unknown)
+     */
+    const char* audioFormatExtension(AudioFormat format);
+}
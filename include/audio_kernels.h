@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Instruction sets the audio kernels are implemented for
+     */
+    enum class SimdLevel
+    {
+        /// Portable loops, available everywhere
+        Scalar,
+
+        /// 256-bit AVX2 on x86-64, chosen when the CPU reports it
+        Avx2,
+
+        /// 128-bit NEON, part of every AArch64 CPU
+        Neon
+    };
+
+    /**
+     * @brief Integer sample encodings the conversion kernels accept (little-endian)
+     */
+    enum class PcmEncoding
+    {
+        /// Two bytes per sample
+        Int16,
+
+        /// Three packed bytes per sample
+        Int24,
+
+        /// Four bytes per sample
+        Int32
+    };
+
+    /**
+     * @struct AudioLevels
+     * @brief Peak and RMS of a block of samples, both linear (1.0 is full scale)
+     */
+    struct AudioLevels
+    {
+        float peak = 0.0f;
+        float rms = 0.0f;
+    };
+
+    /**
+     * @struct SampleRange
+     * @brief Smallest and largest sample of a block
+     */
+    struct SampleRange
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+    };
+
+    /**
+     * @brief Returns the instruction set the kernels currently run on
+     *
+     * Chosen on first use from what the CPU supports.
+     */
+    SimdLevel activeSimdLevel();
+
+    /**
+     * @brief Returns whether a level can run on this CPU
+     */
+    bool simdLevelSupported(SimdLevel level);
+
+    /**
+     * @brief Switches every kernel to another instruction set
+     *
+     * Meant for tests and benchmarks comparing implementations; the
+     * automatic choice is the fastest one.
+     *
+     * @param level Instruction set to use
+     * @return bool false (and nothing changes) if the CPU lacks the level
+     */
+    bool setSimdLevel(SimdLevel level);
+
+    /**
+     * @brief Returns a printable name of a level ("scalar", "avx2", "neon")
+     */
+    const char* simdLevelName(SimdLevel level);
+
+    /**
+     * @brief Returns the bytes per sample of an encoding
+     */
+    size_t pcmBytesPerSample(PcmEncoding encoding);
+
+    /**
+     * @brief Converts integer samples to floats in [-1, 1)
+     *
+     * @param input Little-endian samples
+     * @param encoding Encoding of input
+     * @param count Number of samples
+     * @param output Receives count floats; must not overlap input
+     */
+    void pcmToFloat(const uint8_t* input, PcmEncoding encoding, size_t count, float* output);
+
+    /**
+     * @brief Converts a downloaded buffer of integer samples to floats in place
+     *
+     * The buffer grows to hold the floats and the samples are converted
+     * from the back, so no second buffer is needed. A trailing partial
+     * sample is dropped.
+     *
+     * @param buffer Little-endian samples; holds native floats afterwards
+     * @param encoding Encoding of the samples in buffer
+     * @return size_t Number of samples converted
+     */
+    size_t pcmToFloatInPlace(std::vector<uint8_t>& buffer, PcmEncoding encoding);
+
+    /**
+     * @brief Measures the peak magnitude and RMS of samples
+     *
+     * @param samples Samples of any number of interleaved channels
+     * @param count Number of samples
+     * @return AudioLevels Levels over all samples (zero for an empty block)
+     */
+    AudioLevels measureLevels(const float* samples, size_t count);
+
+    /**
+     * @brief Finds the smallest and largest sample
+     *
+     * The inner loop of waveform overviews.
+     *
+     * @param samples Samples of any number of interleaved channels
+     * @param count Number of samples
+     * @return SampleRange Extremes over all samples (zero for an empty block)
+     */
+    SampleRange measureRange(const float* samples, size_t count);
+
+    /**
+     * @brief Multiplies samples by a gain in place
+     *
+     * @param samples Samples to scale
+     * @param count Number of samples
+     * @param gain Linear factor
+     */
+    void applyGain(float* samples, size_t count, float gain);
+
+    /**
+     * @brief Returns the sum of the products of two sample sequences
+     *
+     * The inner loop of FIR filters such as the Resampler's.
+     *
+     * @param a First sequence
+     * @param b Second sequence
+     * @param count Number of samples in each
+     * @return float Dot product (0 for count 0)
+     */
+    float dotProduct(const float* a, const float* b, size_t count);
+
+    /**
+     * @brief Returns the squared Euclidean distance between two vectors
+     *
+     * The inner loop of the SimilarityIndex graph search.
+     *
+     * @param a First vector
+     * @param b Second vector
+     * @param count Number of elements in each
+     * @return float Sum of the squared differences (0 for count 0)
+     */
+    float squaredDistance(const float* a, const float* b, size_t count);
+
+    /**
+     * @brief Computes the residual of an integer linear predictor
+     *
+     * residual[i] = samples[i] - ((sum over j of coefficients[j] * samples[i - 1 - j]) >> shift).
+     * The inner loop of the lossless codec's encoder. Sums are 32-bit, so
+     * the caller keeps sample and coefficient widths small enough that
+     * they cannot overflow.
+     *
+     * @param samples First sample to predict; the order samples before it are read as history
+     * @param count Number of samples to predict
+     * @param coefficients Quantised coefficients, for the previous sample first
+     * @param order Number of coefficients
+     * @param shift Right shift applied to each prediction
+     * @param residual Receives count differences between samples and predictions
+     */
+    void lpcResidual(const int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                     unsigned shift, int32_t* residual);
+
+    /**
+     * @brief Applies radix-2 butterflies to split-complex data in place
+     *
+     * For each k, with t = w[k] * hi[k]: hi[k] = lo[k] - t and
+     * lo[k] = lo[k] + t. The inner loop of the FFT used by the feature
+     * extractor; keeping real and imaginary parts in separate arrays lets
+     * every lane do the same work.
+     *
+     * @param lo_re Real parts of the first inputs and outputs
+     * @param lo_im Imaginary parts of the first inputs and outputs
+     * @param hi_re Real parts of the second inputs and outputs
+     * @param hi_im Imaginary parts of the second inputs and outputs
+     * @param w_re Real parts of the twiddle factors
+     * @param w_im Imaginary parts of the twiddle factors
+     * @param count Number of butterflies
+     */
+    void fftButterflies(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                        const float* w_re, const float* w_im, size_t count);
+
+    /**
+     * @brief Scales samples in place so that their peak reaches a target
+     *
+     * @param samples Samples to scale
+     * @param count Number of samples
+     * @param target_peak Linear peak to reach
+     * @return float Gain applied (1 for silence, which is left unchanged)
+     */
+    float normalizePeak(float* samples, size_t count, float target_peak = 1.0f);
+
+    /**
+     * @brief Returns the default mixing matrix between two channel counts
+     *
+     * Equal counts map channels straight through, a mono source is copied
+     * to every output, a mono output averages every input, and other
+     * combinations keep the common channels and silence the rest.
+     *
+     * @return std::vector<float> out_channels rows of in_channels weights
+     */
+    std::vector<float> defaultChannelMatrix(unsigned in_channels, unsigned out_channels);
+
+    /**
+     * @brief Remaps interleaved frames to another channel count in place
+     *
+     * Output channel o of each frame is the sum over i of
+     * matrix[o * in_channels + i] times input channel i. Downmixing shrinks
+     * the buffer, upmixing grows it, both without a second buffer.
+     * Stereo to mono and mono to stereo with the default matrix take
+     * vectorized paths.
+     *
+     * @param samples Interleaved frames; holds the remapped frames afterwards
+     * @param in_channels Channels per frame in samples
+     * @param out_channels Channels per frame wanted
+     * @param matrix out_channels x in_channels weights (empty for defaultChannelMatrix)
+     * @return bool false (and samples unchanged) for a zero channel count or a matrix of the wrong size
+     */
+    bool remapChannels(std::vector<float>& samples, unsigned in_channels, unsigned out_channels,
+                       const std::vector<float>& matrix = {});
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "audio_decoder.h"
+#include "audio_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct AudioFileInfo
+     * @brief Format and length of an audio file, as stated by its headers
+     */
+    struct AudioFileInfo
+    {
+        /// Path the information was read from (empty for in-memory data)
+        std::string path;
+
+        /// Size of the file in bytes
+        uint64_t file_size = 0;
+
+        /// Container format (Unknown if the file is not audio or could not be read)
+        AudioFormat format = AudioFormat::Unknown;
+
+        /// Rate, channels, bit depth (0 for lossy codecs) and length in frames
+        AudioStreamInfo stream;
+
+        /// Whether the headers could be parsed; stream.frames may still be unknown
+        bool valid() const { return stream.sample_rate != 0 && stream.channels != 0; }
+
+        /// Duration in seconds, or 0 if the length is unknown
+        double duration() const
+        {
+            return valid() && stream.frames ? static_cast<double>(*stream.frames) / stream.sample_rate : 0.0;
+        }
+    };
+
+    /**
+     * @struct ScanOptions
+     * @brief Configuration of scanAudioFiles()
+     */
+    struct ScanOptions
+    {
+        /// Worker threads (0 for one per hardware thread)
+        unsigned threads = 0;
+
+        /// Files ahead of the workers whose headers the kernel is asked to read in advance
+        size_t readahead = 64;
+    };
+
+    /**
+     * @brief Reads the format and length of an audio file from its headers only
+     *
+     * WAV/RF64 (fmt, fact, ds64 and data chunks), AIFF/AIFF-C (COMM),
+     * FLAC (STREAMINFO, also inside Ogg), Ogg Vorbis and Opus (identification
+     * header and the granule position of the last page) and MP3 (first frame
+     * header plus a Xing/Info/VBRI header; constant-bitrate files without one
+     * are estimated from their size). Output of compressPcmFile() is
+     * reported as the WAV or AIFF file it holds, with file_size the size
+     * on disk. At most a few small reads near the start and end of the
+     * file are made, however long the audio is.
+     *
+     * @param path File to probe
+     * @return AudioFileInfo Information; check valid()
+     */
+    AudioFileInfo probeAudioFile(const std::string& path);
+
+    /**
+     * @brief Reads the format and length of audio held in memory from its headers
+     *
+     * @param data File contents
+     * @param size Number of bytes at data
+     * @return AudioFileInfo Information; check valid()
+     */
+    AudioFileInfo probeAudioData(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Probes many files in parallel
+     *
+     * The files are spread over a pool of worker threads. While a worker
+     * parses one file, the start and end of a file further down the list
+     * are requested from the kernel (posix_fadvise WILLNEED), so the disk
+     * reads of the upcoming headers overlap the parsing and many requests
+     * are in flight at once even on a single worker.
+     *
+     * @param paths Files to probe
+     * @param options Thread count and readahead distance
+     * @return std::vector<AudioFileInfo> One entry per path, in the same order
+     */
+    std::vector<AudioFileInfo> scanAudioFiles(const std::vector<std::string>& paths, const ScanOptions& options = {});
+
+    /**
+     * @brief Probes every audio file below a directory, e.g. a SoundStore root
+     *
+     * Files are selected by extension (wav, aif, aiff, aifc, flac, ogg,
+     * oga, opus, mp3, and fsl for the sounds a SoundStore keeps through
+     * compressPcmFile()) and probed with scanAudioFiles().
+     *
+     * @param root Directory to walk recursively
+     * @param options Thread count and readahead distance
+     * @return std::vector<AudioFileInfo> One entry per audio file found, in path order
+     */
+    std::vector<AudioFileInfo> scanAudioDirectory(const std::string& root, const ScanOptions& options = {});
+}
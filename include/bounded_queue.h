@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class BoundedQueue
+     * @brief Fixed-capacity lock-free queue for many producers and many consumers
+     *
+     * Each cell carries a sequence number that tells producers and consumers
+     * whether it is free or filled for their lap around the ring, so push and
+     * pop each cost one compare-and-swap on the shared cursor in the common
+     * case (D. Vyukov's bounded MPMC design). The queue never allocates after
+     * construction; a full queue rejects tryPush(), which is how callers apply
+     * backpressure.
+     *
+     * @tparam T Element type; must be default-constructible and movable
+     * @note Thread-safe
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        /**
+         * @brief Constructs a queue holding up to capacity elements
+         *
+         * @param capacity Maximum number of queued elements, rounded up to a power of two
+         * @throws std::invalid_argument If capacity is zero
+         */
+        explicit BoundedQueue(size_t capacity)
+        {
+            if (capacity == 0)
+            {
+                throw std::invalid_argument("BoundedQueue capacity must be positive");
+            }
+
+            size_t rounded = 1;
+            while (rounded < capacity)
+            {
+                rounded <<= 1;
+            }
+
+            m_mask = rounded - 1;
+            m_cells.reset(new Cell[rounded]);
+            for (size_t i = 0; i < rounded; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        /**
+         * @brief Appends an element if there is room
+         *
+         * @param value Element to move into the queue
+         * @return bool False if the queue is full (value is left untouched)
+         */
+        bool tryPush(T&& value)
+        {
+            size_t position = m_enqueue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell& cell = m_cells[position & m_mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (lap == 0)
+                {
+                    if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (lap < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_enqueue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * @brief Removes the oldest element if there is one
+         *
+         * @param value Receives the element
+         * @return bool False if the queue is empty
+         */
+        bool tryPop(T& value)
+        {
+            size_t position = m_dequeue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell& cell = m_cells[position & m_mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if (lap == 0)
+                {
+                    if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.value);
+                        cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (lap < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_dequeue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * @brief Returns the number of elements the queue can hold
+         */
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        /// Slot of the ring; the sequence number says whose turn it is
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        /// Keeps the producer and consumer cursors on separate cache lines
+        static constexpr size_t CACHE_LINE = 64;
+
+        std::unique_ptr<Cell[]> m_cells;
+        size_t m_mask = 0;
+        alignas(CACHE_LINE) std::atomic<size_t> m_enqueue{0};
+        alignas(CACHE_LINE) std::atomic<size_t> m_dequeue{0};
+    };
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace FreesoundDownloader
+{
+    class BufferPool;
+
+    /**
+     * @class PooledBuffer
+     * @brief Move-only byte buffer whose memory comes from a BufferPool
+     *
+     * Destroying the buffer hands its memory back to the pool it came from,
+     * where the next buffer of the same size class reuses it. The memory stays
+     * valid even if the pool is destroyed first.
+     */
+    class PooledBuffer
+    {
+    public:
+        /**
+         * @brief Creates an empty buffer with no memory attached
+         */
+        PooledBuffer() = default;
+
+        /**
+         * @brief Returns the memory to its pool
+         */
+        ~PooledBuffer();
+
+        PooledBuffer(PooledBuffer&& other) noexcept;
+        PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+        PooledBuffer(const PooledBuffer&) = delete;
+        PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+        /**
+         * @brief Returns the bytes held by the buffer
+         */
+        uint8_t* data() { return m_data; }
+        const uint8_t* data() const { return m_data; }
+
+        /**
+         * @brief Returns the number of bytes held by the buffer
+         */
+        size_t size() const { return m_size; }
+
+        /**
+         * @brief Returns the number of bytes the buffer can hold without moving
+         */
+        size_t capacity() const { return m_capacity; }
+
+        /**
+         * @brief Returns true if the buffer holds no bytes
+         */
+        bool empty() const { return m_size == 0; }
+
+        /**
+         * @brief Ensures room for at least capacity bytes
+         *
+         * A larger block is taken from the same pool and the contents are
+         * copied into it, so reserving the final size up front avoids copies.
+         *
+         * @param capacity Required capacity in bytes
+         * @return bool False if the buffer has no pool or allocation failed
+         */
+        bool reserve(size_t capacity);
+
+        /**
+         * @brief Appends bytes, growing the buffer geometrically if needed
+         *
+         * @param data Bytes to append
+         * @param size Number of bytes at data
+         * @return bool False if the buffer could not grow
+         */
+        bool append(const void* data, size_t size);
+
+        /**
+         * @brief Discards the contents but keeps the memory
+         */
+        void clear() { m_size = 0; }
+
+    private:
+        friend class BufferPool;
+
+        struct Shelves;
+
+        PooledBuffer(std::shared_ptr<Shelves> shelves, uint8_t* data, size_t capacity);
+
+        void release();
+
+        std::shared_ptr<Shelves> m_shelves;
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_capacity = 0;
+    };
+
+    /**
+     * @class BufferPool
+     * @brief Size-classed cache of large byte buffers
+     *
+     * Requests are rounded up to a power of two between MIN_BLOCK and
+     * MAX_BLOCK, and released blocks are kept on a free list per size class.
+     * Loading many sounds of similar length therefore reuses a handful of
+     * blocks instead of going to the allocator (and page faulting fresh
+     * memory) for every file. Blocks larger than MAX_BLOCK are allocated to
+     * size and freed on release. Cached memory is capped; blocks released
+     * beyond the cap are freed.
+     *
+     * @note Thread-safe
+     */
+    class BufferPool
+    {
+    public:
+        /// Smallest block handed out
+        static constexpr size_t MIN_BLOCK = 64 * 1024;
+
+        /// Largest block that is cached for reuse
+        static constexpr size_t MAX_BLOCK = size_t(1) << 30;
+
+        /**
+         * @brief Creates an empty pool
+         *
+         * @param max_cached_bytes Upper bound on memory kept for reuse
+         */
+        explicit BufferPool(size_t max_cached_bytes = 256 * 1024 * 1024);
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        /**
+         * @brief Takes an empty buffer with room for at least capacity bytes
+         *
+         * @param capacity Required capacity in bytes
+         * @return PooledBuffer Empty buffer; capacity() is 0 if allocation failed
+         */
+        PooledBuffer acquire(size_t capacity);
+
+        /**
+         * @brief Returns the memory currently held for reuse
+         */
+        size_t cachedBytes() const;
+
+        /**
+         * @brief Frees every cached block
+         */
+        void trim();
+
+    private:
+        std::shared_ptr<PooledBuffer::Shelves> m_shelves;
+    };
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "freesound_downloader.h"
+#include "rate_limiter.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct CrawlOptions
+     * @brief Configuration for a partitioned full-catalog metadata crawl
+     */
+    struct CrawlOptions
+    {
+        /// First sound ID covered by the crawl (inclusive)
+        int min_id = 1;
+
+        /// Last sound ID covered by the crawl (inclusive)
+        int max_id = 1000000;
+
+        /// Number of sound IDs per range; each range is claimed and checkpointed as a unit
+        int range_size = 10000;
+
+        /// Results requested per search page (Freesound caps this at 150)
+        int page_size = 150;
+
+        /// Request budget shared by all workers of this process
+        int requests_per_minute = 60;
+
+        /// Worker thread count; 0 sizes the pool from the rate limit and expected latency
+        int max_workers = 0;
+
+        /// Typical round trip of one search page, used when sizing the pool
+        std::chrono::milliseconds expected_latency{1500};
+
+        /// Directory holding range claims and checkpoints; may be shared between processes and hosts
+        std::string job_dir = "freesound_crawl";
+
+        /// A claim whose heartbeat is older than this is treated as abandoned and taken over
+        std::chrono::seconds lease_timeout{600};
+
+        /// Attempts per page before the range is released for a later run
+        int max_attempts = 3;
+
+        /// Text query combined with the ID range (empty matches every sound)
+        std::string query;
+
+        /// Additional filter ANDed with the ID range filter
+        std::optional<std::string> filter;
+    };
+
+    /**
+     * @struct CrawlStats
+     * @brief Summary of a single CatalogCrawler::run invocation
+     */
+    struct CrawlStats
+    {
+        /// Ranges finished by this process during the run
+        int ranges_completed = 0;
+
+        /// Ranges given up after exhausting max_attempts on a page or failing to record progress
+        int ranges_failed = 0;
+
+        /// Ranges already finished or held by a live claim elsewhere
+        int ranges_skipped = 0;
+
+        /// Result pages delivered to the page callback
+        long long pages_fetched = 0;
+
+        /// Search requests issued, including retries
+        long long requests_issued = 0;
+    };
+
+    /**
+     * @class CatalogCrawler
+     * @brief Harvests metadata for the whole catalog by splitting the sound ID space into ranges
+     *
+     * Each range is queried through an `id:[first TO last]` filter with the
+     * advanced searchSounds overload and paged until exhausted. Ranges are
+     * processed by a pool of worker threads that share one RateLimiter.
+     *
+     * Progress is stored in CrawlOptions::job_dir, one set of files per range:
+     * - `<range>.claim` is created exclusively by the worker that owns the range
+     *   and touched after every page as a heartbeat
+     * - `<range>.progress` records the next page to fetch
+     * - `<range>.done` marks a finished range
+     *
+     * Several processes, or several hosts sharing the directory, can run the
+     * same job concurrently; each only picks up ranges nobody else holds.
+     * After a crash the next run resumes each range at its recorded page once
+     * the abandoned claim has exceeded the lease timeout.
+     *
+     * @note Pages are delivered at least once. A page whose checkpoint was not
+     *       written before a crash is delivered again on resume, so consumers
+     *       should upsert by sound ID.
+     */
+    class CatalogCrawler
+    {
+    public:
+        /**
+         * @brief Fetches one page of search results for a filter
+         *
+         * Receives the complete filter string, the 1-based page number and
+         * the page size, and returns the JSON payload or std::nullopt on failure.
+         */
+        using PageFetcher = std::function<std::optional<std::string>(
+            const std::string& filter, int page, int page_size)>;
+
+        /**
+         * @brief Receives one page of results
+         *
+         * Invoked with the inclusive ID range, the page number and the JSON
+         * payload. Calls are serialized, so the callback need not be thread-safe.
+         * Returning false stops the crawl after the current pages finish.
+         */
+        using PageCallback = std::function<bool(
+            int first_id, int last_id, int page, const std::string& json)>;
+
+        /**
+         * @brief Constructs a crawler that issues requests through a Downloader
+         *
+         * @param downloader Authenticated Downloader used for the searches
+         * @param options Crawl configuration
+         * @throws std::invalid_argument If the options describe an empty crawl
+         */
+        CatalogCrawler(Downloader& downloader, CrawlOptions options = {});
+
+        /**
+         * @brief Constructs a crawler around a custom page fetcher
+         *
+         * @param fetcher Function used to retrieve each page
+         * @param options Crawl configuration
+         * @throws std::invalid_argument If the options describe an empty crawl
+         */
+        CatalogCrawler(PageFetcher fetcher, CrawlOptions options = {});
+
+        /**
+         * @brief Crawls every range not yet finished or claimed elsewhere
+         *
+         * Blocks until all ranges available to this process have been
+         * processed, the callback returns false, or stop() is called.
+         *
+         * @param on_page Callback receiving each page of results
+         * @return CrawlStats Summary of the work done by this call
+         */
+        CrawlStats run(const PageCallback& on_page);
+
+        /**
+         * @brief Asks a running crawl to stop after the pages in flight
+         *
+         * Claims held by this process are released, so the remaining work can
+         * be resumed immediately by the next run.
+         */
+        void stop();
+
+        /**
+         * @brief Returns the number of worker threads run() will start
+         *
+         * @return int Worker count derived from the options and the range count
+         */
+        int workerCount() const;
+
+        /**
+         * @brief Builds the search filter for an inclusive ID range
+         *
+         * @param first_id First sound ID of the range
+         * @param last_id Last sound ID of the range
+         * @return std::string Filter of the form `id:[first TO last]`
+         */
+        static std::string rangeFilter(int first_id, int last_id);
+
+    private:
+        /// Inclusive bounds of one unit of work
+        struct Range
+        {
+            int first_id;
+            int last_id;
+        };
+
+        /// Outcome of processing one range
+        enum class RangeResult { Completed, Failed, Skipped, Stopped };
+
+        void worker(const PageCallback& on_page, CrawlStats& stats);
+        RangeResult crawlRange(const Range& range, const PageCallback& on_page, CrawlStats& stats);
+        bool tryClaim(const std::string& stem);
+        std::string stemFor(const Range& range) const;
+
+        /// Source of result pages
+        PageFetcher m_fetcher;
+
+        /// Crawl configuration
+        CrawlOptions m_options;
+
+        /// Every range of the job, in ID order
+        std::vector<Range> m_ranges;
+
+        /// Shared request pacing for all workers
+        RateLimiter m_limiter;
+
+        /// Identifies this process in claim files
+        std::string m_owner;
+
+        /// Next range index to examine
+        std::atomic<size_t> m_cursor{0};
+
+        /// Set by stop() or a callback returning false
+        std::atomic<bool> m_stop{false};
+
+        /// Serializes page callbacks and statistics updates
+        std::mutex m_callback_mutex;
+    };
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "array_view.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct SoundMetadata
+     * @brief Metadata fields of one sound as returned by the search endpoints
+     */
+    struct SoundMetadata
+    {
+        int64_t id = 0;
+        double duration = 0.0;
+        std::string name;
+        std::string username;
+        std::string description;
+        std::string preview_url;
+        std::vector<std::string> tags;
+    };
+
+    /**
+     * @brief Physical encoding of a column in a columnar export
+     */
+    enum class ColumnType : uint8_t
+    {
+        Int64 = 1,          ///< Fixed-width signed 64-bit integers
+        Float64 = 2,        ///< Fixed-width IEEE doubles
+        String = 3,         ///< Dictionary-encoded strings (one code per row)
+        StringList = 4      ///< Dictionary-encoded string lists (row offsets into codes)
+    };
+
+    /**
+     * @class StringDictionaryView
+     * @brief Zero-copy view of a string dictionary stored in a columnar export
+     */
+    class StringDictionaryView
+    {
+    public:
+        StringDictionaryView() = default;
+        StringDictionaryView(ArrayView<uint64_t> offsets, ArrayView<char> bytes)
+            : m_offsets(offsets), m_bytes(bytes)
+        {
+        }
+
+        /**
+         * @brief Returns the number of distinct strings
+         */
+        size_t size() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+
+        /**
+         * @brief Returns a dictionary entry, or an empty view for out-of-range codes
+         *
+         * @param code Dictionary code
+         * @return std::string_view String stored under the code
+         */
+        std::string_view operator[](uint32_t code) const;
+
+    private:
+        ArrayView<uint64_t> m_offsets;
+        ArrayView<char> m_bytes;
+    };
+
+    /**
+     * @class StringColumnView
+     * @brief Zero-copy view of a dictionary-encoded string column
+     */
+    class StringColumnView
+    {
+    public:
+        StringColumnView() = default;
+        StringColumnView(ArrayView<uint32_t> codes, StringDictionaryView dictionary)
+            : m_codes(codes), m_dictionary(dictionary)
+        {
+        }
+
+        size_t size() const { return m_codes.size(); }
+        std::string_view operator[](size_t row) const { return m_dictionary[m_codes[row]]; }
+
+        /// Per-row dictionary codes, suitable for grouping without touching the strings
+        ArrayView<uint32_t> codes() const { return m_codes; }
+        const StringDictionaryView& dictionary() const { return m_dictionary; }
+
+    private:
+        ArrayView<uint32_t> m_codes;
+        StringDictionaryView m_dictionary;
+    };
+
+    /**
+     * @class StringListColumnView
+     * @brief Zero-copy view of a dictionary-encoded string list column (e.g. tags)
+     */
+    class StringListColumnView
+    {
+    public:
+        StringListColumnView() = default;
+        StringListColumnView(
+            ArrayView<uint64_t> row_offsets,
+            ArrayView<uint32_t> codes,
+            StringDictionaryView dictionary)
+            : m_row_offsets(row_offsets), m_codes(codes), m_dictionary(dictionary)
+        {
+        }
+
+        size_t size() const { return m_row_offsets.empty() ? 0 : m_row_offsets.size() - 1; }
+
+        /**
+         * @brief Returns the dictionary codes of one row's list
+         *
+         * @param row Row index
+         * @return ArrayView<uint32_t> Codes of the row's entries
+         */
+        ArrayView<uint32_t> row(size_t row) const;
+
+        const StringDictionaryView& dictionary() const { return m_dictionary; }
+
+    private:
+        ArrayView<uint64_t> m_row_offsets;
+        ArrayView<uint32_t> m_codes;
+        StringDictionaryView m_dictionary;
+    };
+
+    /**
+     * @class ColumnarWriter
+     * @brief Accumulates sound metadata and writes it as a compact columnar file
+     *
+     * File layout (host byte order, little-endian on all supported platforms):
+     * - 8-byte magic `FSCOL001`
+     * - column sections, each aligned to 64 bytes
+     * - footer index describing every column and the location of its sections
+     * - trailer with the footer offset and size, the row count and the magic `FSCOLEND`
+     *
+     * Numeric columns are stored as plain fixed-width arrays. String columns
+     * store one 32-bit dictionary code per row plus an offset table and the
+     * concatenated distinct strings.
+     */
+    class ColumnarWriter
+    {
+    public:
+        /// Column names used for SoundMetadata fields
+        static constexpr const char* ID_COLUMN = "id";
+        static constexpr const char* DURATION_COLUMN = "duration";
+        static constexpr const char* NAME_COLUMN = "name";
+        static constexpr const char* USERNAME_COLUMN = "username";
+        static constexpr const char* DESCRIPTION_COLUMN = "description";
+        static constexpr const char* PREVIEW_COLUMN = "preview-hq-mp3";
+        static constexpr const char* TAGS_COLUMN = "tags";
+
+        /**
+         * @brief Appends one record
+         *
+         * @param record Metadata of one sound
+         */
+        void append(const SoundMetadata& record);
+
+        /**
+         * @brief Appends every entry of a search response
+         *
+         * Accepts the JSON payload returned by either searchSounds overload.
+         * Missing fields are stored as zero or empty values.
+         *
+         * @param json Search response payload
+         * @return std::optional<size_t> Number of records appended, or
+         *         std::nullopt if the payload is not a search response
+         */
+        std::optional<size_t> appendSearchResults(const std::string& json);
+
+        /**
+         * @brief Returns the number of records appended so far
+         */
+        size_t rowCount() const { return m_ids.size(); }
+
+        /**
+         * @brief Writes all appended records to a file
+         *
+         * @param path Destination filesystem path
+         * @return bool True if the file was written completely
+         */
+        bool write(const std::string& path) const;
+
+    private:
+        /// Builds a dictionary while a string column is appended
+        struct Dictionary
+        {
+            std::unordered_map<std::string, uint32_t> codes;
+            std::vector<const std::string*> entries;
+
+            uint32_t encode(const std::string& value);
+        };
+
+        std::vector<int64_t> m_ids;
+        std::vector<double> m_durations;
+
+        Dictionary m_name_dictionary;
+        std::vector<uint32_t> m_names;
+
+        Dictionary m_username_dictionary;
+        std::vector<uint32_t> m_usernames;
+
+        Dictionary m_description_dictionary;
+        std::vector<uint32_t> m_descriptions;
+
+        Dictionary m_preview_dictionary;
+        std::vector<uint32_t> m_previews;
+
+        Dictionary m_tag_dictionary;
+        std::vector<uint64_t> m_tag_offsets{0};
+        std::vector<uint32_t> m_tags;
+    };
+
+    /**
+     * @class ColumnarReader
+     * @brief Memory-maps a columnar export and exposes zero-copy column views
+     *
+     * Opening a file only maps it and parses the footer index; no column data
+     * is copied or decoded. Views stay valid while the reader is alive.
+     */
+    class ColumnarReader
+    {
+    public:
+        /**
+         * @brief Maps a columnar export and validates its footer
+         *
+         * @param path Filesystem path of the export
+         * @return bool True if the file is a well-formed export
+         */
+        bool open(const std::string& path);
+
+        /**
+         * @brief Returns the number of rows in the export
+         */
+        size_t rowCount() const { return m_row_count; }
+
+        /**
+         * @brief Returns the names of all columns in file order
+         */
+        std::vector<std::string> columnNames() const;
+
+        /**
+         * @brief Returns an Int64 column
+         *
+         * @param name Column name
+         * @return std::optional<ArrayView<int64_t>> View, or std::nullopt if no such Int64 column exists
+         */
+        std::optional<ArrayView<int64_t>> int64Column(const std::string& name) const;
+
+        /**
+         * @brief Returns a Float64 column
+         *
+         * @param name Column name
+         * @return std::optional<ArrayView<double>> View, or std::nullopt if no such Float64 column exists
+         */
+        std::optional<ArrayView<double>> float64Column(const std::string& name) const;
+
+        /**
+         * @brief Returns a dictionary-encoded string column
+         *
+         * @param name Column name
+         * @return std::optional<StringColumnView> View, or std::nullopt if no such String column exists
+         */
+        std::optional<StringColumnView> stringColumn(const std::string& name) const;
+
+        /**
+         * @brief Returns a dictionary-encoded string list column
+         *
+         * @param name Column name
+         * @return std::optional<StringListColumnView> View, or std::nullopt if no such StringList column exists
+         */
+        std::optional<StringListColumnView> stringListColumn(const std::string& name) const;
+
+    private:
+        /// Location of one section within the mapped file
+        struct Section
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        /// Footer entry describing one column
+        struct Column
+        {
+            std::string name;
+            ColumnType type;
+            std::vector<Section> sections;
+        };
+
+        const Column* findColumn(const std::string& name, ColumnType type) const;
+
+        template <typename T>
+        ArrayView<T> sectionView(const Section& section) const;
+
+        StringDictionaryView dictionaryView(const Section& offsets, const Section& bytes) const;
+
+        MappedFile m_file;
+        size_t m_row_count = 0;
+        std::vector<Column> m_columns;
+    };
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Implementation used by a DiskWriter to move buffers to disk
+     */
+    enum class DiskWriterBackend
+    {
+        /// io_uring where the kernel allows it, pwrite otherwise
+        Auto,
+
+        /// Synchronous positional writes from the calling thread
+        Pwrite,
+
+        /// Asynchronous submission through an io_uring instance (Linux only)
+        IoUring
+    };
+
+    /**
+     * @struct DiskWriterOptions
+     * @brief Configuration of a DiskWriter
+     */
+    struct DiskWriterOptions
+    {
+        /// Preferred backend
+        DiskWriterBackend backend = DiskWriterBackend::Auto;
+
+        /// Bypass the page cache with O_DIRECT where the filesystem supports it
+        bool direct_io = false;
+
+        /// Size of each staging buffer; rounded up to a multiple of 4096
+        size_t buffer_size = 256 * 1024;
+
+        /// Number of staging buffers, which bounds the writes in flight
+        unsigned buffer_count = 32;
+    };
+
+    /**
+     * @class DiskWriter
+     * @brief Shared write path that stages file data in aligned buffers and submits them to disk
+     *
+     * One DiskWriter serves any number of files being written concurrently.
+     * Data appended to a DiskWriter::File is copied into page-aligned staging
+     * buffers; each full buffer is submitted as one positional write. With
+     * the io_uring backend the buffers are registered with the kernel once
+     * and writes complete asynchronously while the network keeps filling new
+     * buffers. When every buffer is in flight, append() blocks, which bounds
+     * memory use.
+     *
+     * @note Thread-safe; each File must be used by one thread at a time
+     */
+    class DiskWriter
+    {
+    public:
+        class File;
+
+        virtual ~DiskWriter() = default;
+
+        /**
+         * @brief Returns a short name of the active backend ("pwrite" or "io_uring")
+         */
+        virtual const char* name() const = 0;
+
+        /**
+         * @brief Reports whether writes bypass the page cache
+         */
+        bool directIo() const { return m_direct_io; }
+
+        /**
+         * @brief Size of each staging buffer in bytes
+         */
+        size_t bufferSize() const { return m_buffer_size; }
+
+        /**
+         * @class File
+         * @brief Sequential writer for one open file descriptor
+         *
+         * The descriptor stays owned by the caller and must remain open
+         * until finish() returns.
+         */
+        class File
+        {
+        public:
+            /**
+             * @brief Starts writing at offset 0 of an open descriptor
+             *
+             * @param writer DiskWriter performing the writes
+             * @param fd Descriptor opened for writing
+             */
+            File(DiskWriter& writer, int fd);
+
+            /**
+             * @brief Finishes the file if finish() was not called
+             */
+            ~File();
+
+            File(const File&) = delete;
+            File& operator=(const File&) = delete;
+
+            /**
+             * @brief Appends bytes to the file
+             *
+             * @param data Bytes to append
+             * @param size Number of bytes at data
+             * @return bool False once any write of this file has failed
+             */
+            bool append(const void* data, size_t size);
+
+            /**
+             * @brief Submits buffered data and waits until every write has completed
+             *
+             * With O_DIRECT the final partial block is written padded and the
+             * file is then truncated to its exact length.
+             *
+             * @return bool True if all data reached the file
+             */
+            bool finish();
+
+            /**
+             * @brief Returns the number of bytes appended so far
+             */
+            uint64_t size() const { return m_size; }
+
+        private:
+            friend class DiskWriter;
+
+            bool submitCurrent(size_t length);
+
+            DiskWriter& m_writer;
+            int m_fd;
+            bool m_direct = false;
+            bool m_finished = false;
+            uint64_t m_size = 0;
+            uint64_t m_submitted = 0;
+            int m_buffer = -1;
+            size_t m_fill = 0;
+            std::atomic<int> m_outstanding{0};
+            std::atomic<bool> m_failed{false};
+        };
+
+    protected:
+        DiskWriter(size_t buffer_size, bool direct_io)
+            : m_buffer_size(buffer_size), m_direct_io(direct_io)
+        {
+        }
+
+        /// Returns a free staging buffer, blocking until one is available
+        virtual int acquireBuffer() = 0;
+
+        /// Returns the memory of a staging buffer
+        virtual uint8_t* bufferData(int buffer) = 0;
+
+        /// Writes a staging buffer at an offset; the backend releases the buffer when done
+        virtual void submit(File& file, int buffer, uint64_t offset, size_t length) = 0;
+
+        /// Blocks until no write of the file is in flight
+        virtual void waitIdle(File& file) = 0;
+
+        /// Records the outcome of one write of a file
+        static void complete(File& file, bool ok)
+        {
+            if (!ok)
+            {
+                file.m_failed = true;
+            }
+            file.m_outstanding.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+        /// Returns the descriptor a File writes to
+        static int fileDescriptor(const File& file) { return file.m_fd; }
+
+        /// Returns the number of writes of a File still in flight
+        static int outstanding(const File& file)
+        {
+            return file.m_outstanding.load(std::memory_order_acquire);
+        }
+
+        size_t m_buffer_size;
+        bool m_direct_io;
+    };
+
+    /**
+     * @brief Creates a DiskWriter for the requested backend
+     *
+     * DiskWriterBackend::Auto and DiskWriterBackend::IoUring fall back to the
+     * pwrite backend when io_uring is unavailable (non-Linux systems, old
+     * kernels, or sandboxes that forbid the system calls).
+     *
+     * @param options Writer configuration
+     * @return std::shared_ptr<DiskWriter> Ready-to-use writer
+     */
+    std::shared_ptr<DiskWriter> makeDiskWriter(const DiskWriterOptions& options = {});
+}
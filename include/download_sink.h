@@ -0,0 +1,174 @@
+#pragma once
+
+#include "atomic_file.h"
+#include "buffer_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class DownloadSink
+     * @brief Destination of a downloaded body, fed chunk by chunk
+     *
+     * write() receives views into the transport's receive buffer, so a sink
+     * sees each byte without an intermediate copy. The view is only valid
+     * for the duration of the call; a sink that needs the data later must
+     * copy it.
+     *
+     * A download calls begin() once, then write() for every chunk, then
+     * either end() on success or abort() on failure. Returning false from
+     * any of them cancels the transfer.
+     */
+    class DownloadSink
+    {
+    public:
+        virtual ~DownloadSink() = default;
+
+        /**
+         * @brief Called once the response announces a successful body
+         *
+         * @param content_length Size of the body, if the server sent it
+         * @return bool False to cancel the download
+         */
+        virtual bool begin(std::optional<uint64_t> /*content_length*/) { return true; }
+
+        /**
+         * @brief Receives the next part of the body
+         *
+         * @param data Bytes of the chunk, valid only during the call
+         * @param size Number of bytes at data
+         * @return bool False to cancel the download
+         */
+        virtual bool write(const char* data, size_t size) = 0;
+
+        /**
+         * @brief Called after the complete body was received (and verified)
+         *
+         * @return bool False if the sink could not complete the data
+         */
+        virtual bool end() { return true; }
+
+        /**
+         * @brief Called instead of end() when the download fails
+         *
+         * Chunks already written cannot be recalled; the sink should discard
+         * whatever it can.
+         */
+        virtual void abort() {}
+    };
+
+    /**
+     * @class FileSink
+     * @brief Writes the body to a file that appears only once it is complete
+     *
+     * The file is written under a temporary name, preallocated from
+     * Content-Length and renamed into place by end().
+     */
+    class FileSink : public DownloadSink
+    {
+    public:
+        /**
+         * @brief Prepares a sink for a destination path
+         *
+         * @param path Destination file path
+         * @param policy Durability applied when the file is committed
+         */
+        explicit FileSink(std::string path, SyncPolicy policy = SyncPolicy::PerFile);
+
+        bool begin(std::optional<uint64_t> content_length) override;
+        bool write(const char* data, size_t size) override;
+        bool end() override;
+        void abort() override;
+
+    private:
+        std::string m_path;
+        SyncPolicy m_policy;
+        AtomicFile m_file;
+        std::optional<uint64_t> m_content_length;
+    };
+
+    /**
+     * @class MemorySink
+     * @brief Collects the body in a buffer taken from a BufferPool
+     *
+     * The buffer is sized from Content-Length when it is known, so the body
+     * is copied into it once and never moved.
+     */
+    class MemorySink : public DownloadSink
+    {
+    public:
+        /**
+         * @brief Prepares a sink drawing its buffer from a pool
+         *
+         * @param pool Pool providing the buffer; must outlive begin()
+         */
+        explicit MemorySink(BufferPool& pool);
+
+        bool begin(std::optional<uint64_t> content_length) override;
+        bool write(const char* data, size_t size) override;
+        void abort() override;
+
+        /**
+         * @brief Returns the received bytes
+         */
+        const PooledBuffer& buffer() const { return m_buffer; }
+
+        /**
+         * @brief Moves the received bytes out of the sink
+         */
+        PooledBuffer take() { return std::move(m_buffer); }
+
+    private:
+        BufferPool& m_pool;
+        PooledBuffer m_buffer;
+    };
+
+    /**
+     * @class StreamSink
+     * @brief Writes the body to a std::ostream
+     */
+    class StreamSink : public DownloadSink
+    {
+    public:
+        /**
+         * @brief Prepares a sink writing to a stream
+         *
+         * @param stream Stream receiving the bytes; must outlive the download
+         */
+        explicit StreamSink(std::ostream& stream) : m_stream(stream) {}
+
+        bool write(const char* data, size_t size) override;
+        bool end() override;
+
+    private:
+        std::ostream& m_stream;
+    };
+
+    /**
+     * @class CallbackSink
+     * @brief Hands every chunk to a user function
+     */
+    class CallbackSink : public DownloadSink
+    {
+    public:
+        /// Receives a chunk view; returns false to cancel the download
+        using Callback = std::function<bool(const char* data, size_t size)>;
+
+        /**
+         * @brief Prepares a sink calling a function for each chunk
+         *
+         * @param callback Function receiving the chunks
+         */
+        explicit CallbackSink(Callback callback) : m_callback(std::move(callback)) {}
+
+        bool write(const char* data, size_t size) override;
+
+    private:
+        Callback m_callback;
+    };
+}
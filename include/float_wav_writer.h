@@ -0,0 +1,72 @@
+#pragma once
+
+#include "atomic_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class FloatWavWriter
+     * @brief Writes interleaved 32-bit float samples as a WAV file
+     *
+     * The file is written through an AtomicFile, so it only appears under
+     * its final name once commit() has patched the header with the final
+     * length. The layout is WAVE_FORMAT_IEEE_FLOAT with a fact chunk.
+     *
+     * @note Move-only; not thread-safe
+     */
+    class FloatWavWriter
+    {
+    public:
+        /**
+         * @brief Creates the temporary file and writes a provisional header
+         *
+         * @param path Final path of the file
+         * @param sample_rate Frames per second
+         * @param channels Interleaved channels per frame
+         * @return bool True if the file was created
+         */
+        bool open(const std::string& path, uint32_t sample_rate, uint16_t channels);
+
+        /**
+         * @brief Appends interleaved samples
+         *
+         * @param samples Samples to append; a multiple of the channel count
+         * @param count Number of samples (not frames) at samples
+         * @return bool False if the write failed or the file would exceed 4 GiB
+         */
+        bool write(const float* samples, size_t count);
+
+        /**
+         * @brief Completes the header and renames the file into place
+         *
+         * @param sync_first Flush the contents before renaming
+         * @return bool True if the file is now visible under its final path
+         */
+        bool commit(bool sync_first);
+
+        /**
+         * @brief Discards the file
+         */
+        void abort();
+
+        /**
+         * @brief Returns the number of frames written so far
+         */
+        uint64_t frames() const { return m_channels ? m_data_bytes / (4 * m_channels) : 0; }
+
+        /// Size of the header that precedes the samples
+        static constexpr size_t HEADER_SIZE = 58;
+
+    private:
+        bool writeHeader(bool at_start);
+
+        AtomicFile m_file;
+        uint32_t m_sample_rate = 0;
+        uint16_t m_channels = 0;
+        uint64_t m_data_bytes = 0;
+        bool m_failed = false;
+    };
+}
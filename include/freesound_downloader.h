@@ -1,11 +1,48 @@
 #pragma once
 
+#include "atomic_file.h"
+#include "buffer_pool.h"
+#include "preview_prefetcher.h"
+#include "progressive_stream.h"
+#include "write_behind.h"
+#include "zip_stream.h"
 #include <string>
 #include <optional>
+#include <cstdint>
 #include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace FreesoundDownloader 
 {
+    class SoundStore;
+    class SampleArchiveWriter;
+    class DiskWriter;
+    class DownloadSink;
+
+    /**
+     * @struct BatchOptions
+     * @brief Settings for downloading many sounds into a directory
+     */
+    struct BatchOptions
+    {
+        /// Durability applied to the files of the batch
+        SyncPolicy sync_policy = SyncPolicy::GroupCommit;
+
+        /// Files flushed together under SyncPolicy::GroupCommit
+        size_t group_size = 64;
+
+        /// Concurrent network transfers
+        size_t network_workers = 4;
+
+        /// Buffer pool and I/O threads that write the received data
+        WriteBehindOptions write_behind;
+
+        /// Check each file against the MD5 published by the API before committing it
+        bool verify_integrity = false;
+    };
+
     /**
      * @class Downloader
      * @brief Provides an interface for interacting with the Freesound API
@@ -39,7 +76,11 @@ namespace FreesoundDownloader
          * @brief Downloads a sound file by its unique identifier
          * 
          * Retrieves and saves a sound sample from Freesound using 
-         * its specific sound ID.
+         * its specific sound ID. The file is written under a temporary 
+         * name and renamed to output_path only once it is complete.
+         * The body is streamed to disk, and the file is preallocated 
+         * from Content-Length so it is laid out contiguously and a full 
+         * disk is reported before the transfer starts.
          * 
          * @param sound_id Unique identifier of the sound to download
          * @param output_path Filesystem path where the sound will be saved
@@ -50,6 +91,240 @@ namespace FreesoundDownloader
             const std::string& output_path
         );
 
+        /**
+         * @brief Downloads a sound file into a managed SoundStore
+         * 
+         * The store chooses the sharded path from the sound ID and records 
+         * the file's size, hash and format in its index. The body is 
+         * streamed into the store as it arrives.
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param store Open SoundStore receiving the file
+         * @return bool Indicates successful download operation
+         */
+        bool downloadSound(
+            int sound_id, 
+            SoundStore& store
+        );
+
+        /**
+         * @brief Downloads a sound file and appends it to a packed sample archive
+         * 
+         * The body is streamed into the archive as it arrives; the archive 
+         * stays locked from the first body byte until the entry is complete.
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param archive Open SampleArchiveWriter receiving the file
+         * @return bool Indicates successful download operation
+         */
+        bool downloadSound(
+            int sound_id, 
+            SampleArchiveWriter& archive
+        );
+
+        /**
+         * @brief Downloads a sound file into a caller-supplied sink
+         * 
+         * Each received chunk is passed to the sink as a view into the 
+         * transport's buffer, so bytes can be fed to a decoder, hasher or 
+         * socket without holding the whole body or touching the disk. 
+         * See FileSink, MemorySink, StreamSink and CallbackSink.
+         * 
+         * With integrity verification enabled the digest is checked before 
+         * DownloadSink::end(); a mismatch calls DownloadSink::abort().
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param sink Destination of the body
+         * @return bool Indicates successful download operation
+         */
+        bool downloadSound(
+            int sound_id, 
+            DownloadSink& sink
+        );
+
+        /**
+         * @brief Downloads a sound file straight into memory
+         * 
+         * The body is received into a buffer taken from the downloader's 
+         * BufferPool, sized from Content-Length so it is written once and 
+         * never moved. No temporary file is created. Releasing the buffer 
+         * returns its memory to the pool for the next download.
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @return std::optional<PooledBuffer> File contents, or std::nullopt on failure
+         */
+        std::optional<PooledBuffer> downloadToMemory(int sound_id);
+
+        /**
+         * @brief Starts streaming a sound's preview for immediate playback
+         * 
+         * Looks up the sound's preview-hq-mp3 URL and returns a 
+         * ProgressiveStream that is already filling its ring buffer, so 
+         * playback can begin after the first few kilobytes. When the URL is 
+         * already known (e.g. from the advanced searchSounds overload), 
+         * use the overload taking the URL to skip the lookup.
+         * 
+         * @param sound_id Unique identifier of the sound
+         * @param options Ring buffer and transfer settings
+         * @return std::unique_ptr<ProgressiveStream> Running stream, or nullptr if 
+         *         the preview URL could not be looked up
+         */
+        std::unique_ptr<ProgressiveStream> streamPreview(
+            int sound_id, 
+            const ProgressiveStreamOptions& options = {}
+        );
+
+        /**
+         * @brief Starts streaming a preview whose URL is already known
+         * 
+         * If the start of the preview was prefetched (see 
+         * setPreviewPrefetch), those bytes are readable at once and only 
+         * the remainder is requested.
+         * 
+         * @param preview_url Address of the preview (e.g. its preview-hq-mp3)
+         * @param options Ring buffer and transfer settings
+         * @return std::unique_ptr<ProgressiveStream> Running stream
+         */
+        std::unique_ptr<ProgressiveStream> streamPreview(
+            const std::string& preview_url, 
+            const ProgressiveStreamOptions& options = {}
+        );
+
+        /**
+         * @brief Downloads several sounds into a packed sample archive
+         * 
+         * Sounds already present in the archive are skipped, so an 
+         * interrupted batch can simply be run again.
+         * 
+         * @param sound_ids Identifiers of the sounds to download
+         * @param archive Open SampleArchiveWriter receiving the files
+         * @return std::vector<int> Identifiers that could not be downloaded
+         */
+        std::vector<int> downloadSounds(
+            const std::vector<int>& sound_ids, 
+            SampleArchiveWriter& archive
+        );
+
+        /**
+         * @brief Downloads several sounds into a directory
+         * 
+         * Each sound is saved as `<output_dir>/<id>.<ext>`, with the 
+         * extension taken from the downloaded contents. Files become 
+         * visible only once complete; with SyncPolicy::GroupCommit the 
+         * fsync calls are batched across options.group_size files.
+         * 
+         * options.network_workers transfers run at once. Received data is 
+         * handed to a write-behind stage whose I/O threads write it to 
+         * disk, so a slow disk only holds up the network once the stage's 
+         * buffer pool is exhausted.
+         * 
+         * @param sound_ids Identifiers of the sounds to download
+         * @param output_dir Directory receiving the files (created if missing)
+         * @param options Concurrency and durability settings for the batch
+         * @return std::vector<int> Identifiers that could not be downloaded
+         */
+        std::vector<int> downloadSounds(
+            const std::vector<int>& sound_ids, 
+            const std::string& output_dir,
+            const BatchOptions& options = {}
+        );
+
+        /**
+         * @brief Downloads a pack and unpacks it while it arrives
+         * 
+         * The zip archive the API serves for a pack is parsed as it is 
+         * received: each member is written, or inflated on one of 
+         * options.threads threads, as soon as its bytes are in, so 
+         * extraction overlaps the transfer and the archive itself never 
+         * touches the disk. Members keep their archive names below 
+         * output_dir and appear only once complete and checked.
+         * 
+         * @param pack_id Unique identifier of the pack to download
+         * @param output_dir Directory receiving the members (created if missing)
+         * @param options Threads, memory bound and durability of the extraction
+         * @return std::optional<std::vector<ZipMember>> Extracted files, or std::nullopt if 
+         *         the transfer failed or the archive is damaged or unsupported (members 
+         *         completed before then stay in place)
+         * @throws std::invalid_argument If options.max_pending_bytes is zero
+         */
+        std::optional<std::vector<ZipMember>> downloadPack(
+            int pack_id, 
+            const std::string& output_dir,
+            const UnzipOptions& options = {}
+        );
+
+        /**
+         * @brief Points the downloader at a different API root
+         * 
+         * Intended for mirrors, proxies and local test servers.
+         * 
+         * @param base_url API root ending in a slash (default: BASE_URL)
+         */
+        void setBaseUrl(const std::string& base_url);
+
+        /**
+         * @brief Sets the durability applied by downloadSound to a path
+         * 
+         * SyncPolicy::GroupCommit behaves like SyncPolicy::PerFile for 
+         * single downloads.
+         * 
+         * @param policy Durability policy (default: SyncPolicy::PerFile)
+         */
+        void setSyncPolicy(SyncPolicy policy);
+
+        /**
+         * @brief Enables checking single downloads against the API's MD5
+         * 
+         * The hash is computed over the received chunks while they are 
+         * written and compared before the file is renamed into place (or 
+         * handed to a SoundStore or archive), so a corrupt transfer is 
+         * rejected without reading the file back. Each verified download 
+         * costs one extra metadata request.
+         * 
+         * @param verify True to verify (default: false)
+         */
+        void setVerifyIntegrity(bool verify);
+
+        /**
+         * @brief Sets the pool that downloadToMemory takes its buffers from
+         * 
+         * Several downloaders can share one pool so that memory released 
+         * by any of them is reused by all.
+         * 
+         * @param pool Pool to use; nullptr restores a private pool
+         */
+        void setBufferPool(std::shared_ptr<BufferPool> pool);
+
+        /**
+         * @brief Routes file writes through a shared DiskWriter
+         * 
+         * Downloads saved to a path are then staged in the writer's 
+         * aligned buffers and submitted with its backend (io_uring or 
+         * pwrite) instead of plain write calls. Batch downloads write 
+         * through their own write-behind stage (see BatchOptions).
+         * 
+         * @param writer DiskWriter to use, or nullptr for plain writes
+         */
+        void setDiskWriter(std::shared_ptr<DiskWriter> writer);
+
+        /**
+         * @brief Enables prefetching the start of previews after each search
+         * 
+         * After a successful advanced searchSounds, the first 
+         * policy.prefix_bytes of the top policy.top_k previews are fetched 
+         * in the background, so streamPreview can start playing them 
+         * without waiting for the network. Prefetching yields to every 
+         * other request the downloader makes.
+         * 
+         * @param policy Prefetch settings; policy.enabled false turns prefetching off
+         */
+        void setPreviewPrefetch(const PrefetchPolicy& policy);
+
+        /**
+         * @brief Returns the active prefetcher, or nullptr if prefetching is off
+         */
+        std::shared_ptr<PreviewPrefetcher> previewPrefetcher() const { return m_prefetcher; }
+
         /**
          * @brief Performs a text-based search for sound samples
          * 
@@ -90,9 +365,126 @@ namespace FreesoundDownloader
         );
 
     private:
+        /**
+         * @brief Pauses background prefetching while the returned handle is alive
+         * 
+         * @return std::shared_ptr<void> Handle, or nullptr if prefetching is off
+         */
+        std::shared_ptr<void> foregroundScope();
+
+        /**
+         * @brief Fetches the MD5 the API publishes for a sound's original file
+         * 
+         * @param sound_id Unique identifier of the sound
+         * @return std::optional<std::string> Lowercase hexadecimal digest, or std::nullopt on failure
+         */
+        std::optional<std::string> fetchExpectedMd5(int sound_id);
+
+        /**
+         * @brief Streams the original file of a sound to callbacks
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param on_start Called once the response headers announce a 
+         *                 successful body, with its Content-Length if known
+         * @param on_data Called with each received part of the body
+         * @return bool True if the complete body was received and accepted
+         */
+        bool receiveSound(
+            int sound_id,
+            const std::function<bool(std::optional<uint64_t>)>& on_start,
+            const std::function<bool(const char*, size_t)>& on_data
+        );
+
+        /**
+         * @brief Streams a download endpoint's body to callbacks
+         * 
+         * @param url Endpoint, authenticated with the API key
+         * @param on_start Called once the response headers announce a 
+         *                 successful body, with its Content-Length if known
+         * @param on_data Called with each received part of the body
+         * @return bool True if the complete body was received and accepted
+         */
+        bool receive(
+            const std::string& url,
+            const std::function<bool(std::optional<uint64_t>)>& on_start,
+            const std::function<bool(const char*, size_t)>& on_data
+        );
+
+        /**
+         * @brief Streams the original file of a sound to callbacks, checking its MD5 if enabled
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param on_start Called once the response headers announce a 
+         *                 successful body, with its Content-Length if known
+         * @param on_data Called with each received part of the body
+         * @return bool True if the complete body was received, accepted and 
+         *              (with verification enabled) matched the API's MD5
+         */
+        bool receiveVerifiedSound(
+            int sound_id,
+            const std::function<bool(std::optional<uint64_t>)>& on_start,
+            const std::function<bool(const char*, size_t)>& on_data
+        );
+
+        /**
+         * @brief Streams the original file of a sound into an open AtomicFile
+         * 
+         * The file is preallocated from Content-Length once the response 
+         * headers arrive and truncated if the body ends short.
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param file Open AtomicFile receiving the body
+         * @param expected_md5 Digest the body must have, if it is to be verified
+         * @return bool True if the complete body was written (and matched)
+         */
+        bool streamSound(
+            int sound_id, 
+            AtomicFile& file, 
+            const std::optional<std::string>& expected_md5
+        );
+
+        /**
+         * @brief Streams a sound into `<output_dir>/<id>.<ext>` through the write-behind stage
+         * 
+         * @param sound_id Unique identifier of the sound to download
+         * @param output_dir Existing destination directory
+         * @param writer Write-behind stage performing the disk writes
+         * @param file Closed AtomicFile; open and complete on success
+         * @param expected_md5 Digest the body must have, if it is to be verified
+         * @return bool True if the complete body was written (and matched)
+         */
+        bool streamSound(
+            int sound_id, 
+            const std::string& output_dir, 
+            WriteBehindWriter& writer, 
+            AtomicFile& file,
+            const std::optional<std::string>& expected_md5
+        );
+
         /// Stores the authenticated API key for Freesound requests
         std::string m_api_key;
 
+        /// Root of every API request
+        std::string m_base_url;
+
+        /// Durability of single-file downloads
+        SyncPolicy m_sync_policy = SyncPolicy::PerFile;
+
+        /// Verify single downloads against the API's MD5
+        bool m_verify_integrity = false;
+
+        /// Source of the buffers returned by downloadToMemory
+        std::shared_ptr<BufferPool> m_buffer_pool;
+
+        /// Optional shared write path for downloaded files
+        std::shared_ptr<DiskWriter> m_disk_writer;
+
+        /// Background fetcher of preview prefixes, if enabled
+        std::shared_ptr<PreviewPrefetcher> m_prefetcher;
+
+        /// Number of search results whose previews are prefetched
+        size_t m_prefetch_top_k = 0;
+
         /// Base URL for Freesound API endpoints
         static const std::string BASE_URL;
     };
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "atomic_file.h"
+#include "audio_features.h"
+#include "audio_fingerprint.h"
+#include "resampler.h"
+#include "similarity_index.h"
+#include "waveform_peaks.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    class Downloader;
+
+    /**
+     * @enum DuplicatePolicy
+     * @brief What an IngestPipeline does with a sound whose audio is already in the fingerprint index
+     */
+    enum class DuplicatePolicy
+    {
+        /// Write the sound as usual
+        Keep,
+
+        /// Write `<id>.ref` holding the ID of the sound it duplicates instead of its audio
+        Reference
+    };
+
+    /**
+     * @struct IngestOptions
+     * @brief Configuration of an IngestPipeline
+     */
+    struct IngestOptions
+    {
+        /// Rate of the written files
+        uint32_t target_rate = 48000;
+
+        /// Filter length of the rate conversion
+        ResamplerQuality resample_quality = ResamplerQuality::Balanced;
+
+        /// Concurrent downloads
+        unsigned network_workers = 4;
+
+        /// Threads decoding received bytes
+        unsigned decode_workers = 2;
+
+        /// Threads converting decoded samples to target_rate
+        unsigned resample_workers = 2;
+
+        /// Threads writing converted samples to disk
+        unsigned write_workers = 1;
+
+        /// Blocks of one sound that may wait in front of each stage before its producer blocks
+        size_t queue_depth = 8;
+
+        /// Durability of the written files (GroupCommit behaves like PerFile)
+        SyncPolicy sync_policy = SyncPolicy::PerFile;
+
+        /// Write a waveform overview (`<id>.peaks`) next to each file
+        bool write_peaks = false;
+
+        /// Resolutions of the waveform overviews
+        PeakOptions peaks;
+
+        /// Write MFCC and spectral features (`<id>.features`) next to each file
+        bool write_features = false;
+
+        /// Analysis parameters of the features
+        FeatureOptions features;
+
+        /// Index receiving the feature embedding of each written sound (needs write_features)
+        std::shared_ptr<SimilarityIndex> similarity_index;
+
+        /// Index used to recognise duplicates, receiving the fingerprint of each written sound
+        std::shared_ptr<FingerprintIndex> fingerprint_index;
+
+        /// Analysis parameters of the fingerprints; must match those the index was built with
+        FingerprintOptions fingerprints;
+
+        /// Handling of sounds that fingerprint_index already holds a copy of
+        DuplicatePolicy duplicates = DuplicatePolicy::Keep;
+
+        /// Match score from which a sound counts as a duplicate
+        float duplicate_score = FingerprintIndex::DUPLICATE_SCORE;
+
+        /// Called from a write worker for each duplicate once its file is in place
+        std::function<void(int sound_id, const FingerprintMatch& original)> on_duplicate;
+    };
+
+    /**
+     * @class IngestPipeline
+     * @brief Downloads sounds and converts them to 32-bit float WAV at one rate on the fly
+     *
+     * Four stages are connected by bounded queues:
+     * network -> decode (WAV, AIFF, FLAC) -> resample -> write.
+     * Each stage has its own worker pool. The blocks of one sound pass
+     * through a stage in order and one at a time, while different sounds
+     * are processed in parallel, so the downloads of later sounds overlap
+     * the conversion of earlier ones. A full queue blocks its producer,
+     * which bounds memory and slows the network down to the speed of the
+     * slowest stage. The total time approaches the slower of the network
+     * and the CPU work instead of their sum, and the original file is
+     * never written to or read back from disk.
+     *
+     * @note ingest() may be called from several threads at once
+     */
+    class IngestPipeline
+    {
+    public:
+        /**
+         * @brief Starts the stage workers
+         *
+         * @param downloader Downloader performing the transfers; must outlive the pipeline
+         * @param options Rates, worker counts and queue sizes
+         * @throws std::invalid_argument If a worker count, queue_depth or target_rate is zero,
+         *         write_peaks, write_features or fingerprint_index is set with invalid options, or
+         *         similarity_index is set without write_features or does not hold feature embeddings
+         */
+        IngestPipeline(Downloader& downloader, const IngestOptions& options = {});
+
+        /**
+         * @brief Stops the stage workers
+         */
+        ~IngestPipeline();
+
+        IngestPipeline(const IngestPipeline&) = delete;
+        IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+        /**
+         * @brief Ingests sounds into a directory
+         *
+         * Each sound becomes `<output_dir>/<id>.wav`, which appears only
+         * once it is complete. With write_peaks, the resample stage also
+         * builds the sound's waveform overview from the converted samples,
+         * and `<output_dir>/<id>.peaks` is written just before the WAV file
+         * appears; write_features does the same for `<id>.features`. Once the
+         * WAV file is in place, its embedding is added to similarity_index
+         * (a sound the index already holds keeps its old vector).
+         *
+         * With fingerprint_index, each sound is fingerprinted as it is
+         * converted and looked up before it is written. A sound the index
+         * does not hold and that matches no indexed sound is added to the
+         * index. A duplicate is reported to on_duplicate; under
+         * DuplicatePolicy::Reference only `<output_dir>/<id>.ref`, holding
+         * the ID of the original as text, is written for it. Sounds in
+         * formats that cannot be decoded (Ogg, MP3) are reported as failed.
+         *
+         * @param sound_ids Identifiers of the sounds to ingest
+         * @param output_dir Directory receiving the files (created if missing)
+         * @return std::vector<int> Identifiers that could not be ingested
+         */
+        std::vector<int> ingest(const std::vector<int>& sound_ids, const std::string& output_dir);
+
+    private:
+        struct Job;
+        struct Batch;
+
+        /// Unit of work flowing between stages; the last block of a sound has end set
+        struct Block
+        {
+            std::vector<uint8_t> bytes;
+            std::vector<float> samples;
+            bool end = false;
+        };
+
+        /**
+         * @class Stage
+         * @brief Worker pool that runs the blocks of each job in order, and jobs in parallel
+         */
+        class Stage
+        {
+        public:
+            using Handler = std::function<void(const std::shared_ptr<Job>&, Block&&)>;
+
+            Stage(size_t index, unsigned workers, size_t depth, Handler handler);
+            ~Stage();
+
+            /// Queues a block of a job, blocking while the job's queue for this stage is full
+            void push(const std::shared_ptr<Job>& job, Block&& block);
+
+        private:
+            void workerLoop();
+
+            const size_t m_index;
+            const size_t m_depth;
+            Handler m_handler;
+
+            std::mutex m_mutex;
+            std::condition_variable m_work;
+            std::condition_variable m_space;
+
+            /// Jobs with queued blocks that no worker is processing
+            std::deque<std::shared_ptr<Job>> m_ready;
+            bool m_stopping = false;
+            std::vector<std::thread> m_workers;
+        };
+
+        void decodeBlock(const std::shared_ptr<Job>& job, Block&& block);
+        void resampleBlock(const std::shared_ptr<Job>& job, Block&& block);
+        void writeBlock(const std::shared_ptr<Job>& job, Block&& block);
+
+        Downloader& m_downloader;
+        const IngestOptions m_options;
+
+        std::unique_ptr<Stage> m_decode;
+        std::unique_ptr<Stage> m_resample;
+        std::unique_ptr<Stage> m_write;
+    };
+}
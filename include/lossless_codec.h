@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct LosslessOptions
+     * @brief Parameters of compressPcmFile()
+     */
+    struct LosslessOptions
+    {
+        /// Frames per independently coded block (16 to 65536)
+        uint32_t block_frames = 4096;
+
+        /// Highest predictor order tried (1 to 32)
+        unsigned max_order = 12;
+
+        /// Worker threads (0 for one per hardware thread)
+        unsigned threads = 0;
+    };
+
+    /**
+     * @brief Compresses an integer PCM WAV or AIFF file without losing a bit
+     *
+     * The samples are cut into blocks that are coded independently, and
+     * in parallel, the way FLAC codes them. Each channel of a block is
+     * predicted by an integer linear predictor, with coefficients from the
+     * block's autocorrelation. The residual is Rice coded in partitions,
+     * each with its own parameter. Stereo blocks may code the difference
+     * of the channels instead of one of them. The autocorrelation and the
+     * residual use the vectorized kernels. Header and trailing chunks are
+     * kept verbatim, so decompressPcmFile() rebuilds the original file
+     * byte for byte.
+     *
+     * @param data Contents of the file
+     * @param size Number of bytes at data
+     * @param options Block size, predictor order and threads
+     * @return std::optional<std::vector<uint8_t>> Compressed file, or std::nullopt if the file
+     *         is not 8-, 16- or 24-bit PCM with 1 to 8 channels, or would not get smaller
+     * @throws std::invalid_argument If block_frames or max_order is out of range
+     */
+    std::optional<std::vector<uint8_t>> compressPcmFile(const uint8_t* data, size_t size,
+                                                        const LosslessOptions& options = {});
+
+    /**
+     * @brief Rebuilds the original file from the output of compressPcmFile()
+     *
+     * Blocks are decoded in parallel straight into the output.
+     *
+     * @param data Contents of the compressed file
+     * @param size Number of bytes at data
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::optional<std::vector<uint8_t>> Original file, or std::nullopt if data is damaged
+     *         or was not written by compressPcmFile()
+     */
+    std::optional<std::vector<uint8_t>> decompressPcmFile(const uint8_t* data, size_t size, unsigned threads = 0);
+
+    /**
+     * @brief Tells whether bytes start like the output of compressPcmFile()
+     *
+     * @param data Leading bytes of a file
+     * @param size Number of bytes at data
+     * @return bool True if the magic number matches
+     */
+    bool isCompressedPcmFile(const uint8_t* data, size_t size);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class MappedFile
+     * @brief Read-only memory mapping of a whole file
+     *
+     * Provides the zero-copy backing store for the on-disk formats of the
+     * library (columnar exports, sample archives, index snapshots). The
+     * mapping is released when the object is destroyed or close() is called.
+     *
+     * @note Move-only
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /**
+         * @brief Maps a file into memory for reading
+         *
+         * Any previously mapped file is closed first. Empty files open
+         * successfully with a null data pointer.
+         *
+         * @param path Filesystem path of the file to map
+         * @return bool True if the file was mapped
+         */
+        bool open(const std::string& path);
+
+        /**
+         * @brief Releases the mapping
+         */
+        void close();
+
+        /**
+         * @brief Hints the kernel that the whole mapping will be read soon
+         */
+        void willNeed() const;
+
+        const uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool isOpen() const { return m_open; }
+
+    private:
+        /// Start of the mapping
+        const uint8_t* m_data = nullptr;
+
+        /// Length of the mapping in bytes
+        size_t m_size = 0;
+
+        /// Whether open() succeeded
+        bool m_open = false;
+
+#ifdef _WIN32
+        /// File mapping object handle
+        void* m_mapping = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class Md5
+     * @brief Incremental MD5, the checksum the Freesound API publishes for each sound
+     *
+     * Data is hashed as it arrives, so a download can be verified without
+     * reading the file back. updateLanes() advances several independent
+     * hashes in lockstep: their 64-byte blocks are interleaved so that one
+     * pass of the compression function serves up to LANES messages, which
+     * the compiler maps onto SIMD registers.
+     */
+    class Md5
+    {
+    public:
+        /// 128-bit digest
+        using Digest = std::array<uint8_t, 16>;
+
+        /// Messages advanced together by updateLanes()
+        static constexpr size_t LANES = 8;
+
+        Md5() { reset(); }
+
+        /**
+         * @brief Restarts the hash for a new message
+         */
+        void reset();
+
+        /**
+         * @brief Appends bytes to the message
+         *
+         * @param data Bytes to hash
+         * @param size Number of bytes at data
+         */
+        void update(const void* data, size_t size);
+
+        /**
+         * @brief Completes the hash; call reset() before reusing the object
+         *
+         * @return Digest MD5 of everything passed to update()
+         */
+        Digest finish();
+
+        /**
+         * @brief Appends data to several independent hashes at once
+         *
+         * Equivalent to calling hashers[i]->update(data[i], sizes[i]) for
+         * every i, but full blocks are compressed LANES messages at a time.
+         * Each hasher must appear at most once.
+         *
+         * @param hashers Hashes to advance
+         * @param data Bytes to append to each hash
+         * @param sizes Number of bytes at each data pointer
+         * @param count Number of hashes
+         */
+        static void updateLanes(Md5* const hashers[], const uint8_t* const data[],
+            const size_t sizes[], size_t count);
+
+        /**
+         * @brief Hashes a complete message
+         *
+         * @param data Message bytes
+         * @param size Number of bytes at data
+         * @return Digest MD5 of the message
+         */
+        static Digest hash(const void* data, size_t size);
+
+        /**
+         * @brief Formats a digest as 32 lowercase hexadecimal characters
+         */
+        static std::string toHex(const Digest& digest);
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        void compress(const uint8_t* blocks, size_t count);
+
+        /// Chaining value A, B, C, D
+        uint32_t m_state[4];
+
+        /// Bytes of an incomplete block
+        uint8_t m_buffer[BLOCK_SIZE];
+        size_t m_buffered = 0;
+
+        /// Total message length in bytes
+        uint64_t m_length = 0;
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct PrefetchPolicy
+     * @brief Which previews to fetch ahead of an audition, and how much of each
+     */
+    struct PrefetchPolicy
+    {
+        /// Prefetch after each advanced search (off by default)
+        bool enabled = false;
+
+        /// Number of leading search results whose previews are prefetched
+        size_t top_k = 5;
+
+        /// Bytes fetched from the start of each preview
+        size_t prefix_bytes = 64 * 1024;
+
+        /// Memory budget of the prefix cache
+        size_t cache_bytes = 8 * 1024 * 1024;
+    };
+
+    /**
+     * @class PreviewCache
+     * @brief Bounded in-memory LRU cache of preview prefixes, keyed by URL
+     *
+     * @note Thread-safe
+     */
+    class PreviewCache
+    {
+    public:
+        /**
+         * @brief Creates an empty cache
+         *
+         * @param max_bytes Total size of the cached prefixes
+         */
+        explicit PreviewCache(size_t max_bytes);
+
+        /**
+         * @brief Stores a prefix, evicting the least recently used ones to make room
+         *
+         * @param url Preview URL
+         * @param data Leading bytes of the preview (ignored if larger than the cache)
+         */
+        void put(const std::string& url, std::string data);
+
+        /**
+         * @brief Looks up a prefix and marks it as recently used
+         *
+         * @param url Preview URL
+         * @return std::shared_ptr<const std::string> Prefix, or nullptr if not cached
+         */
+        std::shared_ptr<const std::string> get(const std::string& url);
+
+        /**
+         * @brief Returns true if a prefix is cached, without touching its recency
+         */
+        bool contains(const std::string& url) const;
+
+        /**
+         * @brief Returns the total size of the cached prefixes
+         */
+        size_t bytes() const;
+
+    private:
+        struct Entry
+        {
+            std::string url;
+            std::shared_ptr<const std::string> data;
+        };
+
+        size_t m_max_bytes;
+        size_t m_bytes = 0;
+        mutable std::mutex m_mutex;
+
+        /// Most recently used first
+        std::list<Entry> m_entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    };
+
+    /**
+     * @class PreviewPrefetcher
+     * @brief Fetches the start of likely-to-be-auditioned previews in the background
+     *
+     * A single low-priority thread issues range requests for the first
+     * PrefetchPolicy::prefix_bytes of each queued preview and keeps them in a
+     * PreviewCache. Each call to prefetch() replaces the queue, so previews
+     * of an older search are dropped once a newer one arrives.
+     *
+     * Foreground traffic takes precedence: while any foreground() scope is
+     * alive, a running prefetch is cancelled (and queued again) and no new
+     * one starts.
+     *
+     * foreground() handles may outlive the prefetcher (a stream's transfer
+     * keeps its handle until it ends), so a prefetcher must be owned by a
+     * std::shared_ptr; its handles refer to it weakly.
+     *
+     * @note Thread-safe
+     */
+    class PreviewPrefetcher : public std::enable_shared_from_this<PreviewPrefetcher>
+    {
+    public:
+        /**
+         * @brief Starts the prefetch thread
+         *
+         * @param policy Prefix size and cache budget
+         */
+        explicit PreviewPrefetcher(const PrefetchPolicy& policy);
+
+        /**
+         * @brief Cancels outstanding prefetches and stops the thread
+         */
+        ~PreviewPrefetcher();
+
+        PreviewPrefetcher(const PreviewPrefetcher&) = delete;
+        PreviewPrefetcher& operator=(const PreviewPrefetcher&) = delete;
+
+        /**
+         * @brief Replaces the queue with previews that are not cached yet
+         *
+         * @param urls Preview URLs, most likely audition first
+         */
+        void prefetch(const std::vector<std::string>& urls);
+
+        /**
+         * @brief Marks foreground traffic until the returned handle is released
+         *
+         * @return std::shared_ptr<void> Handle; prefetching resumes once every handle is gone.
+         *         Releasing it after the prefetcher is destroyed does nothing.
+         */
+        std::shared_ptr<void> foreground();
+
+        /**
+         * @brief Waits until the queue is empty and no prefetch is running
+         *
+         * @param timeout Longest time to wait
+         * @return bool False if prefetches were still outstanding at the timeout
+         */
+        bool waitIdle(std::chrono::milliseconds timeout);
+
+        /**
+         * @brief Returns the cache holding the prefetched prefixes
+         */
+        PreviewCache& cache() { return m_cache; }
+
+        /**
+         * @brief Returns the number of prefetches cut short by foreground traffic
+         */
+        uint64_t preemptions() const { return m_preemptions.load(std::memory_order_relaxed); }
+
+    private:
+        void run();
+        bool fetchPrefix(const std::string& url);
+
+        size_t m_prefix_bytes;
+        PreviewCache m_cache;
+
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::deque<std::string> m_queue;
+        bool m_busy = false;
+        std::atomic<bool> m_stopping{false};
+
+        /// Live foreground() handles; read lock-free by the transfer's progress callback
+        std::atomic<int> m_foreground{0};
+        std::atomic<uint64_t> m_preemptions{0};
+
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct ProgressiveStreamOptions
+     * @brief Configuration of a ProgressiveStream
+     */
+    struct ProgressiveStreamOptions
+    {
+        /// Ring buffer size in bytes (rounded up to a power of two)
+        size_t capacity = 1024 * 1024;
+
+        /// Longest wait for the connection to the server
+        std::chrono::milliseconds connect_timeout{5000};
+
+        /// Leading bytes of the file already at hand (e.g. prefetched); they are
+        /// readable immediately and the transfer requests only the rest
+        std::shared_ptr<const std::string> prefix;
+
+        /// Held until the transfer ends, e.g. to keep background traffic paused
+        std::shared_ptr<void> transfer_guard;
+    };
+
+    /**
+     * @struct ProgressiveStreamStats
+     * @brief Snapshot of a ProgressiveStream's progress
+     */
+    struct ProgressiveStreamStats
+    {
+        /// Ring buffer size in bytes
+        size_t capacity = 0;
+
+        /// Bytes received but not yet read
+        size_t fill = 0;
+
+        /// Bytes received from the network so far
+        uint64_t bytes_received = 0;
+
+        /// Bytes handed to the consumer so far
+        uint64_t bytes_read = 0;
+
+        /// Size of the whole body, if the server announced it
+        std::optional<uint64_t> content_length;
+
+        /// tryRead() calls that found fewer bytes than requested before the end of the stream
+        uint64_t underruns = 0;
+
+        /// Times the transfer paused because the consumer had not made room
+        uint64_t producer_stalls = 0;
+
+        /// Time from construction to the first body byte, once it has arrived
+        std::optional<std::chrono::microseconds> time_to_first_byte;
+    };
+
+    /**
+     * @class ProgressiveStream
+     * @brief Plays a file while it downloads by filling a bounded ring buffer
+     *
+     * A background thread starts the transfer on construction and copies the
+     * body into a single-producer/single-consumer ring buffer as it arrives.
+     * The consumer reads from the ring while the transfer continues, so
+     * playback of a preview can start as soon as the first few kilobytes are
+     * in. When the ring is full the transfer pauses until the consumer makes
+     * room, so memory stays at the ring's capacity however long the file is.
+     * Only the producer waits on the other side: a paused transfer polls for
+     * free space with a short back-off, so reading never has to wake it.
+     *
+     * The stream delivers the raw file bytes (e.g. MP3 frames); decoding is
+     * left to the consumer.
+     *
+     * @note One thread may read at a time; stats() may be called from any thread
+     */
+    class ProgressiveStream
+    {
+    public:
+        /**
+         * @brief Starts streaming a URL
+         *
+         * @param url Address of the file (e.g. a sound's preview-hq-mp3)
+         * @param options Ring buffer and transfer settings
+         */
+        explicit ProgressiveStream(std::string url, const ProgressiveStreamOptions& options = {});
+
+        /**
+         * @brief Cancels the transfer and waits for its thread
+         */
+        ~ProgressiveStream();
+
+        ProgressiveStream(const ProgressiveStream&) = delete;
+        ProgressiveStream& operator=(const ProgressiveStream&) = delete;
+
+        /**
+         * @brief Copies out whatever is buffered, without waiting
+         *
+         * Suitable for an audio callback: it takes no lock and makes no
+         * system call. Returning fewer bytes than requested before the end
+         * of the stream is counted as an underrun.
+         *
+         * @param dest Destination of the bytes
+         * @param size Maximum number of bytes to copy
+         * @return size_t Number of bytes copied
+         */
+        size_t tryRead(void* dest, size_t size);
+
+        /**
+         * @brief Copies out size bytes, waiting for the network as needed
+         *
+         * @param dest Destination of the bytes
+         * @param size Number of bytes to copy
+         * @return size_t Number of bytes copied; less than size only at the end
+         *         of the stream or on failure
+         */
+        size_t read(void* dest, size_t size);
+
+        /**
+         * @brief Waits until a number of bytes is buffered or the transfer ends
+         *
+         * Typically used to prebuffer a few kilobytes before starting playback.
+         *
+         * @param bytes Bytes that should be buffered (capped at the capacity)
+         * @param timeout Longest time to wait
+         * @return bool True if the bytes are buffered or the transfer has ended
+         */
+        bool waitForData(size_t bytes, std::chrono::milliseconds timeout);
+
+        /**
+         * @brief Returns the number of bytes that can be read without waiting
+         */
+        size_t available() const;
+
+        /**
+         * @brief Returns true once the whole body has been received
+         */
+        bool complete() const { return m_complete.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Returns true if the transfer failed or was cancelled
+         */
+        bool failed() const { return m_failed.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Returns true once the transfer has ended and every byte has been read
+         */
+        bool atEnd() const { return (complete() || failed()) && available() == 0; }
+
+        /**
+         * @brief Stops the transfer; bytes already buffered remain readable
+         */
+        void cancel();
+
+        /**
+         * @brief Returns the current fill level and transfer statistics
+         */
+        ProgressiveStreamStats stats() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void transfer(std::shared_ptr<void> guard);
+        bool produce(const char* data, size_t size);
+        size_t consume(uint8_t* dest, size_t size);
+        void finishTransfer(bool ok);
+        void wakeConsumer();
+
+        std::string m_url;
+        std::chrono::milliseconds m_connect_timeout;
+
+        /// Bytes placed in the ring before the transfer started
+        uint64_t m_prefix_size = 0;
+        Clock::time_point m_started;
+
+        /// Ring storage; positions are running byte counts masked into it
+        std::unique_ptr<uint8_t[]> m_ring;
+        size_t m_capacity;
+        std::atomic<uint64_t> m_write_position{0};
+        std::atomic<uint64_t> m_read_position{0};
+
+        std::atomic<bool> m_complete{false};
+        std::atomic<bool> m_failed{false};
+        std::atomic<bool> m_cancelled{false};
+
+        /// Content-Length, or UNKNOWN_LENGTH
+        static constexpr uint64_t UNKNOWN_LENGTH = ~uint64_t(0);
+        std::atomic<uint64_t> m_content_length{UNKNOWN_LENGTH};
+
+        /// Microseconds to the first body byte plus one; 0 until it arrives
+        std::atomic<int64_t> m_first_byte_us{0};
+        std::atomic<uint64_t> m_underruns{0};
+        std::atomic<uint64_t> m_producer_stalls{0};
+
+        /// Lets read() and waitForData() sleep until the transfer delivers more
+        std::mutex m_wait_mutex;
+        std::condition_variable m_data_available;
+        std::atomic<int> m_consumer_waiting{0};
+
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class RateLimiter
+     * @brief Paces API requests so that a group of threads stays under a request budget
+     *
+     * Freesound enforces per-key request limits (60 requests per minute for
+     * standard keys). A single RateLimiter is shared by every thread issuing
+     * requests with the same key; each call to acquire() reserves the next
+     * free slot and sleeps until that slot is reached.
+     *
+     * @note Thread-safe
+     */
+    class RateLimiter
+    {
+    public:
+        /**
+         * @brief Constructs a limiter for the given request budget
+         *
+         * @param requests_per_minute Maximum sustained request rate
+         * @param burst Number of requests that may be issued back-to-back
+         *              after an idle period (default: 1)
+         * @throws std::invalid_argument If requests_per_minute or burst is not positive
+         */
+        explicit RateLimiter(int requests_per_minute, int burst = 1);
+
+        /**
+         * @brief Blocks until the caller may issue one request
+         */
+        void acquire();
+
+        /**
+         * @brief Returns the spacing between two consecutive requests
+         *
+         * @return std::chrono::nanoseconds Minimum interval at the sustained rate
+         */
+        std::chrono::nanoseconds interval() const { return m_interval; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /// Guards m_next_slot
+        std::mutex m_mutex;
+
+        /// Minimum spacing between requests at the sustained rate
+        std::chrono::nanoseconds m_interval;
+
+        /// How far m_next_slot may lag behind the current time
+        std::chrono::nanoseconds m_burst_window;
+
+        /// Earliest time at which the next request may start
+        Clock::time_point m_next_slot;
+    };
+}
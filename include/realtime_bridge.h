@@ -0,0 +1,215 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include "spsc_queue.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    class Downloader;
+
+    /**
+     * @struct RealtimeBridgeOptions
+     * @brief Configuration of a RealtimeBridge
+     */
+    struct RealtimeBridgeOptions
+    {
+        /// Background threads running searches and downloads
+        unsigned workers = 2;
+
+        /// Downloaded sounds that may be queued for or held by the audio thread at once
+        size_t max_ready = 32;
+    };
+
+    /**
+     * @struct ReadySound
+     * @brief A downloaded sound handed to the audio thread
+     *
+     * The bytes stay valid until the sound is passed to RealtimeBridge::release().
+     */
+    struct ReadySound
+    {
+        /// Identifier returned by RealtimeBridge::requestDownload()
+        uint64_t request = 0;
+
+        /// Freesound sound ID
+        int sound_id = 0;
+
+        /// File contents
+        const uint8_t* data = nullptr;
+
+        /// Number of bytes at data
+        size_t size = 0;
+
+        /// Bridge-internal slot holding the buffer
+        uint32_t slot = 0;
+    };
+
+    /**
+     * @struct BridgeCompletion
+     * @brief Outcome of a background request, delivered on the message thread
+     */
+    struct BridgeCompletion
+    {
+        enum class Kind
+        {
+            Download,
+            Search
+        };
+
+        /// Identifier returned when the request was made
+        uint64_t request = 0;
+
+        Kind kind = Kind::Download;
+
+        /// Sound ID of a download
+        int sound_id = 0;
+
+        /// True if the request succeeded
+        bool ok = false;
+
+        /// Size of a downloaded file in bytes
+        size_t size = 0;
+
+        /// JSON results of a search
+        std::string results;
+    };
+
+    /**
+     * @class RealtimeBridge
+     * @brief Moves Downloader work off an audio thread behind wait-free queues
+     *
+     * Three threads take part:
+     * - The message (UI) thread issues requests and calls dispatch(), which
+     *   reports completions and hands finished downloads to the audio thread.
+     * - Background workers run the blocking searches and downloads.
+     * - The audio thread calls pollReady() to take finished sounds and
+     *   release() to give their memory back.
+     *
+     * pollReady() and release() only touch single-producer/single-consumer
+     * queues: they never allocate, lock or make a system call, and finish in
+     * a bounded number of steps. Buffers are freed on the message thread.
+     *
+     * @note requestDownload(), requestSearch() and dispatch() must be called
+     *       from one (message) thread; pollReady() and release() from one
+     *       (audio) thread
+     */
+    class RealtimeBridge
+    {
+    public:
+        /// Called on a worker thread when completions are waiting for dispatch()
+        using Notifier = std::function<void()>;
+
+        /// Receives each completion on the message thread
+        using CompletionHandler = std::function<void(const BridgeCompletion&)>;
+
+        /**
+         * @brief Starts the background workers
+         *
+         * @param downloader Downloader performing the requests; must outlive the bridge
+         * @param options Worker count and queue sizes
+         * @param notifier Optional hook used to schedule dispatch() on the message
+         *                 thread (e.g. by posting an async message)
+         * @throws std::invalid_argument If workers or max_ready is zero
+         */
+        RealtimeBridge(Downloader& downloader, const RealtimeBridgeOptions& options = {},
+            Notifier notifier = nullptr);
+
+        /**
+         * @brief Stops the workers after their current request
+         *
+         * The audio thread must no longer use sounds obtained from the bridge.
+         */
+        ~RealtimeBridge();
+
+        RealtimeBridge(const RealtimeBridge&) = delete;
+        RealtimeBridge& operator=(const RealtimeBridge&) = delete;
+
+        /**
+         * @brief Queues a download into memory (message thread)
+         *
+         * @param sound_id Unique identifier of the sound to download
+         * @return uint64_t Request identifier reported with the result
+         */
+        uint64_t requestDownload(int sound_id);
+
+        /**
+         * @brief Queues a text search (message thread)
+         *
+         * @param query Text-based search term
+         * @param page_size Number of results
+         * @return uint64_t Request identifier reported with the result
+         */
+        uint64_t requestSearch(const std::string& query, int page_size = 15);
+
+        /**
+         * @brief Reports finished requests and feeds the audio thread (message thread)
+         *
+         * Also frees the buffers the audio thread has released. Downloads
+         * that do not fit in the audio queue yet are retried on the next call.
+         *
+         * @param handler Called for each completion; may be empty
+         * @return size_t Number of completions reported
+         */
+        size_t dispatch(const CompletionHandler& handler);
+
+        /**
+         * @brief Takes the next downloaded sound (audio thread, wait-free)
+         *
+         * @param sound Receives the sound
+         * @return bool False if no sound is ready
+         */
+        bool pollReady(ReadySound& sound);
+
+        /**
+         * @brief Returns a sound's memory for freeing on the message thread (audio thread, wait-free)
+         *
+         * @param sound Sound obtained from pollReady()
+         */
+        void release(const ReadySound& sound);
+
+    private:
+        /// Finished request waiting for dispatch()
+        struct Finished
+        {
+            BridgeCompletion completion;
+            PooledBuffer buffer;
+        };
+
+        void submit(std::function<Finished()> job);
+        void workerLoop();
+        bool deliver(Finished& finished);
+
+        Downloader& m_downloader;
+        Notifier m_notifier;
+        uint64_t m_next_request = 1;
+
+        /// Requests waiting for a worker
+        std::mutex m_job_mutex;
+        std::condition_variable m_job_ready;
+        std::deque<std::function<Finished()>> m_jobs;
+        bool m_stopping = false;
+        std::vector<std::thread> m_workers;
+
+        /// Results waiting for dispatch(); guarded by m_finished_mutex
+        std::mutex m_finished_mutex;
+        std::deque<Finished> m_finished;
+
+        /// Message-thread state: buffers lent to the audio thread and the free slots
+        std::vector<PooledBuffer> m_slots;
+        std::vector<uint32_t> m_free_slots;
+        std::deque<Finished> m_undelivered;
+
+        /// Message thread to audio thread, and back
+        SpscQueue<ReadySound> m_ready;
+        SpscQueue<uint32_t> m_released;
+    };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Trade-off between conversion quality and speed
+     */
+    enum class ResamplerQuality
+    {
+        /// 8 zero crossings, 90% passband; several times faster, for previews and analysis
+        Fast,
+
+        /// 16 zero crossings, 95% passband; transparent for playback
+        Balanced,
+
+        /// 48 zero crossings, 97% passband; for masters that are converted once
+        Best
+    };
+
+    /**
+     * @class Resampler
+     * @brief Streaming polyphase sample-rate converter for interleaved float audio
+     *
+     * Band-limited interpolation with a Kaiser-windowed sinc kernel. The
+     * conversion ratio is reduced to L/M, and for the usual ratios (every
+     * pair of rates between 8 kHz and 192 kHz that Freesound serves) one
+     * filter per output phase is computed up front, so every output frame
+     * costs one vectorized dot product per channel. Filter banks are
+     * shared by every resampler with the same ratio and quality. Unusual
+     * ratios with too many phases fall back to interpolating the kernel
+     * from an oversampled table at the exact position of each frame. When
+     * downsampling, the cutoff moves down to the output Nyquist frequency
+     * so nothing aliases.
+     *
+     * Input may arrive in blocks of any size; the output is identical to
+     * converting the whole signal at once.
+     *
+     * @note Not thread-safe; each resampler is used by one thread at a time
+     */
+    class Resampler
+    {
+    public:
+        /**
+         * @brief Prepares a converter
+         *
+         * @param channels Interleaved channels per frame
+         * @param input_rate Rate of the samples passed to process()
+         * @param output_rate Rate of the samples produced
+         * @param quality Filter length and passband
+         * @throws std::invalid_argument If any argument is zero
+         */
+        Resampler(unsigned channels, uint32_t input_rate, uint32_t output_rate,
+                  ResamplerQuality quality = ResamplerQuality::Balanced);
+
+        /**
+         * @brief Converts the next block of frames
+         *
+         * Output lags the input by the kernel's half width; flush() releases
+         * the remainder.
+         *
+         * @param input Interleaved frames following those passed before
+         * @param frames Number of frames at input
+         * @param output Receives the converted frames (appended)
+         */
+        void process(const float* input, size_t frames, std::vector<float>& output);
+
+        /**
+         * @brief Produces the frames still held back once the input has ended
+         *
+         * @param output Receives the converted frames (appended)
+         */
+        void flush(std::vector<float>& output);
+
+        /**
+         * @brief Returns the number of frames produced so far
+         */
+        uint64_t outputFrames() const { return m_output_frames; }
+
+        /**
+         * @brief Returns whether a precomputed filter bank serves this ratio
+         */
+        bool polyphase() const;
+
+    private:
+        struct Filter;
+
+        static std::shared_ptr<const Filter> filterFor(ResamplerQuality quality, uint32_t phases, uint32_t step);
+        void produce(std::vector<float>& output, uint64_t limit);
+        const float* weightsFor(uint32_t phase);
+
+        const unsigned m_channels;
+        const uint32_t m_input_rate;
+        const uint32_t m_output_rate;
+
+        /// Output frames advance the input position by m_step / m_phases frames
+        uint32_t m_phases = 1;
+        uint32_t m_step = 1;
+
+        /// Kernel shared with other resamplers of the same ratio and quality
+        std::shared_ptr<const Filter> m_filter;
+
+        /// Input frame at or before the next output frame, and the output's phase after it
+        int64_t m_centre = 0;
+        uint32_t m_phase = 0;
+
+        /// Input frames still needed per channel, starting at absolute frame m_history_start
+        std::vector<std::vector<float>> m_history;
+        int64_t m_history_start = 0;
+
+        uint64_t m_input_frames = 0;
+        uint64_t m_output_frames = 0;
+
+        /// Kernel weights of the output frame being computed (table fallback only)
+        std::vector<float> m_weights;
+    };
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "array_view.h"
+#include "audio_format.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct ArchiveEntry
+     * @brief One sound stored in a packed sample archive
+     */
+    struct ArchiveEntry
+    {
+        /// Freesound sound ID
+        int sound_id = 0;
+
+        /// Container format of the stored file
+        AudioFormat format = AudioFormat::Unknown;
+
+        /// File contents, pointing into the archive mapping
+        ArrayView<uint8_t> data;
+    };
+
+    /**
+     * @class SampleArchiveWriter
+     * @brief Appends many sounds into a single packed archive file
+     *
+     * Archive layout (host byte order, little-endian on all supported platforms):
+     * - 64-byte file header with the magic `FSPAK001` and the data alignment
+     * - for each sound, a 32-byte entry header followed by the file contents,
+     *   which start on a multiple of the data alignment
+     * - a trailing index of (sound ID, offset, length, format) records sorted
+     *   by sound ID, and a 32-byte trailer ending in the magic `FSPAKEND`
+     *
+     * Reopening an existing archive strips the trailing index and continues
+     * appending. If the index is missing because a previous writer crashed,
+     * it is rebuilt from the entry headers.
+     *
+     * @note Thread-safe; appends from several threads are serialized
+     */
+    class SampleArchiveWriter
+    {
+    public:
+        /**
+         * @class EntryWriter
+         * @brief Appends one sound whose contents arrive in parts
+         *
+         * The archive stays locked from construction until commit() or
+         * destruction, so other appends wait for the entry to complete.
+         * The entry header is written last; an entry that is given up on,
+         * or cut short by a crash, is never seen by readers or recovery.
+         */
+        class EntryWriter
+        {
+        public:
+            /**
+             * @brief Locks the archive and starts an entry at its end
+             *
+             * @param archive Open archive receiving the sound
+             * @param sound_id Freesound sound ID
+             */
+            EntryWriter(SampleArchiveWriter& archive, int sound_id);
+
+            /**
+             * @brief Discards the entry unless commit() succeeded and unlocks the archive
+             */
+            ~EntryWriter();
+
+            EntryWriter(const EntryWriter&) = delete;
+            EntryWriter& operator=(const EntryWriter&) = delete;
+
+            /**
+             * @brief Appends the next part of the contents
+             *
+             * @param data Bytes following those of the previous call
+             * @param size Number of bytes at data
+             * @return bool True if the bytes were written
+             */
+            bool append(const uint8_t* data, size_t size);
+
+            /**
+             * @brief Writes the entry header and records the entry in the index
+             *
+             * Appending an ID that is already present supersedes the earlier entry.
+             *
+             * @return bool True if the entry is complete
+             */
+            bool commit();
+
+        private:
+            SampleArchiveWriter& m_archive;
+            std::unique_lock<std::mutex> m_lock;
+            int m_sound_id;
+            uint64_t m_data_offset = 0;
+            uint64_t m_size = 0;
+            std::vector<uint8_t> m_head;
+            bool m_failed = false;
+            bool m_committed = false;
+        };
+
+        /**
+         * @brief Constructs a writer with the given data alignment
+         *
+         * @param alignment Alignment of each file's contents in bytes; the
+         *                  default page size lets readers map single entries
+         * @throws std::invalid_argument If alignment is not a power of two of at least 8
+         */
+        explicit SampleArchiveWriter(size_t alignment = 4096);
+
+        /**
+         * @brief Finishes the archive if it is still open
+         */
+        ~SampleArchiveWriter();
+
+        SampleArchiveWriter(const SampleArchiveWriter&) = delete;
+        SampleArchiveWriter& operator=(const SampleArchiveWriter&) = delete;
+
+        /**
+         * @brief Creates an archive, or reopens an existing one for appending
+         *
+         * @param path Filesystem path of the archive
+         * @return bool True if the archive is ready for appending
+         */
+        bool open(const std::string& path);
+
+        /**
+         * @brief Appends one sound
+         *
+         * Appending an ID that is already present supersedes the earlier entry.
+         *
+         * @param sound_id Freesound sound ID
+         * @param data File contents
+         * @param size Number of bytes at data
+         * @return bool True if the entry was written
+         */
+        bool append(int sound_id, const uint8_t* data, size_t size);
+
+        /**
+         * @brief Reports whether a sound is already in the archive
+         *
+         * @param sound_id Freesound sound ID
+         * @return bool True if an entry exists for the ID
+         */
+        bool contains(int sound_id) const;
+
+        /**
+         * @brief Returns the number of distinct sounds in the archive
+         */
+        size_t entryCount() const;
+
+        /**
+         * @brief Writes the trailing index and closes the archive
+         *
+         * @return bool True if the index and trailer were written
+         */
+        bool finish();
+
+    private:
+        /// Index record kept in memory until finish()
+        struct IndexRecord
+        {
+            uint64_t offset;
+            uint64_t length;
+            AudioFormat format;
+        };
+
+        bool recover(const std::string& path, uint64_t file_size);
+
+        /// Alignment of file contents within the archive
+        size_t m_alignment;
+
+        /// Filesystem path of the archive being written
+        std::string m_path;
+
+        /// Archive being written
+        std::ofstream m_out;
+
+        /// End of the last complete entry
+        uint64_t m_position = 0;
+
+        /// Latest entry for every sound ID
+        std::unordered_map<int, IndexRecord> m_index;
+
+        /// Serializes appends; held by an EntryWriter for its lifetime
+        mutable std::mutex m_mutex;
+    };
+
+    /**
+     * @class SampleArchiveReader
+     * @brief Memory-maps a finished sample archive and serves zero-copy entries
+     *
+     * Opening costs a single open() and mmap(); lookups binary-search the
+     * sorted index inside the mapping.
+     */
+    class SampleArchiveReader
+    {
+    public:
+        /**
+         * @brief Maps an archive and validates its trailer and index
+         *
+         * @param path Filesystem path of the archive
+         * @return bool True if the archive is complete and well-formed
+         */
+        bool open(const std::string& path);
+
+        /**
+         * @brief Returns the number of sounds in the archive
+         */
+        size_t size() const { return m_entry_count; }
+
+        /**
+         * @brief Returns the entry at a position of the ID-sorted index
+         *
+         * @param index Position in the index, less than size()
+         * @return ArchiveEntry Entry at that position
+         */
+        ArchiveEntry entry(size_t index) const;
+
+        /**
+         * @brief Looks up a sound by ID
+         *
+         * @param sound_id Freesound sound ID
+         * @return std::optional<ArchiveEntry> Entry, or std::nullopt if absent
+         */
+        std::optional<ArchiveEntry> find(int sound_id) const;
+
+        /**
+         * @brief Asks the kernel to start reading the whole archive in the background
+         */
+        void prefetch() const { m_file.willNeed(); }
+
+    private:
+        MappedFile m_file;
+        const uint8_t* m_index = nullptr;
+        size_t m_entry_count = 0;
+    };
+}
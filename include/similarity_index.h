@@ -0,0 +1,216 @@
+#pragma once
+
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct SimilarityIndexOptions
+     * @brief Shape and search effort of a SimilarityIndex
+     */
+    struct SimilarityIndexOptions
+    {
+        /// Length of every vector (AudioFeatures::EMBEDDING_SIZE for feature embeddings)
+        uint32_t dimensions = 30;
+
+        /// Links per node on the upper layers; the bottom layer keeps twice as many
+        uint32_t max_links = 16;
+
+        /// Candidates kept while linking a new vector (higher builds a better graph, more slowly)
+        uint32_t construction_breadth = 200;
+
+        /// Candidates kept while answering a query unless the query asks for more
+        uint32_t search_breadth = 64;
+
+        /// Seed of the layer assignment, which makes builds reproducible
+        uint32_t seed = 42;
+    };
+
+    /**
+     * @struct SimilarSound
+     * @brief One result of a SimilarityIndex query
+     */
+    struct SimilarSound
+    {
+        int sound_id;
+
+        /// Euclidean distance to the query vector
+        float distance;
+    };
+
+    /**
+     * @class SimilarityIndex
+     * @brief Approximate nearest-neighbour search over sound vectors (HNSW)
+     *
+     * Vectors are linked into a hierarchical navigable small-world graph:
+     * every vector is a node of the bottom layer, and exponentially fewer of
+     * them also appear on each layer above. A query descends greedily
+     * through the sparse upper layers and then explores the bottom layer
+     * around the closest node found, so it visits a few thousand nodes even
+     * among millions of vectors. Distances go through the vectorized
+     * squaredDistance() kernel.
+     *
+     * Vectors can be inserted at any time, e.g. by an IngestPipeline as it
+     * writes each sound's features. save() writes the graph as fixed-size
+     * arrays without pointers; open() maps such a file and queries run on
+     * the mapping directly. The first insert() after open() copies the
+     * graph into memory.
+     *
+     * @note Thread-safe; queries run concurrently, inserts one at a time
+     */
+    class SimilarityIndex
+    {
+    public:
+        /**
+         * @brief Creates an empty index
+         *
+         * @param options Dimensions, graph degree and search effort
+         * @throws std::invalid_argument If dimensions, construction_breadth or search_breadth is zero,
+         *         or max_links is less than 2
+         */
+        explicit SimilarityIndex(const SimilarityIndexOptions& options = {});
+
+        SimilarityIndex(const SimilarityIndex&) = delete;
+        SimilarityIndex& operator=(const SimilarityIndex&) = delete;
+
+        /**
+         * @brief Adds the vector of a sound
+         *
+         * @param sound_id Freesound sound ID
+         * @param vector dimensions() values
+         * @return bool True if added; false if the sound is already indexed or the index is full
+         */
+        bool insert(int sound_id, const float* vector);
+
+        /**
+         * @brief Finds the sounds whose vectors are closest to a vector
+         *
+         * @param vector dimensions() values
+         * @param count Maximum number of results
+         * @param breadth Candidates to keep during the search (0 for search_breadth; at least count is used)
+         * @return std::vector<SimilarSound> Results, closest first
+         */
+        std::vector<SimilarSound> query(const float* vector, size_t count, size_t breadth = 0) const;
+
+        /**
+         * @brief Finds the sounds most similar to an indexed sound ("more like this")
+         *
+         * @param sound_id Indexed sound
+         * @param count Maximum number of results, not counting the sound itself
+         * @param breadth Candidates to keep during the search (0 for search_breadth)
+         * @return std::vector<SimilarSound> Results, closest first; empty if the sound is not indexed
+         */
+        std::vector<SimilarSound> similarTo(int sound_id, size_t count, size_t breadth = 0) const;
+
+        /**
+         * @brief Checks whether a sound is indexed
+         *
+         * @param sound_id Freesound sound ID
+         * @return bool True if insert() added it or the opened file contains it
+         */
+        bool contains(int sound_id) const;
+
+        /**
+         * @brief Writes the index to a file that open() can map
+         *
+         * @param path Destination
+         * @param sync_first Flush the file to stable storage before it appears
+         * @return bool True if the file was written
+         */
+        bool save(const std::string& path, bool sync_first = false) const;
+
+        /**
+         * @brief Replaces the contents of the index with a file written by save()
+         *
+         * The file is mapped rather than read, and its options replace the
+         * ones given to the constructor. Every link is checked once, so a
+         * damaged file is rejected instead of steering a query out of bounds.
+         *
+         * @param path Index file
+         * @return bool True if the file was opened; false leaves the index unchanged
+         */
+        bool open(const std::string& path);
+
+        size_t size() const;
+        size_t dimensions() const;
+
+    private:
+        /// Per-search marks of the nodes already visited; recycled between searches
+        struct VisitedSet
+        {
+            std::vector<uint32_t> marks;
+            uint32_t epoch = 0;
+        };
+
+        using Candidate = std::pair<float, uint32_t>;
+
+        size_t linkSlots(uint32_t layer) const;
+        const uint32_t* links(uint32_t node, uint32_t layer) const;
+        uint32_t* mutableLinks(uint32_t node, uint32_t layer);
+        const float* vectorOf(uint32_t node) const;
+        bool findNode(int sound_id, uint32_t& node) const;
+        uint32_t randomLevel();
+        void materialise();
+        void refreshViews();
+
+        uint32_t descend(const float* vector, uint32_t target_layer) const;
+        std::vector<Candidate> searchLayer(const float* vector, uint32_t entry, size_t breadth, uint32_t layer) const;
+        std::vector<uint32_t> selectNeighbours(const std::vector<Candidate>& candidates, size_t limit) const;
+        void link(uint32_t from, uint32_t to, uint32_t layer);
+        std::vector<SimilarSound> search(const float* vector, size_t count, size_t breadth, uint32_t exclude) const;
+
+        std::unique_ptr<VisitedSet> acquireVisited() const;
+        void releaseVisited(std::unique_ptr<VisitedSet> visited) const;
+
+        SimilarityIndexOptions m_options;
+
+        mutable std::shared_mutex m_mutex;
+
+        size_t m_count = 0;
+        uint32_t m_max_level = 0;
+        uint32_t m_entry = 0;
+
+        /// Length of the upper-layer link array
+        size_t m_upper_words = 0;
+
+        /// Where the graph is read from: the mapping after open(), the vectors below otherwise
+        const float* m_vector_data = nullptr;
+        const int32_t* m_id_data = nullptr;
+        const uint32_t* m_level_data = nullptr;
+        const uint32_t* m_upper_offset_data = nullptr;
+        const uint32_t* m_bottom_link_data = nullptr;
+        const uint32_t* m_upper_link_data = nullptr;
+
+        /// (sound ID, node) pairs sorted by ID; only used while reading from the mapping
+        const uint32_t* m_id_table = nullptr;
+
+        MappedFile m_file;
+        bool m_mapped = false;
+
+        std::vector<float> m_vectors;
+        std::vector<int32_t> m_ids;
+        std::vector<uint32_t> m_levels;
+
+        /// Start of each node's upper-layer links in m_upper_links (layer l at + (l - 1) * slots)
+        std::vector<uint32_t> m_upper_offsets;
+
+        /// Per node and layer: link count followed by that many slots
+        std::vector<uint32_t> m_bottom_links;
+        std::vector<uint32_t> m_upper_links;
+
+        std::unordered_map<int, uint32_t> m_nodes;
+        std::mt19937 m_random;
+
+        mutable std::mutex m_visited_mutex;
+        mutable std::vector<std::unique_ptr<VisitedSet>> m_visited_pool;
+    };
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "atomic_file.h"
+#include "audio_format.h"
+#include "lossless_codec.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct StoreEntry
+     * @brief Index record of one sound held in a SoundStore
+     */
+    struct StoreEntry
+    {
+        /// Freesound sound ID
+        int sound_id = 0;
+
+        /// File size in bytes
+        uint64_t size = 0;
+
+        /// FNV-1a 64 hash of the file contents (non-cryptographic, for change detection)
+        uint64_t content_hash = 0;
+
+        /// Container format detected from the file contents
+        AudioFormat format = AudioFormat::Unknown;
+
+        /// Kept on disk as the output of compressPcmFile(); size and content_hash describe the original
+        bool compressed = false;
+    };
+
+    /**
+     * @class SoundStore
+     * @brief Managed on-disk library with sharded directories and a compact ID index
+     *
+     * Sounds are placed at `<root>/<xx>/<yy>/<id>.<ext>`, where `xx/yy` are
+     * derived from a hash of the sound ID. The 65536 shard directories keep
+     * every directory small even with tens of millions of files.
+     *
+     * The index maps each ID to its size, content hash and format in two
+     * parts. A snapshot (`<root>/index.snap`) holds fixed-size records
+     * sorted by ID behind a checksummed header; it contains no pointers, so
+     * open() simply maps it and verifies the checksum, and lookups
+     * binary-search the mapping. Changes made since the snapshot are appended
+     * to a delta log (`<root>/index.bin`, 32 bytes per record) and replayed
+     * into a small in-memory overlay. compact() folds the overlay into a new
+     * snapshot and empties the log, so startup time depends on the number of
+     * changes since the last compaction rather than on the size of the library.
+     *
+     * With setLosslessCompression() enabled, put() and Writer store integer PCM WAV
+     * and AIFF files through compressPcmFile(), typically in about half the
+     * space, at `<id>.<ext>.fsl`; read() returns the original bytes
+     * whichever way a sound is kept.
+     *
+     * @note Thread-safe
+     */
+    class SoundStore
+    {
+    public:
+        /// Name of the index log inside the store root
+        static constexpr const char* INDEX_FILE = "index.bin";
+
+        /// Name of the index snapshot inside the store root
+        static constexpr const char* SNAPSHOT_FILE = "index.snap";
+
+        /// Appended to the path of a sound kept compressed
+        static constexpr const char* COMPRESSED_SUFFIX = ".fsl";
+
+        /**
+         * @class Writer
+         * @brief Stores a sound whose contents arrive in parts
+         *
+         * The first bytes are held back until the container format, and with
+         * it the file name, is known; after that every part goes straight to
+         * the file, so a sound is never held in memory in full. The file is
+         * written through an AtomicFile, so a writer destroyed before
+         * commit() leaves nothing behind.
+         */
+        class Writer
+        {
+        public:
+            /**
+             * @brief Starts storing a sound, replacing any previous version on commit()
+             *
+             * @param store Open store receiving the sound
+             * @param sound_id Freesound sound ID
+             */
+            Writer(SoundStore& store, int sound_id);
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            /**
+             * @brief Appends the next part of the contents
+             *
+             * @param data Bytes following those of the previous call
+             * @param size Number of bytes at data
+             * @return bool True if the bytes were written (or held back)
+             */
+            bool append(const uint8_t* data, size_t size);
+
+            /**
+             * @brief Completes the file and records it in the index
+             *
+             * With lossless compression enabled, a PCM file is compressed from
+             * its temporary copy and only the compressed form is renamed into
+             * place.
+             *
+             * @return bool True if the file and its index record were written
+             */
+            bool commit();
+
+        private:
+            bool openFile();
+
+            SoundStore& m_store;
+            StoreEntry m_entry;
+
+            /// Leading bytes held back until the format is known
+            std::vector<uint8_t> m_head;
+
+            AtomicFile m_file;
+            bool m_failed = false;
+            bool m_committed = false;
+        };
+
+        /**
+         * @brief Opens (or creates) a store rooted at a directory
+         *
+         * Maps the index snapshot, if any, and replays the delta log on top of
+         * it. A partially written trailing record left by a crash is discarded.
+         *
+         * @param root Store root directory
+         * @return bool True if the store is ready for use; false if the
+         *              directory or log cannot be opened or the snapshot fails
+         *              its checksum
+         */
+        bool open(const std::string& root);
+
+        /**
+         * @brief Stores the contents of a sound, replacing any previous version
+         *
+         * @param sound_id Freesound sound ID
+         * @param data File contents
+         * @param size Number of bytes at data
+         * @return bool True if the file and its index record were written
+         */
+        bool put(int sound_id, const uint8_t* data, size_t size);
+
+        /**
+         * @brief Reads back the contents of a sound as they were put
+         *
+         * Compressed sounds are decompressed, in parallel blocks. The result
+         * is checked against the size and content hash of the index record.
+         *
+         * @param sound_id Freesound sound ID
+         * @return std::optional<std::vector<uint8_t>> File contents, or std::nullopt if the sound
+         *         is not stored or its file is missing or damaged
+         */
+        std::optional<std::vector<uint8_t>> read(int sound_id) const;
+
+        /**
+         * @brief Removes a sound from the store
+         *
+         * @param sound_id Freesound sound ID
+         * @return bool True if the sound was present and has been removed
+         */
+        bool remove(int sound_id);
+
+        /**
+         * @brief Looks up a sound in the index
+         *
+         * @param sound_id Freesound sound ID
+         * @return std::optional<StoreEntry> Index record, or std::nullopt if not stored
+         */
+        std::optional<StoreEntry> find(int sound_id) const;
+
+        /**
+         * @brief Returns the path at which a sound is (or would be) stored
+         *
+         * @param sound_id Freesound sound ID
+         * @param format Container format, which selects the file extension
+         * @return std::string Sharded file path below the store root
+         */
+        std::string pathFor(int sound_id, AudioFormat format) const;
+
+        /**
+         * @brief Returns the path of the file that holds a sound
+         *
+         * @param entry Index record of the sound
+         * @return std::string pathFor() of the sound, with COMPRESSED_SUFFIX if it is kept compressed
+         */
+        std::string storedPathFor(const StoreEntry& entry) const;
+
+        /**
+         * @brief Chooses whether put() and Writer compress PCM files losslessly
+         *
+         * Sounds already stored are kept as they are until put again.
+         *
+         * @param enabled Compress from now on
+         * @param options Parameters passed to compressPcmFile(); threads also applies to read()
+         * @throws std::invalid_argument If enabled and options are out of range
+         */
+        void setLosslessCompression(bool enabled, const LosslessOptions& options = {});
+
+        /**
+         * @brief Returns the number of sounds in the store
+         */
+        size_t size() const;
+
+        /**
+         * @brief Writes a new index snapshot and empties the delta log
+         *
+         * @return bool True if the new snapshot replaced the old one
+         */
+        bool compact();
+
+        /**
+         * @brief Returns the store root directory
+         */
+        const std::string& root() const { return m_root; }
+
+        /**
+         * @brief Computes the content hash recorded in StoreEntry
+         *
+         * @param data File contents
+         * @param size Number of bytes at data
+         * @param hash Hash of the bytes preceding data, to hash a file in parts
+         * @return uint64_t FNV-1a 64 hash
+         */
+        static uint64_t contentHash(const uint8_t* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull);
+
+    private:
+        bool addEntry(const StoreEntry& entry);
+        bool appendRecord(const StoreEntry& entry, bool removed);
+        bool loadSnapshot();
+        std::optional<StoreEntry> lookup(int sound_id) const;
+        std::optional<StoreEntry> snapshotFind(int sound_id) const;
+
+        /// Store root directory
+        std::string m_root;
+
+        /// Mapped index snapshot and its sorted records
+        MappedFile m_snapshot;
+        const uint8_t* m_snapshot_records = nullptr;
+        size_t m_snapshot_count = 0;
+
+        /// Changes since the snapshot; std::nullopt marks a removed sound
+        std::unordered_map<int, std::optional<StoreEntry>> m_delta;
+
+        /// Number of sounds in the store
+        size_t m_count = 0;
+
+        /// Append handle on the delta log
+        std::ofstream m_index;
+
+        /// Whether and how put() compresses PCM files
+        bool m_compress = false;
+        LosslessOptions m_lossless;
+
+        /// Guards the index state, m_index and the compression settings
+        mutable std::mutex m_mutex;
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @class SpscQueue
+     * @brief Fixed-capacity wait-free queue for one producer and one consumer
+     *
+     * Each side owns one cursor and only reads the other's, so push and pop
+     * are a bounded number of loads and stores with no read-modify-write,
+     * lock or system call. Each side also keeps a cached copy of the other
+     * cursor and rereads the shared one only when the cache says the ring
+     * is full (or empty), which keeps the cursor cache lines from bouncing
+     * between cores. The queue never allocates after construction, which
+     * makes it usable from a real-time audio thread.
+     *
+     * @tparam T Element type; must be default-constructible and movable
+     * @note One thread may push and one (other) thread may pop at a time
+     */
+    template <typename T>
+    class SpscQueue
+    {
+    public:
+        /**
+         * @brief Constructs a queue holding up to capacity elements
+         *
+         * @param capacity Maximum number of queued elements, rounded up to a power of two
+         * @throws std::invalid_argument If capacity is zero
+         */
+        explicit SpscQueue(size_t capacity)
+        {
+            if (capacity == 0)
+            {
+                throw std::invalid_argument("SpscQueue capacity must be positive");
+            }
+
+            size_t rounded = 1;
+            while (rounded < capacity)
+            {
+                rounded <<= 1;
+            }
+
+            m_mask = rounded - 1;
+            m_slots.reset(new T[rounded]);
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief Appends an element if there is room (producer only)
+         *
+         * @param value Element to move into the queue
+         * @return bool False if the queue is full (value is left untouched)
+         */
+        bool tryPush(T&& value)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cached_head > m_mask)
+            {
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if (tail - m_cached_head > m_mask)
+                {
+                    return false;
+                }
+            }
+
+            m_slots[tail & m_mask] = std::move(value);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Removes the oldest element if there is one (consumer only)
+         *
+         * @param value Receives the element
+         * @return bool False if the queue is empty
+         */
+        bool tryPop(T& value)
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cached_tail)
+            {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cached_tail)
+                {
+                    return false;
+                }
+            }
+
+            value = std::move(m_slots[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Returns the number of elements the queue can hold
+         */
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        /// Keeps the producer and consumer state on separate cache lines
+        static constexpr size_t CACHE_LINE = 64;
+
+        std::unique_ptr<T[]> m_slots;
+        size_t m_mask = 0;
+
+        /// Producer side: next slot to fill, and the consumer cursor last seen
+        alignas(CACHE_LINE) std::atomic<size_t> m_tail{0};
+        size_t m_cached_head = 0;
+
+        /// Consumer side: next slot to read, and the producer cursor last seen
+        alignas(CACHE_LINE) std::atomic<size_t> m_head{0};
+        size_t m_cached_tail = 0;
+    };
+}
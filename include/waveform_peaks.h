@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct PeakOptions
+     * @brief Resolutions of a waveform overview
+     */
+    struct PeakOptions
+    {
+        /// Frames summarized by each peak of the finest level
+        uint32_t frames_per_peak = 256;
+
+        /// Ratio between the frames per peak of consecutive levels
+        uint32_t level_factor = 4;
+
+        /// Number of levels, finest first
+        uint32_t levels = 4;
+    };
+
+    /**
+     * @struct PeakLevel
+     * @brief Minimum and maximum of every window of frames at one resolution
+     *
+     * Values are the extremes over all channels, scaled so that 127 is full
+     * scale and rounded outwards, so a drawn waveform never looks quieter
+     * than the audio.
+     */
+    struct PeakLevel
+    {
+        /// Frames summarized by each peak (the last peak may cover fewer)
+        uint32_t frames_per_peak = 0;
+
+        std::vector<int8_t> min;
+        std::vector<int8_t> max;
+
+        size_t size() const { return min.size(); }
+    };
+
+    /**
+     * @struct WaveformPeaks
+     * @brief Multi-resolution min/max overview of a sound, for drawing waveform thumbnails
+     */
+    struct WaveformPeaks
+    {
+        uint32_t sample_rate = 0;
+        uint16_t channels = 0;
+        uint64_t frames = 0;
+
+        /// Levels from the finest to the coarsest
+        std::vector<PeakLevel> levels;
+
+        /**
+         * @brief Returns the coarsest level that still has a peak per pixel
+         *
+         * @param width Pixels the waveform is drawn across
+         * @return const PeakLevel* Best level, the finest if none is detailed enough, or nullptr without levels
+         */
+        const PeakLevel* levelFor(size_t width) const;
+
+        /**
+         * @brief Writes the overview to a compact peak file
+         *
+         * The file appears under its final name only once complete.
+         *
+         * @param path Destination, usually peakPathFor() of the sound
+         * @param sync_first Flush the file to stable storage before it appears
+         * @return bool True if the file was written
+         */
+        bool save(const std::string& path, bool sync_first = false) const;
+
+        /**
+         * @brief Reads a peak file written by save()
+         *
+         * @param path Peak file
+         * @return std::optional<WaveformPeaks> Overview, or std::nullopt if the file is missing or malformed
+         */
+        static std::optional<WaveformPeaks> load(const std::string& path);
+    };
+
+    /**
+     * @class PeakBuilder
+     * @brief Computes a WaveformPeaks overview from samples as they are decoded
+     *
+     * The finest level is built from the samples with the vectorized
+     * measureRange() kernel; the coarser levels are derived from it when
+     * the stream ends, so the samples are read only once.
+     *
+     * @note Not thread-safe; each builder is used by one thread at a time
+     */
+    class PeakBuilder
+    {
+    public:
+        /**
+         * @brief Prepares a builder
+         *
+         * @param channels Interleaved channels per frame
+         * @param sample_rate Rate recorded in the overview
+         * @param options Resolutions to build
+         * @throws std::invalid_argument If channels, frames_per_peak or levels is zero, or level_factor is below 2
+         */
+        PeakBuilder(uint16_t channels, uint32_t sample_rate, const PeakOptions& options = {});
+
+        /**
+         * @brief Adds the next frames of the sound
+         *
+         * @param samples Interleaved frames following those added before
+         * @param frames Number of frames at samples
+         */
+        void push(const float* samples, size_t frames);
+
+        /**
+         * @brief Completes the overview once every frame has been added
+         *
+         * @return WaveformPeaks Overview of all frames pushed
+         */
+        WaveformPeaks finish();
+
+    private:
+        void closeWindow();
+
+        const PeakOptions m_options;
+        WaveformPeaks m_peaks;
+
+        /// Extremes of the finest-level window being filled, and its frame count
+        float m_min = 0.0f;
+        float m_max = 0.0f;
+        uint32_t m_window_frames = 0;
+    };
+
+    /**
+     * @brief Returns the path of the peak file kept next to an audio file
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.peaks`
+     */
+    std::string peakPathFor(const std::string& audio_path);
+
+    /**
+     * @brief Decodes audio files in parallel and writes a peak file next to each
+     *
+     * WAV, AIFF and FLAC files are read in blocks and decoded on a pool of
+     * worker threads, one file per worker at a time.
+     *
+     * @param paths Sound files
+     * @param options Resolutions to build
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::string> Paths whose peaks could not be generated
+     */
+    std::vector<std::string> generatePeakFiles(const std::vector<std::string>& paths,
+                                               const PeakOptions& options = {}, unsigned threads = 0);
+}
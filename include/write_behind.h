@@ -0,0 +1,221 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "md5.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    class AtomicFile;
+
+    /**
+     * @struct WriteBehindOptions
+     * @brief Configuration of a WriteBehindWriter
+     */
+    struct WriteBehindOptions
+    {
+        /// Threads draining filled buffers to disk
+        unsigned io_threads = 2;
+
+        /// Size of each pooled buffer
+        size_t buffer_size = 256 * 1024;
+
+        /// Buffers shared by all streams; memory use is buffer_size * buffer_count
+        size_t buffer_count = 64;
+    };
+
+    /**
+     * @class WriteBehindWriter
+     * @brief Write-behind stage that moves disk writes off the network threads
+     *
+     * Network threads copy received data into buffers taken from a fixed
+     * pool and push each full buffer onto a lock-free queue; a small pool of
+     * I/O threads pops the buffers, writes them at their file offset and
+     * returns them to the pool. A disk latency spike therefore only delays
+     * a network thread once every buffer is queued, and that wait is the
+     * backpressure that keeps memory bounded.
+     *
+     * Streams can have their MD5 computed on the way through. The I/O
+     * threads hash each stream's buffers in order and process up to
+     * Md5::LANES streams in one multi-lane pass, so verification needs
+     * neither a second read of the file nor time on the network threads.
+     *
+     * @note Thread-safe; each Stream must be used by one thread at a time
+     */
+    class WriteBehindWriter
+    {
+    public:
+        class Stream;
+
+    private:
+        /// One filled buffer of a stream waiting to be written
+        struct WriteRequest
+        {
+            Stream* stream = nullptr;
+            uint8_t* buffer = nullptr;
+            size_t length = 0;
+            uint64_t offset = 0;
+
+            /// Position of the buffer within its stream
+            uint64_t sequence = 0;
+        };
+
+    public:
+        /**
+         * @class Stream
+         * @brief Sequential writer for one AtomicFile
+         *
+         * The file must stay open until finish() returns.
+         */
+        class Stream
+        {
+        public:
+            /**
+             * @brief Starts writing at offset 0 of an open AtomicFile
+             *
+             * @param writer Write-behind stage performing the writes
+             * @param file Open AtomicFile receiving the data
+             * @param compute_md5 Hash the data as it is written
+             */
+            Stream(WriteBehindWriter& writer, AtomicFile& file, bool compute_md5 = false);
+
+            /**
+             * @brief Finishes the stream if finish() was not called
+             */
+            ~Stream();
+
+            Stream(const Stream&) = delete;
+            Stream& operator=(const Stream&) = delete;
+
+            /**
+             * @brief Appends bytes, blocking only while every pooled buffer is in use
+             *
+             * @param data Bytes to append
+             * @param size Number of bytes at data
+             * @return bool False once any write of this stream has failed
+             */
+            bool append(const void* data, size_t size);
+
+            /**
+             * @brief Queues buffered data and waits until all of it is on disk
+             *
+             * @return bool True if every byte was written
+             */
+            bool finish();
+
+            /**
+             * @brief Returns the number of bytes appended so far
+             */
+            uint64_t size() const { return m_size; }
+
+            /**
+             * @brief Returns the MD5 of the stream once finish() has returned
+             *
+             * @return std::optional<Md5::Digest> Digest, or std::nullopt if
+             *         hashing was not requested or the stream is unfinished
+             */
+            const std::optional<Md5::Digest>& md5() const { return m_digest; }
+
+        private:
+            friend class WriteBehindWriter;
+
+            void queueCurrent();
+
+            WriteBehindWriter& m_writer;
+            AtomicFile& m_file;
+            uint8_t* m_buffer = nullptr;
+            size_t m_fill = 0;
+            uint64_t m_size = 0;
+            bool m_finished = false;
+            uint64_t m_next_sequence = 0;
+
+            const bool m_compute_md5;
+            Md5 m_md5;
+            std::optional<Md5::Digest> m_digest;
+
+            /// Buffers queued but not yet written (and hashed); guarded by m_mutex
+            size_t m_pending = 0;
+
+            /// Sequence number of the next buffer to hash; guarded by m_mutex
+            uint64_t m_hash_sequence = 0;
+
+            /// An I/O thread is hashing this stream; guarded by m_mutex
+            bool m_hashing = false;
+
+            /// Written buffers waiting for their turn to be hashed; guarded by m_mutex
+            std::vector<WriteRequest> m_parked;
+
+            std::atomic<bool> m_failed{false};
+            std::mutex m_mutex;
+            std::condition_variable m_drained;
+        };
+
+        /**
+         * @brief Allocates the buffer pool and starts the I/O threads
+         *
+         * @param options Stage configuration
+         * @throws std::invalid_argument If io_threads, buffer_size or buffer_count is zero
+         */
+        explicit WriteBehindWriter(const WriteBehindOptions& options = {});
+
+        /**
+         * @brief Drains the queue and stops the I/O threads
+         *
+         * Every Stream must be finished before the writer is destroyed.
+         */
+        ~WriteBehindWriter();
+
+        WriteBehindWriter(const WriteBehindWriter&) = delete;
+        WriteBehindWriter& operator=(const WriteBehindWriter&) = delete;
+
+        /**
+         * @brief Size of each pooled buffer in bytes
+         */
+        size_t bufferSize() const { return m_buffer_size; }
+
+        /**
+         * @brief Returns how often a stream had to wait for a free buffer
+         *
+         * A growing count means the disks are the bottleneck.
+         */
+        uint64_t stalls() const { return m_stalls.load(std::memory_order_relaxed); }
+
+    private:
+        uint8_t* acquireBuffer();
+        void releaseBuffer(uint8_t* buffer);
+        void enqueue(WriteRequest request);
+        bool waitForRequest(WriteRequest& request);
+        void ioLoop();
+        void hashInOrder(WriteRequest* requests, size_t count);
+
+        size_t m_buffer_size;
+
+        /// Backing memory of every pooled buffer
+        std::unique_ptr<uint8_t[]> m_memory;
+
+        /// Buffers not owned by a stream or request
+        BoundedQueue<uint8_t*> m_free_buffers;
+
+        /// Filled buffers waiting for an I/O thread
+        BoundedQueue<WriteRequest> m_requests;
+
+        /// Sleep/wake-up for the otherwise lock-free queues
+        std::mutex m_wait_mutex;
+        std::condition_variable m_buffer_freed;
+        std::condition_variable m_work_ready;
+        std::atomic<int> m_waiting_streams{0};
+        std::atomic<int> m_idle_workers{0};
+
+        std::atomic<uint64_t> m_stalls{0};
+        std::atomic<bool> m_stopping{false};
+        std::vector<std::thread> m_io_threads;
+    };
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "atomic_file.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @struct UnzipOptions
+     * @brief Configuration of a ZipStreamExtractor
+     */
+    struct UnzipOptions
+    {
+        /// Threads inflating and writing members (0 for one per hardware thread)
+        unsigned threads = 0;
+
+        /// Compressed bytes that may wait for a thread before push() blocks
+        size_t max_pending_bytes = 64 * 1024 * 1024;
+
+        /// Durability of the extracted files (GroupCommit behaves like PerFile)
+        SyncPolicy sync_policy = SyncPolicy::PerFile;
+    };
+
+    /**
+     * @struct ZipMember
+     * @brief File extracted from a zip archive
+     */
+    struct ZipMember
+    {
+        /// Name inside the archive, with '/' separators
+        std::string name;
+
+        /// Path of the extracted file
+        std::string path;
+
+        /// Uncompressed size in bytes
+        uint64_t size = 0;
+    };
+
+    /**
+     * @class ZipStreamExtractor
+     * @brief Unpacks a zip archive from its bytes as they arrive
+     *
+     * The archive is read front to back through the local file headers,
+     * so members are extracted while the rest of the archive is still
+     * being received and the archive itself is never written to disk; the
+     * central directory at the end is not needed. Stored members are
+     * written through as their bytes arrive. Deflated members are
+     * collected and then inflated, checked and written by a pool of
+     * threads, several members at once, while parsing goes on. Members
+     * whose sizes follow their data (general purpose flag bit 3) are
+     * delimited by their data descriptor, which must carry its optional
+     * signature, and Zip64 sizes are understood. A compressed member is
+     * held in memory in full until a thread has written it.
+     *
+     * Every file is checked against the CRC-32 and size recorded in the
+     * archive before it is renamed into place under the output directory.
+     * Names that are absolute or climb out of the output directory with
+     * ".." are refused.
+     *
+     * @note Not thread-safe; push() and finish() are called from one thread
+     */
+    class ZipStreamExtractor
+    {
+    public:
+        /**
+         * @brief Starts the worker threads
+         *
+         * @param output_dir Directory receiving the members (created if missing)
+         * @param options Threads, memory bound and durability
+         * @throws std::invalid_argument If max_pending_bytes is zero
+         */
+        ZipStreamExtractor(const std::string& output_dir, const UnzipOptions& options = {});
+
+        /**
+         * @brief Stops the worker threads; members not yet complete are discarded
+         */
+        ~ZipStreamExtractor();
+
+        ZipStreamExtractor(const ZipStreamExtractor&) = delete;
+        ZipStreamExtractor& operator=(const ZipStreamExtractor&) = delete;
+
+        /**
+         * @brief Parses the next bytes of the archive
+         *
+         * Blocks while max_pending_bytes of compressed members are waiting
+         * for a thread.
+         *
+         * @param data Bytes following those of the previous call
+         * @param size Number of bytes at data
+         * @return bool False once the archive is found to be damaged, uses an
+         *         unsupported feature (encryption, a method other than stored
+         *         or deflate) or a member cannot be written
+         */
+        bool push(const void* data, size_t size);
+
+        /**
+         * @brief Waits for the members still being extracted
+         *
+         * Members completed before a failure stay in place.
+         *
+         * @return bool True if the archive ended after its last member and
+         *         every member was extracted
+         */
+        bool finish();
+
+        /**
+         * @brief Returns the members found so far, in archive order
+         *
+         * Directory entries are not listed. After a successful finish()
+         * every listed file is in place.
+         */
+        const std::vector<ZipMember>& members() const { return m_members; }
+
+    private:
+        struct Member;
+
+        enum class State
+        {
+            Header,
+            Data,
+            End,
+            Failed
+        };
+
+        size_t consume(const uint8_t* data, size_t size);
+        void parseHeader(const uint8_t* data, size_t size, size_t& used);
+        void parseData(const uint8_t* data, size_t size, size_t& used);
+        void beginMember(const std::string& name, uint16_t flags, uint16_t method,
+                         uint32_t crc, uint64_t compressed_size, uint64_t size, bool zip64);
+        void endMember();
+        void fail();
+        void workerLoop();
+
+        std::string m_output_dir;
+        const UnzipOptions m_options;
+        State m_state = State::Header;
+
+        /// Received bytes the parser needs more of before it can consume them
+        std::vector<uint8_t> m_input;
+
+        /// Member whose data is being received
+        std::unique_ptr<Member> m_member;
+
+        std::vector<ZipMember> m_members;
+
+        std::mutex m_mutex;
+        std::condition_variable m_work;
+        std::condition_variable m_space;
+
+        /// Members waiting for a worker, and their total compressed size
+        std::deque<std::unique_ptr<Member>> m_queue;
+        size_t m_pending_bytes = 0;
+        size_t m_busy = 0;
+        bool m_worker_failed = false;
+        bool m_stopping = false;
+        std::vector<std::thread> m_workers;
+    };
+}
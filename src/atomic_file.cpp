@@ -0,0 +1,457 @@
+/**
+ * @file src/atomic_file.cpp
+ * @brief Implementation of atomic file replacement and group commit
+ *
+ * @see include/atomic_file.h
+ */
+
+#include "atomic_file.h"
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Distinguishes temporary files created by threads of the same process
+        std::atomic<uint64_t> g_temp_counter{0};
+
+        int currentProcessId()
+        {
+#ifdef _WIN32
+            return _getpid();
+#else
+            return static_cast<int>(getpid());
+#endif
+        }
+    }
+
+    AtomicFile::~AtomicFile()
+    {
+        abort();
+    }
+
+    AtomicFile::AtomicFile(AtomicFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    AtomicFile& AtomicFile::operator=(AtomicFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            abort();
+            m_fd = std::exchange(other.m_fd, -1);
+            m_written = std::exchange(other.m_written, 0);
+            m_final_path = std::move(other.m_final_path);
+            m_temp_path = std::move(other.m_temp_path);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Creates the temporary file for a final path
+     *
+     * The temporary name is `.<filename>.part.<pid>.<n>` in the destination
+     * directory, which keeps it on the same filesystem as the final path.
+     *
+     * @param final_path Path the file will have after commit()
+     * @return bool True if the temporary file was created
+     */
+    bool AtomicFile::open(const std::string& final_path)
+    {
+        abort();
+
+        const fs::path destination(final_path);
+        const std::string temp_name = "." + destination.filename().string()
+            + ".part." + std::to_string(currentProcessId())
+            + "." + std::to_string(g_temp_counter++);
+
+        m_final_path = final_path;
+        m_temp_path = (destination.parent_path() / temp_name).string();
+        m_written = 0;
+
+#ifdef _WIN32
+        m_fd = _open(m_temp_path.c_str(),
+            _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        m_fd = ::open(m_temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#endif
+        return m_fd >= 0;
+    }
+
+    /**
+     * @brief Appends bytes to the temporary file
+     *
+     * @param data Bytes to write
+     * @param size Number of bytes at data
+     * @return bool True if every byte was written
+     */
+    bool AtomicFile::write(const void* data, size_t size)
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+#ifdef _WIN32
+            const unsigned int request = size > 0x40000000u
+                ? 0x40000000u : static_cast<unsigned int>(size);
+            const int written = _write(m_fd, bytes, request);
+#else
+            const ssize_t written = ::write(m_fd, bytes, size);
+#endif
+            if (written < 0)
+            {
+#ifndef _WIN32
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+#endif
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+            m_written += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes bytes at an offset without moving the file position
+     *
+     * @param data Bytes to write
+     * @param size Number of bytes at data
+     * @param offset Position in the file of the first byte
+     * @return bool True if every byte was written
+     */
+    bool AtomicFile::writeAt(const void* data, size_t size, uint64_t offset)
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(data);
+#ifdef _WIN32
+        // No positional write on CRT descriptors: serialise seek + write
+        static std::mutex seek_mutex;
+        std::lock_guard<std::mutex> lock(seek_mutex);
+        const __int64 previous = _telli64(m_fd);
+        if (_lseeki64(m_fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+        {
+            return false;
+        }
+        bool ok = true;
+        while (ok && size > 0)
+        {
+            const unsigned int request = size > 0x40000000u
+                ? 0x40000000u : static_cast<unsigned int>(size);
+            const int written = _write(m_fd, bytes, request);
+            ok = written > 0;
+            if (ok)
+            {
+                bytes += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+        _lseeki64(m_fd, previous, SEEK_SET);
+        return ok;
+#else
+        while (size > 0)
+        {
+            const ssize_t written = pwrite(m_fd, bytes, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+#endif
+    }
+
+    /**
+     * @brief Reserves disk space for the expected file size
+     *
+     * Uses fallocate on Linux (not posix_fallocate, whose glibc fallback
+     * writes zeros on filesystems without native support), F_PREALLOCATE
+     * on Apple platforms and posix_fallocate on other POSIX systems.
+     *
+     * @param size Expected file size in bytes
+     * @return bool False if the space could not be reserved
+     */
+    bool AtomicFile::preallocate(uint64_t size)
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+        if (size == 0)
+        {
+            return true;
+        }
+
+#if defined(__linux__)
+        if (fallocate(m_fd, 0, 0, static_cast<off_t>(size)) == 0)
+        {
+            return true;
+        }
+        return errno != ENOSPC && errno != EFBIG && errno != EDQUOT;
+#elif defined(__APPLE__)
+        fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0};
+        if (fcntl(m_fd, F_PREALLOCATE, &store) == -1)
+        {
+            store.fst_flags = F_ALLOCATEALL;
+            if (fcntl(m_fd, F_PREALLOCATE, &store) == -1)
+            {
+                return errno != ENOSPC;
+            }
+        }
+        return ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+#elif defined(_WIN32)
+        return _chsize_s(m_fd, static_cast<__int64>(size)) == 0;
+#else
+        const int result = posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+        return result != ENOSPC && result != EFBIG;
+#endif
+    }
+
+    /**
+     * @brief Sets the length of the temporary file
+     *
+     * @param size New length in bytes
+     * @return bool True on success
+     */
+    bool AtomicFile::truncate(uint64_t size)
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+#ifdef _WIN32
+        return _chsize_s(m_fd, static_cast<__int64>(size)) == 0;
+#else
+        return ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+#endif
+    }
+
+    /**
+     * @brief Asks the kernel to begin writing the file back without waiting
+     */
+    void AtomicFile::startWriteback()
+    {
+#if defined(__linux__)
+        if (m_fd >= 0)
+        {
+            sync_file_range(m_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+        }
+#endif
+    }
+
+    /**
+     * @brief Flushes the file contents to stable storage
+     *
+     * @return bool True if the flush succeeded
+     */
+    bool AtomicFile::sync()
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(m_fd) == 0;
+#elif defined(__APPLE__)
+        return fcntl(m_fd, F_FULLFSYNC) == 0 || fsync(m_fd) == 0;
+#else
+        return fdatasync(m_fd) == 0;
+#endif
+    }
+
+    /**
+     * @brief Closes the temporary file and renames it to the final path
+     *
+     * @param sync_first Flush the contents before renaming
+     * @return bool True if the file is now visible under its final path
+     */
+    bool AtomicFile::commit(bool sync_first)
+    {
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        if (sync_first && !sync())
+        {
+            abort();
+            return false;
+        }
+        closeDescriptor();
+
+        std::error_code ec;
+        fs::rename(m_temp_path, m_final_path, ec);
+        if (ec)
+        {
+            fs::remove(m_temp_path, ec);
+            m_temp_path.clear();
+            return false;
+        }
+
+        m_temp_path.clear();
+        return true;
+    }
+
+    /**
+     * @brief Closes and removes the temporary file
+     */
+    void AtomicFile::abort()
+    {
+        closeDescriptor();
+        if (!m_temp_path.empty())
+        {
+            std::error_code ec;
+            fs::remove(m_temp_path, ec);
+            m_temp_path.clear();
+        }
+    }
+
+    /**
+     * @brief Flushes a directory entry table so that renames inside it are durable
+     *
+     * @param directory Directory to flush
+     * @return bool True on success (always true where unsupported)
+     */
+    bool AtomicFile::syncDirectory(const std::string& directory)
+    {
+#ifdef _WIN32
+        (void)directory;
+        return true;
+#else
+        const int fd = ::open(directory.empty() ? "." : directory.c_str(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        const bool ok = fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    void AtomicFile::closeDescriptor()
+    {
+        if (m_fd >= 0)
+        {
+#ifdef _WIN32
+            _close(m_fd);
+#else
+            ::close(m_fd);
+#endif
+            m_fd = -1;
+        }
+    }
+
+    /**
+     * @brief Constructs a committer that flushes after group_size files
+     *
+     * @param group_size Files collected before an automatic flush (minimum 1)
+     */
+    GroupCommitter::GroupCommitter(size_t group_size)
+        : m_group_size(group_size == 0 ? 1 : group_size)
+    {
+        m_pending.reserve(m_group_size);
+    }
+
+    /**
+     * @brief Flushes any files still pending
+     */
+    GroupCommitter::~GroupCommitter()
+    {
+        flush();
+    }
+
+    /**
+     * @brief Queues a fully written file, flushing if the group is full
+     *
+     * @param file Open AtomicFile whose contents are complete
+     */
+    void GroupCommitter::add(AtomicFile&& file)
+    {
+        m_pending.push_back(std::move(file));
+        if (m_pending.size() >= m_group_size)
+        {
+            flush();
+        }
+    }
+
+    /**
+     * @brief Commits every pending file
+     *
+     * @return std::vector<std::string> Final paths that could not be committed
+     */
+    std::vector<std::string> GroupCommitter::flush()
+    {
+        std::vector<std::string> failed;
+        if (m_pending.empty())
+        {
+            return failed;
+        }
+
+        for (auto& file : m_pending)
+        {
+            file.startWriteback();
+        }
+
+        std::set<std::string> directories;
+        for (auto& file : m_pending)
+        {
+            const std::string final_path = file.finalPath();
+            if (file.sync() && file.commit(false))
+            {
+                directories.insert(fs::path(final_path).parent_path().string());
+            }
+            else
+            {
+                file.abort();
+                failed.push_back(final_path);
+            }
+        }
+
+        for (const auto& directory : directories)
+        {
+            AtomicFile::syncDirectory(directory);
+        }
+
+        m_pending.clear();
+        m_failures.insert(m_failures.end(), failed.begin(), failed.end());
+        return failed;
+    }
+}
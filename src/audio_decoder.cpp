@@ -0,0 +1,1291 @@
+/**
+ * @file src/audio_decoder.cpp
+ * @brief Incremental WAV, AIFF and FLAC decoders
+ *
+ * @see include/audio_decoder.h
+ */
+
+#include "audio_decoder.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        uint16_t readLe16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+        uint32_t readLe32(const uint8_t* p) { return readLe16(p) | (static_cast<uint32_t>(readLe16(p + 2)) << 16); }
+        uint64_t readLe64(const uint8_t* p) { return readLe32(p) | (static_cast<uint64_t>(readLe32(p + 4)) << 32); }
+        uint16_t readBe16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+        uint32_t readBe32(const uint8_t* p) { return (static_cast<uint32_t>(readBe16(p)) << 16) | readBe16(p + 2); }
+
+        /// AIFF stores its sample rate as an 80-bit IEEE 754 extended float
+        double readExtended80(const uint8_t* p)
+        {
+            const int exponent = ((p[0] & 0x7F) << 8) | p[1];
+            uint64_t mantissa = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                mantissa = (mantissa << 8) | p[2 + i];
+            }
+            if (exponent == 0 && mantissa == 0)
+            {
+                return 0.0;
+            }
+            const double value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+            return (p[0] & 0x80) ? -value : value;
+        }
+
+        bool tagIs(const uint8_t* p, const char* tag) { return std::memcmp(p, tag, 4) == 0; }
+
+        /**
+         * @brief Byte layout of uncompressed samples
+         */
+        struct PcmLayout
+        {
+            enum class Coding { Unsigned, Signed, Float };
+
+            Coding coding = Coding::Signed;
+            unsigned bytes = 2;
+            bool big_endian = false;
+            unsigned channels = 0;
+
+            size_t frameBytes() const { return static_cast<size_t>(bytes) * channels; }
+        };
+
+        /// Converts whole frames of uncompressed samples to interleaved floats
+        void convertPcm(const uint8_t* data, size_t frames, const PcmLayout& layout, std::vector<float>& samples)
+        {
+            const size_t count = frames * layout.channels;
+            const size_t first = samples.size();
+            samples.resize(first + count);
+            float* out = samples.data() + first;
+
+            if (layout.coding == PcmLayout::Coding::Float)
+            {
+                for (size_t i = 0; i < count; ++i, data += layout.bytes)
+                {
+                    uint8_t raw[8];
+                    for (unsigned b = 0; b < layout.bytes; ++b)
+                    {
+                        raw[b] = layout.big_endian ? data[layout.bytes - 1 - b] : data[b];
+                    }
+                    if (layout.bytes == 4)
+                    {
+                        float value;
+                        std::memcpy(&value, raw, 4);
+                        out[i] = value;
+                    }
+                    else
+                    {
+                        double value;
+                        std::memcpy(&value, raw, 8);
+                        out[i] = static_cast<float>(value);
+                    }
+                }
+                return;
+            }
+
+            if (layout.coding == PcmLayout::Coding::Signed && !layout.big_endian && layout.bytes >= 2 && layout.bytes <= 4)
+            {
+                static const PcmEncoding ENCODINGS[] = {PcmEncoding::Int16, PcmEncoding::Int24, PcmEncoding::Int32};
+                pcmToFloat(data, ENCODINGS[layout.bytes - 2], count, out);
+                return;
+            }
+
+            // Build the sample in the top bits of an int32 so one scale fits every width
+            const float scale = 1.0f / 2147483648.0f;
+            const unsigned shift = 32 - 8 * layout.bytes;
+            for (size_t i = 0; i < count; ++i, data += layout.bytes)
+            {
+                uint32_t value = 0;
+                for (unsigned b = 0; b < layout.bytes; ++b)
+                {
+                    value = (value << 8) | (layout.big_endian ? data[b] : data[layout.bytes - 1 - b]);
+                }
+                value <<= shift;
+                if (layout.coding == PcmLayout::Coding::Unsigned)
+                {
+                    value ^= 0x80000000u;
+                }
+                out[i] = static_cast<float>(static_cast<int32_t>(value)) * scale;
+            }
+        }
+
+        /**
+         * @class ChunkedPcmDecoder
+         * @brief WAV and AIFF: a chunked container around uncompressed samples
+         *
+         * Header and format chunks are collected in a small buffer; samples
+         * of the data chunk are converted straight from the pushed bytes,
+         * with only a partial frame carried over between pushes.
+         */
+        class ChunkedPcmDecoder : public AudioDecoder
+        {
+        public:
+            explicit ChunkedPcmDecoder(bool aiff) : m_aiff(aiff) {}
+
+            bool push(const uint8_t* data, size_t size, std::vector<float>& samples) override
+            {
+                if (m_failed)
+                {
+                    return false;
+                }
+                m_failed = !consume(data, size, samples);
+                return !m_failed;
+            }
+
+            bool finish(std::vector<float>& samples) override
+            {
+                (void)samples;
+                if (m_failed)
+                {
+                    return false;
+                }
+                if (m_state == State::Trailer)
+                {
+                    return true;
+                }
+                // An open-ended data chunk ends with the file; a bounded one must be complete
+                return m_state == State::Data && !m_data_left && m_pending.empty();
+            }
+
+        private:
+            enum class State { Header, ChunkHeader, ChunkBody, Skip, Data, Trailer };
+
+            static constexpr size_t MAX_FORMAT_CHUNK = 4096;
+
+            /// Tops up m_pending from the input until it holds need bytes
+            bool gather(const uint8_t*& data, size_t& size, size_t need)
+            {
+                const size_t take = std::min(size, need - m_pending.size());
+                m_pending.insert(m_pending.end(), data, data + take);
+                data += take;
+                size -= take;
+                return m_pending.size() == need;
+            }
+
+            bool consume(const uint8_t* data, size_t size, std::vector<float>& samples)
+            {
+                while (size > 0)
+                {
+                    switch (m_state)
+                    {
+                        case State::Header:
+                            if (gather(data, size, 12))
+                            {
+                                if (!parseHeader())
+                                {
+                                    return false;
+                                }
+                                m_pending.clear();
+                                m_state = State::ChunkHeader;
+                            }
+                            break;
+
+                        case State::ChunkHeader:
+                            if (gather(data, size, 8))
+                            {
+                                if (!beginChunk())
+                                {
+                                    return false;
+                                }
+                            }
+                            break;
+
+                        case State::ChunkBody:
+                            if (gather(data, size, m_chunk_size))
+                            {
+                                if (!parseChunk())
+                                {
+                                    return false;
+                                }
+                            }
+                            break;
+
+                        case State::Skip:
+                        {
+                            const uint64_t take = std::min<uint64_t>(size, m_skip);
+                            data += take;
+                            size -= static_cast<size_t>(take);
+                            m_skip -= take;
+                            if (m_skip == 0)
+                            {
+                                m_state = m_after_skip;
+                            }
+                            break;
+                        }
+
+                        case State::Data:
+                            decodeData(data, size, samples);
+                            break;
+
+                        case State::Trailer:
+                            return true;
+                    }
+                }
+                return true;
+            }
+
+            bool parseHeader()
+            {
+                const uint8_t* header = m_pending.data();
+                if (m_aiff)
+                {
+                    m_aifc = tagIs(header + 8, "AIFC");
+                    return tagIs(header, "FORM") && (m_aifc || tagIs(header + 8, "AIFF"));
+                }
+                m_rf64 = tagIs(header, "RF64");
+                return (m_rf64 || tagIs(header, "RIFF")) && tagIs(header + 8, "WAVE");
+            }
+
+            bool beginChunk()
+            {
+                std::memcpy(m_chunk_id, m_pending.data(), 4);
+                const uint32_t size = m_aiff ? readBe32(m_pending.data() + 4) : readLe32(m_pending.data() + 4);
+                m_pending.clear();
+
+                // Chunks are padded to an even size
+                const uint64_t padded = static_cast<uint64_t>(size) + (size & 1);
+                const bool format = m_aiff ? tagIs(m_chunk_id, "COMM") : (tagIs(m_chunk_id, "fmt ") || tagIs(m_chunk_id, "ds64"));
+                if (format || (m_aiff && tagIs(m_chunk_id, "SSND")))
+                {
+                    if (padded > MAX_FORMAT_CHUNK && format)
+                    {
+                        return false;
+                    }
+                    // Only the SSND offset/block-size preamble is collected
+                    m_chunk_size = format ? static_cast<size_t>(padded) : 8;
+                    m_chunk_remainder = padded - m_chunk_size;
+                    m_data_size = size;
+                    m_state = State::ChunkBody;
+                    return m_chunk_size > 0 || parseChunk();
+                }
+                if (!m_aiff && tagIs(m_chunk_id, "data"))
+                {
+                    if (!m_info)
+                    {
+                        return false;
+                    }
+                    std::optional<uint64_t> length = size;
+                    if (size == 0xFFFFFFFFu)
+                    {
+                        length = m_rf64 && m_ds64_data_size ? std::optional<uint64_t>(m_ds64_data_size) : std::nullopt;
+                    }
+                    startData(length, 0);
+                    return true;
+                }
+                skip(padded, State::ChunkHeader);
+                return true;
+            }
+
+            bool parseChunk()
+            {
+                const uint8_t* body = m_pending.data();
+                const size_t size = m_pending.size();
+                bool ok = true;
+                if (tagIs(m_chunk_id, "fmt "))
+                {
+                    ok = parseWaveFormat(body, size);
+                }
+                else if (tagIs(m_chunk_id, "ds64"))
+                {
+                    if (size >= 16)
+                    {
+                        m_ds64_data_size = readLe64(body + 8);
+                    }
+                }
+                else if (tagIs(m_chunk_id, "COMM"))
+                {
+                    ok = parseAiffCommon(body, size);
+                }
+                else if (tagIs(m_chunk_id, "SSND"))
+                {
+                    const uint32_t offset = readBe32(body);
+                    if (!m_info || m_data_size < 8 + static_cast<uint64_t>(offset))
+                    {
+                        return false;
+                    }
+                    m_pending.clear();
+                    startData(m_data_size - 8 - offset, offset);
+                    return true;
+                }
+                m_pending.clear();
+                skip(m_chunk_remainder, State::ChunkHeader);
+                return ok;
+            }
+
+            bool parseWaveFormat(const uint8_t* body, size_t size)
+            {
+                if (size < 16)
+                {
+                    return false;
+                }
+                uint16_t tag = readLe16(body);
+                const uint16_t channels = readLe16(body + 2);
+                const uint32_t rate = readLe32(body + 4);
+                const uint16_t block_align = readLe16(body + 12);
+                uint16_t bits = readLe16(body + 14);
+                if (tag == 0xFFFE)
+                {
+                    // WAVE_FORMAT_EXTENSIBLE: the real tag opens the sub-format GUID
+                    if (size < 40)
+                    {
+                        return false;
+                    }
+                    bits = readLe16(body + 18) ? readLe16(body + 18) : bits;
+                    tag = readLe16(body + 24);
+                }
+                if (channels == 0 || rate == 0 || block_align % channels != 0)
+                {
+                    return false;
+                }
+
+                m_layout.channels = channels;
+                m_layout.bytes = block_align / channels;
+                m_layout.big_endian = false;
+                if (tag == 1 && m_layout.bytes >= 1 && m_layout.bytes <= 4)
+                {
+                    m_layout.coding = m_layout.bytes == 1 ? PcmLayout::Coding::Unsigned : PcmLayout::Coding::Signed;
+                }
+                else if (tag == 3 && (m_layout.bytes == 4 || m_layout.bytes == 8))
+                {
+                    m_layout.coding = PcmLayout::Coding::Float;
+                }
+                else
+                {
+                    return false;
+                }
+
+                AudioStreamInfo info;
+                info.sample_rate = rate;
+                info.channels = channels;
+                info.bits_per_sample = bits;
+                m_info = info;
+                return true;
+            }
+
+            bool parseAiffCommon(const uint8_t* body, size_t size)
+            {
+                if (size < 18)
+                {
+                    return false;
+                }
+                const uint16_t channels = readBe16(body);
+                const uint32_t frames = readBe32(body + 2);
+                const uint16_t bits = readBe16(body + 6);
+                const double rate = readExtended80(body + 8);
+                if (channels == 0 || bits == 0 || bits > 32 || !(rate >= 1.0 && rate < 4294967296.0))
+                {
+                    return false;
+                }
+
+                m_layout.channels = channels;
+                m_layout.bytes = (bits + 7) / 8;
+                m_layout.big_endian = true;
+                m_layout.coding = PcmLayout::Coding::Signed;
+                if (m_aifc)
+                {
+                    if (size < 22)
+                    {
+                        return false;
+                    }
+                    const uint8_t* compression = body + 18;
+                    if (tagIs(compression, "sowt"))
+                    {
+                        m_layout.big_endian = false;
+                    }
+                    else if (tagIs(compression, "fl32") || tagIs(compression, "FL32"))
+                    {
+                        m_layout.coding = PcmLayout::Coding::Float;
+                        m_layout.bytes = 4;
+                    }
+                    else if (tagIs(compression, "fl64") || tagIs(compression, "FL64"))
+                    {
+                        m_layout.coding = PcmLayout::Coding::Float;
+                        m_layout.bytes = 8;
+                    }
+                    else if (!tagIs(compression, "NONE") && !tagIs(compression, "twos"))
+                    {
+                        return false;
+                    }
+                }
+
+                AudioStreamInfo info;
+                info.sample_rate = static_cast<uint32_t>(std::lround(rate));
+                info.channels = channels;
+                info.bits_per_sample = m_layout.coding == PcmLayout::Coding::Float
+                    ? static_cast<uint16_t>(m_layout.bytes * 8) : bits;
+                info.frames = frames;
+                m_info = info;
+                return true;
+            }
+
+            void skip(uint64_t bytes, State next)
+            {
+                m_skip = bytes;
+                m_after_skip = next;
+                m_state = bytes > 0 ? State::Skip : next;
+            }
+
+            void startData(std::optional<uint64_t> length, uint64_t leading)
+            {
+                m_data_left = length;
+                if (length && !m_info->frames)
+                {
+                    m_info->frames = *length / m_layout.frameBytes();
+                }
+                skip(leading, State::Data);
+                if (m_data_left && *m_data_left == 0)
+                {
+                    m_state = State::Trailer;
+                }
+            }
+
+            void decodeData(const uint8_t*& data, size_t& size, std::vector<float>& samples)
+            {
+                size_t usable = size;
+                if (m_data_left)
+                {
+                    usable = static_cast<size_t>(std::min<uint64_t>(usable, *m_data_left));
+                    *m_data_left -= usable;
+                }
+                const uint8_t* input = data;
+                data += usable;
+                size -= usable;
+
+                // Complete the frame split across the previous push
+                const size_t frame_bytes = m_layout.frameBytes();
+                if (!m_pending.empty())
+                {
+                    const size_t take = std::min(usable, frame_bytes - m_pending.size());
+                    m_pending.insert(m_pending.end(), input, input + take);
+                    input += take;
+                    usable -= take;
+                    if (m_pending.size() == frame_bytes)
+                    {
+                        convertPcm(m_pending.data(), 1, m_layout, samples);
+                        m_pending.clear();
+                    }
+                }
+
+                if (m_pending.empty())
+                {
+                    const size_t frames = usable / frame_bytes;
+                    convertPcm(input, frames, m_layout, samples);
+                    m_pending.assign(input + frames * frame_bytes, input + usable);
+                }
+
+                if (m_data_left && *m_data_left == 0)
+                {
+                    m_state = State::Trailer;
+                }
+            }
+
+            const bool m_aiff;
+            bool m_aifc = false;
+            bool m_rf64 = false;
+            bool m_failed = false;
+
+            State m_state = State::Header;
+            State m_after_skip = State::ChunkHeader;
+            std::vector<uint8_t> m_pending;
+
+            uint8_t m_chunk_id[4] = {};
+            size_t m_chunk_size = 0;
+            uint64_t m_chunk_remainder = 0;
+            uint64_t m_data_size = 0;
+            uint64_t m_skip = 0;
+            uint64_t m_ds64_data_size = 0;
+
+            PcmLayout m_layout;
+
+            /// Bytes of sample data still expected, or std::nullopt if it runs to the end of the file
+            std::optional<uint64_t> m_data_left;
+        };
+
+        /**
+         * @class BitReader
+         * @brief MSB-first reader over a byte range that flags reads past its end
+         */
+        class BitReader
+        {
+        public:
+            BitReader(const uint8_t* data, size_t size) : m_data(data), m_bits(size * 8) {}
+
+            /// Reads up to 32 bits; past the end it returns 0 and sets overrun()
+            uint32_t read(unsigned count)
+            {
+                if (count == 0)
+                {
+                    return 0;
+                }
+                if (m_position + count > m_bits)
+                {
+                    m_overrun = true;
+                    m_position = m_bits;
+                    return 0;
+                }
+                const size_t byte = m_position >> 3;
+                const size_t bytes = m_bits >> 3;
+                uint64_t window = 0;
+                for (size_t i = 0; i < 8; ++i)
+                {
+                    window = (window << 8) | (byte + i < bytes ? m_data[byte + i] : 0);
+                }
+                const uint32_t value = static_cast<uint32_t>((window << (m_position & 7)) >> (64 - count));
+                m_position += count;
+                return value;
+            }
+
+            int32_t readSigned(unsigned count)
+            {
+                int64_t value = read(count);
+                if (count > 0 && ((value >> (count - 1)) & 1))
+                {
+                    value -= int64_t(1) << count;
+                }
+                return static_cast<int32_t>(value);
+            }
+
+            /// Counts zero bits up to and including the terminating one
+            uint32_t readUnary()
+            {
+                uint32_t zeros = 0;
+                while (m_position < m_bits)
+                {
+                    const unsigned offset = m_position & 7;
+                    const uint8_t byte = static_cast<uint8_t>(m_data[m_position >> 3] << offset);
+                    if (byte == 0)
+                    {
+                        zeros += 8 - offset;
+                        m_position += 8 - offset;
+                        continue;
+                    }
+                    unsigned leading = 0;
+                    while (!(byte & (0x80 >> leading)))
+                    {
+                        ++leading;
+                    }
+                    zeros += leading;
+                    m_position += leading + 1;
+                    return zeros;
+                }
+                m_overrun = true;
+                return 0;
+            }
+
+            void alignToByte() { m_position = std::min(m_bits, (m_position + 7) & ~size_t(7)); }
+
+            size_t bytePosition() const { return m_position >> 3; }
+            bool overrun() const { return m_overrun; }
+
+        private:
+            const uint8_t* m_data;
+            size_t m_bits;
+            size_t m_position = 0;
+            bool m_overrun = false;
+        };
+
+        /// CRC-8 (polynomial 0x07) protecting a FLAC frame header
+        uint8_t flacCrc8(const uint8_t* data, size_t size)
+        {
+            static const auto table = []()
+            {
+                std::array<uint8_t, 256> entries{};
+                for (unsigned i = 0; i < 256; ++i)
+                {
+                    uint8_t crc = static_cast<uint8_t>(i);
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+                    }
+                    entries[i] = crc;
+                }
+                return entries;
+            }();
+            uint8_t crc = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                crc = table[crc ^ data[i]];
+            }
+            return crc;
+        }
+
+        /// CRC-16 (polynomial 0x8005) protecting a whole FLAC frame
+        uint16_t flacCrc16(const uint8_t* data, size_t size)
+        {
+            static const auto table = []()
+            {
+                std::array<uint16_t, 256> entries{};
+                for (unsigned i = 0; i < 256; ++i)
+                {
+                    uint16_t crc = static_cast<uint16_t>(i << 8);
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+                    }
+                    entries[i] = crc;
+                }
+                return entries;
+            }();
+            uint16_t crc = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+            }
+            return crc;
+        }
+
+        /**
+         * @class FlacDecoder
+         * @brief FLAC: metadata blocks followed by independently decodable frames
+         *
+         * Frames are decoded once enough bytes are buffered. STREAMINFO's
+         * maximum frame size tells when a frame is surely complete; without
+         * it, a frame that runs out of bytes is retried once the buffer has
+         * doubled, which keeps the wasted work linear.
+         */
+        class FlacDecoder : public AudioDecoder
+        {
+        public:
+            bool push(const uint8_t* data, size_t size, std::vector<float>& samples) override
+            {
+                if (m_failed)
+                {
+                    return false;
+                }
+                m_pending.insert(m_pending.end(), data, data + size);
+                m_failed = !process(samples, false);
+                return !m_failed;
+            }
+
+            bool finish(std::vector<float>& samples) override
+            {
+                if (m_failed)
+                {
+                    return false;
+                }
+                m_failed = !process(samples, true);
+                return !m_failed && m_state == State::Frames;
+            }
+
+        private:
+            enum class State { Magic, BlockHeader, BlockBody, Frames };
+            enum class FrameResult { Decoded, NeedMore, Invalid };
+
+            static constexpr size_t MAX_CHANNELS = 8;
+
+            bool process(std::vector<float>& samples, bool final)
+            {
+                while (m_state != State::Frames)
+                {
+                    const size_t available = m_pending.size() - m_offset;
+                    const uint8_t* head = m_pending.data() + m_offset;
+                    if (m_state == State::Magic)
+                    {
+                        if (available < 4)
+                        {
+                            return !final;
+                        }
+                        if (!tagIs(head, "fLaC"))
+                        {
+                            return false;
+                        }
+                        m_offset += 4;
+                        m_state = State::BlockHeader;
+                    }
+                    else if (m_state == State::BlockHeader)
+                    {
+                        if (available < 4)
+                        {
+                            return !final;
+                        }
+                        m_last_block = (head[0] & 0x80) != 0;
+                        m_block_type = head[0] & 0x7F;
+                        m_block_size = (static_cast<size_t>(head[1]) << 16) | (head[2] << 8) | head[3];
+                        m_offset += 4;
+                        m_state = State::BlockBody;
+                    }
+                    else
+                    {
+                        if (m_block_type != 0)
+                        {
+                            // Other blocks (tags, pictures) are dropped as they arrive
+                            const size_t skipped = std::min(available, m_block_size);
+                            m_offset += skipped;
+                            m_block_size -= skipped;
+                        }
+                        else if (available >= m_block_size)
+                        {
+                            if (!parseStreamInfo(head, m_block_size))
+                            {
+                                return false;
+                            }
+                            m_offset += m_block_size;
+                            m_block_size = 0;
+                        }
+                        if (m_block_size > 0)
+                        {
+                            compact();
+                            return !final;
+                        }
+                        if (m_last_block)
+                        {
+                            if (!m_info)
+                            {
+                                return false;
+                            }
+                            m_state = State::Frames;
+                        }
+                        else
+                        {
+                            m_state = State::BlockHeader;
+                        }
+                    }
+                }
+
+                while (true)
+                {
+                    const size_t available = m_pending.size() - m_offset;
+                    if (available == 0 || (!final && available < m_retry_at))
+                    {
+                        break;
+                    }
+                    const uint8_t* frame = m_pending.data() + m_offset;
+                    if (final && (available < 2 || frame[0] != 0xFF || (frame[1] & 0xFE) != 0xF8))
+                    {
+                        // Trailing bytes that are not a frame (e.g. an ID3v1 tag)
+                        m_offset = m_pending.size();
+                        break;
+                    }
+
+                    size_t used = 0;
+                    const FrameResult result = decodeFrame(frame, available, samples, used);
+                    if (result == FrameResult::Invalid)
+                    {
+                        return false;
+                    }
+                    if (result == FrameResult::NeedMore)
+                    {
+                        if (final)
+                        {
+                            return false;
+                        }
+                        m_retry_at = available * 2;
+                        break;
+                    }
+                    m_offset += used;
+                    m_retry_at = m_max_frame_size;
+                }
+
+                compact();
+                return true;
+            }
+
+            /// Drops consumed bytes once they dominate the buffer
+            void compact()
+            {
+                if (m_offset > 0 && m_offset * 2 >= m_pending.size())
+                {
+                    m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(m_offset));
+                    m_offset = 0;
+                }
+            }
+
+            bool parseStreamInfo(const uint8_t* body, size_t size)
+            {
+                if (size < 34)
+                {
+                    return false;
+                }
+                m_max_frame_size = (static_cast<size_t>(body[7]) << 16) | (body[8] << 8) | body[9];
+                const uint32_t rate = (static_cast<uint32_t>(body[10]) << 12) | (body[11] << 4) | (body[12] >> 4);
+                const unsigned channels = ((body[12] >> 1) & 0x07) + 1;
+                const unsigned bits = (((body[12] & 0x01) << 4) | (body[13] >> 4)) + 1;
+                uint64_t frames = body[13] & 0x0F;
+                for (int i = 14; i < 18; ++i)
+                {
+                    frames = (frames << 8) | body[i];
+                }
+                if (rate == 0 || bits < 4)
+                {
+                    return false;
+                }
+
+                AudioStreamInfo info;
+                info.sample_rate = rate;
+                info.channels = static_cast<uint16_t>(channels);
+                info.bits_per_sample = static_cast<uint16_t>(bits);
+                if (frames > 0)
+                {
+                    info.frames = frames;
+                }
+                m_info = info;
+                m_retry_at = m_max_frame_size;
+                return true;
+            }
+
+            FrameResult decodeFrame(const uint8_t* data, size_t size, std::vector<float>& samples, size_t& used)
+            {
+                // Fields read past the end come back as zeros and may look invalid
+                BitReader reader(data, size);
+                const FrameResult result = parseFrame(reader, data, samples, used);
+                return result == FrameResult::Invalid && reader.overrun() ? FrameResult::NeedMore : result;
+            }
+
+            FrameResult parseFrame(BitReader& reader, const uint8_t* data, std::vector<float>& samples, size_t& used)
+            {
+                if (reader.read(15) != 0x7FFC)
+                {
+                    return FrameResult::Invalid;
+                }
+                reader.read(1);  // Blocking strategy
+                const unsigned block_code = reader.read(4);
+                const unsigned rate_code = reader.read(4);
+                const unsigned channel_code = reader.read(4);
+                const unsigned bits_code = reader.read(3);
+                if (reader.read(1) != 0)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                // Frame or sample number, UTF-8 style
+                const uint32_t lead = reader.read(8);
+                unsigned continuation = 0;
+                while (continuation < 8 && (lead & (0x80 >> continuation)))
+                {
+                    ++continuation;
+                }
+                if (continuation == 1 || continuation == 8)
+                {
+                    return FrameResult::Invalid;
+                }
+                for (unsigned i = 1; i < continuation; ++i)
+                {
+                    if ((reader.read(8) & 0xC0) != 0x80)
+                    {
+                        return reader.overrun() ? FrameResult::NeedMore : FrameResult::Invalid;
+                    }
+                }
+
+                uint32_t block_size = 0;
+                if (block_code == 1)
+                {
+                    block_size = 192;
+                }
+                else if (block_code >= 2 && block_code <= 5)
+                {
+                    block_size = 576u << (block_code - 2);
+                }
+                else if (block_code == 6)
+                {
+                    block_size = reader.read(8) + 1;
+                }
+                else if (block_code == 7)
+                {
+                    block_size = reader.read(16) + 1;
+                }
+                else if (block_code >= 8)
+                {
+                    block_size = 256u << (block_code - 8);
+                }
+                else
+                {
+                    return FrameResult::Invalid;
+                }
+
+                if (rate_code == 12)
+                {
+                    reader.read(8);
+                }
+                else if (rate_code == 13 || rate_code == 14)
+                {
+                    reader.read(16);
+                }
+                else if (rate_code == 15)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                static const unsigned BITS[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+                const unsigned bits = bits_code == 0 ? m_info->bits_per_sample : BITS[bits_code];
+                if (bits == 0)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                const size_t header_bytes = reader.bytePosition();
+                const uint8_t crc8 = static_cast<uint8_t>(reader.read(8));
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (crc8 != flacCrc8(data, header_bytes))
+                {
+                    return FrameResult::Invalid;
+                }
+
+                const unsigned channels = channel_code < 8 ? channel_code + 1 : 2;
+                if (channel_code > 10 || channels != m_info->channels)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                for (unsigned channel = 0; channel < channels; ++channel)
+                {
+                    // The side channel of a stereo pair needs one extra bit
+                    const bool side = (channel_code == 8 && channel == 1) || (channel_code == 9 && channel == 0)
+                        || (channel_code == 10 && channel == 1);
+                    m_channels[channel].resize(block_size);
+                    const FrameResult result = decodeSubframe(reader, bits + (side ? 1 : 0), block_size,
+                        m_channels[channel].data());
+                    if (result != FrameResult::Decoded)
+                    {
+                        return result;
+                    }
+                }
+
+                reader.alignToByte();
+                const size_t body_bytes = reader.bytePosition();
+                const uint16_t crc16 = static_cast<uint16_t>(reader.read(16));
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (crc16 != flacCrc16(data, body_bytes))
+                {
+                    return FrameResult::Invalid;
+                }
+                used = body_bytes + 2;
+
+                decorrelate(channel_code, block_size);
+
+                const float scale = 1.0f / static_cast<float>(uint64_t(1) << (bits - 1));
+                const size_t first = samples.size();
+                samples.resize(first + static_cast<size_t>(block_size) * channels);
+                float* out = samples.data() + first;
+                for (uint32_t i = 0; i < block_size; ++i)
+                {
+                    for (unsigned channel = 0; channel < channels; ++channel)
+                    {
+                        *out++ = static_cast<float>(m_channels[channel][i]) * scale;
+                    }
+                }
+                return FrameResult::Decoded;
+            }
+
+            FrameResult decodeSubframe(BitReader& reader, unsigned bits, uint32_t block_size, int32_t* out)
+            {
+                if (reader.read(1) != 0)
+                {
+                    return reader.overrun() ? FrameResult::NeedMore : FrameResult::Invalid;
+                }
+                const unsigned type = reader.read(6);
+                unsigned wasted = 0;
+                if (reader.read(1))
+                {
+                    wasted = reader.readUnary() + 1;
+                }
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (wasted >= bits)
+                {
+                    return FrameResult::Invalid;
+                }
+                bits -= wasted;
+                if (bits > 32)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                if (type == 0)
+                {
+                    std::fill(out, out + block_size, reader.readSigned(bits));
+                }
+                else if (type == 1)
+                {
+                    for (uint32_t i = 0; i < block_size; ++i)
+                    {
+                        out[i] = reader.readSigned(bits);
+                    }
+                }
+                else if (type >= 8 && type <= 12)
+                {
+                    const FrameResult result = decodeFixed(reader, bits, block_size, type - 8, out);
+                    if (result != FrameResult::Decoded)
+                    {
+                        return result;
+                    }
+                }
+                else if (type >= 32)
+                {
+                    const FrameResult result = decodeLpc(reader, bits, block_size, type - 31, out);
+                    if (result != FrameResult::Decoded)
+                    {
+                        return result;
+                    }
+                }
+                else
+                {
+                    return FrameResult::Invalid;
+                }
+
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (wasted > 0)
+                {
+                    for (uint32_t i = 0; i < block_size; ++i)
+                    {
+                        out[i] = static_cast<int32_t>(static_cast<uint32_t>(out[i]) << wasted);
+                    }
+                }
+                return FrameResult::Decoded;
+            }
+
+            FrameResult decodeFixed(BitReader& reader, unsigned bits, uint32_t block_size, unsigned order, int32_t* out)
+            {
+                if (order > block_size)
+                {
+                    return FrameResult::Invalid;
+                }
+                for (unsigned i = 0; i < order; ++i)
+                {
+                    out[i] = reader.readSigned(bits);
+                }
+                const FrameResult result = decodeResidual(reader, block_size, order, out);
+                if (result != FrameResult::Decoded)
+                {
+                    return result;
+                }
+
+                for (uint32_t i = order; i < block_size; ++i)
+                {
+                    int64_t prediction = 0;
+                    switch (order)
+                    {
+                        case 1: prediction = out[i - 1]; break;
+                        case 2: prediction = 2 * int64_t(out[i - 1]) - out[i - 2]; break;
+                        case 3: prediction = 3 * (int64_t(out[i - 1]) - out[i - 2]) + out[i - 3]; break;
+                        case 4:
+                            prediction = 4 * (int64_t(out[i - 1]) + out[i - 3]) - 6 * int64_t(out[i - 2]) - out[i - 4];
+                            break;
+                        default: break;
+                    }
+                    out[i] = static_cast<int32_t>(out[i] + prediction);
+                }
+                return FrameResult::Decoded;
+            }
+
+            FrameResult decodeLpc(BitReader& reader, unsigned bits, uint32_t block_size, unsigned order, int32_t* out)
+            {
+                if (order > block_size)
+                {
+                    return FrameResult::Invalid;
+                }
+                for (unsigned i = 0; i < order; ++i)
+                {
+                    out[i] = reader.readSigned(bits);
+                }
+                const unsigned precision = reader.read(4) + 1;
+                const int shift = reader.readSigned(5);
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (precision == 16 || shift < 0)
+                {
+                    return FrameResult::Invalid;
+                }
+                int32_t coefficients[32];
+                for (unsigned i = 0; i < order; ++i)
+                {
+                    coefficients[i] = reader.readSigned(precision);
+                }
+                const FrameResult result = decodeResidual(reader, block_size, order, out);
+                if (result != FrameResult::Decoded)
+                {
+                    return result;
+                }
+
+                for (uint32_t i = order; i < block_size; ++i)
+                {
+                    int64_t sum = 0;
+                    for (unsigned j = 0; j < order; ++j)
+                    {
+                        sum += int64_t(coefficients[j]) * out[i - 1 - j];
+                    }
+                    out[i] = static_cast<int32_t>(out[i] + (sum >> shift));
+                }
+                return FrameResult::Decoded;
+            }
+
+            /// Decodes the Rice-coded residual into out[order..block_size)
+            FrameResult decodeResidual(BitReader& reader, uint32_t block_size, unsigned order, int32_t* out)
+            {
+                const unsigned method = reader.read(2);
+                const unsigned partition_order = reader.read(4);
+                if (reader.overrun())
+                {
+                    return FrameResult::NeedMore;
+                }
+                if (method > 1)
+                {
+                    return FrameResult::Invalid;
+                }
+                const unsigned parameter_bits = method == 0 ? 4 : 5;
+                const unsigned escape = method == 0 ? 15 : 31;
+                const uint32_t partitions = 1u << partition_order;
+                const uint32_t partition_size = block_size >> partition_order;
+                if ((block_size & (partitions - 1)) != 0 || partition_size < order)
+                {
+                    return FrameResult::Invalid;
+                }
+
+                uint32_t sample = order;
+                for (uint32_t partition = 0; partition < partitions; ++partition)
+                {
+                    const uint32_t end = (partition + 1) * partition_size;
+                    const unsigned parameter = reader.read(parameter_bits);
+                    if (parameter == escape)
+                    {
+                        const unsigned raw_bits = reader.read(5);
+                        for (; sample < end; ++sample)
+                        {
+                            out[sample] = reader.readSigned(raw_bits);
+                        }
+                    }
+                    else
+                    {
+                        for (; sample < end; ++sample)
+                        {
+                            const uint64_t quotient = reader.readUnary();
+                            const uint64_t folded = (quotient << parameter) | reader.read(parameter);
+                            out[sample] = static_cast<int32_t>((folded >> 1) ^ (~(folded & 1) + 1));
+                        }
+                    }
+                    if (reader.overrun())
+                    {
+                        return FrameResult::NeedMore;
+                    }
+                }
+                return FrameResult::Decoded;
+            }
+
+            void decorrelate(unsigned channel_code, uint32_t block_size)
+            {
+                int32_t* left = m_channels[0].data();
+                int32_t* right = m_channels[1].data();
+                for (uint32_t i = 0; channel_code >= 8 && i < block_size; ++i)
+                {
+                    if (channel_code == 8)
+                    {
+                        right[i] = left[i] - right[i];
+                    }
+                    else if (channel_code == 9)
+                    {
+                        left[i] = left[i] + right[i];
+                    }
+                    else
+                    {
+                        const int64_t side = right[i];
+                        const int64_t mid = (int64_t(left[i]) * 2) | (side & 1);
+                        left[i] = static_cast<int32_t>((mid + side) >> 1);
+                        right[i] = static_cast<int32_t>((mid - side) >> 1);
+                    }
+                }
+            }
+
+            State m_state = State::Magic;
+            bool m_failed = false;
+
+            std::vector<uint8_t> m_pending;
+            size_t m_offset = 0;
+            size_t m_retry_at = 0;
+            size_t m_max_frame_size = 0;
+
+            bool m_last_block = false;
+            unsigned m_block_type = 0;
+            size_t m_block_size = 0;
+
+            std::array<std::vector<int32_t>, MAX_CHANNELS> m_channels;
+        };
+    }
+
+    /**
+     * @brief Creates a decoder for a container format
+     *
+     * @param format Format of the file, e.g. from sniffAudioFormat()
+     * @return std::unique_ptr<AudioDecoder> Decoder, or nullptr if the format cannot be decoded
+     */
+    std::unique_ptr<AudioDecoder> AudioDecoder::create(AudioFormat format)
+    {
+        switch (format)
+        {
+            case AudioFormat::Wav:  return std::make_unique<ChunkedPcmDecoder>(false);
+            case AudioFormat::Aiff: return std::make_unique<ChunkedPcmDecoder>(true);
+            case AudioFormat::Flac: return std::make_unique<FlacDecoder>();
+            default: break;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Decodes a file from disk in blocks, for tools that analyse a library
+     *
+     * @param path WAV, AIFF or FLAC file
+     * @param consumer Called after each block is read, once the stream layout is
+     *                 known, with the frames decoded from it (possibly none);
+     *                 returns false to stop
+     * @return bool True if the whole file was decoded and the consumer never stopped it
+     */
+    bool decodeAudioFile(const std::string& path,
+                         const std::function<bool(const AudioStreamInfo& info, const float* samples, size_t frames)>& consumer)
+    {
+        constexpr size_t READ_BLOCK_BYTES = 64 * 1024;
+
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> bytes(READ_BLOCK_BYTES);
+        auto readBlock = [&]() {
+            in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            return static_cast<size_t>(in.gcount());
+        };
+
+        size_t received = readBlock();
+        auto decoder = AudioDecoder::create(sniffAudioFormat(bytes.data(), received));
+        if (!decoder)
+        {
+            return false;
+        }
+
+        std::vector<float> samples;
+        auto deliver = [&]() {
+            const auto& info = decoder->info();
+            if (!info || info->channels == 0)
+            {
+                return samples.empty();
+            }
+            const bool more = consumer(*info, samples.data(), samples.size() / info->channels);
+            samples.clear();
+            return more;
+        };
+
+        while (received > 0)
+        {
+            if (!decoder->push(bytes.data(), received, samples) || !deliver())
+            {
+                return false;
+            }
+            received = readBlock();
+        }
+        return !in.bad() && decoder->finish(samples) && deliver() && decoder->info();
+    }
+}
@@ -0,0 +1,555 @@
+/**
+ * @file src/audio_features.cpp
+ * @brief Implementation of the FFT, the feature extractor and feature files
+ *
+ * @see include/audio_features.h
+ */
+
+#include "audio_features.h"
+#include "atomic_file.h"
+#include "audio_decoder.h"
+#include "audio_kernels.h"
+#include "resampler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        constexpr double PI = 3.14159265358979323846;
+
+        /// Header: magic, frames, Nyquist frequency, value count; then the values
+        const char FEATURE_MAGIC[8] = {'F', 'S', 'F', 'E', 'A', 'T', '0', '1'};
+        constexpr size_t FEATURE_HEADER_SIZE = 24;
+
+        /// Frames whose mean windowed power is below -100 dBFS do not count
+        constexpr double SILENCE_POWER = 1e-10;
+
+        /// Keeps the logarithms finite for empty bins and bands
+        constexpr float LOG_FLOOR = 1e-10f;
+
+        double hzToMel(double hz)
+        {
+            return 2595.0 * std::log10(1.0 + hz / 700.0);
+        }
+
+        double melToHz(double mel)
+        {
+            return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+        }
+    }
+
+    /**
+     * @brief Precomputes the twiddle factors and bit-reversal permutation
+     *
+     * @param size Frame length
+     * @throws std::invalid_argument If size is not a power of two of at least 4
+     */
+    RealFft::RealFft(size_t size)
+        : m_size(size), m_half(size / 2)
+    {
+        if (size < 4 || (size & (size - 1)) != 0)
+        {
+            throw std::invalid_argument("RealFft size must be a power of two of at least 4");
+        }
+
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < m_half)
+        {
+            ++bits;
+        }
+        m_reversed.resize(m_half);
+        for (size_t i = 0; i < m_half; ++i)
+        {
+            uint32_t reversed = 0;
+            for (unsigned b = 0; b < bits; ++b)
+            {
+                reversed |= static_cast<uint32_t>((i >> b) & 1) << (bits - 1 - b);
+            }
+            m_reversed[i] = reversed;
+        }
+
+        m_stage_re.resize(m_half);
+        m_stage_im.resize(m_half);
+        for (size_t span = 1; span < m_half; span *= 2)
+        {
+            for (size_t k = 0; k < span; ++k)
+            {
+                const double angle = -PI * static_cast<double>(k) / static_cast<double>(span);
+                m_stage_re[span - 1 + k] = static_cast<float>(std::cos(angle));
+                m_stage_im[span - 1 + k] = static_cast<float>(std::sin(angle));
+            }
+        }
+
+        m_split_re.resize(m_half + 1);
+        m_split_im.resize(m_half + 1);
+        for (size_t k = 0; k <= m_half; ++k)
+        {
+            const double angle = -2.0 * PI * static_cast<double>(k) / static_cast<double>(m_size);
+            m_split_re[k] = static_cast<float>(std::cos(angle));
+            m_split_im[k] = static_cast<float>(std::sin(angle));
+        }
+
+        m_re.resize(m_half);
+        m_im.resize(m_half);
+    }
+
+    /**
+     * @brief Computes |X[k]|^2 for k = 0 .. size/2
+     *
+     * Even samples form the real and odd samples the imaginary part of a
+     * half-length complex sequence. After its FFT Z, the spectra of the
+     * even and odd samples are E[k] = (Z[k] + conj(Z[-k])) / 2 and
+     * O[k] = (Z[k] - conj(Z[-k])) / 2i, and X[k] = E[k] + exp(-2 pi i k / N) O[k].
+     *
+     * @param frame size real samples
+     * @param power Receives size/2 + 1 values
+     */
+    void RealFft::powerSpectrum(const float* frame, float* power)
+    {
+        for (size_t i = 0; i < m_half; ++i)
+        {
+            m_re[m_reversed[i]] = frame[2 * i];
+            m_im[m_reversed[i]] = frame[2 * i + 1];
+        }
+
+        for (size_t span = 1; span < m_half; span *= 2)
+        {
+            for (size_t block = 0; block < m_half; block += 2 * span)
+            {
+                fftButterflies(m_re.data() + block, m_im.data() + block,
+                               m_re.data() + block + span, m_im.data() + block + span,
+                               m_stage_re.data() + span - 1, m_stage_im.data() + span - 1, span);
+            }
+        }
+
+        for (size_t k = 0; k <= m_half; ++k)
+        {
+            const size_t forward = k % m_half;
+            const size_t mirror = (m_half - k) % m_half;
+            const float z_re = m_re[forward];
+            const float z_im = m_im[forward];
+            const float c_re = m_re[mirror];
+            const float c_im = -m_im[mirror];
+
+            const float even_re = 0.5f * (z_re + c_re);
+            const float even_im = 0.5f * (z_im + c_im);
+            const float odd_re = 0.5f * (z_im - c_im);
+            const float odd_im = -0.5f * (z_re - c_re);
+
+            const float x_re = even_re + m_split_re[k] * odd_re - m_split_im[k] * odd_im;
+            const float x_im = even_im + m_split_re[k] * odd_im + m_split_im[k] * odd_re;
+            power[k] = x_re * x_re + x_im * x_im;
+        }
+    }
+
+    /**
+     * @brief Returns the fixed-length vector used to compare sounds
+     */
+    std::array<float, AudioFeatures::EMBEDDING_SIZE> AudioFeatures::embedding() const
+    {
+        std::array<float, EMBEDDING_SIZE> values{};
+        std::copy(mfcc_mean.begin(), mfcc_mean.end(), values.begin());
+        std::copy(mfcc_std.begin(), mfcc_std.end(), values.begin() + MFCC_COUNT);
+        const float scale = nyquist > 0.0f ? 1.0f / nyquist : 0.0f;
+        values[2 * MFCC_COUNT] = centroid_mean * scale;
+        values[2 * MFCC_COUNT + 1] = centroid_std * scale;
+        values[2 * MFCC_COUNT + 2] = flatness_mean;
+        values[2 * MFCC_COUNT + 3] = flatness_std;
+        return values;
+    }
+
+    /**
+     * @brief Writes the features to a small binary file
+     *
+     * @param path Destination, usually featurePathFor() of the sound
+     * @param sync_first Flush the file to stable storage before it appears
+     * @return bool True if the file was written
+     */
+    bool AudioFeatures::save(const std::string& path, bool sync_first) const
+    {
+        std::array<float, EMBEDDING_SIZE> values = embedding();
+        values[2 * MFCC_COUNT] = centroid_mean;
+        values[2 * MFCC_COUNT + 1] = centroid_std;
+
+        const uint32_t count = EMBEDDING_SIZE;
+        uint8_t out[FEATURE_HEADER_SIZE + EMBEDDING_SIZE * sizeof(float)];
+        std::memcpy(out, FEATURE_MAGIC, sizeof(FEATURE_MAGIC));
+        std::memcpy(out + 8, &frames, 8);
+        std::memcpy(out + 16, &nyquist, 4);
+        std::memcpy(out + 20, &count, 4);
+        std::memcpy(out + FEATURE_HEADER_SIZE, values.data(), sizeof(float) * EMBEDDING_SIZE);
+
+        AtomicFile file;
+        if (!file.open(path) || !file.write(out, sizeof(out)))
+        {
+            file.abort();
+            return false;
+        }
+        return file.commit(sync_first);
+    }
+
+    /**
+     * @brief Reads a file written by save()
+     *
+     * @param path Feature file
+     * @return std::optional<AudioFeatures> Features, or std::nullopt if the file is missing or malformed
+     */
+    std::optional<AudioFeatures> AudioFeatures::load(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (bytes.size() != FEATURE_HEADER_SIZE + EMBEDDING_SIZE * sizeof(float)
+            || std::memcmp(bytes.data(), FEATURE_MAGIC, sizeof(FEATURE_MAGIC)) != 0)
+        {
+            return std::nullopt;
+        }
+
+        uint32_t count = 0;
+        std::memcpy(&count, bytes.data() + 20, 4);
+        if (count != EMBEDDING_SIZE)
+        {
+            return std::nullopt;
+        }
+
+        AudioFeatures features;
+        std::array<float, EMBEDDING_SIZE> values;
+        std::memcpy(&features.frames, bytes.data() + 8, 8);
+        std::memcpy(&features.nyquist, bytes.data() + 16, 4);
+        std::memcpy(values.data(), bytes.data() + FEATURE_HEADER_SIZE, sizeof(float) * EMBEDDING_SIZE);
+
+        std::copy(values.begin(), values.begin() + MFCC_COUNT, features.mfcc_mean.begin());
+        std::copy(values.begin() + MFCC_COUNT, values.begin() + 2 * MFCC_COUNT, features.mfcc_std.begin());
+        features.centroid_mean = values[2 * MFCC_COUNT];
+        features.centroid_std = values[2 * MFCC_COUNT + 1];
+        features.flatness_mean = values[2 * MFCC_COUNT + 2];
+        features.flatness_std = values[2 * MFCC_COUNT + 3];
+        return features;
+    }
+
+    /**
+     * @brief Prepares an extractor
+     *
+     * @param channels Interleaved channels per frame of the input
+     * @param sample_rate Rate of the input
+     * @param options Analysis parameters
+     * @throws std::invalid_argument If channels, sample_rate, analysis_rate, hop_size or mel_bands is zero,
+     *         fft_size is not a power of two of at least 64, or hop_size exceeds fft_size
+     */
+    FeatureExtractor::FeatureExtractor(uint16_t channels, uint32_t sample_rate, const FeatureOptions& options)
+        : m_channels(channels),
+          m_options(validated(channels, sample_rate, options)),
+          m_fft(options.fft_size)
+    {
+        if (sample_rate != options.analysis_rate)
+        {
+            m_resampler = std::make_unique<Resampler>(1, sample_rate, options.analysis_rate, ResamplerQuality::Fast);
+        }
+
+        const size_t size = options.fft_size;
+        const size_t bins = size / 2 + 1;
+        m_window.resize(size);
+        for (size_t n = 0; n < size; ++n)
+        {
+            m_window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * PI * static_cast<double>(n) / size));
+        }
+
+        // Triangular filters with centres equally spaced on the mel scale
+        const double bin_hz = static_cast<double>(options.analysis_rate) / size;
+        const double top_mel = hzToMel(options.analysis_rate / 2.0);
+        for (uint32_t b = 0; b < options.mel_bands; ++b)
+        {
+            const double lower = melToHz(top_mel * b / (options.mel_bands + 1));
+            const double centre = melToHz(top_mel * (b + 1) / (options.mel_bands + 1));
+            const double upper = melToHz(top_mel * (b + 2) / (options.mel_bands + 1));
+
+            MelBand band;
+            band.first_bin = static_cast<size_t>(std::ceil(lower / bin_hz));
+            for (size_t k = band.first_bin; k < bins && k * bin_hz < upper; ++k)
+            {
+                const double hz = k * bin_hz;
+                const double weight = hz <= centre ? (hz - lower) / (centre - lower) : (upper - hz) / (upper - centre);
+                band.weights.push_back(static_cast<float>(std::max(0.0, weight)));
+            }
+            if (band.weights.empty())
+            {
+                // Narrower than a bin: take the bin nearest the centre
+                band.first_bin = std::min(bins - 1, static_cast<size_t>(std::lround(centre / bin_hz)));
+                band.weights.push_back(1.0f);
+            }
+            m_bands.push_back(std::move(band));
+        }
+
+        // Orthonormal DCT-II
+        const size_t band_count = options.mel_bands;
+        m_dct.resize(AudioFeatures::MFCC_COUNT * band_count);
+        for (size_t i = 0; i < AudioFeatures::MFCC_COUNT; ++i)
+        {
+            const double scale = std::sqrt((i == 0 ? 1.0 : 2.0) / band_count);
+            for (size_t j = 0; j < band_count; ++j)
+            {
+                m_dct[i * band_count + j] = static_cast<float>(
+                    scale * std::cos(PI * static_cast<double>(i) * (j + 0.5) / band_count));
+            }
+        }
+
+        m_frame.resize(size);
+        m_power.resize(bins);
+        m_log_mel.resize(band_count);
+    }
+
+    FeatureExtractor::~FeatureExtractor() = default;
+
+    /**
+     * @brief Adds the next frames of the sound
+     *
+     * @param samples Interleaved frames following those added before
+     * @param frames Number of frames at samples
+     */
+    void FeatureExtractor::push(const float* samples, size_t frames)
+    {
+        const float* mono = samples;
+        if (m_channels > 1)
+        {
+            m_mixed.assign(samples, samples + frames * m_channels);
+            remapChannels(m_mixed, m_channels, 1);
+            mono = m_mixed.data();
+        }
+
+        if (m_resampler)
+        {
+            m_resampler->process(mono, frames, m_pending);
+        }
+        else
+        {
+            m_pending.insert(m_pending.end(), mono, mono + frames);
+        }
+        analyseFrames();
+    }
+
+    /**
+     * @brief Analyses what is still buffered and returns the summary
+     *
+     * @return AudioFeatures Features of all frames pushed
+     */
+    AudioFeatures FeatureExtractor::finish()
+    {
+        if (m_resampler)
+        {
+            m_resampler->flush(m_pending);
+        }
+        analyseFrames();
+
+        if (!m_analysed_any && m_pending.size() > m_pending_start)
+        {
+            std::vector<float> padded(m_pending.begin() + static_cast<std::ptrdiff_t>(m_pending_start), m_pending.end());
+            padded.resize(m_options.fft_size, 0.0f);
+            analyse(padded.data());
+        }
+
+        AudioFeatures features;
+        features.frames = m_frames;
+        features.nyquist = m_options.analysis_rate / 2.0f;
+        if (m_frames > 0)
+        {
+            std::array<float, AudioFeatures::MFCC_COUNT + 2> mean{};
+            std::array<float, AudioFeatures::MFCC_COUNT + 2> deviation{};
+            for (size_t i = 0; i < m_sum.size(); ++i)
+            {
+                const double average = m_sum[i] / static_cast<double>(m_frames);
+                const double variance = m_sum_squares[i] / static_cast<double>(m_frames) - average * average;
+                mean[i] = static_cast<float>(average);
+                deviation[i] = static_cast<float>(std::sqrt(std::max(0.0, variance)));
+            }
+            std::copy(mean.begin(), mean.begin() + AudioFeatures::MFCC_COUNT, features.mfcc_mean.begin());
+            std::copy(deviation.begin(), deviation.begin() + AudioFeatures::MFCC_COUNT, features.mfcc_std.begin());
+            features.centroid_mean = mean[AudioFeatures::MFCC_COUNT];
+            features.centroid_std = deviation[AudioFeatures::MFCC_COUNT];
+            features.flatness_mean = mean[AudioFeatures::MFCC_COUNT + 1];
+            features.flatness_std = deviation[AudioFeatures::MFCC_COUNT + 1];
+        }
+        return features;
+    }
+
+    /**
+     * @brief Checks the arguments of the constructor before any member is built from them
+     */
+    const FeatureOptions& FeatureExtractor::validated(uint16_t channels, uint32_t sample_rate,
+                                                      const FeatureOptions& options)
+    {
+        if (channels == 0 || sample_rate == 0 || options.analysis_rate == 0 || options.hop_size == 0
+            || options.mel_bands == 0 || options.fft_size < 64 || (options.fft_size & (options.fft_size - 1)) != 0
+            || options.hop_size > options.fft_size)
+        {
+            throw std::invalid_argument("FeatureExtractor needs channels, rates, mel bands, a power-of-two FFT size "
+                                        "of at least 64 and a hop no longer than the frame");
+        }
+        return options;
+    }
+
+    /**
+     * @brief Analyses every complete frame in the pending samples
+     */
+    void FeatureExtractor::analyseFrames()
+    {
+        while (m_pending.size() - m_pending_start >= m_options.fft_size)
+        {
+            analyse(m_pending.data() + m_pending_start);
+            m_pending_start += m_options.hop_size;
+        }
+
+        // Drop consumed samples once they outweigh the rest, so erasing stays cheap
+        if (m_pending_start > 0 && m_pending_start >= m_pending.size() - m_pending_start)
+        {
+            m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(m_pending_start));
+            m_pending_start = 0;
+        }
+    }
+
+    /**
+     * @brief Adds the descriptors of one frame to the running sums
+     *
+     * @param frame fft_size mono samples at the analysis rate
+     */
+    void FeatureExtractor::analyse(const float* frame)
+    {
+        m_analysed_any = true;
+
+        const size_t size = m_options.fft_size;
+        for (size_t n = 0; n < size; ++n)
+        {
+            m_frame[n] = frame[n] * m_window[n];
+        }
+        m_fft.powerSpectrum(m_frame.data(), m_power.data());
+
+        const size_t bins = m_power.size();
+        double total = 0.0;
+        double weighted = 0.0;
+        double log_sum = 0.0;
+        const double bin_hz = static_cast<double>(m_options.analysis_rate) / size;
+        for (size_t k = 1; k < bins; ++k)
+        {
+            total += m_power[k];
+            weighted += k * bin_hz * m_power[k];
+            log_sum += std::log(m_power[k] + LOG_FLOOR);
+        }
+
+        // Parseval: the one-sided power of a frame of mean square p is about p * size^2 / 2
+        if (total < SILENCE_POWER * size * size / 2)
+        {
+            return;
+        }
+
+        const double arithmetic = total / (bins - 1);
+        const double flatness = std::exp(log_sum / (bins - 1)) / arithmetic;
+        const double centroid = weighted / total;
+
+        const size_t band_count = m_bands.size();
+        for (size_t b = 0; b < band_count; ++b)
+        {
+            const MelBand& band = m_bands[b];
+            const size_t count = std::min(band.weights.size(), bins - band.first_bin);
+            m_log_mel[b] = std::log(dotProduct(m_power.data() + band.first_bin, band.weights.data(), count) + LOG_FLOOR);
+        }
+
+        for (size_t i = 0; i < AudioFeatures::MFCC_COUNT; ++i)
+        {
+            const double coefficient = dotProduct(m_dct.data() + i * band_count, m_log_mel.data(), band_count);
+            m_sum[i] += coefficient;
+            m_sum_squares[i] += coefficient * coefficient;
+        }
+        m_sum[AudioFeatures::MFCC_COUNT] += centroid;
+        m_sum_squares[AudioFeatures::MFCC_COUNT] += centroid * centroid;
+        m_sum[AudioFeatures::MFCC_COUNT + 1] += flatness;
+        m_sum_squares[AudioFeatures::MFCC_COUNT + 1] += flatness * flatness;
+        ++m_frames;
+    }
+
+    /**
+     * @brief Returns the path of the feature file kept next to an audio file
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.features`
+     */
+    std::string featurePathFor(const std::string& audio_path)
+    {
+        return std::filesystem::path(audio_path).replace_extension(".features").string();
+    }
+
+    /**
+     * @brief Decodes audio files in parallel and writes a feature file next to each
+     *
+     * @param paths WAV, AIFF or FLAC files
+     * @param options Analysis parameters
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::string> Paths whose features could not be extracted
+     */
+    std::vector<std::string> extractFeatureFiles(const std::vector<std::string>& paths,
+                                                 const FeatureOptions& options, unsigned threads)
+    {
+        // Reject bad options on the caller's thread rather than in a worker
+        FeatureExtractor validate(1, options.analysis_rate, options);
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+
+        std::vector<char> failed(paths.size(), 0);
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < paths.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                std::unique_ptr<FeatureExtractor> extractor;
+                const bool decoded = decodeAudioFile(paths[i],
+                    [&](const AudioStreamInfo& info, const float* samples, size_t frames) {
+                        if (!extractor)
+                        {
+                            if (info.sample_rate == 0)
+                            {
+                                return false;
+                            }
+                            extractor = std::make_unique<FeatureExtractor>(info.channels, info.sample_rate, options);
+                        }
+                        extractor->push(samples, frames);
+                        return true;
+                    });
+                failed[i] = !decoded || !extractor->finish().save(featurePathFor(paths[i]));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        if (threads > 0)
+        {
+            work();
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        std::vector<std::string> failures;
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            if (failed[i])
+            {
+                failures.push_back(paths[i]);
+            }
+        }
+        return failures;
+    }
+}
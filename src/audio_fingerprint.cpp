@@ -0,0 +1,779 @@
+/**
+ * @file src/audio_fingerprint.cpp
+ * @brief Implementation of the fingerprinter, the fingerprint index and batch fingerprinting
+ *
+ * Index file layout (little-endian):
+ *   header  32 bytes: magic, record count, sound count, reserved
+ *   records 12 bytes each (hash, sound ID, time), sorted by hash
+ *   sounds  8 bytes each (sound ID, hash count), sorted by sound ID
+ *
+ * @see include/audio_fingerprint.h
+ */
+
+#include "audio_fingerprint.h"
+#include "atomic_file.h"
+#include "audio_decoder.h"
+#include "audio_kernels.h"
+#include "resampler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        constexpr double PI = 3.14159265358979323846;
+
+        /// A peak is the loudest bin within this many bins and frames of itself
+        constexpr uint32_t PEAK_BINS = 16;
+        constexpr uint32_t PEAK_FRAMES = 8;
+        constexpr uint32_t RING_FRAMES = 2 * PEAK_FRAMES + 1;
+
+        /// Quietest peak, relative to a full-scale sine (about -60 dBFS)
+        constexpr double PEAK_FLOOR = 1e-7;
+
+        /// How far after a peak, in frames and bins, the peaks it is paired with may lie
+        constexpr uint32_t TARGET_FRAMES = 32;
+        constexpr uint32_t TARGET_BINS = 64;
+
+        /// Hashes more common than this are skipped by lookups
+        constexpr size_t MAX_POSTINGS = 10000;
+
+        const char INDEX_MAGIC[8] = {'F', 'S', 'F', 'P', 'R', '0', '0', '1'};
+        constexpr size_t INDEX_HEADER_SIZE = 32;
+        constexpr size_t RECORD_SIZE = 12;
+        constexpr size_t SOUND_SIZE = 8;
+
+        template <typename T>
+        T loadValue(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void storeValue(uint8_t* bytes, T value)
+        {
+            std::memcpy(bytes, &value, sizeof(T));
+        }
+
+        /**
+         * @brief Packs a peak pair into 24 bits: first bin, second bin, frames between them
+         */
+        uint32_t pairHash(uint32_t anchor_bin, uint32_t target_bin, uint32_t frames)
+        {
+            return ((anchor_bin & 0x1FF) << 15) | ((target_bin & 0x1FF) << 6) | (frames & 0x3F);
+        }
+
+        uint64_t voteKey(int sound_id, int32_t offset)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(sound_id)) << 32) | static_cast<uint32_t>(offset);
+        }
+
+        /**
+         * @brief Returns the records of a sorted record array that carry a hash
+         */
+        std::pair<size_t, size_t> recordRange(const uint8_t* records, size_t count, uint32_t hash)
+        {
+            size_t low = 0;
+            size_t high = count;
+            while (low < high)
+            {
+                const size_t middle = low + (high - low) / 2;
+                if (loadValue<uint32_t>(records + middle * RECORD_SIZE) < hash)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+            size_t end = low;
+            while (end < count && loadValue<uint32_t>(records + end * RECORD_SIZE) == hash)
+            {
+                ++end;
+            }
+            return {low, end};
+        }
+    }
+
+    /**
+     * @brief Prepares a fingerprinter
+     *
+     * @param channels Interleaved channels per frame of the input
+     * @param sample_rate Rate of the input
+     * @param options Analysis parameters
+     * @throws std::invalid_argument If channels, sample_rate, analysis_rate, hop_size or fan_out is zero,
+     *         fft_size is not a power of two from 64 to 1024, or hop_size exceeds fft_size
+     */
+    Fingerprinter::Fingerprinter(uint16_t channels, uint32_t sample_rate, const FingerprintOptions& options)
+        : m_channels(channels),
+          m_options(validated(channels, sample_rate, options)),
+          m_fft(options.fft_size)
+    {
+        if (sample_rate != options.analysis_rate)
+        {
+            m_resampler = std::make_unique<Resampler>(1, sample_rate, options.analysis_rate, ResamplerQuality::Fast);
+        }
+
+        const size_t size = options.fft_size;
+        m_window.resize(size);
+        for (size_t n = 0; n < size; ++n)
+        {
+            m_window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * PI * static_cast<double>(n) / size));
+        }
+        m_frame.resize(size);
+        m_spectra.resize(RING_FRAMES * (size / 2 + 1));
+        m_neighbourhood.resize(RING_FRAMES * (size / 2 + 1));
+    }
+
+    Fingerprinter::~Fingerprinter() = default;
+
+    /**
+     * @brief Adds the next frames of the sound
+     *
+     * @param samples Interleaved frames following those added before
+     * @param frames Number of frames at samples
+     */
+    void Fingerprinter::push(const float* samples, size_t frames)
+    {
+        const float* mono = samples;
+        if (m_channels > 1)
+        {
+            m_mixed.assign(samples, samples + frames * m_channels);
+            remapChannels(m_mixed, m_channels, 1);
+            mono = m_mixed.data();
+        }
+
+        if (m_resampler)
+        {
+            m_resampler->process(mono, frames, m_pending);
+        }
+        else
+        {
+            m_pending.insert(m_pending.end(), mono, mono + frames);
+        }
+        analyseFrames();
+    }
+
+    /**
+     * @brief Analyses what is still buffered and returns the fingerprint
+     *
+     * A sound shorter than one frame is analysed as one zero-padded frame.
+     *
+     * @return Fingerprint Hashes of all frames pushed (none for silence or very short sounds)
+     */
+    Fingerprint Fingerprinter::finish()
+    {
+        if (m_resampler)
+        {
+            m_resampler->flush(m_pending);
+        }
+        analyseFrames();
+
+        if (m_frames == 0 && m_pending.size() > m_pending_start)
+        {
+            std::vector<float> padded(m_pending.begin() + static_cast<std::ptrdiff_t>(m_pending_start), m_pending.end());
+            padded.resize(m_options.fft_size, 0.0f);
+            analyse(padded.data());
+        }
+
+        // The last frames have no successors left to compare with
+        for (uint32_t frame = m_frames > PEAK_FRAMES ? m_frames - PEAK_FRAMES : 0; frame < m_frames; ++frame)
+        {
+            pickPeaks(frame);
+        }
+
+        Fingerprint fingerprint;
+        fingerprint.frames = m_frames;
+        for (size_t i = 0; i < m_peaks.size(); ++i)
+        {
+            const Peak& anchor = m_peaks[i];
+            uint32_t paired = 0;
+            for (size_t j = i + 1; j < m_peaks.size() && paired < m_options.fan_out; ++j)
+            {
+                const Peak& target = m_peaks[j];
+                if (target.frame - anchor.frame > TARGET_FRAMES)
+                {
+                    break;
+                }
+                const uint32_t distance = target.bin > anchor.bin ? target.bin - anchor.bin : anchor.bin - target.bin;
+                if (target.frame > anchor.frame && distance <= TARGET_BINS)
+                {
+                    fingerprint.hashes.push_back({pairHash(anchor.bin, target.bin, target.frame - anchor.frame),
+                                                  anchor.frame});
+                    ++paired;
+                }
+            }
+        }
+        return fingerprint;
+    }
+
+    /**
+     * @brief Checks the arguments of the constructor before any member is built from them
+     */
+    const FingerprintOptions& Fingerprinter::validated(uint16_t channels, uint32_t sample_rate,
+                                                       const FingerprintOptions& options)
+    {
+        if (channels == 0 || sample_rate == 0 || options.analysis_rate == 0 || options.hop_size == 0
+            || options.fan_out == 0 || options.fft_size < 64 || options.fft_size > 1024
+            || (options.fft_size & (options.fft_size - 1)) != 0 || options.hop_size > options.fft_size)
+        {
+            throw std::invalid_argument("Fingerprinter needs channels, rates, a fan-out, a power-of-two FFT size "
+                                        "from 64 to 1024 and a hop no longer than the frame");
+        }
+        return options;
+    }
+
+    /**
+     * @brief Analyses every complete frame in the pending samples
+     */
+    void Fingerprinter::analyseFrames()
+    {
+        while (m_pending.size() - m_pending_start >= m_options.fft_size)
+        {
+            analyse(m_pending.data() + m_pending_start);
+            m_pending_start += m_options.hop_size;
+        }
+
+        // Drop consumed samples once they outweigh the rest, so erasing stays cheap
+        if (m_pending_start > 0 && m_pending_start >= m_pending.size() - m_pending_start)
+        {
+            m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(m_pending_start));
+            m_pending_start = 0;
+        }
+    }
+
+    /**
+     * @brief Adds the spectrum of one frame, deciding the peaks of the frame PEAK_FRAMES earlier
+     *
+     * @param frame fft_size mono samples at the analysis rate
+     */
+    void Fingerprinter::analyse(const float* frame)
+    {
+        const size_t size = m_options.fft_size;
+        const size_t bins = size / 2 + 1;
+        for (size_t n = 0; n < size; ++n)
+        {
+            m_frame[n] = frame[n] * m_window[n];
+        }
+
+        const size_t slot = (m_frames % RING_FRAMES) * bins;
+        float* power = m_spectra.data() + slot;
+        float* loudest = m_neighbourhood.data() + slot;
+        m_fft.powerSpectrum(m_frame.data(), power);
+        for (size_t k = 0; k < bins; ++k)
+        {
+            const size_t first = k > PEAK_BINS ? k - PEAK_BINS : 0;
+            const size_t last = std::min(bins - 1, k + PEAK_BINS);
+            loudest[k] = *std::max_element(power + first, power + last + 1);
+        }
+
+        ++m_frames;
+        if (m_frames > PEAK_FRAMES)
+        {
+            pickPeaks(m_frames - 1 - PEAK_FRAMES);
+        }
+    }
+
+    /**
+     * @brief Records the bins of a frame that are the loudest of their neighbourhood
+     *
+     * @param frame Frame whose successors within PEAK_FRAMES are analysed, or the last frames
+     */
+    void Fingerprinter::pickPeaks(uint32_t frame)
+    {
+        const size_t size = m_options.fft_size;
+        const size_t bins = size / 2 + 1;
+        const float floor = static_cast<float>(PEAK_FLOOR * static_cast<double>(size) * size);
+        const uint32_t first = frame > PEAK_FRAMES ? frame - PEAK_FRAMES : 0;
+        const uint32_t last = std::min(m_frames - 1, frame + PEAK_FRAMES);
+
+        const float* power = m_spectra.data() + (frame % RING_FRAMES) * bins;
+        const float* loudest = m_neighbourhood.data() + (frame % RING_FRAMES) * bins;
+        for (size_t k = 1; k + 1 < bins; ++k)
+        {
+            const float value = power[k];
+            if (value < floor || value < loudest[k])
+            {
+                continue;
+            }
+
+            // Ties go to the earlier frame, so a steady tone gives one peak rather than many
+            bool peak = true;
+            for (uint32_t other = first; other <= last && peak; ++other)
+            {
+                const float neighbour = m_neighbourhood[(other % RING_FRAMES) * bins + k];
+                peak = other == frame || (other < frame ? value > neighbour : value >= neighbour);
+            }
+            if (peak)
+            {
+                m_peaks.push_back({frame, static_cast<uint32_t>(k)});
+            }
+        }
+    }
+
+    /**
+     * @brief Adds the fingerprint of a sound
+     *
+     * @param sound_id Freesound sound ID
+     * @param fingerprint Its fingerprint
+     * @return bool True if added; false if the sound is already indexed
+     */
+    bool FingerprintIndex::insert(int sound_id, const Fingerprint& fingerprint)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (containsLocked(sound_id))
+        {
+            return false;
+        }
+        insertLocked(sound_id, fingerprint);
+        return true;
+    }
+
+    /**
+     * @brief Adds a sound unless it duplicates one already indexed
+     *
+     * @param sound_id Freesound sound ID
+     * @param fingerprint Its fingerprint
+     * @param min_score Score from which a match counts as a duplicate
+     * @return std::optional<FingerprintMatch> The sound it duplicates (and it was not added),
+     *         or std::nullopt if it was added or was already indexed
+     */
+    std::optional<FingerprintMatch> FingerprintIndex::insertIfUnique(int sound_id, const Fingerprint& fingerprint,
+                                                                     float min_score)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (containsLocked(sound_id))
+        {
+            return std::nullopt;
+        }
+        const auto matches = matchLocked(fingerprint, 1);
+        if (!matches.empty() && matches[0].score >= min_score)
+        {
+            return matches[0];
+        }
+        insertLocked(sound_id, fingerprint);
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Forgets a sound
+     *
+     * @param sound_id Freesound sound ID
+     * @return bool True if the sound was indexed
+     */
+    bool FingerprintIndex::remove(int sound_id)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+        const auto added = m_added.find(sound_id);
+        if (added != m_added.end())
+        {
+            for (const FingerprintHash& hash : added->second)
+            {
+                auto postings = m_postings.find(hash.hash);
+                if (postings == m_postings.end())
+                {
+                    continue;
+                }
+                auto& list = postings->second;
+                list.erase(std::remove_if(list.begin(), list.end(),
+                                          [sound_id](const Posting& p) { return p.sound_id == sound_id; }),
+                           list.end());
+                if (list.empty())
+                {
+                    m_postings.erase(postings);
+                }
+            }
+            m_added.erase(added);
+            return true;
+        }
+
+        if (containsLocked(sound_id))
+        {
+            m_removed.insert(sound_id);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Finds the indexed sounds that share the most audio with a fingerprint
+     *
+     * @param fingerprint Fingerprint to look up
+     * @param max_results Maximum number of matches
+     * @return std::vector<FingerprintMatch> Matches with at least MIN_MATCHED aligned hashes, best first
+     */
+    std::vector<FingerprintMatch> FingerprintIndex::match(const Fingerprint& fingerprint, size_t max_results) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return matchLocked(fingerprint, max_results);
+    }
+
+    /**
+     * @brief Returns the best match if it is close enough to count as a duplicate
+     *
+     * @param fingerprint Fingerprint to look up
+     * @param min_score Score from which a match counts as a duplicate
+     * @return std::optional<FingerprintMatch> Best match, or std::nullopt
+     */
+    std::optional<FingerprintMatch> FingerprintIndex::findDuplicate(const Fingerprint& fingerprint,
+                                                                    float min_score) const
+    {
+        const auto matches = match(fingerprint, 1);
+        if (matches.empty() || matches[0].score < min_score)
+        {
+            return std::nullopt;
+        }
+        return matches[0];
+    }
+
+    bool FingerprintIndex::contains(int sound_id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return containsLocked(sound_id);
+    }
+
+    size_t FingerprintIndex::size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_sound_count - m_removed.size() + m_added.size();
+    }
+
+    /**
+     * @brief Writes every indexed sound to a file that open() can map
+     *
+     * @param path Destination
+     * @param sync_first Flush the file to stable storage before it appears
+     * @return bool True if the file was written
+     */
+    bool FingerprintIndex::save(const std::string& path, bool sync_first) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+        std::vector<std::tuple<uint32_t, int32_t, uint32_t>> records;
+        for (size_t i = 0; i < m_record_count; ++i)
+        {
+            const uint8_t* record = m_records + i * RECORD_SIZE;
+            const auto sound_id = loadValue<int32_t>(record + 4);
+            if (!m_removed.count(sound_id))
+            {
+                records.emplace_back(loadValue<uint32_t>(record), sound_id, loadValue<uint32_t>(record + 8));
+            }
+        }
+        std::vector<std::pair<int32_t, uint32_t>> sounds;
+        for (size_t i = 0; i < m_sound_count; ++i)
+        {
+            const auto sound_id = loadValue<int32_t>(m_sounds + i * SOUND_SIZE);
+            if (!m_removed.count(sound_id))
+            {
+                sounds.emplace_back(sound_id, loadValue<uint32_t>(m_sounds + i * SOUND_SIZE + 4));
+            }
+        }
+        for (const auto& added : m_added)
+        {
+            sounds.emplace_back(added.first, static_cast<uint32_t>(added.second.size()));
+            for (const FingerprintHash& hash : added.second)
+            {
+                records.emplace_back(hash.hash, added.first, hash.time);
+            }
+        }
+        std::sort(records.begin(), records.end());
+        std::sort(sounds.begin(), sounds.end());
+
+        std::vector<uint8_t> bytes(INDEX_HEADER_SIZE + records.size() * RECORD_SIZE + sounds.size() * SOUND_SIZE);
+        std::memcpy(bytes.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        storeValue<uint64_t>(bytes.data() + 8, records.size());
+        storeValue<uint64_t>(bytes.data() + 16, sounds.size());
+        uint8_t* out = bytes.data() + INDEX_HEADER_SIZE;
+        for (const auto& record : records)
+        {
+            storeValue<uint32_t>(out, std::get<0>(record));
+            storeValue<int32_t>(out + 4, std::get<1>(record));
+            storeValue<uint32_t>(out + 8, std::get<2>(record));
+            out += RECORD_SIZE;
+        }
+        for (const auto& sound : sounds)
+        {
+            storeValue<int32_t>(out, sound.first);
+            storeValue<uint32_t>(out + 4, sound.second);
+            out += SOUND_SIZE;
+        }
+
+        AtomicFile file;
+        if (!file.open(path) || !file.write(bytes.data(), bytes.size()))
+        {
+            file.abort();
+            return false;
+        }
+        return file.commit(sync_first);
+    }
+
+    /**
+     * @brief Replaces the contents of the index with a file written by save()
+     *
+     * Only the order of the records and sounds is checked, which is what
+     * the lookups rely on.
+     *
+     * @param path Index file
+     * @return bool True if the file was opened; false leaves the index unchanged
+     */
+    bool FingerprintIndex::open(const std::string& path)
+    {
+        MappedFile file;
+        if (!file.open(path) || file.size() < INDEX_HEADER_SIZE
+            || std::memcmp(file.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        {
+            return false;
+        }
+
+        const uint64_t record_count = loadValue<uint64_t>(file.data() + 8);
+        const uint64_t sound_count = loadValue<uint64_t>(file.data() + 16);
+        if (record_count > file.size() / RECORD_SIZE || sound_count > file.size() / SOUND_SIZE
+            || file.size() != INDEX_HEADER_SIZE + record_count * RECORD_SIZE + sound_count * SOUND_SIZE)
+        {
+            return false;
+        }
+
+        const uint8_t* records = file.data() + INDEX_HEADER_SIZE;
+        const uint8_t* sounds = records + record_count * RECORD_SIZE;
+        for (uint64_t i = 1; i < record_count; ++i)
+        {
+            if (loadValue<uint32_t>(records + (i - 1) * RECORD_SIZE) > loadValue<uint32_t>(records + i * RECORD_SIZE))
+            {
+                return false;
+            }
+        }
+        for (uint64_t i = 1; i < sound_count; ++i)
+        {
+            if (loadValue<int32_t>(sounds + (i - 1) * SOUND_SIZE) >= loadValue<int32_t>(sounds + i * SOUND_SIZE))
+            {
+                return false;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_file = std::move(file);
+        m_records = records;
+        m_record_count = static_cast<size_t>(record_count);
+        m_sounds = sounds;
+        m_sound_count = static_cast<size_t>(sound_count);
+        m_removed.clear();
+        m_postings.clear();
+        m_added.clear();
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of hashes of an indexed sound
+     */
+    std::optional<uint32_t> FingerprintIndex::hashCount(int sound_id) const
+    {
+        const auto added = m_added.find(sound_id);
+        if (added != m_added.end())
+        {
+            return static_cast<uint32_t>(added->second.size());
+        }
+        if (m_removed.count(sound_id))
+        {
+            return std::nullopt;
+        }
+
+        size_t low = 0;
+        size_t high = m_sound_count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            const auto id = loadValue<int32_t>(m_sounds + middle * SOUND_SIZE);
+            if (id == sound_id)
+            {
+                return loadValue<uint32_t>(m_sounds + middle * SOUND_SIZE + 4);
+            }
+            if (id < sound_id)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool FingerprintIndex::containsLocked(int sound_id) const
+    {
+        return hashCount(sound_id).has_value();
+    }
+
+    void FingerprintIndex::insertLocked(int sound_id, const Fingerprint& fingerprint)
+    {
+        for (const FingerprintHash& hash : fingerprint.hashes)
+        {
+            m_postings[hash.hash].push_back({sound_id, hash.time});
+        }
+        m_added.emplace(sound_id, fingerprint.hashes);
+    }
+
+    /**
+     * @brief Votes for (sound, time offset) pairs and keeps each sound's best offset
+     *
+     * Votes of neighbouring offsets are added up, because a copy that is
+     * shifted by part of a hop lands some of its peaks one frame earlier
+     * or later.
+     */
+    std::vector<FingerprintMatch> FingerprintIndex::matchLocked(const Fingerprint& fingerprint,
+                                                                size_t max_results) const
+    {
+        std::unordered_map<uint64_t, uint32_t> votes;
+        for (const FingerprintHash& hash : fingerprint.hashes)
+        {
+            const auto range = recordRange(m_records, m_record_count, hash.hash);
+            const auto postings = m_postings.find(hash.hash);
+            const size_t added = postings == m_postings.end() ? 0 : postings->second.size();
+            if (range.second - range.first + added > MAX_POSTINGS)
+            {
+                continue;
+            }
+
+            for (size_t i = range.first; i < range.second; ++i)
+            {
+                const uint8_t* record = m_records + i * RECORD_SIZE;
+                const auto sound_id = loadValue<int32_t>(record + 4);
+                if (!m_removed.count(sound_id))
+                {
+                    const auto offset = static_cast<int32_t>(loadValue<uint32_t>(record + 8) - hash.time);
+                    ++votes[voteKey(sound_id, offset)];
+                }
+            }
+            for (size_t i = 0; i < added; ++i)
+            {
+                const Posting& posting = postings->second[i];
+                ++votes[voteKey(posting.sound_id, static_cast<int32_t>(posting.time - hash.time))];
+            }
+        }
+
+        std::unordered_map<int, FingerprintMatch> best;
+        for (const auto& vote : votes)
+        {
+            const auto sound_id = static_cast<int>(static_cast<int32_t>(vote.first >> 32));
+            const auto offset = static_cast<int32_t>(static_cast<uint32_t>(vote.first));
+            uint32_t matched = vote.second;
+            for (int32_t neighbour : {offset - 1, offset + 1})
+            {
+                const auto found = votes.find(voteKey(sound_id, neighbour));
+                matched += found == votes.end() ? 0 : found->second;
+            }
+
+            auto& entry = best.try_emplace(sound_id, FingerprintMatch{sound_id, 0, 0.0f, 0}).first->second;
+            if (matched > entry.matched || (matched == entry.matched && offset < entry.offset))
+            {
+                entry.matched = matched;
+                entry.offset = offset;
+            }
+        }
+
+        std::vector<FingerprintMatch> matches;
+        for (auto& candidate : best)
+        {
+            FingerprintMatch& match = candidate.second;
+            const auto count = hashCount(match.sound_id);
+            if (match.matched < MIN_MATCHED || !count)
+            {
+                continue;
+            }
+            const size_t shorter = std::max<size_t>(1, std::min<size_t>(*count, fingerprint.hashes.size()));
+            match.score = std::min(1.0f, static_cast<float>(match.matched) / static_cast<float>(shorter));
+            matches.push_back(match);
+        }
+        std::sort(matches.begin(), matches.end(), [](const FingerprintMatch& a, const FingerprintMatch& b) {
+            return a.score != b.score ? a.score > b.score
+                 : a.matched != b.matched ? a.matched > b.matched : a.sound_id < b.sound_id;
+        });
+        if (matches.size() > max_results)
+        {
+            matches.resize(max_results);
+        }
+        return matches;
+    }
+
+    /**
+     * @brief Decodes audio files in parallel and fingerprints each
+     *
+     * @param paths WAV, AIFF or FLAC files
+     * @param options Analysis parameters
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::optional<Fingerprint>> One entry per path, std::nullopt where decoding failed
+     */
+    std::vector<std::optional<Fingerprint>> fingerprintFiles(const std::vector<std::string>& paths,
+                                                             const FingerprintOptions& options, unsigned threads)
+    {
+        // Reject bad options on the caller's thread rather than in a worker
+        Fingerprinter validate(1, options.analysis_rate, options);
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+
+        std::vector<std::optional<Fingerprint>> fingerprints(paths.size());
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < paths.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                std::unique_ptr<Fingerprinter> fingerprinter;
+                const bool decoded = decodeAudioFile(paths[i],
+                    [&](const AudioStreamInfo& info, const float* samples, size_t frames) {
+                        if (!fingerprinter)
+                        {
+                            fingerprinter = std::make_unique<Fingerprinter>(info.channels, info.sample_rate, options);
+                        }
+                        fingerprinter->push(samples, frames);
+                        return true;
+                    });
+                if (decoded && fingerprinter)
+                {
+                    fingerprints[i] = fingerprinter->finish();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        if (threads > 0)
+        {
+            work();
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return fingerprints;
+    }
+
+    /**
+     * @brief Returns the path of the file that stands in for a duplicate sound
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.ref`
+     */
+    std::string referencePathFor(const std::string& audio_path)
+    {
+        return std::filesystem::path(audio_path).replace_extension(".ref").string();
+    }
+}
@@ -0,0 +1,81 @@
+/**
+ * @file src/audio_format.cpp
+ * @brief Container format detection for downloaded sounds
+ *
+ * @see include/audio_format.h
+ */
+
+#include "audio_format.h"
+#include <cstring>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Identifies a container format from the first bytes of a file
+     *
+     * @param data Start of the file contents
+     * @param size Number of bytes available at data
+     * @return AudioFormat Detected format, or AudioFormat::Unknown
+     */
+    AudioFormat sniffAudioFormat(const uint8_t* data, size_t size)
+    {
+        auto startsWith = [data, size](size_t offset, const char* tag)
+        {
+            const size_t length = std::strlen(tag);
+            return size >= offset + length && std::memcmp(data + offset, tag, length) == 0;
+        };
+
+        if (startsWith(0, "RIFF") && startsWith(8, "WAVE"))
+        {
+            return AudioFormat::Wav;
+        }
+        if (startsWith(0, "RF64") && startsWith(8, "WAVE"))
+        {
+            return AudioFormat::Wav;
+        }
+        if (startsWith(0, "FORM") && (startsWith(8, "AIFF") || startsWith(8, "AIFC")))
+        {
+            return AudioFormat::Aiff;
+        }
+        if (startsWith(0, "fLaC"))
+        {
+            return AudioFormat::Flac;
+        }
+        if (startsWith(0, "OggS"))
+        {
+            return AudioFormat::Ogg;
+        }
+        if (startsWith(0, "ID3"))
+        {
+            return AudioFormat::Mp3;
+        }
+
+        // Bare MPEG audio frame: 11-bit sync word, layer bits must not be zero
+        if (size >= 2 && data[0] == 0xFF && (data[1] & 0xE0) == 0xE0 && (data[1] & 0x06) != 0)
+        {
+            return AudioFormat::Mp3;
+        }
+
+        return AudioFormat::Unknown;
+    }
+
+    /**
+     * @brief Returns the conventional file extension for a format
+     *
+     * @param format Container format
+     * @return const char* Extension without the leading dot
+     */
+    const char* audioFormatExtension(AudioFormat format)
+    {
+        switch (format)
+        {
+            case AudioFormat::Wav:  return "wav";
+            case AudioFormat::Aiff: return "aiff";
+            case AudioFormat::Flac: return "flac";
+            case AudioFormat::Ogg:  return "ogg";
+            case AudioFormat::Mp3:  return "mp3";
+            case AudioFormat::Unknown: break;
+        }
+        return "bin";
+    }
+}
@@ -0,0 +1,1111 @@
+/**
+ * @file src/audio_kernels.cpp
+ * @brief Implementation of the vectorized sample kernels and their runtime dispatch
+ *
+ * Every kernel exists as a portable loop and, where the target has them,
+ * as AVX2 and NEON versions. The AVX2 versions are compiled with a target
+ * attribute so the library itself needs no special compiler flags; they are
+ * only called once the CPU has reported AVX2 support.
+ *
+ * The conversion kernels run from the back of the buffer to the front and
+ * load each block before storing it, which lets output overlap input that
+ * starts at the same address (int -> float widens every sample).
+ *
+ * @see include/audio_kernels.h
+ */
+
+#include "audio_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FREESOUND_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define FREESOUND_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        constexpr float INT16_SCALE = 1.0f / 32768.0f;
+        constexpr float INT32_SCALE = 1.0f / 2147483648.0f;
+
+        /// Samples whose squares are summed in single precision before moving to the double total
+        constexpr size_t LEVEL_BLOCK = 4096;
+
+        /**
+         * @brief One implementation of every kernel
+         */
+        struct KernelTable
+        {
+            SimdLevel level;
+            void (*int16_to_float)(const uint8_t* input, size_t count, float* output);
+            void (*int24_to_float)(const uint8_t* input, size_t count, float* output);
+            void (*int32_to_float)(const uint8_t* input, size_t count, float* output);
+            void (*levels)(const float* samples, size_t count, float& peak, double& sum_squares);
+            void (*range)(const float* samples, size_t count, float& minimum, float& maximum);
+            void (*gain)(float* samples, size_t count, float gain);
+            float (*dot)(const float* a, const float* b, size_t count);
+            float (*distance)(const float* a, const float* b, size_t count);
+            void (*butterflies)(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                                const float* w_re, const float* w_im, size_t count);
+            void (*stereo_to_mono)(const float* input, size_t frames, float* output);
+            void (*mono_to_stereo)(const float* input, size_t frames, float* output);
+            void (*residual)(const int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                             unsigned shift, int32_t* residual);
+        };
+
+        // Scalar ------------------------------------------------------------
+
+        int32_t loadInt24(const uint8_t* p)
+        {
+            const uint32_t value = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16)
+                                 | (static_cast<uint32_t>(p[2]) << 24);
+            return static_cast<int32_t>(value);
+        }
+
+        void scalarInt16ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            for (size_t i = count; i-- > 0;)
+            {
+                int16_t value;
+                std::memcpy(&value, input + 2 * i, 2);
+                output[i] = static_cast<float>(value) * INT16_SCALE;
+            }
+        }
+
+        void scalarInt24ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            for (size_t i = count; i-- > 0;)
+            {
+                output[i] = static_cast<float>(loadInt24(input + 3 * i)) * INT32_SCALE;
+            }
+        }
+
+        void scalarInt32ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            for (size_t i = count; i-- > 0;)
+            {
+                int32_t value;
+                std::memcpy(&value, input + 4 * i, 4);
+                output[i] = static_cast<float>(value) * INT32_SCALE;
+            }
+        }
+
+        void scalarLevels(const float* samples, size_t count, float& peak, double& sum_squares)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                peak = std::max(peak, std::fabs(samples[i]));
+                sum_squares += static_cast<double>(samples[i]) * samples[i];
+            }
+        }
+
+        void scalarRange(const float* samples, size_t count, float& minimum, float& maximum)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                minimum = std::min(minimum, samples[i]);
+                maximum = std::max(maximum, samples[i]);
+            }
+        }
+
+        void scalarGain(float* samples, size_t count, float gain)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                samples[i] *= gain;
+            }
+        }
+
+        float scalarDot(const float* a, const float* b, size_t count)
+        {
+            float sum = 0.0f;
+            for (size_t i = 0; i < count; ++i)
+            {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+
+        float scalarDistance(const float* a, const float* b, size_t count)
+        {
+            float sum = 0.0f;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float difference = a[i] - b[i];
+                sum += difference * difference;
+            }
+            return sum;
+        }
+
+        void scalarButterflies(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                               const float* w_re, const float* w_im, size_t count)
+        {
+            for (size_t k = 0; k < count; ++k)
+            {
+                const float t_re = w_re[k] * hi_re[k] - w_im[k] * hi_im[k];
+                const float t_im = w_re[k] * hi_im[k] + w_im[k] * hi_re[k];
+                hi_re[k] = lo_re[k] - t_re;
+                hi_im[k] = lo_im[k] - t_im;
+                lo_re[k] += t_re;
+                lo_im[k] += t_im;
+            }
+        }
+
+        void scalarStereoToMono(const float* input, size_t frames, float* output)
+        {
+            for (size_t i = 0; i < frames; ++i)
+            {
+                output[i] = (input[2 * i] + input[2 * i + 1]) * 0.5f;
+            }
+        }
+
+        void scalarMonoToStereo(const float* input, size_t frames, float* output)
+        {
+            for (size_t i = frames; i-- > 0;)
+            {
+                const float value = input[i];
+                output[2 * i] = value;
+                output[2 * i + 1] = value;
+            }
+        }
+
+        void scalarResidual(const int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                            unsigned shift, int32_t* residual)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                int32_t sum = 0;
+                for (unsigned j = 0; j < order; ++j)
+                {
+                    sum += coefficients[j] * samples[static_cast<std::ptrdiff_t>(i) - 1 - j];
+                }
+                residual[i] = samples[i] - (sum >> shift);
+            }
+        }
+
+        constexpr KernelTable SCALAR_KERNELS = {
+            SimdLevel::Scalar,
+            scalarInt16ToFloat,
+            scalarInt24ToFloat,
+            scalarInt32ToFloat,
+            scalarLevels,
+            scalarRange,
+            scalarGain,
+            scalarDot,
+            scalarDistance,
+            scalarButterflies,
+            scalarStereoToMono,
+            scalarMonoToStereo,
+            scalarResidual,
+        };
+
+#if defined(FREESOUND_HAVE_AVX2)
+        // AVX2 --------------------------------------------------------------
+
+#define FREESOUND_AVX2 __attribute__((target("avx2")))
+
+        FREESOUND_AVX2 void avx2Int16ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 8 * 8;
+            scalarInt16ToFloat(input + 2 * vectors, count - vectors, output + vectors);
+
+            const __m256 scale = _mm256_set1_ps(INT16_SCALE);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * i));
+                const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw));
+                _mm256_storeu_ps(output + i, _mm256_mul_ps(value, scale));
+            }
+        }
+
+        FREESOUND_AVX2 void avx2Int24ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 8 * 8;
+            scalarInt24ToFloat(input + 3 * vectors, count - vectors, output + vectors);
+
+            // Samples 0-3 sit at bytes 0-11 of the low load, samples 4-7 at bytes 4-15 of the
+            // high load; each lands in the top three bytes of an int32
+            const __m256i spread = _mm256_setr_epi8(
+                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15);
+            const __m256 scale = _mm256_set1_ps(INT32_SCALE);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                const uint8_t* p = input + 3 * i;
+                const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8));
+                const __m256i raw = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+                const __m256 value = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(raw, spread));
+                _mm256_storeu_ps(output + i, _mm256_mul_ps(value, scale));
+            }
+        }
+
+        FREESOUND_AVX2 void avx2Int32ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 8 * 8;
+            scalarInt32ToFloat(input + 4 * vectors, count - vectors, output + vectors);
+
+            const __m256 scale = _mm256_set1_ps(INT32_SCALE);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                const __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + 4 * i));
+                _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(raw), scale));
+            }
+        }
+
+        FREESOUND_AVX2 float avx2HorizontalMax(__m256 value)
+        {
+            __m128 v = _mm_max_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+            v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+            v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+            return _mm_cvtss_f32(v);
+        }
+
+        FREESOUND_AVX2 float avx2HorizontalSum(__m256 value)
+        {
+            __m128 v = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+            v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+            v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+            return _mm_cvtss_f32(v);
+        }
+
+        FREESOUND_AVX2 void avx2Levels(const float* samples, size_t count, float& peak, double& sum_squares)
+        {
+            const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            __m256 peaks = _mm256_setzero_ps();
+            size_t i = 0;
+            while (count - i >= 8)
+            {
+                const size_t end = i + std::min(LEVEL_BLOCK, (count - i) / 8 * 8);
+                __m256 squares = _mm256_setzero_ps();
+                for (; i < end; i += 8)
+                {
+                    const __m256 value = _mm256_loadu_ps(samples + i);
+                    peaks = _mm256_max_ps(peaks, _mm256_and_ps(value, magnitude));
+                    squares = _mm256_add_ps(squares, _mm256_mul_ps(value, value));
+                }
+                sum_squares += avx2HorizontalSum(squares);
+            }
+            peak = std::max(peak, avx2HorizontalMax(peaks));
+            scalarLevels(samples + i, count - i, peak, sum_squares);
+        }
+
+        FREESOUND_AVX2 float avx2HorizontalMin(__m256 value)
+        {
+            __m128 v = _mm_min_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+            v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+            v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+            return _mm_cvtss_f32(v);
+        }
+
+        FREESOUND_AVX2 void avx2Range(const float* samples, size_t count, float& minimum, float& maximum)
+        {
+            size_t i = 0;
+            if (count >= 8)
+            {
+                __m256 low = _mm256_set1_ps(minimum);
+                __m256 high = _mm256_set1_ps(maximum);
+                for (; count - i >= 8; i += 8)
+                {
+                    const __m256 value = _mm256_loadu_ps(samples + i);
+                    low = _mm256_min_ps(low, value);
+                    high = _mm256_max_ps(high, value);
+                }
+                minimum = avx2HorizontalMin(low);
+                maximum = avx2HorizontalMax(high);
+            }
+            scalarRange(samples + i, count - i, minimum, maximum);
+        }
+
+        FREESOUND_AVX2 void avx2Gain(float* samples, size_t count, float gain)
+        {
+            const __m256 factor = _mm256_set1_ps(gain);
+            size_t i = 0;
+            for (; count - i >= 8; i += 8)
+            {
+                _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), factor));
+            }
+            scalarGain(samples + i, count - i, gain);
+        }
+
+        FREESOUND_AVX2 float avx2Dot(const float* a, const float* b, size_t count)
+        {
+            // Two accumulators hide the latency of the dependent additions
+            __m256 first = _mm256_setzero_ps();
+            __m256 second = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; count - i >= 16; i += 16)
+            {
+                first = _mm256_add_ps(first, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+                second = _mm256_add_ps(second, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+            }
+            if (count - i >= 8)
+            {
+                first = _mm256_add_ps(first, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+                i += 8;
+            }
+            return avx2HorizontalSum(_mm256_add_ps(first, second)) + scalarDot(a + i, b + i, count - i);
+        }
+
+        FREESOUND_AVX2 float avx2Distance(const float* a, const float* b, size_t count)
+        {
+            __m256 first = _mm256_setzero_ps();
+            __m256 second = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; count - i >= 16; i += 16)
+            {
+                const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+                first = _mm256_add_ps(first, _mm256_mul_ps(d0, d0));
+                second = _mm256_add_ps(second, _mm256_mul_ps(d1, d1));
+            }
+            if (count - i >= 8)
+            {
+                const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                first = _mm256_add_ps(first, _mm256_mul_ps(d, d));
+                i += 8;
+            }
+            return avx2HorizontalSum(_mm256_add_ps(first, second)) + scalarDistance(a + i, b + i, count - i);
+        }
+
+        FREESOUND_AVX2 void avx2Butterflies(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                                            const float* w_re, const float* w_im, size_t count)
+        {
+            size_t k = 0;
+            for (; count - k >= 8; k += 8)
+            {
+                const __m256 wr = _mm256_loadu_ps(w_re + k);
+                const __m256 wi = _mm256_loadu_ps(w_im + k);
+                const __m256 hr = _mm256_loadu_ps(hi_re + k);
+                const __m256 hi = _mm256_loadu_ps(hi_im + k);
+                const __m256 lr = _mm256_loadu_ps(lo_re + k);
+                const __m256 li = _mm256_loadu_ps(lo_im + k);
+                const __m256 t_re = _mm256_sub_ps(_mm256_mul_ps(wr, hr), _mm256_mul_ps(wi, hi));
+                const __m256 t_im = _mm256_add_ps(_mm256_mul_ps(wr, hi), _mm256_mul_ps(wi, hr));
+                _mm256_storeu_ps(hi_re + k, _mm256_sub_ps(lr, t_re));
+                _mm256_storeu_ps(hi_im + k, _mm256_sub_ps(li, t_im));
+                _mm256_storeu_ps(lo_re + k, _mm256_add_ps(lr, t_re));
+                _mm256_storeu_ps(lo_im + k, _mm256_add_ps(li, t_im));
+            }
+            // GCC turns the tail into a jump without clearing the upper halves, which
+            // would slow every SSE instruction the caller runs afterwards (libm's log)
+            _mm256_zeroupper();
+            scalarButterflies(lo_re + k, lo_im + k, hi_re + k, hi_im + k, w_re + k, w_im + k, count - k);
+        }
+
+        FREESOUND_AVX2 void avx2StereoToMono(const float* input, size_t frames, float* output)
+        {
+            const __m256 half = _mm256_set1_ps(0.5f);
+            size_t i = 0;
+            for (; frames - i >= 8; i += 8)
+            {
+                const __m256 first = _mm256_loadu_ps(input + 2 * i);
+                const __m256 second = _mm256_loadu_ps(input + 2 * i + 8);
+                // hadd pairs within each 128-bit lane; the permute restores frame order
+                const __m256 pairs = _mm256_hadd_ps(first, second);
+                const __m256 ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(pairs), 0xD8));
+                _mm256_storeu_ps(output + i, _mm256_mul_ps(ordered, half));
+            }
+            scalarStereoToMono(input + 2 * i, frames - i, output + i);
+        }
+
+        FREESOUND_AVX2 void avx2MonoToStereo(const float* input, size_t frames, float* output)
+        {
+            const size_t vectors = frames / 8 * 8;
+            scalarMonoToStereo(input + vectors, frames - vectors, output + 2 * vectors);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                const __m256 value = _mm256_loadu_ps(input + i);
+                const __m256 low = _mm256_unpacklo_ps(value, value);
+                const __m256 high = _mm256_unpackhi_ps(value, value);
+                _mm256_storeu_ps(output + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+                _mm256_storeu_ps(output + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+            }
+        }
+
+        FREESOUND_AVX2 void avx2Residual(const int32_t* samples, size_t count, const int32_t* coefficients,
+                                         unsigned order, unsigned shift, int32_t* residual)
+        {
+            // Eight consecutive predictions share each coefficient
+            const __m128i bits = _mm_cvtsi32_si128(static_cast<int>(shift));
+            size_t i = 0;
+            for (; count - i >= 8; i += 8)
+            {
+                __m256i sum = _mm256_setzero_si256();
+                for (unsigned j = 0; j < order; ++j)
+                {
+                    const __m256i history = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(samples + static_cast<std::ptrdiff_t>(i) - 1 - j));
+                    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(coefficients[j]), history));
+                }
+                const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(residual + i),
+                                    _mm256_sub_epi32(current, _mm256_sra_epi32(sum, bits)));
+            }
+            _mm256_zeroupper();
+            scalarResidual(samples + i, count - i, coefficients, order, shift, residual + i);
+        }
+
+#undef FREESOUND_AVX2
+
+        constexpr KernelTable AVX2_KERNELS = {
+            SimdLevel::Avx2,
+            avx2Int16ToFloat,
+            avx2Int24ToFloat,
+            avx2Int32ToFloat,
+            avx2Levels,
+            avx2Range,
+            avx2Gain,
+            avx2Dot,
+            avx2Distance,
+            avx2Butterflies,
+            avx2StereoToMono,
+            avx2MonoToStereo,
+            avx2Residual,
+        };
+#endif
+
+#if defined(FREESOUND_HAVE_NEON)
+        // NEON --------------------------------------------------------------
+
+        void neonInt16ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 8 * 8;
+            scalarInt16ToFloat(input + 2 * vectors, count - vectors, output + vectors);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                const int16x8_t raw = vreinterpretq_s16_u8(vld1q_u8(input + 2 * i));
+                const float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(raw)));
+                const float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(raw)));
+                vst1q_f32(output + i, vmulq_n_f32(low, INT16_SCALE));
+                vst1q_f32(output + i + 4, vmulq_n_f32(high, INT16_SCALE));
+            }
+        }
+
+        void neonInt24ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 8 * 8;
+            scalarInt24ToFloat(input + 3 * vectors, count - vectors, output + vectors);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 8;
+                // De-interleaves the low, middle and high byte of eight samples
+                const uint8x8x3_t bytes = vld3_u8(input + 3 * i);
+                const uint16x8_t bottom = vorrq_u16(vmovl_u8(bytes.val[0]), vshlq_n_u16(vmovl_u8(bytes.val[1]), 8));
+                const uint16x8_t top = vmovl_u8(bytes.val[2]);
+                const uint32x4_t low = vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(top)), 24),
+                                                 vshlq_n_u32(vmovl_u16(vget_low_u16(bottom)), 8));
+                const uint32x4_t high = vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(top)), 24),
+                                                  vshlq_n_u32(vmovl_u16(vget_high_u16(bottom)), 8));
+                vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(low)), INT32_SCALE));
+                vst1q_f32(output + i + 4, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(high)), INT32_SCALE));
+            }
+        }
+
+        void neonInt32ToFloat(const uint8_t* input, size_t count, float* output)
+        {
+            const size_t vectors = count / 4 * 4;
+            scalarInt32ToFloat(input + 4 * vectors, count - vectors, output + vectors);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 4;
+                const int32x4_t raw = vreinterpretq_s32_u8(vld1q_u8(input + 4 * i));
+                vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(raw), INT32_SCALE));
+            }
+        }
+
+        void neonLevels(const float* samples, size_t count, float& peak, double& sum_squares)
+        {
+            float32x4_t peaks = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            while (count - i >= 4)
+            {
+                const size_t end = i + std::min(LEVEL_BLOCK, (count - i) / 4 * 4);
+                float32x4_t squares = vdupq_n_f32(0.0f);
+                for (; i < end; i += 4)
+                {
+                    const float32x4_t value = vld1q_f32(samples + i);
+                    peaks = vmaxq_f32(peaks, vabsq_f32(value));
+                    squares = vmlaq_f32(squares, value, value);
+                }
+                sum_squares += vaddvq_f32(squares);
+            }
+            peak = std::max(peak, vmaxvq_f32(peaks));
+            scalarLevels(samples + i, count - i, peak, sum_squares);
+        }
+
+        void neonRange(const float* samples, size_t count, float& minimum, float& maximum)
+        {
+            size_t i = 0;
+            if (count >= 4)
+            {
+                float32x4_t low = vdupq_n_f32(minimum);
+                float32x4_t high = vdupq_n_f32(maximum);
+                for (; count - i >= 4; i += 4)
+                {
+                    const float32x4_t value = vld1q_f32(samples + i);
+                    low = vminq_f32(low, value);
+                    high = vmaxq_f32(high, value);
+                }
+                minimum = vminvq_f32(low);
+                maximum = vmaxvq_f32(high);
+            }
+            scalarRange(samples + i, count - i, minimum, maximum);
+        }
+
+        void neonGain(float* samples, size_t count, float gain)
+        {
+            size_t i = 0;
+            for (; count - i >= 4; i += 4)
+            {
+                vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+            }
+            scalarGain(samples + i, count - i, gain);
+        }
+
+        float neonDot(const float* a, const float* b, size_t count)
+        {
+            float32x4_t first = vdupq_n_f32(0.0f);
+            float32x4_t second = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            for (; count - i >= 8; i += 8)
+            {
+                first = vmlaq_f32(first, vld1q_f32(a + i), vld1q_f32(b + i));
+                second = vmlaq_f32(second, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            }
+            if (count - i >= 4)
+            {
+                first = vmlaq_f32(first, vld1q_f32(a + i), vld1q_f32(b + i));
+                i += 4;
+            }
+            return vaddvq_f32(vaddq_f32(first, second)) + scalarDot(a + i, b + i, count - i);
+        }
+
+        float neonDistance(const float* a, const float* b, size_t count)
+        {
+            float32x4_t first = vdupq_n_f32(0.0f);
+            float32x4_t second = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            for (; count - i >= 8; i += 8)
+            {
+                const float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+                const float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+                first = vmlaq_f32(first, d0, d0);
+                second = vmlaq_f32(second, d1, d1);
+            }
+            if (count - i >= 4)
+            {
+                const float32x4_t d = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+                first = vmlaq_f32(first, d, d);
+                i += 4;
+            }
+            return vaddvq_f32(vaddq_f32(first, second)) + scalarDistance(a + i, b + i, count - i);
+        }
+
+        void neonButterflies(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                             const float* w_re, const float* w_im, size_t count)
+        {
+            size_t k = 0;
+            for (; count - k >= 4; k += 4)
+            {
+                const float32x4_t wr = vld1q_f32(w_re + k);
+                const float32x4_t wi = vld1q_f32(w_im + k);
+                const float32x4_t hr = vld1q_f32(hi_re + k);
+                const float32x4_t hi = vld1q_f32(hi_im + k);
+                const float32x4_t lr = vld1q_f32(lo_re + k);
+                const float32x4_t li = vld1q_f32(lo_im + k);
+                const float32x4_t t_re = vsubq_f32(vmulq_f32(wr, hr), vmulq_f32(wi, hi));
+                const float32x4_t t_im = vaddq_f32(vmulq_f32(wr, hi), vmulq_f32(wi, hr));
+                vst1q_f32(hi_re + k, vsubq_f32(lr, t_re));
+                vst1q_f32(hi_im + k, vsubq_f32(li, t_im));
+                vst1q_f32(lo_re + k, vaddq_f32(lr, t_re));
+                vst1q_f32(lo_im + k, vaddq_f32(li, t_im));
+            }
+            scalarButterflies(lo_re + k, lo_im + k, hi_re + k, hi_im + k, w_re + k, w_im + k, count - k);
+        }
+
+        void neonStereoToMono(const float* input, size_t frames, float* output)
+        {
+            size_t i = 0;
+            for (; frames - i >= 4; i += 4)
+            {
+                const float32x4x2_t channels = vld2q_f32(input + 2 * i);
+                vst1q_f32(output + i, vmulq_n_f32(vaddq_f32(channels.val[0], channels.val[1]), 0.5f));
+            }
+            scalarStereoToMono(input + 2 * i, frames - i, output + i);
+        }
+
+        void neonMonoToStereo(const float* input, size_t frames, float* output)
+        {
+            const size_t vectors = frames / 4 * 4;
+            scalarMonoToStereo(input + vectors, frames - vectors, output + 2 * vectors);
+            for (size_t i = vectors; i > 0;)
+            {
+                i -= 4;
+                const float32x4_t value = vld1q_f32(input + i);
+                vst2q_f32(output + 2 * i, (float32x4x2_t{{value, value}}));
+            }
+        }
+
+        void neonResidual(const int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                          unsigned shift, int32_t* residual)
+        {
+            const int32x4_t bits = vdupq_n_s32(-static_cast<int32_t>(shift));
+            size_t i = 0;
+            for (; count - i >= 4; i += 4)
+            {
+                int32x4_t sum = vdupq_n_s32(0);
+                for (unsigned j = 0; j < order; ++j)
+                {
+                    sum = vmlaq_n_s32(sum, vld1q_s32(samples + static_cast<std::ptrdiff_t>(i) - 1 - j), coefficients[j]);
+                }
+                vst1q_s32(residual + i, vsubq_s32(vld1q_s32(samples + i), vshlq_s32(sum, bits)));
+            }
+            scalarResidual(samples + i, count - i, coefficients, order, shift, residual + i);
+        }
+
+        constexpr KernelTable NEON_KERNELS = {
+            SimdLevel::Neon,
+            neonInt16ToFloat,
+            neonInt24ToFloat,
+            neonInt32ToFloat,
+            neonLevels,
+            neonRange,
+            neonGain,
+            neonDot,
+            neonDistance,
+            neonButterflies,
+            neonStereoToMono,
+            neonMonoToStereo,
+            neonResidual,
+        };
+#endif
+
+        // Dispatch ----------------------------------------------------------
+
+        /// Kernels of a level, or nullptr if the CPU cannot run them
+        const KernelTable* kernelsFor(SimdLevel level)
+        {
+            switch (level)
+            {
+            case SimdLevel::Scalar:
+                return &SCALAR_KERNELS;
+            case SimdLevel::Avx2:
+#if defined(FREESOUND_HAVE_AVX2)
+                if (__builtin_cpu_supports("avx2"))
+                {
+                    return &AVX2_KERNELS;
+                }
+#endif
+                return nullptr;
+            case SimdLevel::Neon:
+#if defined(FREESOUND_HAVE_NEON)
+                return &NEON_KERNELS;
+#else
+                return nullptr;
+#endif
+            }
+            return nullptr;
+        }
+
+        std::atomic<const KernelTable*> g_kernels{nullptr};
+
+        const KernelTable& kernels()
+        {
+            const KernelTable* table = g_kernels.load(std::memory_order_acquire);
+            if (table)
+            {
+                return *table;
+            }
+
+            table = &SCALAR_KERNELS;
+            for (SimdLevel level : {SimdLevel::Avx2, SimdLevel::Neon})
+            {
+                if (const KernelTable* candidate = kernelsFor(level))
+                {
+                    table = candidate;
+                    break;
+                }
+            }
+
+            // A concurrent first call may have won; either choice is the same table
+            const KernelTable* expected = nullptr;
+            g_kernels.compare_exchange_strong(expected, table, std::memory_order_acq_rel);
+            return *g_kernels.load(std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief Returns the instruction set the kernels currently run on
+     */
+    SimdLevel activeSimdLevel()
+    {
+        return kernels().level;
+    }
+
+    /**
+     * @brief Returns whether a level can run on this CPU
+     */
+    bool simdLevelSupported(SimdLevel level)
+    {
+        return kernelsFor(level) != nullptr;
+    }
+
+    /**
+     * @brief Switches every kernel to another instruction set
+     *
+     * @param level Instruction set to use
+     * @return bool false (and nothing changes) if the CPU lacks the level
+     */
+    bool setSimdLevel(SimdLevel level)
+    {
+        const KernelTable* table = kernelsFor(level);
+        if (!table)
+        {
+            return false;
+        }
+        g_kernels.store(table, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Returns a printable name of a level ("scalar", "avx2", "neon")
+     */
+    const char* simdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::Scalar:
+            return "scalar";
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Neon:
+            return "neon";
+        }
+        return "unknown";
+    }
+
+    /**
+     * @brief Returns the bytes per sample of an encoding
+     */
+    size_t pcmBytesPerSample(PcmEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case PcmEncoding::Int16:
+            return 2;
+        case PcmEncoding::Int24:
+            return 3;
+        case PcmEncoding::Int32:
+            return 4;
+        }
+        return 4;
+    }
+
+    /**
+     * @brief Converts integer samples to floats in [-1, 1)
+     *
+     * @param input Little-endian samples
+     * @param encoding Encoding of input
+     * @param count Number of samples
+     * @param output Receives count floats; must not overlap input
+     */
+    void pcmToFloat(const uint8_t* input, PcmEncoding encoding, size_t count, float* output)
+    {
+        const KernelTable& table = kernels();
+        switch (encoding)
+        {
+        case PcmEncoding::Int16:
+            table.int16_to_float(input, count, output);
+            break;
+        case PcmEncoding::Int24:
+            table.int24_to_float(input, count, output);
+            break;
+        case PcmEncoding::Int32:
+            table.int32_to_float(input, count, output);
+            break;
+        }
+    }
+
+    /**
+     * @brief Converts a downloaded buffer of integer samples to floats in place
+     *
+     * @param buffer Little-endian samples; holds native floats afterwards
+     * @param encoding Encoding of the samples in buffer
+     * @return size_t Number of samples converted
+     */
+    size_t pcmToFloatInPlace(std::vector<uint8_t>& buffer, PcmEncoding encoding)
+    {
+        const size_t count = buffer.size() / pcmBytesPerSample(encoding);
+        const size_t float_bytes = count * sizeof(float);
+        if (buffer.size() < float_bytes)
+        {
+            buffer.resize(float_bytes);
+        }
+
+        // The kernels convert back to front, so the widened output never overtakes unread input
+        pcmToFloat(buffer.data(), encoding, count, reinterpret_cast<float*>(buffer.data()));
+        buffer.resize(float_bytes);
+        return count;
+    }
+
+    /**
+     * @brief Measures the peak magnitude and RMS of samples
+     *
+     * @param samples Samples of any number of interleaved channels
+     * @param count Number of samples
+     * @return AudioLevels Levels over all samples (zero for an empty block)
+     */
+    AudioLevels measureLevels(const float* samples, size_t count)
+    {
+        AudioLevels levels;
+        if (count == 0)
+        {
+            return levels;
+        }
+
+        double sum_squares = 0.0;
+        kernels().levels(samples, count, levels.peak, sum_squares);
+        levels.rms = static_cast<float>(std::sqrt(sum_squares / static_cast<double>(count)));
+        return levels;
+    }
+
+    /**
+     * @brief Finds the smallest and largest sample
+     *
+     * @param samples Samples of any number of interleaved channels
+     * @param count Number of samples
+     * @return SampleRange Extremes over all samples (zero for an empty block)
+     */
+    SampleRange measureRange(const float* samples, size_t count)
+    {
+        SampleRange range;
+        if (count == 0)
+        {
+            return range;
+        }
+
+        range.min = samples[0];
+        range.max = samples[0];
+        kernels().range(samples, count, range.min, range.max);
+        return range;
+    }
+
+    /**
+     * @brief Multiplies samples by a gain in place
+     *
+     * @param samples Samples to scale
+     * @param count Number of samples
+     * @param gain Linear factor
+     */
+    void applyGain(float* samples, size_t count, float gain)
+    {
+        kernels().gain(samples, count, gain);
+    }
+
+    /**
+     * @brief Returns the sum of the products of two sample sequences
+     *
+     * @param a First sequence
+     * @param b Second sequence
+     * @param count Number of samples in each
+     * @return float Dot product (0 for count 0)
+     */
+    float dotProduct(const float* a, const float* b, size_t count)
+    {
+        return kernels().dot(a, b, count);
+    }
+
+    /**
+     * @brief Returns the squared Euclidean distance between two vectors
+     *
+     * @param a First vector
+     * @param b Second vector
+     * @param count Number of elements in each
+     * @return float Sum of the squared differences (0 for count 0)
+     */
+    float squaredDistance(const float* a, const float* b, size_t count)
+    {
+        return kernels().distance(a, b, count);
+    }
+
+    /**
+     * @brief Computes the residual of an integer linear predictor
+     *
+     * @param samples First sample to predict; the order samples before it are read as history
+     * @param count Number of samples to predict
+     * @param coefficients Quantised coefficients, for the previous sample first
+     * @param order Number of coefficients
+     * @param shift Right shift applied to each prediction
+     * @param residual Receives count differences between samples and predictions
+     */
+    void lpcResidual(const int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                     unsigned shift, int32_t* residual)
+    {
+        kernels().residual(samples, count, coefficients, order, shift, residual);
+    }
+
+    /**
+     * @brief Applies radix-2 butterflies to split-complex data in place
+     *
+     * @param lo_re Real parts of the first inputs and outputs
+     * @param lo_im Imaginary parts of the first inputs and outputs
+     * @param hi_re Real parts of the second inputs and outputs
+     * @param hi_im Imaginary parts of the second inputs and outputs
+     * @param w_re Real parts of the twiddle factors
+     * @param w_im Imaginary parts of the twiddle factors
+     * @param count Number of butterflies
+     */
+    void fftButterflies(float* lo_re, float* lo_im, float* hi_re, float* hi_im,
+                        const float* w_re, const float* w_im, size_t count)
+    {
+        kernels().butterflies(lo_re, lo_im, hi_re, hi_im, w_re, w_im, count);
+    }
+
+    /**
+     * @brief Scales samples in place so that their peak reaches a target
+     *
+     * @param samples Samples to scale
+     * @param count Number of samples
+     * @param target_peak Linear peak to reach
+     * @return float Gain applied (1 for silence, which is left unchanged)
+     */
+    float normalizePeak(float* samples, size_t count, float target_peak)
+    {
+        const AudioLevels levels = measureLevels(samples, count);
+        if (levels.peak <= 0.0f)
+        {
+            return 1.0f;
+        }
+
+        const float gain = target_peak / levels.peak;
+        applyGain(samples, count, gain);
+        return gain;
+    }
+
+    /**
+     * @brief Returns the default mixing matrix between two channel counts
+     *
+     * @return std::vector<float> out_channels rows of in_channels weights
+     */
+    std::vector<float> defaultChannelMatrix(unsigned in_channels, unsigned out_channels)
+    {
+        std::vector<float> matrix(static_cast<size_t>(in_channels) * out_channels, 0.0f);
+        if (in_channels == 0 || out_channels == 0)
+        {
+            return matrix;
+        }
+
+        if (out_channels == 1)
+        {
+            std::fill(matrix.begin(), matrix.end(), 1.0f / static_cast<float>(in_channels));
+        }
+        else if (in_channels == 1)
+        {
+            std::fill(matrix.begin(), matrix.end(), 1.0f);
+        }
+        else
+        {
+            for (unsigned channel = 0; channel < std::min(in_channels, out_channels); ++channel)
+            {
+                matrix[static_cast<size_t>(channel) * in_channels + channel] = 1.0f;
+            }
+        }
+        return matrix;
+    }
+
+    /**
+     * @brief Remaps interleaved frames to another channel count in place
+     *
+     * @param samples Interleaved frames; holds the remapped frames afterwards
+     * @param in_channels Channels per frame in samples
+     * @param out_channels Channels per frame wanted
+     * @param matrix out_channels x in_channels weights (empty for defaultChannelMatrix)
+     * @return bool false (and samples unchanged) for a zero channel count or a matrix of the wrong size
+     */
+    bool remapChannels(std::vector<float>& samples, unsigned in_channels, unsigned out_channels,
+                       const std::vector<float>& matrix)
+    {
+        if (in_channels == 0 || out_channels == 0)
+        {
+            return false;
+        }
+        const std::vector<float> defaults = defaultChannelMatrix(in_channels, out_channels);
+        const std::vector<float>& weights = matrix.empty() ? defaults : matrix;
+        if (weights.size() != defaults.size())
+        {
+            return false;
+        }
+
+        const size_t frames = samples.size() / in_channels;
+        samples.resize(frames * in_channels);
+        if (weights == defaults && in_channels == out_channels)
+        {
+            return true;
+        }
+
+        if (weights == defaults && in_channels == 2 && out_channels == 1)
+        {
+            kernels().stereo_to_mono(samples.data(), frames, samples.data());
+            samples.resize(frames);
+            return true;
+        }
+        if (weights == defaults && in_channels == 1 && out_channels == 2)
+        {
+            samples.resize(frames * 2);
+            kernels().mono_to_stereo(samples.data(), frames, samples.data());
+            return true;
+        }
+
+        // Each frame is mixed through a scratch frame, since its input and output overlap.
+        // Shrinking frames are walked forwards and growing ones backwards, so no frame is
+        // overwritten before it has been read.
+        std::vector<float> frame(out_channels);
+        auto mix = [&](size_t index) {
+            const float* input = samples.data() + index * in_channels;
+            for (unsigned out = 0; out < out_channels; ++out)
+            {
+                const float* row = weights.data() + static_cast<size_t>(out) * in_channels;
+                float sum = 0.0f;
+                for (unsigned in = 0; in < in_channels; ++in)
+                {
+                    sum += row[in] * input[in];
+                }
+                frame[out] = sum;
+            }
+            std::copy(frame.begin(), frame.end(), samples.begin() + static_cast<std::ptrdiff_t>(index * out_channels));
+        };
+
+        if (out_channels <= in_channels)
+        {
+            for (size_t index = 0; index < frames; ++index)
+            {
+                mix(index);
+            }
+            samples.resize(frames * out_channels);
+        }
+        else
+        {
+            samples.resize(frames * out_channels);
+            for (size_t index = frames; index-- > 0;)
+            {
+                mix(index);
+            }
+        }
+        return true;
+    }
+}
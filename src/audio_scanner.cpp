@@ -0,0 +1,955 @@
+/**
+ * @file src/audio_scanner.cpp
+ * @brief Header-only probing of audio files and the parallel library scan
+ *
+ * @see include/audio_scanner.h
+ */
+
+#include "audio_scanner.h"
+#include "lossless_codec.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Bytes read from the start of every file; one page covers the headers of nearly every file
+        constexpr size_t HEAD_BYTES = 4096;
+
+        /// Bytes read from the end of Ogg files to find the last page; retried with the largest page size
+        constexpr size_t TAIL_BYTES = 8192;
+        constexpr size_t MAX_OGG_PAGE = 27 + 255 + 255 * 255;
+
+        /// Bytes searched for the first MPEG frame after any ID3 tag
+        constexpr size_t MPEG_SYNC_WINDOW = 16384;
+
+        /// Chunks walked in a WAV or AIFF file before giving up on finding the sample data
+        constexpr int MAX_CHUNKS = 256;
+
+        uint16_t readLe16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+        uint32_t readLe32(const uint8_t* p) { return readLe16(p) | (static_cast<uint32_t>(readLe16(p + 2)) << 16); }
+        uint64_t readLe64(const uint8_t* p) { return readLe32(p) | (static_cast<uint64_t>(readLe32(p + 4)) << 32); }
+        uint16_t readBe16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+        uint32_t readBe32(const uint8_t* p) { return (static_cast<uint32_t>(readBe16(p)) << 16) | readBe16(p + 2); }
+        bool tagIs(const uint8_t* p, const char* tag) { return std::memcmp(p, tag, std::strlen(tag)) == 0; }
+
+        /// IEEE 754 80-bit extended float (AIFF sample rate)
+        double readExtended80(const uint8_t* p)
+        {
+            const int exponent = ((p[0] & 0x7F) << 8) | p[1];
+            uint64_t mantissa = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                mantissa = (mantissa << 8) | p[2 + i];
+            }
+            if (exponent == 0 && mantissa == 0)
+            {
+                return 0.0;
+            }
+            const double value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+            return (p[0] & 0x80) ? -value : value;
+        }
+
+        /**
+         * @class HeaderReader
+         * @brief Small positional reads of one file, with its first page cached
+         */
+        class HeaderReader
+        {
+        public:
+            using ReadFunction = std::function<size_t(uint64_t offset, uint8_t* buffer, size_t size)>;
+
+            HeaderReader(ReadFunction read, uint64_t size) : m_read(std::move(read)), m_size(size)
+            {
+                m_head.resize(static_cast<size_t>(std::min<uint64_t>(HEAD_BYTES, size)));
+                m_head.resize(m_read(0, m_head.data(), m_head.size()));
+            }
+
+            uint64_t size() const { return m_size; }
+
+            /**
+             * @brief Returns size bytes at an offset, or nullptr if they are not all in the file
+             *
+             * The pointer stays valid until the next call.
+             */
+            const uint8_t* at(uint64_t offset, size_t size)
+            {
+                if (offset <= m_head.size() && size <= m_head.size() - offset)
+                {
+                    return m_head.data() + offset;
+                }
+                if (offset > m_size || size > m_size - offset)
+                {
+                    return nullptr;
+                }
+                m_scratch.resize(size);
+                return m_read(offset, m_scratch.data(), size) == size ? m_scratch.data() : nullptr;
+            }
+
+        private:
+            ReadFunction m_read;
+            const uint64_t m_size;
+            std::vector<uint8_t> m_head;
+            std::vector<uint8_t> m_scratch;
+        };
+
+        // WAV -------------------------------------------------------------------
+
+        bool probeWav(HeaderReader& reader, AudioStreamInfo& info)
+        {
+            const uint8_t* riff = reader.at(0, 12);
+            if (!riff)
+            {
+                return false;
+            }
+            const bool rf64 = tagIs(riff, "RF64");
+
+            bool have_fmt = false;
+            uint16_t format_tag = 0;
+            uint16_t block_align = 0;
+            uint64_t ds64_data_size = 0;
+            uint64_t ds64_frames = 0;
+            std::optional<uint64_t> fact_frames;
+
+            uint64_t offset = 12;
+            for (int chunk = 0; chunk < MAX_CHUNKS; ++chunk)
+            {
+                const uint8_t* header = reader.at(offset, 8);
+                if (!header)
+                {
+                    return false;
+                }
+                const bool is_fmt = tagIs(header, "fmt ");
+                const bool is_ds64 = tagIs(header, "ds64");
+                const bool is_fact = tagIs(header, "fact");
+                const bool is_data = tagIs(header, "data");
+                const uint64_t size = readLe32(header + 4);
+                const uint64_t body = offset + 8;
+
+                if (is_fmt)
+                {
+                    const uint8_t* fmt = size >= 16 ? reader.at(body, size >= 26 ? 26 : 16) : nullptr;
+                    if (!fmt)
+                    {
+                        return false;
+                    }
+                    format_tag = readLe16(fmt);
+                    info.channels = readLe16(fmt + 2);
+                    info.sample_rate = readLe32(fmt + 4);
+                    block_align = readLe16(fmt + 12);
+                    info.bits_per_sample = readLe16(fmt + 14);
+                    if (format_tag == 0xFFFE && size >= 26)
+                    {
+                        // WAVE_FORMAT_EXTENSIBLE: the sub-format GUID starts with the actual tag
+                        const uint8_t* extension = reader.at(body + 18, 8);
+                        if (extension)
+                        {
+                            if (readLe16(extension) != 0)
+                            {
+                                info.bits_per_sample = readLe16(extension);
+                            }
+                            format_tag = readLe16(extension + 6);
+                        }
+                    }
+                    have_fmt = true;
+                }
+                else if (is_ds64)
+                {
+                    if (const uint8_t* ds64 = reader.at(body, 24))
+                    {
+                        ds64_data_size = readLe64(ds64 + 8);
+                        ds64_frames = readLe64(ds64 + 16);
+                    }
+                }
+                else if (is_fact)
+                {
+                    if (const uint8_t* fact = reader.at(body, 4))
+                    {
+                        fact_frames = readLe32(fact);
+                    }
+                }
+                else if (is_data)
+                {
+                    if (!have_fmt)
+                    {
+                        return false;
+                    }
+
+                    // Files still being written (or RF64) may not state the size; the file ends the data
+                    const uint64_t remaining = reader.size() - std::min(reader.size(), body);
+                    uint64_t data_size = size;
+                    if (rf64 && size == 0xFFFFFFFFu)
+                    {
+                        data_size = ds64_data_size;
+                    }
+                    if (data_size == 0xFFFFFFFFu || data_size > remaining || (data_size == 0 && remaining > 0))
+                    {
+                        data_size = remaining;
+                    }
+
+                    const bool uncompressed = format_tag == 1 || format_tag == 3;
+                    if (uncompressed && block_align != 0)
+                    {
+                        info.frames = data_size / block_align;
+                    }
+                    else if (rf64 && ds64_frames != 0)
+                    {
+                        info.frames = ds64_frames;
+                    }
+                    else if (fact_frames)
+                    {
+                        info.frames = fact_frames;
+                    }
+                    if (!uncompressed)
+                    {
+                        info.bits_per_sample = 0;
+                    }
+                    return info.sample_rate != 0 && info.channels != 0;
+                }
+
+                offset = body + size + (size & 1);
+            }
+            return false;
+        }
+
+        // AIFF ------------------------------------------------------------------
+
+        bool probeAiff(HeaderReader& reader, AudioStreamInfo& info)
+        {
+            const uint8_t* form = reader.at(0, 12);
+            if (!form)
+            {
+                return false;
+            }
+            const bool aifc = tagIs(form + 8, "AIFC");
+
+            uint64_t offset = 12;
+            for (int chunk = 0; chunk < MAX_CHUNKS; ++chunk)
+            {
+                const uint8_t* header = reader.at(offset, 8);
+                if (!header)
+                {
+                    return false;
+                }
+                const uint64_t size = readBe32(header + 4);
+                if (tagIs(header, "COMM"))
+                {
+                    const uint8_t* comm = size >= 18 ? reader.at(offset + 8, aifc && size >= 22 ? 22 : 18) : nullptr;
+                    if (!comm)
+                    {
+                        return false;
+                    }
+                    info.channels = readBe16(comm);
+                    info.frames = readBe32(comm + 2);
+                    info.bits_per_sample = readBe16(comm + 6);
+                    const double rate = readExtended80(comm + 8);
+                    info.sample_rate = rate >= 1.0 && rate < 4294967296.0 ? static_cast<uint32_t>(std::lround(rate)) : 0;
+                    if (aifc && size >= 22)
+                    {
+                        const uint8_t* type = comm + 18;
+                        if (tagIs(type, "fl32") || tagIs(type, "FL32"))
+                        {
+                            info.bits_per_sample = 32;
+                        }
+                        else if (tagIs(type, "fl64") || tagIs(type, "FL64"))
+                        {
+                            info.bits_per_sample = 64;
+                        }
+                        else if (!tagIs(type, "NONE") && !tagIs(type, "twos") && !tagIs(type, "sowt"))
+                        {
+                            info.bits_per_sample = 0;
+                        }
+                    }
+                    return info.sample_rate != 0 && info.channels != 0;
+                }
+                offset += 8 + size + (size & 1);
+            }
+            return false;
+        }
+
+        // FLAC ------------------------------------------------------------------
+
+        /// Reads the 34-byte STREAMINFO block body
+        bool parseStreamInfo(const uint8_t* block, AudioStreamInfo& info)
+        {
+            const uint8_t* p = block + 10;
+            info.sample_rate = (static_cast<uint32_t>(p[0]) << 12) | (static_cast<uint32_t>(p[1]) << 4) | (p[2] >> 4);
+            info.channels = static_cast<uint16_t>(((p[2] >> 1) & 0x07) + 1);
+            info.bits_per_sample = static_cast<uint16_t>((((p[2] & 0x01) << 4) | (p[3] >> 4)) + 1);
+            const uint64_t total = (static_cast<uint64_t>(p[3] & 0x0F) << 32) | readBe32(p + 4);
+            if (total != 0)
+            {
+                info.frames = total;
+            }
+            return info.sample_rate != 0;
+        }
+
+        bool probeFlac(HeaderReader& reader, uint64_t base, AudioStreamInfo& info)
+        {
+            const uint8_t* p = reader.at(base, 8 + 34);
+            if (!p || !tagIs(p, "fLaC") || (p[4] & 0x7F) != 0)
+            {
+                return false;
+            }
+            return parseStreamInfo(p + 8, info);
+        }
+
+        // Ogg -------------------------------------------------------------------
+
+        /// Granule position of the last page of a stream, or -1 if none is found near the end
+        int64_t lastGranule(HeaderReader& reader, uint32_t serial)
+        {
+            for (size_t window : {TAIL_BYTES, MAX_OGG_PAGE + 27})
+            {
+                const size_t length = static_cast<size_t>(std::min<uint64_t>(window, reader.size()));
+                const uint8_t* tail = reader.at(reader.size() - length, length);
+                if (!tail)
+                {
+                    return -1;
+                }
+                for (size_t i = length >= 27 ? length - 27 + 1 : 0; i-- > 0;)
+                {
+                    if (tail[i] == 'O' && tagIs(tail + i, "OggS") && tail[i + 4] == 0
+                        && readLe32(tail + i + 14) == serial)
+                    {
+                        const int64_t granule = static_cast<int64_t>(readLe64(tail + i + 6));
+                        if (granule >= 0)
+                        {
+                            return granule;
+                        }
+                    }
+                }
+                if (length == reader.size())
+                {
+                    break;
+                }
+            }
+            return -1;
+        }
+
+        bool probeOgg(HeaderReader& reader, AudioFormat& format, AudioStreamInfo& info)
+        {
+            const uint8_t* page = reader.at(0, 27);
+            if (!page || page[4] != 0)
+            {
+                return false;
+            }
+            const uint32_t serial = readLe32(page + 14);
+            const size_t segments = page[26];
+            const uint8_t* table = reader.at(27, segments);
+            if (!table)
+            {
+                return false;
+            }
+            size_t packet_size = 0;
+            for (size_t i = 0; i < segments; ++i)
+            {
+                packet_size += table[i];
+                if (table[i] < 255)
+                {
+                    break;
+                }
+            }
+
+            const uint64_t body = 27 + segments;
+            const uint8_t* packet = reader.at(body, std::min<size_t>(packet_size, 64));
+            if (!packet)
+            {
+                return false;
+            }
+
+            uint64_t pre_skip = 0;
+            if (packet_size >= 16 && tagIs(packet, "\x01vorbis"))
+            {
+                info.channels = packet[11];
+                info.sample_rate = readLe32(packet + 12);
+            }
+            else if (packet_size >= 19 && tagIs(packet, "OpusHead"))
+            {
+                // Opus always decodes at 48 kHz; the granule counts 48 kHz frames including pre-skip
+                info.channels = packet[9];
+                info.sample_rate = 48000;
+                pre_skip = readLe16(packet + 10);
+            }
+            else if (packet_size >= 51 && tagIs(packet, "\x7F" "FLAC") && tagIs(packet + 9, "fLaC"))
+            {
+                if (!parseStreamInfo(packet + 17, info))
+                {
+                    return false;
+                }
+                format = AudioFormat::Flac;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (!info.frames)
+            {
+                const int64_t granule = lastGranule(reader, serial);
+                if (granule >= 0)
+                {
+                    info.frames = static_cast<uint64_t>(granule) > pre_skip ? static_cast<uint64_t>(granule) - pre_skip : 0;
+                }
+            }
+            if (format != AudioFormat::Flac)
+            {
+                info.bits_per_sample = 0;
+            }
+            return info.sample_rate != 0 && info.channels != 0;
+        }
+
+        // MP3 -------------------------------------------------------------------
+
+        struct MpegFrame
+        {
+            bool mpeg1 = false;
+            int layer = 0;
+            uint32_t bitrate = 0;
+            uint32_t sample_rate = 0;
+            uint16_t channels = 0;
+            uint32_t samples = 0;
+            uint32_t length = 0;
+        };
+
+        bool parseMpegHeader(const uint8_t* h, MpegFrame& frame)
+        {
+            if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+            {
+                return false;
+            }
+            const int version = (h[1] >> 3) & 0x03;  // 0: 2.5, 2: 2, 3: 1
+            const int layer_bits = (h[1] >> 1) & 0x03;
+            const int bitrate_index = h[2] >> 4;
+            const int rate_index = (h[2] >> 2) & 0x03;
+            if (version == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3)
+            {
+                return false;
+            }
+
+            static const uint16_t BITRATES[5][15] = {
+                {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},  // MPEG-1 layer I
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},     // MPEG-1 layer II
+                {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},      // MPEG-1 layer III
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},     // MPEG-2/2.5 layer I
+                {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},          // MPEG-2/2.5 layer II/III
+            };
+            static const uint32_t RATES[3] = {44100, 48000, 32000};
+
+            frame.mpeg1 = version == 3;
+            frame.layer = 4 - layer_bits;
+            const int table = frame.mpeg1 ? frame.layer - 1 : (frame.layer == 1 ? 3 : 4);
+            frame.bitrate = BITRATES[table][bitrate_index] * 1000u;
+            frame.sample_rate = RATES[rate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+            frame.channels = (h[3] >> 6) == 3 ? 1 : 2;
+            frame.samples = frame.layer == 1 ? 384 : (frame.layer == 3 && !frame.mpeg1 ? 576 : 1152);
+            const uint32_t padding = (h[2] >> 1) & 0x01;
+            frame.length = frame.layer == 1
+                ? (12 * frame.bitrate / frame.sample_rate + padding) * 4
+                : frame.samples / 8 * frame.bitrate / frame.sample_rate + padding;
+            return frame.length >= 4;
+        }
+
+        /// Frame count of a Xing/Info (with LAME gapless trim) or VBRI header, if the first frame holds one
+        std::optional<uint64_t> vbrHeaderFrames(HeaderReader& reader, uint64_t start, const MpegFrame& frame)
+        {
+            const uint8_t* body = reader.at(start, frame.length);
+            if (!body)
+            {
+                return std::nullopt;
+            }
+
+            const size_t side_info = frame.mpeg1 ? (frame.channels == 1 ? 17 : 32) : (frame.channels == 1 ? 9 : 17);
+            const size_t xing = 4 + side_info;
+            if (frame.layer == 3 && frame.length >= xing + 12 && (tagIs(body + xing, "Xing") || tagIs(body + xing, "Info")))
+            {
+                const uint32_t flags = readBe32(body + xing + 4);
+                if (!(flags & 0x01))
+                {
+                    return std::nullopt;
+                }
+                uint64_t samples = static_cast<uint64_t>(readBe32(body + xing + 8)) * frame.samples;
+
+                size_t lame = xing + 8 + 4 + ((flags & 0x02) ? 4 : 0) + ((flags & 0x04) ? 100 : 0) + ((flags & 0x08) ? 4 : 0);
+                if (lame + 24 <= frame.length && std::isalpha(body[lame]) && std::isalpha(body[lame + 1]))
+                {
+                    // Encoder delay and padding, 12 bits each
+                    const uint8_t* gapless = body + lame + 21;
+                    const uint64_t trim = ((gapless[0] << 4) | (gapless[1] >> 4)) + (((gapless[1] & 0x0F) << 8) | gapless[2]);
+                    samples = samples > trim ? samples - trim : 0;
+                }
+                return samples;
+            }
+
+            if (frame.length >= 4 + 32 + 18 && tagIs(body + 4 + 32, "VBRI"))
+            {
+                return static_cast<uint64_t>(readBe32(body + 4 + 32 + 14)) * frame.samples;
+            }
+            return std::nullopt;
+        }
+
+        bool probeMp3(HeaderReader& reader, uint64_t start, AudioStreamInfo& info)
+        {
+            const size_t window = static_cast<size_t>(std::min<uint64_t>(MPEG_SYNC_WINDOW, reader.size() - start));
+            const uint8_t* found = reader.at(start, window);
+            if (!found)
+            {
+                return false;
+            }
+            // Kept apart from the reader's buffer, which the checks below reuse
+            const std::vector<uint8_t> bytes(found, found + window);
+
+            // A sync word can occur by chance, so the next frame must follow where the first one ends
+            for (size_t i = 0; i + 4 <= window; ++i)
+            {
+                MpegFrame frame;
+                if (bytes[i] != 0xFF || !parseMpegHeader(bytes.data() + i, frame))
+                {
+                    continue;
+                }
+                const uint64_t next = start + i + frame.length;
+                if (next + 4 <= reader.size())
+                {
+                    MpegFrame following;
+                    const uint8_t* header = reader.at(next, 4);
+                    if (!header || !parseMpegHeader(header, following) || following.sample_rate != frame.sample_rate
+                        || following.layer != frame.layer)
+                    {
+                        continue;
+                    }
+                }
+
+                info.sample_rate = frame.sample_rate;
+                info.channels = frame.channels;
+                info.bits_per_sample = 0;
+
+                const uint64_t first = start + i;
+                info.frames = vbrHeaderFrames(reader, first, frame);
+                if (!info.frames)
+                {
+                    // Constant bitrate: the audio's size and bitrate give its duration
+                    uint64_t end = reader.size();
+                    const uint8_t* tag = end >= first + 128 ? reader.at(end - 128, 3) : nullptr;
+                    if (tag && tagIs(tag, "TAG"))
+                    {
+                        end -= 128;
+                    }
+                    info.frames = (end - first) * 8 * frame.sample_rate / frame.bitrate;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        /// Offset of the first byte after any ID3v2 tags at the start
+        uint64_t skipId3(HeaderReader& reader)
+        {
+            uint64_t offset = 0;
+            while (const uint8_t* tag = reader.at(offset, 10))
+            {
+                if (!tagIs(tag, "ID3") || ((tag[6] | tag[7] | tag[8] | tag[9]) & 0x80))
+                {
+                    break;
+                }
+                const uint64_t size = (static_cast<uint64_t>(tag[6]) << 21) | (tag[7] << 14) | (tag[8] << 7) | tag[9];
+                offset += 10 + size + ((tag[5] & 0x10) ? 10 : 0);
+            }
+            return offset;
+        }
+
+        AudioFileInfo probe(HeaderReader& reader);
+
+        // Compressed PCM ----------------------------------------------------------
+
+        /**
+         * @brief Probes the original file inside the output of compressPcmFile()
+         *
+         * The compressed file keeps the original bytes before and after the
+         * samples verbatim, so the original headers are probed through a view
+         * that puts them back at their original offsets; the samples
+         * themselves are never needed. The frame count comes from the codec
+         * header.
+         */
+        AudioFileInfo probeCompressedPcm(HeaderReader& reader)
+        {
+            AudioFileInfo result;
+            result.file_size = reader.size();
+            const uint8_t* header = reader.at(0, 64);
+            if (!header)
+            {
+                return result;
+            }
+            const uint64_t original_size = readLe64(header + 8);
+            const uint64_t offset = readLe64(header + 16);
+            const uint64_t frames = readLe64(header + 24);
+            const uint64_t block_count = readLe32(header + 36);
+            const uint64_t frame_bytes = uint64_t(readLe16(header + 40)) * (header[42] / 8);
+            if (offset > original_size || frame_bytes == 0 || frames > (original_size - offset) / frame_bytes)
+            {
+                return result;
+            }
+            const uint64_t samples_end = offset + frames * frame_bytes;
+            const uint64_t prefix_at = 64 + block_count * 8;
+            const uint64_t suffix_at = prefix_at + offset;
+
+            HeaderReader original([&](uint64_t position, uint8_t* buffer, size_t size) {
+                size_t done = 0;
+                while (done < size)
+                {
+                    const uint64_t at = position + done;
+                    uint64_t source = 0;
+                    uint64_t available = 0;
+                    if (at < offset)
+                    {
+                        source = prefix_at + at;
+                        available = offset - at;
+                    }
+                    else if (at >= samples_end && at < original_size)
+                    {
+                        source = suffix_at + (at - samples_end);
+                        available = original_size - at;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                    const auto count = static_cast<size_t>(std::min<uint64_t>(size - done, available));
+                    const uint8_t* bytes = reader.at(source, count);
+                    if (!bytes)
+                    {
+                        break;
+                    }
+                    std::memcpy(buffer + done, bytes, count);
+                    done += count;
+                }
+                return done;
+            }, original_size);
+
+            // Only WAV and AIFF are ever compressed; this also keeps a crafted file from nesting
+            const uint8_t* magic = original.at(0, 8);
+            if (!magic || isCompressedPcmFile(magic, 8))
+            {
+                return result;
+            }
+            const AudioFileInfo inner = probe(original);
+            if (inner.valid() && (inner.format == AudioFormat::Wav || inner.format == AudioFormat::Aiff))
+            {
+                result.format = inner.format;
+                result.stream = inner.stream;
+                result.stream.frames = frames;
+            }
+            return result;
+        }
+
+        /**
+         * @brief Probes a file through a reader
+         */
+        AudioFileInfo probe(HeaderReader& reader)
+        {
+            AudioFileInfo result;
+            result.file_size = reader.size();
+
+            const uint8_t* head = reader.at(0, static_cast<size_t>(std::min<uint64_t>(AUDIO_SNIFF_BYTES, reader.size())));
+            if (head && isCompressedPcmFile(head, static_cast<size_t>(std::min<uint64_t>(AUDIO_SNIFF_BYTES, reader.size()))))
+            {
+                return probeCompressedPcm(reader);
+            }
+            AudioFormat format = head ? sniffAudioFormat(head, static_cast<size_t>(std::min<uint64_t>(AUDIO_SNIFF_BYTES, reader.size())))
+                                      : AudioFormat::Unknown;
+
+            AudioStreamInfo info;
+            bool ok = false;
+            switch (format)
+            {
+            case AudioFormat::Wav:
+                ok = probeWav(reader, info);
+                break;
+            case AudioFormat::Aiff:
+                ok = probeAiff(reader, info);
+                break;
+            case AudioFormat::Flac:
+                ok = probeFlac(reader, 0, info);
+                break;
+            case AudioFormat::Ogg:
+                ok = probeOgg(reader, format, info);
+                break;
+            case AudioFormat::Mp3:
+            {
+                // Some taggers put ID3v2 in front of FLAC too
+                const uint64_t start = skipId3(reader);
+                const uint8_t* magic = reader.at(start, 4);
+                if (magic && tagIs(magic, "fLaC"))
+                {
+                    format = AudioFormat::Flac;
+                    ok = probeFlac(reader, start, info);
+                }
+                else
+                {
+                    ok = probeMp3(reader, start, info);
+                }
+                break;
+            }
+            case AudioFormat::Unknown:
+                break;
+            }
+
+            if (ok)
+            {
+                result.format = format;
+                result.stream = info;
+            }
+            return result;
+        }
+
+        // Files -----------------------------------------------------------------
+
+        int openForReading(const std::string& path)
+        {
+#ifdef _WIN32
+            return _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+            return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+        }
+
+        void closeFile(int fd)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+
+        uint64_t fileSize(int fd)
+        {
+#ifdef _WIN32
+            struct _stat64 status;
+            return _fstat64(fd, &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+#else
+            struct stat status;
+            return fstat(fd, &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+#endif
+        }
+
+        size_t readAt(int fd, uint64_t offset, uint8_t* buffer, size_t size)
+        {
+            size_t done = 0;
+#ifdef _WIN32
+            // Each descriptor belongs to one worker, so seek + read is safe
+            if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+            {
+                return 0;
+            }
+            while (done < size)
+            {
+                const int got = _read(fd, buffer + done, static_cast<unsigned int>(std::min<size_t>(size - done, 0x40000000u)));
+                if (got <= 0)
+                {
+                    break;
+                }
+                done += static_cast<size_t>(got);
+            }
+#else
+            while (done < size)
+            {
+                const ssize_t got = pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (got <= 0)
+                {
+                    break;
+                }
+                done += static_cast<size_t>(got);
+            }
+#endif
+            return done;
+        }
+
+        /// Whether the kernel should also fetch the end of a file ahead of time (Ogg and MP3 read it)
+        bool readsTail(const std::string& path)
+        {
+            std::string extension = fs::path(path).extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return extension == ".ogg" || extension == ".oga" || extension == ".opus" || extension == ".mp3";
+        }
+
+        /**
+         * @brief Asks the kernel to start reading the pages the probe of a file will need
+         */
+        void adviseHeaders(const std::string& path)
+        {
+#if defined(POSIX_FADV_WILLNEED)
+            const int fd = openForReading(path);
+            if (fd < 0)
+            {
+                return;
+            }
+            posix_fadvise(fd, 0, HEAD_BYTES, POSIX_FADV_WILLNEED);
+            const uint64_t size = fileSize(fd);
+            if (size > HEAD_BYTES && readsTail(path))
+            {
+                const uint64_t tail = std::min<uint64_t>(size, TAIL_BYTES);
+                posix_fadvise(fd, static_cast<off_t>(size - tail), static_cast<off_t>(tail), POSIX_FADV_WILLNEED);
+            }
+            // The reads continue after the descriptor is closed
+            closeFile(fd);
+#else
+            (void)path;
+#endif
+        }
+    }
+
+    /**
+     * @brief Reads the format and length of an audio file from its headers only
+     *
+     * @param path File to probe
+     * @return AudioFileInfo Information; check valid()
+     */
+    AudioFileInfo probeAudioFile(const std::string& path)
+    {
+        const int fd = openForReading(path);
+        if (fd < 0)
+        {
+            AudioFileInfo result;
+            result.path = path;
+            return result;
+        }
+#if defined(POSIX_FADV_RANDOM)
+        // Only a few pages are read; keep the kernel from reading ahead through the audio
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+
+        HeaderReader reader([fd](uint64_t offset, uint8_t* buffer, size_t size) {
+            return readAt(fd, offset, buffer, size);
+        }, fileSize(fd));
+        AudioFileInfo result = probe(reader);
+        closeFile(fd);
+        result.path = path;
+        return result;
+    }
+
+    /**
+     * @brief Reads the format and length of audio held in memory from its headers
+     *
+     * @param data File contents
+     * @param size Number of bytes at data
+     * @return AudioFileInfo Information; check valid()
+     */
+    AudioFileInfo probeAudioData(const uint8_t* data, size_t size)
+    {
+        HeaderReader reader([data, size](uint64_t offset, uint8_t* buffer, size_t length) {
+            const size_t available = offset < size ? std::min<size_t>(length, size - static_cast<size_t>(offset)) : 0;
+            std::memcpy(buffer, data + offset, available);
+            return available;
+        }, size);
+        return probe(reader);
+    }
+
+    /**
+     * @brief Probes many files in parallel
+     *
+     * @param paths Files to probe
+     * @param options Thread count and readahead distance
+     * @return std::vector<AudioFileInfo> One entry per path, in the same order
+     */
+    std::vector<AudioFileInfo> scanAudioFiles(const std::vector<std::string>& paths, const ScanOptions& options)
+    {
+        std::vector<AudioFileInfo> results(paths.size());
+        if (paths.empty())
+        {
+            return results;
+        }
+
+        unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+        const size_t readahead = options.readahead;
+
+        for (size_t i = 0; i < std::min(readahead, paths.size()); ++i)
+        {
+            adviseHeaders(paths[i]);
+        }
+
+        // Whoever claims file i starts the reads of file i + readahead, so the advice stays that far ahead
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < paths.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                if (readahead && i + readahead < paths.size())
+                {
+                    adviseHeaders(paths[i + readahead]);
+                }
+                results[i] = probeAudioFile(paths[i]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return results;
+    }
+
+    /**
+     * @brief Probes every audio file below a directory, e.g. a SoundStore root
+     *
+     * @param root Directory to walk recursively
+     * @param options Thread count and readahead distance
+     * @return std::vector<AudioFileInfo> One entry per audio file found, in path order
+     */
+    std::vector<AudioFileInfo> scanAudioDirectory(const std::string& root, const ScanOptions& options)
+    {
+        static const std::set<std::string> EXTENSIONS = {
+            ".wav", ".aif", ".aiff", ".aifc", ".flac", ".ogg", ".oga", ".opus", ".mp3", ".fsl"};
+
+        std::vector<std::string> paths;
+        std::error_code error;
+        for (fs::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        {
+            if (!it->is_regular_file(error))
+            {
+                continue;
+            }
+            std::string extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (EXTENSIONS.count(extension))
+            {
+                paths.push_back(it->path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return scanAudioFiles(paths, options);
+    }
+}
@@ -0,0 +1,281 @@
+/**
+ * @file src/buffer_pool.cpp
+ * @brief Implementation of the size-classed buffer pool
+ *
+ * @see include/buffer_pool.h
+ */
+
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Free lists shared by a pool and every buffer it handed out
+     */
+    struct PooledBuffer::Shelves
+    {
+        /// One size class per power of two from MIN_BLOCK to MAX_BLOCK
+        static constexpr size_t CLASSES = 15;
+        static_assert((BufferPool::MIN_BLOCK << (CLASSES - 1)) == BufferPool::MAX_BLOCK,
+            "size classes must span MIN_BLOCK to MAX_BLOCK");
+
+        explicit Shelves(size_t max_cached) : max_cached_bytes(max_cached) {}
+
+        ~Shelves()
+        {
+            freeAll();
+        }
+
+        /**
+         * @brief Rounds a request up to its block size
+         *
+         * @param capacity Requested capacity
+         * @param size_class Receives the class index, or CLASSES if uncached
+         * @return size_t Block size to allocate
+         */
+        static size_t blockSize(size_t capacity, size_t& size_class)
+        {
+            if (capacity > BufferPool::MAX_BLOCK)
+            {
+                size_class = CLASSES;
+                return capacity;
+            }
+
+            size_t block = BufferPool::MIN_BLOCK;
+            size_class = 0;
+            while (block < capacity)
+            {
+                block <<= 1;
+                ++size_class;
+            }
+            return block;
+        }
+
+        /**
+         * @brief Takes a cached block or allocates a new one
+         *
+         * @param capacity Requested capacity
+         * @param block Receives the usable size of the block
+         * @return uint8_t* Block, or nullptr if allocation failed
+         */
+        uint8_t* take(size_t capacity, size_t& block)
+        {
+            size_t size_class = 0;
+            block = blockSize(capacity, size_class);
+            if (size_class < CLASSES)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& shelf = free[size_class];
+                if (!shelf.empty())
+                {
+                    uint8_t* data = shelf.back();
+                    shelf.pop_back();
+                    cached_bytes -= block;
+                    return data;
+                }
+            }
+
+            // Allocate outside the lock; the memory is not touched until it is written
+            uint8_t* data = static_cast<uint8_t*>(::operator new(block, std::nothrow));
+            if (!data)
+            {
+                block = 0;
+            }
+            return data;
+        }
+
+        /**
+         * @brief Caches a released block, or frees it once the cap is reached
+         *
+         * @param data Block obtained from take()
+         * @param block Size of the block
+         */
+        void give(uint8_t* data, size_t block)
+        {
+            size_t size_class = 0;
+            blockSize(block, size_class);
+            if (size_class < CLASSES)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (cached_bytes + block <= max_cached_bytes)
+                {
+                    free[size_class].push_back(data);
+                    cached_bytes += block;
+                    return;
+                }
+            }
+            ::operator delete(data);
+        }
+
+        void freeAll()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& shelf : free)
+            {
+                for (uint8_t* data : shelf)
+                {
+                    ::operator delete(data);
+                }
+                shelf.clear();
+            }
+            cached_bytes = 0;
+        }
+
+        const size_t max_cached_bytes;
+        std::mutex mutex;
+        std::vector<uint8_t*> free[CLASSES];
+        size_t cached_bytes = 0;
+    };
+
+    PooledBuffer::PooledBuffer(std::shared_ptr<Shelves> shelves, uint8_t* data, size_t capacity)
+        : m_shelves(std::move(shelves)), m_data(data), m_capacity(capacity)
+    {
+    }
+
+    /**
+     * @brief Returns the memory to its pool
+     */
+    PooledBuffer::~PooledBuffer()
+    {
+        release();
+    }
+
+    PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+        : m_shelves(std::move(other.m_shelves)),
+          m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_capacity(std::exchange(other.m_capacity, 0))
+    {
+    }
+
+    PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_shelves = std::move(other.m_shelves);
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_capacity = std::exchange(other.m_capacity, 0);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Ensures room for at least capacity bytes
+     *
+     * @param capacity Required capacity in bytes
+     * @return bool False if the buffer has no pool or allocation failed
+     */
+    bool PooledBuffer::reserve(size_t capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return true;
+        }
+        if (!m_shelves)
+        {
+            return false;
+        }
+
+        size_t block = 0;
+        uint8_t* data = m_shelves->take(capacity, block);
+        if (!data)
+        {
+            return false;
+        }
+
+        if (m_size > 0)
+        {
+            std::memcpy(data, m_data, m_size);
+        }
+        if (m_data)
+        {
+            m_shelves->give(m_data, m_capacity);
+        }
+        m_data = data;
+        m_capacity = block;
+        return true;
+    }
+
+    /**
+     * @brief Appends bytes, growing the buffer geometrically if needed
+     *
+     * @param data Bytes to append
+     * @param size Number of bytes at data
+     * @return bool False if the buffer could not grow
+     */
+    bool PooledBuffer::append(const void* data, size_t size)
+    {
+        if (size == 0)
+        {
+            return true;
+        }
+        if (m_size + size > m_capacity && !reserve(std::max(m_size + size, m_capacity * 2)))
+        {
+            return false;
+        }
+
+        std::memcpy(m_data + m_size, data, size);
+        m_size += size;
+        return true;
+    }
+
+    void PooledBuffer::release()
+    {
+        if (m_data)
+        {
+            m_shelves->give(m_data, m_capacity);
+        }
+        m_shelves.reset();
+        m_data = nullptr;
+        m_size = 0;
+        m_capacity = 0;
+    }
+
+    /**
+     * @brief Creates an empty pool
+     *
+     * @param max_cached_bytes Upper bound on memory kept for reuse
+     */
+    BufferPool::BufferPool(size_t max_cached_bytes)
+        : m_shelves(std::make_shared<PooledBuffer::Shelves>(max_cached_bytes))
+    {
+    }
+
+    /**
+     * @brief Takes an empty buffer with room for at least capacity bytes
+     *
+     * @param capacity Required capacity in bytes
+     * @return PooledBuffer Empty buffer; capacity() is 0 if allocation failed
+     */
+    PooledBuffer BufferPool::acquire(size_t capacity)
+    {
+        size_t block = 0;
+        uint8_t* data = m_shelves->take(std::max<size_t>(capacity, 1), block);
+        return PooledBuffer(m_shelves, data, block);
+    }
+
+    /**
+     * @brief Returns the memory currently held for reuse
+     */
+    size_t BufferPool::cachedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_shelves->mutex);
+        return m_shelves->cached_bytes;
+    }
+
+    /**
+     * @brief Frees every cached block
+     */
+    void BufferPool::trim()
+    {
+        m_shelves->freeAll();
+    }
+}
@@ -0,0 +1,490 @@
+/**
+ * @file src/catalog_crawler.cpp
+ * @brief Implementation of the CatalogCrawler class
+ *
+ * Splits the sound ID space into ranges, crawls them in parallel under a
+ * shared rate limit and keeps per-range checkpoints in a job directory so
+ * that several processes can share and resume the work.
+ *
+ * @see include/catalog_crawler.h
+ */
+
+#include "catalog_crawler.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Sort order that keeps paging stable while new sounds are uploaded
+        const char* const CRAWL_SORT = "created_asc";
+
+        /**
+         * @brief Builds an identifier for this process that is unique across hosts
+         *
+         * @return std::string Identifier of the form `host-pid`
+         */
+        std::string processOwnerId()
+        {
+            std::string host = "localhost";
+#ifdef _WIN32
+            if (const char* name = std::getenv("COMPUTERNAME"))
+            {
+                host = name;
+            }
+            return host + "-" + std::to_string(_getpid());
+#else
+            char name[256] = {};
+            if (gethostname(name, sizeof(name) - 1) == 0 && name[0] != '\0')
+            {
+                host = name;
+            }
+            return host + "-" + std::to_string(getpid());
+#endif
+        }
+
+        /**
+         * @brief Reads the owner recorded in a claim file
+         *
+         * @param claim_path Path of the claim file
+         * @return std::string Owner identifier, empty if the file cannot be read
+         */
+        std::string readClaimOwner(const fs::path& claim_path)
+        {
+            std::ifstream in(claim_path);
+            std::string owner;
+            std::getline(in, owner);
+            return owner;
+        }
+
+        /**
+         * @brief Reads the next page recorded for a range
+         *
+         * @param progress_path Path of the range's progress file
+         * @return int Next page to fetch, 1 when no checkpoint exists
+         */
+        int readCheckpoint(const fs::path& progress_path)
+        {
+            std::ifstream in(progress_path);
+            int next_page = 1;
+            if (in >> next_page && next_page >= 1)
+            {
+                return next_page;
+            }
+            return 1;
+        }
+
+        /**
+         * @brief Atomically replaces one of a range's job files
+         *
+         * @param path Path of the job file
+         * @param contents New contents of the file
+         * @param owner Owner identifier used to name the temporary file
+         * @return bool True if the file was written and renamed into place
+         */
+        bool replaceJobFile(const fs::path& path, const std::string& contents, const std::string& owner)
+        {
+            fs::path temp_path = path;
+            temp_path += ".tmp." + owner;
+
+            {
+                std::ofstream out(temp_path, std::ios::trunc);
+                if (!out)
+                {
+                    return false;
+                }
+                out << contents;
+                out.close();
+                if (!out)
+                {
+                    std::error_code ec;
+                    fs::remove(temp_path, ec);
+                    return false;
+                }
+            }
+
+            std::error_code ec;
+            fs::rename(temp_path, path, ec);
+            if (ec)
+            {
+                fs::remove(temp_path, ec);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Atomically replaces a range's progress file
+         *
+         * @param progress_path Path of the range's progress file
+         * @param next_page Page to resume from
+         * @param owner Owner identifier used to name the temporary file
+         * @return bool True if the checkpoint was written
+         */
+        bool writeCheckpoint(const fs::path& progress_path, int next_page, const std::string& owner)
+        {
+            return replaceJobFile(progress_path, std::to_string(next_page) + "\n", owner);
+        }
+    }
+
+    /**
+     * @brief Constructs a crawler that issues requests through a Downloader
+     *
+     * @param downloader Authenticated Downloader used for the searches
+     * @param options Crawl configuration
+     * @throws std::invalid_argument If the options describe an empty crawl
+     */
+    CatalogCrawler::CatalogCrawler(Downloader& downloader, CrawlOptions options)
+        : CatalogCrawler(
+            [&downloader, query = options.query](const std::string& filter, int page, int page_size)
+            {
+                return downloader.searchSounds(
+                    query, filter, std::string(CRAWL_SORT), page, page_size);
+            },
+            std::move(options))
+    {
+    }
+
+    /**
+     * @brief Constructs a crawler around a custom page fetcher
+     *
+     * @param fetcher Function used to retrieve each page
+     * @param options Crawl configuration
+     * @throws std::invalid_argument If the options describe an empty crawl
+     */
+    CatalogCrawler::CatalogCrawler(PageFetcher fetcher, CrawlOptions options)
+        : m_fetcher(std::move(fetcher)),
+          m_options(std::move(options)),
+          m_limiter(m_options.requests_per_minute),
+          m_owner(processOwnerId())
+    {
+        if (m_options.min_id > m_options.max_id
+            || m_options.range_size <= 0
+            || m_options.page_size <= 0
+            || m_options.max_attempts <= 0)
+        {
+            throw std::invalid_argument(
+                "Catalog crawl requires a non-empty ID span and positive range size, "
+                "page size and attempt count."
+            );
+        }
+
+        for (long long first = m_options.min_id; first <= m_options.max_id;
+             first += m_options.range_size)
+        {
+            long long last = std::min<long long>(
+                first + m_options.range_size - 1, m_options.max_id);
+            m_ranges.push_back({static_cast<int>(first), static_cast<int>(last)});
+        }
+    }
+
+    /**
+     * @brief Crawls every range not yet finished or claimed elsewhere
+     *
+     * @param on_page Callback receiving each page of results
+     * @return CrawlStats Summary of the work done by this call
+     * @throws std::filesystem::filesystem_error If the job directory cannot be created
+     */
+    CrawlStats CatalogCrawler::run(const PageCallback& on_page)
+    {
+        fs::create_directories(m_options.job_dir);
+
+        m_cursor = 0;
+        m_stop = false;
+
+        CrawlStats stats;
+        const int worker_count = workerCount();
+
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (int i = 0; i < worker_count; ++i)
+        {
+            workers.emplace_back([this, &on_page, &stats]() { worker(on_page, stats); });
+        }
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+
+        return stats;
+    }
+
+    /**
+     * @brief Asks a running crawl to stop after the pages in flight
+     */
+    void CatalogCrawler::stop()
+    {
+        m_stop = true;
+    }
+
+    /**
+     * @brief Returns the number of worker threads run() will start
+     *
+     * Without an explicit max_workers, the pool holds just enough workers to
+     * keep the request budget busy given the expected page latency; more
+     * threads would only queue on the rate limiter.
+     *
+     * @return int Worker count derived from the options and the range count
+     */
+    int CatalogCrawler::workerCount() const
+    {
+        int workers = m_options.max_workers;
+        if (workers <= 0)
+        {
+            const double requests_per_ms = m_options.requests_per_minute / 60000.0;
+            workers = static_cast<int>(std::ceil(
+                requests_per_ms * static_cast<double>(m_options.expected_latency.count())));
+        }
+
+        workers = std::max(workers, 1);
+        return std::min(workers, static_cast<int>(m_ranges.size()));
+    }
+
+    /**
+     * @brief Builds the search filter for an inclusive ID range
+     *
+     * @param first_id First sound ID of the range
+     * @param last_id Last sound ID of the range
+     * @return std::string Filter of the form `id:[first TO last]`
+     */
+    std::string CatalogCrawler::rangeFilter(int first_id, int last_id)
+    {
+        return "id:[" + std::to_string(first_id) + " TO " + std::to_string(last_id) + "]";
+    }
+
+    /**
+     * @brief Worker loop: claims ranges in ID order until none are left
+     *
+     * @param on_page Callback receiving each page of results
+     * @param stats Statistics shared by all workers
+     */
+    void CatalogCrawler::worker(const PageCallback& on_page, CrawlStats& stats)
+    {
+        while (!m_stop)
+        {
+            const size_t index = m_cursor++;
+            if (index >= m_ranges.size())
+            {
+                return;
+            }
+
+            RangeResult result = crawlRange(m_ranges[index], on_page, stats);
+
+            std::lock_guard<std::mutex> lock(m_callback_mutex);
+            switch (result)
+            {
+                case RangeResult::Completed: ++stats.ranges_completed; break;
+                case RangeResult::Failed:    ++stats.ranges_failed;    break;
+                case RangeResult::Skipped:   ++stats.ranges_skipped;   break;
+                case RangeResult::Stopped:   break;
+            }
+        }
+    }
+
+    /**
+     * @brief Pages through one range, checkpointing after every delivered page
+     *
+     * @param range Range to crawl
+     * @param on_page Callback receiving each page of results
+     * @param stats Statistics shared by all workers
+     * @return RangeResult How processing of the range ended
+     */
+    CatalogCrawler::RangeResult CatalogCrawler::crawlRange(
+        const Range& range,
+        const PageCallback& on_page,
+        CrawlStats& stats
+    )
+    {
+        const std::string stem = stemFor(range);
+        const fs::path claim_path = stem + ".claim";
+        const fs::path progress_path = stem + ".progress";
+        const fs::path done_path = stem + ".done";
+
+        std::error_code ec;
+        if (fs::exists(done_path, ec) || !tryClaim(stem))
+        {
+            return RangeResult::Skipped;
+        }
+
+        std::string filter = rangeFilter(range.first_id, range.last_id);
+        if (m_options.filter)
+        {
+            filter += " " + *m_options.filter;
+        }
+
+        int page = readCheckpoint(progress_path);
+        while (true)
+        {
+            if (m_stop)
+            {
+                fs::remove(claim_path, ec);
+                return RangeResult::Stopped;
+            }
+
+            std::optional<nlohmann::json> payload;
+            std::string text;
+            for (int attempt = 0; attempt < m_options.max_attempts && !payload; ++attempt)
+            {
+                m_limiter.acquire();
+                {
+                    std::lock_guard<std::mutex> lock(m_callback_mutex);
+                    ++stats.requests_issued;
+                }
+
+                auto response = m_fetcher(filter, page, m_options.page_size);
+                if (!response)
+                {
+                    continue;
+                }
+
+                try
+                {
+                    payload = nlohmann::json::parse(*response);
+                    text = std::move(*response);
+                }
+                catch (const nlohmann::json::exception&)
+                {
+                    payload.reset();
+                }
+            }
+
+            if (!payload)
+            {
+                fs::remove(claim_path, ec);
+                return RangeResult::Failed;
+            }
+
+            const auto results = payload->find("results");
+            const bool empty = results == payload->end()
+                || !results->is_array() || results->empty();
+            const auto next = payload->find("next");
+            const bool last_page = empty || next == payload->end() || next->is_null();
+
+            if (!empty)
+            {
+                std::lock_guard<std::mutex> lock(m_callback_mutex);
+                ++stats.pages_fetched;
+                if (!on_page(range.first_id, range.last_id, page, text))
+                {
+                    m_stop = true;
+                }
+            }
+
+            // A range whose progress cannot be recorded keeps its claim, so
+            // that it is resumed from the last checkpoint once the lease expires
+            if (last_page)
+            {
+                if (!replaceJobFile(done_path, m_owner + "\n", m_owner))
+                {
+                    return RangeResult::Failed;
+                }
+                fs::remove(claim_path, ec);
+                return RangeResult::Completed;
+            }
+
+            ++page;
+            if (!writeCheckpoint(progress_path, page, m_owner))
+            {
+                return RangeResult::Failed;
+            }
+            fs::last_write_time(claim_path, fs::file_time_type::clock::now(), ec);
+        }
+    }
+
+    /**
+     * @brief Claims a range for this process
+     *
+     * The claim file is created exclusively, so only one process can hold a
+     * range. A claim whose heartbeat is older than the lease timeout belongs
+     * to a crashed owner; it is moved aside and claimed afresh. Another
+     * process may have taken the range over between the check and the move,
+     * so the moved file must still carry the expired heartbeat and owner;
+     * otherwise it is linked back into place and the range is left alone.
+     *
+     * @param stem Path prefix of the range's job files
+     * @return bool True if this process now owns the range
+     */
+    bool CatalogCrawler::tryClaim(const std::string& stem)
+    {
+        // Tells apart the takeovers of threads in this process
+        static std::atomic<unsigned> abandon_counter{0};
+
+        const std::string claim_path = stem + ".claim";
+
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            if (FILE* claim = std::fopen(claim_path.c_str(), "wx"))
+            {
+                std::fputs((m_owner + "\n").c_str(), claim);
+                std::fclose(claim);
+                return true;
+            }
+
+            std::error_code ec;
+            const auto heartbeat = fs::last_write_time(claim_path, ec);
+            if (ec)
+            {
+                // The claim vanished between the two calls; try creating it again
+                continue;
+            }
+
+            const auto age = fs::file_time_type::clock::now() - heartbeat;
+            if (age < m_options.lease_timeout)
+            {
+                return false;
+            }
+
+            const std::string owner = readClaimOwner(claim_path);
+            const std::string abandoned_path = claim_path + ".abandoned." + m_owner + "."
+                + std::to_string(abandon_counter.fetch_add(1));
+            fs::rename(claim_path, abandoned_path, ec);
+            if (ec)
+            {
+                return false;
+            }
+
+            const auto moved_heartbeat = fs::last_write_time(abandoned_path, ec);
+            if (ec || moved_heartbeat != heartbeat || readClaimOwner(abandoned_path) != owner)
+            {
+                // The expired claim was replaced before the move, so a live
+                // owner's claim was moved; put it back unless yet another
+                // claim has appeared since, which then holds the range
+                fs::create_hard_link(abandoned_path, claim_path, ec);
+                fs::remove(abandoned_path, ec);
+                return false;
+            }
+            fs::remove(abandoned_path, ec);
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Returns the path prefix of a range's job files
+     *
+     * @param range Range to name
+     * @return std::string Path of the form `<job_dir>/range_<first>_<last>`
+     */
+    std::string CatalogCrawler::stemFor(const Range& range) const
+    {
+        return (fs::path(m_options.job_dir)
+            / ("range_" + std::to_string(range.first_id) + "_" + std::to_string(range.last_id)))
+            .string();
+    }
+}
@@ -0,0 +1,544 @@
+/**
+ * @file src/columnar_export.cpp
+ * @brief Implementation of the columnar metadata export writer and reader
+ *
+ * @see include/columnar_export.h
+ */
+
+#include "columnar_export.h"
+#include <nlohmann/json.hpp>
+#include <cstring>
+#include <fstream>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        const char FILE_MAGIC[8] = {'F', 'S', 'C', 'O', 'L', '0', '0', '1'};
+        const char TRAILER_MAGIC[8] = {'F', 'S', 'C', 'O', 'L', 'E', 'N', 'D'};
+
+        /// Column sections start on cache-line boundaries so views can be used with SIMD loads
+        constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+        /// footer offset, footer size, row count, magic
+        constexpr size_t TRAILER_SIZE = 8 + 8 + 8 + sizeof(TRAILER_MAGIC);
+
+        /// Number of sections stored for each column type
+        size_t sectionCount(ColumnType type)
+        {
+            switch (type)
+            {
+                case ColumnType::Int64:      return 1;
+                case ColumnType::Float64:    return 1;
+                case ColumnType::String:     return 3;
+                case ColumnType::StringList: return 4;
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Writes column sections and collects the footer index
+         */
+        class SectionWriter
+        {
+        public:
+            explicit SectionWriter(std::ofstream& out) : m_out(out) {}
+
+            template <typename T>
+            void addSection(const std::vector<T>& values)
+            {
+                addSection(values.data(), values.size() * sizeof(T));
+            }
+
+            void addSection(const void* data, size_t size)
+            {
+                static const char padding[SECTION_ALIGNMENT] = {};
+                const uint64_t misalignment = m_position % SECTION_ALIGNMENT;
+                if (misalignment != 0)
+                {
+                    const uint64_t pad = SECTION_ALIGNMENT - misalignment;
+                    m_out.write(padding, static_cast<std::streamsize>(pad));
+                    m_position += pad;
+                }
+
+                appendFooter(m_position);
+                appendFooter(static_cast<uint64_t>(size));
+                m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                m_position += size;
+            }
+
+            void beginColumn(const std::string& name, ColumnType type)
+            {
+                appendFooter(static_cast<uint16_t>(name.size()));
+                m_footer.insert(m_footer.end(), name.begin(), name.end());
+                appendFooter(static_cast<uint8_t>(type));
+                appendFooter(static_cast<uint8_t>(sectionCount(type)));
+                ++m_column_count;
+            }
+
+            void addDictionary(const std::vector<const std::string*>& entries)
+            {
+                std::vector<uint64_t> offsets;
+                offsets.reserve(entries.size() + 1);
+                offsets.push_back(0);
+                std::string bytes;
+                for (const std::string* entry : entries)
+                {
+                    bytes += *entry;
+                    offsets.push_back(bytes.size());
+                }
+                addSection(offsets);
+                addSection(bytes.data(), bytes.size());
+            }
+
+            void finish(uint64_t row_count)
+            {
+                std::vector<char> footer;
+                footer.resize(sizeof(uint32_t));
+                std::memcpy(footer.data(), &m_column_count, sizeof(uint32_t));
+                footer.insert(footer.end(), m_footer.begin(), m_footer.end());
+
+                const uint64_t footer_offset = m_position;
+                const uint64_t footer_size = footer.size();
+                m_out.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+                m_out.write(reinterpret_cast<const char*>(&footer_offset), sizeof(footer_offset));
+                m_out.write(reinterpret_cast<const char*>(&footer_size), sizeof(footer_size));
+                m_out.write(reinterpret_cast<const char*>(&row_count), sizeof(row_count));
+                m_out.write(TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+            }
+
+        private:
+            template <typename T>
+            void appendFooter(T value)
+            {
+                const char* bytes = reinterpret_cast<const char*>(&value);
+                m_footer.insert(m_footer.end(), bytes, bytes + sizeof(T));
+            }
+
+            std::ofstream& m_out;
+            uint64_t m_position = sizeof(FILE_MAGIC);
+            uint32_t m_column_count = 0;
+            std::vector<char> m_footer;
+        };
+
+        /// Reads a string member, returning an empty string when absent or mistyped
+        std::string stringField(const nlohmann::json& object, const char* key)
+        {
+            auto it = object.find(key);
+            return it != object.end() && it->is_string() ? it->get<std::string>() : std::string();
+        }
+    }
+
+    /**
+     * @brief Returns a dictionary entry, or an empty view for out-of-range codes
+     *
+     * @param code Dictionary code
+     * @return std::string_view String stored under the code
+     */
+    std::string_view StringDictionaryView::operator[](uint32_t code) const
+    {
+        if (static_cast<size_t>(code) + 1 >= m_offsets.size())
+        {
+            return {};
+        }
+
+        const uint64_t begin = m_offsets[code];
+        const uint64_t end = m_offsets[code + 1];
+        if (begin > end || end > m_bytes.size())
+        {
+            return {};
+        }
+        return {m_bytes.data() + begin, static_cast<size_t>(end - begin)};
+    }
+
+    /**
+     * @brief Returns the dictionary codes of one row's list
+     *
+     * @param row Row index
+     * @return ArrayView<uint32_t> Codes of the row's entries
+     */
+    ArrayView<uint32_t> StringListColumnView::row(size_t row) const
+    {
+        if (row + 1 >= m_row_offsets.size())
+        {
+            return {};
+        }
+
+        const uint64_t begin = m_row_offsets[row];
+        const uint64_t end = m_row_offsets[row + 1];
+        if (begin > end)
+        {
+            return {};
+        }
+        return m_codes.subview(static_cast<size_t>(begin), static_cast<size_t>(end - begin));
+    }
+
+    uint32_t ColumnarWriter::Dictionary::encode(const std::string& value)
+    {
+        auto [it, inserted] = codes.emplace(value, static_cast<uint32_t>(entries.size()));
+        if (inserted)
+        {
+            entries.push_back(&it->first);
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Appends one record
+     *
+     * @param record Metadata of one sound
+     */
+    void ColumnarWriter::append(const SoundMetadata& record)
+    {
+        m_ids.push_back(record.id);
+        m_durations.push_back(record.duration);
+        m_names.push_back(m_name_dictionary.encode(record.name));
+        m_usernames.push_back(m_username_dictionary.encode(record.username));
+        m_descriptions.push_back(m_description_dictionary.encode(record.description));
+        m_previews.push_back(m_preview_dictionary.encode(record.preview_url));
+
+        for (const auto& tag : record.tags)
+        {
+            m_tags.push_back(m_tag_dictionary.encode(tag));
+        }
+        m_tag_offsets.push_back(m_tags.size());
+    }
+
+    /**
+     * @brief Appends every entry of a search response
+     *
+     * @param json Search response payload
+     * @return std::optional<size_t> Number of records appended, or
+     *         std::nullopt if the payload is not a search response
+     */
+    std::optional<size_t> ColumnarWriter::appendSearchResults(const std::string& json)
+    {
+        nlohmann::json payload = nlohmann::json::parse(json, nullptr, false);
+        if (payload.is_discarded() || !payload.is_object())
+        {
+            return std::nullopt;
+        }
+
+        auto results = payload.find("results");
+        if (results == payload.end() || !results->is_array())
+        {
+            return std::nullopt;
+        }
+
+        size_t appended = 0;
+        for (const auto& sound : *results)
+        {
+            if (!sound.is_object())
+            {
+                continue;
+            }
+
+            SoundMetadata record;
+            if (auto id = sound.find("id"); id != sound.end() && id->is_number_integer())
+            {
+                record.id = id->get<int64_t>();
+            }
+            if (auto duration = sound.find("duration"); duration != sound.end() && duration->is_number())
+            {
+                record.duration = duration->get<double>();
+            }
+            record.name = stringField(sound, "name");
+            record.username = stringField(sound, "username");
+            record.description = stringField(sound, "description");
+
+            record.preview_url = stringField(sound, PREVIEW_COLUMN);
+            if (auto previews = sound.find("previews"); record.preview_url.empty()
+                && previews != sound.end() && previews->is_object())
+            {
+                record.preview_url = stringField(*previews, PREVIEW_COLUMN);
+            }
+
+            if (auto tags = sound.find("tags"); tags != sound.end() && tags->is_array())
+            {
+                for (const auto& tag : *tags)
+                {
+                    if (tag.is_string())
+                    {
+                        record.tags.push_back(tag.get<std::string>());
+                    }
+                }
+            }
+
+            append(record);
+            ++appended;
+        }
+        return appended;
+    }
+
+    /**
+     * @brief Writes all appended records to a file
+     *
+     * @param path Destination filesystem path
+     * @return bool True if the file was written completely
+     */
+    bool ColumnarWriter::write(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+
+        out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        SectionWriter sections(out);
+
+        sections.beginColumn(ID_COLUMN, ColumnType::Int64);
+        sections.addSection(m_ids);
+
+        sections.beginColumn(DURATION_COLUMN, ColumnType::Float64);
+        sections.addSection(m_durations);
+
+        const std::pair<const char*, std::pair<const Dictionary*, const std::vector<uint32_t>*>> strings[] = {
+            {NAME_COLUMN, {&m_name_dictionary, &m_names}},
+            {USERNAME_COLUMN, {&m_username_dictionary, &m_usernames}},
+            {DESCRIPTION_COLUMN, {&m_description_dictionary, &m_descriptions}},
+            {PREVIEW_COLUMN, {&m_preview_dictionary, &m_previews}},
+        };
+        for (const auto& [name, column] : strings)
+        {
+            sections.beginColumn(name, ColumnType::String);
+            sections.addSection(*column.second);
+            sections.addDictionary(column.first->entries);
+        }
+
+        sections.beginColumn(TAGS_COLUMN, ColumnType::StringList);
+        sections.addSection(m_tag_offsets);
+        sections.addSection(m_tags);
+        sections.addDictionary(m_tag_dictionary.entries);
+
+        sections.finish(m_ids.size());
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Maps a columnar export and validates its footer
+     *
+     * Only the footer is parsed. Section bounds, alignment and sizes are
+     * checked against the row count so that column views never reach
+     * outside the mapping.
+     *
+     * @param path Filesystem path of the export
+     * @return bool True if the file is a well-formed export
+     */
+    bool ColumnarReader::open(const std::string& path)
+    {
+        m_columns.clear();
+        m_row_count = 0;
+
+        if (!m_file.open(path) || m_file.size() < sizeof(FILE_MAGIC) + TRAILER_SIZE)
+        {
+            m_file.close();
+            return false;
+        }
+
+        const uint8_t* data = m_file.data();
+        const size_t size = m_file.size();
+        const uint8_t* trailer = data + size - TRAILER_SIZE;
+
+        uint64_t footer_offset = 0;
+        uint64_t footer_size = 0;
+        uint64_t row_count = 0;
+        std::memcpy(&footer_offset, trailer, 8);
+        std::memcpy(&footer_size, trailer + 8, 8);
+        std::memcpy(&row_count, trailer + 16, 8);
+
+        if (std::memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+            || std::memcmp(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0
+            || footer_offset < sizeof(FILE_MAGIC)
+            || footer_offset > size - TRAILER_SIZE
+            || footer_size != size - TRAILER_SIZE - footer_offset
+            // Every row takes at least four bytes of some section, which also
+            // keeps the expected section sizes below from overflowing
+            || row_count > size / 4)
+        {
+            m_file.close();
+            return false;
+        }
+
+        const uint8_t* cursor = data + footer_offset;
+        const uint8_t* footer_end = cursor + footer_size;
+        auto read = [&cursor, footer_end](void* out, size_t bytes)
+        {
+            if (static_cast<size_t>(footer_end - cursor) < bytes)
+            {
+                return false;
+            }
+            std::memcpy(out, cursor, bytes);
+            cursor += bytes;
+            return true;
+        };
+
+        // Expected byte size of each section relative to the row count (0 = free-form)
+        auto expectedSize = [row_count](ColumnType type, size_t index) -> uint64_t
+        {
+            switch (type)
+            {
+                case ColumnType::Int64:
+                case ColumnType::Float64:
+                    return row_count * 8;
+                case ColumnType::String:
+                    return index == 0 ? row_count * 4 : 0;
+                case ColumnType::StringList:
+                    return index == 0 ? (row_count + 1) * 8 : 0;
+            }
+            return 0;
+        };
+
+        uint32_t column_count = 0;
+        if (!read(&column_count, sizeof(column_count)))
+        {
+            m_file.close();
+            return false;
+        }
+
+        for (uint32_t i = 0; i < column_count; ++i)
+        {
+            uint16_t name_length = 0;
+            uint8_t type = 0;
+            uint8_t section_count = 0;
+            Column column;
+
+            if (!read(&name_length, sizeof(name_length)))
+            {
+                m_file.close();
+                return false;
+            }
+            column.name.resize(name_length);
+            if (!read(column.name.data(), name_length)
+                || !read(&type, 1)
+                || !read(&section_count, 1))
+            {
+                m_file.close();
+                return false;
+            }
+
+            column.type = static_cast<ColumnType>(type);
+            if (section_count == 0 || sectionCount(column.type) != section_count)
+            {
+                m_file.close();
+                return false;
+            }
+
+            for (size_t s = 0; s < section_count; ++s)
+            {
+                Section section{};
+                if (!read(&section.offset, 8) || !read(&section.size, 8)
+                    || section.offset % SECTION_ALIGNMENT != 0
+                    || section.offset > footer_offset
+                    || section.size > footer_offset - section.offset)
+                {
+                    m_file.close();
+                    return false;
+                }
+
+                const uint64_t expected = expectedSize(column.type, s);
+                if (expected != 0 && section.size != expected)
+                {
+                    m_file.close();
+                    return false;
+                }
+                column.sections.push_back(section);
+            }
+
+            m_columns.push_back(std::move(column));
+        }
+
+        m_row_count = static_cast<size_t>(row_count);
+        return true;
+    }
+
+    /**
+     * @brief Returns the names of all columns in file order
+     */
+    std::vector<std::string> ColumnarReader::columnNames() const
+    {
+        std::vector<std::string> names;
+        for (const auto& column : m_columns)
+        {
+            names.push_back(column.name);
+        }
+        return names;
+    }
+
+    std::optional<ArrayView<int64_t>> ColumnarReader::int64Column(const std::string& name) const
+    {
+        const Column* column = findColumn(name, ColumnType::Int64);
+        if (!column)
+        {
+            return std::nullopt;
+        }
+        return sectionView<int64_t>(column->sections[0]);
+    }
+
+    std::optional<ArrayView<double>> ColumnarReader::float64Column(const std::string& name) const
+    {
+        const Column* column = findColumn(name, ColumnType::Float64);
+        if (!column)
+        {
+            return std::nullopt;
+        }
+        return sectionView<double>(column->sections[0]);
+    }
+
+    std::optional<StringColumnView> ColumnarReader::stringColumn(const std::string& name) const
+    {
+        const Column* column = findColumn(name, ColumnType::String);
+        if (!column)
+        {
+            return std::nullopt;
+        }
+        return StringColumnView(
+            sectionView<uint32_t>(column->sections[0]),
+            dictionaryView(column->sections[1], column->sections[2]));
+    }
+
+    std::optional<StringListColumnView> ColumnarReader::stringListColumn(const std::string& name) const
+    {
+        const Column* column = findColumn(name, ColumnType::StringList);
+        if (!column)
+        {
+            return std::nullopt;
+        }
+        return StringListColumnView(
+            sectionView<uint64_t>(column->sections[0]),
+            sectionView<uint32_t>(column->sections[1]),
+            dictionaryView(column->sections[2], column->sections[3]));
+    }
+
+    const ColumnarReader::Column* ColumnarReader::findColumn(
+        const std::string& name,
+        ColumnType type
+    ) const
+    {
+        for (const auto& column : m_columns)
+        {
+            if (column.name == name)
+            {
+                return column.type == type ? &column : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    ArrayView<T> ColumnarReader::sectionView(const Section& section) const
+    {
+        return ArrayView<T>(
+            reinterpret_cast<const T*>(m_file.data() + section.offset),
+            static_cast<size_t>(section.size / sizeof(T)));
+    }
+
+    StringDictionaryView ColumnarReader::dictionaryView(
+        const Section& offsets,
+        const Section& bytes
+    ) const
+    {
+        return StringDictionaryView(sectionView<uint64_t>(offsets), sectionView<char>(bytes));
+    }
+}
@@ -0,0 +1,669 @@
+/**
+ * @file src/disk_writer.cpp
+ * @brief pwrite and io_uring implementations of DiskWriter
+ *
+ * The io_uring backend talks to the kernel through the raw system calls,
+ * so no liburing dependency is needed. It is compiled on Linux when the
+ * kernel headers provide <linux/io_uring.h> and FREESOUND_DISABLE_IO_URING
+ * is not defined.
+ *
+ * @see include/disk_writer.h
+ */
+
+#include "disk_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(FREESOUND_DISABLE_IO_URING) && __has_include(<linux/io_uring.h>)
+#define FREESOUND_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Alignment required by O_DIRECT on common filesystems and devices
+        constexpr size_t BLOCK_ALIGNMENT = 4096;
+
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        /**
+         * @brief Writes a whole buffer at an offset, retrying short writes
+         *
+         * @return bool True if every byte was written
+         */
+        bool positionalWrite(int fd, const uint8_t* data, size_t length, uint64_t offset)
+        {
+#ifdef _WIN32
+            static std::mutex seek_mutex;
+            std::lock_guard<std::mutex> lock(seek_mutex);
+            if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+            {
+                return false;
+            }
+            while (length > 0)
+            {
+                const unsigned int request = length > 0x40000000u
+                    ? 0x40000000u : static_cast<unsigned int>(length);
+                const int written = _write(fd, data, request);
+                if (written <= 0)
+                {
+                    return false;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            return true;
+#else
+            while (length > 0)
+            {
+                const ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+                if (written < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (written <= 0)
+                {
+                    return false;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+                offset += static_cast<uint64_t>(written);
+            }
+            return true;
+#endif
+        }
+
+        /**
+         * @brief Fixed set of page-aligned staging buffers with a blocking free list
+         */
+        class StagingBuffers
+        {
+        public:
+            StagingBuffers(unsigned count, size_t size)
+                : m_size(size), m_count(count)
+            {
+                m_memory = static_cast<uint8_t*>(
+                    ::operator new(m_size * m_count, std::align_val_t(BLOCK_ALIGNMENT)));
+                for (unsigned i = 0; i < m_count; ++i)
+                {
+                    m_free.push_back(static_cast<int>(i));
+                }
+            }
+
+            ~StagingBuffers()
+            {
+                ::operator delete(m_memory, std::align_val_t(BLOCK_ALIGNMENT));
+            }
+
+            StagingBuffers(const StagingBuffers&) = delete;
+            StagingBuffers& operator=(const StagingBuffers&) = delete;
+
+            int acquire()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_available.wait(lock, [this]() { return !m_free.empty(); });
+                const int buffer = m_free.back();
+                m_free.pop_back();
+                return buffer;
+            }
+
+            void release(int buffer)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_free.push_back(buffer);
+                }
+                m_available.notify_one();
+            }
+
+            uint8_t* data(int buffer) { return m_memory + static_cast<size_t>(buffer) * m_size; }
+            size_t size() const { return m_size; }
+            unsigned count() const { return m_count; }
+
+        private:
+            uint8_t* m_memory = nullptr;
+            size_t m_size;
+            unsigned m_count;
+            std::vector<int> m_free;
+            std::mutex m_mutex;
+            std::condition_variable m_available;
+        };
+
+        /**
+         * @brief Backend that writes each buffer synchronously with pwrite
+         */
+        class PwriteDiskWriter final : public DiskWriter
+        {
+        public:
+            PwriteDiskWriter(const DiskWriterOptions& options, size_t buffer_size)
+                : DiskWriter(buffer_size, options.direct_io),
+                  m_buffers(std::max(options.buffer_count, 1u), buffer_size)
+            {
+            }
+
+            const char* name() const override { return "pwrite"; }
+
+        protected:
+            int acquireBuffer() override { return m_buffers.acquire(); }
+            uint8_t* bufferData(int buffer) override { return m_buffers.data(buffer); }
+
+            void submit(File& file, int buffer, uint64_t offset, size_t length) override
+            {
+                const bool ok = positionalWrite(fileDescriptor(file), m_buffers.data(buffer), length, offset);
+                m_buffers.release(buffer);
+                complete(file, ok);
+            }
+
+            void waitIdle(File&) override
+            {
+            }
+
+        private:
+            StagingBuffers m_buffers;
+        };
+
+#ifdef FREESOUND_HAVE_IO_URING
+        int ioUringSetup(unsigned entries, io_uring_params* params)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        int ioUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return static_cast<int>(syscall(
+                __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        int ioUringRegister(int ring_fd, unsigned opcode, const void* arg, unsigned count)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, count));
+        }
+
+        /**
+         * @brief Backend that submits buffers through io_uring and reaps completions on a thread
+         *
+         * Every staging buffer doubles as the submission slot: the buffer
+         * index is the request's user_data (offset by one, so that zero can
+         * mark the wake-up request used at shutdown). Buffers are registered
+         * with the kernel when allowed, so WRITE_FIXED avoids per-request page
+         * pinning; otherwise plain WRITE requests are used.
+         */
+        class IoUringDiskWriter final : public DiskWriter
+        {
+        public:
+            static std::shared_ptr<DiskWriter> create(const DiskWriterOptions& options, size_t buffer_size)
+            {
+                std::shared_ptr<IoUringDiskWriter> writer(new IoUringDiskWriter(options, buffer_size));
+                if (!writer->start())
+                {
+                    return nullptr;
+                }
+                return writer;
+            }
+
+            ~IoUringDiskWriter() override
+            {
+                if (m_reaper.joinable())
+                {
+                    m_stopping = true;
+                    submitRequest(IORING_OP_NOP, -1, nullptr, 0, 0, 0);
+                    m_reaper.join();
+                }
+                if (m_sqes)
+                {
+                    munmap(m_sqes, m_sqes_size);
+                }
+                if (m_cq_ring && m_cq_ring != m_sq_ring)
+                {
+                    munmap(m_cq_ring, m_cq_ring_size);
+                }
+                if (m_sq_ring)
+                {
+                    munmap(m_sq_ring, m_sq_ring_size);
+                }
+                if (m_ring_fd >= 0)
+                {
+                    close(m_ring_fd);
+                }
+            }
+
+            const char* name() const override { return "io_uring"; }
+
+        protected:
+            int acquireBuffer() override { return m_buffers.acquire(); }
+            uint8_t* bufferData(int buffer) override { return m_buffers.data(buffer); }
+
+            void submit(File& file, int buffer, uint64_t offset, size_t length) override
+            {
+                m_slots[buffer] = {&file, offset, length, 0};
+                submitSlot(buffer);
+            }
+
+            void waitIdle(File& file) override
+            {
+                std::unique_lock<std::mutex> lock(m_idle_mutex);
+                m_idle.wait(lock, [&file]() { return outstanding(file) == 0; });
+            }
+
+        private:
+            /// In-flight write occupying one staging buffer
+            struct Slot
+            {
+                File* file;
+                uint64_t offset;
+                size_t length;
+                size_t done;
+            };
+
+            IoUringDiskWriter(const DiskWriterOptions& options, size_t buffer_size)
+                : DiskWriter(buffer_size, options.direct_io),
+                  m_buffers(std::max(options.buffer_count, 1u), buffer_size),
+                  m_slots(m_buffers.count())
+            {
+            }
+
+            bool start()
+            {
+                // One entry per buffer plus the shutdown wake-up never overflows the rings
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                m_ring_fd = ioUringSetup(m_buffers.count() + 1, &params);
+                if (m_ring_fd < 0)
+                {
+                    return false;
+                }
+
+                m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single_mmap)
+                {
+                    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+                }
+
+                m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+                if (m_sq_ring == MAP_FAILED)
+                {
+                    m_sq_ring = nullptr;
+                    return false;
+                }
+
+                m_cq_ring = single_mmap ? m_sq_ring : mmap(nullptr, m_cq_ring_size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+                if (m_cq_ring == MAP_FAILED)
+                {
+                    m_cq_ring = nullptr;
+                    return false;
+                }
+
+                m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+                void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+                if (sqes == MAP_FAILED)
+                {
+                    return false;
+                }
+                m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+                auto* sq = static_cast<uint8_t*>(m_sq_ring);
+                m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+                m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                m_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+                auto* cq = static_cast<uint8_t*>(m_cq_ring);
+                m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                m_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+                std::vector<iovec> vectors(m_buffers.count());
+                for (unsigned i = 0; i < m_buffers.count(); ++i)
+                {
+                    vectors[i].iov_base = m_buffers.data(static_cast<int>(i));
+                    vectors[i].iov_len = m_buffers.size();
+                }
+                m_fixed_buffers = ioUringRegister(m_ring_fd, IORING_REGISTER_BUFFERS,
+                    vectors.data(), static_cast<unsigned>(vectors.size())) == 0;
+
+                m_reaper = std::thread([this]() { reap(); });
+                return true;
+            }
+
+            /// Queues the remaining part of a slot's write
+            void submitSlot(int buffer)
+            {
+                Slot& slot = m_slots[buffer];
+                const int fd = fileDescriptor(*slot.file);
+                const uint64_t address = reinterpret_cast<uint64_t>(m_buffers.data(buffer) + slot.done);
+                const unsigned length = static_cast<unsigned>(slot.length - slot.done);
+                const uint64_t offset = slot.offset + slot.done;
+
+                if (!submitRequest(m_fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE,
+                        fd, reinterpret_cast<void*>(address), length, offset,
+                        static_cast<uint64_t>(buffer) + 1, buffer))
+                {
+                    finishSlot(buffer, positionalWrite(fd, m_buffers.data(buffer) + slot.done,
+                        length, offset));
+                }
+            }
+
+            bool submitRequest(uint8_t opcode, int fd, void* address, unsigned length,
+                uint64_t offset, uint64_t user_data, int buffer = -1)
+            {
+                std::lock_guard<std::mutex> lock(m_submit_mutex);
+
+                const unsigned tail = *m_sq_tail;
+                const unsigned index = tail & m_sq_mask;
+                io_uring_sqe* sqe = &m_sqes[index];
+                std::memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = opcode;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(address);
+                sqe->len = length;
+                sqe->off = offset;
+                sqe->user_data = user_data;
+                if (opcode == IORING_OP_WRITE_FIXED)
+                {
+                    sqe->buf_index = static_cast<uint16_t>(buffer);
+                }
+                m_sq_array[index] = index;
+                __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+                while (true)
+                {
+                    const int submitted = ioUringEnter(m_ring_fd, 1, 0, 0);
+                    // Earlier entries were all consumed or withdrawn, so the head
+                    // moves past tail only once the kernel has taken this one
+                    if (submitted == 1 || __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) != tail)
+                    {
+                        return true;
+                    }
+                    if (submitted == 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY))
+                    {
+                        // Withdraw the entry so that the kernel never sees it; the caller
+                        // falls back to a synchronous write and reuses the buffer
+                        __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+                        return false;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+
+            /// Completion loop run on m_reaper
+            void reap()
+            {
+                while (true)
+                {
+                    unsigned head = *m_cq_head;
+                    const unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+                    if (head == tail)
+                    {
+                        if (m_stopping)
+                        {
+                            return;
+                        }
+                        ioUringEnter(m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+                        continue;
+                    }
+
+                    // Slots are filled before their request is queued under
+                    // m_submit_mutex; taking it here orders those writes before
+                    // the reads below without relying on the ring's barriers
+                    {
+                        std::lock_guard<std::mutex> lock(m_submit_mutex);
+                    }
+
+                    for (; head != tail; ++head)
+                    {
+                        const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+                        if (cqe.user_data != 0)
+                        {
+                            handleCompletion(static_cast<int>(cqe.user_data - 1), cqe.res);
+                        }
+                    }
+                    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+                }
+            }
+
+            void handleCompletion(int buffer, int result)
+            {
+                Slot& slot = m_slots[buffer];
+                if (result == -EINTR || result == -EAGAIN)
+                {
+                    submitSlot(buffer);
+                    return;
+                }
+                if (result == -EINVAL || result == -EOPNOTSUPP)
+                {
+                    // Opcode or flags unsupported by this kernel/filesystem: write it ourselves
+                    finishSlot(buffer, positionalWrite(fileDescriptor(*slot.file),
+                        m_buffers.data(buffer) + slot.done, slot.length - slot.done,
+                        slot.offset + slot.done));
+                    return;
+                }
+                if (result <= 0)
+                {
+                    finishSlot(buffer, false);
+                    return;
+                }
+
+                slot.done += static_cast<size_t>(result);
+                if (slot.done < slot.length)
+                {
+                    submitSlot(buffer);
+                    return;
+                }
+                finishSlot(buffer, true);
+            }
+
+            void finishSlot(int buffer, bool ok)
+            {
+                File& file = *m_slots[buffer].file;
+                m_buffers.release(buffer);
+                complete(file, ok);
+                {
+                    std::lock_guard<std::mutex> lock(m_idle_mutex);
+                }
+                m_idle.notify_all();
+            }
+
+            StagingBuffers m_buffers;
+            std::vector<Slot> m_slots;
+
+            int m_ring_fd = -1;
+            void* m_sq_ring = nullptr;
+            void* m_cq_ring = nullptr;
+            size_t m_sq_ring_size = 0;
+            size_t m_cq_ring_size = 0;
+            size_t m_sqes_size = 0;
+            io_uring_sqe* m_sqes = nullptr;
+            unsigned* m_sq_head = nullptr;
+            unsigned* m_sq_tail = nullptr;
+            unsigned* m_sq_array = nullptr;
+            unsigned m_sq_mask = 0;
+            unsigned* m_cq_head = nullptr;
+            unsigned* m_cq_tail = nullptr;
+            unsigned m_cq_mask = 0;
+            io_uring_cqe* m_cqes = nullptr;
+            bool m_fixed_buffers = false;
+
+            std::mutex m_submit_mutex;
+            std::mutex m_idle_mutex;
+            std::condition_variable m_idle;
+            std::atomic<bool> m_stopping{false};
+            std::thread m_reaper;
+        };
+#endif
+    }
+
+    /**
+     * @brief Starts writing at offset 0 of an open descriptor
+     *
+     * When the writer uses direct I/O, O_DIRECT is switched on for the
+     * descriptor; filesystems that reject it (tmpfs, some network mounts)
+     * keep using buffered writes.
+     *
+     * @param writer DiskWriter performing the writes
+     * @param fd Descriptor opened for writing
+     */
+    DiskWriter::File::File(DiskWriter& writer, int fd)
+        : m_writer(writer), m_fd(fd)
+    {
+#if defined(O_DIRECT) && !defined(_WIN32)
+        if (writer.directIo())
+        {
+            const int flags = fcntl(fd, F_GETFL);
+            m_direct = flags >= 0 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0;
+        }
+#endif
+    }
+
+    /**
+     * @brief Finishes the file if finish() was not called
+     */
+    DiskWriter::File::~File()
+    {
+        finish();
+    }
+
+    /**
+     * @brief Appends bytes to the file
+     *
+     * @param data Bytes to append
+     * @param size Number of bytes at data
+     * @return bool False once any write of this file has failed
+     */
+    bool DiskWriter::File::append(const void* data, size_t size)
+    {
+        if (m_finished)
+        {
+            return false;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        const size_t capacity = m_writer.bufferSize();
+        while (size > 0)
+        {
+            if (m_buffer < 0)
+            {
+                m_buffer = m_writer.acquireBuffer();
+                m_fill = 0;
+            }
+
+            const size_t chunk = std::min(size, capacity - m_fill);
+            std::memcpy(m_writer.bufferData(m_buffer) + m_fill, bytes, chunk);
+            m_fill += chunk;
+            m_size += chunk;
+            bytes += chunk;
+            size -= chunk;
+
+            if (m_fill == capacity && !submitCurrent(capacity))
+            {
+                return false;
+            }
+        }
+        return !m_failed;
+    }
+
+    /**
+     * @brief Submits buffered data and waits until every write has completed
+     *
+     * @return bool True if all data reached the file
+     */
+    bool DiskWriter::File::finish()
+    {
+        if (m_finished)
+        {
+            return !m_failed;
+        }
+        m_finished = true;
+
+        bool padded = false;
+        if (m_buffer >= 0 && m_fill > 0)
+        {
+            size_t length = m_fill;
+            if (m_direct)
+            {
+                length = alignUp(m_fill, BLOCK_ALIGNMENT);
+                std::memset(m_writer.bufferData(m_buffer) + m_fill, 0, length - m_fill);
+                padded = length != m_fill;
+            }
+            submitCurrent(length);
+        }
+
+        m_writer.waitIdle(*this);
+
+#ifndef _WIN32
+        if (padded && ftruncate(m_fd, static_cast<off_t>(m_size)) != 0)
+        {
+            m_failed = true;
+        }
+#endif
+        return !m_failed;
+    }
+
+    /**
+     * @brief Hands the current staging buffer to the backend
+     *
+     * @param length Bytes to write, including any O_DIRECT padding
+     * @return bool False once any write of this file has failed
+     */
+    bool DiskWriter::File::submitCurrent(size_t length)
+    {
+        const uint64_t offset = m_submitted;
+        const int buffer = m_buffer;
+        m_submitted += m_fill;
+        m_buffer = -1;
+        m_fill = 0;
+
+        m_outstanding.fetch_add(1, std::memory_order_acq_rel);
+        m_writer.submit(*this, buffer, offset, length);
+        return !m_failed;
+    }
+
+    /**
+     * @brief Creates a DiskWriter for the requested backend
+     *
+     * @param options Writer configuration
+     * @return std::shared_ptr<DiskWriter> Ready-to-use writer
+     */
+    std::shared_ptr<DiskWriter> makeDiskWriter(const DiskWriterOptions& options)
+    {
+        const size_t buffer_size = alignUp(std::max<size_t>(options.buffer_size, 1), BLOCK_ALIGNMENT);
+
+#ifdef FREESOUND_HAVE_IO_URING
+        if (options.backend != DiskWriterBackend::Pwrite)
+        {
+            if (auto writer = IoUringDiskWriter::create(options, buffer_size))
+            {
+                return writer;
+            }
+        }
+#endif
+
+        return std::make_shared<PwriteDiskWriter>(options, buffer_size);
+    }
+}
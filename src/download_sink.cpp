@@ -0,0 +1,118 @@
+/**
+ * @file src/download_sink.cpp
+ * @brief Implementation of the built-in download sinks
+ *
+ * @see include/download_sink.h
+ */
+
+#include "download_sink.h"
+#include <filesystem>
+#include <utility>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Prepares a sink for a destination path
+     *
+     * @param path Destination file path
+     * @param policy Durability applied when the file is committed
+     */
+    FileSink::FileSink(std::string path, SyncPolicy policy)
+        : m_path(std::move(path)), m_policy(policy)
+    {
+    }
+
+    /**
+     * @brief Opens the temporary file and reserves space for the body
+     */
+    bool FileSink::begin(std::optional<uint64_t> content_length)
+    {
+        m_content_length = content_length;
+        return m_file.open(m_path) && (!content_length || m_file.preallocate(*content_length));
+    }
+
+    bool FileSink::write(const char* data, size_t size)
+    {
+        return m_file.write(data, size);
+    }
+
+    /**
+     * @brief Releases unused preallocated space and renames the file into place
+     */
+    bool FileSink::end()
+    {
+        if (m_content_length && m_file.bytesWritten() != *m_content_length
+            && !m_file.truncate(m_file.bytesWritten()))
+        {
+            m_file.abort();
+            return false;
+        }
+
+        const bool durable = m_policy != SyncPolicy::None;
+        if (!m_file.commit(durable))
+        {
+            return false;
+        }
+        if (durable)
+        {
+            AtomicFile::syncDirectory(std::filesystem::path(m_path).parent_path().string());
+        }
+        return true;
+    }
+
+    /**
+     * @brief Removes the temporary file
+     */
+    void FileSink::abort()
+    {
+        m_file.abort();
+    }
+
+    /**
+     * @brief Prepares a sink drawing its buffer from a pool
+     *
+     * @param pool Pool providing the buffer; must outlive begin()
+     */
+    MemorySink::MemorySink(BufferPool& pool)
+        : m_pool(pool)
+    {
+    }
+
+    /**
+     * @brief Takes a buffer large enough for the announced body
+     */
+    bool MemorySink::begin(std::optional<uint64_t> content_length)
+    {
+        m_buffer = m_pool.acquire(content_length ? static_cast<size_t>(*content_length) : 0);
+        return m_buffer.capacity() > 0;
+    }
+
+    bool MemorySink::write(const char* data, size_t size)
+    {
+        return m_buffer.append(data, size);
+    }
+
+    /**
+     * @brief Returns the partial body's memory to the pool
+     */
+    void MemorySink::abort()
+    {
+        m_buffer = PooledBuffer();
+    }
+
+    bool StreamSink::write(const char* data, size_t size)
+    {
+        m_stream.write(data, static_cast<std::streamsize>(size));
+        return m_stream.good();
+    }
+
+    bool StreamSink::end()
+    {
+        return m_stream.flush().good();
+    }
+
+    bool CallbackSink::write(const char* data, size_t size)
+    {
+        return m_callback(data, size);
+    }
+}
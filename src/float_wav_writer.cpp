@@ -0,0 +1,143 @@
+/**
+ * @file src/float_wav_writer.cpp
+ * @brief Implementation of the float WAV writer
+ *
+ * @see include/float_wav_writer.h
+ */
+
+#include "float_wav_writer.h"
+#include <cstring>
+#include <limits>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        void putLe16(uint8_t*& p, uint16_t value)
+        {
+            *p++ = static_cast<uint8_t>(value);
+            *p++ = static_cast<uint8_t>(value >> 8);
+        }
+
+        void putLe32(uint8_t*& p, uint32_t value)
+        {
+            putLe16(p, static_cast<uint16_t>(value));
+            putLe16(p, static_cast<uint16_t>(value >> 16));
+        }
+
+        void putTag(uint8_t*& p, const char* tag)
+        {
+            std::memcpy(p, tag, 4);
+            p += 4;
+        }
+
+        /// Largest data chunk whose RIFF size still fits in 32 bits
+        constexpr uint64_t MAX_DATA_BYTES = std::numeric_limits<uint32_t>::max() - FloatWavWriter::HEADER_SIZE;
+    }
+
+    /**
+     * @brief Creates the temporary file and writes a provisional header
+     *
+     * @param path Final path of the file
+     * @param sample_rate Frames per second
+     * @param channels Interleaved channels per frame
+     * @return bool True if the file was created
+     */
+    bool FloatWavWriter::open(const std::string& path, uint32_t sample_rate, uint16_t channels)
+    {
+        if (sample_rate == 0 || channels == 0 || !m_file.open(path))
+        {
+            return false;
+        }
+        m_sample_rate = sample_rate;
+        m_channels = channels;
+        m_data_bytes = 0;
+        m_failed = !writeHeader(false);
+        return !m_failed;
+    }
+
+    /**
+     * @brief Appends interleaved samples
+     *
+     * @param samples Samples to append; a multiple of the channel count
+     * @param count Number of samples (not frames) at samples
+     * @return bool False if the write failed or the file would exceed 4 GiB
+     */
+    bool FloatWavWriter::write(const float* samples, size_t count)
+    {
+        const uint64_t bytes = static_cast<uint64_t>(count) * sizeof(float);
+        if (m_failed || m_data_bytes + bytes > MAX_DATA_BYTES)
+        {
+            m_failed = true;
+            return false;
+        }
+
+        // WAV is little-endian, like every platform the library targets
+        static_assert(sizeof(float) == 4, "IEEE 754 single precision expected");
+        m_failed = !m_file.write(samples, static_cast<size_t>(bytes));
+        m_data_bytes += bytes;
+        return !m_failed;
+    }
+
+    /**
+     * @brief Completes the header and renames the file into place
+     *
+     * @param sync_first Flush the contents before renaming
+     * @return bool True if the file is now visible under its final path
+     */
+    bool FloatWavWriter::commit(bool sync_first)
+    {
+        if (m_failed || !writeHeader(true))
+        {
+            abort();
+            return false;
+        }
+        return m_file.commit(sync_first);
+    }
+
+    /**
+     * @brief Discards the file
+     */
+    void FloatWavWriter::abort()
+    {
+        m_file.abort();
+        m_failed = true;
+    }
+
+    /**
+     * @brief Writes the header for the current length
+     *
+     * @param at_start Overwrite the header at offset 0 instead of appending it
+     * @return bool True if the header was written
+     */
+    bool FloatWavWriter::writeHeader(bool at_start)
+    {
+        uint8_t header[HEADER_SIZE];
+        uint8_t* p = header;
+        const uint32_t frame_bytes = 4u * m_channels;
+
+        putTag(p, "RIFF");
+        putLe32(p, static_cast<uint32_t>(HEADER_SIZE - 8 + m_data_bytes));
+        putTag(p, "WAVE");
+
+        // 18-byte format chunk with an empty extension, as required for non-PCM data
+        putTag(p, "fmt ");
+        putLe32(p, 18);
+        putLe16(p, 3);
+        putLe16(p, m_channels);
+        putLe32(p, m_sample_rate);
+        putLe32(p, m_sample_rate * frame_bytes);
+        putLe16(p, static_cast<uint16_t>(frame_bytes));
+        putLe16(p, 32);
+        putLe16(p, 0);
+
+        putTag(p, "fact");
+        putLe32(p, 4);
+        putLe32(p, static_cast<uint32_t>(m_data_bytes / frame_bytes));
+
+        putTag(p, "data");
+        putLe32(p, static_cast<uint32_t>(m_data_bytes));
+
+        return at_start ? m_file.writeAt(header, sizeof(header), 0) : m_file.write(header, sizeof(header));
+    }
+}
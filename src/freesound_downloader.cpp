@@ -11,17 +11,105 @@
  */
 
 #include "freesound_downloader.h"
+#include "sound_store.h"
+#include "sample_archive.h"
+#include "audio_format.h"
+#include "disk_writer.h"
+#include "download_sink.h"
+#include "write_behind.h"
+#include "md5.h"
+#include "preview_prefetcher.h"
+#include "progressive_stream.h"
+#include "zip_stream.h"
 #include <nlohmann/json.hpp>
 #include <cpr/cpr.h>
+#include <atomic>
+#include <filesystem>
+#include <functional>
 #include <fstream>
 #include <stdexcept>
+#include <unordered_map>
+#include <cctype>
 #include <cstdlib>
+#include <string_view>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace FreesoundDownloader 
 {
     const std::string Downloader::BASE_URL = "https://freesound.org/apiv2/";
 
+    namespace 
+    {
+        bool startsWithIgnoreCase(std::string_view text, std::string_view prefix)
+        {
+            if (text.size() < prefix.size()) 
+            {
+                return false;
+            }
+            for (size_t i = 0; i < prefix.size(); ++i) 
+            {
+                if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) 
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Preview URL of one search result, or nullptr if it has none
+        const nlohmann::json* previewUrl(const nlohmann::json& result)
+        {
+            if (!result.is_object()) 
+            {
+                return nullptr;
+            }
+
+            auto url = result.find("preview-hq-mp3");
+            if (url == result.end()) 
+            {
+                auto previews = result.find("previews");
+                if (previews == result.end() || !previews->is_object()) 
+                {
+                    return nullptr;
+                }
+                url = previews->find("preview-hq-mp3");
+                if (url == previews->end()) 
+                {
+                    return nullptr;
+                }
+            }
+            return url->is_string() && !url->get_ref<const std::string&>().empty() ? &*url : nullptr;
+        }
+
+        /// Preview URLs of the first max_results results of a search response that have one
+        std::vector<std::string> previewUrls(const std::string& results_json, size_t max_results)
+        {
+            std::vector<std::string> urls;
+            try 
+            {
+                const auto parsed = nlohmann::json::parse(results_json);
+                for (const auto& result : parsed.at("results")) 
+                {
+                    if (urls.size() >= max_results) 
+                    {
+                        break;
+                    }
+                    if (const auto* url = previewUrl(result)) 
+                    {
+                        urls.push_back(url->get<std::string>());
+                    }
+                }
+            }
+            catch (const nlohmann::json::exception&) 
+            {
+                // Malformed results simply prefetch nothing
+            }
+            return urls;
+        }
+    }
+
     /**
      * @brief Constructs a Downloader instance with API authentication
      * 
@@ -33,7 +121,7 @@ namespace FreesoundDownloader
      * @throws std::invalid_argument If no valid API key is found
      */
     Downloader::Downloader(const std::string& api_key)
-        : m_api_key(api_key)
+        : m_api_key(api_key), m_base_url(BASE_URL), m_buffer_pool(std::make_shared<BufferPool>())
     {
         if (m_api_key.empty()) 
         {
@@ -57,7 +145,11 @@ namespace FreesoundDownloader
      * @brief Downloads a sound file by its unique identifier
      * 
      * Retrieves and saves a sound sample from Freesound using 
-     * its specific sound ID.
+     * its specific sound ID. The file is written under a temporary 
+     * name and renamed to output_path only once it is complete.
+     * The body is streamed to disk, and the file is preallocated 
+     * from Content-Length so it is laid out contiguously and a full 
+     * disk is reported before the transfer starts.
      * 
      * @param sound_id Unique identifier of the sound to download
      * @param output_path Filesystem path where the sound will be saved
@@ -68,28 +160,766 @@ namespace FreesoundDownloader
         const std::string& output_path
     )
     {
-        std::string download_url = BASE_URL + "sounds/" 
-            + std::to_string(sound_id) + "/download/";
-        
+        std::optional<std::string> expected_md5;
+        if (m_verify_integrity && !(expected_md5 = fetchExpectedMd5(sound_id))) 
+        {
+            return false;
+        }
+
+        AtomicFile out_file;
+        if (!out_file.open(output_path) || !streamSound(sound_id, out_file, expected_md5)) 
+        {
+            return false;
+        }
+
+        const bool durable = m_sync_policy != SyncPolicy::None;
+        if (!out_file.commit(durable)) 
+        {
+            return false;
+        }
+
+        if (durable) 
+        {
+            AtomicFile::syncDirectory(
+                std::filesystem::path(output_path).parent_path().string()
+            );
+        }
+        return true;
+    }
+
+    /**
+     * @brief Downloads a sound file into a managed SoundStore
+     * 
+     * The body is streamed into the store as it arrives.
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param store Open SoundStore receiving the file
+     * @return bool Indicates successful download operation
+     */
+    bool Downloader::downloadSound(
+        int sound_id, 
+        SoundStore& store
+    )
+    {
+        SoundStore::Writer writer(store, sound_id);
+        const bool ok = receiveVerifiedSound(
+            sound_id,
+            [](std::optional<uint64_t>) { return true; },
+            [&](const char* data, size_t size) 
+            {
+                return writer.append(reinterpret_cast<const uint8_t*>(data), size);
+            }
+        );
+        return ok && writer.commit();
+    }
+
+    /**
+     * @brief Downloads a sound file and appends it to a packed sample archive
+     * 
+     * The body is streamed into the archive as it arrives; the archive 
+     * stays locked from the first body byte until the entry is complete.
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param archive Open SampleArchiveWriter receiving the file
+     * @return bool Indicates successful download operation
+     */
+    bool Downloader::downloadSound(
+        int sound_id, 
+        SampleArchiveWriter& archive
+    )
+    {
+        // Lock the archive only once the body is about to arrive
+        std::optional<SampleArchiveWriter::EntryWriter> entry;
+        const bool ok = receiveVerifiedSound(
+            sound_id,
+            [&](std::optional<uint64_t>) 
+            {
+                entry.emplace(archive, sound_id);
+                return true;
+            },
+            [&](const char* data, size_t size) 
+            {
+                return entry->append(reinterpret_cast<const uint8_t*>(data), size);
+            }
+        );
+        return ok && entry && entry->commit();
+    }
+
+    /**
+     * @brief Downloads a sound file into a caller-supplied sink
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param sink Destination of the body
+     * @return bool Indicates successful download operation
+     */
+    bool Downloader::downloadSound(
+        int sound_id, 
+        DownloadSink& sink
+    )
+    {
+        std::optional<std::string> expected_md5;
+        if (m_verify_integrity && !(expected_md5 = fetchExpectedMd5(sound_id))) 
+        {
+            return false;
+        }
+
+        bool begun = false;
+        Md5 md5;
+        const bool ok = receiveSound(
+            sound_id,
+            [&](std::optional<uint64_t> length) 
+            {
+                begun = true;
+                return sink.begin(length);
+            },
+            [&](const char* data, size_t size) 
+            {
+                if (expected_md5) 
+                {
+                    md5.update(data, size);
+                }
+                return sink.write(data, size);
+            }
+        );
+
+        if (!ok || (expected_md5 && Md5::toHex(md5.finish()) != *expected_md5)) 
+        {
+            if (begun) 
+            {
+                sink.abort();
+            }
+            return false;
+        }
+        return sink.end();
+    }
+
+    /**
+     * @brief Downloads a sound file straight into memory
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @return std::optional<PooledBuffer> File contents, or std::nullopt on failure
+     */
+    std::optional<PooledBuffer> Downloader::downloadToMemory(int sound_id)
+    {
+        MemorySink sink(*m_buffer_pool);
+        if (!downloadSound(sound_id, sink)) 
+        {
+            return std::nullopt;
+        }
+        return sink.take();
+    }
+
+    /**
+     * @brief Starts streaming a sound's preview for immediate playback
+     * 
+     * @param sound_id Unique identifier of the sound
+     * @param options Ring buffer and transfer settings
+     * @return std::unique_ptr<ProgressiveStream> Running stream, or nullptr if 
+     *         the preview URL could not be looked up
+     */
+    std::unique_ptr<ProgressiveStream> Downloader::streamPreview(
+        int sound_id, 
+        const ProgressiveStreamOptions& options
+    )
+    {
+        const auto foreground = foregroundScope();
+        auto response = cpr::Get(
+            cpr::Url{m_base_url + "sounds/" + std::to_string(sound_id) + "/"},
+            cpr::Parameters{{"token", m_api_key}, {"fields", "previews"}}
+        );
+
+        if (response.status_code != 200) 
+        {
+            return nullptr;
+        }
+
+        try 
+        {
+            const auto metadata = nlohmann::json::parse(response.text);
+            return streamPreview(
+                metadata.at("previews").at("preview-hq-mp3").get<std::string>(), 
+                options
+            );
+        }
+        catch (const nlohmann::json::exception&) 
+        {
+            return nullptr;
+        }
+    }
+
+    /**
+     * @brief Starts streaming a preview whose URL is already known
+     * 
+     * @param preview_url Address of the preview
+     * @param options Ring buffer and transfer settings
+     * @return std::unique_ptr<ProgressiveStream> Running stream
+     */
+    std::unique_ptr<ProgressiveStream> Downloader::streamPreview(
+        const std::string& preview_url, 
+        const ProgressiveStreamOptions& options
+    )
+    {
+        if (!m_prefetcher) 
+        {
+            return std::make_unique<ProgressiveStream>(preview_url, options);
+        }
+
+        // The stream's transfer is foreground traffic for as long as it runs
+        ProgressiveStreamOptions resumed = options;
+        if (!resumed.prefix) 
+        {
+            resumed.prefix = m_prefetcher->cache().get(preview_url);
+        }
+        resumed.transfer_guard = m_prefetcher->foreground();
+        return std::make_unique<ProgressiveStream>(preview_url, resumed);
+    }
+
+    /**
+     * @brief Downloads several sounds into a packed sample archive
+     * 
+     * @param sound_ids Identifiers of the sounds to download
+     * @param archive Open SampleArchiveWriter receiving the files
+     * @return std::vector<int> Identifiers that could not be downloaded
+     */
+    std::vector<int> Downloader::downloadSounds(
+        const std::vector<int>& sound_ids, 
+        SampleArchiveWriter& archive
+    )
+    {
+        std::vector<int> failed;
+        for (int sound_id : sound_ids) 
+        {
+            if (archive.contains(sound_id)) 
+            {
+                continue;
+            }
+
+            if (!downloadSound(sound_id, archive)) 
+            {
+                failed.push_back(sound_id);
+            }
+        }
+        return failed;
+    }
+
+    /**
+     * @brief Downloads several sounds into a directory
+     * 
+     * @param sound_ids Identifiers of the sounds to download
+     * @param output_dir Directory receiving the files (created if missing)
+     * @param options Concurrency and durability settings for the batch
+     * @return std::vector<int> Identifiers that could not be downloaded
+     */
+    std::vector<int> Downloader::downloadSounds(
+        const std::vector<int>& sound_ids, 
+        const std::string& output_dir,
+        const BatchOptions& options
+    )
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(output_dir, ec);
+        if (ec) 
+        {
+            return sound_ids;
+        }
+
+        WriteBehindWriter writer(options.write_behind);
+        GroupCommitter committer(options.group_size);
+        std::mutex commit_mutex;
+        std::unordered_map<std::string, size_t> pending_indices;
+        std::vector<char> succeeded(sound_ids.size(), 0);
+        std::atomic<size_t> next_index{0};
+
+        auto worker = [&]() 
+        {
+            for (size_t index = next_index++; index < sound_ids.size(); index = next_index++) 
+            {
+                std::optional<std::string> expected_md5;
+                if (options.verify_integrity 
+                    && !(expected_md5 = fetchExpectedMd5(sound_ids[index]))) 
+                {
+                    continue;
+                }
+
+                AtomicFile file;
+                if (!streamSound(sound_ids[index], output_dir, writer, file, expected_md5)) 
+                {
+                    continue;
+                }
+
+                switch (options.sync_policy) 
+                {
+                    case SyncPolicy::None:
+                    case SyncPolicy::PerFile:
+                        if (file.commit(options.sync_policy == SyncPolicy::PerFile)) 
+                        {
+                            succeeded[index] = 1;
+                        }
+                        break;
+
+                    case SyncPolicy::GroupCommit:
+                    {
+                        std::lock_guard<std::mutex> lock(commit_mutex);
+                        pending_indices[file.finalPath()] = index;
+                        succeeded[index] = 1;
+                        committer.add(std::move(file));
+                        break;
+                    }
+                }
+            }
+        };
+
+        const size_t worker_count = std::min(
+            std::max<size_t>(options.network_workers, 1), 
+            std::max<size_t>(sound_ids.size(), 1)
+        );
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < worker_count; ++i) 
+        {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : workers) 
+        {
+            thread.join();
+        }
+
+        committer.flush();
+        for (const auto& path : committer.failures()) 
+        {
+            succeeded[pending_indices[path]] = 0;
+        }
+        if (options.sync_policy == SyncPolicy::PerFile) 
+        {
+            AtomicFile::syncDirectory(output_dir);
+        }
+
+        std::vector<int> failed;
+        for (size_t i = 0; i < sound_ids.size(); ++i) 
+        {
+            if (!succeeded[i]) 
+            {
+                failed.push_back(sound_ids[i]);
+            }
+        }
+        return failed;
+    }
+
+    /**
+     * @brief Downloads a pack and unpacks it while it arrives
+     * 
+     * @param pack_id Unique identifier of the pack to download
+     * @param output_dir Directory receiving the members (created if missing)
+     * @param options Threads, memory bound and durability of the extraction
+     * @return std::optional<std::vector<ZipMember>> Extracted files, or std::nullopt if 
+     *         the transfer failed or the archive is damaged or unsupported
+     */
+    std::optional<std::vector<ZipMember>> Downloader::downloadPack(
+        int pack_id, 
+        const std::string& output_dir,
+        const UnzipOptions& options
+    )
+    {
+        ZipStreamExtractor extractor(output_dir, options);
+        const bool received = receive(
+            m_base_url + "packs/" + std::to_string(pack_id) + "/download/",
+            [](std::optional<uint64_t>) { return true; },
+            [&](const char* data, size_t size) { return extractor.push(data, size); }
+        );
+
+        // Wait for the members in flight even if the transfer broke off
+        const bool extracted = extractor.finish();
+        if (!received || !extracted) 
+        {
+            return std::nullopt;
+        }
+        return extractor.members();
+    }
+
+    /**
+     * @brief Points the downloader at a different API root
+     * 
+     * @param base_url API root ending in a slash
+     */
+    void Downloader::setBaseUrl(const std::string& base_url)
+    {
+        m_base_url = base_url;
+    }
+
+    /**
+     * @brief Sets the durability applied by downloadSound to a path
+     * 
+     * @param policy Durability policy
+     */
+    void Downloader::setSyncPolicy(SyncPolicy policy)
+    {
+        m_sync_policy = policy;
+    }
+
+    /**
+     * @brief Enables checking single downloads against the API's MD5
+     * 
+     * @param verify True to verify
+     */
+    void Downloader::setVerifyIntegrity(bool verify)
+    {
+        m_verify_integrity = verify;
+    }
+
+    /**
+     * @brief Sets the pool that downloadToMemory takes its buffers from
+     * 
+     * @param pool Pool to use; nullptr restores a private pool
+     */
+    void Downloader::setBufferPool(std::shared_ptr<BufferPool> pool)
+    {
+        m_buffer_pool = pool ? std::move(pool) : std::make_shared<BufferPool>();
+    }
+
+    /**
+     * @brief Routes file writes through a shared DiskWriter
+     * 
+     * @param writer DiskWriter to use, or nullptr for plain writes
+     */
+    void Downloader::setDiskWriter(std::shared_ptr<DiskWriter> writer)
+    {
+        m_disk_writer = std::move(writer);
+    }
+
+    /**
+     * @brief Enables prefetching the start of previews after each search
+     * 
+     * @param policy Prefetch settings; policy.enabled false turns prefetching off
+     */
+    void Downloader::setPreviewPrefetch(const PrefetchPolicy& policy)
+    {
+        m_prefetcher = policy.enabled ? std::make_shared<PreviewPrefetcher>(policy) : nullptr;
+        m_prefetch_top_k = policy.top_k;
+    }
+
+    /**
+     * @brief Pauses background prefetching while the returned handle is alive
+     * 
+     * @return std::shared_ptr<void> Handle, or nullptr if prefetching is off
+     */
+    std::shared_ptr<void> Downloader::foregroundScope()
+    {
+        return m_prefetcher ? m_prefetcher->foreground() : nullptr;
+    }
+
+    /**
+     * @brief Fetches the MD5 the API publishes for a sound's original file
+     * 
+     * @param sound_id Unique identifier of the sound
+     * @return std::optional<std::string> Lowercase hexadecimal digest, or std::nullopt on failure
+     */
+    std::optional<std::string> Downloader::fetchExpectedMd5(int sound_id)
+    {
+        const auto foreground = foregroundScope();
         auto response = cpr::Get(
-            cpr::Url{download_url},
-            cpr::Parameters{{"token", m_api_key}}
+            cpr::Url{m_base_url + "sounds/" + std::to_string(sound_id) + "/"},
+            cpr::Parameters{{"token", m_api_key}, {"fields", "md5"}}
         );
 
         if (response.status_code != 200) 
+        {
+            return std::nullopt;
+        }
+
+        try 
+        {
+            const auto metadata = nlohmann::json::parse(response.text);
+            std::string md5 = metadata.at("md5").get<std::string>();
+            if (md5.size() != 32) 
+            {
+                return std::nullopt;
+            }
+            for (auto& c : md5) 
+            {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return md5;
+        }
+        catch (const nlohmann::json::exception&) 
+        {
+            return std::nullopt;
+        }
+    }
+
+    /**
+     * @brief Streams the original file of a sound to callbacks
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param on_start Called once the response headers announce a 
+     *                 successful body, with its Content-Length if known
+     * @param on_data Called with each received part of the body
+     * @return bool True if the complete body was received and accepted
+     */
+    bool Downloader::receiveSound(
+        int sound_id,
+        const std::function<bool(std::optional<uint64_t>)>& on_start,
+        const std::function<bool(const char*, size_t)>& on_data
+    )
+    {
+        return receive(m_base_url + "sounds/" + std::to_string(sound_id) + "/download/", on_start, on_data);
+    }
+
+    /**
+     * @brief Streams a download endpoint's body to callbacks
+     * 
+     * @param url Endpoint, authenticated with the API key
+     * @param on_start Called once the response headers announce a 
+     *                 successful body, with its Content-Length if known
+     * @param on_data Called with each received part of the body
+     * @return bool True if the complete body was received and accepted
+     */
+    bool Downloader::receive(
+        const std::string& url,
+        const std::function<bool(std::optional<uint64_t>)>& on_start,
+        const std::function<bool(const char*, size_t)>& on_data
+    )
+    {
+        // Header blocks repeat for every redirect; only the last one describes the body
+        long status = 0;
+        std::optional<uint64_t> content_length;
+        bool started = false;
+        bool rejected = false;
+
+        auto start = [&]() 
+        {
+            started = true;
+            rejected = !on_start(content_length);
+            return !rejected;
+        };
+
+        auto on_header = [&](std::string_view line, intptr_t) 
+        {
+            if (line.rfind("HTTP/", 0) == 0) 
+            {
+                const size_t space = line.find(' ');
+                status = space == std::string_view::npos 
+                    ? 0 : std::strtol(std::string(line.substr(space + 1, 3)).c_str(), nullptr, 10);
+                content_length.reset();
+            }
+            else if (line.size() > 15 && startsWithIgnoreCase(line, "content-length:")) 
+            {
+                content_length = std::strtoull(std::string(line.substr(15)).c_str(), nullptr, 10);
+            }
+            else if ((line == "\r\n" || line == "\n") && status == 200 && !started) 
+            {
+                // Let the receiver prepare before the first body byte arrives
+                return start();
+            }
+            return true;
+        };
+
+        auto on_body = [&](std::string_view data, intptr_t) 
+        {
+            if (status != 200) 
+            {
+                return true;
+            }
+            if (!started && !start()) 
+            {
+                return false;
+            }
+
+            rejected = !on_data(data.data(), data.size());
+            return !rejected;
+        };
+
+        const auto foreground = foregroundScope();
+        auto response = cpr::Get(
+            cpr::Url{url},
+            cpr::Parameters{{"token", m_api_key}},
+            cpr::HeaderCallback{on_header},
+            cpr::WriteCallback{on_body}
+        );
+
+        if (rejected || response.error || response.status_code != 200) 
         {
             return false;
         }
+        return started || on_start(content_length);
+    }
 
-        std::ofstream out_file(output_path, std::ios::binary);
-        if (!out_file) 
+    /**
+     * @brief Streams the original file of a sound to callbacks, checking its MD5 if enabled
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param on_start Called once the response headers announce a 
+     *                 successful body, with its Content-Length if known
+     * @param on_data Called with each received part of the body
+     * @return bool True if the complete body was received, accepted and 
+     *              (with verification enabled) matched the API's MD5
+     */
+    bool Downloader::receiveVerifiedSound(
+        int sound_id,
+        const std::function<bool(std::optional<uint64_t>)>& on_start,
+        const std::function<bool(const char*, size_t)>& on_data
+    )
+    {
+        std::optional<std::string> expected_md5;
+        if (m_verify_integrity && !(expected_md5 = fetchExpectedMd5(sound_id))) 
         {
             return false;
         }
-        
-        out_file.write(response.text.c_str(), response.text.size());
-        out_file.close();
 
+        Md5 md5;
+        const bool ok = receiveSound(
+            sound_id,
+            on_start,
+            [&](const char* data, size_t size) 
+            {
+                if (expected_md5) 
+                {
+                    md5.update(data, size);
+                }
+                return on_data(data, size);
+            }
+        );
+        return ok && (!expected_md5 || Md5::toHex(md5.finish()) == *expected_md5);
+    }
+
+    /**
+     * @brief Streams the original file of a sound into an open AtomicFile
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param file Open AtomicFile receiving the body
+     * @param expected_md5 Digest the body must have, if it is to be verified
+     * @return bool True if the complete body was written (and matched)
+     */
+    bool Downloader::streamSound(
+        int sound_id, 
+        AtomicFile& file, 
+        const std::optional<std::string>& expected_md5
+    )
+    {
+        std::optional<uint64_t> content_length;
+        uint64_t received = 0;
+        std::optional<DiskWriter::File> disk_file;
+        Md5 md5;
+
+        const bool ok = receiveSound(
+            sound_id,
+            [&](std::optional<uint64_t> length) 
+            {
+                // Reserve the space before the first body byte arrives
+                content_length = length;
+                if (m_disk_writer) 
+                {
+                    disk_file.emplace(*m_disk_writer, file.descriptor());
+                }
+                return !length || file.preallocate(*length);
+            },
+            [&](const char* data, size_t size) 
+            {
+                received += size;
+                if (expected_md5) 
+                {
+                    md5.update(data, size);
+                }
+                return disk_file 
+                    ? disk_file->append(data, size) 
+                    : file.write(data, size);
+            }
+        );
+
+        if (disk_file && !disk_file->finish()) 
+        {
+            return false;
+        }
+        if (!ok || (expected_md5 && Md5::toHex(md5.finish()) != *expected_md5)) 
+        {
+            return false;
+        }
+
+        // A body shorter than announced leaves preallocated space to release
+        if (content_length && received != *content_length) 
+        {
+            return file.truncate(received);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Streams a sound into `<output_dir>/<id>.<ext>` through the write-behind stage
+     * 
+     * The first bytes are held back until the container format, and with 
+     * it the file name, is known.
+     * 
+     * @param sound_id Unique identifier of the sound to download
+     * @param output_dir Existing destination directory
+     * @param writer Write-behind stage performing the disk writes
+     * @param file Closed AtomicFile; open and complete on success
+     * @param expected_md5 Digest the body must have, if it is to be verified
+     * @return bool True if the complete body was written (and matched)
+     */
+    bool Downloader::streamSound(
+        int sound_id, 
+        const std::string& output_dir, 
+        WriteBehindWriter& writer, 
+        AtomicFile& file,
+        const std::optional<std::string>& expected_md5
+    )
+    {
+        std::optional<uint64_t> content_length;
+        std::string head;
+        std::optional<WriteBehindWriter::Stream> stream;
+
+        auto open_file = [&]() 
+        {
+            const AudioFormat format = sniffAudioFormat(
+                reinterpret_cast<const uint8_t*>(head.data()), head.size());
+            const std::string path = (std::filesystem::path(output_dir) 
+                / (std::to_string(sound_id) + "." + audioFormatExtension(format))).string();
+
+            if (!file.open(path) || (content_length && !file.preallocate(*content_length))) 
+            {
+                return false;
+            }
+            stream.emplace(writer, file, expected_md5.has_value());
+            return stream->append(head.data(), head.size());
+        };
+
+        bool ok = receiveSound(
+            sound_id,
+            [&](std::optional<uint64_t> length) 
+            {
+                content_length = length;
+                return true;
+            },
+            [&](const char* data, size_t size) 
+            {
+                if (stream) 
+                {
+                    return stream->append(data, size);
+                }
+                head.append(data, size);
+                return head.size() < AUDIO_SNIFF_BYTES || open_file();
+            }
+        );
+
+        ok = ok && (stream || open_file());
+        if (stream) 
+        {
+            ok = stream->finish() && ok;
+        }
+        if (ok && expected_md5) 
+        {
+            // Hashed by the write-behind stage, several files per SIMD pass
+            ok = Md5::toHex(*stream->md5()) == *expected_md5;
+        }
+        if (!ok) 
+        {
+            file.abort();
+            return false;
+        }
+
+        if (content_length && stream->size() != *content_length) 
+        {
+            return file.truncate(stream->size());
+        }
         return true;
     }
 
@@ -110,8 +940,9 @@ namespace FreesoundDownloader
         int page_size
     )
     {
-        std::string search_url = BASE_URL + "search/text/";
+        std::string search_url = m_base_url + "search/text/";
         
+        const auto foreground = foregroundScope();
         auto response = cpr::Get(
             cpr::Url{search_url},
             cpr::Parameters{
@@ -155,7 +986,7 @@ namespace FreesoundDownloader
         const std::optional<std::string>& weights
     )
     {
-        std::string search_url = BASE_URL + "search/text/";
+        std::string search_url = m_base_url + "search/text/";
         
         cpr::Parameters params{
             {"query", query},
@@ -179,6 +1010,7 @@ namespace FreesoundDownloader
         }
 
         try {
+            auto foreground = foregroundScope();
             auto response = cpr::Get(
                 cpr::Url{search_url},
                 cpr::Parameters{params},
@@ -190,6 +1022,10 @@ namespace FreesoundDownloader
             );
 
             if (response.status_code == 200) {
+                foreground.reset();
+                if (m_prefetcher) {
+                    m_prefetcher->prefetch(previewUrls(response.text, m_prefetch_top_k));
+                }
                 return response.text;
             } else {
                 std::cerr << "FREESOUND API ERROR:" << std::endl;
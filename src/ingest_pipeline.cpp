@@ -0,0 +1,569 @@
+/**
+ * @file src/ingest_pipeline.cpp
+ * @brief Implementation of the download, decode, resample and write pipeline
+ *
+ * @see include/ingest_pipeline.h
+ */
+
+#include "ingest_pipeline.h"
+#include "audio_decoder.h"
+#include "audio_format.h"
+#include "download_sink.h"
+#include "float_wav_writer.h"
+#include "freesound_downloader.h"
+#include "resampler.h"
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Received bytes are handed to the decoder in blocks of about this size
+        constexpr size_t NETWORK_BLOCK_BYTES = 64 * 1024;
+
+        enum StageIndex : size_t
+        {
+            DECODE_STAGE,
+            RESAMPLE_STAGE,
+            WRITE_STAGE,
+            STAGE_COUNT
+        };
+    }
+
+    /**
+     * @brief Outcome of one ingest() call, completed as its jobs are destroyed
+     */
+    struct IngestPipeline::Batch
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t outstanding = 0;
+        std::vector<int> failed;
+    };
+
+    /**
+     * @brief One sound on its way through the stages
+     *
+     * Each stage keeps a reference while it holds blocks of the job; the
+     * job reports its outcome to the batch once the last reference is gone.
+     */
+    struct IngestPipeline::Job
+    {
+        Job(int id, std::string output_path, Batch& owner)
+            : sound_id(id), path(std::move(output_path)), batch(owner)
+        {
+        }
+
+        ~Job()
+        {
+            // Notify under the lock: the batch is destroyed as soon as ingest() sees zero
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (!committed)
+            {
+                batch.failed.push_back(sound_id);
+            }
+            --batch.outstanding;
+            batch.done.notify_all();
+        }
+
+        /// Blocks waiting in front of a stage; guarded by that stage's mutex
+        struct Queue
+        {
+            std::deque<Block> blocks;
+
+            /// Queued in the stage's ready list or being processed by a worker
+            bool active = false;
+        };
+
+        const int sound_id;
+        const std::string path;
+        Batch& batch;
+        std::array<Queue, STAGE_COUNT> queues;
+        std::atomic<bool> failed{false};
+
+        /// Decode stage: leading bytes until the format is known, then the decoder
+        std::vector<uint8_t> head;
+        std::unique_ptr<AudioDecoder> decoder;
+
+        /// Layout of the decoded samples, set by the decode stage before its first output
+        uint16_t channels = 0;
+        uint32_t sample_rate = 0;
+
+        /// Resample stage
+        std::unique_ptr<Resampler> resampler;
+        std::unique_ptr<PeakBuilder> peak_builder;
+
+        std::unique_ptr<FeatureExtractor> feature_extractor;
+        std::unique_ptr<Fingerprinter> fingerprinter;
+
+        /// Waveform overview, features and fingerprint, completed by the resample stage with the end marker
+        WaveformPeaks peaks;
+        AudioFeatures features;
+        Fingerprint fingerprint;
+
+        /// Write stage
+        FloatWavWriter writer;
+        bool writer_open = false;
+        bool committed = false;
+    };
+
+    /**
+     * @brief Starts a stage's workers
+     *
+     * @param index Position of the stage's queue within each Job
+     * @param workers Number of worker threads
+     * @param depth Blocks of one job that may wait before push() blocks
+     * @param handler Processes one block of a job
+     */
+    IngestPipeline::Stage::Stage(size_t index, unsigned workers, size_t depth, Handler handler)
+        : m_index(index), m_depth(depth), m_handler(std::move(handler))
+    {
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            m_workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    /**
+     * @brief Stops the workers once every queued block is processed
+     */
+    IngestPipeline::Stage::~Stage()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_work.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Queues a block of a job, blocking while the job's queue for this stage is full
+     *
+     * @param job Job the block belongs to
+     * @param block Block to process after the job's earlier blocks
+     */
+    void IngestPipeline::Stage::push(const std::shared_ptr<Job>& job, Block&& block)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Job::Queue& queue = job->queues[m_index];
+        m_space.wait(lock, [&]() { return queue.blocks.size() < m_depth; });
+        queue.blocks.push_back(std::move(block));
+        if (!queue.active)
+        {
+            queue.active = true;
+            m_ready.push_back(job);
+            lock.unlock();
+            m_work.notify_one();
+        }
+    }
+
+    /**
+     * @brief Body of a stage worker
+     */
+    void IngestPipeline::Stage::workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_work.wait(lock, [this]() { return m_stopping || !m_ready.empty(); });
+            if (m_ready.empty())
+            {
+                return;
+            }
+
+            std::shared_ptr<Job> job = std::move(m_ready.front());
+            m_ready.pop_front();
+            Job::Queue& queue = job->queues[m_index];
+            Block block = std::move(queue.blocks.front());
+            queue.blocks.pop_front();
+            lock.unlock();
+            m_space.notify_all();
+
+            m_handler(job, std::move(block));
+
+            lock.lock();
+            if (queue.blocks.empty())
+            {
+                queue.active = false;
+            }
+            else
+            {
+                // Back of the line, so one busy job cannot starve the others
+                m_ready.push_back(job);
+                m_work.notify_one();
+            }
+
+            // The last reference may complete the batch; do that outside the lock
+            lock.unlock();
+            job.reset();
+            lock.lock();
+        }
+    }
+
+    /**
+     * @brief Starts the stage workers
+     *
+     * @param downloader Downloader performing the transfers; must outlive the pipeline
+     * @param options Rates, worker counts and queue sizes
+     * @throws std::invalid_argument If a worker count, queue_depth or target_rate is zero,
+     *         write_peaks, write_features or fingerprint_index is set with invalid options, or
+     *         similarity_index is set without write_features or does not hold feature embeddings
+     */
+    IngestPipeline::IngestPipeline(Downloader& downloader, const IngestOptions& options)
+        : m_downloader(downloader), m_options(options)
+    {
+        if (options.network_workers == 0 || options.decode_workers == 0 || options.resample_workers == 0
+            || options.write_workers == 0 || options.queue_depth == 0 || options.target_rate == 0)
+        {
+            throw std::invalid_argument("IngestPipeline needs workers for every stage, a queue depth and a rate");
+        }
+        if (options.write_peaks)
+        {
+            PeakBuilder validate(1, options.target_rate, options.peaks);
+        }
+        if (options.write_features)
+        {
+            FeatureExtractor validate(1, options.target_rate, options.features);
+        }
+        if (options.similarity_index
+            && (!options.write_features || options.similarity_index->dimensions() != AudioFeatures::EMBEDDING_SIZE))
+        {
+            throw std::invalid_argument("IngestPipeline: similarity_index needs write_features and embedding vectors");
+        }
+        if (options.fingerprint_index)
+        {
+            Fingerprinter validate(1, options.target_rate, options.fingerprints);
+        }
+
+        // Downstream stages are created first so they exist before anything feeds them
+        m_write = std::make_unique<Stage>(WRITE_STAGE, options.write_workers, options.queue_depth,
+            [this](const std::shared_ptr<Job>& job, Block&& block) { writeBlock(job, std::move(block)); });
+        m_resample = std::make_unique<Stage>(RESAMPLE_STAGE, options.resample_workers, options.queue_depth,
+            [this](const std::shared_ptr<Job>& job, Block&& block) { resampleBlock(job, std::move(block)); });
+        m_decode = std::make_unique<Stage>(DECODE_STAGE, options.decode_workers, options.queue_depth,
+            [this](const std::shared_ptr<Job>& job, Block&& block) { decodeBlock(job, std::move(block)); });
+    }
+
+    /**
+     * @brief Stops the stage workers, upstream first
+     */
+    IngestPipeline::~IngestPipeline()
+    {
+        m_decode.reset();
+        m_resample.reset();
+        m_write.reset();
+    }
+
+    /**
+     * @brief Ingests sounds into a directory
+     *
+     * @param sound_ids Identifiers of the sounds to ingest
+     * @param output_dir Directory receiving the files (created if missing)
+     * @return std::vector<int> Identifiers that could not be ingested
+     */
+    std::vector<int> IngestPipeline::ingest(const std::vector<int>& sound_ids, const std::string& output_dir)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(output_dir, ec);
+        if (ec)
+        {
+            return sound_ids;
+        }
+
+        Batch batch;
+        std::atomic<size_t> next_index{0};
+
+        // Network stage: each transfer feeds the decode stage as its bytes arrive
+        auto network = [&]()
+        {
+            for (size_t index = next_index++; index < sound_ids.size(); index = next_index++)
+            {
+                const int sound_id = sound_ids[index];
+                {
+                    std::lock_guard<std::mutex> lock(batch.mutex);
+                    ++batch.outstanding;
+                }
+                auto job = std::make_shared<Job>(sound_id,
+                    (std::filesystem::path(output_dir) / (std::to_string(sound_id) + ".wav")).string(), batch);
+
+                Block pending;
+                CallbackSink sink([&](const char* data, size_t size)
+                {
+                    pending.bytes.insert(pending.bytes.end(), data, data + size);
+                    if (pending.bytes.size() >= NETWORK_BLOCK_BYTES)
+                    {
+                        m_decode->push(job, std::move(pending));
+                        pending = Block();
+                    }
+                    return !job->failed.load();
+                });
+
+                const bool received = m_downloader.downloadSound(sound_id, sink);
+                if (received && !pending.bytes.empty())
+                {
+                    m_decode->push(job, std::move(pending));
+                }
+                if (!received)
+                {
+                    job->failed = true;
+                }
+
+                Block end;
+                end.end = true;
+                m_decode->push(job, std::move(end));
+            }
+        };
+
+        const size_t thread_count = std::min<size_t>(m_options.network_workers, sound_ids.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < thread_count; ++i)
+        {
+            threads.emplace_back(network);
+        }
+        if (thread_count > 0)
+        {
+            network();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        batch.done.wait(lock, [&batch]() { return batch.outstanding == 0; });
+        return batch.failed;
+    }
+
+    /**
+     * @brief Decode stage: turns received bytes into interleaved float samples
+     *
+     * @param job Sound the block belongs to
+     * @param block Received bytes, or the end marker
+     */
+    void IngestPipeline::decodeBlock(const std::shared_ptr<Job>& job, Block&& block)
+    {
+        Block decoded;
+        decoded.end = block.end;
+        if (!job->failed)
+        {
+            const uint8_t* data = block.bytes.data();
+            size_t size = block.bytes.size();
+            if (!job->decoder && size > 0)
+            {
+                // Wait for enough bytes to recognise the container
+                job->head.insert(job->head.end(), data, data + size);
+                if (job->head.size() >= AUDIO_SNIFF_BYTES)
+                {
+                    job->decoder = AudioDecoder::create(sniffAudioFormat(job->head.data(), job->head.size()));
+                    job->failed = !job->decoder;
+                    data = job->head.data();
+                    size = job->head.size();
+                }
+                else
+                {
+                    size = 0;
+                }
+            }
+
+            if (job->decoder && size > 0 && !job->decoder->push(data, size, decoded.samples))
+            {
+                job->failed = true;
+            }
+            if (block.end && (!job->decoder || !job->decoder->finish(decoded.samples)))
+            {
+                job->failed = true;
+            }
+            if (job->decoder)
+            {
+                job->head = std::vector<uint8_t>();
+            }
+
+            if (job->decoder && job->decoder->info() && !job->channels)
+            {
+                job->channels = job->decoder->info()->channels;
+                job->sample_rate = job->decoder->info()->sample_rate;
+            }
+        }
+
+        if (decoded.end || (!job->failed && !decoded.samples.empty()))
+        {
+            m_resample->push(job, std::move(decoded));
+        }
+    }
+
+    /**
+     * @brief Resample stage: converts decoded samples to the target rate
+     *
+     * @param job Sound the block belongs to
+     * @param block Decoded samples, possibly with the end marker
+     */
+    void IngestPipeline::resampleBlock(const std::shared_ptr<Job>& job, Block&& block)
+    {
+        Block converted;
+        converted.end = block.end;
+        if (!job->failed && job->channels)
+        {
+            if (!job->resampler)
+            {
+                job->resampler = std::make_unique<Resampler>(job->channels, job->sample_rate, m_options.target_rate,
+                                                             m_options.resample_quality);
+            }
+            job->resampler->process(block.samples.data(), block.samples.size() / job->channels, converted.samples);
+            if (block.end)
+            {
+                job->resampler->flush(converted.samples);
+            }
+
+            // Analysis happens here so that its cost is spread over the resample workers
+            if (m_options.write_peaks)
+            {
+                if (!job->peak_builder)
+                {
+                    job->peak_builder = std::make_unique<PeakBuilder>(job->channels, m_options.target_rate,
+                                                                      m_options.peaks);
+                }
+                job->peak_builder->push(converted.samples.data(), converted.samples.size() / job->channels);
+                if (block.end)
+                {
+                    job->peaks = job->peak_builder->finish();
+                }
+            }
+            if (m_options.write_features)
+            {
+                if (!job->feature_extractor)
+                {
+                    job->feature_extractor = std::make_unique<FeatureExtractor>(job->channels, m_options.target_rate,
+                                                                                m_options.features);
+                }
+                job->feature_extractor->push(converted.samples.data(), converted.samples.size() / job->channels);
+                if (block.end)
+                {
+                    job->features = job->feature_extractor->finish();
+                }
+            }
+            if (m_options.fingerprint_index)
+            {
+                if (!job->fingerprinter)
+                {
+                    job->fingerprinter = std::make_unique<Fingerprinter>(job->channels, m_options.target_rate,
+                                                                         m_options.fingerprints);
+                }
+                job->fingerprinter->push(converted.samples.data(), converted.samples.size() / job->channels);
+                if (block.end)
+                {
+                    job->fingerprint = job->fingerprinter->finish();
+                }
+            }
+        }
+
+        if (converted.end || (!job->failed && !converted.samples.empty()))
+        {
+            m_write->push(job, std::move(converted));
+        }
+    }
+
+    /**
+     * @brief Write stage: appends converted samples to the output file
+     *
+     * @param job Sound the block belongs to
+     * @param block Converted samples, possibly with the end marker
+     */
+    void IngestPipeline::writeBlock(const std::shared_ptr<Job>& job, Block&& block)
+    {
+        if (!job->failed && !job->writer_open)
+        {
+            job->writer_open = job->channels && job->writer.open(job->path, m_options.target_rate, job->channels);
+            job->failed = !job->writer_open;
+        }
+        if (!job->failed && !block.samples.empty() && !job->writer.write(block.samples.data(), block.samples.size()))
+        {
+            job->failed = true;
+        }
+
+        if (block.end)
+        {
+            const bool sync = m_options.sync_policy != SyncPolicy::None;
+
+            // Claim the sound's place in the fingerprint index before anything appears, so that
+            // of two copies in flight at once only one is taken for the original
+            FingerprintIndex* fingerprints = m_options.fingerprint_index.get();
+            std::optional<FingerprintMatch> original;
+            bool fingerprinted = false;
+            if (!job->failed && fingerprints && !fingerprints->contains(job->sound_id))
+            {
+                original = fingerprints->insertIfUnique(job->sound_id, job->fingerprint, m_options.duplicate_score);
+                fingerprinted = !original;
+            }
+            if (original && m_options.duplicates == DuplicatePolicy::Reference)
+            {
+                job->writer.abort();
+                const std::string text = std::to_string(original->sound_id) + "\n";
+                AtomicFile reference;
+                job->committed = reference.open(referencePathFor(job->path))
+                    && reference.write(text.data(), text.size()) && reference.commit(sync);
+                if (!job->committed)
+                {
+                    reference.abort();
+                }
+                else if (m_options.on_duplicate)
+                {
+                    m_options.on_duplicate(job->sound_id, *original);
+                }
+                return;
+            }
+
+            // Side files go first, so a thumbnail and features exist as soon as the sound does
+            if (!job->failed && m_options.write_peaks && !job->peaks.save(peakPathFor(job->path), sync))
+            {
+                job->failed = true;
+            }
+            if (!job->failed && m_options.write_features
+                && !job->features.save(featurePathFor(job->path), sync))
+            {
+                job->failed = true;
+            }
+            if (!job->failed)
+            {
+                job->committed = job->writer.commit(sync);
+                std::error_code ec;
+                if (!job->committed && m_options.write_peaks)
+                {
+                    std::filesystem::remove(peakPathFor(job->path), ec);
+                }
+                if (!job->committed && m_options.write_features)
+                {
+                    std::filesystem::remove(featurePathFor(job->path), ec);
+                }
+                if (job->committed && m_options.similarity_index)
+                {
+                    m_options.similarity_index->insert(job->sound_id, job->features.embedding().data());
+                }
+                if (job->committed && original)
+                {
+                    fingerprints->insert(job->sound_id, job->fingerprint);
+                    if (m_options.on_duplicate)
+                    {
+                        m_options.on_duplicate(job->sound_id, *original);
+                    }
+                }
+            }
+            else if (job->writer_open)
+            {
+                job->writer.abort();
+            }
+            if (!job->committed && fingerprinted)
+            {
+                fingerprints->remove(job->sound_id);
+            }
+        }
+    }
+}
@@ -0,0 +1,1277 @@
+/**
+ * @file src/lossless_codec.cpp
+ * @brief Implementation of the lossless PCM codec
+ *
+ * Compressed file layout (little-endian):
+ *   header  64 bytes: magic, original size, sample offset, frames, block frames,
+ *           block count, channels, bits per sample, sample layout, reserved
+ *   table   8 bytes per block: end of the block, relative to the first block
+ *   prefix  the original bytes before the samples
+ *   suffix  the original bytes after the samples
+ *   blocks  one bitstream per block (most significant bit first), byte aligned
+ *
+ * A block starts with its 2-bit stereo mode, followed by one subframe per
+ * channel: a 2-bit type, then a constant, verbatim samples, or a predictor
+ * (order, precision, shift, coefficients, warm-up samples) and its
+ * partitioned Rice-coded residual.
+ *
+ * @see include/lossless_codec.h
+ */
+
+#include "lossless_codec.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        const char CODEC_MAGIC[8] = {'F', 'S', 'L', 'P', 'C', 'M', '0', '1'};
+        constexpr size_t CODEC_HEADER_SIZE = 64;
+
+        /// Sample layout flags
+        constexpr uint8_t BIG_ENDIAN_SAMPLES = 1;
+        constexpr uint8_t UNSIGNED_SAMPLES = 2;
+
+        constexpr unsigned MAX_CHANNELS = 8;
+        constexpr unsigned MAX_ORDER = 32;
+        constexpr unsigned MAX_PARTITION_ORDER = 8;
+        constexpr unsigned MAX_RICE_PARAMETER = 30;
+
+        /// Longest unary prefix the encoder writes; longer ones get a larger Rice parameter
+        constexpr uint32_t MAX_QUOTIENT = 4095;
+
+        /// Residuals beyond this make a channel verbatim, which keeps every code below 32 bits
+        constexpr int64_t MAX_RESIDUAL = int64_t(1) << 30;
+
+        /// Coefficient precision when the predictor needs 64-bit sums (24-bit samples)
+        constexpr unsigned WIDE_PRECISION = 15;
+        constexpr unsigned MIN_NARROW_PRECISION = 10;
+
+        enum : uint32_t
+        {
+            SUBFRAME_CONSTANT = 0,
+            SUBFRAME_VERBATIM = 1,
+            SUBFRAME_LPC = 2
+        };
+
+        enum : uint32_t
+        {
+            INDEPENDENT = 0,
+            LEFT_SIDE = 1,
+            SIDE_RIGHT = 2
+        };
+
+        /**
+         * @brief Where the samples of a PCM file lie and how they are stored
+         */
+        struct PcmLayout
+        {
+            size_t offset = 0;
+            uint64_t frames = 0;
+            unsigned channels = 0;
+            unsigned bytes = 0;
+            uint8_t flags = 0;
+        };
+
+        template <typename T>
+        T loadValue(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void storeValue(uint8_t* bytes, T value)
+        {
+            std::memcpy(bytes, &value, sizeof(T));
+        }
+
+        uint32_t loadBe(const uint8_t* p, unsigned bytes)
+        {
+            uint32_t value = 0;
+            for (unsigned i = 0; i < bytes; ++i)
+            {
+                value = (value << 8) | p[i];
+            }
+            return value;
+        }
+
+        uint32_t loadLe(const uint8_t* p, unsigned bytes)
+        {
+            uint32_t value = 0;
+            for (unsigned i = bytes; i-- > 0;)
+            {
+                value = (value << 8) | p[i];
+            }
+            return value;
+        }
+
+        unsigned leadingZeros(uint64_t value)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return value ? static_cast<unsigned>(__builtin_clzll(value)) : 64;
+#else
+            unsigned zeros = 0;
+            for (uint64_t bit = uint64_t(1) << 63; bit && !(value & bit); bit >>= 1)
+            {
+                ++zeros;
+            }
+            return zeros;
+#endif
+        }
+
+        unsigned ceilLog2(unsigned value)
+        {
+            unsigned bits = 0;
+            while ((1u << bits) < value)
+            {
+                ++bits;
+            }
+            return bits;
+        }
+
+        /**
+         * @brief Finds the integer PCM samples of a RIFF WAVE file
+         */
+        std::optional<PcmLayout> parseWav(const uint8_t* data, size_t size)
+        {
+            if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+            {
+                return std::nullopt;
+            }
+
+            PcmLayout layout;
+            uint64_t position = 12;
+            while (position + 8 <= size)
+            {
+                const uint8_t* chunk = data + position;
+                const uint64_t length = loadLe(chunk + 4, 4);
+                const uint64_t body = position + 8;
+                if (std::memcmp(chunk, "fmt ", 4) == 0)
+                {
+                    if (length < 16 || body + 16 > size)
+                    {
+                        return std::nullopt;
+                    }
+                    const uint32_t tag = loadLe(chunk + 8, 2);
+                    const bool extensible = tag == 0xFFFE && length >= 26 && body + 26 <= size
+                        && loadLe(chunk + 8 + 24, 2) == 1;
+                    const unsigned channels = loadLe(chunk + 10, 2);
+                    const unsigned align = loadLe(chunk + 20, 2);
+                    if ((tag != 1 && !extensible) || channels == 0 || align == 0 || align % channels != 0)
+                    {
+                        return std::nullopt;
+                    }
+                    layout.channels = channels;
+                    layout.bytes = align / channels;
+                    layout.flags = layout.bytes == 1 ? UNSIGNED_SAMPLES : 0;
+                }
+                else if (std::memcmp(chunk, "data", 4) == 0)
+                {
+                    if (layout.channels == 0)
+                    {
+                        return std::nullopt;
+                    }
+                    const uint64_t available = std::min<uint64_t>(length, size - body);
+                    layout.offset = static_cast<size_t>(body);
+                    layout.frames = available / (layout.channels * layout.bytes);
+                    return layout;
+                }
+                position = body + length + (length & 1);
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * @brief Finds the integer PCM samples of an AIFF or uncompressed AIFF-C file
+         */
+        std::optional<PcmLayout> parseAiff(const uint8_t* data, size_t size)
+        {
+            if (size < 12 || std::memcmp(data, "FORM", 4) != 0
+                || (std::memcmp(data + 8, "AIFF", 4) != 0 && std::memcmp(data + 8, "AIFC", 4) != 0))
+            {
+                return std::nullopt;
+            }
+            const bool compressed_form = std::memcmp(data + 8, "AIFC", 4) == 0;
+
+            PcmLayout layout;
+            uint64_t declared_frames = 0;
+            uint64_t sound_start = 0;
+            uint64_t sound_length = 0;
+            bool have_sound = false;
+            uint64_t position = 12;
+            while (position + 8 <= size)
+            {
+                const uint8_t* chunk = data + position;
+                const uint64_t length = loadBe(chunk + 4, 4);
+                const uint64_t body = position + 8;
+                if (std::memcmp(chunk, "COMM", 4) == 0)
+                {
+                    if (length < 18 || body + 18 > size)
+                    {
+                        return std::nullopt;
+                    }
+                    layout.channels = loadBe(chunk + 8, 2);
+                    declared_frames = loadBe(chunk + 10, 4);
+                    layout.bytes = (loadBe(chunk + 14, 2) + 7) / 8;
+                    layout.flags = BIG_ENDIAN_SAMPLES;
+                    if (compressed_form)
+                    {
+                        if (length < 22 || body + 22 > size)
+                        {
+                            return std::nullopt;
+                        }
+                        const uint8_t* type = chunk + 8 + 18;
+                        if (std::memcmp(type, "sowt", 4) == 0)
+                        {
+                            layout.flags = 0;
+                        }
+                        else if (std::memcmp(type, "NONE", 4) != 0 && std::memcmp(type, "twos", 4) != 0)
+                        {
+                            return std::nullopt;
+                        }
+                    }
+                }
+                else if (std::memcmp(chunk, "SSND", 4) == 0)
+                {
+                    if (length < 8 || body + 8 > size)
+                    {
+                        return std::nullopt;
+                    }
+                    const uint64_t skip = loadBe(chunk + 8, 4);
+                    sound_start = body + 8 + skip;
+                    sound_length = length >= 8 + skip ? length - 8 - skip : 0;
+                    have_sound = sound_start <= size;
+                }
+                position = body + length + (length & 1);
+            }
+
+            if (!have_sound || layout.channels == 0 || layout.bytes == 0)
+            {
+                return std::nullopt;
+            }
+            const uint64_t available = std::min<uint64_t>(sound_length, size - sound_start);
+            layout.offset = static_cast<size_t>(sound_start);
+            layout.frames = std::min<uint64_t>(declared_frames, available / (layout.channels * layout.bytes));
+            return layout;
+        }
+
+        int32_t readSample(const uint8_t* p, unsigned bytes, uint8_t flags)
+        {
+            if (bytes == 1)
+            {
+                return (flags & UNSIGNED_SAMPLES) ? static_cast<int32_t>(p[0]) - 128 : static_cast<int8_t>(p[0]);
+            }
+            const uint32_t value = (flags & BIG_ENDIAN_SAMPLES) ? loadBe(p, bytes) : loadLe(p, bytes);
+            const unsigned unused = 32 - 8 * bytes;
+            return static_cast<int32_t>(value << unused) >> unused;
+        }
+
+        void writeSample(uint8_t* p, unsigned bytes, uint8_t flags, int32_t sample)
+        {
+            const uint32_t value = static_cast<uint32_t>(sample) + ((flags & UNSIGNED_SAMPLES) ? 128u : 0u);
+            for (unsigned i = 0; i < bytes; ++i)
+            {
+                const unsigned at = (flags & BIG_ENDIAN_SAMPLES) ? bytes - 1 - i : i;
+                p[at] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        /**
+         * @brief Appends bit fields, most significant bit first
+         */
+        class BitWriter
+        {
+        public:
+            explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+            /// Appends the low bits of value (bits up to 32)
+            void write(uint32_t value, unsigned bits)
+            {
+                if (bits == 0)
+                {
+                    return;
+                }
+                m_buffer = (m_buffer << bits) | (value & (0xFFFFFFFFu >> (32 - bits)));
+                m_bits += bits;
+                while (m_bits >= 8)
+                {
+                    m_bits -= 8;
+                    m_out.push_back(static_cast<uint8_t>(m_buffer >> m_bits));
+                }
+            }
+
+            void writeSigned(int32_t value, unsigned bits)
+            {
+                write(static_cast<uint32_t>(value), bits);
+            }
+
+            /// Appends value as a Rice code: quotient in unary (zeros ended by a one), then k low bits
+            void writeRice(uint32_t value, unsigned k)
+            {
+                uint32_t quotient = value >> k;
+                const uint32_t low = k ? value & (0xFFFFFFFFu >> (32 - k)) : 0;
+                if (quotient + 1 + k <= 32)
+                {
+                    write((1u << k) | low, quotient + 1 + k);
+                    return;
+                }
+                for (; quotient >= 32; quotient -= 32)
+                {
+                    write(0, 32);
+                }
+                write(1, quotient + 1);
+                write(low, k);
+            }
+
+            /// Pads the last byte with zeros
+            void flush()
+            {
+                if (m_bits > 0)
+                {
+                    write(0, 8 - m_bits);
+                }
+            }
+
+        private:
+            std::vector<uint8_t>& m_out;
+            uint64_t m_buffer = 0;
+            unsigned m_bits = 0;
+        };
+
+        /**
+         * @brief Reads bit fields written by BitWriter, 64 bits of look-ahead at a time
+         *
+         * Reading past the end yields zeros and marks the reader as failed.
+         */
+        class BitReader
+        {
+        public:
+            BitReader(const uint8_t* data, size_t size) : m_data(data), m_end(data + size) {}
+
+            /// Reads bits (1 to 32) as an unsigned value
+            uint32_t read(unsigned bits)
+            {
+                refill();
+                const auto value = static_cast<uint32_t>(m_cache >> (64 - bits));
+                m_cache <<= bits;
+                m_count -= bits;
+                return value;
+            }
+
+            int32_t readSigned(unsigned bits)
+            {
+                const unsigned unused = 32 - bits;
+                return static_cast<int32_t>(read(bits) << unused) >> unused;
+            }
+
+            /// Counts the zeros before the next one and skips them and the one
+            uint32_t readUnary()
+            {
+                uint32_t zeros = 0;
+                for (;;)
+                {
+                    refill();
+                    const unsigned leading = leadingZeros(m_cache);
+                    if (leading < m_count)
+                    {
+                        // Two shifts, as the one may be the cache's last bit
+                        m_cache = (m_cache << leading) << 1;
+                        m_count -= leading + 1;
+                        return zeros + leading;
+                    }
+                    zeros += m_count;
+                    m_cache = 0;
+                    m_count = 0;
+                    if (m_padding > 0)
+                    {
+                        return 0;
+                    }
+                }
+            }
+
+            /// Reads a Rice code with parameter k (0 to 30), from the cache alone when it holds the whole code
+            uint32_t readRice(unsigned k)
+            {
+                refill();
+                const unsigned leading = leadingZeros(m_cache);
+                if (leading + 1 + k <= m_count)
+                {
+                    const uint64_t rest = (m_cache << leading) << 1;
+                    const auto low = static_cast<uint32_t>((rest >> 1) >> (63 - k));
+                    m_cache = rest << k;
+                    m_count -= leading + 1 + k;
+                    return (leading << k) | low;
+                }
+
+                const uint32_t quotient = readUnary();
+                if (quotient > (0xFFFFFFFFu >> k))
+                {
+                    m_broken = true;
+                    return 0;
+                }
+                return (quotient << k) | (k ? read(k) : 0);
+            }
+
+            /// True once more bits were read than there are, or a code was too long
+            bool failed() const { return m_broken || m_padding > m_count; }
+
+        private:
+            void refill()
+            {
+                if (m_count > 56)
+                {
+                    return;
+                }
+                if (m_end - m_data >= 8)
+                {
+                    // Bits beyond the whole bytes taken are the next bytes' own, so ORing them again is harmless
+                    uint64_t word = 0;
+                    for (unsigned i = 0; i < 8; ++i)
+                    {
+                        word = (word << 8) | m_data[i];
+                    }
+                    m_cache |= word >> m_count;
+                    const unsigned taken = (64 - m_count) / 8;
+                    m_data += taken;
+                    m_count += 8 * taken;
+                    return;
+                }
+                while (m_count <= 56)
+                {
+                    uint64_t byte = 0;
+                    if (m_data < m_end)
+                    {
+                        byte = *m_data++;
+                    }
+                    else
+                    {
+                        m_padding += 8;
+                    }
+                    m_cache |= byte << (56 - m_count);
+                    m_count += 8;
+                }
+            }
+
+            const uint8_t* m_data;
+            const uint8_t* const m_end;
+
+            /// Bits not yet read, from the most significant; m_count of them are valid
+            uint64_t m_cache = 0;
+            unsigned m_count = 0;
+
+            /// Zero bits added to the cache past the end
+            unsigned m_padding = 0;
+            bool m_broken = false;
+        };
+
+        uint32_t zigzag(int32_t value)
+        {
+            return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        }
+
+        int32_t unzigzag(uint32_t value)
+        {
+            return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+        }
+
+        /**
+         * @brief Picks the Rice parameter for a partition from the sum and maximum of its values
+         */
+        unsigned riceParameter(uint64_t sum, size_t count, uint32_t largest)
+        {
+            unsigned k = 0;
+            while (k < MAX_RICE_PARAMETER && (static_cast<uint64_t>(count) << (k + 1)) <= sum)
+            {
+                ++k;
+            }
+            while (k < MAX_RICE_PARAMETER && (largest >> k) > MAX_QUOTIENT)
+            {
+                ++k;
+            }
+            return k;
+        }
+
+        /**
+         * @brief Chooses how to split a residual into Rice partitions
+         *
+         * @param values Zigzagged residual of samples order to count
+         * @param count Samples in the block
+         * @param order Warm-up samples, which have no residual
+         * @param partition_order Receives the chosen split (2^partition_order partitions)
+         * @return uint64_t Exact number of bits of the coded residual
+         */
+        uint64_t choosePartitions(const std::vector<uint32_t>& values, size_t count, unsigned order,
+                                  unsigned& partition_order)
+        {
+            uint64_t best = UINT64_MAX;
+            for (unsigned p = 0; p <= MAX_PARTITION_ORDER; ++p)
+            {
+                const size_t length = count >> p;
+                if (p > 0 && (length < 16 || length <= order))
+                {
+                    break;
+                }
+                uint64_t bits = 4;
+                for (size_t i = 0; i < (size_t(1) << p); ++i)
+                {
+                    const size_t first = std::max<size_t>(i * length, order) - order;
+                    const size_t last = (i + 1 == (size_t(1) << p) ? count : (i + 1) * length) - order;
+                    uint64_t sum = 0;
+                    uint32_t largest = 0;
+                    for (size_t n = first; n < last; ++n)
+                    {
+                        sum += values[n];
+                        largest = std::max(largest, values[n]);
+                    }
+                    const unsigned k = riceParameter(sum, last - first, largest);
+                    bits += 5 + (last - first) * (k + 1);
+                    for (size_t n = first; n < last; ++n)
+                    {
+                        bits += values[n] >> k;
+                    }
+                }
+                if (bits < best)
+                {
+                    best = bits;
+                    partition_order = p;
+                }
+            }
+            return best;
+        }
+
+        void writeResidual(BitWriter& writer, const std::vector<uint32_t>& values, size_t count, unsigned order,
+                           unsigned partition_order)
+        {
+            writer.write(partition_order, 4);
+            const size_t length = count >> partition_order;
+            for (size_t i = 0; i < (size_t(1) << partition_order); ++i)
+            {
+                const size_t first = std::max<size_t>(i * length, order) - order;
+                const size_t last = (i + 1 == (size_t(1) << partition_order) ? count : (i + 1) * length) - order;
+                uint64_t sum = 0;
+                uint32_t largest = 0;
+                for (size_t n = first; n < last; ++n)
+                {
+                    sum += values[n];
+                    largest = std::max(largest, values[n]);
+                }
+                const unsigned k = riceParameter(sum, last - first, largest);
+                writer.write(k, 5);
+                for (size_t n = first; n < last; ++n)
+                {
+                    writer.writeRice(values[n], k);
+                }
+            }
+        }
+
+        /**
+         * @brief Coefficient precision that keeps the predictor's sums within 32 bits, or 0 if none does
+         */
+        unsigned narrowPrecision(unsigned sample_bits, unsigned order)
+        {
+            const int precision = 32 - static_cast<int>(sample_bits) - static_cast<int>(ceilLog2(order));
+            return precision >= static_cast<int>(MIN_NARROW_PRECISION) ? static_cast<unsigned>(std::min(precision, 15))
+                                                                       : 0;
+        }
+
+        /**
+         * @brief Reusable buffers of one encoding thread
+         */
+        struct EncoderScratch
+        {
+            std::vector<float> windowed;
+            std::vector<float> window;
+            std::vector<int32_t> residual;
+            std::vector<uint32_t> values;
+        };
+
+        /**
+         * @brief Codes one channel of a block with the cheapest of the subframe types
+         *
+         * @param writer Destination
+         * @param samples The channel's samples
+         * @param count Number of samples
+         * @param sample_bits Width of the samples (one more for a side channel)
+         * @param max_order Highest predictor order tried
+         * @param scratch Buffers
+         */
+        void encodeSubframe(BitWriter& writer, const int32_t* samples, size_t count, unsigned sample_bits,
+                            unsigned max_order, EncoderScratch& scratch)
+        {
+            if (std::all_of(samples, samples + count, [&](int32_t s) { return s == samples[0]; }))
+            {
+                writer.write(SUBFRAME_CONSTANT, 2);
+                writer.writeSigned(samples[0], sample_bits);
+                return;
+            }
+
+            auto writeVerbatim = [&]() {
+                writer.write(SUBFRAME_VERBATIM, 2);
+                for (size_t n = 0; n < count; ++n)
+                {
+                    writer.writeSigned(samples[n], sample_bits);
+                }
+            };
+            max_order = std::min<unsigned>(max_order, static_cast<unsigned>(count - 1) / 2);
+            if (max_order == 0)
+            {
+                writeVerbatim();
+                return;
+            }
+
+            // Autocorrelation of the windowed block, with the vectorized dot product
+            if (scratch.window.size() != count)
+            {
+                scratch.window.resize(count);
+                const double half = (static_cast<double>(count) + 1.0) / 2.0;
+                for (size_t n = 0; n < count; ++n)
+                {
+                    const double x = (static_cast<double>(n) - (static_cast<double>(count) - 1.0) / 2.0) / half;
+                    scratch.window[n] = static_cast<float>(1.0 - x * x);
+                }
+            }
+            scratch.windowed.resize(count);
+            const float scale = 1.0f / static_cast<float>(1u << (sample_bits - 1));
+            for (size_t n = 0; n < count; ++n)
+            {
+                scratch.windowed[n] = static_cast<float>(samples[n]) * scale * scratch.window[n];
+            }
+            double autocorrelation[MAX_ORDER + 1];
+            for (unsigned lag = 0; lag <= max_order; ++lag)
+            {
+                autocorrelation[lag] = dotProduct(scratch.windowed.data(), scratch.windowed.data() + lag, count - lag);
+            }
+            if (autocorrelation[0] <= 0.0)
+            {
+                writeVerbatim();
+                return;
+            }
+            autocorrelation[0] *= 1.0 + 1e-9;
+
+            // Levinson-Durbin recursion: predictors of every order and their errors
+            double reflection[MAX_ORDER];
+            double predictors[MAX_ORDER][MAX_ORDER];
+            double errors[MAX_ORDER];
+            double error = autocorrelation[0];
+            unsigned orders = max_order;
+            for (unsigned i = 0; i < max_order; ++i)
+            {
+                double r = -autocorrelation[i + 1];
+                for (unsigned j = 0; j < i; ++j)
+                {
+                    r -= reflection[j] * autocorrelation[i - j];
+                }
+                r /= error;
+                reflection[i] = r;
+                unsigned j = 0;
+                for (; j < i / 2; ++j)
+                {
+                    const double previous = reflection[j];
+                    reflection[j] += r * reflection[i - 1 - j];
+                    reflection[i - 1 - j] += r * previous;
+                }
+                if (i & 1)
+                {
+                    reflection[j] += reflection[j] * r;
+                }
+                error *= 1.0 - r * r;
+                for (j = 0; j <= i; ++j)
+                {
+                    predictors[i][j] = -reflection[j];
+                }
+                errors[i] = error;
+                if (error <= 0.0)
+                {
+                    orders = i + 1;
+                    break;
+                }
+            }
+
+            // Estimated size of each order: a Laplacian residual of deviation s takes about log2(s) + 1.94
+            // bits a sample, and the window kept 8/15 of the energy
+            unsigned order = 1;
+            double best = HUGE_VAL;
+            const double energy = std::ldexp(1.0, 2 * static_cast<int>(sample_bits - 1)) * 15.0 / 8.0;
+            for (unsigned i = 0; i < orders; ++i)
+            {
+                const unsigned precision = narrowPrecision(sample_bits, i + 1);
+                const double variance = std::max(errors[i] * energy / static_cast<double>(count), 1e-30);
+                const double per_sample = std::max(0.0, 0.5 * std::log2(variance) + 1.94);
+                const double bits = per_sample * static_cast<double>(count - i - 1)
+                    + (i + 1) * ((precision ? precision : WIDE_PRECISION) + sample_bits);
+                if (bits < best)
+                {
+                    best = bits;
+                    order = i + 1;
+                }
+            }
+
+            // Quantise, carrying each coefficient's rounding error into the next
+            const unsigned narrow = narrowPrecision(sample_bits, order);
+            const unsigned precision = narrow ? narrow : WIDE_PRECISION;
+            double largest = 0.0;
+            for (unsigned j = 0; j < order; ++j)
+            {
+                largest = std::max(largest, std::abs(predictors[order - 1][j]));
+            }
+            int exponent = 0;
+            std::frexp(largest, &exponent);
+            const int shift = static_cast<int>(precision) - 1 - exponent;
+            if (largest <= 0.0 || shift < 0)
+            {
+                writeVerbatim();
+                return;
+            }
+            const unsigned bits_shift = static_cast<unsigned>(std::min(shift, 15));
+            const int32_t limit = 1 << (precision - 1);
+            int32_t coefficients[MAX_ORDER];
+            double carried = 0.0;
+            for (unsigned j = 0; j < order; ++j)
+            {
+                carried += predictors[order - 1][j] * static_cast<double>(1 << bits_shift);
+                const auto quantised = static_cast<int32_t>(
+                    std::clamp<long>(std::lround(carried), -static_cast<long>(limit), limit - 1));
+                carried -= quantised;
+                coefficients[j] = quantised;
+            }
+
+            const size_t residuals = count - order;
+            scratch.residual.resize(residuals);
+            if (narrow)
+            {
+                lpcResidual(samples + order, residuals, coefficients, order, bits_shift, scratch.residual.data());
+            }
+            else
+            {
+                for (size_t n = order; n < count; ++n)
+                {
+                    int64_t sum = 0;
+                    for (unsigned j = 0; j < order; ++j)
+                    {
+                        sum += static_cast<int64_t>(coefficients[j]) * samples[n - 1 - j];
+                    }
+                    const int64_t difference = samples[n] - (sum >> bits_shift);
+                    if (difference >= MAX_RESIDUAL || difference <= -MAX_RESIDUAL)
+                    {
+                        writeVerbatim();
+                        return;
+                    }
+                    scratch.residual[n - order] = static_cast<int32_t>(difference);
+                }
+            }
+            scratch.values.resize(residuals);
+            for (size_t n = 0; n < residuals; ++n)
+            {
+                if (scratch.residual[n] >= MAX_RESIDUAL || scratch.residual[n] <= -MAX_RESIDUAL)
+                {
+                    writeVerbatim();
+                    return;
+                }
+                scratch.values[n] = zigzag(scratch.residual[n]);
+            }
+
+            unsigned partition_order = 0;
+            const uint64_t residual_bits = choosePartitions(scratch.values, count, order, partition_order);
+            const uint64_t lpc_bits = 2 + 5 + 4 + 4 + order * (precision + sample_bits) + residual_bits;
+            if (lpc_bits >= 2 + static_cast<uint64_t>(count) * sample_bits)
+            {
+                writeVerbatim();
+                return;
+            }
+
+            writer.write(SUBFRAME_LPC, 2);
+            writer.write(order - 1, 5);
+            writer.write(precision - 1, 4);
+            writer.write(bits_shift, 4);
+            for (unsigned j = 0; j < order; ++j)
+            {
+                writer.writeSigned(coefficients[j], precision);
+            }
+            for (unsigned j = 0; j < order; ++j)
+            {
+                writer.writeSigned(samples[j], sample_bits);
+            }
+            writeResidual(writer, scratch.values, count, order, partition_order);
+        }
+
+        /**
+         * @brief Sum of the magnitudes of the second differences, a cheap stand-in for the coded size
+         */
+        uint64_t roughCost(const std::vector<int32_t>& samples)
+        {
+            uint64_t cost = 0;
+            for (size_t n = 2; n < samples.size(); ++n)
+            {
+                const int64_t difference = int64_t(samples[n]) - 2 * int64_t(samples[n - 1]) + samples[n - 2];
+                cost += static_cast<uint64_t>(difference < 0 ? -difference : difference);
+            }
+            return cost;
+        }
+
+        /**
+         * @brief Codes the frames of one block
+         */
+        void encodeBlock(const uint8_t* pcm, const PcmLayout& layout, uint64_t first_frame, size_t frames,
+                         unsigned max_order, EncoderScratch& scratch, std::vector<uint8_t>& out)
+        {
+            const unsigned bits = 8 * layout.bytes;
+            std::vector<std::vector<int32_t>> channels(layout.channels, std::vector<int32_t>(frames));
+            const size_t frame_bytes = size_t(layout.channels) * layout.bytes;
+            for (size_t f = 0; f < frames; ++f)
+            {
+                const uint8_t* frame = pcm + (first_frame + f) * frame_bytes;
+                for (unsigned c = 0; c < layout.channels; ++c)
+                {
+                    channels[c][f] = readSample(frame + c * layout.bytes, layout.bytes, layout.flags);
+                }
+            }
+
+            // Stereo: replace the channel that costs more by the difference, when that is cheaper
+            uint32_t mode = INDEPENDENT;
+            if (layout.channels == 2)
+            {
+                std::vector<int32_t> side(frames);
+                for (size_t f = 0; f < frames; ++f)
+                {
+                    side[f] = channels[0][f] - channels[1][f];
+                }
+                const uint64_t left = roughCost(channels[0]);
+                const uint64_t right = roughCost(channels[1]);
+                const uint64_t difference = roughCost(side);
+                if (difference < std::max(left, right))
+                {
+                    mode = left <= right ? LEFT_SIDE : SIDE_RIGHT;
+                    channels[mode == LEFT_SIDE ? 1 : 0] = std::move(side);
+                }
+            }
+
+            BitWriter writer(out);
+            writer.write(mode, 2);
+            for (unsigned c = 0; c < layout.channels; ++c)
+            {
+                const bool side = (mode == LEFT_SIDE && c == 1) || (mode == SIDE_RIGHT && c == 0);
+                encodeSubframe(writer, channels[c].data(), frames, bits + (side ? 1 : 0), max_order, scratch);
+            }
+            writer.flush();
+        }
+
+        /**
+         * @brief Adds the prediction to a residual in place, with wrapping 32-bit sums
+         *
+         * ORDER > 0 fixes the order at compile time so the inner loop unrolls;
+         * 0 reads it from order.
+         */
+        template <unsigned ORDER>
+        void restoreNarrow(int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                           unsigned shift)
+        {
+            if (ORDER > 0)
+            {
+                order = ORDER;
+            }
+            uint32_t taps[MAX_ORDER];
+            for (unsigned j = 0; j < order; ++j)
+            {
+                taps[j] = static_cast<uint32_t>(coefficients[j]);
+            }
+            // The newest sample stays in a register and enters the sum last, which keeps
+            // the chain from one output to the next short
+            uint32_t newest = static_cast<uint32_t>(samples[order - 1]);
+            for (size_t n = order; n < count; ++n)
+            {
+                uint32_t sum = 0;
+                for (unsigned j = (ORDER > 0 ? ORDER : order) - 1; j > 0; --j)
+                {
+                    sum += taps[j] * static_cast<uint32_t>(samples[n - 1 - j]);
+                }
+                sum += taps[0] * newest;
+                newest = static_cast<uint32_t>(samples[n]) + static_cast<uint32_t>(static_cast<int32_t>(sum) >> shift);
+                samples[n] = static_cast<int32_t>(newest);
+            }
+        }
+
+        void restoreNarrow(int32_t* samples, size_t count, const int32_t* coefficients, unsigned order,
+                           unsigned shift)
+        {
+            switch (order)
+            {
+                case 1: return restoreNarrow<1>(samples, count, coefficients, order, shift);
+                case 2: return restoreNarrow<2>(samples, count, coefficients, order, shift);
+                case 3: return restoreNarrow<3>(samples, count, coefficients, order, shift);
+                case 4: return restoreNarrow<4>(samples, count, coefficients, order, shift);
+                case 5: return restoreNarrow<5>(samples, count, coefficients, order, shift);
+                case 6: return restoreNarrow<6>(samples, count, coefficients, order, shift);
+                case 7: return restoreNarrow<7>(samples, count, coefficients, order, shift);
+                case 8: return restoreNarrow<8>(samples, count, coefficients, order, shift);
+                case 9: return restoreNarrow<9>(samples, count, coefficients, order, shift);
+                case 10: return restoreNarrow<10>(samples, count, coefficients, order, shift);
+                case 11: return restoreNarrow<11>(samples, count, coefficients, order, shift);
+                case 12: return restoreNarrow<12>(samples, count, coefficients, order, shift);
+                default: return restoreNarrow<0>(samples, count, coefficients, order, shift);
+            }
+        }
+
+        /**
+         * @brief Decodes one channel of a block
+         */
+        bool decodeSubframe(BitReader& reader, int32_t* samples, size_t count, unsigned sample_bits)
+        {
+            const uint32_t type = reader.read(2);
+            if (type == SUBFRAME_CONSTANT)
+            {
+                std::fill(samples, samples + count, reader.readSigned(sample_bits));
+                return !reader.failed();
+            }
+            if (type == SUBFRAME_VERBATIM)
+            {
+                for (size_t n = 0; n < count; ++n)
+                {
+                    samples[n] = reader.readSigned(sample_bits);
+                }
+                return !reader.failed();
+            }
+            if (type != SUBFRAME_LPC)
+            {
+                return false;
+            }
+
+            const unsigned order = reader.read(5) + 1;
+            const unsigned precision = reader.read(4) + 1;
+            const unsigned shift = reader.read(4);
+            if (order >= count)
+            {
+                return false;
+            }
+            int32_t coefficients[MAX_ORDER];
+            for (unsigned j = 0; j < order; ++j)
+            {
+                coefficients[j] = reader.readSigned(precision);
+            }
+            for (unsigned j = 0; j < order; ++j)
+            {
+                samples[j] = reader.readSigned(sample_bits);
+            }
+
+            const unsigned partition_order = reader.read(4);
+            const size_t length = count >> partition_order;
+            if (partition_order > MAX_PARTITION_ORDER || (partition_order > 0 && length <= order))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < (size_t(1) << partition_order); ++i)
+            {
+                const size_t first = std::max<size_t>(i * length, order);
+                const size_t last = i + 1 == (size_t(1) << partition_order) ? count : (i + 1) * length;
+                const unsigned k = reader.read(5);
+                for (size_t n = first; n < last; ++n)
+                {
+                    samples[n] = unzigzag(reader.readRice(k));
+                }
+                if (reader.failed())
+                {
+                    return false;
+                }
+            }
+
+            // Same arithmetic as the encoder: 32-bit sums when they cannot overflow, 64-bit otherwise
+            if (precision <= narrowPrecision(sample_bits, order))
+            {
+                restoreNarrow(samples, count, coefficients, order, shift);
+            }
+            else
+            {
+                for (size_t n = order; n < count; ++n)
+                {
+                    int64_t sum = 0;
+                    for (unsigned j = 0; j < order; ++j)
+                    {
+                        sum += static_cast<int64_t>(coefficients[j]) * samples[n - 1 - j];
+                    }
+                    samples[n] = static_cast<int32_t>(samples[n] + (sum >> shift));
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Decodes one block straight into the samples of the output file
+         */
+        bool decodeBlock(const uint8_t* data, size_t size, const PcmLayout& layout, uint64_t first_frame,
+                         size_t frames, uint8_t* pcm, std::vector<int32_t>& scratch)
+        {
+            BitReader reader(data, size);
+            const uint32_t mode = reader.read(2);
+            if (mode > SIDE_RIGHT || (mode != INDEPENDENT && layout.channels != 2))
+            {
+                return false;
+            }
+
+            const unsigned bits = 8 * layout.bytes;
+            scratch.resize(frames * layout.channels);
+            for (unsigned c = 0; c < layout.channels; ++c)
+            {
+                const bool side = (mode == LEFT_SIDE && c == 1) || (mode == SIDE_RIGHT && c == 0);
+                if (!decodeSubframe(reader, scratch.data() + c * frames, frames, bits + (side ? 1 : 0)))
+                {
+                    return false;
+                }
+            }
+            if (reader.failed())
+            {
+                return false;
+            }
+
+            int32_t* first = scratch.data();
+            int32_t* second = scratch.data() + frames;
+            if (mode == LEFT_SIDE)
+            {
+                for (size_t f = 0; f < frames; ++f)
+                {
+                    second[f] = static_cast<int32_t>(static_cast<uint32_t>(first[f])
+                                                     - static_cast<uint32_t>(second[f]));
+                }
+            }
+            else if (mode == SIDE_RIGHT)
+            {
+                for (size_t f = 0; f < frames; ++f)
+                {
+                    first[f] = static_cast<int32_t>(static_cast<uint32_t>(first[f])
+                                                    + static_cast<uint32_t>(second[f]));
+                }
+            }
+
+            const size_t frame_bytes = size_t(layout.channels) * layout.bytes;
+            for (size_t f = 0; f < frames; ++f)
+            {
+                uint8_t* frame = pcm + (first_frame + f) * frame_bytes;
+                for (unsigned c = 0; c < layout.channels; ++c)
+                {
+                    writeSample(frame + c * layout.bytes, layout.bytes, layout.flags, scratch[c * frames + f]);
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Runs work(index, worker) for every index below count on up to threads threads
+         */
+        template <typename Work>
+        void runParallel(size_t count, unsigned threads, Work work)
+        {
+            if (threads == 0)
+            {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+            std::atomic<size_t> next{0};
+            auto loop = [&](unsigned worker) {
+                for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+                     i = next.fetch_add(1, std::memory_order_relaxed))
+                {
+                    work(i, worker);
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; ++t)
+            {
+                workers.emplace_back(loop, t);
+            }
+            loop(0);
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+    }
+
+    /**
+     * @brief Compresses an integer PCM WAV or AIFF file without losing a bit
+     *
+     * @param data Contents of the file
+     * @param size Number of bytes at data
+     * @param options Block size, predictor order and threads
+     * @return std::optional<std::vector<uint8_t>> Compressed file, or std::nullopt if the file
+     *         is not 8-, 16- or 24-bit PCM with 1 to 8 channels, or would not get smaller
+     * @throws std::invalid_argument If block_frames or max_order is out of range
+     */
+    std::optional<std::vector<uint8_t>> compressPcmFile(const uint8_t* data, size_t size,
+                                                        const LosslessOptions& options)
+    {
+        if (options.block_frames < 16 || options.block_frames > 65536 || options.max_order == 0
+            || options.max_order > MAX_ORDER)
+        {
+            throw std::invalid_argument("compressPcmFile needs 16 to 65536 block frames and an order from 1 to 32");
+        }
+
+        auto layout = parseWav(data, size);
+        if (!layout)
+        {
+            layout = parseAiff(data, size);
+        }
+        if (!layout || layout->channels > MAX_CHANNELS || layout->bytes < 1 || layout->bytes > 3
+            || layout->frames == 0)
+        {
+            return std::nullopt;
+        }
+
+        const uint64_t block_count = (layout->frames + options.block_frames - 1) / options.block_frames;
+        std::vector<std::vector<uint8_t>> blocks(static_cast<size_t>(block_count));
+        std::vector<EncoderScratch> scratch(std::max(1u, options.threads ? options.threads
+                                                                         : std::thread::hardware_concurrency()));
+        runParallel(blocks.size(), static_cast<unsigned>(scratch.size()), [&](size_t block, unsigned worker) {
+            const uint64_t first = uint64_t(block) * options.block_frames;
+            const auto frames = static_cast<size_t>(std::min<uint64_t>(options.block_frames, layout->frames - first));
+            encodeBlock(data + layout->offset, *layout, first, frames, options.max_order, scratch[worker],
+                        blocks[block]);
+        });
+
+        const size_t pcm_bytes = static_cast<size_t>(layout->frames) * layout->channels * layout->bytes;
+        const size_t suffix = size - layout->offset - pcm_bytes;
+        size_t total = CODEC_HEADER_SIZE + blocks.size() * 8 + layout->offset + suffix;
+        for (const auto& block : blocks)
+        {
+            total += block.size();
+        }
+        if (total >= size)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<uint8_t> out(CODEC_HEADER_SIZE + blocks.size() * 8);
+        out.reserve(total);
+        std::memcpy(out.data(), CODEC_MAGIC, sizeof(CODEC_MAGIC));
+        storeValue<uint64_t>(out.data() + 8, size);
+        storeValue<uint64_t>(out.data() + 16, layout->offset);
+        storeValue<uint64_t>(out.data() + 24, layout->frames);
+        storeValue<uint32_t>(out.data() + 32, options.block_frames);
+        storeValue<uint32_t>(out.data() + 36, static_cast<uint32_t>(blocks.size()));
+        storeValue<uint16_t>(out.data() + 40, static_cast<uint16_t>(layout->channels));
+        out[42] = static_cast<uint8_t>(8 * layout->bytes);
+        out[43] = layout->flags;
+        uint64_t end = 0;
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            end += blocks[i].size();
+            storeValue<uint64_t>(out.data() + CODEC_HEADER_SIZE + i * 8, end);
+        }
+        out.insert(out.end(), data, data + layout->offset);
+        out.insert(out.end(), data + layout->offset + pcm_bytes, data + size);
+        for (const auto& block : blocks)
+        {
+            out.insert(out.end(), block.begin(), block.end());
+        }
+        return out;
+    }
+
+    /**
+     * @brief Rebuilds the original file from the output of compressPcmFile()
+     *
+     * @param data Contents of the compressed file
+     * @param size Number of bytes at data
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::optional<std::vector<uint8_t>> Original file, or std::nullopt if data is damaged
+     *         or was not written by compressPcmFile()
+     */
+    std::optional<std::vector<uint8_t>> decompressPcmFile(const uint8_t* data, size_t size, unsigned threads)
+    {
+        if (!isCompressedPcmFile(data, size) || size < CODEC_HEADER_SIZE)
+        {
+            return std::nullopt;
+        }
+
+        const auto original_size = loadValue<uint64_t>(data + 8);
+        PcmLayout layout;
+        const auto offset = loadValue<uint64_t>(data + 16);
+        layout.frames = loadValue<uint64_t>(data + 24);
+        const auto block_frames = loadValue<uint32_t>(data + 32);
+        const auto block_count = loadValue<uint32_t>(data + 36);
+        layout.channels = loadValue<uint16_t>(data + 40);
+        layout.bytes = data[42] / 8u;
+        layout.flags = data[43];
+        if (layout.channels == 0 || layout.channels > MAX_CHANNELS || data[42] % 8 != 0 || layout.bytes < 1
+            || layout.bytes > 3 || block_frames < 16 || block_frames > 65536 || layout.frames == 0
+            || offset > original_size || original_size > SIZE_MAX / 2)
+        {
+            return std::nullopt;
+        }
+        const uint64_t frame_bytes = uint64_t(layout.channels) * layout.bytes;
+        if (layout.frames > (original_size - offset) / frame_bytes
+            || block_count != (layout.frames + block_frames - 1) / block_frames)
+        {
+            return std::nullopt;
+        }
+        layout.offset = static_cast<size_t>(offset);
+        const uint64_t pcm_bytes = layout.frames * frame_bytes;
+        const uint64_t kept = original_size - pcm_bytes;
+        const uint64_t blocks_start = CODEC_HEADER_SIZE + uint64_t(block_count) * 8 + kept;
+        if (blocks_start > size)
+        {
+            return std::nullopt;
+        }
+
+        const uint8_t* table = data + CODEC_HEADER_SIZE;
+        std::vector<uint64_t> ends(block_count);
+        uint64_t previous = 0;
+        for (uint32_t i = 0; i < block_count; ++i)
+        {
+            ends[i] = loadValue<uint64_t>(table + uint64_t(i) * 8);
+            if (ends[i] < previous)
+            {
+                return std::nullopt;
+            }
+            previous = ends[i];
+        }
+        if (previous != size - blocks_start)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<uint8_t> out(static_cast<size_t>(original_size));
+        const uint8_t* kept_bytes = table + uint64_t(block_count) * 8;
+        std::memcpy(out.data(), kept_bytes, layout.offset);
+        std::memcpy(out.data() + layout.offset + pcm_bytes, kept_bytes + layout.offset,
+                    static_cast<size_t>(kept - layout.offset));
+
+        const uint8_t* blocks = data + blocks_start;
+        std::atomic<bool> damaged{false};
+        std::vector<std::vector<int32_t>> scratch(std::max(1u, threads ? threads
+                                                                        : std::thread::hardware_concurrency()));
+        runParallel(block_count, static_cast<unsigned>(scratch.size()), [&](size_t block, unsigned worker) {
+            const uint64_t begin = block ? ends[block - 1] : 0;
+            const uint64_t first = uint64_t(block) * block_frames;
+            const auto frames = static_cast<size_t>(std::min<uint64_t>(block_frames, layout.frames - first));
+            if (!damaged.load(std::memory_order_relaxed)
+                && !decodeBlock(blocks + begin, static_cast<size_t>(ends[block] - begin), layout, first, frames,
+                                out.data() + layout.offset, scratch[worker]))
+            {
+                damaged = true;
+            }
+        });
+        if (damaged)
+        {
+            return std::nullopt;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Tells whether bytes start like the output of compressPcmFile()
+     *
+     * @param data Leading bytes of a file
+     * @param size Number of bytes at data
+     * @return bool True if the magic number matches
+     */
+    bool isCompressedPcmFile(const uint8_t* data, size_t size)
+    {
+        return size >= sizeof(CODEC_MAGIC) && std::memcmp(data, CODEC_MAGIC, sizeof(CODEC_MAGIC)) == 0;
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file src/mapped_file.cpp
+ * @brief Implementation of the MappedFile class
+ *
+ * Uses mmap on POSIX systems and file mapping objects on Windows.
+ *
+ * @see include/mapped_file.h
+ */
+
+#include "mapped_file.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FreesoundDownloader
+{
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_open = std::exchange(other.m_open, false);
+#ifdef _WIN32
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Maps a file into memory for reading
+     *
+     * @param path Filesystem path of the file to map
+     * @return bool True if the file was mapped
+     */
+    bool MappedFile::open(const std::string& path)
+    {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        if (size.QuadPart > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!mapping)
+            {
+                return false;
+            }
+
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!view)
+            {
+                CloseHandle(mapping);
+                return false;
+            }
+
+            m_mapping = mapping;
+            m_data = static_cast<const uint8_t*>(view);
+            m_size = static_cast<size_t>(size.QuadPart);
+        }
+        else
+        {
+            CloseHandle(file);
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        if (info.st_size > 0)
+        {
+            void* view = mmap(nullptr, static_cast<size_t>(info.st_size),
+                PROT_READ, MAP_SHARED, fd, 0);
+            if (view == MAP_FAILED)
+            {
+                ::close(fd);
+                return false;
+            }
+
+            m_data = static_cast<const uint8_t*>(view);
+            m_size = static_cast<size_t>(info.st_size);
+        }
+        ::close(fd);
+#endif
+
+        m_open = true;
+        return true;
+    }
+
+    /**
+     * @brief Releases the mapping
+     */
+    void MappedFile::close()
+    {
+#ifdef _WIN32
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+#else
+        if (m_data)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_open = false;
+    }
+
+    /**
+     * @brief Hints the kernel that the whole mapping will be read soon
+     */
+    void MappedFile::willNeed() const
+    {
+#ifndef _WIN32
+        if (m_data)
+        {
+            madvise(const_cast<uint8_t*>(m_data), m_size, MADV_WILLNEED);
+        }
+#endif
+    }
+}
@@ -0,0 +1,415 @@
+/**
+ * @file src/md5.cpp
+ * @brief Scalar and multi-lane MD5 (RFC 1321)
+ *
+ * @see include/md5.h
+ */
+
+#include "md5.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// floor(abs(sin(i + 1)) * 2^32)
+        constexpr uint32_t ROUND_CONSTANTS[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+
+        constexpr uint32_t ROTATIONS[64] = {
+            7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+            5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+            4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+            6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+        };
+
+        /// Message word used by step i
+        constexpr unsigned messageIndex(unsigned i)
+        {
+            return i < 16 ? i
+                : i < 32 ? (5 * i + 1) % 16
+                : i < 48 ? (3 * i + 5) % 16
+                : (7 * i) % 16;
+        }
+
+        inline uint32_t loadLittleEndian(const uint8_t* p)
+        {
+            return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+                | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        /// Round function of the four 16-step rounds
+        template <unsigned Round>
+        inline uint32_t mix(uint32_t b, uint32_t c, uint32_t d)
+        {
+            if constexpr (Round == 0)
+            {
+                return (b & c) | (~b & d);
+            }
+            else if constexpr (Round == 1)
+            {
+                return (d & b) | (~d & c);
+            }
+            else if constexpr (Round == 2)
+            {
+                return b ^ c ^ d;
+            }
+            else
+            {
+                return c ^ (b | ~d);
+            }
+        }
+
+        /// Runs one round (16 steps) on a single chaining value
+        template <unsigned Round>
+        inline void scalarRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d, const uint32_t* words)
+        {
+            for (unsigned i = Round * 16; i < Round * 16 + 16; ++i)
+            {
+                const uint32_t x = a + mix<Round>(b, c, d) + ROUND_CONSTANTS[i] + words[messageIndex(i)];
+                const uint32_t s = ROTATIONS[i];
+                a = d;
+                d = c;
+                c = b;
+                b = b + ((x << s) | (x >> (32 - s)));
+            }
+        }
+
+        /**
+         * @brief Runs one round (16 steps) on every lane
+         *
+         * The lane loop is innermost and branch-free with a rotation amount
+         * shared by all lanes, which lets the auto-vectorizer turn it into
+         * SSE2/AVX2/NEON integer operations.
+         */
+        template <unsigned Round>
+        inline void laneRound(uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d,
+            const uint32_t (*words)[Md5::LANES])
+        {
+            for (unsigned i = Round * 16; i < Round * 16 + 16; ++i)
+            {
+                const uint32_t k = ROUND_CONSTANTS[i];
+                const uint32_t s = ROTATIONS[i];
+                const uint32_t* m = words[messageIndex(i)];
+                for (size_t lane = 0; lane < Md5::LANES; ++lane)
+                {
+                    const uint32_t x = a[lane] + mix<Round>(b[lane], c[lane], d[lane]) + k + m[lane];
+                    const uint32_t rotated = (x << s) | (x >> (32 - s));
+                    a[lane] = d[lane];
+                    d[lane] = c[lane];
+                    c[lane] = b[lane];
+                    b[lane] = b[lane] + rotated;
+                }
+            }
+        }
+
+        /**
+         * @brief Compresses the same number of blocks for up to LANES chaining values
+         *
+         * @param states Chaining values, one per used lane
+         * @param inputs Block data, one pointer per used lane
+         * @param used Number of lanes in use (1..LANES)
+         * @param blocks Blocks to compress in every lane
+         */
+        void compressLanes(uint32_t* const states[], const uint8_t* const inputs[], size_t used, size_t blocks)
+        {
+            alignas(32) uint32_t a[Md5::LANES], b[Md5::LANES], c[Md5::LANES], d[Md5::LANES];
+            alignas(32) uint32_t words[16][Md5::LANES];
+            const uint8_t* ptr[Md5::LANES];
+
+            for (size_t lane = 0; lane < Md5::LANES; ++lane)
+            {
+                // Idle lanes shadow lane 0; their results are discarded
+                const size_t source = lane < used ? lane : 0;
+                a[lane] = states[source][0];
+                b[lane] = states[source][1];
+                c[lane] = states[source][2];
+                d[lane] = states[source][3];
+                ptr[lane] = inputs[source];
+            }
+
+            for (size_t block = 0; block < blocks; ++block)
+            {
+                for (unsigned w = 0; w < 16; ++w)
+                {
+                    for (size_t lane = 0; lane < Md5::LANES; ++lane)
+                    {
+                        words[w][lane] = loadLittleEndian(ptr[lane] + block * 64 + w * 4);
+                    }
+                }
+
+                alignas(32) uint32_t aa[Md5::LANES], bb[Md5::LANES], cc[Md5::LANES], dd[Md5::LANES];
+                std::memcpy(aa, a, sizeof(a));
+                std::memcpy(bb, b, sizeof(b));
+                std::memcpy(cc, c, sizeof(c));
+                std::memcpy(dd, d, sizeof(d));
+
+                laneRound<0>(aa, bb, cc, dd, words);
+                laneRound<1>(aa, bb, cc, dd, words);
+                laneRound<2>(aa, bb, cc, dd, words);
+                laneRound<3>(aa, bb, cc, dd, words);
+
+                for (size_t lane = 0; lane < Md5::LANES; ++lane)
+                {
+                    a[lane] += aa[lane];
+                    b[lane] += bb[lane];
+                    c[lane] += cc[lane];
+                    d[lane] += dd[lane];
+                }
+            }
+
+            for (size_t lane = 0; lane < used; ++lane)
+            {
+                states[lane][0] = a[lane];
+                states[lane][1] = b[lane];
+                states[lane][2] = c[lane];
+                states[lane][3] = d[lane];
+            }
+        }
+    }
+
+    /**
+     * @brief Restarts the hash for a new message
+     */
+    void Md5::reset()
+    {
+        m_state[0] = 0x67452301;
+        m_state[1] = 0xefcdab89;
+        m_state[2] = 0x98badcfe;
+        m_state[3] = 0x10325476;
+        m_buffered = 0;
+        m_length = 0;
+    }
+
+    /**
+     * @brief Appends bytes to the message
+     *
+     * @param data Bytes to hash
+     * @param size Number of bytes at data
+     */
+    void Md5::update(const void* data, size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_length += size;
+
+        if (m_buffered > 0)
+        {
+            const size_t take = std::min(size, BLOCK_SIZE - m_buffered);
+            std::memcpy(m_buffer + m_buffered, bytes, take);
+            m_buffered += take;
+            bytes += take;
+            size -= take;
+            if (m_buffered < BLOCK_SIZE)
+            {
+                return;
+            }
+            compress(m_buffer, 1);
+            m_buffered = 0;
+        }
+
+        const size_t blocks = size / BLOCK_SIZE;
+        compress(bytes, blocks);
+        bytes += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+
+        std::memcpy(m_buffer, bytes, size);
+        m_buffered = size;
+    }
+
+    /**
+     * @brief Completes the hash; call reset() before reusing the object
+     *
+     * @return Digest MD5 of everything passed to update()
+     */
+    Md5::Digest Md5::finish()
+    {
+        const uint64_t bit_length = m_length * 8;
+
+        uint8_t padding[BLOCK_SIZE * 2] = {0x80};
+        const size_t pad_length = (m_buffered < 56 ? 56 : 120) - m_buffered;
+        for (int i = 0; i < 8; ++i)
+        {
+            padding[pad_length + i] = static_cast<uint8_t>(bit_length >> (8 * i));
+        }
+        update(padding, pad_length + 8);
+
+        Digest digest;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                digest[i * 4 + j] = static_cast<uint8_t>(m_state[i] >> (8 * j));
+            }
+        }
+        return digest;
+    }
+
+    /**
+     * @brief Appends data to several independent hashes at once
+     *
+     * @param hashers Hashes to advance
+     * @param data Bytes to append to each hash
+     * @param sizes Number of bytes at each data pointer
+     * @param count Number of hashes
+     */
+    void Md5::updateLanes(Md5* const hashers[], const uint8_t* const data[],
+        const size_t sizes[], size_t count)
+    {
+        for (size_t first = 0; first < count; first += LANES)
+        {
+            const size_t group = std::min(LANES, count - first);
+            Md5* lane_hashers[LANES];
+            const uint8_t* ptr[LANES];
+            size_t left[LANES];
+
+            // Complete any partially filled block so that every lane starts on a boundary
+            for (size_t lane = 0; lane < group; ++lane)
+            {
+                Md5& hasher = *hashers[first + lane];
+                const uint8_t* bytes = data[first + lane];
+                size_t size = sizes[first + lane];
+                hasher.m_length += size;
+
+                if (hasher.m_buffered > 0)
+                {
+                    const size_t take = std::min(size, BLOCK_SIZE - hasher.m_buffered);
+                    std::memcpy(hasher.m_buffer + hasher.m_buffered, bytes, take);
+                    hasher.m_buffered += take;
+                    bytes += take;
+                    size -= take;
+                    if (hasher.m_buffered == BLOCK_SIZE)
+                    {
+                        hasher.compress(hasher.m_buffer, 1);
+                        hasher.m_buffered = 0;
+                    }
+                }
+
+                lane_hashers[lane] = &hasher;
+                ptr[lane] = bytes;
+                left[lane] = size;
+            }
+
+            // Lockstep over the blocks the remaining lanes have in common
+            while (true)
+            {
+                uint32_t* states[LANES];
+                const uint8_t* inputs[LANES];
+                size_t active[LANES];
+                size_t used = 0;
+                size_t common = SIZE_MAX;
+                for (size_t lane = 0; lane < group; ++lane)
+                {
+                    if (left[lane] >= BLOCK_SIZE)
+                    {
+                        states[used] = lane_hashers[lane]->m_state;
+                        inputs[used] = ptr[lane];
+                        active[used++] = lane;
+                        common = std::min(common, left[lane] / BLOCK_SIZE);
+                    }
+                }
+                if (used < 2)
+                {
+                    break;
+                }
+
+                compressLanes(states, inputs, used, common);
+                for (size_t i = 0; i < used; ++i)
+                {
+                    ptr[active[i]] += common * BLOCK_SIZE;
+                    left[active[i]] -= common * BLOCK_SIZE;
+                }
+            }
+
+            // At most one lane still has whole blocks; tails go to the block buffers
+            for (size_t lane = 0; lane < group; ++lane)
+            {
+                if (left[lane] == 0)
+                {
+                    // Input was used up completing the pending block (or fully buffered)
+                    continue;
+                }
+
+                Md5& hasher = *lane_hashers[lane];
+                const size_t blocks = left[lane] / BLOCK_SIZE;
+                hasher.compress(ptr[lane], blocks);
+                const size_t tail = left[lane] - blocks * BLOCK_SIZE;
+                std::memcpy(hasher.m_buffer, ptr[lane] + blocks * BLOCK_SIZE, tail);
+                hasher.m_buffered = tail;
+            }
+        }
+    }
+
+    /**
+     * @brief Hashes a complete message
+     *
+     * @param data Message bytes
+     * @param size Number of bytes at data
+     * @return Digest MD5 of the message
+     */
+    Md5::Digest Md5::hash(const void* data, size_t size)
+    {
+        Md5 md5;
+        md5.update(data, size);
+        return md5.finish();
+    }
+
+    /**
+     * @brief Formats a digest as 32 lowercase hexadecimal characters
+     */
+    std::string Md5::toHex(const Digest& digest)
+    {
+        static const char HEX[] = "0123456789abcdef";
+        std::string text;
+        text.reserve(32);
+        for (uint8_t byte : digest)
+        {
+            text.push_back(HEX[byte >> 4]);
+            text.push_back(HEX[byte & 0x0F]);
+        }
+        return text;
+    }
+
+    /**
+     * @brief Compresses whole 64-byte blocks into the chaining value
+     *
+     * @param blocks Block data
+     * @param count Number of blocks
+     */
+    void Md5::compress(const uint8_t* blocks, size_t count)
+    {
+        for (size_t block = 0; block < count; ++block, blocks += BLOCK_SIZE)
+        {
+            uint32_t words[16];
+            for (unsigned w = 0; w < 16; ++w)
+            {
+                words[w] = loadLittleEndian(blocks + w * 4);
+            }
+
+            uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+            scalarRound<0>(a, b, c, d, words);
+            scalarRound<1>(a, b, c, d, words);
+            scalarRound<2>(a, b, c, d, words);
+            scalarRound<3>(a, b, c, d, words);
+
+            m_state[0] += a;
+            m_state[1] += b;
+            m_state[2] += c;
+            m_state[3] += d;
+        }
+    }
+}
@@ -0,0 +1,282 @@
+/**
+ * @file src/preview_prefetcher.cpp
+ * @brief Implementation of the preview prefix cache and prefetcher
+ *
+ * @see include/preview_prefetcher.h
+ */
+
+#include "preview_prefetcher.h"
+#include <cpr/cpr.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Creates an empty cache
+     *
+     * @param max_bytes Total size of the cached prefixes
+     */
+    PreviewCache::PreviewCache(size_t max_bytes)
+        : m_max_bytes(max_bytes)
+    {
+    }
+
+    /**
+     * @brief Stores a prefix, evicting the least recently used ones to make room
+     *
+     * @param url Preview URL
+     * @param data Leading bytes of the preview
+     */
+    void PreviewCache::put(const std::string& url, std::string data)
+    {
+        if (data.size() > m_max_bytes)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto existing = m_index.find(url);
+        if (existing != m_index.end())
+        {
+            m_bytes -= existing->second->data->size();
+            m_entries.erase(existing->second);
+            m_index.erase(existing);
+        }
+
+        while (m_bytes + data.size() > m_max_bytes && !m_entries.empty())
+        {
+            m_bytes -= m_entries.back().data->size();
+            m_index.erase(m_entries.back().url);
+            m_entries.pop_back();
+        }
+
+        m_bytes += data.size();
+        m_entries.push_front(Entry{url, std::make_shared<const std::string>(std::move(data))});
+        m_index[url] = m_entries.begin();
+    }
+
+    /**
+     * @brief Looks up a prefix and marks it as recently used
+     *
+     * @param url Preview URL
+     * @return std::shared_ptr<const std::string> Prefix, or nullptr if not cached
+     */
+    std::shared_ptr<const std::string> PreviewCache::get(const std::string& url)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(url);
+        if (found == m_index.end())
+        {
+            return nullptr;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return found->second->data;
+    }
+
+    /**
+     * @brief Returns true if a prefix is cached, without touching its recency
+     */
+    bool PreviewCache::contains(const std::string& url) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_index.count(url) > 0;
+    }
+
+    /**
+     * @brief Returns the total size of the cached prefixes
+     */
+    size_t PreviewCache::bytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes;
+    }
+
+    /**
+     * @brief Starts the prefetch thread
+     *
+     * @param policy Prefix size and cache budget
+     */
+    PreviewPrefetcher::PreviewPrefetcher(const PrefetchPolicy& policy)
+        : m_prefix_bytes(std::max<size_t>(policy.prefix_bytes, 1)),
+          m_cache(policy.cache_bytes)
+    {
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    /**
+     * @brief Cancels outstanding prefetches and stops the thread
+     */
+    PreviewPrefetcher::~PreviewPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_queue.clear();
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    /**
+     * @brief Replaces the queue with previews that are not cached yet
+     *
+     * @param urls Preview URLs, most likely audition first
+     */
+    void PreviewPrefetcher::prefetch(const std::vector<std::string>& urls)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.clear();
+            for (const auto& url : urls)
+            {
+                if (!url.empty() && !m_cache.contains(url))
+                {
+                    m_queue.push_back(url);
+                }
+            }
+        }
+        m_changed.notify_all();
+    }
+
+    /**
+     * @brief Marks foreground traffic until the returned handle is released
+     *
+     * The handle holds the prefetcher weakly, so it may be released after
+     * the prefetcher is gone (e.g. by a stream that outlives a disabled or
+     * replaced prefetcher).
+     *
+     * @return std::shared_ptr<void> Handle; prefetching resumes once every handle is gone.
+     *         Releasing it after the prefetcher is destroyed does nothing.
+     */
+    std::shared_ptr<void> PreviewPrefetcher::foreground()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_foreground.fetch_add(1);
+        }
+        return std::shared_ptr<void>(nullptr, [self = weak_from_this()](void*) {
+            const auto prefetcher = self.lock();
+            if (!prefetcher)
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(prefetcher->m_mutex);
+                prefetcher->m_foreground.fetch_sub(1);
+            }
+            prefetcher->m_changed.notify_all();
+        });
+    }
+
+    /**
+     * @brief Waits until the queue is empty and no prefetch is running
+     *
+     * @param timeout Longest time to wait
+     * @return bool False if prefetches were still outstanding at the timeout
+     */
+    bool PreviewPrefetcher::waitIdle(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_changed.wait_for(lock, timeout, [this]() { return m_queue.empty() && !m_busy; });
+    }
+
+    /**
+     * @brief Body of the prefetch thread
+     */
+    void PreviewPrefetcher::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait(lock, [this]() {
+                return m_stopping || (!m_queue.empty() && m_foreground.load() == 0);
+            });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            const std::string url = m_queue.front();
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+
+            const bool finished = m_cache.contains(url) || fetchPrefix(url);
+
+            lock.lock();
+            m_busy = false;
+            if (!finished && !m_stopping)
+            {
+                // Pre-empted: try again once the foreground traffic is over
+                m_queue.push_front(url);
+            }
+            m_changed.notify_all();
+        }
+    }
+
+    /**
+     * @brief Fetches the first prefix_bytes of a preview into the cache
+     *
+     * @param url Preview URL
+     * @return bool False if the fetch was pre-empted and should be retried
+     */
+    bool PreviewPrefetcher::fetchPrefix(const std::string& url)
+    {
+        std::string data;
+        data.reserve(m_prefix_bytes);
+
+        // Header blocks repeat for every redirect; only the last one describes the body
+        long status = 0;
+        auto on_header = [&](std::string_view line, intptr_t)
+        {
+            if (line.rfind("HTTP/", 0) == 0)
+            {
+                const size_t space = line.find(' ');
+                status = space == std::string_view::npos
+                    ? 0 : std::strtol(std::string(line.substr(space + 1, 3)).c_str(), nullptr, 10);
+            }
+            return true;
+        };
+
+        // A server that ignores the range sends the whole file: stop once the prefix is in
+        auto on_body = [&](std::string_view chunk, intptr_t)
+        {
+            if (status != 200 && status != 206)
+            {
+                return true;
+            }
+            data.append(chunk.data(), std::min(chunk.size(), m_prefix_bytes - data.size()));
+            return data.size() < m_prefix_bytes;
+        };
+
+        auto on_progress = [this](cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, intptr_t)
+        {
+            return m_foreground.load(std::memory_order_relaxed) == 0 && !m_stopping.load(std::memory_order_relaxed);
+        };
+
+        auto response = cpr::Get(
+            cpr::Url{url},
+            cpr::Header{{"Range", "bytes=0-" + std::to_string(m_prefix_bytes - 1)}},
+            cpr::HeaderCallback{on_header},
+            cpr::WriteCallback{on_body},
+            cpr::ProgressCallback{on_progress}
+        );
+
+        const bool ok = (status == 200 || status == 206) && !data.empty()
+            && (data.size() == m_prefix_bytes || !response.error);
+        if (ok)
+        {
+            m_cache.put(url, std::move(data));
+            return true;
+        }
+
+        if (m_foreground.load() > 0 && !m_stopping.load())
+        {
+            m_preemptions.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+}
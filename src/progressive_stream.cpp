@@ -0,0 +1,394 @@
+/**
+ * @file src/progressive_stream.cpp
+ * @brief Implementation of the progressive ring-buffered stream
+ *
+ * @see include/progressive_stream.h
+ */
+
+#include "progressive_stream.h"
+#include <cpr/cpr.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Bounds of the producer's back-off while the ring is full
+        constexpr std::chrono::microseconds SPACE_POLL_MIN{50};
+        constexpr std::chrono::microseconds SPACE_POLL_MAX{2000};
+
+        size_t roundUpToPowerOfTwo(size_t value)
+        {
+            size_t result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        bool startsWithIgnoreCase(std::string_view text, std::string_view prefix)
+        {
+            if (text.size() < prefix.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < prefix.size(); ++i)
+            {
+                if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    /**
+     * @brief Starts streaming a URL
+     *
+     * @param url Address of the file (e.g. a sound's preview-hq-mp3)
+     * @param options Ring buffer and transfer settings
+     */
+    ProgressiveStream::ProgressiveStream(std::string url, const ProgressiveStreamOptions& options)
+        : m_url(std::move(url)),
+          m_connect_timeout(options.connect_timeout),
+          m_started(Clock::now()),
+          m_capacity(roundUpToPowerOfTwo(std::max<size_t>(
+              {options.capacity, options.prefix ? options.prefix->size() : 0, 1})))
+    {
+        m_ring.reset(new uint8_t[m_capacity]);
+
+        // A known prefix is playable before the first network round trip
+        if (options.prefix && !options.prefix->empty())
+        {
+            m_prefix_size = options.prefix->size();
+            std::memcpy(m_ring.get(), options.prefix->data(), options.prefix->size());
+            m_write_position.store(m_prefix_size, std::memory_order_release);
+            m_first_byte_us.store(1, std::memory_order_relaxed);
+        }
+
+        m_thread = std::thread([this, guard = options.transfer_guard]() { transfer(guard); });
+    }
+
+    /**
+     * @brief Cancels the transfer and waits for its thread
+     */
+    ProgressiveStream::~ProgressiveStream()
+    {
+        cancel();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    /**
+     * @brief Copies out whatever is buffered, without waiting
+     *
+     * @param dest Destination of the bytes
+     * @param size Maximum number of bytes to copy
+     * @return size_t Number of bytes copied
+     */
+    size_t ProgressiveStream::tryRead(void* dest, size_t size)
+    {
+        const size_t copied = consume(static_cast<uint8_t*>(dest), size);
+        if (copied < size && !complete() && !failed())
+        {
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        return copied;
+    }
+
+    /**
+     * @brief Copies out size bytes, waiting for the network as needed
+     *
+     * @param dest Destination of the bytes
+     * @param size Number of bytes to copy
+     * @return size_t Number of bytes copied
+     */
+    size_t ProgressiveStream::read(void* dest, size_t size)
+    {
+        uint8_t* bytes = static_cast<uint8_t*>(dest);
+        size_t copied = 0;
+        while (copied < size)
+        {
+            copied += consume(bytes + copied, size - copied);
+            if (copied == size || !waitForData(1, std::chrono::milliseconds::max()))
+            {
+                break;
+            }
+            if (available() == 0)
+            {
+                // The transfer ended with nothing left to read
+                break;
+            }
+        }
+        return copied;
+    }
+
+    /**
+     * @brief Waits until a number of bytes is buffered or the transfer ends
+     *
+     * @param bytes Bytes that should be buffered (capped at the capacity)
+     * @param timeout Longest time to wait
+     * @return bool True if the bytes are buffered or the transfer has ended
+     */
+    bool ProgressiveStream::waitForData(size_t bytes, std::chrono::milliseconds timeout)
+    {
+        bytes = std::min(bytes, m_capacity);
+        auto ready = [this, bytes]() { return available() >= bytes || complete() || failed(); };
+        if (ready())
+        {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wait_mutex);
+        m_consumer_waiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool result = true;
+        if (timeout == std::chrono::milliseconds::max())
+        {
+            m_data_available.wait(lock, ready);
+        }
+        else
+        {
+            result = m_data_available.wait_for(lock, timeout, ready);
+        }
+        m_consumer_waiting.fetch_sub(1);
+        return result;
+    }
+
+    /**
+     * @brief Returns the number of bytes that can be read without waiting
+     */
+    size_t ProgressiveStream::available() const
+    {
+        return static_cast<size_t>(m_write_position.load(std::memory_order_acquire)
+            - m_read_position.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Stops the transfer; bytes already buffered remain readable
+     */
+    void ProgressiveStream::cancel()
+    {
+        m_cancelled.store(true);
+    }
+
+    /**
+     * @brief Returns the current fill level and transfer statistics
+     */
+    ProgressiveStreamStats ProgressiveStream::stats() const
+    {
+        ProgressiveStreamStats stats;
+        stats.capacity = m_capacity;
+        stats.bytes_read = m_read_position.load(std::memory_order_acquire);
+        stats.bytes_received = m_write_position.load(std::memory_order_acquire);
+        stats.fill = static_cast<size_t>(stats.bytes_received - std::min(stats.bytes_read, stats.bytes_received));
+        stats.underruns = m_underruns.load(std::memory_order_relaxed);
+        stats.producer_stalls = m_producer_stalls.load(std::memory_order_relaxed);
+
+        const uint64_t length = m_content_length.load(std::memory_order_relaxed);
+        if (length != UNKNOWN_LENGTH)
+        {
+            stats.content_length = length;
+        }
+        const int64_t first_byte = m_first_byte_us.load(std::memory_order_relaxed);
+        if (first_byte > 0)
+        {
+            stats.time_to_first_byte = std::chrono::microseconds(first_byte - 1);
+        }
+        return stats;
+    }
+
+    /**
+     * @brief Body of the transfer thread
+     *
+     * @param guard Released once the transfer has ended
+     */
+    void ProgressiveStream::transfer(std::shared_ptr<void> guard)
+    {
+        // Header blocks repeat for every redirect; only the last one describes the body
+        long status = 0;
+        uint64_t skip = 0;
+        auto on_header = [&](std::string_view line, intptr_t)
+        {
+            if (line.rfind("HTTP/", 0) == 0)
+            {
+                const size_t space = line.find(' ');
+                status = space == std::string_view::npos
+                    ? 0 : std::strtol(std::string(line.substr(space + 1, 3)).c_str(), nullptr, 10);
+                m_content_length.store(UNKNOWN_LENGTH, std::memory_order_relaxed);
+            }
+            else if (line.size() > 15 && startsWithIgnoreCase(line, "content-length:"))
+            {
+                // A partial response carries only what follows the prefix
+                const uint64_t length = std::strtoull(std::string(line.substr(15)).c_str(), nullptr, 10);
+                m_content_length.store(status == 206 ? m_prefix_size + length : length,
+                    std::memory_order_relaxed);
+            }
+            else if ((line == "\r\n" || line == "\n") && status == 200)
+            {
+                // The server ignored the range and sends the whole file
+                skip = m_prefix_size;
+            }
+            return true;
+        };
+
+        auto on_body = [&](std::string_view data, intptr_t)
+        {
+            if (status != 200 && status != 206)
+            {
+                return true;
+            }
+            const size_t skipped = static_cast<size_t>(std::min<uint64_t>(skip, data.size()));
+            skip -= skipped;
+            return produce(data.data() + skipped, data.size() - skipped);
+        };
+
+        // Lets cancel() abort a transfer that is waiting on the network
+        auto on_progress = [this](cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, intptr_t)
+        {
+            return !m_cancelled.load(std::memory_order_relaxed);
+        };
+
+        cpr::Header header;
+        if (m_prefix_size > 0)
+        {
+            header["Range"] = "bytes=" + std::to_string(m_prefix_size) + "-";
+        }
+
+        auto response = cpr::Get(
+            cpr::Url{m_url},
+            header,
+            cpr::ConnectTimeout{m_connect_timeout},
+            cpr::HeaderCallback{on_header},
+            cpr::WriteCallback{on_body},
+            cpr::ProgressCallback{on_progress}
+        );
+
+        // 416 means the range starts at the end: the prefix was the whole file
+        const bool ok = !response.error && !m_cancelled.load() && (response.status_code == 200
+            || response.status_code == 206 || (m_prefix_size > 0 && response.status_code == 416));
+        if (ok && response.status_code == 416)
+        {
+            m_content_length.store(m_prefix_size, std::memory_order_relaxed);
+        }
+        guard.reset();
+        finishTransfer(ok);
+    }
+
+    /**
+     * @brief Appends received bytes, waiting while the ring is full
+     *
+     * The consumer never signals freed space, so that reading stays free of
+     * locks and system calls; instead a full ring is polled with a sleep
+     * that doubles up to SPACE_POLL_MAX.
+     *
+     * @param data Received bytes
+     * @param size Number of bytes at data
+     * @return bool False if the stream was cancelled
+     */
+    bool ProgressiveStream::produce(const char* data, size_t size)
+    {
+        if (size > 0 && m_first_byte_us.load(std::memory_order_relaxed) == 0)
+        {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_started);
+            m_first_byte_us.store(elapsed.count() + 1, std::memory_order_relaxed);
+        }
+
+        const size_t mask = m_capacity - 1;
+        auto backoff = SPACE_POLL_MIN;
+        while (size > 0)
+        {
+            if (m_cancelled.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+
+            const uint64_t write = m_write_position.load(std::memory_order_relaxed);
+            const size_t space = m_capacity
+                - static_cast<size_t>(write - m_read_position.load(std::memory_order_acquire));
+            if (space == 0)
+            {
+                if (backoff == SPACE_POLL_MIN)
+                {
+                    m_producer_stalls.fetch_add(1, std::memory_order_relaxed);
+                }
+                std::this_thread::sleep_for(backoff);
+                backoff = std::min(backoff * 2, SPACE_POLL_MAX);
+                continue;
+            }
+            backoff = SPACE_POLL_MIN;
+
+            // Copy up to the end of the ring, then wrap around
+            const size_t chunk = std::min(size, space);
+            const size_t offset = static_cast<size_t>(write) & mask;
+            const size_t first = std::min(chunk, m_capacity - offset);
+            std::memcpy(m_ring.get() + offset, data, first);
+            std::memcpy(m_ring.get(), data + first, chunk - first);
+            m_write_position.store(write + chunk, std::memory_order_release);
+            wakeConsumer();
+
+            data += chunk;
+            size -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copies buffered bytes out of the ring
+     *
+     * Takes no lock and makes no system call; a paused transfer notices the
+     * freed space on its next poll.
+     *
+     * @param dest Destination of the bytes
+     * @param size Maximum number of bytes to copy
+     * @return size_t Number of bytes copied
+     */
+    size_t ProgressiveStream::consume(uint8_t* dest, size_t size)
+    {
+        const uint64_t read = m_read_position.load(std::memory_order_relaxed);
+        const size_t buffered = static_cast<size_t>(m_write_position.load(std::memory_order_acquire) - read);
+        const size_t chunk = std::min(size, buffered);
+        if (chunk == 0)
+        {
+            return 0;
+        }
+
+        const size_t offset = static_cast<size_t>(read) & (m_capacity - 1);
+        const size_t first = std::min(chunk, m_capacity - offset);
+        std::memcpy(dest, m_ring.get() + offset, first);
+        std::memcpy(dest + first, m_ring.get(), chunk - first);
+        m_read_position.store(read + chunk, std::memory_order_release);
+        return chunk;
+    }
+
+    /**
+     * @brief Records the outcome of the transfer and wakes the consumer
+     *
+     * @param ok True if the whole body was received
+     */
+    void ProgressiveStream::finishTransfer(bool ok)
+    {
+        (ok ? m_complete : m_failed).store(true, std::memory_order_release);
+        wakeConsumer();
+    }
+
+    void ProgressiveStream::wakeConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumer_waiting.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_wait_mutex);
+            }
+            m_data_available.notify_all();
+        }
+    }
+}
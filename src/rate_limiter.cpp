@@ -0,0 +1,58 @@
+/**
+ * @file src/rate_limiter.cpp
+ * @brief Implementation of the RateLimiter class
+ *
+ * @see include/rate_limiter.h
+ */
+
+#include "rate_limiter.h"
+#include <stdexcept>
+#include <thread>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Constructs a limiter for the given request budget
+     *
+     * @param requests_per_minute Maximum sustained request rate
+     * @param burst Number of requests that may be issued back-to-back
+     * @throws std::invalid_argument If requests_per_minute or burst is not positive
+     */
+    RateLimiter::RateLimiter(int requests_per_minute, int burst)
+    {
+        if (requests_per_minute <= 0 || burst <= 0)
+        {
+            throw std::invalid_argument(
+                "RateLimiter requires a positive request rate and burst size."
+            );
+        }
+
+        m_interval = std::chrono::nanoseconds(std::chrono::minutes(1)) / requests_per_minute;
+        m_burst_window = m_interval * (burst - 1);
+        m_next_slot = Clock::now();
+    }
+
+    /**
+     * @brief Blocks until the caller may issue one request
+     *
+     * Slots are handed out in call order. Unused slots accumulate only up to
+     * the burst window, so a long idle period does not allow a flood of
+     * requests afterwards.
+     */
+    void RateLimiter::acquire()
+    {
+        Clock::time_point slot;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto now = Clock::now();
+            if (m_next_slot < now - m_burst_window)
+            {
+                m_next_slot = now - m_burst_window;
+            }
+            slot = m_next_slot;
+            m_next_slot += m_interval;
+        }
+
+        std::this_thread::sleep_until(slot);
+    }
+}
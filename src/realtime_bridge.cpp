@@ -0,0 +1,255 @@
+/**
+ * @file src/realtime_bridge.cpp
+ * @brief Implementation of the real-time-safe request bridge
+ *
+ * @see include/realtime_bridge.h
+ */
+
+#include "realtime_bridge.h"
+#include "freesound_downloader.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Starts the background workers
+     *
+     * @param downloader Downloader performing the requests; must outlive the bridge
+     * @param options Worker count and queue sizes
+     * @param notifier Optional hook used to schedule dispatch() on the message thread
+     * @throws std::invalid_argument If workers or max_ready is zero
+     */
+    RealtimeBridge::RealtimeBridge(Downloader& downloader, const RealtimeBridgeOptions& options,
+        Notifier notifier)
+        : m_downloader(downloader),
+          m_notifier(std::move(notifier)),
+          m_ready(std::max<size_t>(options.max_ready, 1)),
+          m_released(std::max<size_t>(options.max_ready, 1))
+    {
+        if (options.workers == 0 || options.max_ready == 0)
+        {
+            throw std::invalid_argument("RealtimeBridge needs at least one worker and one ready slot");
+        }
+
+        // Every slot can be released at once, so the return queue never overflows
+        m_slots.resize(options.max_ready);
+        for (size_t i = options.max_ready; i > 0; --i)
+        {
+            m_free_slots.push_back(static_cast<uint32_t>(i - 1));
+        }
+
+        for (unsigned i = 0; i < options.workers; ++i)
+        {
+            m_workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    /**
+     * @brief Stops the workers after their current request
+     */
+    RealtimeBridge::~RealtimeBridge()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_job_mutex);
+            m_stopping = true;
+            m_jobs.clear();
+        }
+        m_job_ready.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Queues a download into memory (message thread)
+     *
+     * @param sound_id Unique identifier of the sound to download
+     * @return uint64_t Request identifier reported with the result
+     */
+    uint64_t RealtimeBridge::requestDownload(int sound_id)
+    {
+        const uint64_t request = m_next_request++;
+        submit([this, request, sound_id]() {
+            Finished finished;
+            finished.completion.request = request;
+            finished.completion.kind = BridgeCompletion::Kind::Download;
+            finished.completion.sound_id = sound_id;
+
+            if (auto buffer = m_downloader.downloadToMemory(sound_id))
+            {
+                finished.completion.ok = true;
+                finished.completion.size = buffer->size();
+                finished.buffer = std::move(*buffer);
+            }
+            return finished;
+        });
+        return request;
+    }
+
+    /**
+     * @brief Queues a text search (message thread)
+     *
+     * @param query Text-based search term
+     * @param page_size Number of results
+     * @return uint64_t Request identifier reported with the result
+     */
+    uint64_t RealtimeBridge::requestSearch(const std::string& query, int page_size)
+    {
+        const uint64_t request = m_next_request++;
+        submit([this, request, query, page_size]() {
+            Finished finished;
+            finished.completion.request = request;
+            finished.completion.kind = BridgeCompletion::Kind::Search;
+
+            if (auto results = m_downloader.searchSounds(query, 1, page_size))
+            {
+                finished.completion.ok = true;
+                finished.completion.results = std::move(*results);
+            }
+            return finished;
+        });
+        return request;
+    }
+
+    /**
+     * @brief Reports finished requests and feeds the audio thread (message thread)
+     *
+     * @param handler Called for each completion; may be empty
+     * @return size_t Number of completions reported
+     */
+    size_t RealtimeBridge::dispatch(const CompletionHandler& handler)
+    {
+        // Free what the audio thread is done with before lending out more
+        uint32_t slot = 0;
+        while (m_released.tryPop(slot))
+        {
+            m_slots[slot] = PooledBuffer();
+            m_free_slots.push_back(slot);
+        }
+
+        while (!m_undelivered.empty() && deliver(m_undelivered.front()))
+        {
+            m_undelivered.pop_front();
+        }
+
+        std::deque<Finished> finished;
+        {
+            std::lock_guard<std::mutex> lock(m_finished_mutex);
+            finished.swap(m_finished);
+        }
+
+        for (auto& result : finished)
+        {
+            if (handler)
+            {
+                handler(result.completion);
+            }
+            if (result.completion.kind == BridgeCompletion::Kind::Download && result.completion.ok
+                && (!m_undelivered.empty() || !deliver(result)))
+            {
+                m_undelivered.push_back(std::move(result));
+            }
+        }
+        return finished.size();
+    }
+
+    /**
+     * @brief Takes the next downloaded sound (audio thread, wait-free)
+     *
+     * @param sound Receives the sound
+     * @return bool False if no sound is ready
+     */
+    bool RealtimeBridge::pollReady(ReadySound& sound)
+    {
+        return m_ready.tryPop(sound);
+    }
+
+    /**
+     * @brief Returns a sound's memory for freeing on the message thread (audio thread, wait-free)
+     *
+     * @param sound Sound obtained from pollReady()
+     */
+    void RealtimeBridge::release(const ReadySound& sound)
+    {
+        // Sized for every slot, so this push cannot fail
+        m_released.tryPush(uint32_t(sound.slot));
+    }
+
+    /**
+     * @brief Hands a job to the workers
+     *
+     * @param job Request to run; returns its result
+     */
+    void RealtimeBridge::submit(std::function<Finished()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_job_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_job_ready.notify_one();
+    }
+
+    /**
+     * @brief Body of each worker thread
+     */
+    void RealtimeBridge::workerLoop()
+    {
+        while (true)
+        {
+            std::function<Finished()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_job_mutex);
+                m_job_ready.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            Finished finished = job();
+            {
+                std::lock_guard<std::mutex> lock(m_finished_mutex);
+                m_finished.push_back(std::move(finished));
+            }
+            if (m_notifier)
+            {
+                m_notifier();
+            }
+        }
+    }
+
+    /**
+     * @brief Lends a downloaded buffer to the audio thread (message thread)
+     *
+     * @param finished Successful download; its buffer is moved into a slot
+     * @return bool False if no slot is free yet
+     */
+    bool RealtimeBridge::deliver(Finished& finished)
+    {
+        if (m_free_slots.empty())
+        {
+            return false;
+        }
+
+        const uint32_t slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        m_slots[slot] = std::move(finished.buffer);
+
+        ReadySound sound;
+        sound.request = finished.completion.request;
+        sound.sound_id = finished.completion.sound_id;
+        sound.data = m_slots[slot].data();
+        sound.size = m_slots[slot].size();
+        sound.slot = slot;
+
+        // One queue entry per slot, so the push cannot fail
+        m_ready.tryPush(std::move(sound));
+        return true;
+    }
+}
@@ -0,0 +1,355 @@
+/**
+ * @file src/resampler.cpp
+ * @brief Implementation of the streaming polyphase sample-rate converter
+ *
+ * @see include/resampler.h
+ */
+
+#include "resampler.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Table entries per zero crossing when the kernel is interpolated instead of banked
+        constexpr int TABLE_RESOLUTION = 512;
+
+        /// Ratios with more phases, or banks with more weights, use the interpolated table
+        constexpr uint32_t MAX_PHASES = 4096;
+        constexpr size_t MAX_BANK_WEIGHTS = size_t(1) << 20;
+
+        /// Distinct filters kept for reuse by later resamplers
+        constexpr size_t MAX_CACHED_FILTERS = 32;
+
+        constexpr double PI = 3.14159265358979323846;
+
+        /**
+         * @brief Kernel shape of a quality preset
+         */
+        struct Design
+        {
+            /// Zero crossings of the sinc on each side of the kernel's centre
+            int zero_crossings;
+
+            /// Share of the lower Nyquist frequency that is passed; the rest is the transition band
+            double passband;
+
+            /// Kaiser window shape; larger values trade transition width for stopband attenuation
+            double beta;
+        };
+
+        Design designOf(ResamplerQuality quality)
+        {
+            switch (quality)
+            {
+            case ResamplerQuality::Fast:
+                return {8, 0.90, 6.0};
+            case ResamplerQuality::Balanced:
+                return {16, 0.95, 8.6};
+            case ResamplerQuality::Best:
+                return {48, 0.97, 12.0};
+            }
+            return {16, 0.95, 8.6};
+        }
+
+        /// Zeroth-order modified Bessel function of the first kind
+        double besselI0(double x)
+        {
+            double sum = 1.0;
+            double term = 1.0;
+            for (int k = 1; k < 64 && term > sum * 1e-17; ++k)
+            {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        /// Windowed sinc at a distance in zero crossings (not yet scaled by the cutoff)
+        double prototype(double x, const Design& design)
+        {
+            x = std::abs(x);
+            if (x >= design.zero_crossings)
+            {
+                return 0.0;
+            }
+            const double t = x / design.zero_crossings;
+            const double window = besselI0(design.beta * std::sqrt(1.0 - t * t)) / besselI0(design.beta);
+            const double sinc = x == 0.0 ? 1.0 : std::sin(PI * x) / (PI * x);
+            return sinc * window;
+        }
+    }
+
+    /**
+     * @struct Resampler::Filter
+     * @brief Kernel of one ratio and quality, as a polyphase bank or an oversampled table
+     */
+    struct Resampler::Filter
+    {
+        /// Cutoff relative to the input Nyquist frequency
+        double cutoff = 1.0;
+
+        /// Input frames on each side of an output position that contribute to it
+        int64_t half_width = 0;
+
+        /// Weights per output frame
+        size_t taps = 0;
+
+        /// phases rows of taps weights, each summing to one; empty when table is used
+        std::vector<float> bank;
+
+        /// Kernel sampled TABLE_RESOLUTION times per zero crossing
+        std::vector<float> table;
+    };
+
+    /**
+     * @brief Returns the filter of a reduced ratio, building it on first use
+     *
+     * @param quality Preset the filter is designed for
+     * @param phases Output frames per cycle of the ratio (L)
+     * @param step Input frames per cycle of the ratio (M)
+     */
+    std::shared_ptr<const Resampler::Filter> Resampler::filterFor(ResamplerQuality quality, uint32_t phases, uint32_t step)
+    {
+        static std::mutex mutex;
+        static std::map<std::tuple<ResamplerQuality, uint32_t, uint32_t>, std::shared_ptr<const Filter>> cache;
+
+        const auto key = std::make_tuple(quality, phases, step);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = cache.find(key);
+            if (found != cache.end())
+            {
+                return found->second;
+            }
+        }
+
+        const Design design = designOf(quality);
+        auto filter = std::make_shared<Filter>();
+        filter->cutoff = design.passband * std::min(1.0, static_cast<double>(phases) / step);
+        filter->half_width = static_cast<int64_t>(std::ceil(design.zero_crossings / filter->cutoff));
+        filter->taps = static_cast<size_t>(2 * filter->half_width);
+
+        if (phases <= MAX_PHASES && phases * filter->taps <= MAX_BANK_WEIGHTS)
+        {
+            // Row p holds the weights of an output frame p/phases of an input frame past its centre
+            filter->bank.resize(phases * filter->taps);
+            for (uint32_t phase = 0; phase < phases; ++phase)
+            {
+                float* row = filter->bank.data() + phase * filter->taps;
+                const double fraction = static_cast<double>(phase) / phases;
+                double sum = 0.0;
+                for (size_t tap = 0; tap < filter->taps; ++tap)
+                {
+                    const double distance = fraction + static_cast<double>(filter->half_width - 1) - static_cast<double>(tap);
+                    const double weight = prototype(distance * filter->cutoff, design);
+                    row[tap] = static_cast<float>(weight);
+                    sum += weight;
+                }
+                // Unit gain at DC for every phase, so a constant stays constant
+                for (size_t tap = 0; tap < filter->taps; ++tap)
+                {
+                    row[tap] = static_cast<float>(row[tap] / sum);
+                }
+            }
+        }
+        else
+        {
+            filter->table.resize(static_cast<size_t>(design.zero_crossings) * TABLE_RESOLUTION + 2);
+            for (size_t i = 0; i < filter->table.size(); ++i)
+            {
+                filter->table[i] = static_cast<float>(prototype(static_cast<double>(i) / TABLE_RESOLUTION, design));
+            }
+            filter->table.back() = 0.0f;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cache.size() >= MAX_CACHED_FILTERS)
+        {
+            cache.clear();
+        }
+        // A concurrent builder may have won; both filters are identical
+        return cache.emplace(key, std::move(filter)).first->second;
+    }
+
+    /**
+     * @brief Prepares a converter
+     *
+     * @param channels Interleaved channels per frame
+     * @param input_rate Rate of the samples passed to process()
+     * @param output_rate Rate of the samples produced
+     * @param quality Filter length and passband
+     * @throws std::invalid_argument If any argument is zero
+     */
+    Resampler::Resampler(unsigned channels, uint32_t input_rate, uint32_t output_rate, ResamplerQuality quality)
+        : m_channels(channels), m_input_rate(input_rate), m_output_rate(output_rate)
+    {
+        if (channels == 0 || input_rate == 0 || output_rate == 0)
+        {
+            throw std::invalid_argument("Resampler needs a channel count and two non-zero rates");
+        }
+        if (input_rate == output_rate)
+        {
+            return;
+        }
+
+        const uint32_t divisor = std::gcd(input_rate, output_rate);
+        m_phases = output_rate / divisor;
+        m_step = input_rate / divisor;
+        m_filter = filterFor(quality, m_phases, m_step);
+
+        // Silence before the first frame keeps the kernel's left half defined
+        m_history.assign(channels, std::vector<float>(static_cast<size_t>(m_filter->half_width), 0.0f));
+        m_history_start = -m_filter->half_width;
+        if (m_filter->bank.empty())
+        {
+            m_weights.resize(m_filter->taps);
+        }
+    }
+
+    /**
+     * @brief Returns whether a precomputed filter bank serves this ratio
+     */
+    bool Resampler::polyphase() const
+    {
+        return m_filter && !m_filter->bank.empty();
+    }
+
+    /**
+     * @brief Converts the next block of frames
+     *
+     * @param input Interleaved frames following those passed before
+     * @param frames Number of frames at input
+     * @param output Receives the converted frames (appended)
+     */
+    void Resampler::process(const float* input, size_t frames, std::vector<float>& output)
+    {
+        m_input_frames += frames;
+        if (m_input_rate == m_output_rate)
+        {
+            output.insert(output.end(), input, input + frames * m_channels);
+            m_output_frames += frames;
+            return;
+        }
+
+        // Channels are kept apart so each output sample is one contiguous dot product
+        for (unsigned channel = 0; channel < m_channels; ++channel)
+        {
+            std::vector<float>& history = m_history[channel];
+            const size_t first = history.size();
+            history.resize(first + frames);
+            for (size_t i = 0; i < frames; ++i)
+            {
+                history[first + i] = input[i * m_channels + channel];
+            }
+        }
+        produce(output, std::numeric_limits<uint64_t>::max());
+    }
+
+    /**
+     * @brief Produces the frames still held back once the input has ended
+     *
+     * @param output Receives the converted frames (appended)
+     */
+    void Resampler::flush(std::vector<float>& output)
+    {
+        if (m_input_rate == m_output_rate)
+        {
+            return;
+        }
+
+        // The output spans exactly the input's duration
+        const uint64_t total = (m_input_frames * m_phases + m_step - 1) / m_step;
+        for (auto& history : m_history)
+        {
+            history.resize(history.size() + static_cast<size_t>(2 * m_filter->half_width + 1), 0.0f);
+        }
+        produce(output, total);
+    }
+
+    /**
+     * @brief Computes output frames while their input is buffered
+     *
+     * @param output Receives the frames (appended)
+     * @param limit Total number of output frames not to exceed
+     */
+    void Resampler::produce(std::vector<float>& output, uint64_t limit)
+    {
+        const int64_t half_width = m_filter->half_width;
+        const int64_t buffered_end = m_history_start + static_cast<int64_t>(m_history[0].size());
+        const uint64_t available = static_cast<uint64_t>(std::max<int64_t>(0, buffered_end - m_centre)) * m_phases / m_step + 1;
+        output.reserve(output.size() + static_cast<size_t>(std::min(available, limit - m_output_frames)) * m_channels);
+        while (m_output_frames < limit && m_centre + half_width < buffered_end)
+        {
+            const float* weights = weightsFor(m_phase);
+            const size_t first = static_cast<size_t>(m_centre - half_width + 1 - m_history_start);
+            for (unsigned channel = 0; channel < m_channels; ++channel)
+            {
+                output.push_back(dotProduct(weights, m_history[channel].data() + first, m_filter->taps));
+            }
+
+            ++m_output_frames;
+            const uint64_t advanced = static_cast<uint64_t>(m_phase) + m_step;
+            m_centre += static_cast<int64_t>(advanced / m_phases);
+            m_phase = static_cast<uint32_t>(advanced % m_phases);
+        }
+
+        // Forget input no future output frame reaches back to, in large steps
+        const int64_t needed = m_centre - half_width + 1;
+        const int64_t stale = needed - m_history_start;
+        if (stale > 4096)
+        {
+            for (auto& history : m_history)
+            {
+                history.erase(history.begin(), history.begin() + static_cast<std::ptrdiff_t>(stale));
+            }
+            m_history_start = needed;
+        }
+    }
+
+    /**
+     * @brief Returns the weights of an output frame at a phase
+     *
+     * Reads the bank row, or interpolates the kernel from the table into
+     * m_weights for ratios without a bank.
+     */
+    const float* Resampler::weightsFor(uint32_t phase)
+    {
+        const Filter& filter = *m_filter;
+        if (!filter.bank.empty())
+        {
+            return filter.bank.data() + static_cast<size_t>(phase) * filter.taps;
+        }
+
+        const double fraction = static_cast<double>(phase) / m_phases;
+        float sum = 0.0f;
+        for (size_t tap = 0; tap < filter.taps; ++tap)
+        {
+            const double distance = fraction + static_cast<double>(filter.half_width - 1) - static_cast<double>(tap);
+            const double position = std::abs(distance) * filter.cutoff * TABLE_RESOLUTION;
+            const size_t index = static_cast<size_t>(position);
+            float weight = 0.0f;
+            if (index + 1 < filter.table.size())
+            {
+                const float blend = static_cast<float>(position - static_cast<double>(index));
+                weight = filter.table[index] + blend * (filter.table[index + 1] - filter.table[index]);
+            }
+            m_weights[tap] = weight;
+            sum += weight;
+        }
+        for (float& weight : m_weights)
+        {
+            weight /= sum;
+        }
+        return m_weights.data();
+    }
+}
@@ -0,0 +1,533 @@
+/**
+ * @file src/sample_archive.cpp
+ * @brief Implementation of the packed sample archive writer and reader
+ *
+ * @see include/sample_archive.h
+ */
+
+#include "sample_archive.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        const char FILE_MAGIC[8] = {'F', 'S', 'P', 'A', 'K', '0', '0', '1'};
+        const char ENTRY_MAGIC[4] = {'F', 'S', 'P', 'E'};
+        const char TRAILER_MAGIC[8] = {'F', 'S', 'P', 'A', 'K', 'E', 'N', 'D'};
+
+        constexpr uint64_t FILE_HEADER_SIZE = 64;
+        constexpr uint64_t ENTRY_HEADER_SIZE = 32;
+        constexpr uint64_t INDEX_RECORD_SIZE = 32;
+        constexpr uint64_t TRAILER_SIZE = 32;
+
+        /// Entry headers and the index start on 8-byte boundaries
+        constexpr uint64_t HEADER_ALIGNMENT = 8;
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        void writeZeros(std::ofstream& out, uint64_t count)
+        {
+            static const char zeros[4096] = {};
+            while (count > 0)
+            {
+                const uint64_t chunk = std::min<uint64_t>(count, sizeof(zeros));
+                out.write(zeros, static_cast<std::streamsize>(chunk));
+                count -= chunk;
+            }
+        }
+
+        template <typename T>
+        T load(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+    }
+
+    /**
+     * @brief Constructs a writer with the given data alignment
+     *
+     * @param alignment Alignment of each file's contents in bytes
+     * @throws std::invalid_argument If alignment is not a power of two of at least 8
+     */
+    SampleArchiveWriter::SampleArchiveWriter(size_t alignment)
+        : m_alignment(alignment)
+    {
+        if (alignment < HEADER_ALIGNMENT || (alignment & (alignment - 1)) != 0)
+        {
+            throw std::invalid_argument(
+                "Sample archive alignment must be a power of two of at least 8 bytes."
+            );
+        }
+    }
+
+    /**
+     * @brief Finishes the archive if it is still open
+     */
+    SampleArchiveWriter::~SampleArchiveWriter()
+    {
+        finish();
+    }
+
+    /**
+     * @brief Creates an archive, or reopens an existing one for appending
+     *
+     * An existing archive keeps the alignment recorded in its header.
+     *
+     * @param path Filesystem path of the archive
+     * @return bool True if the archive is ready for appending
+     */
+    bool SampleArchiveWriter::open(const std::string& path)
+    {
+        finish();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_index.clear();
+
+        std::error_code ec;
+        const uint64_t file_size = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+        if (ec)
+        {
+            return false;
+        }
+
+        m_path = path;
+        if (file_size == 0)
+        {
+            m_out.open(path, std::ios::binary | std::ios::trunc);
+            char header[FILE_HEADER_SIZE] = {};
+            const uint32_t alignment = static_cast<uint32_t>(m_alignment);
+            std::memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+            std::memcpy(header + 8, &alignment, sizeof(alignment));
+            m_out.write(header, sizeof(header));
+            m_position = FILE_HEADER_SIZE;
+            return static_cast<bool>(m_out);
+        }
+
+        if (file_size < FILE_HEADER_SIZE)
+        {
+            return false;
+        }
+
+        {
+            std::ifstream in(path, std::ios::binary);
+            uint8_t header[FILE_HEADER_SIZE];
+            if (!in.read(reinterpret_cast<char*>(header), FILE_HEADER_SIZE)
+                || std::memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+            {
+                return false;
+            }
+
+            const uint32_t alignment = load<uint32_t>(header + 8);
+            if (alignment < HEADER_ALIGNMENT || (alignment & (alignment - 1)) != 0)
+            {
+                return false;
+            }
+            m_alignment = alignment;
+
+            bool indexed = false;
+            if (file_size >= FILE_HEADER_SIZE + TRAILER_SIZE)
+            {
+                uint8_t trailer[TRAILER_SIZE];
+                in.seekg(static_cast<std::streamoff>(file_size - TRAILER_SIZE));
+                in.read(reinterpret_cast<char*>(trailer), TRAILER_SIZE);
+
+                const uint64_t index_offset = load<uint64_t>(trailer);
+                const uint64_t count = load<uint64_t>(trailer + 8);
+                indexed = in
+                    && std::memcmp(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) == 0
+                    && index_offset >= FILE_HEADER_SIZE
+                    && count <= (file_size - TRAILER_SIZE - index_offset) / INDEX_RECORD_SIZE
+                    && index_offset + count * INDEX_RECORD_SIZE + TRAILER_SIZE == file_size;
+
+                if (indexed)
+                {
+                    std::vector<uint8_t> records(static_cast<size_t>(count * INDEX_RECORD_SIZE));
+                    in.seekg(static_cast<std::streamoff>(index_offset));
+                    in.read(reinterpret_cast<char*>(records.data()),
+                        static_cast<std::streamsize>(records.size()));
+                    indexed = static_cast<bool>(in);
+
+                    for (uint64_t i = 0; indexed && i < count; ++i)
+                    {
+                        const uint8_t* record = records.data() + i * INDEX_RECORD_SIZE;
+                        m_index[static_cast<int>(load<int64_t>(record))] = {
+                            load<uint64_t>(record + 8),
+                            load<uint64_t>(record + 16),
+                            static_cast<AudioFormat>(record[24])
+                        };
+                    }
+                    m_position = index_offset;
+                }
+            }
+
+            if (!indexed && !recover(path, file_size))
+            {
+                return false;
+            }
+        }
+
+        // Strip the old index (or a torn tail); it is rewritten by finish()
+        fs::resize_file(path, m_position, ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        // Not opened for appending: entry headers are written in place once their data is complete
+        m_out.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        m_out.seekp(static_cast<std::streamoff>(m_position));
+        return m_out.is_open() && static_cast<bool>(m_out);
+    }
+
+    /**
+     * @brief Appends one sound
+     *
+     * @param sound_id Freesound sound ID
+     * @param data File contents
+     * @param size Number of bytes at data
+     * @return bool True if the entry was written
+     */
+    bool SampleArchiveWriter::append(int sound_id, const uint8_t* data, size_t size)
+    {
+        EntryWriter entry(*this, sound_id);
+        return entry.append(data, size) && entry.commit();
+    }
+
+    /**
+     * @brief Locks the archive and starts an entry at its end
+     *
+     * The space for the entry header is left zeroed, so recovery stops
+     * before an entry that was never committed.
+     *
+     * @param archive Open archive receiving the sound
+     * @param sound_id Freesound sound ID
+     */
+    SampleArchiveWriter::EntryWriter::EntryWriter(SampleArchiveWriter& archive, int sound_id)
+        : m_archive(archive), m_lock(archive.m_mutex), m_sound_id(sound_id)
+    {
+        if (!m_archive.m_out.is_open())
+        {
+            m_failed = true;
+            return;
+        }
+
+        const uint64_t header_offset = m_archive.m_position;
+        m_data_offset = alignUp(header_offset + ENTRY_HEADER_SIZE, m_archive.m_alignment);
+        writeZeros(m_archive.m_out, m_data_offset - header_offset);
+        m_failed = !m_archive.m_out;
+    }
+
+    /**
+     * @brief Discards the entry unless commit() succeeded and unlocks the archive
+     *
+     * The next entry, or finish(), overwrites the discarded bytes.
+     */
+    SampleArchiveWriter::EntryWriter::~EntryWriter()
+    {
+        if (!m_committed && m_archive.m_out.is_open())
+        {
+            m_archive.m_out.clear();
+            m_archive.m_out.seekp(static_cast<std::streamoff>(m_archive.m_position));
+        }
+    }
+
+    /**
+     * @brief Appends the next part of the contents
+     *
+     * @param data Bytes following those of the previous call
+     * @param size Number of bytes at data
+     * @return bool True if the bytes were written
+     */
+    bool SampleArchiveWriter::EntryWriter::append(const uint8_t* data, size_t size)
+    {
+        if (m_failed || m_committed)
+        {
+            return false;
+        }
+
+        // Keep the leading bytes for sniffing the format on commit
+        if (m_head.size() < AUDIO_SNIFF_BYTES)
+        {
+            const size_t head = std::min(size, AUDIO_SNIFF_BYTES - m_head.size());
+            m_head.insert(m_head.end(), data, data + head);
+        }
+
+        m_archive.m_out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        m_size += size;
+        m_failed = !m_archive.m_out;
+        return !m_failed;
+    }
+
+    /**
+     * @brief Writes the entry header and records the entry in the index
+     *
+     * @return bool True if the entry is complete
+     */
+    bool SampleArchiveWriter::EntryWriter::commit()
+    {
+        if (m_failed || m_committed)
+        {
+            return false;
+        }
+
+        std::ofstream& out = m_archive.m_out;
+        const uint64_t header_offset = m_archive.m_position;
+        const uint64_t end = alignUp(m_data_offset + m_size, HEADER_ALIGNMENT);
+        const AudioFormat format = sniffAudioFormat(m_head.data(), m_head.size());
+        writeZeros(out, end - m_data_offset - m_size);
+
+        char header[ENTRY_HEADER_SIZE] = {};
+        const int64_t id = m_sound_id;
+        std::memcpy(header, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        header[4] = static_cast<char>(format);
+        std::memcpy(header + 8, &id, sizeof(id));
+        std::memcpy(header + 16, &m_size, sizeof(m_size));
+
+        out.seekp(static_cast<std::streamoff>(header_offset));
+        out.write(header, sizeof(header));
+        out.seekp(static_cast<std::streamoff>(end));
+        if (!out)
+        {
+            m_failed = true;
+            return false;
+        }
+
+        m_archive.m_position = end;
+        m_archive.m_index[m_sound_id] = {m_data_offset, m_size, format};
+        m_committed = true;
+        return true;
+    }
+
+    /**
+     * @brief Reports whether a sound is already in the archive
+     *
+     * @param sound_id Freesound sound ID
+     * @return bool True if an entry exists for the ID
+     */
+    bool SampleArchiveWriter::contains(int sound_id) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_index.count(sound_id) != 0;
+    }
+
+    /**
+     * @brief Returns the number of distinct sounds in the archive
+     */
+    size_t SampleArchiveWriter::entryCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_index.size();
+    }
+
+    /**
+     * @brief Writes the trailing index and closes the archive
+     *
+     * @return bool True if the index and trailer were written
+     */
+    bool SampleArchiveWriter::finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_out.is_open())
+        {
+            return false;
+        }
+
+        std::vector<std::pair<int, IndexRecord>> sorted(m_index.begin(), m_index.end());
+        std::sort(sorted.begin(), sorted.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        for (const auto& [sound_id, record] : sorted)
+        {
+            char bytes[INDEX_RECORD_SIZE] = {};
+            const int64_t id = sound_id;
+            std::memcpy(bytes, &id, sizeof(id));
+            std::memcpy(bytes + 8, &record.offset, sizeof(record.offset));
+            std::memcpy(bytes + 16, &record.length, sizeof(record.length));
+            bytes[24] = static_cast<char>(record.format);
+            m_out.write(bytes, sizeof(bytes));
+        }
+
+        char trailer[TRAILER_SIZE] = {};
+        const uint64_t count = sorted.size();
+        const uint32_t alignment = static_cast<uint32_t>(m_alignment);
+        std::memcpy(trailer, &m_position, sizeof(m_position));
+        std::memcpy(trailer + 8, &count, sizeof(count));
+        std::memcpy(trailer + 16, &alignment, sizeof(alignment));
+        std::memcpy(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+        m_out.write(trailer, sizeof(trailer));
+
+        m_out.close();
+        bool ok = static_cast<bool>(m_out);
+        m_out.clear();
+        m_index.clear();
+
+        // Drop whatever a discarded entry left beyond the trailer
+        std::error_code ec;
+        const uint64_t size = m_position + count * INDEX_RECORD_SIZE + TRAILER_SIZE;
+        if (ok && fs::file_size(m_path, ec) != size)
+        {
+            fs::resize_file(m_path, size, ec);
+            ok = !ec;
+        }
+        return ok;
+    }
+
+    /**
+     * @brief Rebuilds the index of an archive whose writer did not finish
+     *
+     * Walks the entry headers from the start of the file and stops at the
+     * first header that is missing or describes data beyond the end of the
+     * file. m_position is set to the end of the last intact entry.
+     *
+     * @param path Filesystem path of the archive
+     * @param file_size Current size of the archive
+     * @return bool True if the scan completed
+     */
+    bool SampleArchiveWriter::recover(const std::string& path, uint64_t file_size)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+
+        uint64_t position = FILE_HEADER_SIZE;
+        while (position + ENTRY_HEADER_SIZE <= file_size)
+        {
+            uint8_t header[ENTRY_HEADER_SIZE];
+            in.seekg(static_cast<std::streamoff>(position));
+            if (!in.read(reinterpret_cast<char*>(header), ENTRY_HEADER_SIZE)
+                || std::memcmp(header, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0)
+            {
+                break;
+            }
+
+            const int64_t id = load<int64_t>(header + 8);
+            const uint64_t length = load<uint64_t>(header + 16);
+            const uint64_t data_offset = alignUp(position + ENTRY_HEADER_SIZE, m_alignment);
+            if (data_offset > file_size || length > file_size - data_offset)
+            {
+                break;
+            }
+
+            m_index[static_cast<int>(id)] = {
+                data_offset, length, static_cast<AudioFormat>(header[4])
+            };
+            position = alignUp(data_offset + length, HEADER_ALIGNMENT);
+        }
+
+        // open() resizes the file to this position, which also restores
+        // padding lost after the last intact entry
+        m_position = position;
+        return true;
+    }
+
+    /**
+     * @brief Maps an archive and validates its trailer and index
+     *
+     * @param path Filesystem path of the archive
+     * @return bool True if the archive is complete and well-formed
+     */
+    bool SampleArchiveReader::open(const std::string& path)
+    {
+        m_index = nullptr;
+        m_entry_count = 0;
+
+        if (!m_file.open(path) || m_file.size() < FILE_HEADER_SIZE + TRAILER_SIZE)
+        {
+            m_file.close();
+            return false;
+        }
+
+        const uint8_t* data = m_file.data();
+        const uint64_t size = m_file.size();
+        const uint8_t* trailer = data + size - TRAILER_SIZE;
+        const uint64_t index_offset = load<uint64_t>(trailer);
+        const uint64_t count = load<uint64_t>(trailer + 8);
+
+        if (std::memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+            || std::memcmp(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0
+            || index_offset < FILE_HEADER_SIZE
+            || index_offset % HEADER_ALIGNMENT != 0
+            || index_offset > size - TRAILER_SIZE
+            || count != (size - TRAILER_SIZE - index_offset) / INDEX_RECORD_SIZE
+            || index_offset + count * INDEX_RECORD_SIZE + TRAILER_SIZE != size)
+        {
+            m_file.close();
+            return false;
+        }
+
+        m_index = data + index_offset;
+        m_entry_count = static_cast<size_t>(count);
+        return true;
+    }
+
+    /**
+     * @brief Returns the entry at a position of the ID-sorted index
+     *
+     * Entries whose recorded bounds fall outside the data area are returned
+     * with an empty data view.
+     *
+     * @param index Position in the index, less than size()
+     * @return ArchiveEntry Entry at that position
+     */
+    ArchiveEntry SampleArchiveReader::entry(size_t index) const
+    {
+        const uint8_t* record = m_index + index * INDEX_RECORD_SIZE;
+        const uint64_t offset = load<uint64_t>(record + 8);
+        const uint64_t length = load<uint64_t>(record + 16);
+        const uint64_t data_end = static_cast<uint64_t>(m_index - m_file.data());
+
+        ArchiveEntry entry;
+        entry.sound_id = static_cast<int>(load<int64_t>(record));
+        entry.format = static_cast<AudioFormat>(record[24]);
+        if (offset <= data_end && length <= data_end - offset)
+        {
+            entry.data = ArrayView<uint8_t>(m_file.data() + offset, static_cast<size_t>(length));
+        }
+        return entry;
+    }
+
+    /**
+     * @brief Looks up a sound by ID
+     *
+     * @param sound_id Freesound sound ID
+     * @return std::optional<ArchiveEntry> Entry, or std::nullopt if absent
+     */
+    std::optional<ArchiveEntry> SampleArchiveReader::find(int sound_id) const
+    {
+        size_t low = 0;
+        size_t high = m_entry_count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            const int64_t id = load<int64_t>(m_index + middle * INDEX_RECORD_SIZE);
+            if (id < sound_id)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (low < m_entry_count && load<int64_t>(m_index + low * INDEX_RECORD_SIZE) == sound_id)
+        {
+            return entry(low);
+        }
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,752 @@
+/**
+ * @file src/similarity_index.cpp
+ * @brief Implementation of the SimilarityIndex class
+ *
+ * File layout (little-endian, every section 4-byte aligned):
+ *   header        64 bytes: magic, options, count, top layer, entry node, upper link words
+ *   vectors       count x dimensions floats
+ *   ids           count int32
+ *   levels        count uint32 (top layer of each node)
+ *   upper offsets count uint32
+ *   bottom links  count x (1 + 2 * max_links) uint32
+ *   upper links   upper link words uint32
+ *   id table      count (sound ID, node) pairs sorted by sound ID
+ *
+ * @see include/similarity_index.h
+ */
+
+#include "similarity_index.h"
+#include "atomic_file.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        const char MAGIC[8] = {'F', 'S', 'A', 'N', 'N', '0', '0', '1'};
+        constexpr size_t HEADER_SIZE = 64;
+
+        /// Layers above the bottom one; with max_links >= 2 a node reaches layer 16 with odds below 2^-16
+        constexpr uint32_t MAX_LEVEL = 16;
+
+        constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+
+        template <typename T>
+        T loadValue(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void storeValue(uint8_t* bytes, T value)
+        {
+            std::memcpy(bytes, &value, sizeof(T));
+        }
+
+        template <typename T>
+        bool writeArray(AtomicFile& file, const T* data, size_t count)
+        {
+            return count == 0 || file.write(data, count * sizeof(T));
+        }
+
+        using Candidate = std::pair<float, uint32_t>;
+
+        /// Orders a priority queue with the farthest candidate on top
+        struct Farther
+        {
+            bool operator()(const Candidate& a, const Candidate& b) const { return a.first < b.first; }
+        };
+
+        /// Orders a priority queue with the closest candidate on top
+        struct Closer
+        {
+            bool operator()(const Candidate& a, const Candidate& b) const { return a.first > b.first; }
+        };
+    }
+
+    /**
+     * @brief Creates an empty index
+     *
+     * @param options Dimensions, graph degree and search effort
+     * @throws std::invalid_argument If dimensions, construction_breadth or search_breadth is zero,
+     *         or max_links is less than 2
+     */
+    SimilarityIndex::SimilarityIndex(const SimilarityIndexOptions& options)
+        : m_options(options), m_random(options.seed)
+    {
+        if (options.dimensions == 0 || options.max_links < 2 || options.construction_breadth == 0
+            || options.search_breadth == 0)
+        {
+            throw std::invalid_argument("SimilarityIndex: invalid options");
+        }
+    }
+
+    /**
+     * @brief Adds the vector of a sound
+     *
+     * The new node is linked to the closest nodes found on each of its
+     * layers, chosen so that they point in different directions rather
+     * than all into one cluster. A neighbour that ends up with too many
+     * links keeps the most useful ones by the same rule.
+     *
+     * @param sound_id Freesound sound ID
+     * @param vector dimensions() values
+     * @return bool True if added; false if the sound is already indexed or the index is full
+     */
+    bool SimilarityIndex::insert(int sound_id, const float* vector)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+        uint32_t existing;
+        if (findNode(sound_id, existing) || m_count >= NO_NODE)
+        {
+            return false;
+        }
+        materialise();
+
+        const uint32_t node = static_cast<uint32_t>(m_count);
+        const uint32_t level = randomLevel();
+        const size_t upper_words = static_cast<size_t>(level) * linkSlots(1);
+        if (m_upper_links.size() + upper_words > NO_NODE)
+        {
+            return false;
+        }
+
+        m_vectors.insert(m_vectors.end(), vector, vector + m_options.dimensions);
+        m_ids.push_back(sound_id);
+        m_levels.push_back(level);
+        m_upper_offsets.push_back(static_cast<uint32_t>(m_upper_links.size()));
+        m_upper_links.resize(m_upper_links.size() + upper_words, 0);
+        m_upper_words = m_upper_links.size();
+        m_bottom_links.resize(m_bottom_links.size() + linkSlots(0), 0);
+        m_nodes.emplace(sound_id, node);
+        ++m_count;
+        refreshViews();
+
+        if (node == 0)
+        {
+            m_entry = 0;
+            m_max_level = level;
+            return true;
+        }
+
+        const float* own = vectorOf(node);
+        uint32_t entry = level < m_max_level ? descend(own, level) : m_entry;
+        for (uint32_t layer = std::min(level, m_max_level) + 1; layer-- > 0;)
+        {
+            const auto candidates = searchLayer(own, entry, m_options.construction_breadth, layer);
+            const auto neighbours = selectNeighbours(candidates, m_options.max_links);
+
+            uint32_t* slots = mutableLinks(node, layer);
+            slots[0] = static_cast<uint32_t>(neighbours.size());
+            std::copy(neighbours.begin(), neighbours.end(), slots + 1);
+            for (uint32_t neighbour : neighbours)
+            {
+                link(neighbour, node, layer);
+            }
+            entry = candidates.front().second;
+        }
+
+        if (level > m_max_level)
+        {
+            m_max_level = level;
+            m_entry = node;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finds the sounds whose vectors are closest to a vector
+     *
+     * @param vector dimensions() values
+     * @param count Maximum number of results
+     * @param breadth Candidates to keep during the search (0 for search_breadth; at least count is used)
+     * @return std::vector<SimilarSound> Results, closest first
+     */
+    std::vector<SimilarSound> SimilarityIndex::query(const float* vector, size_t count, size_t breadth) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return search(vector, count, breadth, NO_NODE);
+    }
+
+    /**
+     * @brief Finds the sounds most similar to an indexed sound ("more like this")
+     *
+     * @param sound_id Indexed sound
+     * @param count Maximum number of results, not counting the sound itself
+     * @param breadth Candidates to keep during the search (0 for search_breadth)
+     * @return std::vector<SimilarSound> Results, closest first; empty if the sound is not indexed
+     */
+    std::vector<SimilarSound> SimilarityIndex::similarTo(int sound_id, size_t count, size_t breadth) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        uint32_t node;
+        if (!findNode(sound_id, node))
+        {
+            return {};
+        }
+        return search(vectorOf(node), count, breadth, node);
+    }
+
+    /**
+     * @brief Checks whether a sound is indexed
+     *
+     * @param sound_id Freesound sound ID
+     * @return bool True if insert() added it or the opened file contains it
+     */
+    bool SimilarityIndex::contains(int sound_id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        uint32_t node;
+        return findNode(sound_id, node);
+    }
+
+    /**
+     * @brief Writes the index to a file that open() can map
+     *
+     * @param path Destination
+     * @param sync_first Flush the file to stable storage before it appears
+     * @return bool True if the file was written
+     */
+    bool SimilarityIndex::save(const std::string& path, bool sync_first) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+        uint8_t header[HEADER_SIZE] = {};
+        std::memcpy(header, MAGIC, sizeof(MAGIC));
+        storeValue<uint32_t>(header + 8, m_options.dimensions);
+        storeValue<uint32_t>(header + 12, m_options.max_links);
+        storeValue<uint32_t>(header + 16, m_options.construction_breadth);
+        storeValue<uint32_t>(header + 20, m_options.search_breadth);
+        storeValue<uint32_t>(header + 24, m_options.seed);
+        storeValue<uint32_t>(header + 28, static_cast<uint32_t>(m_count));
+        storeValue<uint32_t>(header + 32, m_max_level);
+        storeValue<uint32_t>(header + 36, m_entry);
+        storeValue<uint64_t>(header + 40, m_upper_words);
+
+        std::vector<uint32_t> id_table(2 * m_count);
+        {
+            std::vector<uint32_t> order(m_count);
+            for (uint32_t node = 0; node < m_count; ++node)
+            {
+                order[node] = node;
+            }
+            std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return m_id_data[a] < m_id_data[b];
+            });
+            for (size_t i = 0; i < m_count; ++i)
+            {
+                id_table[2 * i] = static_cast<uint32_t>(m_id_data[order[i]]);
+                id_table[2 * i + 1] = order[i];
+            }
+        }
+
+        AtomicFile file;
+        if (!file.open(path)
+            || !file.write(header, sizeof(header))
+            || !writeArray(file, m_vector_data, m_count * m_options.dimensions)
+            || !writeArray(file, m_id_data, m_count)
+            || !writeArray(file, m_level_data, m_count)
+            || !writeArray(file, m_upper_offset_data, m_count)
+            || !writeArray(file, m_bottom_link_data, m_count * linkSlots(0))
+            || !writeArray(file, m_upper_link_data, m_upper_words)
+            || !writeArray(file, id_table.data(), id_table.size()))
+        {
+            file.abort();
+            return false;
+        }
+        return file.commit(sync_first);
+    }
+
+    /**
+     * @brief Replaces the contents of the index with a file written by save()
+     *
+     * The file is mapped rather than read, and its options replace the
+     * ones given to the constructor. Every link is checked once, so a
+     * damaged file is rejected instead of steering a query out of bounds.
+     *
+     * @param path Index file
+     * @return bool True if the file was opened; false leaves the index unchanged
+     */
+    bool SimilarityIndex::open(const std::string& path)
+    {
+        MappedFile file;
+        if (!file.open(path) || file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0)
+        {
+            return false;
+        }
+
+        const uint8_t* header = file.data();
+        SimilarityIndexOptions options;
+        options.dimensions = loadValue<uint32_t>(header + 8);
+        options.max_links = loadValue<uint32_t>(header + 12);
+        options.construction_breadth = loadValue<uint32_t>(header + 16);
+        options.search_breadth = loadValue<uint32_t>(header + 20);
+        options.seed = loadValue<uint32_t>(header + 24);
+        const uint64_t count = loadValue<uint32_t>(header + 28);
+        const uint32_t max_level = loadValue<uint32_t>(header + 32);
+        const uint32_t entry = loadValue<uint32_t>(header + 36);
+        const uint64_t upper_words = loadValue<uint64_t>(header + 40);
+
+        if (options.dimensions == 0 || options.max_links < 2 || options.max_links > (1u << 16)
+            || options.construction_breadth == 0 || options.search_breadth == 0 || max_level > MAX_LEVEL
+            || (count > 0 && entry >= count) || options.dimensions > (1u << 20))
+        {
+            return false;
+        }
+
+        const uint64_t bottom_slots = 1 + 2 * static_cast<uint64_t>(options.max_links);
+        const uint64_t upper_slots = 1 + static_cast<uint64_t>(options.max_links);
+        const uint64_t words = count * options.dimensions + 3 * count + count * bottom_slots + upper_words + 2 * count;
+        if (upper_words >= NO_NODE || file.size() != HEADER_SIZE + 4 * words)
+        {
+            return false;
+        }
+
+        const auto* base = reinterpret_cast<const uint32_t*>(file.data() + HEADER_SIZE);
+        const auto* vectors = reinterpret_cast<const float*>(base);
+        const auto* ids = reinterpret_cast<const int32_t*>(base + count * options.dimensions);
+        const uint32_t* levels = base + count * options.dimensions + count;
+        const uint32_t* upper_offsets = levels + count;
+        const uint32_t* bottom_links = upper_offsets + count;
+        const uint32_t* upper_links = bottom_links + count * bottom_slots;
+        const uint32_t* id_table = upper_links + upper_words;
+
+        if (count > 0 && levels[entry] != max_level)
+        {
+            return false;
+        }
+        for (uint64_t node = 0; node < count; ++node)
+        {
+            if (levels[node] > max_level
+                || static_cast<uint64_t>(upper_offsets[node]) + levels[node] * upper_slots > upper_words)
+            {
+                return false;
+            }
+        }
+        for (uint64_t node = 0; node < count; ++node)
+        {
+            for (uint32_t layer = 0; layer <= levels[node]; ++layer)
+            {
+                const uint32_t* slots = layer == 0 ? bottom_links + node * bottom_slots
+                    : upper_links + upper_offsets[node] + (layer - 1) * upper_slots;
+                if (slots[0] > (layer == 0 ? bottom_slots : upper_slots) - 1)
+                {
+                    return false;
+                }
+                for (uint32_t i = 1; i <= slots[0]; ++i)
+                {
+                    // A neighbour on a layer must itself reach that layer
+                    if (slots[i] >= count || levels[slots[i]] < layer)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            const uint32_t node = id_table[2 * i + 1];
+            if (node >= count || static_cast<uint32_t>(ids[node]) != id_table[2 * i]
+                || (i > 0 && static_cast<int32_t>(id_table[2 * i - 2]) >= static_cast<int32_t>(id_table[2 * i])))
+            {
+                return false;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_options = options;
+        m_count = static_cast<size_t>(count);
+        m_max_level = max_level;
+        m_entry = entry;
+        m_upper_words = static_cast<size_t>(upper_words);
+        m_vector_data = vectors;
+        m_id_data = ids;
+        m_level_data = levels;
+        m_upper_offset_data = upper_offsets;
+        m_bottom_link_data = bottom_links;
+        m_upper_link_data = upper_links;
+        m_id_table = id_table;
+        m_file = std::move(file);
+        m_mapped = true;
+
+        m_vectors.clear();
+        m_ids.clear();
+        m_levels.clear();
+        m_upper_offsets.clear();
+        m_bottom_links.clear();
+        m_upper_links.clear();
+        m_nodes.clear();
+        m_random.seed(options.seed ^ static_cast<uint32_t>(count));
+        return true;
+    }
+
+    size_t SimilarityIndex::size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_count;
+    }
+
+    size_t SimilarityIndex::dimensions() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_options.dimensions;
+    }
+
+    /**
+     * @brief Returns the words a node's link list occupies on a layer, count included
+     */
+    size_t SimilarityIndex::linkSlots(uint32_t layer) const
+    {
+        return 1 + static_cast<size_t>(m_options.max_links) * (layer == 0 ? 2 : 1);
+    }
+
+    const uint32_t* SimilarityIndex::links(uint32_t node, uint32_t layer) const
+    {
+        if (layer == 0)
+        {
+            return m_bottom_link_data + static_cast<size_t>(node) * linkSlots(0);
+        }
+        return m_upper_link_data + m_upper_offset_data[node] + (layer - 1) * linkSlots(1);
+    }
+
+    uint32_t* SimilarityIndex::mutableLinks(uint32_t node, uint32_t layer)
+    {
+        if (layer == 0)
+        {
+            return m_bottom_links.data() + static_cast<size_t>(node) * linkSlots(0);
+        }
+        return m_upper_links.data() + m_upper_offsets[node] + (layer - 1) * linkSlots(1);
+    }
+
+    const float* SimilarityIndex::vectorOf(uint32_t node) const
+    {
+        return m_vector_data + static_cast<size_t>(node) * m_options.dimensions;
+    }
+
+    bool SimilarityIndex::findNode(int sound_id, uint32_t& node) const
+    {
+        if (!m_mapped)
+        {
+            const auto found = m_nodes.find(sound_id);
+            if (found == m_nodes.end())
+            {
+                return false;
+            }
+            node = found->second;
+            return true;
+        }
+
+        size_t low = 0;
+        size_t high = m_count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            const auto id = static_cast<int32_t>(m_id_table[2 * middle]);
+            if (id == sound_id)
+            {
+                node = m_id_table[2 * middle + 1];
+                return true;
+            }
+            if (id < sound_id)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Draws the top layer of a new node: layer l with probability max_links^-l
+     */
+    uint32_t SimilarityIndex::randomLevel()
+    {
+        std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+        const double level = -std::log(uniform(m_random)) / std::log(static_cast<double>(m_options.max_links));
+        return static_cast<uint32_t>(std::min<double>(level, MAX_LEVEL));
+    }
+
+    /**
+     * @brief Copies a mapped graph into the vectors so that it can grow
+     */
+    void SimilarityIndex::materialise()
+    {
+        if (!m_mapped)
+        {
+            return;
+        }
+
+        m_vectors.assign(m_vector_data, m_vector_data + m_count * m_options.dimensions);
+        m_ids.assign(m_id_data, m_id_data + m_count);
+        m_levels.assign(m_level_data, m_level_data + m_count);
+        m_upper_offsets.assign(m_upper_offset_data, m_upper_offset_data + m_count);
+        m_bottom_links.assign(m_bottom_link_data, m_bottom_link_data + m_count * linkSlots(0));
+        m_upper_links.assign(m_upper_link_data, m_upper_link_data + m_upper_words);
+        m_nodes.reserve(m_count);
+        for (uint32_t node = 0; node < m_count; ++node)
+        {
+            m_nodes.emplace(m_ids[node], node);
+        }
+
+        m_mapped = false;
+        m_id_table = nullptr;
+        m_file.close();
+        refreshViews();
+    }
+
+    void SimilarityIndex::refreshViews()
+    {
+        m_vector_data = m_vectors.data();
+        m_id_data = m_ids.data();
+        m_level_data = m_levels.data();
+        m_upper_offset_data = m_upper_offsets.data();
+        m_bottom_link_data = m_bottom_links.data();
+        m_upper_link_data = m_upper_links.data();
+    }
+
+    /**
+     * @brief Walks greedily from the entry node down to a layer
+     *
+     * @param vector Target
+     * @param target_layer Layer to stop at
+     * @return uint32_t Closest node found on target_layer
+     */
+    uint32_t SimilarityIndex::descend(const float* vector, uint32_t target_layer) const
+    {
+        const size_t dimensions = m_options.dimensions;
+        uint32_t current = m_entry;
+        float current_distance = squaredDistance(vector, vectorOf(current), dimensions);
+        for (uint32_t layer = m_max_level; layer > target_layer; --layer)
+        {
+            bool moved = true;
+            while (moved)
+            {
+                moved = false;
+                const uint32_t* slots = links(current, layer);
+                for (uint32_t i = 1; i <= slots[0]; ++i)
+                {
+                    const float distance = squaredDistance(vector, vectorOf(slots[i]), dimensions);
+                    if (distance < current_distance)
+                    {
+                        current_distance = distance;
+                        current = slots[i];
+                        moved = true;
+                    }
+                }
+            }
+        }
+        return current;
+    }
+
+    /**
+     * @brief Beam search on one layer
+     *
+     * @param vector Target
+     * @param entry Node to start from
+     * @param breadth Candidates kept
+     * @param layer Layer searched
+     * @return std::vector<Candidate> Up to breadth (squared distance, node) pairs, closest first
+     */
+    std::vector<SimilarityIndex::Candidate> SimilarityIndex::searchLayer(const float* vector, uint32_t entry,
+                                                                         size_t breadth, uint32_t layer) const
+    {
+        const size_t dimensions = m_options.dimensions;
+        auto visited = acquireVisited();
+        visited->marks[entry] = visited->epoch;
+
+        const Candidate start(squaredDistance(vector, vectorOf(entry), dimensions), entry);
+        std::priority_queue<Candidate, std::vector<Candidate>, Closer> frontier;
+        std::priority_queue<Candidate, std::vector<Candidate>, Farther> best;
+        frontier.push(start);
+        best.push(start);
+
+        while (!frontier.empty())
+        {
+            const Candidate current = frontier.top();
+            if (current.first > best.top().first && best.size() >= breadth)
+            {
+                break;
+            }
+            frontier.pop();
+
+            const uint32_t* slots = links(current.second, layer);
+            for (uint32_t i = 1; i <= slots[0]; ++i)
+            {
+                const uint32_t neighbour = slots[i];
+                if (visited->marks[neighbour] == visited->epoch)
+                {
+                    continue;
+                }
+                visited->marks[neighbour] = visited->epoch;
+
+                const float distance = squaredDistance(vector, vectorOf(neighbour), dimensions);
+                if (best.size() < breadth || distance < best.top().first)
+                {
+                    frontier.emplace(distance, neighbour);
+                    best.emplace(distance, neighbour);
+                    if (best.size() > breadth)
+                    {
+                        best.pop();
+                    }
+                }
+            }
+        }
+        releaseVisited(std::move(visited));
+
+        std::vector<Candidate> result(best.size());
+        for (size_t i = result.size(); i-- > 0;)
+        {
+            result[i] = best.top();
+            best.pop();
+        }
+        return result;
+    }
+
+    /**
+     * @brief Picks links that cover different directions from a node
+     *
+     * A candidate is kept only if it is closer to the node than to every
+     * neighbour kept so far; otherwise that neighbour already leads towards
+     * it. This keeps clusters connected to each other, which plain nearest
+     * neighbours would not.
+     *
+     * @param candidates (squared distance, node) pairs, closest first
+     * @param limit Maximum links
+     * @return std::vector<uint32_t> Chosen nodes
+     */
+    std::vector<uint32_t> SimilarityIndex::selectNeighbours(const std::vector<Candidate>& candidates,
+                                                            size_t limit) const
+    {
+        const size_t dimensions = m_options.dimensions;
+        std::vector<uint32_t> chosen;
+        for (const Candidate& candidate : candidates)
+        {
+            if (chosen.size() >= limit)
+            {
+                break;
+            }
+            bool diverse = true;
+            for (uint32_t kept : chosen)
+            {
+                if (squaredDistance(vectorOf(candidate.second), vectorOf(kept), dimensions) < candidate.first)
+                {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse)
+            {
+                chosen.push_back(candidate.second);
+            }
+        }
+        return chosen;
+    }
+
+    /**
+     * @brief Adds a link, pruning the node's list if it is full
+     *
+     * @param from Node whose list grows
+     * @param to New neighbour
+     * @param layer Layer of the link
+     */
+    void SimilarityIndex::link(uint32_t from, uint32_t to, uint32_t layer)
+    {
+        uint32_t* slots = mutableLinks(from, layer);
+        const size_t capacity = linkSlots(layer) - 1;
+        if (slots[0] < capacity)
+        {
+            slots[++slots[0]] = to;
+            return;
+        }
+
+        const size_t dimensions = m_options.dimensions;
+        const float* origin = vectorOf(from);
+        std::vector<Candidate> candidates;
+        candidates.reserve(capacity + 1);
+        candidates.emplace_back(squaredDistance(origin, vectorOf(to), dimensions), to);
+        for (uint32_t i = 1; i <= slots[0]; ++i)
+        {
+            candidates.emplace_back(squaredDistance(origin, vectorOf(slots[i]), dimensions), slots[i]);
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        const auto kept = selectNeighbours(candidates, capacity);
+        slots[0] = static_cast<uint32_t>(kept.size());
+        std::copy(kept.begin(), kept.end(), slots + 1);
+    }
+
+    std::vector<SimilarSound> SimilarityIndex::search(const float* vector, size_t count, size_t breadth,
+                                                      uint32_t exclude) const
+    {
+        if (m_count == 0 || count == 0)
+        {
+            return {};
+        }
+
+        const size_t wanted = count + (exclude != NO_NODE ? 1 : 0);
+        const size_t beam = std::max(breadth ? breadth : m_options.search_breadth, wanted);
+        const auto candidates = searchLayer(vector, descend(vector, 0), beam, 0);
+
+        std::vector<SimilarSound> results;
+        results.reserve(std::min(count, candidates.size()));
+        for (const Candidate& candidate : candidates)
+        {
+            if (results.size() == count)
+            {
+                break;
+            }
+            if (candidate.second != exclude)
+            {
+                results.push_back({m_id_data[candidate.second], std::sqrt(candidate.first)});
+            }
+        }
+        return results;
+    }
+
+    std::unique_ptr<SimilarityIndex::VisitedSet> SimilarityIndex::acquireVisited() const
+    {
+        std::unique_ptr<VisitedSet> visited;
+        {
+            std::lock_guard<std::mutex> lock(m_visited_mutex);
+            if (!m_visited_pool.empty())
+            {
+                visited = std::move(m_visited_pool.back());
+                m_visited_pool.pop_back();
+            }
+        }
+        if (!visited)
+        {
+            visited = std::make_unique<VisitedSet>();
+        }
+
+        if (visited->marks.size() < m_count)
+        {
+            visited->marks.resize(m_count, visited->epoch);
+        }
+        if (++visited->epoch == 0)
+        {
+            // The epoch wrapped: old marks could now look current
+            std::fill(visited->marks.begin(), visited->marks.end(), 0);
+            visited->epoch = 1;
+        }
+        return visited;
+    }
+
+    void SimilarityIndex::releaseVisited(std::unique_ptr<VisitedSet> visited) const
+    {
+        std::lock_guard<std::mutex> lock(m_visited_mutex);
+        m_visited_pool.push_back(std::move(visited));
+    }
+}
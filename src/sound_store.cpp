@@ -0,0 +1,750 @@
+/**
+ * @file src/sound_store.cpp
+ * @brief Implementation of the SoundStore class
+ *
+ * @see include/sound_store.h
+ */
+
+#include "sound_store.h"
+#include "atomic_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// id, size, content hash, format, operation, compressed flag, reserved
+        constexpr size_t RECORD_SIZE = 32;
+
+        constexpr uint8_t OP_PUT = 1;
+        constexpr uint8_t OP_REMOVE = 2;
+
+        /// Snapshot header: magic, record count, checksum, reserved
+        const char SNAPSHOT_MAGIC[8] = {'F', 'S', 'I', 'D', 'X', '0', '0', '1'};
+        constexpr size_t SNAPSHOT_HEADER_SIZE = 64;
+
+        template <typename T>
+        T load(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        uint64_t rotateLeft(uint64_t value, unsigned bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        /**
+         * @brief Checksums the records of a snapshot
+         *
+         * Each of the four 64-bit words of a record feeds its own lane, so
+         * the multiplications of consecutive words do not wait on each
+         * other and validation runs at memory bandwidth.
+         *
+         * @param records First record
+         * @param count Number of records
+         * @return uint64_t 64-bit checksum, which also depends on count
+         */
+        uint64_t snapshotChecksum(const uint8_t* records, size_t count)
+        {
+            constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+            constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+            uint64_t lanes[4] = {count + PRIME_1, count ^ PRIME_2, count - PRIME_1, ~count};
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint8_t* record = records + i * RECORD_SIZE;
+                for (size_t lane = 0; lane < 4; ++lane)
+                {
+                    lanes[lane] = rotateLeft(lanes[lane] + load<uint64_t>(record + lane * 8) * PRIME_2, 31) * PRIME_1;
+                }
+            }
+
+            uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7)
+                + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+            hash = (hash ^ (hash >> 33)) * PRIME_2;
+            return hash ^ (hash >> 29);
+        }
+
+        StoreEntry decodeRecord(const uint8_t* record)
+        {
+            StoreEntry entry;
+            entry.sound_id = static_cast<int>(load<int64_t>(record));
+            entry.size = load<uint64_t>(record + 8);
+            entry.content_hash = load<uint64_t>(record + 16);
+            entry.format = static_cast<AudioFormat>(record[24]);
+            entry.compressed = record[26] != 0;
+            return entry;
+        }
+
+        /**
+         * @brief Scrambles a sound ID so that consecutive IDs land in different shards
+         *
+         * @param sound_id Freesound sound ID
+         * @return uint64_t Well-mixed 64-bit value (splitmix64 finalizer)
+         */
+        uint64_t mixId(int sound_id)
+        {
+            uint64_t x = static_cast<uint64_t>(static_cast<int64_t>(sound_id));
+            x += 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+
+        void encodeRecord(const StoreEntry& entry, uint8_t op, uint8_t* out)
+        {
+            const int64_t id = entry.sound_id;
+            std::memset(out, 0, RECORD_SIZE);
+            std::memcpy(out, &id, 8);
+            std::memcpy(out + 8, &entry.size, 8);
+            std::memcpy(out + 16, &entry.content_hash, 8);
+            out[24] = static_cast<uint8_t>(entry.format);
+            out[25] = op;
+            out[26] = entry.compressed ? 1 : 0;
+        }
+    }
+
+    /**
+     * @brief Opens (or creates) a store rooted at a directory
+     *
+     * Only the snapshot header and records are checked, which costs one pass
+     * over the mapping; the time spent replaying the log grows with the
+     * number of changes since the last compact().
+     *
+     * @param root Store root directory
+     * @return bool True if the store is ready for use; false if the
+     *              directory or log cannot be opened or the snapshot fails
+     *              its checksum
+     */
+    bool SoundStore::open(const std::string& root)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_root = root;
+        m_delta.clear();
+        if (m_index.is_open())
+        {
+            m_index.close();
+        }
+
+        std::error_code ec;
+        fs::create_directories(m_root, ec);
+        if (ec || !loadSnapshot())
+        {
+            return false;
+        }
+
+        const fs::path index_path = fs::path(m_root) / INDEX_FILE;
+        uint64_t valid_bytes = 0;
+        {
+            std::ifstream in(index_path, std::ios::binary);
+            uint8_t record[RECORD_SIZE];
+            while (in.read(reinterpret_cast<char*>(record), RECORD_SIZE))
+            {
+                const StoreEntry entry = decodeRecord(record);
+                const bool present = lookup(entry.sound_id).has_value();
+
+                // Replaying records the snapshot already includes (a crash
+                // between writing it and emptying the log) is harmless
+                if (record[25] == OP_PUT)
+                {
+                    m_delta[entry.sound_id] = entry;
+                    m_count += present ? 0 : 1;
+                }
+                else if (record[25] == OP_REMOVE)
+                {
+                    m_delta[entry.sound_id] = std::nullopt;
+                    m_count -= present ? 1 : 0;
+                }
+                valid_bytes += RECORD_SIZE;
+            }
+        }
+
+        // Drop a torn record left behind by an interrupted append
+        if (fs::exists(index_path, ec) && fs::file_size(index_path, ec) != valid_bytes)
+        {
+            fs::resize_file(index_path, valid_bytes, ec);
+            if (ec)
+            {
+                return false;
+            }
+        }
+
+        m_index.open(index_path, std::ios::binary | std::ios::app);
+        return m_index.is_open();
+    }
+
+    /**
+     * @brief Stores the contents of a sound, replacing any previous version
+     *
+     * The file is written to a temporary name, flushed and renamed into
+     * place before its index record is appended, so a crash can leave an
+     * unindexed file behind but never an index record pointing at a
+     * missing or truncated file. Compression, when enabled, happens before
+     * the lock is taken, so puts of different sounds compress in parallel.
+     *
+     * @param sound_id Freesound sound ID
+     * @param data File contents
+     * @param size Number of bytes at data
+     * @return bool True if the file and its index record were written
+     */
+    bool SoundStore::put(int sound_id, const uint8_t* data, size_t size)
+    {
+        StoreEntry entry;
+        entry.sound_id = sound_id;
+        entry.size = size;
+        entry.content_hash = contentHash(data, size);
+        entry.format = sniffAudioFormat(data, size);
+
+        bool compress = false;
+        LosslessOptions lossless;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            compress = m_compress;
+            lossless = m_lossless;
+        }
+        std::optional<std::vector<uint8_t>> packed;
+        if (compress && (entry.format == AudioFormat::Wav || entry.format == AudioFormat::Aiff))
+        {
+            packed = compressPcmFile(data, size, lossless);
+        }
+        entry.compressed = packed.has_value();
+
+        const fs::path path = storedPathFor(entry);
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        AtomicFile file;
+        const uint8_t* contents = packed ? packed->data() : data;
+        const size_t length = packed ? packed->size() : size;
+        if (!file.open(path.string()) || !file.write(contents, length) || !file.commit(true))
+        {
+            return false;
+        }
+
+        return addEntry(entry);
+    }
+
+    /**
+     * @brief Starts storing a sound, replacing any previous version on commit()
+     *
+     * @param store Open store receiving the sound
+     * @param sound_id Freesound sound ID
+     */
+    SoundStore::Writer::Writer(SoundStore& store, int sound_id)
+        : m_store(store)
+    {
+        m_entry.sound_id = sound_id;
+        m_entry.content_hash = contentHash(nullptr, 0);
+    }
+
+    /**
+     * @brief Appends the next part of the contents
+     *
+     * @param data Bytes following those of the previous call
+     * @param size Number of bytes at data
+     * @return bool True if the bytes were written (or held back)
+     */
+    bool SoundStore::Writer::append(const uint8_t* data, size_t size)
+    {
+        if (m_failed || m_committed)
+        {
+            return false;
+        }
+
+        m_entry.size += size;
+        m_entry.content_hash = contentHash(data, size, m_entry.content_hash);
+        if (!m_file.isOpen())
+        {
+            m_head.insert(m_head.end(), data, data + size);
+            m_failed = m_head.size() >= AUDIO_SNIFF_BYTES && !openFile();
+            return !m_failed;
+        }
+
+        m_failed = !m_file.write(data, size);
+        return !m_failed;
+    }
+
+    /**
+     * @brief Completes the file and records it in the index
+     *
+     * As with put(), the file is flushed and renamed into place before its
+     * index record is appended. With lossless compression enabled, a PCM
+     * file is compressed from its temporary copy and only the compressed
+     * form is renamed into place.
+     *
+     * @return bool True if the file and its index record were written
+     */
+    bool SoundStore::Writer::commit()
+    {
+        if (m_failed || m_committed || (!m_file.isOpen() && !openFile()))
+        {
+            return false;
+        }
+
+        bool compress = false;
+        LosslessOptions lossless;
+        {
+            std::lock_guard<std::mutex> lock(m_store.m_mutex);
+            compress = m_store.m_compress;
+            lossless = m_store.m_lossless;
+        }
+        std::optional<std::vector<uint8_t>> packed;
+        if (compress && (m_entry.format == AudioFormat::Wav || m_entry.format == AudioFormat::Aiff))
+        {
+            MappedFile written;
+            if (written.open(m_file.tempPath()))
+            {
+                packed = compressPcmFile(written.data(), written.size(), lossless);
+            }
+        }
+
+        bool stored = false;
+        if (packed)
+        {
+            m_entry.compressed = true;
+            AtomicFile file;
+            stored = file.open(m_store.storedPathFor(m_entry)) && file.write(packed->data(), packed->size())
+                && file.commit(true);
+            m_file.abort();
+        }
+        else
+        {
+            stored = m_file.commit(true);
+        }
+
+        if (!stored || !m_store.addEntry(m_entry))
+        {
+            m_failed = true;
+            return false;
+        }
+        m_committed = true;
+        return true;
+    }
+
+    /**
+     * @brief Opens the file named after the sniffed format and writes the held-back bytes
+     *
+     * @return bool True if the file is open and the bytes were written
+     */
+    bool SoundStore::Writer::openFile()
+    {
+        m_entry.format = sniffAudioFormat(m_head.data(), m_head.size());
+        const fs::path path = m_store.pathFor(m_entry.sound_id, m_entry.format);
+
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        if (ec || !m_file.open(path.string()) || !m_file.write(m_head.data(), m_head.size()))
+        {
+            return false;
+        }
+
+        m_head.clear();
+        m_head.shrink_to_fit();
+        return true;
+    }
+
+    /**
+     * @brief Removes a sound from the store
+     *
+     * @param sound_id Freesound sound ID
+     * @return bool True if the sound was present and has been removed
+     */
+    bool SoundStore::remove(int sound_id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto entry = lookup(sound_id);
+        if (!entry || !appendRecord(*entry, true))
+        {
+            return false;
+        }
+
+        std::error_code ec;
+        fs::remove(storedPathFor(*entry), ec);
+        m_delta[sound_id] = std::nullopt;
+        --m_count;
+        return true;
+    }
+
+    /**
+     * @brief Looks up a sound in the index
+     *
+     * @param sound_id Freesound sound ID
+     * @return std::optional<StoreEntry> Index record, or std::nullopt if not stored
+     */
+    std::optional<StoreEntry> SoundStore::find(int sound_id) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return lookup(sound_id);
+    }
+
+    /**
+     * @brief Returns the path at which a sound is (or would be) stored
+     *
+     * @param sound_id Freesound sound ID
+     * @param format Container format, which selects the file extension
+     * @return std::string Sharded file path below the store root
+     */
+    std::string SoundStore::pathFor(int sound_id, AudioFormat format) const
+    {
+        const uint64_t shard = mixId(sound_id) >> 48;
+        char shard_dirs[8];
+        std::snprintf(shard_dirs, sizeof(shard_dirs), "%02x/%02x",
+            static_cast<unsigned>(shard >> 8), static_cast<unsigned>(shard & 0xFF));
+
+        return (fs::path(m_root) / shard_dirs
+            / (std::to_string(sound_id) + "." + audioFormatExtension(format))).string();
+    }
+
+    /**
+     * @brief Returns the path of the file that holds a sound
+     *
+     * @param entry Index record of the sound
+     * @return std::string pathFor() of the sound, with COMPRESSED_SUFFIX if it is kept compressed
+     */
+    std::string SoundStore::storedPathFor(const StoreEntry& entry) const
+    {
+        return pathFor(entry.sound_id, entry.format) + (entry.compressed ? COMPRESSED_SUFFIX : "");
+    }
+
+    /**
+     * @brief Reads back the contents of a sound as they were put
+     *
+     * The file is mapped rather than read, so a compressed sound is decoded
+     * straight from the page cache into the result.
+     *
+     * @param sound_id Freesound sound ID
+     * @return std::optional<std::vector<uint8_t>> File contents, or std::nullopt if the sound
+     *         is not stored or its file is missing or damaged
+     */
+    std::optional<std::vector<uint8_t>> SoundStore::read(int sound_id) const
+    {
+        std::optional<StoreEntry> entry;
+        unsigned threads = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            entry = lookup(sound_id);
+            threads = m_lossless.threads;
+        }
+        MappedFile file;
+        if (!entry || !file.open(storedPathFor(*entry)))
+        {
+            return std::nullopt;
+        }
+
+        std::optional<std::vector<uint8_t>> contents;
+        if (entry->compressed)
+        {
+            contents = decompressPcmFile(file.data(), file.size(), threads);
+        }
+        else
+        {
+            contents.emplace(file.data(), file.data() + file.size());
+        }
+        if (!contents || contents->size() != entry->size
+            || contentHash(contents->data(), contents->size()) != entry->content_hash)
+        {
+            return std::nullopt;
+        }
+        return contents;
+    }
+
+    /**
+     * @brief Chooses whether put() compresses PCM files losslessly
+     *
+     * Sounds already stored are kept as they are until put again.
+     *
+     * @param enabled Compress from now on
+     * @param options Parameters passed to compressPcmFile(); threads also applies to read()
+     * @throws std::invalid_argument If enabled and options are out of range
+     */
+    void SoundStore::setLosslessCompression(bool enabled, const LosslessOptions& options)
+    {
+        if (enabled && (options.block_frames < 16 || options.block_frames > 65536 || options.max_order == 0
+                        || options.max_order > 32))
+        {
+            throw std::invalid_argument("Lossless compression needs 16 to 65536 block frames and an order from 1 to 32");
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_compress = enabled;
+        m_lossless = options;
+    }
+
+    /**
+     * @brief Returns the number of sounds in the store
+     */
+    size_t SoundStore::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count;
+    }
+
+    /**
+     * @brief Writes a new index snapshot and empties the delta log
+     *
+     * The sorted snapshot records and the overlay are merged into a new
+     * snapshot, which is flushed and renamed over the old one before the
+     * log is truncated. A crash in between leaves a log whose records the
+     * snapshot already contains, and replaying them changes nothing.
+     *
+     * @return bool True if the new snapshot replaced the old one
+     */
+    bool SoundStore::compact()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<int> changed;
+        changed.reserve(m_delta.size());
+        for (const auto& change : m_delta)
+        {
+            changed.push_back(change.first);
+        }
+        std::sort(changed.begin(), changed.end());
+
+        std::vector<uint8_t> records(SNAPSHOT_HEADER_SIZE + m_count * RECORD_SIZE);
+        uint8_t* out = records.data() + SNAPSHOT_HEADER_SIZE;
+        size_t written = 0;
+        auto emit = [&](const StoreEntry& entry) {
+            if (written < m_count)
+            {
+                encodeRecord(entry, OP_PUT, out + written * RECORD_SIZE);
+            }
+            ++written;
+        };
+
+        // Merge the two sorted sequences, with the overlay taking precedence
+        size_t next_change = 0;
+        auto emitChangesBelow = [&](int64_t limit) {
+            for (; next_change < changed.size() && changed[next_change] < limit; ++next_change)
+            {
+                const auto& entry = m_delta.at(changed[next_change]);
+                if (entry)
+                {
+                    emit(*entry);
+                }
+            }
+        };
+        for (size_t i = 0; i < m_snapshot_count; ++i)
+        {
+            const uint8_t* record = m_snapshot_records + i * RECORD_SIZE;
+            const int64_t id = load<int64_t>(record);
+            emitChangesBelow(id);
+            if (m_delta.find(static_cast<int>(id)) == m_delta.end())
+            {
+                emit(decodeRecord(record));
+            }
+        }
+        emitChangesBelow(INT64_MAX);
+        if (written != m_count)
+        {
+            return false;
+        }
+
+        const uint64_t count = m_count;
+        const uint64_t checksum = snapshotChecksum(out, m_count);
+        std::memcpy(records.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        std::memcpy(records.data() + 8, &count, 8);
+        std::memcpy(records.data() + 16, &checksum, 8);
+
+        const fs::path snapshot_path = fs::path(m_root) / SNAPSHOT_FILE;
+        AtomicFile file;
+        if (!file.open(snapshot_path.string()) || !file.write(records.data(), records.size()))
+        {
+            file.abort();
+            return false;
+        }
+
+        // Windows cannot replace a file that is still mapped
+        m_snapshot.close();
+        m_snapshot_records = nullptr;
+        m_snapshot_count = 0;
+        const bool replaced = file.commit(true);
+        if (!loadSnapshot() || !replaced)
+        {
+            // The overlay still holds every change, so the count before the attempt stands
+            m_count = static_cast<size_t>(count);
+            return false;
+        }
+        m_delta.clear();
+
+        m_index.close();
+        m_index.open(fs::path(m_root) / INDEX_FILE, std::ios::binary | std::ios::trunc);
+        m_index.close();
+        m_index.open(fs::path(m_root) / INDEX_FILE, std::ios::binary | std::ios::app);
+        return m_index.is_open();
+    }
+
+    /**
+     * @brief Computes the content hash recorded in StoreEntry
+     *
+     * @param data File contents
+     * @param size Number of bytes at data
+     * @param hash Hash of the bytes preceding data, to hash a file in parts
+     * @return uint64_t FNV-1a 64 hash
+     */
+    uint64_t SoundStore::contentHash(const uint8_t* data, size_t size, uint64_t hash)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Records a written file in the index, removing a previous file under another name
+     *
+     * @param entry Entry of the file now in place
+     * @return bool True if the record reached the log
+     */
+    bool SoundStore::addEntry(const StoreEntry& entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto previous = lookup(entry.sound_id);
+        if (previous && storedPathFor(*previous) != storedPathFor(entry))
+        {
+            std::error_code ec;
+            fs::remove(storedPathFor(*previous), ec);
+        }
+
+        if (!appendRecord(entry, false))
+        {
+            return false;
+        }
+        m_delta[entry.sound_id] = entry;
+        m_count += previous ? 0 : 1;
+        return true;
+    }
+
+    /**
+     * @brief Appends one record to the index log; caller holds m_mutex
+     *
+     * @param entry Entry being written or removed
+     * @param removed True to record a removal
+     * @return bool True if the record reached the log
+     */
+    bool SoundStore::appendRecord(const StoreEntry& entry, bool removed)
+    {
+        if (!m_index.is_open())
+        {
+            return false;
+        }
+
+        uint8_t record[RECORD_SIZE];
+        encodeRecord(entry, removed ? OP_REMOVE : OP_PUT, record);
+        m_index.write(reinterpret_cast<const char*>(record), RECORD_SIZE);
+        m_index.flush();
+        return static_cast<bool>(m_index);
+    }
+
+    /**
+     * @brief Maps and validates the index snapshot; caller holds m_mutex
+     *
+     * A missing snapshot is an empty one, as in stores created before
+     * snapshots existed, whose whole history is still in the log.
+     *
+     * @return bool False if a snapshot exists but is unreadable or corrupt
+     */
+    bool SoundStore::loadSnapshot()
+    {
+        m_snapshot.close();
+        m_snapshot_records = nullptr;
+        m_snapshot_count = 0;
+        m_count = 0;
+
+        const fs::path snapshot_path = fs::path(m_root) / SNAPSHOT_FILE;
+        std::error_code ec;
+        if (!fs::exists(snapshot_path, ec))
+        {
+            return !ec;
+        }
+        if (!m_snapshot.open(snapshot_path.string()))
+        {
+            return false;
+        }
+
+        const uint8_t* data = m_snapshot.data();
+        const size_t size = m_snapshot.size();
+        if (size < SNAPSHOT_HEADER_SIZE || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        {
+            m_snapshot.close();
+            return false;
+        }
+
+        const uint64_t count = load<uint64_t>(data + 8);
+        if (count != (size - SNAPSHOT_HEADER_SIZE) / RECORD_SIZE
+            || (size - SNAPSHOT_HEADER_SIZE) % RECORD_SIZE != 0
+            || load<uint64_t>(data + 16) != snapshotChecksum(data + SNAPSHOT_HEADER_SIZE, static_cast<size_t>(count)))
+        {
+            m_snapshot.close();
+            return false;
+        }
+
+        m_snapshot_records = data + SNAPSHOT_HEADER_SIZE;
+        m_snapshot_count = static_cast<size_t>(count);
+        m_count = m_snapshot_count;
+        return true;
+    }
+
+    /**
+     * @brief Looks up a sound in the overlay, then the snapshot; caller holds m_mutex
+     *
+     * @param sound_id Freesound sound ID
+     * @return std::optional<StoreEntry> Index record, or std::nullopt if not stored
+     */
+    std::optional<StoreEntry> SoundStore::lookup(int sound_id) const
+    {
+        auto it = m_delta.find(sound_id);
+        if (it != m_delta.end())
+        {
+            return it->second;
+        }
+        return snapshotFind(sound_id);
+    }
+
+    /**
+     * @brief Binary-searches the snapshot records; caller holds m_mutex
+     *
+     * @param sound_id Freesound sound ID
+     * @return std::optional<StoreEntry> Snapshot record, or std::nullopt if absent
+     */
+    std::optional<StoreEntry> SoundStore::snapshotFind(int sound_id) const
+    {
+        size_t low = 0;
+        size_t high = m_snapshot_count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            const int64_t id = load<int64_t>(m_snapshot_records + middle * RECORD_SIZE);
+            if (id < sound_id)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (low < m_snapshot_count && load<int64_t>(m_snapshot_records + low * RECORD_SIZE) == sound_id)
+        {
+            return decodeRecord(m_snapshot_records + low * RECORD_SIZE);
+        }
+        return std::nullopt;
+    }
+}
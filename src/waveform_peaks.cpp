@@ -0,0 +1,357 @@
+/**
+ * @file src/waveform_peaks.cpp
+ * @brief Implementation of the waveform overview builder and peak files
+ *
+ * @see include/waveform_peaks.h
+ */
+
+#include "waveform_peaks.h"
+#include "atomic_file.h"
+#include "audio_decoder.h"
+#include "audio_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        /// Header: magic, sample rate, channels, level count, frames, reserved
+        const char PEAK_MAGIC[8] = {'F', 'S', 'P', 'E', 'A', 'K', '0', '1'};
+        constexpr size_t PEAK_HEADER_SIZE = 32;
+
+        /// Each level: frames per peak, peak count, then the minima and the maxima
+        constexpr size_t LEVEL_HEADER_SIZE = 8;
+
+        constexpr float PEAK_SCALE = 127.0f;
+
+        int8_t quantize(float value, bool round_up)
+        {
+            const float scaled = round_up ? std::ceil(value * PEAK_SCALE) : std::floor(value * PEAK_SCALE);
+            return static_cast<int8_t>(std::clamp(scaled, -PEAK_SCALE, PEAK_SCALE));
+        }
+
+        template <typename T>
+        T loadValue(const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void append(std::vector<uint8_t>& out, T value)
+        {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+
+        /**
+         * @brief Decodes a sound file in blocks and builds its overview
+         *
+         * @param path Sound file
+         * @param options Resolutions to build
+         * @return std::optional<WaveformPeaks> Overview, or std::nullopt if the file cannot be decoded
+         */
+        std::optional<WaveformPeaks> peaksOfFile(const std::string& path, const PeakOptions& options)
+        {
+            std::optional<PeakBuilder> builder;
+            const bool decoded = decodeAudioFile(path,
+                [&](const AudioStreamInfo& info, const float* samples, size_t frames) {
+                    if (!builder)
+                    {
+                        builder.emplace(info.channels, info.sample_rate, options);
+                    }
+                    builder->push(samples, frames);
+                    return true;
+                });
+
+            if (!decoded)
+            {
+                return std::nullopt;
+            }
+            return builder->finish();
+        }
+    }
+
+    /**
+     * @brief Returns the coarsest level that still has a peak per pixel
+     *
+     * @param width Pixels the waveform is drawn across
+     * @return const PeakLevel* Best level, the finest if none is detailed enough, or nullptr without levels
+     */
+    const PeakLevel* WaveformPeaks::levelFor(size_t width) const
+    {
+        if (levels.empty())
+        {
+            return nullptr;
+        }
+
+        const PeakLevel* best = &levels.front();
+        for (const PeakLevel& level : levels)
+        {
+            if (level.size() >= width)
+            {
+                best = &level;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Writes the overview to a compact peak file
+     *
+     * @param path Destination, usually peakPathFor() of the sound
+     * @param sync_first Flush the file to stable storage before it appears
+     * @return bool True if the file was written
+     */
+    bool WaveformPeaks::save(const std::string& path, bool sync_first) const
+    {
+        std::vector<uint8_t> out(PEAK_MAGIC, PEAK_MAGIC + sizeof(PEAK_MAGIC));
+        append<uint32_t>(out, sample_rate);
+        append<uint16_t>(out, channels);
+        append<uint16_t>(out, static_cast<uint16_t>(levels.size()));
+        append<uint64_t>(out, frames);
+        append<uint64_t>(out, 0);
+        for (const PeakLevel& level : levels)
+        {
+            if (level.max.size() != level.size() || level.size() > std::numeric_limits<uint32_t>::max())
+            {
+                return false;
+            }
+            append<uint32_t>(out, level.frames_per_peak);
+            append<uint32_t>(out, static_cast<uint32_t>(level.size()));
+            out.insert(out.end(), level.min.begin(), level.min.end());
+            out.insert(out.end(), level.max.begin(), level.max.end());
+        }
+
+        AtomicFile file;
+        if (!file.open(path) || !file.write(out.data(), out.size()))
+        {
+            file.abort();
+            return false;
+        }
+        return file.commit(sync_first);
+    }
+
+    /**
+     * @brief Reads a peak file written by save()
+     *
+     * @param path Peak file
+     * @return std::optional<WaveformPeaks> Overview, or std::nullopt if the file is missing or malformed
+     */
+    std::optional<WaveformPeaks> WaveformPeaks::load(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (bytes.size() < PEAK_HEADER_SIZE || std::memcmp(bytes.data(), PEAK_MAGIC, sizeof(PEAK_MAGIC)) != 0)
+        {
+            return std::nullopt;
+        }
+
+        WaveformPeaks peaks;
+        peaks.sample_rate = loadValue<uint32_t>(bytes.data() + 8);
+        peaks.channels = loadValue<uint16_t>(bytes.data() + 12);
+        const uint16_t level_count = loadValue<uint16_t>(bytes.data() + 14);
+        peaks.frames = loadValue<uint64_t>(bytes.data() + 16);
+
+        size_t offset = PEAK_HEADER_SIZE;
+        for (uint16_t l = 0; l < level_count; ++l)
+        {
+            if (bytes.size() - offset < LEVEL_HEADER_SIZE)
+            {
+                return std::nullopt;
+            }
+            PeakLevel level;
+            level.frames_per_peak = loadValue<uint32_t>(bytes.data() + offset);
+            const size_t count = loadValue<uint32_t>(bytes.data() + offset + 4);
+            offset += LEVEL_HEADER_SIZE;
+            if ((bytes.size() - offset) / 2 < count)
+            {
+                return std::nullopt;
+            }
+
+            const auto* values = reinterpret_cast<const int8_t*>(bytes.data() + offset);
+            level.min.assign(values, values + count);
+            level.max.assign(values + count, values + 2 * count);
+            offset += 2 * count;
+            peaks.levels.push_back(std::move(level));
+        }
+        return peaks;
+    }
+
+    /**
+     * @brief Prepares a builder
+     *
+     * @param channels Interleaved channels per frame
+     * @param sample_rate Rate recorded in the overview
+     * @param options Resolutions to build
+     * @throws std::invalid_argument If channels, frames_per_peak or levels is zero, or level_factor is below 2
+     */
+    PeakBuilder::PeakBuilder(uint16_t channels, uint32_t sample_rate, const PeakOptions& options)
+        : m_options(options)
+    {
+        if (channels == 0 || options.frames_per_peak == 0 || options.levels == 0 || options.level_factor < 2)
+        {
+            throw std::invalid_argument("PeakBuilder needs channels, a window size, levels and a level factor of 2 or more");
+        }
+
+        m_peaks.sample_rate = sample_rate;
+        m_peaks.channels = channels;
+        m_peaks.levels.resize(1);
+        m_peaks.levels[0].frames_per_peak = options.frames_per_peak;
+    }
+
+    /**
+     * @brief Adds the next frames of the sound
+     *
+     * @param samples Interleaved frames following those added before
+     * @param frames Number of frames at samples
+     */
+    void PeakBuilder::push(const float* samples, size_t frames)
+    {
+        m_peaks.frames += frames;
+        while (frames > 0)
+        {
+            const size_t take = std::min<size_t>(frames, m_options.frames_per_peak - m_window_frames);
+            const SampleRange range = measureRange(samples, take * m_peaks.channels);
+            m_min = m_window_frames ? std::min(m_min, range.min) : range.min;
+            m_max = m_window_frames ? std::max(m_max, range.max) : range.max;
+            m_window_frames += static_cast<uint32_t>(take);
+            if (m_window_frames == m_options.frames_per_peak)
+            {
+                closeWindow();
+            }
+
+            samples += take * m_peaks.channels;
+            frames -= take;
+        }
+    }
+
+    /**
+     * @brief Completes the overview once every frame has been added
+     *
+     * Each coarser level takes the extremes of level_factor peaks of the
+     * level below. Levels whose window would not fit in 32 bits are left out.
+     *
+     * @return WaveformPeaks Overview of all frames pushed
+     */
+    WaveformPeaks PeakBuilder::finish()
+    {
+        if (m_window_frames > 0)
+        {
+            closeWindow();
+        }
+
+        const size_t factor = m_options.level_factor;
+        while (m_peaks.levels.size() < m_options.levels)
+        {
+            const PeakLevel& finer = m_peaks.levels.back();
+            const uint64_t frames_per_peak = static_cast<uint64_t>(finer.frames_per_peak) * factor;
+            if (frames_per_peak > std::numeric_limits<uint32_t>::max())
+            {
+                break;
+            }
+
+            PeakLevel coarser;
+            coarser.frames_per_peak = static_cast<uint32_t>(frames_per_peak);
+            for (size_t i = 0; i < finer.size(); i += factor)
+            {
+                const size_t end = std::min(finer.size(), i + factor);
+                coarser.min.push_back(*std::min_element(finer.min.begin() + i, finer.min.begin() + end));
+                coarser.max.push_back(*std::max_element(finer.max.begin() + i, finer.max.begin() + end));
+            }
+            m_peaks.levels.push_back(std::move(coarser));
+        }
+
+        WaveformPeaks peaks = std::move(m_peaks);
+        m_peaks = WaveformPeaks();
+        return peaks;
+    }
+
+    /**
+     * @brief Appends the current window to the finest level
+     */
+    void PeakBuilder::closeWindow()
+    {
+        PeakLevel& finest = m_peaks.levels.front();
+        finest.min.push_back(quantize(m_min, false));
+        finest.max.push_back(quantize(m_max, true));
+        m_window_frames = 0;
+    }
+
+    /**
+     * @brief Returns the path of the peak file kept next to an audio file
+     *
+     * @param audio_path Sound file, e.g. `<dir>/1234.wav`
+     * @return std::string The same path with the extension `.peaks`
+     */
+    std::string peakPathFor(const std::string& audio_path)
+    {
+        return std::filesystem::path(audio_path).replace_extension(".peaks").string();
+    }
+
+    /**
+     * @brief Decodes audio files in parallel and writes a peak file next to each
+     *
+     * @param paths Sound files
+     * @param options Resolutions to build
+     * @param threads Worker threads (0 for one per hardware thread)
+     * @return std::vector<std::string> Paths whose peaks could not be generated
+     */
+    std::vector<std::string> generatePeakFiles(const std::vector<std::string>& paths,
+                                               const PeakOptions& options, unsigned threads)
+    {
+        // Reject bad options on the caller's thread rather than in a worker
+        PeakBuilder(1, 0, options);
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+
+        std::vector<char> failed(paths.size(), 0);
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < paths.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                const auto peaks = peaksOfFile(paths[i], options);
+                failed[i] = !peaks || !peaks->save(peakPathFor(paths[i]));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        if (threads > 0)
+        {
+            work();
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        std::vector<std::string> failures;
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            if (failed[i])
+            {
+                failures.push_back(paths[i]);
+            }
+        }
+        return failures;
+    }
+}
@@ -0,0 +1,371 @@
+/**
+ * @file src/write_behind.cpp
+ * @brief Implementation of the write-behind I/O stage
+ *
+ * @see include/write_behind.h
+ */
+
+#include "write_behind.h"
+#include "atomic_file.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace FreesoundDownloader
+{
+    /**
+     * @brief Starts writing at offset 0 of an open AtomicFile
+     *
+     * @param writer Write-behind stage performing the writes
+     * @param file Open AtomicFile receiving the data
+     * @param compute_md5 Hash the data as it is written
+     */
+    WriteBehindWriter::Stream::Stream(WriteBehindWriter& writer, AtomicFile& file, bool compute_md5)
+        : m_writer(writer), m_file(file), m_compute_md5(compute_md5)
+    {
+    }
+
+    /**
+     * @brief Finishes the stream if finish() was not called
+     */
+    WriteBehindWriter::Stream::~Stream()
+    {
+        finish();
+    }
+
+    /**
+     * @brief Appends bytes, blocking only while every pooled buffer is in use
+     *
+     * @param data Bytes to append
+     * @param size Number of bytes at data
+     * @return bool False once any write of this stream has failed
+     */
+    bool WriteBehindWriter::Stream::append(const void* data, size_t size)
+    {
+        if (m_finished || m_failed)
+        {
+            return false;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        const size_t capacity = m_writer.bufferSize();
+        while (size > 0)
+        {
+            if (!m_buffer)
+            {
+                m_buffer = m_writer.acquireBuffer();
+                m_fill = 0;
+            }
+
+            const size_t chunk = std::min(size, capacity - m_fill);
+            std::memcpy(m_buffer + m_fill, bytes, chunk);
+            m_fill += chunk;
+            m_size += chunk;
+            bytes += chunk;
+            size -= chunk;
+
+            if (m_fill == capacity)
+            {
+                queueCurrent();
+            }
+        }
+        return !m_failed;
+    }
+
+    /**
+     * @brief Queues buffered data and waits until all of it is on disk
+     *
+     * @return bool True if every byte was written
+     */
+    bool WriteBehindWriter::Stream::finish()
+    {
+        if (!m_finished)
+        {
+            m_finished = true;
+            if (m_buffer)
+            {
+                queueCurrent();
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_drained.wait(lock, [this]() { return m_pending == 0; });
+            if (m_compute_md5)
+            {
+                m_digest = m_md5.finish();
+            }
+        }
+        return !m_failed;
+    }
+
+    /**
+     * @brief Hands the current buffer to the I/O threads
+     */
+    void WriteBehindWriter::Stream::queueCurrent()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_pending;
+        }
+
+        WriteRequest request;
+        request.stream = this;
+        request.buffer = m_buffer;
+        request.length = m_fill;
+        request.offset = m_size - m_fill;
+        request.sequence = m_next_sequence++;
+        m_writer.enqueue(request);
+
+        m_buffer = nullptr;
+        m_fill = 0;
+    }
+
+    /**
+     * @brief Allocates the buffer pool and starts the I/O threads
+     *
+     * @param options Stage configuration
+     * @throws std::invalid_argument If io_threads, buffer_size or buffer_count is zero
+     */
+    WriteBehindWriter::WriteBehindWriter(const WriteBehindOptions& options)
+        : m_buffer_size(options.buffer_size),
+          m_free_buffers(std::max<size_t>(options.buffer_count, 1)),
+          m_requests(std::max<size_t>(options.buffer_count, 1))
+    {
+        if (options.io_threads == 0 || options.buffer_size == 0 || options.buffer_count == 0)
+        {
+            throw std::invalid_argument(
+                "WriteBehindWriter needs at least one I/O thread and one non-empty buffer");
+        }
+
+        m_memory.reset(new uint8_t[m_buffer_size * options.buffer_count]);
+        for (size_t i = 0; i < options.buffer_count; ++i)
+        {
+            m_free_buffers.tryPush(m_memory.get() + i * m_buffer_size);
+        }
+
+        for (unsigned i = 0; i < options.io_threads; ++i)
+        {
+            m_io_threads.emplace_back([this]() { ioLoop(); });
+        }
+    }
+
+    /**
+     * @brief Drains the queue and stops the I/O threads
+     */
+    WriteBehindWriter::~WriteBehindWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wait_mutex);
+            m_stopping = true;
+        }
+        m_work_ready.notify_all();
+
+        for (auto& thread : m_io_threads)
+        {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief Takes a buffer from the pool, waiting while all are in use
+     *
+     * @return uint8_t* Buffer of bufferSize() bytes
+     */
+    uint8_t* WriteBehindWriter::acquireBuffer()
+    {
+        uint8_t* buffer = nullptr;
+        if (m_free_buffers.tryPop(buffer))
+        {
+            return buffer;
+        }
+
+        m_stalls.fetch_add(1, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(m_wait_mutex);
+        m_waiting_streams.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!m_free_buffers.tryPop(buffer))
+        {
+            m_buffer_freed.wait(lock);
+        }
+        m_waiting_streams.fetch_sub(1);
+        return buffer;
+    }
+
+    /**
+     * @brief Returns a buffer to the pool and wakes a waiting stream
+     *
+     * @param buffer Buffer obtained from acquireBuffer()
+     */
+    void WriteBehindWriter::releaseBuffer(uint8_t* buffer)
+    {
+        // The pool holds every buffer, so this push cannot fail
+        m_free_buffers.tryPush(std::move(buffer));
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiting_streams.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_wait_mutex);
+            }
+            m_buffer_freed.notify_one();
+        }
+    }
+
+    /**
+     * @brief Queues a filled buffer and wakes an idle I/O thread
+     *
+     * @param request Buffer and its destination
+     */
+    void WriteBehindWriter::enqueue(WriteRequest request)
+    {
+        // One request per pooled buffer: the queue has room for all of them
+        m_requests.tryPush(std::move(request));
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_idle_workers.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_wait_mutex);
+            }
+            m_work_ready.notify_one();
+        }
+    }
+
+    /**
+     * @brief Pops the next request, sleeping while the queue is empty
+     *
+     * @param request Receives the request
+     * @return bool False once the writer is stopping and the queue is drained
+     */
+    bool WriteBehindWriter::waitForRequest(WriteRequest& request)
+    {
+        if (m_requests.tryPop(request))
+        {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wait_mutex);
+        m_idle_workers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!m_requests.tryPop(request))
+        {
+            if (m_stopping)
+            {
+                m_idle_workers.fetch_sub(1);
+                return false;
+            }
+            m_work_ready.wait(lock);
+        }
+        m_idle_workers.fetch_sub(1);
+        return true;
+    }
+
+    /**
+     * @brief Body of each I/O thread
+     *
+     * Takes up to Md5::LANES requests at a time so that buffers of
+     * different streams can be hashed together.
+     */
+    void WriteBehindWriter::ioLoop()
+    {
+        WriteRequest batch[Md5::LANES];
+        while (waitForRequest(batch[0]))
+        {
+            size_t count = 1;
+            while (count < Md5::LANES && m_requests.tryPop(batch[count]))
+            {
+                ++count;
+            }
+
+            size_t hashed = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                Stream& stream = *batch[i].stream;
+                if (!stream.m_file.writeAt(batch[i].buffer, batch[i].length, batch[i].offset))
+                {
+                    stream.m_failed = true;
+                }
+
+                if (stream.m_compute_md5)
+                {
+                    batch[hashed++] = batch[i];
+                    continue;
+                }
+
+                releaseBuffer(batch[i].buffer);
+
+                // Notify while holding the lock: the stream may be destroyed once it is released
+                std::lock_guard<std::mutex> lock(stream.m_mutex);
+                --stream.m_pending;
+                stream.m_drained.notify_all();
+            }
+
+            hashInOrder(batch, hashed);
+        }
+    }
+
+    /**
+     * @brief Hashes written buffers, each in its stream's order
+     *
+     * A buffer whose predecessor has not been hashed yet is parked on its
+     * stream; whichever thread hashes the predecessor picks it up next.
+     *
+     * @param requests Written requests of hashing streams (overwritten)
+     * @param count Number of requests
+     */
+    void WriteBehindWriter::hashInOrder(WriteRequest* requests, size_t count)
+    {
+        size_t ready = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Stream& stream = *requests[i].stream;
+            std::lock_guard<std::mutex> lock(stream.m_mutex);
+            if (!stream.m_hashing && stream.m_hash_sequence == requests[i].sequence)
+            {
+                stream.m_hashing = true;
+                requests[ready++] = requests[i];
+            }
+            else
+            {
+                stream.m_parked.push_back(requests[i]);
+            }
+        }
+
+        while (ready > 0)
+        {
+            Md5* hashers[Md5::LANES];
+            const uint8_t* data[Md5::LANES];
+            size_t sizes[Md5::LANES];
+            for (size_t i = 0; i < ready; ++i)
+            {
+                hashers[i] = &requests[i].stream->m_md5;
+                data[i] = requests[i].buffer;
+                sizes[i] = requests[i].length;
+            }
+            Md5::updateLanes(hashers, data, sizes, ready);
+
+            size_t next = 0;
+            for (size_t i = 0; i < ready; ++i)
+            {
+                Stream& stream = *requests[i].stream;
+                releaseBuffer(requests[i].buffer);
+
+                std::lock_guard<std::mutex> lock(stream.m_mutex);
+                ++stream.m_hash_sequence;
+                auto successor = std::find_if(stream.m_parked.begin(), stream.m_parked.end(),
+                    [&stream](const WriteRequest& parked) { return parked.sequence == stream.m_hash_sequence; });
+                if (successor != stream.m_parked.end())
+                {
+                    requests[next++] = *successor;
+                    stream.m_parked.erase(successor);
+                }
+                else
+                {
+                    stream.m_hashing = false;
+                }
+
+                // Notify while holding the lock: the stream may be destroyed once it is released
+                --stream.m_pending;
+                stream.m_drained.notify_all();
+            }
+            ready = next;
+        }
+    }
+}
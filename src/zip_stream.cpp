@@ -0,0 +1,1092 @@
+/**
+ * @file src/zip_stream.cpp
+ * @brief Implementation of the streaming zip extractor
+ *
+ * Archive layout read here (little-endian, PKWARE APPNOTE 6.3):
+ *   local header  30 bytes: signature, version, flags, method, time, date,
+ *                 CRC-32, compressed size, size, name length, extra length;
+ *                 then the name and the extra fields (Zip64 sizes: ID 0x0001)
+ *   data          the member, stored or raw deflate (RFC 1951)
+ *   descriptor    if flag bit 3 is set: signature, CRC-32, compressed size
+ *                 and size, the sizes 8 bytes wide for Zip64 members
+ * The central directory that follows the last member is skipped.
+ *
+ * @see include/zip_stream.h
+ */
+
+#include "zip_stream.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <optional>
+#include <stdexcept>
+
+namespace FreesoundDownloader
+{
+    namespace
+    {
+        constexpr uint32_t LOCAL_HEADER = 0x04034b50;
+        constexpr uint32_t DATA_DESCRIPTOR = 0x08074b50;
+        constexpr uint32_t CENTRAL_HEADER = 0x02014b50;
+        constexpr uint32_t END_OF_DIRECTORY = 0x06054b50;
+        constexpr uint32_t ZIP64_END_OF_DIRECTORY = 0x06064b50;
+
+        constexpr size_t LOCAL_HEADER_SIZE = 30;
+
+        /// General purpose flags
+        constexpr uint16_t ENCRYPTED = 1;
+        constexpr uint16_t SIZES_FOLLOW = 8;
+
+        /// Compression methods
+        constexpr uint16_t STORED = 0;
+        constexpr uint16_t DEFLATED = 8;
+
+        uint16_t loadLe16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+
+        uint32_t loadLe32(const uint8_t* p)
+        {
+            return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+        }
+
+        uint64_t loadLe64(const uint8_t* p) { return loadLe32(p) | uint64_t(loadLe32(p + 4)) << 32; }
+
+        /**
+         * @brief Builds the tables of slice-by-8 CRC-32 (reflected polynomial 0xEDB88320)
+         */
+        struct CrcTables
+        {
+            uint32_t table[8][256];
+
+            CrcTables()
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+                    }
+                    table[0][i] = crc;
+                }
+                for (int slice = 1; slice < 8; ++slice)
+                {
+                    for (int i = 0; i < 256; ++i)
+                    {
+                        const uint32_t previous = table[slice - 1][i];
+                        table[slice][i] = (previous >> 8) ^ table[0][previous & 255];
+                    }
+                }
+            }
+        };
+
+        /**
+         * @brief Continues the CRC-32 of a zip member over more bytes
+         *
+         * @param crc CRC-32 of the bytes before (0 to start)
+         */
+        uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc)
+        {
+            static const CrcTables tables;
+            const auto& t = tables.table;
+            crc = ~crc;
+            for (; size >= 8; data += 8, size -= 8)
+            {
+                const uint32_t one = loadLe32(data) ^ crc;
+                const uint32_t two = loadLe32(data + 4);
+                crc = t[7][one & 255] ^ t[6][(one >> 8) & 255] ^ t[5][(one >> 16) & 255] ^ t[4][one >> 24]
+                    ^ t[3][two & 255] ^ t[2][(two >> 8) & 255] ^ t[1][(two >> 16) & 255] ^ t[0][two >> 24];
+            }
+            for (; size > 0; ++data, --size)
+            {
+                crc = t[0][(crc ^ *data) & 255] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        /**
+         * @class InflateBits
+         * @brief Reads a deflate stream least significant bit first
+         *
+         * Reading past the end yields zero bits; overrun() tells afterwards
+         * whether any of them were consumed.
+         */
+        class InflateBits
+        {
+        public:
+            InflateBits(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+            /// Returns the next count (at most 32) bits without consuming them
+            uint32_t peek(int count)
+            {
+                if (m_count < count)
+                {
+                    refill();
+                }
+                return static_cast<uint32_t>(m_bits & ((uint64_t(1) << count) - 1));
+            }
+
+            void skip(int count)
+            {
+                m_bits >>= count;
+                m_count -= count;
+                m_consumed += static_cast<uint64_t>(count);
+            }
+
+            uint32_t take(int count)
+            {
+                const uint32_t value = peek(count);
+                skip(count);
+                return value;
+            }
+
+            /**
+             * @brief Moves to the next byte boundary
+             *
+             * @return size_t Offset of that byte in the stream
+             */
+            size_t align()
+            {
+                skip(m_count & 7);
+                return static_cast<size_t>(m_consumed / 8);
+            }
+
+            /// Continues reading at a byte offset
+            void seek(size_t offset)
+            {
+                m_position = offset;
+                m_consumed = uint64_t(offset) * 8;
+                m_bits = 0;
+                m_count = 0;
+            }
+
+            bool overrun() const { return m_consumed > uint64_t(m_size) * 8; }
+
+        private:
+            void refill()
+            {
+                while (m_count <= 56)
+                {
+                    const uint64_t byte = m_position < m_size ? m_data[m_position] : 0;
+                    ++m_position;
+                    m_bits |= byte << m_count;
+                    m_count += 8;
+                }
+            }
+
+            const uint8_t* m_data;
+            size_t m_size;
+            size_t m_position = 0;
+            uint64_t m_bits = 0;
+            int m_count = 0;
+            uint64_t m_consumed = 0;
+        };
+
+        /**
+         * @class Huffman
+         * @brief Canonical Huffman code of a deflate block
+         *
+         * Codes of up to FAST_BITS bits are resolved by one table lookup;
+         * longer ones are walked a bit at a time through the code counts.
+         */
+        class Huffman
+        {
+        public:
+            static constexpr int FAST_BITS = 10;
+            static constexpr int MAX_BITS = 15;
+
+            /**
+             * @brief Builds the code from the length of each symbol's code
+             *
+             * @return bool False if the lengths describe more codes than fit
+             */
+            bool build(const uint8_t* lengths, int count)
+            {
+                std::fill(std::begin(m_count), std::end(m_count), uint16_t(0));
+                for (int symbol = 0; symbol < count; ++symbol)
+                {
+                    ++m_count[lengths[symbol]];
+                }
+                m_count[0] = 0;
+                int left = 1;
+                for (int length = 1; length <= MAX_BITS; ++length)
+                {
+                    left = (left << 1) - m_count[length];
+                    if (left < 0)
+                    {
+                        return false;
+                    }
+                }
+
+                uint16_t offsets[MAX_BITS + 2] = {};
+                uint32_t next_code[MAX_BITS + 2] = {};
+                for (int length = 1; length <= MAX_BITS; ++length)
+                {
+                    offsets[length + 1] = static_cast<uint16_t>(offsets[length] + m_count[length]);
+                    next_code[length + 1] = (next_code[length] + m_count[length]) << 1;
+                }
+                std::fill(std::begin(m_fast), std::end(m_fast), uint16_t(0));
+                for (int symbol = 0; symbol < count; ++symbol)
+                {
+                    const int length = lengths[symbol];
+                    if (length == 0)
+                    {
+                        continue;
+                    }
+                    m_symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+                    const uint32_t code = next_code[length]++;
+                    if (length <= FAST_BITS)
+                    {
+                        uint32_t reversed = 0;
+                        for (int bit = 0; bit < length; ++bit)
+                        {
+                            reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+                        }
+                        for (uint32_t i = reversed; i < (1u << FAST_BITS); i += 1u << length)
+                        {
+                            m_fast[i] = static_cast<uint16_t>(symbol << 4 | length);
+                        }
+                    }
+                }
+                return true;
+            }
+
+            /// Returns the next symbol, or -1 for a code that is not in use
+            int decode(InflateBits& bits) const
+            {
+                const uint16_t entry = m_fast[bits.peek(FAST_BITS)];
+                if (entry != 0)
+                {
+                    bits.skip(entry & 15);
+                    return entry >> 4;
+                }
+                int code = 0;
+                int first = 0;
+                int index = 0;
+                for (int length = 1; length <= MAX_BITS; ++length)
+                {
+                    code |= static_cast<int>(bits.take(1));
+                    const int count = m_count[length];
+                    if (code - first < count)
+                    {
+                        return m_symbols[index + code - first];
+                    }
+                    index += count;
+                    first = (first + count) << 1;
+                    code <<= 1;
+                }
+                return -1;
+            }
+
+        private:
+            uint16_t m_fast[1 << FAST_BITS];
+            uint16_t m_count[MAX_BITS + 1];
+            uint16_t m_symbols[288];
+        };
+
+        const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                          31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                          2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        const uint16_t DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                            33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        /// Order in which a dynamic block lists the lengths of the code length code
+        const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        /**
+         * @brief Codes of the fixed Huffman blocks
+         */
+        struct FixedCodes
+        {
+            Huffman literals;
+            Huffman distances;
+
+            FixedCodes()
+            {
+                uint8_t lengths[288];
+                std::fill(lengths, lengths + 144, uint8_t(8));
+                std::fill(lengths + 144, lengths + 256, uint8_t(9));
+                std::fill(lengths + 256, lengths + 280, uint8_t(7));
+                std::fill(lengths + 280, lengths + 288, uint8_t(8));
+                literals.build(lengths, 288);
+                std::fill(lengths, lengths + 30, uint8_t(5));
+                distances.build(lengths, 30);
+            }
+        };
+
+        /**
+         * @brief Reads the code lengths of a dynamic block and builds its codes
+         */
+        bool readDynamicCodes(InflateBits& bits, Huffman& literals, Huffman& distances)
+        {
+            const int literal_count = static_cast<int>(bits.take(5)) + 257;
+            const int distance_count = static_cast<int>(bits.take(5)) + 1;
+            const int length_count = static_cast<int>(bits.take(4)) + 4;
+            if (literal_count > 286 || distance_count > 30)
+            {
+                return false;
+            }
+
+            uint8_t lengths[286 + 30] = {};
+            for (int i = 0; i < length_count; ++i)
+            {
+                lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(bits.take(3));
+            }
+            Huffman length_code;
+            if (!length_code.build(lengths, 19))
+            {
+                return false;
+            }
+
+            const int total = literal_count + distance_count;
+            std::fill(lengths, lengths + 19, uint8_t(0));
+            for (int i = 0; i < total;)
+            {
+                const int symbol = length_code.decode(bits);
+                if (symbol < 0)
+                {
+                    return false;
+                }
+                if (symbol < 16)
+                {
+                    lengths[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint8_t repeated = 0;
+                int repeat = 0;
+                if (symbol == 16)
+                {
+                    if (i == 0)
+                    {
+                        return false;
+                    }
+                    repeated = lengths[i - 1];
+                    repeat = 3 + static_cast<int>(bits.take(2));
+                }
+                else if (symbol == 17)
+                {
+                    repeat = 3 + static_cast<int>(bits.take(3));
+                }
+                else
+                {
+                    repeat = 11 + static_cast<int>(bits.take(7));
+                }
+                if (i + repeat > total)
+                {
+                    return false;
+                }
+                std::fill(lengths + i, lengths + i + repeat, repeated);
+                i += repeat;
+            }
+
+            // A block without an end-of-block code could never finish
+            return lengths[256] != 0 && literals.build(lengths, literal_count)
+                && distances.build(lengths + literal_count, distance_count);
+        }
+
+        /**
+         * @class InflateOutput
+         * @brief Decompressed bytes, grown as they are produced up to the size the archive declares
+         *
+         * Memory follows the output actually decoded, so a damaged header
+         * that declares a huge size costs nothing unless the stream really
+         * expands that far.
+         */
+        class InflateOutput
+        {
+        public:
+            explicit InflateOutput(size_t limit) : m_limit(limit) {}
+
+            /// Makes room for count more bytes; false if they would pass the limit
+            bool reserve(size_t count)
+            {
+                if (count > m_limit - m_size)
+                {
+                    return false;
+                }
+                if (count > m_bytes.size() - m_size)
+                {
+                    m_bytes.resize(std::min(m_limit, std::max(m_size + count, m_bytes.size() * 2 + 65536)));
+                }
+                return true;
+            }
+
+            /// First byte after the output so far; valid until the next reserve()
+            uint8_t* end() { return m_bytes.data() + m_size; }
+
+            void advance(size_t count) { m_size += count; }
+
+            size_t size() const { return m_size; }
+
+            /// Hands over the output, trimmed to the bytes produced
+            std::vector<uint8_t> release()
+            {
+                m_bytes.resize(m_size);
+                return std::move(m_bytes);
+            }
+
+        private:
+            std::vector<uint8_t> m_bytes;
+            size_t m_size = 0;
+            size_t m_limit;
+        };
+
+        /**
+         * @brief Decodes the symbols of one Huffman block
+         */
+        bool inflateCodes(InflateBits& bits, const Huffman& literals, const Huffman& distances, InflateOutput& out)
+        {
+            for (;;)
+            {
+                const int symbol = literals.decode(bits);
+                if (symbol < 256)
+                {
+                    if (symbol < 0 || !out.reserve(1))
+                    {
+                        return false;
+                    }
+                    *out.end() = static_cast<uint8_t>(symbol);
+                    out.advance(1);
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    return !bits.overrun();
+                }
+                const int length_symbol = symbol - 257;
+                if (length_symbol >= 29)
+                {
+                    return false;
+                }
+                const size_t length = LENGTH_BASE[length_symbol] + bits.take(LENGTH_EXTRA[length_symbol]);
+                const int distance_symbol = distances.decode(bits);
+                if (distance_symbol < 0 || distance_symbol >= 30)
+                {
+                    return false;
+                }
+                const size_t distance = DISTANCE_BASE[distance_symbol] + bits.take(DISTANCE_EXTRA[distance_symbol]);
+                if (distance > out.size() || !out.reserve(length))
+                {
+                    return false;
+                }
+                uint8_t* target = out.end();
+                const uint8_t* source = target - distance;
+                if (distance >= length)
+                {
+                    std::memcpy(target, source, length);
+                }
+                else
+                {
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        target[i] = source[i];
+                    }
+                }
+                out.advance(length);
+            }
+        }
+
+        /**
+         * @brief Inflates a raw deflate stream of known decompressed size
+         *
+         * @param data Compressed bytes
+         * @param size Number of bytes at data
+         * @param expected Decompressed size recorded in the archive
+         * @return std::optional<std::vector<uint8_t>> Decompressed bytes, or std::nullopt if the
+         *         stream is damaged, ends early or does not decompress to expected bytes
+         * @throws std::bad_alloc If the output does not fit in memory
+         */
+        std::optional<std::vector<uint8_t>> inflateRaw(const uint8_t* data, size_t size, size_t expected)
+        {
+            static const FixedCodes fixed;
+            InflateBits bits(data, size);
+            InflateOutput out(expected);
+            Huffman literals;
+            Huffman distances;
+            bool last = false;
+            while (!last)
+            {
+                last = bits.take(1) != 0;
+                switch (bits.take(2))
+                {
+                    case 0:
+                    {
+                        const size_t start = bits.align();
+                        if (start + 4 > size)
+                        {
+                            return std::nullopt;
+                        }
+                        const size_t length = loadLe16(data + start);
+                        if ((length ^ 0xFFFF) != loadLe16(data + start + 2) || length > size - start - 4
+                            || !out.reserve(length))
+                        {
+                            return std::nullopt;
+                        }
+                        if (length > 0)
+                        {
+                            std::memcpy(out.end(), data + start + 4, length);
+                        }
+                        out.advance(length);
+                        bits.seek(start + 4 + length);
+                        break;
+                    }
+                    case 1:
+                        if (!inflateCodes(bits, fixed.literals, fixed.distances, out))
+                        {
+                            return std::nullopt;
+                        }
+                        break;
+                    case 2:
+                        if (!readDynamicCodes(bits, literals, distances)
+                            || !inflateCodes(bits, literals, distances, out))
+                        {
+                            return std::nullopt;
+                        }
+                        break;
+                    default:
+                        return std::nullopt;
+                }
+            }
+            if (bits.overrun() || out.size() != expected)
+            {
+                return std::nullopt;
+            }
+            return out.release();
+        }
+
+        /**
+         * @brief Turns a member name into a path relative to the output directory
+         *
+         * Backslashes are taken as separators, and empty and "." components
+         * are dropped.
+         *
+         * @return std::optional<std::string> Relative path (empty for the
+         *         directory itself), or std::nullopt if the name is absolute
+         *         or contains ".."
+         */
+        std::optional<std::string> relativePath(std::string name)
+        {
+            std::replace(name.begin(), name.end(), '\\', '/');
+            if (!name.empty() && name[0] == '/')
+            {
+                return std::nullopt;
+            }
+            std::string path;
+            size_t start = 0;
+            while (start <= name.size())
+            {
+                const size_t end = std::min(name.find('/', start), name.size());
+                const std::string component = name.substr(start, end - start);
+                start = end + 1;
+                if (component.empty() || component == ".")
+                {
+                    continue;
+                }
+                if (component == ".." || (path.empty() && component.find(':') != std::string::npos))
+                {
+                    return std::nullopt;
+                }
+                if (!path.empty())
+                {
+                    path += '/';
+                }
+                path += component;
+            }
+            return path;
+        }
+    }
+
+    /// Member of the archive on its way from the parser to disk
+    struct ZipStreamExtractor::Member
+    {
+        std::string name;
+        std::string path;
+        uint16_t flags = 0;
+        uint16_t method = STORED;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        bool zip64 = false;
+
+        /// Directory entry, whose data is skipped
+        bool directory = false;
+
+        /// Compressed bytes received so far
+        uint64_t received = 0;
+
+        /// Stored member of known size, written through as it arrives
+        AtomicFile file;
+        uint32_t running_crc = 0;
+
+        /// Collected data of any other member
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * @brief Starts the worker threads
+     *
+     * @param output_dir Directory receiving the members (created if missing)
+     * @param options Threads, memory bound and durability
+     * @throws std::invalid_argument If max_pending_bytes is zero
+     */
+    ZipStreamExtractor::ZipStreamExtractor(const std::string& output_dir, const UnzipOptions& options)
+        : m_output_dir(output_dir), m_options(options)
+    {
+        if (options.max_pending_bytes == 0)
+        {
+            throw std::invalid_argument("UnzipOptions::max_pending_bytes must not be zero");
+        }
+        std::error_code error;
+        std::filesystem::create_directories(output_dir, error);
+
+        const unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+        for (unsigned i = 0; i < std::max(1u, threads); ++i)
+        {
+            m_workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    /**
+     * @brief Stops the worker threads; members not yet complete are discarded
+     */
+    ZipStreamExtractor::~ZipStreamExtractor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_queue.clear();
+        }
+        m_work.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Parses the next bytes of the archive
+     *
+     * @param data Bytes following those of the previous call
+     * @param size Number of bytes at data
+     * @return bool False once the archive is found to be damaged, uses an
+     *         unsupported feature or a member cannot be written
+     */
+    bool ZipStreamExtractor::push(const void* data, size_t size)
+    {
+        bool worker_failed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            worker_failed = m_worker_failed;
+        }
+        if (worker_failed && m_state != State::Failed)
+        {
+            fail();
+        }
+        if (m_state == State::Failed)
+        {
+            return false;
+        }
+
+        // Bytes are only copied aside when a header or descriptor straddles two calls
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        if (m_input.empty())
+        {
+            const size_t used = consume(bytes, size);
+            if (m_state != State::Failed)
+            {
+                m_input.assign(bytes + used, bytes + size);
+            }
+        }
+        else
+        {
+            m_input.insert(m_input.end(), bytes, bytes + size);
+            const size_t used = consume(m_input.data(), m_input.size());
+            if (m_state != State::Failed)
+            {
+                m_input.erase(m_input.begin(), m_input.begin() + static_cast<std::ptrdiff_t>(used));
+            }
+        }
+        return m_state != State::Failed;
+    }
+
+    /**
+     * @brief Waits for the members still being extracted
+     *
+     * @return bool True if the archive ended after its last member and
+     *         every member was extracted
+     */
+    bool ZipStreamExtractor::finish()
+    {
+        if (m_state != State::End)
+        {
+            fail();
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_space.wait(lock, [this]() { return m_queue.empty() && m_busy == 0; });
+        return m_state == State::End && !m_worker_failed;
+    }
+
+    /**
+     * @brief Runs the parser over bytes for as long as it makes progress
+     *
+     * @return size_t Number of bytes consumed; the rest must be passed again with more
+     */
+    size_t ZipStreamExtractor::consume(const uint8_t* data, size_t size)
+    {
+        size_t used = 0;
+        for (;;)
+        {
+            const State state = m_state;
+            const size_t before = used;
+            switch (m_state)
+            {
+                case State::Header:
+                    parseHeader(data, size, used);
+                    break;
+                case State::Data:
+                    parseData(data, size, used);
+                    break;
+                case State::End:
+                    // The central directory and anything after it
+                    return size;
+                case State::Failed:
+                    return used;
+            }
+            if (m_state == state && used == before)
+            {
+                return used;
+            }
+        }
+    }
+
+    /**
+     * @brief Reads a local file header once all of it has arrived
+     */
+    void ZipStreamExtractor::parseHeader(const uint8_t* data, size_t size, size_t& used)
+    {
+        const uint8_t* header = data + used;
+        const size_t available = size - used;
+        if (available < 4)
+        {
+            return;
+        }
+        const uint32_t signature = loadLe32(header);
+        if (signature == CENTRAL_HEADER || signature == END_OF_DIRECTORY || signature == ZIP64_END_OF_DIRECTORY)
+        {
+            m_state = State::End;
+            return;
+        }
+        if (signature != LOCAL_HEADER)
+        {
+            fail();
+            return;
+        }
+        if (available < LOCAL_HEADER_SIZE)
+        {
+            return;
+        }
+        const size_t name_length = loadLe16(header + 26);
+        const size_t extra_length = loadLe16(header + 28);
+        if (available < LOCAL_HEADER_SIZE + name_length + extra_length)
+        {
+            return;
+        }
+
+        uint64_t compressed_size = loadLe32(header + 18);
+        uint64_t member_size = loadLe32(header + 22);
+        bool zip64 = false;
+        const uint8_t* extra = header + LOCAL_HEADER_SIZE + name_length;
+        for (size_t offset = 0; offset + 4 <= extra_length;)
+        {
+            const uint16_t id = loadLe16(extra + offset);
+            const size_t length = loadLe16(extra + offset + 2);
+            const uint8_t* field = extra + offset + 4;
+            offset += 4 + length;
+            if (offset > extra_length)
+            {
+                break;
+            }
+            if (id != 0x0001)
+            {
+                continue;
+            }
+            // Local headers hold both sizes; only the saturated ones are required to be there
+            zip64 = true;
+            size_t read = 0;
+            if ((member_size == 0xFFFFFFFF || length >= 16) && read + 8 <= length)
+            {
+                member_size = loadLe64(field + read);
+                read += 8;
+            }
+            if ((compressed_size == 0xFFFFFFFF || length >= 16) && read + 8 <= length)
+            {
+                compressed_size = loadLe64(field + read);
+            }
+        }
+
+        const std::string name(reinterpret_cast<const char*>(header + LOCAL_HEADER_SIZE), name_length);
+        used += LOCAL_HEADER_SIZE + name_length + extra_length;
+        beginMember(name, loadLe16(header + 6), loadLe16(header + 8), loadLe32(header + 14), compressed_size,
+                    member_size, zip64);
+    }
+
+    /**
+     * @brief Prepares to receive the data of a member
+     */
+    void ZipStreamExtractor::beginMember(const std::string& name, uint16_t flags, uint16_t method,
+                                         uint32_t crc, uint64_t compressed_size, uint64_t size, bool zip64)
+    {
+        const auto relative = relativePath(name);
+        if ((flags & ENCRYPTED) || (method != STORED && method != DEFLATED) || !relative)
+        {
+            fail();
+            return;
+        }
+
+        auto member = std::make_unique<Member>();
+        member->name = name;
+        member->flags = flags;
+        member->method = method;
+        member->zip64 = zip64;
+        member->directory = relative->empty() || name.back() == '/' || name.back() == '\\';
+        const auto path = std::filesystem::path(m_output_dir) / std::filesystem::path(*relative);
+        member->path = path.string();
+        std::error_code error;
+        std::filesystem::create_directories(member->directory ? path : path.parent_path(), error);
+
+        if (!(flags & SIZES_FOLLOW))
+        {
+            member->crc = crc;
+            member->compressed_size = compressed_size;
+            member->size = size;
+            if (method == STORED && !member->directory)
+            {
+                if (compressed_size != size || !member->file.open(member->path)
+                    || (size > 0 && !member->file.preallocate(size)))
+                {
+                    fail();
+                    return;
+                }
+            }
+            else if (!member->directory)
+            {
+                member->data.reserve(static_cast<size_t>(std::min<uint64_t>(compressed_size,
+                                                                            m_options.max_pending_bytes)));
+            }
+        }
+        m_member = std::move(member);
+        m_state = State::Data;
+    }
+
+    /**
+     * @brief Takes in the data of the current member
+     *
+     * A member whose sizes follow its data ends at the first data descriptor
+     * signature that is followed by a compressed size equal to the number of
+     * bytes before it. Until such a descriptor has arrived in full, the last
+     * bytes are left unconsumed in case it starts among them.
+     */
+    void ZipStreamExtractor::parseData(const uint8_t* data, size_t size, size_t& used)
+    {
+        Member& member = *m_member;
+        const uint8_t* bytes = data + used;
+        const size_t available = size - used;
+
+        if (!(member.flags & SIZES_FOLLOW))
+        {
+            const auto count = static_cast<size_t>(std::min<uint64_t>(available,
+                                                                      member.compressed_size - member.received));
+            if (member.file.isOpen())
+            {
+                if (count > 0 && !member.file.write(bytes, count))
+                {
+                    fail();
+                    return;
+                }
+                member.running_crc = crc32(bytes, count, member.running_crc);
+            }
+            else if (!member.directory)
+            {
+                member.data.insert(member.data.end(), bytes, bytes + count);
+            }
+            member.received += count;
+            used += count;
+            if (member.received == member.compressed_size)
+            {
+                if (member.file.isOpen() && member.running_crc != member.crc)
+                {
+                    fail();
+                    return;
+                }
+                endMember();
+            }
+            return;
+        }
+
+        const size_t descriptor_size = member.zip64 ? 24 : 16;
+        size_t end = 0;
+        bool found = false;
+        for (size_t i = 0; i + descriptor_size <= available; ++i)
+        {
+            const void* candidate = std::memchr(bytes + i, 'P', available - descriptor_size + 1 - i);
+            if (candidate == nullptr)
+            {
+                break;
+            }
+            i = static_cast<size_t>(static_cast<const uint8_t*>(candidate) - bytes);
+            if (loadLe32(bytes + i) != DATA_DESCRIPTOR)
+            {
+                continue;
+            }
+            const uint64_t compressed_size = member.zip64 ? loadLe64(bytes + i + 8) : loadLe32(bytes + i + 8);
+            if (compressed_size == member.received + i)
+            {
+                end = i;
+                found = true;
+                break;
+            }
+        }
+
+        const size_t count = found ? end : (available >= descriptor_size ? available - descriptor_size + 1 : 0);
+        if (!member.directory)
+        {
+            member.data.insert(member.data.end(), bytes, bytes + count);
+        }
+        member.received += count;
+        used += count;
+        if (found)
+        {
+            const uint8_t* descriptor = bytes + end;
+            member.crc = loadLe32(descriptor + 4);
+            member.compressed_size = member.received;
+            member.size = member.zip64 ? loadLe64(descriptor + 16) : loadLe32(descriptor + 12);
+            used += descriptor_size;
+            endMember();
+        }
+    }
+
+    /**
+     * @brief Hands a complete member to the workers
+     *
+     * Blocks while the compressed bytes already queued and those of this
+     * member together exceed max_pending_bytes.
+     */
+    void ZipStreamExtractor::endMember()
+    {
+        auto member = std::move(m_member);
+        m_state = State::Header;
+        if (member->directory)
+        {
+            return;
+        }
+        m_members.push_back({member->name, member->path, member->size});
+
+        const size_t cost = member->data.size();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_space.wait(lock, [&]() {
+                return m_worker_failed || m_pending_bytes == 0 || m_pending_bytes + cost <= m_options.max_pending_bytes;
+            });
+            if (!m_worker_failed)
+            {
+                m_pending_bytes += cost;
+                m_queue.push_back(std::move(member));
+            }
+        }
+        m_work.notify_one();
+    }
+
+    /**
+     * @brief Gives up on the archive and drops the members no worker has started
+     */
+    void ZipStreamExtractor::fail()
+    {
+        m_state = State::Failed;
+        m_member.reset();
+        m_input.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& member : m_queue)
+            {
+                m_pending_bytes -= member->data.size();
+            }
+            m_queue.clear();
+        }
+        m_space.notify_all();
+    }
+
+    /**
+     * @brief Inflates, checks and commits queued members until stopped
+     */
+    void ZipStreamExtractor::workerLoop()
+    {
+        const bool sync = m_options.sync_policy != SyncPolicy::None;
+        for (;;)
+        {
+            std::unique_ptr<Member> member;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                member = std::move(m_queue.front());
+                m_queue.pop_front();
+                ++m_busy;
+            }
+
+            const size_t cost = member->data.size();
+            bool ok = false;
+            if (member->file.isOpen())
+            {
+                ok = member->file.commit(sync);
+            }
+            else
+            {
+                // A worker has nothing to report an exception to; running out of memory fails the member
+                try
+                {
+                    std::optional<std::vector<uint8_t>> inflated;
+                    const std::vector<uint8_t>* contents = &member->data;
+                    if (member->method == DEFLATED)
+                    {
+                        if (member->size <= SIZE_MAX)
+                        {
+                            inflated = inflateRaw(member->data.data(), member->data.size(),
+                                                  static_cast<size_t>(member->size));
+                        }
+                        ok = inflated.has_value();
+                        contents = ok ? &*inflated : contents;
+                    }
+                    else
+                    {
+                        ok = member->data.size() == member->size;
+                    }
+                    AtomicFile file;
+                    ok = ok && crc32(contents->data(), contents->size(), 0) == member->crc
+                        && file.open(member->path)
+                        && (contents->empty() || file.write(contents->data(), contents->size()))
+                        && file.commit(sync);
+                }
+                catch (const std::bad_alloc&)
+                {
+                    ok = false;
+                }
+            }
+            member.reset();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending_bytes -= cost;
+                --m_busy;
+                m_worker_failed = m_worker_failed || !ok;
+            }
+            m_space.notify_all();
+        }
+    }
+}
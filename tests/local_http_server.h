@@ -0,0 +1,225 @@
+#pragma once
+
+// Minimal HTTP/1.1 server on 127.0.0.1 for tests that need a real transfer.
+// Bodies can be throttled to imitate a slow link; Range requests are honoured.
+
+#ifndef _WIN32
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    namespace Testing
+    {
+        class LocalHttpServer
+        {
+        public:
+            /**
+             * @param chunk_size Bytes sent per chunk (0 sends each body at once)
+             * @param chunk_interval Pause after each chunk
+             */
+            explicit LocalHttpServer(size_t chunk_size = 0,
+                std::chrono::milliseconds chunk_interval = std::chrono::milliseconds(0))
+                : m_chunk_size(chunk_size), m_chunk_interval(chunk_interval)
+            {
+                m_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                address.sin_port = 0;
+                socklen_t length = sizeof(address);
+                if (m_listen_fd < 0
+                    || ::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+                    || ::listen(m_listen_fd, 64) != 0
+                    || ::getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+                {
+                    throw std::runtime_error("LocalHttpServer could not listen on 127.0.0.1");
+                }
+                m_port = ntohs(address.sin_port);
+                m_accept_thread = std::thread([this]() { acceptLoop(); });
+            }
+
+            ~LocalHttpServer()
+            {
+                m_stopping = true;
+                m_accept_thread.join();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (auto& thread : m_connections)
+                {
+                    thread.join();
+                }
+                ::close(m_listen_fd);
+            }
+
+            LocalHttpServer(const LocalHttpServer&) = delete;
+            LocalHttpServer& operator=(const LocalHttpServer&) = delete;
+
+            /// Serves body at path (query strings are ignored when matching)
+            void serve(const std::string& path, std::string body)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_routes[path] = std::move(body);
+            }
+
+            std::string url(const std::string& path = "/") const
+            {
+                return "http://127.0.0.1:" + std::to_string(m_port) + path;
+            }
+
+            /// Requests received so far, as "<path> <range header or empty>"
+            std::vector<std::string> requests() const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_requests;
+            }
+
+        private:
+            void acceptLoop()
+            {
+                while (!m_stopping)
+                {
+                    pollfd descriptor{m_listen_fd, POLLIN, 0};
+                    if (::poll(&descriptor, 1, 20) <= 0)
+                    {
+                        continue;
+                    }
+                    const int client = ::accept(m_listen_fd, nullptr, nullptr);
+                    if (client >= 0)
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_connections.emplace_back([this, client]() { handle(client); });
+                    }
+                }
+            }
+
+            void handle(int client)
+            {
+                std::string request;
+                char buffer[4096];
+                while (request.find("\r\n\r\n") == std::string::npos)
+                {
+                    const ssize_t received = ::recv(client, buffer, sizeof(buffer), 0);
+                    if (received <= 0)
+                    {
+                        ::close(client);
+                        return;
+                    }
+                    request.append(buffer, static_cast<size_t>(received));
+                }
+
+                const size_t path_start = request.find(' ') + 1;
+                std::string path = request.substr(path_start, request.find(' ', path_start) - path_start);
+                path = path.substr(0, path.find('?'));
+
+                std::string range;
+                for (const char* name : {"\r\nRange: ", "\r\nrange: "})
+                {
+                    const size_t at = request.find(name);
+                    if (at != std::string::npos)
+                    {
+                        const size_t value = at + 9;
+                        range = request.substr(value, request.find("\r\n", value) - value);
+                    }
+                }
+
+                std::string body;
+                bool found = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_requests.push_back(path + " " + range);
+                    auto route = m_routes.find(path);
+                    if (route != m_routes.end())
+                    {
+                        body = route->second;
+                        found = true;
+                    }
+                }
+
+                bool partial = false;
+                size_t first = 0;
+                size_t last = body.empty() ? 0 : body.size() - 1;
+                unsigned long long range_first = 0;
+                unsigned long long range_last = 0;
+                const int fields = found && !body.empty()
+                    ? std::sscanf(range.c_str(), "bytes=%llu-%llu", &range_first, &range_last) : 0;
+                if (fields >= 1 && range_first < body.size())
+                {
+                    first = static_cast<size_t>(range_first);
+                    if (fields == 2)
+                    {
+                        last = std::min(last, static_cast<size_t>(range_last));
+                    }
+                    partial = true;
+                }
+                const std::string content = found && !body.empty() ? body.substr(first, last - first + 1) : "";
+
+                const std::string status = !found ? "404 Not Found" : partial ? "206 Partial Content" : "200 OK";
+                std::string head = "HTTP/1.1 " + status + "\r\nContent-Length: "
+                    + std::to_string(content.size()) + "\r\nConnection: close\r\n";
+                if (partial)
+                {
+                    head += "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last)
+                        + "/" + std::to_string(body.size()) + "\r\n";
+                }
+                head += "\r\n";
+
+                bool ok = sendAll(client, head.data(), head.size());
+                const size_t chunk = m_chunk_size ? m_chunk_size : std::max<size_t>(content.size(), 1);
+                for (size_t offset = 0; ok && offset < content.size() && !m_stopping; offset += chunk)
+                {
+                    ok = sendAll(client, content.data() + offset, std::min(chunk, content.size() - offset));
+                    if (m_chunk_interval.count() > 0)
+                    {
+                        std::this_thread::sleep_for(m_chunk_interval);
+                    }
+                }
+                ::close(client);
+            }
+
+            static bool sendAll(int client, const char* data, size_t size)
+            {
+                while (size > 0)
+                {
+                    const ssize_t sent = ::send(client, data, size, MSG_NOSIGNAL);
+                    if (sent <= 0)
+                    {
+                        return false;
+                    }
+                    data += sent;
+                    size -= static_cast<size_t>(sent);
+                }
+                return true;
+            }
+
+            size_t m_chunk_size;
+            std::chrono::milliseconds m_chunk_interval;
+            int m_listen_fd = -1;
+            uint16_t m_port = 0;
+            std::atomic<bool> m_stopping{false};
+            std::thread m_accept_thread;
+
+            mutable std::mutex m_mutex;
+            std::map<std::string, std::string> m_routes;
+            std::vector<std::string> m_requests;
+            std::vector<std::thread> m_connections;
+        };
+    }
+}
+
+#endif
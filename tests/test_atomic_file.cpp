@@ -0,0 +1,97 @@
+#include <doctest/doctest.h>
+#include "atomic_file.h"
+#include "test_files.h"
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    size_t entryCount(const std::filesystem::path& dir)
+    {
+        return static_cast<size_t>(std::distance(
+            std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()));
+    }
+}
+
+TEST_CASE("Atomic File Replaces Target Only On Commit") {
+    auto dir = freshDir("atomic_commit");
+    const auto target = dir / "sound.wav";
+    std::ofstream(target) << "previous";
+
+    {
+        FreesoundDownloader::AtomicFile file;
+        REQUIRE(file.open(target.string()));
+        REQUIRE(file.write("partial", 7));
+
+        // The old contents stay visible while the new file is being written
+        CHECK(readFile(target) == "previous");
+        CHECK(std::filesystem::exists(file.tempPath()));
+        // Destroyed without commit: the temporary file disappears
+    }
+    CHECK(readFile(target) == "previous");
+    CHECK(entryCount(dir) == 1);
+
+    FreesoundDownloader::AtomicFile file;
+    REQUIRE(file.open(target.string()));
+    REQUIRE(file.write("complete", 8));
+    CHECK(file.bytesWritten() == 8);
+    REQUIRE(file.commit(true));
+    CHECK(readFile(target) == "complete");
+    CHECK(entryCount(dir) == 1);
+    CHECK_FALSE(file.commit(true));
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Group Commit Flushes Files Together") {
+    auto dir = freshDir("atomic_group");
+
+    FreesoundDownloader::GroupCommitter committer(3);
+    for (int i = 0; i < 4; ++i)
+    {
+        FreesoundDownloader::AtomicFile file;
+        REQUIRE(file.open((dir / (std::to_string(i) + ".wav")).string()));
+        REQUIRE(file.write("data", 4));
+        committer.add(std::move(file));
+    }
+
+    // The first group of three was committed automatically; one is pending
+    CHECK(std::filesystem::exists(dir / "2.wav"));
+    CHECK_FALSE(std::filesystem::exists(dir / "3.wav"));
+
+    // A file whose directory vanished before the flush is reported as failed
+    auto doomed_dir = dir / "doomed";
+    std::filesystem::create_directories(doomed_dir);
+    FreesoundDownloader::AtomicFile doomed;
+    REQUIRE(doomed.open((doomed_dir / "x.wav").string()));
+    committer.add(std::move(doomed));
+    std::filesystem::remove_all(doomed_dir);
+
+    auto failed = committer.flush();
+    REQUIRE(failed.size() == 1);
+    CHECK(failed[0] == (doomed_dir / "x.wav").string());
+    CHECK(readFile(dir / "3.wav") == "data");
+    CHECK(entryCount(dir) == 4);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Atomic File Preallocates And Trims") {
+    auto dir = freshDir("atomic_preallocate");
+    const auto target = dir / "sound.wav";
+
+    FreesoundDownloader::AtomicFile file;
+    REQUIRE(file.open(target.string()));
+    REQUIRE(file.preallocate(1 << 20));
+    CHECK(std::filesystem::file_size(file.tempPath()) == (1u << 20));
+
+    // The body ended short of the announced length
+    REQUIRE(file.write("short body", 10));
+    REQUIRE(file.truncate(file.bytesWritten()));
+    REQUIRE(file.commit(false));
+    CHECK(readFile(target) == "short body");
+
+    std::filesystem::remove_all(dir);
+}
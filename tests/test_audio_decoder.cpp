@@ -0,0 +1,389 @@
+#include <doctest/doctest.h>
+#include "audio_decoder.h"
+#include "test_files.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+    using Bytes = std::vector<uint8_t>;
+
+    /// Decodes a file pushed in pieces of the given size
+    std::vector<float> decode(const Bytes& file, FreesoundDownloader::AudioFormat format, size_t piece,
+        bool& ok, FreesoundDownloader::AudioStreamInfo* info = nullptr)
+    {
+        auto decoder = FreesoundDownloader::AudioDecoder::create(format);
+        std::vector<float> samples;
+        ok = decoder != nullptr;
+        for (size_t offset = 0; ok && offset < file.size(); offset += piece)
+        {
+            ok = decoder->push(file.data() + offset, std::min(piece, file.size() - offset), samples);
+        }
+        ok = ok && decoder->finish(samples);
+        if (decoder && decoder->info() && info)
+        {
+            *info = *decoder->info();
+        }
+        return samples;
+    }
+
+    /// MSB-first bit writer for building FLAC streams
+    class BitWriter
+    {
+    public:
+        void write(uint64_t value, unsigned bits)
+        {
+            for (unsigned i = bits; i-- > 0;)
+            {
+                if (m_used == 0)
+                {
+                    bytes.push_back(0);
+                }
+                bytes.back() |= static_cast<uint8_t>(((value >> i) & 1) << (7 - m_used));
+                m_used = (m_used + 1) & 7;
+            }
+        }
+
+        void writeSigned(int64_t value, unsigned bits) { write(static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1), bits); }
+
+        void writeRice(int64_t value, unsigned parameter)
+        {
+            const uint64_t folded = value < 0 ? (uint64_t(-value) << 1) - 1 : uint64_t(value) << 1;
+            for (uint64_t i = 0; i < (folded >> parameter); ++i)
+            {
+                write(0, 1);
+            }
+            write(1, 1);
+            write(folded & ((uint64_t(1) << parameter) - 1), parameter);
+        }
+
+        void align() { m_used = 0; }
+
+        Bytes bytes;
+
+    private:
+        unsigned m_used = 0;
+    };
+
+    uint8_t crc8(const Bytes& data)
+    {
+        uint8_t crc = 0;
+        for (uint8_t byte : data)
+        {
+            crc ^= byte;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    uint16_t crc16(const Bytes& data)
+    {
+        uint16_t crc = 0;
+        for (uint8_t byte : data)
+        {
+            crc ^= static_cast<uint16_t>(byte << 8);
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    /// Residual with one Rice partition per half block; the second half uses the escape code
+    void writeResidual(BitWriter& bits, const std::vector<int64_t>& residual, unsigned order, size_t block)
+    {
+        bits.write(0, 2);
+        bits.write(1, 4);
+        bits.write(5, 4);
+        for (size_t i = order; i < block / 2; ++i)
+        {
+            bits.writeRice(residual[i], 5);
+        }
+        bits.write(15, 4);
+        bits.write(18, 5);
+        for (size_t i = block / 2; i < block; ++i)
+        {
+            bits.writeSigned(residual[i], 18);
+        }
+    }
+
+    std::vector<int32_t> makeChannel(size_t length, int phase)
+    {
+        std::vector<int32_t> samples(length);
+        for (size_t i = 0; i < length; ++i)
+        {
+            samples[i] = static_cast<int32_t>(((i * 37 + phase) % 200) * 150) - 15000 + static_cast<int32_t>(i % 7);
+        }
+        return samples;
+    }
+
+    /**
+     * @brief Builds a 16-bit stereo FLAC file exercising every subframe type
+     *
+     * Frame 0 (192 frames, independent channels): FIXED order 2 and VERBATIM.
+     * Frame 1 (100 frames, mid/side): LPC order 2 and CONSTANT with wasted bits.
+     */
+    Bytes buildFlac(const std::vector<int32_t>& left, const std::vector<int32_t>& right)
+    {
+        Bytes file;
+        putTag(file, "fLaC");
+
+        // STREAMINFO, then a padding block that must be skipped
+        BitWriter info;
+        info.write(100, 16);
+        info.write(192, 16);
+        info.write(0, 24);
+        info.write(0, 24);
+        info.write(44100, 20);
+        info.write(1, 3);
+        info.write(15, 5);
+        info.write(left.size(), 36);
+        info.write(0, 64);
+        info.write(0, 64);
+        file.push_back(0x00);
+        putBe(file, info.bytes.size(), 3);
+        file.insert(file.end(), info.bytes.begin(), info.bytes.end());
+        file.push_back(0x81);
+        putBe(file, 5, 3);
+        file.insert(file.end(), 5, 0);
+
+        auto frame = [&file](unsigned block_code, unsigned channel_code, uint32_t number, size_t block,
+            const std::function<void(BitWriter&)>& subframes)
+        {
+            BitWriter bits;
+            bits.write(0x3FFE, 14);
+            bits.write(0, 1);
+            bits.write(0, 1);
+            bits.write(block_code, 4);
+            bits.write(9, 4);
+            bits.write(channel_code, 4);
+            bits.write(4, 3);
+            bits.write(0, 1);
+            bits.write(number, 8);
+            if (block_code == 6)
+            {
+                bits.write(block - 1, 8);
+            }
+            bits.write(crc8(bits.bytes), 8);
+            subframes(bits);
+            bits.align();
+            bits.write(crc16(bits.bytes), 16);
+            file.insert(file.end(), bits.bytes.begin(), bits.bytes.end());
+        };
+
+        frame(1, 1, 0, 192, [&](BitWriter& bits)
+        {
+            // FIXED order 2
+            bits.write(0, 1);
+            bits.write(8 + 2, 6);
+            bits.write(0, 1);
+            std::vector<int64_t> residual(192);
+            for (size_t i = 0; i < 192; ++i)
+            {
+                residual[i] = i < 2 ? left[i] : left[i] - (2 * int64_t(left[i - 1]) - left[i - 2]);
+            }
+            bits.writeSigned(left[0], 16);
+            bits.writeSigned(left[1], 16);
+            writeResidual(bits, residual, 2, 192);
+
+            // VERBATIM
+            bits.write(0, 1);
+            bits.write(1, 6);
+            bits.write(0, 1);
+            for (size_t i = 0; i < 192; ++i)
+            {
+                bits.writeSigned(right[i], 16);
+            }
+        });
+
+        frame(6, 10, 1, 100, [&](BitWriter& bits)
+        {
+            std::vector<int64_t> mid(100);
+            for (size_t i = 0; i < 100; ++i)
+            {
+                mid[i] = (int64_t(left[192 + i]) + right[192 + i]) >> 1;
+            }
+
+            // LPC order 2: prediction = (3 * s[-1] - 1 * s[-2]) >> 1
+            bits.write(0, 1);
+            bits.write(32 + 1, 6);
+            bits.write(0, 1);
+            bits.writeSigned(mid[0], 16);
+            bits.writeSigned(mid[1], 16);
+            bits.write(4 - 1, 4);
+            bits.writeSigned(1, 5);
+            bits.writeSigned(3, 4);
+            bits.writeSigned(-1, 4);
+            std::vector<int64_t> residual(100);
+            for (size_t i = 2; i < 100; ++i)
+            {
+                residual[i] = mid[i] - ((3 * mid[i - 1] - mid[i - 2]) >> 1);
+            }
+            writeResidual(bits, residual, 2, 100);
+
+            // CONSTANT side of 0x300 with eight wasted bits: 17 - 8 = 9 bits remain
+            bits.write(0, 1);
+            bits.write(0, 6);
+            bits.write(1, 1);
+            bits.write(1, 8);
+            bits.writeSigned(0x3, 9);
+        });
+        return file;
+    }
+}
+
+TEST_CASE("WAV Decoder Handles Chunks Split Across Pushes") {
+    // 24-bit stereo PCM with an odd-sized chunk before the data
+    const std::vector<int32_t> values = {0, 8388607, -8388608, 4194304, -1, 123456};
+    Bytes file;
+    putTag(file, "RIFF");
+    putLe(file, 0, 4);
+    putTag(file, "WAVE");
+    putTag(file, "LIST");
+    putLe(file, 3, 4);
+    file.insert(file.end(), {'a', 'b', 'c', 0});
+    putTag(file, "fmt ");
+    putLe(file, 16, 4);
+    putLe(file, 1, 2);
+    putLe(file, 2, 2);
+    putLe(file, 96000, 4);
+    putLe(file, 96000 * 6, 4);
+    putLe(file, 6, 2);
+    putLe(file, 24, 2);
+    putTag(file, "data");
+    putLe(file, values.size() * 3, 4);
+    for (int32_t value : values)
+    {
+        putLe(file, static_cast<uint32_t>(value), 3);
+    }
+    putTag(file, "id3 ");
+    putLe(file, 0, 4);
+
+    for (size_t piece : {size_t(1), size_t(5), file.size()})
+    {
+        bool ok = false;
+        FreesoundDownloader::AudioStreamInfo info;
+        const auto samples = decode(file, FreesoundDownloader::AudioFormat::Wav, piece, ok, &info);
+        REQUIRE(ok);
+        CHECK(info.sample_rate == 96000);
+        CHECK(info.channels == 2);
+        CHECK(info.bits_per_sample == 24);
+        REQUIRE(info.frames);
+        CHECK(*info.frames == 3);
+        REQUIRE(samples.size() == values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            CHECK(samples[i] == doctest::Approx(values[i] / 8388608.0));
+        }
+    }
+
+    // A data chunk that ends early is reported by finish()
+    Bytes truncated(file.begin(), file.end() - 10);
+    bool ok = true;
+    decode(truncated, FreesoundDownloader::AudioFormat::Wav, 7, ok);
+    CHECK_FALSE(ok);
+
+    // Compressed WAV formats are rejected
+    Bytes adpcm = file;
+    adpcm[20 + 12] = 2;
+    decode(adpcm, FreesoundDownloader::AudioFormat::Wav, 64, ok);
+    CHECK_FALSE(ok);
+}
+
+TEST_CASE("AIFF Decoder Reads Big And Little Endian Samples") {
+    for (bool aifc : {false, true})
+    {
+        Bytes file;
+        putTag(file, "FORM");
+        putBe(file, 0, 4);
+        putTag(file, aifc ? "AIFC" : "AIFF");
+        putTag(file, "COMM");
+        putBe(file, aifc ? 24 : 18, 4);
+        putBe(file, 1, 2);
+        putBe(file, 4, 4);
+        putBe(file, 16, 2);
+        // 22050 as an 80-bit extended float
+        file.insert(file.end(), {0x40, 0x0D, 0xAC, 0x44, 0, 0, 0, 0, 0, 0});
+        if (aifc)
+        {
+            putTag(file, "sowt");
+            file.insert(file.end(), {0, 0});
+        }
+        putTag(file, "SSND");
+        putBe(file, 8 + 2 + 8, 4);
+        putBe(file, 2, 4);
+        putBe(file, 0, 4);
+        file.insert(file.end(), {0xEE, 0xEE});
+        for (int16_t value : {int16_t(0), int16_t(16384), int16_t(-32768), int16_t(-2)})
+        {
+            aifc ? putLe(file, static_cast<uint16_t>(value), 2) : putBe(file, static_cast<uint16_t>(value), 2);
+        }
+
+        bool ok = false;
+        FreesoundDownloader::AudioStreamInfo info;
+        const auto samples = decode(file, FreesoundDownloader::AudioFormat::Aiff, 3, ok, &info);
+        REQUIRE(ok);
+        CHECK(info.sample_rate == 22050);
+        CHECK(info.channels == 1);
+        REQUIRE(samples.size() == 4);
+        CHECK(samples[0] == 0.0f);
+        CHECK(samples[1] == 0.5f);
+        CHECK(samples[2] == -1.0f);
+        CHECK(samples[3] == doctest::Approx(-2 / 32768.0));
+    }
+}
+
+TEST_CASE("FLAC Decoder Reconstructs Every Subframe Type") {
+    const auto left = makeChannel(292, 0);
+    auto right = makeChannel(292, 50);
+    // Frame 1 stores side = left - right as a constant
+    for (size_t i = 192; i < right.size(); ++i)
+    {
+        right[i] = left[i] - 0x300;
+    }
+    const Bytes file = buildFlac(left, right);
+
+    for (size_t piece : {size_t(1), size_t(64), file.size()})
+    {
+        bool ok = false;
+        FreesoundDownloader::AudioStreamInfo info;
+        const auto samples = decode(file, FreesoundDownloader::AudioFormat::Flac, piece, ok, &info);
+        REQUIRE(ok);
+        CHECK(info.sample_rate == 44100);
+        CHECK(info.channels == 2);
+        CHECK(info.bits_per_sample == 16);
+        REQUIRE(info.frames);
+        CHECK(*info.frames == 292);
+        REQUIRE(samples.size() == 2 * 292);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < 292; ++i)
+        {
+            mismatches += samples[2 * i] != left[i] / 32768.0f;
+            mismatches += samples[2 * i + 1] != right[i] / 32768.0f;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    // A flipped bit fails the frame CRC; a cut-off frame fails finish()
+    Bytes corrupt = file;
+    corrupt[corrupt.size() - 40] ^= 0x10;
+    bool ok = true;
+    decode(corrupt, FreesoundDownloader::AudioFormat::Flac, 4096, ok);
+    CHECK_FALSE(ok);
+
+    Bytes truncated(file.begin(), file.end() - 3);
+    auto samples = decode(truncated, FreesoundDownloader::AudioFormat::Flac, 4096, ok);
+    CHECK_FALSE(ok);
+    CHECK(samples.size() == 2 * 192);
+
+    CHECK(FreesoundDownloader::AudioDecoder::create(FreesoundDownloader::AudioFormat::Mp3) == nullptr);
+}
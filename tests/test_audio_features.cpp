@@ -0,0 +1,200 @@
+#include <doctest/doctest.h>
+#include "audio_features.h"
+#include "audio_kernels.h"
+#include "float_wav_writer.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    std::vector<float> makeTone(double frequency, uint32_t rate, size_t frames, unsigned channels)
+    {
+        std::vector<float> samples(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                samples[i * channels + c] = static_cast<float>(0.5 * std::sin(2.0 * PI * frequency * i / rate));
+            }
+        }
+        return samples;
+    }
+
+    std::vector<float> makeNoise(size_t count, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+        std::vector<float> samples(count);
+        for (float& sample : samples)
+        {
+            sample = distribution(generator);
+        }
+        return samples;
+    }
+
+    FreesoundDownloader::AudioFeatures extract(const std::vector<float>& samples, unsigned channels, uint32_t rate,
+                                               size_t block_frames)
+    {
+        FreesoundDownloader::FeatureExtractor extractor(static_cast<uint16_t>(channels), rate);
+        const size_t frames = samples.size() / channels;
+        for (size_t offset = 0; offset < frames; offset += block_frames)
+        {
+            extractor.push(samples.data() + offset * channels, std::min(block_frames, frames - offset));
+        }
+        return extractor.finish();
+    }
+
+    double distance(const FreesoundDownloader::AudioFeatures& a, const FreesoundDownloader::AudioFeatures& b)
+    {
+        const auto x = a.embedding();
+        const auto y = b.embedding();
+        double sum = 0.0;
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            sum += (x[i] - y[i]) * (x[i] - y[i]);
+        }
+        return std::sqrt(sum);
+    }
+}
+
+TEST_CASE("Real FFT Matches A Direct DFT On Every Instruction Set") {
+    using FreesoundDownloader::SimdLevel;
+
+    CHECK_THROWS_AS(FreesoundDownloader::RealFft(96), std::invalid_argument);
+    CHECK_THROWS_AS(FreesoundDownloader::RealFft(2), std::invalid_argument);
+
+    const SimdLevel original = FreesoundDownloader::activeSimdLevel();
+    for (size_t size : {4u, 64u, 1024u})
+    {
+        const auto frame = makeNoise(size, static_cast<unsigned>(size));
+        std::vector<double> expected(size / 2 + 1);
+        for (size_t k = 0; k <= size / 2; ++k)
+        {
+            std::complex<double> sum = 0.0;
+            for (size_t n = 0; n < size; ++n)
+            {
+                sum += static_cast<double>(frame[n]) * std::polar(1.0, -2.0 * PI * k * n / size);
+            }
+            expected[k] = std::norm(sum);
+        }
+
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+        {
+            if (!FreesoundDownloader::setSimdLevel(level))
+            {
+                continue;
+            }
+            FreesoundDownloader::RealFft fft(size);
+            std::vector<float> power(size / 2 + 1);
+            fft.powerSpectrum(frame.data(), power.data());
+
+            double worst = 0.0;
+            for (size_t k = 0; k <= size / 2; ++k)
+            {
+                worst = std::max(worst, std::abs(power[k] - expected[k]));
+            }
+            CHECK(worst < 1e-3 * static_cast<double>(size));
+        }
+    }
+    FreesoundDownloader::setSimdLevel(original);
+}
+
+TEST_CASE("Feature Extractor Describes Tones And Noise") {
+    using FreesoundDownloader::AudioFeatures;
+    using FreesoundDownloader::FeatureExtractor;
+    using FreesoundDownloader::FeatureOptions;
+
+    CHECK_THROWS_AS(FeatureExtractor(0, 44100), std::invalid_argument);
+    FeatureOptions bad;
+    bad.fft_size = 1000;
+    CHECK_THROWS_AS(FeatureExtractor(1, 44100, bad), std::invalid_argument);
+    bad.fft_size = 256;
+    bad.hop_size = 512;
+    CHECK_THROWS_AS(FeatureExtractor(1, 44100, bad), std::invalid_argument);
+
+    const auto tone = makeTone(1000.0, 44100, 44100, 2);
+    const AudioFeatures low = extract(tone, 2, 44100, 44100);
+    CHECK(low.frames > 35);
+    CHECK(low.nyquist == 11025.0f);
+    CHECK(low.centroid_mean == doctest::Approx(1000.0).epsilon(0.05));
+    CHECK(low.flatness_mean < 0.01f);
+
+    // Any block size gives the same result
+    const AudioFeatures blocked = extract(tone, 2, 44100, 333);
+    CHECK(blocked.frames == low.frames);
+    CHECK(distance(blocked, low) < 1e-4);
+
+    const AudioFeatures high = extract(makeTone(1200.0, 48000, 48000, 1), 1, 48000, 4096);
+    CHECK(high.centroid_mean == doctest::Approx(1200.0).epsilon(0.05));
+
+    const AudioFeatures noise = extract(makeNoise(22050, 7), 1, 22050, 1000);
+    CHECK(noise.flatness_mean > 0.3f);
+    CHECK(noise.centroid_mean == doctest::Approx(11025.0 / 2).epsilon(0.1));
+
+    // Similar sounds are closer to each other than to something different
+    CHECK(distance(low, high) < distance(low, noise));
+    CHECK(distance(extract(makeNoise(22050, 8), 1, 22050, 1000), noise) < distance(noise, high));
+
+    // Silence contributes no frames; a sound shorter than one frame still gets one
+    const AudioFeatures silent = extract(std::vector<float>(30000, 0.0f), 1, 22050, 5000);
+    CHECK(silent.frames == 0);
+    CHECK(silent.mfcc_mean[0] == 0.0f);
+    const AudioFeatures blip = extract(makeTone(3000.0, 22050, 200, 1), 1, 22050, 200);
+    CHECK(blip.frames == 1);
+    CHECK(blip.mfcc_std[0] == 0.0f);
+}
+
+TEST_CASE("Feature Files Are Extracted In Parallel") {
+    const auto dir = freshDir("features");
+
+    std::vector<std::string> paths;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const auto samples = makeTone(500.0 + 500.0 * i, 44100, 30000, 1 + i % 2);
+        FreesoundDownloader::FloatWavWriter writer;
+        paths.push_back((dir / (std::to_string(i) + ".wav")).string());
+        REQUIRE(writer.open(paths.back(), 44100, static_cast<uint16_t>(1 + i % 2)));
+        REQUIRE(writer.write(samples.data(), samples.size()));
+        REQUIRE(writer.commit(false));
+    }
+    {
+        std::ofstream junk(dir / "junk.wav", std::ios::binary);
+        junk << "RIFF but not really";
+    }
+    paths.push_back((dir / "junk.wav").string());
+
+    CHECK(FreesoundDownloader::featurePathFor("/library/1234.wav") == "/library/1234.features");
+
+    const auto failed = FreesoundDownloader::extractFeatureFiles(paths, {}, 2);
+    REQUIRE(failed.size() == 1);
+    CHECK(failed[0] == paths[4]);
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const auto features = FreesoundDownloader::AudioFeatures::load(FreesoundDownloader::featurePathFor(paths[i]));
+        REQUIRE(features.has_value());
+        CHECK(features->centroid_mean == doctest::Approx(500.0 + 500.0 * i).epsilon(0.05));
+
+        // The file holds exactly what the extractor computes
+        const auto direct = extract(makeTone(500.0 + 500.0 * i, 44100, 30000, 1 + i % 2), 1 + i % 2, 44100, 4096);
+        CHECK(features->frames == direct.frames);
+        CHECK(features->embedding() == direct.embedding());
+    }
+
+    std::filesystem::resize_file(FreesoundDownloader::featurePathFor(paths[0]), 100);
+    CHECK_FALSE(FreesoundDownloader::AudioFeatures::load(FreesoundDownloader::featurePathFor(paths[0])).has_value());
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,235 @@
+#include <doctest/doctest.h>
+#include "audio_fingerprint.h"
+#include "float_wav_writer.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    struct Note
+    {
+        double start;
+        double length;
+        double frequency;
+    };
+
+    /// A random tune of overlapping notes, so the same tune can be rendered at any rate
+    std::vector<Note> makeTune(double seconds, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> pitch(48.0, 96.0);
+        std::uniform_real_distribution<double> length(0.1, 0.4);
+        std::vector<Note> notes;
+        for (double start = 0.0; start < seconds; start += 0.15)
+        {
+            notes.push_back({start, length(generator), 440.0 * std::pow(2.0, (pitch(generator) - 69.0) / 12.0)});
+        }
+        return notes;
+    }
+
+    std::vector<float> render(const std::vector<Note>& notes, double from, double seconds, uint32_t rate,
+                              unsigned channels, float gain)
+    {
+        const size_t frames = static_cast<size_t>(seconds * rate);
+        std::vector<float> mono(frames, 0.0f);
+        for (const Note& note : notes)
+        {
+            const double begin = std::max(note.start - from, 0.0);
+            const double end = std::min(note.start + note.length - from, seconds);
+            for (size_t i = static_cast<size_t>(begin * rate); i < frames && i < end * rate; ++i)
+            {
+                const double t = from + static_cast<double>(i) / rate - note.start;
+                mono[i] += static_cast<float>(0.2 * std::sin(2.0 * PI * note.frequency * t));
+            }
+        }
+        std::vector<float> samples(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                samples[i * channels + c] = gain * mono[i];
+            }
+        }
+        return samples;
+    }
+
+    FreesoundDownloader::Fingerprint fingerprint(const std::vector<float>& samples, unsigned channels, uint32_t rate,
+                                                 size_t block_frames = 4096)
+    {
+        FreesoundDownloader::Fingerprinter fingerprinter(static_cast<uint16_t>(channels), rate);
+        const size_t frames = samples.size() / channels;
+        for (size_t offset = 0; offset < frames; offset += block_frames)
+        {
+            fingerprinter.push(samples.data() + offset * channels, std::min(block_frames, frames - offset));
+        }
+        return fingerprinter.finish();
+    }
+
+    bool sameHashes(const FreesoundDownloader::Fingerprint& a, const FreesoundDownloader::Fingerprint& b)
+    {
+        return a.frames == b.frames && a.hashes.size() == b.hashes.size()
+            && std::equal(a.hashes.begin(), a.hashes.end(), b.hashes.begin(), [](const auto& x, const auto& y) {
+                   return x.hash == y.hash && x.time == y.time;
+               });
+    }
+}
+
+TEST_CASE("Fingerprints Match Copies Of A Sound") {
+    using namespace FreesoundDownloader;
+
+    FingerprintOptions bad;
+    bad.fft_size = 1000;
+    CHECK_THROWS_AS(Fingerprinter(1, 44100, bad), std::invalid_argument);
+    bad = {};
+    bad.hop_size = 2048;
+    CHECK_THROWS_AS(Fingerprinter(1, 44100, bad), std::invalid_argument);
+    CHECK_THROWS_AS(Fingerprinter(0, 44100), std::invalid_argument);
+
+    const auto tune = makeTune(20.0, 1);
+    const auto original = fingerprint(render(tune, 0.0, 20.0, 44100, 2, 1.0f), 2, 44100);
+    CHECK(original.frames == 20 * 11025 / 512 - 1);
+    CHECK(original.hashes.size() > 150);
+    CHECK(std::is_sorted(original.hashes.begin(), original.hashes.end(),
+                         [](const auto& a, const auto& b) { return a.time < b.time; }));
+
+    // Block sizes do not change the result; silence has no peaks
+    CHECK(sameHashes(original, fingerprint(render(tune, 0.0, 20.0, 44100, 2, 1.0f), 2, 44100, 333)));
+    CHECK(fingerprint(std::vector<float>(44100 * 5, 0.0f), 1, 44100).hashes.empty());
+    CHECK(fingerprint(std::vector<float>(100, 0.5f), 1, 44100).frames == 1);
+
+    FingerprintIndex index;
+    REQUIRE(index.insert(1, original));
+    CHECK_FALSE(index.insert(1, original));
+    REQUIRE(index.insert(2, fingerprint(render(makeTune(20.0, 2), 0.0, 20.0, 44100, 1, 1.0f), 1, 44100)));
+    CHECK(index.size() == 2);
+
+    // A quieter mono copy at another rate
+    const auto copy = fingerprint(render(tune, 0.0, 20.0, 48000, 1, 0.3f), 1, 48000);
+    auto matches = index.match(copy);
+    REQUIRE_FALSE(matches.empty());
+    CHECK(matches[0].sound_id == 1);
+    CHECK(matches[0].score > 0.5f);
+    CHECK(std::abs(matches[0].offset) <= 1);
+
+    // An excerpt from the middle, which starts 3.3 seconds (about 71 frames) into the original
+    const auto excerpt = fingerprint(render(tune, 3.3, 8.0, 22050, 1, 1.0f), 1, 22050);
+    matches = index.match(excerpt);
+    REQUIRE_FALSE(matches.empty());
+    CHECK(matches[0].sound_id == 1);
+    CHECK(matches[0].score > 0.5f);
+    CHECK(std::abs(matches[0].offset - 71) <= 1);
+
+    // Another tune is no duplicate of either
+    const auto other = fingerprint(render(makeTune(20.0, 3), 0.0, 20.0, 44100, 1, 1.0f), 1, 44100);
+    CHECK_FALSE(index.findDuplicate(other).has_value());
+    CHECK_FALSE(index.insertIfUnique(3, other).has_value());
+    CHECK(index.contains(3));
+
+    const auto duplicate = index.insertIfUnique(4, copy);
+    REQUIRE(duplicate.has_value());
+    CHECK(duplicate->sound_id == 1);
+    CHECK_FALSE(index.contains(4));
+    CHECK(index.size() == 3);
+
+    CHECK(index.remove(1));
+    CHECK_FALSE(index.remove(1));
+    CHECK_FALSE(index.findDuplicate(copy).has_value());
+    CHECK_FALSE(index.insertIfUnique(4, copy).has_value());
+    CHECK(index.findDuplicate(excerpt)->sound_id == 4);
+}
+
+TEST_CASE("Fingerprint Index Is Saved, Mapped And Extended") {
+    using namespace FreesoundDownloader;
+
+    const auto dir = freshDir("fingerprint");
+    const std::string path = (dir / "sounds.fpi").string();
+
+    // Files decode in parallel to the same fingerprints as pushing their samples
+    std::vector<std::vector<Note>> tunes;
+    std::vector<std::string> paths;
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        tunes.push_back(makeTune(10.0, 10 + i));
+        const auto samples = render(tunes.back(), 0.0, 10.0, 44100, 1, 1.0f);
+        FloatWavWriter writer;
+        paths.push_back((dir / (std::to_string(i) + ".wav")).string());
+        REQUIRE(writer.open(paths.back(), 44100, 1));
+        REQUIRE(writer.write(samples.data(), samples.size()));
+        REQUIRE(writer.commit(false));
+    }
+    {
+        std::ofstream junk(dir / "junk.wav", std::ios::binary);
+        junk << "RIFF but not really";
+    }
+    paths.push_back((dir / "junk.wav").string());
+
+    const auto fingerprints = fingerprintFiles(paths, {}, 3);
+    REQUIRE(fingerprints.size() == 7);
+    CHECK_FALSE(fingerprints[6].has_value());
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        REQUIRE(fingerprints[i].has_value());
+        CHECK(sameHashes(*fingerprints[i], fingerprint(render(tunes[i], 0.0, 10.0, 44100, 1, 1.0f), 1, 44100)));
+    }
+
+    FingerprintIndex built;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        REQUIRE(built.insert(static_cast<int>(100 + i), *fingerprints[i]));
+    }
+    REQUIRE(built.save(path));
+
+    FingerprintIndex mapped;
+    REQUIRE(mapped.open(path));
+    CHECK(mapped.size() == 4);
+    CHECK(mapped.contains(103));
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const auto expected = built.match(*fingerprints[i]);
+        const auto actual = mapped.match(*fingerprints[i]);
+        REQUIRE(expected.size() == actual.size());
+        CHECK(actual[0].sound_id == static_cast<int>(100 + i));
+        CHECK(actual[0].matched == expected[0].matched);
+        CHECK(actual[0].score == 1.0f);
+    }
+
+    // Additions and removals on top of the file
+    REQUIRE(mapped.insert(104, *fingerprints[4]));
+    CHECK(mapped.remove(101));
+    CHECK_FALSE(mapped.contains(101));
+    CHECK(mapped.match(*fingerprints[1]).empty());
+    CHECK(mapped.match(*fingerprints[4])[0].sound_id == 104);
+    REQUIRE(mapped.insert(101, *fingerprints[5]));
+    CHECK(mapped.match(*fingerprints[5])[0].sound_id == 101);
+    CHECK(mapped.match(*fingerprints[1]).empty());
+    CHECK(mapped.size() == 5);
+
+    REQUIRE(mapped.save(path));
+    FingerprintIndex reopened;
+    REQUIRE(reopened.open(path));
+    CHECK(reopened.size() == 5);
+    CHECK(reopened.match(*fingerprints[5])[0].sound_id == 101);
+    CHECK(reopened.match(*fingerprints[1]).empty());
+
+    // Damaged files are rejected and leave the index as it was
+    const std::string damaged = (dir / "damaged.fpi").string();
+    std::filesystem::copy_file(path, damaged);
+    std::filesystem::resize_file(damaged, std::filesystem::file_size(path) - 4);
+    CHECK_FALSE(reopened.open(damaged));
+    CHECK_FALSE(reopened.open(paths[0]));
+    CHECK_FALSE(reopened.open((dir / "missing.fpi").string()));
+    CHECK(reopened.size() == 5);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,276 @@
+#include <doctest/doctest.h>
+#include "audio_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using FreesoundDownloader::PcmEncoding;
+using FreesoundDownloader::SimdLevel;
+
+namespace
+{
+    /// Levels the CPU running the tests can execute, scalar first
+    std::vector<SimdLevel> supportedLevels()
+    {
+        std::vector<SimdLevel> levels;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Neon})
+        {
+            if (FreesoundDownloader::simdLevelSupported(level))
+            {
+                levels.push_back(level);
+            }
+        }
+        return levels;
+    }
+
+    /// Little-endian samples sweeping the full range of an encoding, extremes included
+    std::vector<uint8_t> pcmRamp(PcmEncoding encoding, size_t count)
+    {
+        const size_t width = FreesoundDownloader::pcmBytesPerSample(encoding);
+        std::vector<uint8_t> bytes(count * width);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t value = static_cast<uint32_t>(i * 2654435761u);
+            if (i == 0)
+            {
+                value = 0x80000000u;
+            }
+            else if (i == 1)
+            {
+                value = 0x7fffffffu;
+            }
+            for (size_t b = 0; b < width; ++b)
+            {
+                bytes[i * width + b] = static_cast<uint8_t>(value >> (8 * (4 - width + b)));
+            }
+        }
+        return bytes;
+    }
+
+    float expectedSample(const uint8_t* p, size_t width)
+    {
+        uint32_t value = 0;
+        for (size_t b = 0; b < width; ++b)
+        {
+            value |= static_cast<uint32_t>(p[b]) << (8 * (4 - width + b));
+        }
+        return static_cast<float>(static_cast<int32_t>(value)) / 2147483648.0f;
+    }
+
+    std::vector<float> floatsOf(const std::vector<uint8_t>& bytes)
+    {
+        std::vector<float> floats(bytes.size() / sizeof(float));
+        if (!floats.empty())
+        {
+            std::memcpy(floats.data(), bytes.data(), floats.size() * sizeof(float));
+        }
+        return floats;
+    }
+}
+
+TEST_CASE("Audio Kernels Convert Integer Samples On Every Instruction Set") {
+    const SimdLevel original = FreesoundDownloader::activeSimdLevel();
+    CHECK(FreesoundDownloader::simdLevelSupported(SimdLevel::Scalar));
+    CHECK(FreesoundDownloader::simdLevelSupported(original));
+
+    for (SimdLevel level : supportedLevels())
+    {
+        REQUIRE(FreesoundDownloader::setSimdLevel(level));
+        CHECK(FreesoundDownloader::activeSimdLevel() == level);
+
+        for (PcmEncoding encoding : {PcmEncoding::Int16, PcmEncoding::Int24, PcmEncoding::Int32})
+        {
+            const size_t width = FreesoundDownloader::pcmBytesPerSample(encoding);
+            // Odd counts leave a tail after the vector blocks
+            for (size_t count : {0u, 1u, 7u, 8u, 37u, 1000u})
+            {
+                const auto bytes = pcmRamp(encoding, count);
+                std::vector<float> converted(count);
+                FreesoundDownloader::pcmToFloat(bytes.data(), encoding, count, converted.data());
+
+                auto in_place = bytes;
+                in_place.push_back(0x55);  // a partial trailing sample is dropped
+                CHECK(FreesoundDownloader::pcmToFloatInPlace(in_place, encoding) == count);
+                REQUIRE(in_place.size() == count * sizeof(float));
+                const auto in_place_floats = floatsOf(in_place);
+
+                bool exact = true;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const float expected = expectedSample(bytes.data() + i * width, width);
+                    exact = exact && converted[i] == expected && in_place_floats[i] == expected;
+                }
+                CHECK(exact);
+            }
+        }
+    }
+
+    FreesoundDownloader::setSimdLevel(original);
+}
+
+TEST_CASE("Audio Kernels Measure, Scale And Normalize") {
+    const SimdLevel original = FreesoundDownloader::activeSimdLevel();
+
+    std::vector<float> signal(10007);
+    for (size_t i = 0; i < signal.size(); ++i)
+    {
+        signal[i] = static_cast<float>(0.25 * std::sin(0.01 * static_cast<double>(i)));
+    }
+    signal[5003] = -0.5f;
+    double sum_squares = 0.0;
+    for (float sample : signal)
+    {
+        sum_squares += static_cast<double>(sample) * sample;
+    }
+    const float rms = static_cast<float>(std::sqrt(sum_squares / signal.size()));
+
+    for (SimdLevel level : supportedLevels())
+    {
+        REQUIRE(FreesoundDownloader::setSimdLevel(level));
+
+        const auto levels = FreesoundDownloader::measureLevels(signal.data(), signal.size());
+        CHECK(levels.peak == 0.5f);
+        CHECK(levels.rms == doctest::Approx(rms).epsilon(1e-5));
+
+        const auto empty = FreesoundDownloader::measureLevels(signal.data(), 0);
+        CHECK(empty.peak == 0.0f);
+        CHECK(empty.rms == 0.0f);
+
+        const auto range = FreesoundDownloader::measureRange(signal.data(), signal.size());
+        CHECK(range.min == -0.5f);
+        CHECK(range.max == doctest::Approx(0.25f).epsilon(1e-4));
+        const auto tail = FreesoundDownloader::measureRange(signal.data() + 5003, 3);
+        CHECK(tail.min == -0.5f);
+        CHECK(tail.max == std::max(signal[5004], signal[5005]));
+        CHECK(FreesoundDownloader::measureRange(signal.data(), 0).max == 0.0f);
+
+        for (size_t count : {0u, 3u, 8u, 30u, 37u})
+        {
+            double expected = 0.0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const double difference = static_cast<double>(signal[i]) - signal[i + 100];
+                expected += difference * difference;
+            }
+            CHECK(FreesoundDownloader::squaredDistance(signal.data(), signal.data() + 100, count)
+                  == doctest::Approx(expected).epsilon(1e-5));
+        }
+
+        auto scaled = signal;
+        FreesoundDownloader::applyGain(scaled.data(), scaled.size(), 2.0f);
+        bool doubled = true;
+        for (size_t i = 0; i < signal.size(); ++i)
+        {
+            doubled = doubled && scaled[i] == 2.0f * signal[i];
+        }
+        CHECK(doubled);
+
+        auto normalized = signal;
+        CHECK(FreesoundDownloader::normalizePeak(normalized.data(), normalized.size(), 0.9f) == doctest::Approx(1.8f));
+        CHECK(FreesoundDownloader::measureLevels(normalized.data(), normalized.size()).peak
+              == doctest::Approx(0.9f));
+
+        std::vector<float> silence(100, 0.0f);
+        CHECK(FreesoundDownloader::normalizePeak(silence.data(), silence.size()) == 1.0f);
+        CHECK(silence[50] == 0.0f);
+    }
+
+    FreesoundDownloader::setSimdLevel(original);
+}
+
+TEST_CASE("Audio Kernels Compute Prediction Residuals") {
+    const SimdLevel original = FreesoundDownloader::activeSimdLevel();
+
+    // 16-bit samples and 12-bit coefficients, as the lossless codec uses them
+    std::vector<int32_t> samples(1000);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<int32_t>(std::lround(30000.0 * std::sin(0.05 * i) + (i * 7919 % 1001) - 500.0));
+    }
+    std::vector<int32_t> coefficients(32);
+    for (size_t j = 0; j < coefficients.size(); ++j)
+    {
+        coefficients[j] = static_cast<int32_t>((j * 1103 + 17) % 4096) - 2048;
+    }
+
+    for (SimdLevel level : supportedLevels())
+    {
+        REQUIRE(FreesoundDownloader::setSimdLevel(level));
+        for (unsigned order : {1u, 2u, 7u, 8u, 12u, 32u})
+        {
+            const size_t count = samples.size() - 32 - order % 5;
+            std::vector<int32_t> residual(count);
+            FreesoundDownloader::lpcResidual(samples.data() + 32, count, coefficients.data(), order, 11,
+                                             residual.data());
+            bool exact = true;
+            for (size_t i = 0; i < count; ++i)
+            {
+                int64_t sum = 0;
+                for (unsigned j = 0; j < order; ++j)
+                {
+                    sum += static_cast<int64_t>(coefficients[j]) * samples[32 + i - 1 - j];
+                }
+                exact = exact && residual[i] == samples[32 + i] - static_cast<int32_t>(sum >> 11);
+            }
+            CHECK(exact);
+        }
+    }
+
+    FreesoundDownloader::setSimdLevel(original);
+}
+
+TEST_CASE("Audio Kernels Remap Channels In Place") {
+    const SimdLevel original = FreesoundDownloader::activeSimdLevel();
+
+    for (SimdLevel level : supportedLevels())
+    {
+        REQUIRE(FreesoundDownloader::setSimdLevel(level));
+
+        // Stereo to mono and back take the vectorized paths
+        std::vector<float> stereo(2 * 21);
+        for (size_t i = 0; i < stereo.size(); ++i)
+        {
+            stereo[i] = static_cast<float>(i) * 0.125f;
+        }
+        auto mono = stereo;
+        REQUIRE(FreesoundDownloader::remapChannels(mono, 2, 1));
+        REQUIRE(mono.size() == 21);
+        bool averaged = true;
+        for (size_t i = 0; i < mono.size(); ++i)
+        {
+            averaged = averaged && mono[i] == (stereo[2 * i] + stereo[2 * i + 1]) * 0.5f;
+        }
+        CHECK(averaged);
+
+        auto widened = mono;
+        REQUIRE(FreesoundDownloader::remapChannels(widened, 1, 2));
+        REQUIRE(widened.size() == 42);
+        bool duplicated = true;
+        for (size_t i = 0; i < mono.size(); ++i)
+        {
+            duplicated = duplicated && widened[2 * i] == mono[i] && widened[2 * i + 1] == mono[i];
+        }
+        CHECK(duplicated);
+    }
+
+    // An explicit matrix: three channels down to two, then two up to four
+    std::vector<float> frames = {1, 2, 3, 4, 5, 6};
+    const std::vector<float> down = {1, 0, 0.5f, 0, 1, 0.5f};
+    REQUIRE(FreesoundDownloader::remapChannels(frames, 3, 2, down));
+    const std::vector<float> expected_down = {2.5f, 3.5f, 7, 8};
+    CHECK(frames == expected_down);
+
+    REQUIRE(FreesoundDownloader::remapChannels(frames, 2, 4));
+    const std::vector<float> expected_up = {2.5f, 3.5f, 0, 0, 7, 8, 0, 0};
+    CHECK(frames == expected_up);
+
+    // Invalid requests leave the samples alone
+    CHECK_FALSE(FreesoundDownloader::remapChannels(frames, 0, 2));
+    const std::vector<float> wrong_size = {1, 0};
+    CHECK_FALSE(FreesoundDownloader::remapChannels(frames, 4, 2, wrong_size));
+    CHECK(frames == expected_up);
+
+    FreesoundDownloader::setSimdLevel(original);
+}
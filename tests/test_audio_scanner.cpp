@@ -0,0 +1,316 @@
+#include <doctest/doctest.h>
+#include "audio_scanner.h"
+#include "sound_store.h"
+#include "test_files.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using FreesoundDownloader::AudioFormat;
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+    using Bytes = std::vector<uint8_t>;
+
+    /// PCM WAV of silence whose data chunk sits behind a metadata chunk
+    Bytes wav(uint32_t rate, uint16_t channels, uint16_t bits, uint32_t frames, size_t metadata)
+    {
+        return pcmWav(std::vector<int32_t>(static_cast<size_t>(frames) * channels), channels, bits, rate, {metadata});
+    }
+
+    Bytes aiff(uint32_t rate, uint16_t channels, uint16_t bits, uint32_t frames)
+    {
+        return pcmAiff(std::vector<int32_t>(static_cast<size_t>(frames) * channels), channels, bits, rate);
+    }
+
+    Bytes flac(uint32_t rate, unsigned channels, unsigned bits, uint64_t frames)
+    {
+        Bytes out;
+        putTag(out, "fLaC");
+        putBe(out, 0x80000000u | 34, 4);
+        putBe(out, 4096, 2);
+        putBe(out, 4096, 2);
+        putBe(out, 0, 6);
+        putBe(out, (static_cast<uint64_t>(rate) << 44) | (static_cast<uint64_t>(channels - 1) << 41)
+                   | (static_cast<uint64_t>(bits - 1) << 36) | frames, 8);
+        out.resize(out.size() + 16 + 1000, 0);
+        return out;
+    }
+
+    void putOggPage(Bytes& out, uint32_t serial, uint32_t sequence, int64_t granule, const Bytes& packet)
+    {
+        putTag(out, "OggS");
+        out.push_back(0);
+        out.push_back(sequence == 0 ? 0x02 : 0x00);
+        putLe(out, static_cast<uint64_t>(granule), 8);
+        putLe(out, serial, 4);
+        putLe(out, sequence, 4);
+        putLe(out, 0, 4);
+        size_t lacing = packet.size() / 255 + 1;
+        out.push_back(static_cast<uint8_t>(lacing));
+        for (size_t i = 0; i + 1 < lacing; ++i)
+        {
+            out.push_back(255);
+        }
+        out.push_back(static_cast<uint8_t>(packet.size() % 255));
+        out.insert(out.end(), packet.begin(), packet.end());
+    }
+
+    /// Ogg stream with the given identification packet, a long middle page and a final granule
+    Bytes ogg(const Bytes& identification, int64_t final_granule)
+    {
+        Bytes out;
+        putOggPage(out, 77, 0, 0, identification);
+        putOggPage(out, 99, 0, 123456789, Bytes(40, 1));  // another stream must not be mistaken for ours
+        putOggPage(out, 77, 1, 1000, Bytes(20000, 0));
+        putOggPage(out, 77, 2, final_granule, Bytes(100, 0));
+        return out;
+    }
+
+    Bytes id3(size_t size)
+    {
+        Bytes out;
+        putTag(out, "ID3");
+        out.push_back(4);
+        out.push_back(0);
+        out.push_back(0);
+        for (int shift = 21; shift >= 0; shift -= 7)
+        {
+            out.push_back(static_cast<uint8_t>((size >> shift) & 0x7F));
+        }
+        out.resize(out.size() + size, 0);
+        return out;
+    }
+
+    /// MPEG-1 layer III frames at 128 kbps and 44.1 kHz (417 bytes each without padding)
+    void putMpegFrames(Bytes& out, size_t count, bool mono)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t start = out.size();
+            out.push_back(0xFF);
+            out.push_back(0xFB);
+            out.push_back(0x90);
+            out.push_back(mono ? 0xC0 : 0x00);
+            out.resize(start + 417, 0);
+        }
+    }
+
+    void writeFile(const std::filesystem::path& path, const Bytes& bytes)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+}
+
+TEST_CASE("Audio Scanner Reads Container Headers") {
+    // WAV with its data chunk beyond the first page, and a truncated copy
+    const Bytes long_wav = wav(48000, 2, 24, 96000, 10000);
+    auto info = FreesoundDownloader::probeAudioData(long_wav.data(), long_wav.size());
+    REQUIRE(info.valid());
+    CHECK(info.format == AudioFormat::Wav);
+    CHECK(info.stream.sample_rate == 48000);
+    CHECK(info.stream.channels == 2);
+    CHECK(info.stream.bits_per_sample == 24);
+    CHECK(info.stream.frames.value_or(0) == 96000);
+    CHECK(info.duration() == doctest::Approx(2.0));
+
+    const Bytes cut(long_wav.begin(), long_wav.end() - 6 * 1000);
+    info = FreesoundDownloader::probeAudioData(cut.data(), cut.size());
+    CHECK(info.stream.frames.value_or(0) == 95000);
+
+    const Bytes aiff_file = aiff(44100, 1, 16, 12345);
+    info = FreesoundDownloader::probeAudioData(aiff_file.data(), aiff_file.size());
+    CHECK(info.format == AudioFormat::Aiff);
+    CHECK(info.stream.sample_rate == 44100);
+    CHECK(info.stream.channels == 1);
+    CHECK(info.stream.bits_per_sample == 16);
+    CHECK(info.stream.frames.value_or(0) == 12345);
+
+    const Bytes flac_file = flac(96000, 6, 24, 5000000000ull);
+    info = FreesoundDownloader::probeAudioData(flac_file.data(), flac_file.size());
+    CHECK(info.format == AudioFormat::Flac);
+    CHECK(info.stream.sample_rate == 96000);
+    CHECK(info.stream.channels == 6);
+    CHECK(info.stream.bits_per_sample == 24);
+    CHECK(info.stream.frames.value_or(0) == 5000000000ull);
+
+    Bytes tagged_flac = id3(300);
+    tagged_flac.insert(tagged_flac.end(), flac_file.begin(), flac_file.end());
+    info = FreesoundDownloader::probeAudioData(tagged_flac.data(), tagged_flac.size());
+    CHECK(info.format == AudioFormat::Flac);
+    CHECK(info.stream.channels == 6);
+
+    // Ogg Vorbis and Opus take their length from the last page of their own stream
+    Bytes vorbis;
+    vorbis.push_back(1);
+    putTag(vorbis, "vorbis");
+    putLe(vorbis, 0, 4);
+    vorbis.push_back(2);
+    putLe(vorbis, 22050, 4);
+    vorbis.resize(30, 0);
+    const Bytes vorbis_file = ogg(vorbis, 66150);
+    info = FreesoundDownloader::probeAudioData(vorbis_file.data(), vorbis_file.size());
+    CHECK(info.format == AudioFormat::Ogg);
+    CHECK(info.stream.sample_rate == 22050);
+    CHECK(info.stream.channels == 2);
+    CHECK(info.stream.bits_per_sample == 0);
+    CHECK(info.stream.frames.value_or(0) == 66150);
+
+    Bytes opus;
+    putTag(opus, "OpusHead");
+    opus.push_back(1);
+    opus.push_back(1);
+    putLe(opus, 312, 2);
+    putLe(opus, 44100, 4);
+    putLe(opus, 0, 3);
+    const Bytes opus_file = ogg(opus, 48000 + 312);
+    info = FreesoundDownloader::probeAudioData(opus_file.data(), opus_file.size());
+    CHECK(info.stream.sample_rate == 48000);
+    CHECK(info.stream.channels == 1);
+    CHECK(info.stream.frames.value_or(0) == 48000);
+
+    // Constant-bitrate MP3 behind an ID3v2 tag and in front of an ID3v1 tag
+    Bytes cbr = id3(300);
+    putMpegFrames(cbr, 100, false);
+    putTag(cbr, "TAG");
+    cbr.resize(cbr.size() + 125, 0);
+    info = FreesoundDownloader::probeAudioData(cbr.data(), cbr.size());
+    CHECK(info.format == AudioFormat::Mp3);
+    CHECK(info.stream.sample_rate == 44100);
+    CHECK(info.stream.channels == 2);
+    CHECK(info.stream.frames.value_or(0) == 100ull * 417 * 8 * 44100 / 128000);
+
+    // Xing header with a frame count and LAME encoder delay and padding
+    Bytes vbr;
+    putMpegFrames(vbr, 20, true);
+    const size_t xing = 4 + 17;
+    std::memcpy(vbr.data() + xing, "Xing", 4);
+    Bytes fields;
+    putBe(fields, 0x03, 4);
+    putBe(fields, 500, 4);
+    putBe(fields, 200000, 4);
+    std::memcpy(vbr.data() + xing + 4, fields.data(), fields.size());
+    std::memcpy(vbr.data() + xing + 16, "LAME3.100", 9);
+    const uint32_t gapless = (576u << 12) | 1000u;
+    vbr[xing + 16 + 21] = static_cast<uint8_t>(gapless >> 16);
+    vbr[xing + 16 + 22] = static_cast<uint8_t>(gapless >> 8);
+    vbr[xing + 16 + 23] = static_cast<uint8_t>(gapless);
+    info = FreesoundDownloader::probeAudioData(vbr.data(), vbr.size());
+    CHECK(info.stream.channels == 1);
+    CHECK(info.stream.frames.value_or(0) == 500ull * 1152 - 576 - 1000);
+
+    // Anything else is not audio
+    const Bytes text = {'h', 'e', 'l', 'l', 'o'};
+    CHECK_FALSE(FreesoundDownloader::probeAudioData(text.data(), text.size()).valid());
+    const Bytes header_only(long_wav.begin(), long_wav.begin() + 20);
+    CHECK_FALSE(FreesoundDownloader::probeAudioData(header_only.data(), header_only.size()).valid());
+}
+
+TEST_CASE("Audio Scanner Indexes A Directory In Parallel") {
+    const auto dir = freshDir("scanner");
+
+    for (int i = 0; i < 40; ++i)
+    {
+        const auto shard = dir / std::to_string(i % 7);
+        writeFile(shard / (std::to_string(i) + ".wav"), wav(8000 + 1000 * i, 1, 16, 100 * i, 0));
+    }
+    writeFile(dir / "a" / "tone.AIFF", aiff(32000, 2, 16, 777));
+    writeFile(dir / "a" / "broken.flac", Bytes(64, 0x42));
+    writeFile(dir / "index.bin", Bytes(32, 0));
+
+    FreesoundDownloader::ScanOptions options;
+    options.threads = 3;
+    options.readahead = 4;
+    const auto scanned = FreesoundDownloader::scanAudioDirectory(dir.string(), options);
+    REQUIRE(scanned.size() == 42);
+
+    size_t valid = 0;
+    bool matches = true;
+    for (const auto& file : scanned)
+    {
+        const std::string name = std::filesystem::path(file.path).stem().string();
+        if (!file.valid())
+        {
+            CHECK(name == "broken");
+            continue;
+        }
+        ++valid;
+        if (name == "tone")
+        {
+            matches = matches && file.format == AudioFormat::Aiff && file.stream.frames.value_or(0) == 777;
+            continue;
+        }
+        const int id = std::stoi(name);
+        matches = matches && file.format == AudioFormat::Wav
+                  && file.stream.sample_rate == static_cast<uint32_t>(8000 + 1000 * id)
+                  && file.stream.frames.value_or(0) == static_cast<uint64_t>(100 * id)
+                  && file.file_size == std::filesystem::file_size(file.path);
+    }
+    CHECK(valid == 41);
+    CHECK(matches);
+
+    // Explicit lists keep their order, and missing files come back invalid
+    const std::vector<std::string> paths = {(dir / "a" / "tone.AIFF").string(), (dir / "missing.wav").string()};
+    const auto listed = FreesoundDownloader::scanAudioFiles(paths);
+    REQUIRE(listed.size() == 2);
+    CHECK(listed[0].valid());
+    CHECK_FALSE(listed[1].valid());
+    CHECK(listed[1].path == paths[1]);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Audio Scanner Reads Sounds A Store Keeps Compressed") {
+    using namespace FreesoundDownloader;
+
+    const auto dir = freshDir("scanner_store");
+    SoundStore store;
+    REQUIRE(store.open(dir.string()));
+    store.setLosslessCompression(true);
+
+    // Silence compresses; the WAV keeps a metadata chunk ahead of its samples
+    const Bytes wav_file = wav(22050, 2, 16, 30000, 101);
+    const Bytes aiff_file = aiff(32000, 1, 24, 5000);
+    REQUIRE(store.put(1, wav_file.data(), wav_file.size()));
+    REQUIRE(store.put(2, aiff_file.data(), aiff_file.size()));
+    REQUIRE(store.find(1)->compressed);
+    REQUIRE(store.find(2)->compressed);
+
+    const auto scanned = scanAudioDirectory(dir.string());
+    REQUIRE(scanned.size() == 2);
+    for (const auto& file : scanned)
+    {
+        CHECK(file.file_size == std::filesystem::file_size(file.path));
+        CHECK(file.file_size < 1000);
+    }
+    const bool wav_first = scanned[0].format == AudioFormat::Wav;
+    const auto& wav_info = scanned[wav_first ? 0 : 1];
+    const auto& aiff_info = scanned[wav_first ? 1 : 0];
+    CHECK(wav_info.format == AudioFormat::Wav);
+    CHECK(wav_info.stream.sample_rate == 22050);
+    CHECK(wav_info.stream.channels == 2);
+    CHECK(wav_info.stream.frames.value_or(0) == 30000);
+    CHECK(aiff_info.format == AudioFormat::Aiff);
+    CHECK(aiff_info.stream.sample_rate == 32000);
+    CHECK(aiff_info.stream.bits_per_sample == 24);
+    CHECK(aiff_info.stream.frames.value_or(0) == 5000);
+
+    // A damaged codec header is not mistaken for audio
+    const std::string path = store.storedPathFor(*store.find(1));
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(16);
+        const char huge[8] = {0, 0, 0, 0, 0, 0, 0, 0x40};
+        file.write(huge, 8);
+    }
+    CHECK_FALSE(probeAudioFile(path).valid());
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,67 @@
+#include <doctest/doctest.h>
+#include "buffer_pool.h"
+#include <cstring>
+#include <string>
+#include <utility>
+
+TEST_CASE("Buffer Pool Reuses Blocks By Size Class") {
+    FreesoundDownloader::BufferPool pool(4 * FreesoundDownloader::BufferPool::MIN_BLOCK);
+
+    const uint8_t* first_block = nullptr;
+    {
+        auto buffer = pool.acquire(1000);
+        CHECK(buffer.empty());
+        CHECK(buffer.capacity() == FreesoundDownloader::BufferPool::MIN_BLOCK);
+        first_block = buffer.data();
+    }
+    CHECK(pool.cachedBytes() == FreesoundDownloader::BufferPool::MIN_BLOCK);
+
+    // Same size class: the released block comes back
+    auto reused = pool.acquire(FreesoundDownloader::BufferPool::MIN_BLOCK);
+    CHECK(reused.data() == first_block);
+    CHECK(pool.cachedBytes() == 0);
+
+    // Rounded up to the next power of two
+    auto larger = pool.acquire(FreesoundDownloader::BufferPool::MIN_BLOCK + 1);
+    CHECK(larger.capacity() == 2 * FreesoundDownloader::BufferPool::MIN_BLOCK);
+
+    // Blocks released beyond the cap are freed instead of cached
+    auto big = pool.acquire(4 * FreesoundDownloader::BufferPool::MIN_BLOCK);
+    larger = FreesoundDownloader::PooledBuffer();
+    big = FreesoundDownloader::PooledBuffer();
+    CHECK(pool.cachedBytes() == 2 * FreesoundDownloader::BufferPool::MIN_BLOCK);
+
+    pool.trim();
+    CHECK(pool.cachedBytes() == 0);
+}
+
+TEST_CASE("Pooled Buffer Moves And Grows") {
+    FreesoundDownloader::PooledBuffer outlived;
+    {
+        FreesoundDownloader::BufferPool pool;
+        auto buffer = pool.acquire(16);
+
+        std::string expected;
+        for (int i = 0; i < 50000; ++i)
+        {
+            const std::string chunk = std::to_string(i) + ",";
+            REQUIRE(buffer.append(chunk.data(), chunk.size()));
+            expected += chunk;
+        }
+        CHECK(buffer.capacity() >= expected.size());
+
+        FreesoundDownloader::PooledBuffer moved(std::move(buffer));
+        CHECK(buffer.data() == nullptr);
+        CHECK(buffer.size() == 0);
+        CHECK_FALSE(buffer.append("x", 1));
+        REQUIRE(moved.size() == expected.size());
+        CHECK(std::memcmp(moved.data(), expected.data(), expected.size()) == 0);
+
+        outlived = std::move(moved);
+    }
+
+    // The memory stays valid after its pool is gone and is freed on release
+    CHECK(outlived.size() > 0);
+    CHECK(outlived.data()[0] == '0');
+    outlived = FreesoundDownloader::PooledBuffer();
+}
@@ -0,0 +1,171 @@
+#include <doctest/doctest.h>
+#include "catalog_crawler.h"
+#include "test_files.h"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    // Serves a fake catalog in which every ID between 1 and catalog_size exists
+    FreesoundDownloader::CatalogCrawler::PageFetcher fakeCatalog(int catalog_size)
+    {
+        return [catalog_size](const std::string& filter, int page, int page_size)
+            -> std::optional<std::string>
+        {
+            int first = 0;
+            int last = 0;
+            if (std::sscanf(filter.c_str(), "id:[%d TO %d]", &first, &last) != 2)
+            {
+                return std::nullopt;
+            }
+            last = std::min(last, catalog_size);
+
+            nlohmann::json payload;
+            payload["results"] = nlohmann::json::array();
+            const int begin = first + (page - 1) * page_size;
+            for (int id = begin; id <= last && id < begin + page_size; ++id)
+            {
+                payload["results"].push_back({{"id", id}, {"name", "sound " + std::to_string(id)}});
+            }
+            payload["count"] = std::max(0, last - first + 1);
+            payload["next"] = begin + page_size <= last
+                ? nlohmann::json("next-page") : nlohmann::json(nullptr);
+            return payload.dump();
+        };
+    }
+
+    FreesoundDownloader::CrawlOptions testOptions(const std::filesystem::path& job_dir)
+    {
+        FreesoundDownloader::CrawlOptions options;
+        options.min_id = 1;
+        options.max_id = 1000;
+        options.range_size = 100;
+        options.page_size = 30;
+        options.requests_per_minute = 600000;
+        options.max_workers = 4;
+        options.job_dir = job_dir.string();
+        return options;
+    }
+
+    void collectIds(const std::string& json, std::multiset<int>& ids)
+    {
+        const auto payload = nlohmann::json::parse(json);
+        for (const auto& sound : payload["results"])
+        {
+            ids.insert(sound["id"].get<int>());
+        }
+    }
+}
+
+TEST_CASE("Catalog Crawler Range Planning") {
+    using FreesoundDownloader::CatalogCrawler;
+    CHECK(CatalogCrawler::rangeFilter(1, 5000) == "id:[1 TO 5000]");
+
+    FreesoundDownloader::CrawlOptions options;
+    options.min_id = 1;
+    options.max_id = 10000;
+    options.range_size = 1000;
+
+    // 60 requests/minute at 1.5 s per page keeps two requests in flight
+    options.requests_per_minute = 60;
+    options.expected_latency = std::chrono::milliseconds(1500);
+    CHECK(CatalogCrawler(fakeCatalog(0), options).workerCount() == 2);
+
+    // Never more workers than ranges
+    options.requests_per_minute = 6000;
+    CHECK(CatalogCrawler(fakeCatalog(0), options).workerCount() == 10);
+
+    options.range_size = 0;
+    CHECK_THROWS_AS(CatalogCrawler(fakeCatalog(0), options), std::invalid_argument);
+}
+
+TEST_CASE("Catalog Crawler Covers Every Range Once") {
+    auto job_dir = freshDir("crawl_full");
+    FreesoundDownloader::CatalogCrawler crawler(fakeCatalog(950), testOptions(job_dir));
+
+    std::multiset<int> ids;
+    auto stats = crawler.run([&ids](int, int, int, const std::string& json) {
+        collectIds(json, ids);
+        return true;
+    });
+
+    CHECK(stats.ranges_completed == 10);
+    CHECK(stats.ranges_failed == 0);
+    CHECK(ids.size() == 950);
+    CHECK(std::set<int>(ids.begin(), ids.end()).size() == 950);
+    CHECK(std::filesystem::exists(job_dir / "range_901_1000.done"));
+    CHECK_FALSE(std::filesystem::exists(job_dir / "range_901_1000.claim"));
+
+    // A second run finds nothing left to do
+    auto rerun = FreesoundDownloader::CatalogCrawler(fakeCatalog(950), testOptions(job_dir))
+        .run([](int, int, int, const std::string&) { return true; });
+    CHECK(rerun.ranges_skipped == 10);
+    CHECK(rerun.pages_fetched == 0);
+
+    std::filesystem::remove_all(job_dir);
+}
+
+TEST_CASE("Catalog Crawler Resumes From Checkpoints") {
+    auto job_dir = freshDir("crawl_resume");
+    auto options = testOptions(job_dir);
+    options.max_workers = 1;
+
+    std::multiset<int> ids;
+    int pages = 0;
+    FreesoundDownloader::CatalogCrawler first_run(fakeCatalog(1000), options);
+    first_run.run([&](int, int, int, const std::string& json) {
+        collectIds(json, ids);
+        return ++pages < 5;
+    });
+    CHECK(pages == 5);
+
+    // A live claim held by another process is left alone; an abandoned one is taken over
+    std::ofstream(job_dir / "range_901_1000.claim") << "other-host-1\n";
+    std::ofstream(job_dir / "range_801_900.claim") << "crashed-host-2\n";
+    std::filesystem::last_write_time(
+        job_dir / "range_801_900.claim",
+        std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+
+    FreesoundDownloader::CatalogCrawler second_run(fakeCatalog(1000), options);
+    auto stats = second_run.run([&](int, int, int, const std::string& json) {
+        collectIds(json, ids);
+        return true;
+    });
+
+    // The range finished by the first run and the one still held elsewhere
+    CHECK(stats.ranges_skipped == 2);
+    CHECK(ids.size() == 900);
+    CHECK(std::set<int>(ids.begin(), ids.end()).size() == 900);
+    CHECK(ids.count(850) == 1);
+    CHECK(ids.count(950) == 0);
+
+    std::filesystem::remove_all(job_dir);
+}
+
+TEST_CASE("Catalog Crawler Keeps Ranges Whose Progress Cannot Be Written") {
+    auto job_dir = freshDir("crawl_unwritable");
+    auto options = testOptions(job_dir);
+    options.max_id = 200;
+
+    // A directory in the way of the first range's checkpoint
+    std::filesystem::create_directories(job_dir / "range_1_100.progress" / "blocker");
+
+    FreesoundDownloader::CatalogCrawler crawler(fakeCatalog(200), options);
+    auto stats = crawler.run([](int, int, int, const std::string&) { return true; });
+
+    CHECK(stats.ranges_completed == 1);
+    CHECK(stats.ranges_failed == 1);
+    CHECK(std::filesystem::exists(job_dir / "range_101_200.done"));
+    CHECK_FALSE(std::filesystem::exists(job_dir / "range_1_100.done"));
+
+    // The claim stays until its lease expires, so the range is resumed rather than redone
+    CHECK(std::filesystem::exists(job_dir / "range_1_100.claim"));
+
+    std::filesystem::remove_all(job_dir);
+}
@@ -0,0 +1,105 @@
+#include <doctest/doctest.h>
+#include "columnar_export.h"
+#include "test_files.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+}
+
+TEST_CASE("Columnar Export Round Trip") {
+    using FreesoundDownloader::ColumnarWriter;
+
+    ColumnarWriter writer;
+    auto appended = writer.appendSearchResults(R"({
+        "count": 3,
+        "results": [
+            {"id": 101, "name": "kick", "username": "alice", "duration": 0.5,
+             "tags": ["drum", "kick"], "previews": {"preview-hq-mp3": "https://cdn/101.mp3"}},
+            {"id": 102, "name": "snare", "username": "bob", "duration": 0.75,
+             "tags": ["drum"], "preview-hq-mp3": "https://cdn/102.mp3"},
+            {"id": 103, "name": "kick", "username": "alice", "description": "second kick"}
+        ]
+    })");
+    REQUIRE(appended.has_value());
+    CHECK(*appended == 3);
+    CHECK_FALSE(writer.appendSearchResults("not json").has_value());
+
+    const auto dir = freshDir("columnar");
+    const std::string path = (dir / "sounds.fscol").string();
+    REQUIRE(writer.write(path));
+
+    FreesoundDownloader::ColumnarReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(reader.rowCount() == 3);
+
+    auto ids = reader.int64Column(ColumnarWriter::ID_COLUMN);
+    REQUIRE(ids.has_value());
+    CHECK((*ids)[0] == 101);
+    CHECK((*ids)[2] == 103);
+    CHECK(reinterpret_cast<uintptr_t>(ids->data()) % 64 == 0);
+
+    auto durations = reader.float64Column(ColumnarWriter::DURATION_COLUMN);
+    REQUIRE(durations.has_value());
+    CHECK((*durations)[1] == doctest::Approx(0.75));
+
+    auto names = reader.stringColumn(ColumnarWriter::NAME_COLUMN);
+    REQUIRE(names.has_value());
+    CHECK((*names)[0] == "kick");
+    CHECK((*names)[1] == "snare");
+    CHECK(names->dictionary().size() == 2);
+    CHECK(names->codes()[0] == names->codes()[2]);
+
+    auto previews = reader.stringColumn(ColumnarWriter::PREVIEW_COLUMN);
+    REQUIRE(previews.has_value());
+    CHECK((*previews)[0] == "https://cdn/101.mp3");
+    CHECK((*previews)[1] == "https://cdn/102.mp3");
+    CHECK((*previews)[2].empty());
+
+    auto tags = reader.stringListColumn(ColumnarWriter::TAGS_COLUMN);
+    REQUIRE(tags.has_value());
+    CHECK(tags->row(0).size() == 2);
+    CHECK(tags->dictionary()[tags->row(0)[1]] == "kick");
+    CHECK(tags->row(2).empty());
+
+    // Type mismatches and unknown names are rejected
+    CHECK_FALSE(reader.int64Column(ColumnarWriter::NAME_COLUMN).has_value());
+    CHECK_FALSE(reader.stringColumn("license").has_value());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Columnar Export Rejects Damaged Files") {
+    FreesoundDownloader::ColumnarWriter writer;
+    FreesoundDownloader::SoundMetadata record;
+    record.id = 7;
+    record.name = "rain";
+    writer.append(record);
+
+    const auto dir = freshDir("columnar_damaged");
+    const std::string path = (dir / "sounds.fscol").string();
+    REQUIRE(writer.write(path));
+
+    FreesoundDownloader::ColumnarReader reader;
+    const auto size = std::filesystem::file_size(path);
+
+    // A row count whose section sizes wrap around to those of one row
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        const uint64_t row_count = (uint64_t(1) << 62) + 1;
+        file.seekp(static_cast<std::streamoff>(size - 16));
+        file.write(reinterpret_cast<const char*>(&row_count), sizeof(row_count));
+    }
+    CHECK_FALSE(reader.open(path));
+
+    // Chop off the trailer
+    std::filesystem::resize_file(path, size - 4);
+
+    CHECK_FALSE(reader.open(path));
+    CHECK_FALSE(reader.open((dir / "missing.fscol").string()));
+
+    std::filesystem::remove_all(dir);
+}
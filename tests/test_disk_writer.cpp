@@ -0,0 +1,116 @@
+#include <doctest/doctest.h>
+#include "disk_writer.h"
+#include "atomic_file.h"
+#include "test_files.h"
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    std::string patternBytes(size_t size, unsigned seed)
+    {
+        std::string bytes(size, '\0');
+        uint32_t state = seed * 2654435761u + 1;
+        for (auto& byte : bytes)
+        {
+            state = state * 1664525u + 1013904223u;
+            byte = static_cast<char>(state >> 24);
+        }
+        return bytes;
+    }
+
+    /// Writes several files concurrently through one writer in uneven chunks
+    void writeConcurrently(FreesoundDownloader::DiskWriter& writer, const std::filesystem::path& dir)
+    {
+        const std::vector<size_t> sizes = {0, 1, 4095, 4096, 4097, 50000, 123457};
+        std::vector<std::string> expected(sizes.size());
+        std::vector<int> results(sizes.size(), 0);
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            expected[i] = patternBytes(sizes[i], static_cast<unsigned>(i));
+            threads.emplace_back([&, i]() {
+                FreesoundDownloader::AtomicFile file;
+                if (!file.open((dir / (std::to_string(i) + ".bin")).string()))
+                {
+                    return;
+                }
+
+                FreesoundDownloader::DiskWriter::File out(writer, file.descriptor());
+                bool ok = true;
+                for (size_t offset = 0; offset < expected[i].size(); offset += 1000)
+                {
+                    const size_t chunk = std::min<size_t>(1000, expected[i].size() - offset);
+                    ok = ok && out.append(expected[i].data() + offset, chunk);
+                }
+                ok = ok && out.finish() && out.size() == expected[i].size();
+                results[i] = ok && file.commit(false) ? 1 : 0;
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            CHECK(results[i] == 1);
+            CHECK(readFile(dir / (std::to_string(i) + ".bin")) == expected[i]);
+        }
+    }
+}
+
+TEST_CASE("Disk Writer Round Trips Through Each Backend") {
+    auto dir = freshDir("disk_writer_backends");
+
+    FreesoundDownloader::DiskWriterOptions options;
+    options.buffer_size = 4096;
+    options.buffer_count = 3;
+
+    options.backend = FreesoundDownloader::DiskWriterBackend::Pwrite;
+    auto pwrite_writer = FreesoundDownloader::makeDiskWriter(options);
+    CHECK(std::string(pwrite_writer->name()) == "pwrite");
+    writeConcurrently(*pwrite_writer, dir);
+
+    // Falls back to pwrite where io_uring is unavailable
+    options.backend = FreesoundDownloader::DiskWriterBackend::IoUring;
+    auto uring_writer = FreesoundDownloader::makeDiskWriter(options);
+    MESSAGE("io_uring request served by backend: " << uring_writer->name());
+    writeConcurrently(*uring_writer, dir);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Disk Writer Trims Direct I/O Padding") {
+    // Use the working directory: tmpfs typically rejects O_DIRECT, in which
+    // case the writer silently keeps using buffered writes
+    auto dir = std::filesystem::current_path() / "freesound_disk_writer_direct";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    FreesoundDownloader::DiskWriterOptions options;
+    options.direct_io = true;
+    options.buffer_size = 10000;
+    auto writer = FreesoundDownloader::makeDiskWriter(options);
+    CHECK(writer->directIo());
+    CHECK(writer->bufferSize() == 12288);
+
+    const std::string contents = patternBytes(30001, 7);
+    FreesoundDownloader::AtomicFile file;
+    REQUIRE(file.open((dir / "direct.bin").string()));
+    {
+        FreesoundDownloader::DiskWriter::File out(*writer, file.descriptor());
+        REQUIRE(out.append(contents.data(), contents.size()));
+        REQUIRE(out.finish());
+    }
+    REQUIRE(file.commit(true));
+
+    CHECK(std::filesystem::file_size(dir / "direct.bin") == contents.size());
+    CHECK(readFile(dir / "direct.bin") == contents);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,88 @@
+#include <doctest/doctest.h>
+#include "download_sink.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    /// Feeds a body to a sink the way a download does
+    bool deliver(FreesoundDownloader::DownloadSink& sink, const std::string& body,
+        std::optional<uint64_t> content_length, size_t chunk)
+    {
+        if (!sink.begin(content_length))
+        {
+            return false;
+        }
+        for (size_t offset = 0; offset < body.size(); offset += chunk)
+        {
+            if (!sink.write(body.data() + offset, std::min(chunk, body.size() - offset)))
+            {
+                sink.abort();
+                return false;
+            }
+        }
+        return sink.end();
+    }
+}
+
+TEST_CASE("File Sink Commits Complete Bodies Only") {
+    const auto dir = freshDir("download_sink");
+    const std::string body(10000, 'w');
+
+    // Announced length larger than the body: the preallocation is trimmed
+    const auto path = (dir / "complete.wav").string();
+    FreesoundDownloader::FileSink sink(path, FreesoundDownloader::SyncPolicy::None);
+    REQUIRE(deliver(sink, body, body.size() + 5000, 4096));
+    CHECK(std::filesystem::file_size(path) == body.size());
+
+    const auto aborted_path = (dir / "aborted.wav").string();
+    FreesoundDownloader::FileSink aborted(aborted_path);
+    REQUIRE(aborted.begin(std::nullopt));
+    REQUIRE(aborted.write(body.data(), 100));
+    aborted.abort();
+    CHECK_FALSE(std::filesystem::exists(aborted_path));
+    CHECK(std::distance(std::filesystem::directory_iterator(dir), {}) == 1);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Memory, Stream And Callback Sinks Receive Every Chunk") {
+    std::string body;
+    for (int i = 0; i < 20000; ++i)
+    {
+        body += static_cast<char>('A' + i % 23);
+    }
+
+    FreesoundDownloader::BufferPool pool;
+    FreesoundDownloader::MemorySink memory(pool);
+    REQUIRE(deliver(memory, body, body.size(), 1500));
+    CHECK(memory.buffer().capacity() == FreesoundDownloader::BufferPool::MIN_BLOCK);
+    auto buffer = memory.take();
+    REQUIRE(buffer.size() == body.size());
+    CHECK(std::memcmp(buffer.data(), body.data(), body.size()) == 0);
+
+    // Without a length the buffer grows as chunks arrive
+    FreesoundDownloader::MemorySink unsized(pool);
+    REQUIRE(deliver(unsized, body + body + body + body, std::nullopt, 7000));
+    CHECK(unsized.buffer().size() == 4 * body.size());
+
+    std::ostringstream out;
+    FreesoundDownloader::StreamSink stream(out);
+    REQUIRE(deliver(stream, body, std::nullopt, 333));
+    CHECK(out.str() == body);
+
+    size_t received = 0;
+    FreesoundDownloader::CallbackSink callback([&received](const char*, size_t size) {
+        received += size;
+        return received < 5000;
+    });
+    CHECK_FALSE(deliver(callback, body, std::nullopt, 1000));
+    CHECK(received == 5000);
+}
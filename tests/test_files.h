@@ -0,0 +1,181 @@
+#pragma once
+
+// Files for tests: empty scratch directories, whole-file reads, and builders
+// of little and big endian fields and of PCM WAV and AIFF files around a
+// given set of samples. Buffers are std::vector<uint8_t> or std::string.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace FreesoundDownloader
+{
+    namespace Testing
+    {
+        /// Creates an empty directory under the system temporary directory, removing any earlier one
+        inline std::filesystem::path freshDir(const std::string& name)
+        {
+            auto dir = std::filesystem::temp_directory_path() / ("freesound_" + name);
+            std::filesystem::remove_all(dir);
+            std::filesystem::create_directories(dir);
+            return dir;
+        }
+
+        /// Returns the contents of a file, empty if it cannot be read
+        inline std::string readFile(const std::filesystem::path& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        /// Appends a chunk or magic tag without its terminator
+        template <typename Buffer>
+        void putTag(Buffer& out, const char* tag)
+        {
+            out.insert(out.end(), tag, tag + std::strlen(tag));
+        }
+
+        template <typename Buffer>
+        void putLe(Buffer& out, uint64_t value, int bytes)
+        {
+            for (int i = 0; i < bytes; ++i)
+            {
+                out.push_back(static_cast<typename Buffer::value_type>(value >> (8 * i)));
+            }
+        }
+
+        template <typename Buffer>
+        void putBe(Buffer& out, uint64_t value, int bytes)
+        {
+            for (int i = bytes - 1; i >= 0; --i)
+            {
+                out.push_back(static_cast<typename Buffer::value_type>(value >> (8 * i)));
+            }
+        }
+
+        /// Appends a sample rate as an 80-bit extended float, as AIFF stores it
+        template <typename Buffer>
+        void putExtended(Buffer& out, uint32_t rate)
+        {
+            // Biased exponent, then the mantissa with an explicit leading one
+            int exponent = 0;
+            while ((static_cast<uint64_t>(rate) >> exponent) > 1)
+            {
+                ++exponent;
+            }
+            putBe(out, 16383 + exponent, 2);
+            putBe(out, static_cast<uint64_t>(rate) << (63 - exponent), 8);
+        }
+
+        /// Chunks placed around the samples of a WAV file
+        struct WavLayout
+        {
+            /// Bytes of a LIST chunk between "fmt " and "data" (none when 0)
+            size_t metadata = 0;
+
+            /// Adds a stray byte after the samples, which pads the data chunk
+            bool odd_tail = false;
+
+            /// Adds an empty LIST INFO chunk after the samples
+            bool trailing_info = false;
+        };
+
+        /**
+         * @brief Builds a PCM WAV file
+         *
+         * @param samples Interleaved samples, signed for every width
+         * @param channels Number of channels
+         * @param bits Bits per sample, a multiple of 8
+         * @param rate Frames per second
+         * @param layout Chunks around the samples
+         */
+        template <typename Buffer = std::vector<uint8_t>>
+        Buffer pcmWav(const std::vector<int32_t>& samples, unsigned channels, unsigned bits, uint32_t rate,
+            const WavLayout& layout = {})
+        {
+            const unsigned bytes = bits / 8;
+            const size_t metadata = layout.metadata ? 8 + layout.metadata + (layout.metadata & 1) : 0;
+            const size_t data = samples.size() * bytes + (layout.odd_tail ? 1 : 0);
+            const size_t trailer = layout.trailing_info ? 12 : 0;
+            Buffer out;
+            putTag(out, "RIFF");
+            putLe(out, 4 + 24 + metadata + 8 + data + (data & 1) + trailer, 4);
+            putTag(out, "WAVE");
+            putTag(out, "fmt ");
+            putLe(out, 16, 4);
+            putLe(out, 1, 2);
+            putLe(out, channels, 2);
+            putLe(out, rate, 4);
+            putLe(out, static_cast<uint64_t>(rate) * channels * bytes, 4);
+            putLe(out, channels * bytes, 2);
+            putLe(out, bits, 2);
+            if (layout.metadata)
+            {
+                putTag(out, "LIST");
+                putLe(out, layout.metadata, 4);
+                out.resize(out.size() + layout.metadata + (layout.metadata & 1), 0);
+            }
+            putTag(out, "data");
+            putLe(out, data, 4);
+            for (int32_t sample : samples)
+            {
+                // 8-bit WAV samples are unsigned
+                putLe(out, bits == 8 ? static_cast<uint32_t>(sample + 128) : static_cast<uint32_t>(sample), bytes);
+            }
+            if (layout.odd_tail)
+            {
+                out.push_back(0x5A);
+            }
+            if (data & 1)
+            {
+                out.push_back(0);
+            }
+            if (layout.trailing_info)
+            {
+                putTag(out, "LIST");
+                putLe(out, 4, 4);
+                putTag(out, "INFO");
+            }
+            return out;
+        }
+
+        /**
+         * @brief Builds an AIFF file of big endian PCM
+         *
+         * @param samples Interleaved samples
+         * @param channels Number of channels
+         * @param bits Bits per sample, a multiple of 8
+         * @param rate Frames per second
+         */
+        template <typename Buffer = std::vector<uint8_t>>
+        Buffer pcmAiff(const std::vector<int32_t>& samples, unsigned channels, unsigned bits, uint32_t rate)
+        {
+            const unsigned bytes = bits / 8;
+            const size_t data = samples.size() * bytes;
+            Buffer out;
+            putTag(out, "FORM");
+            putBe(out, 4 + 26 + 16 + data, 4);
+            putTag(out, "AIFF");
+            putTag(out, "COMM");
+            putBe(out, 18, 4);
+            putBe(out, channels, 2);
+            putBe(out, samples.size() / channels, 4);
+            putBe(out, bits, 2);
+            putExtended(out, rate);
+            putTag(out, "SSND");
+            putBe(out, 8 + data, 4);
+            putBe(out, 0, 4);
+            putBe(out, 0, 4);
+            for (int32_t sample : samples)
+            {
+                putBe(out, static_cast<uint32_t>(sample), bytes);
+            }
+            return out;
+        }
+    }
+}
@@ -0,0 +1,273 @@
+#include <doctest/doctest.h>
+#include "ingest_pipeline.h"
+#include "audio_decoder.h"
+#include "float_wav_writer.h"
+#include "freesound_downloader.h"
+#include "local_http_server.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    int16_t toneSample(size_t frame, unsigned channel, double rate)
+    {
+        return static_cast<int16_t>(std::lround(16000.0 * std::sin(2.0 * PI * 440.0 * frame / rate + channel)));
+    }
+
+    std::vector<int32_t> tone(size_t frames, unsigned channels, uint32_t rate)
+    {
+        std::vector<int32_t> samples;
+        samples.reserve(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            for (unsigned channel = 0; channel < channels; ++channel)
+            {
+                samples.push_back(toneSample(i, channel, rate));
+            }
+        }
+        return samples;
+    }
+
+    std::string makeWav(size_t frames, unsigned channels, uint32_t rate)
+    {
+        return pcmWav<std::string>(tone(frames, channels, rate), channels, 16, rate);
+    }
+
+    std::string makeAiff(size_t frames, uint32_t rate)
+    {
+        return pcmAiff<std::string>(tone(frames, 1, rate), 1, 16, rate);
+    }
+
+    /// 16-bit WAV of a random tune of short notes, which renders the same at any rate
+    std::string makeTuneWav(unsigned seed, uint32_t rate, unsigned channels, double gain)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> pitch(48.0, 96.0);
+        const size_t frames = 6 * rate;
+        std::vector<double> mono(frames, 0.0);
+        for (double start = 0.0; start < 6.0; start += 0.15)
+        {
+            const double frequency = 440.0 * std::pow(2.0, (pitch(generator) - 69.0) / 12.0);
+            for (size_t i = static_cast<size_t>(start * rate); i < frames && i < (start + 0.25) * rate; ++i)
+            {
+                mono[i] += gain * 8000.0 * std::sin(2.0 * PI * frequency * (static_cast<double>(i) / rate - start));
+            }
+        }
+
+        std::vector<int32_t> samples;
+        samples.reserve(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            samples.insert(samples.end(), channels, static_cast<int16_t>(std::lround(mono[i])));
+        }
+        return pcmWav<std::string>(samples, channels, 16, rate);
+    }
+
+    std::vector<uint8_t> readBytes(const std::filesystem::path& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+}
+
+TEST_CASE("Float WAV Writer Produces A Readable File") {
+    const auto dir = freshDir("float_wav");
+
+    FreesoundDownloader::FloatWavWriter writer;
+    REQUIRE(writer.open((dir / "out.wav").string(), 48000, 2));
+    const std::vector<float> samples = {0.0f, 0.25f, -0.5f, 1.0f, 0.125f, -1.0f};
+    REQUIRE(writer.write(samples.data(), 4));
+    REQUIRE(writer.write(samples.data() + 4, 2));
+    CHECK(writer.frames() == 3);
+    CHECK_FALSE(std::filesystem::exists(dir / "out.wav"));
+    REQUIRE(writer.commit(false));
+
+    const auto file = readBytes(dir / "out.wav");
+    CHECK(file.size() == FreesoundDownloader::FloatWavWriter::HEADER_SIZE + samples.size() * 4);
+    auto decoder = FreesoundDownloader::AudioDecoder::create(FreesoundDownloader::AudioFormat::Wav);
+    std::vector<float> decoded;
+    REQUIRE(decoder->push(file.data(), file.size(), decoded));
+    REQUIRE(decoder->finish(decoded));
+    CHECK(decoder->info()->sample_rate == 48000);
+    CHECK(decoder->info()->channels == 2);
+    CHECK(decoder->info()->bits_per_sample == 32);
+    CHECK(decoded == samples);
+
+    std::filesystem::remove_all(dir);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Ingest Pipeline Converts Sounds While They Download") {
+    // Throttled so that decoding genuinely overlaps the transfers
+    FreesoundDownloader::Testing::LocalHttpServer server(16 * 1024, std::chrono::milliseconds(2));
+    server.serve("/apiv2/sounds/1/download/", makeWav(44100, 2, 44100));
+    server.serve("/apiv2/sounds/2/download/", makeAiff(24000, 48000));
+    server.serve("/apiv2/sounds/3/download/", makeWav(5000, 1, 22050));
+    server.serve("/apiv2/sounds/4/download/", "ID3 not a decodable format at all");
+    server.serve("/apiv2/sounds/5/download/", makeWav(2000, 1, 8000).substr(0, 1500));
+
+    FreesoundDownloader::Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+
+    FreesoundDownloader::IngestOptions options;
+    options.resample_workers = 0;
+    CHECK_THROWS_AS(FreesoundDownloader::IngestPipeline(downloader, options), std::invalid_argument);
+
+    // A single block per queue exercises the backpressure path
+    options.resample_workers = 2;
+    options.network_workers = 3;
+    options.queue_depth = 1;
+    options.sync_policy = FreesoundDownloader::SyncPolicy::None;
+    options.write_peaks = true;
+    options.peaks.levels = 0;
+    CHECK_THROWS_AS(FreesoundDownloader::IngestPipeline(downloader, options), std::invalid_argument);
+    options.peaks.levels = 3;
+    options.write_features = true;
+    options.similarity_index = std::make_shared<FreesoundDownloader::SimilarityIndex>(
+        FreesoundDownloader::SimilarityIndexOptions{7});
+    CHECK_THROWS_AS(FreesoundDownloader::IngestPipeline(downloader, options), std::invalid_argument);
+    options.similarity_index = std::make_shared<FreesoundDownloader::SimilarityIndex>();
+    FreesoundDownloader::IngestPipeline pipeline(downloader, options);
+
+    const auto dir = freshDir("ingest");
+    auto failed = pipeline.ingest({1, 2, 3, 4, 5, 6}, dir.string());
+    std::sort(failed.begin(), failed.end());
+    const std::vector<int> undecodable = {4, 5, 6};
+    CHECK(failed == undecodable);
+    CHECK_FALSE(std::filesystem::exists(dir / "4.wav"));
+    CHECK_FALSE(std::filesystem::exists(dir / "5.wav"));
+    CHECK_FALSE(std::filesystem::exists(dir / "4.peaks"));
+    CHECK_FALSE(std::filesystem::exists(dir / "4.features"));
+    CHECK(options.similarity_index->size() == 3);
+    CHECK_FALSE(options.similarity_index->contains(4));
+
+    struct Expected { int id; unsigned channels; size_t frames; };
+    for (const Expected& expected : {Expected{1, 2, 48000}, Expected{2, 1, 24000}, Expected{3, 1, 10885}})
+    {
+        const auto file = readBytes(dir / (std::to_string(expected.id) + ".wav"));
+        auto decoder = FreesoundDownloader::AudioDecoder::create(FreesoundDownloader::AudioFormat::Wav);
+        std::vector<float> samples;
+        REQUIRE(decoder->push(file.data(), file.size(), samples));
+        REQUIRE(decoder->finish(samples));
+        CHECK(decoder->info()->sample_rate == 48000);
+        CHECK(decoder->info()->bits_per_sample == 32);
+        REQUIRE(decoder->info()->channels == expected.channels);
+        REQUIRE(samples.size() == expected.frames * expected.channels);
+
+        // The tone survives the conversion
+        double worst = 0.0;
+        for (size_t i = 500; i + 500 < expected.frames; ++i)
+        {
+            for (unsigned channel = 0; channel < expected.channels; ++channel)
+            {
+                const double ideal = 16000.0 / 32768.0 * std::sin(2.0 * PI * 440.0 * i / 48000.0 + channel);
+                worst = std::max(worst, std::abs(samples[i * expected.channels + channel] - ideal));
+            }
+        }
+        CHECK(worst < 2e-3);
+
+        // The overview describes the converted file
+        const auto peaks = FreesoundDownloader::WaveformPeaks::load(
+            (dir / (std::to_string(expected.id) + ".peaks")).string());
+        REQUIRE(peaks.has_value());
+        CHECK(peaks->frames == expected.frames);
+        CHECK(peaks->sample_rate == 48000);
+        REQUIRE(peaks->levels.size() == 3);
+        CHECK(peaks->levels[0].size() == (expected.frames + 255) / 256);
+        CHECK(peaks->levels[0].max[peaks->levels[0].size() / 2] >= 61);
+        CHECK(peaks->levels[0].min[peaks->levels[0].size() / 2] <= -61);
+
+        const auto features = FreesoundDownloader::AudioFeatures::load(
+            (dir / (std::to_string(expected.id) + ".features")).string());
+        REQUIRE(features.has_value());
+        CHECK(features->frames > 0);
+        CHECK(features->centroid_mean == doctest::Approx(440.0).epsilon(0.1));
+
+        // The index holds the embedding, and the other two tones are its neighbours
+        const auto embedding = features->embedding();
+        const auto nearest = options.similarity_index->query(embedding.data(), 1);
+        REQUIRE(nearest.size() == 1);
+        CHECK(nearest[0].sound_id == expected.id);
+        CHECK(nearest[0].distance == 0.0f);
+        CHECK(options.similarity_index->similarTo(expected.id, 5).size() == 2);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Ingest Pipeline Recognises Duplicate Sounds") {
+    using namespace FreesoundDownloader;
+
+    Testing::LocalHttpServer server;
+    server.serve("/apiv2/sounds/10/download/", makeTuneWav(1, 44100, 2, 1.0));
+    server.serve("/apiv2/sounds/11/download/", makeTuneWav(1, 22050, 1, 0.5));
+    server.serve("/apiv2/sounds/12/download/", makeTuneWav(2, 44100, 1, 1.0));
+    server.serve("/apiv2/sounds/13/download/", makeTuneWav(2, 48000, 2, 0.7));
+
+    Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+
+    IngestOptions options;
+    options.sync_policy = SyncPolicy::None;
+    options.fingerprint_index = std::make_shared<FingerprintIndex>();
+    options.fingerprints.fft_size = 1000;
+    CHECK_THROWS_AS(IngestPipeline(downloader, options), std::invalid_argument);
+    options.fingerprints = {};
+
+    std::mutex mutex;
+    std::vector<std::pair<int, int>> reported;
+    options.on_duplicate = [&](int sound_id, const FingerprintMatch& original) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reported.emplace_back(sound_id, original.sound_id);
+    };
+
+    const auto dir = freshDir("ingest_duplicates");
+    {
+        IngestPipeline pipeline(downloader, options);
+        CHECK(pipeline.ingest({10, 12}, dir.string()).empty());
+        CHECK(options.fingerprint_index->size() == 2);
+        CHECK(reported.empty());
+
+        // A quieter mono copy at another rate is written but reported
+        CHECK(pipeline.ingest({11}, dir.string()).empty());
+        CHECK(std::filesystem::exists(dir / "11.wav"));
+        REQUIRE(reported.size() == 1);
+        CHECK(reported[0] == std::make_pair(11, 10));
+        CHECK(options.fingerprint_index->contains(11));
+    }
+
+    // Under DuplicatePolicy::Reference a copy only points at its original
+    options.duplicates = DuplicatePolicy::Reference;
+    IngestPipeline pipeline(downloader, options);
+    CHECK(pipeline.ingest({13}, dir.string()).empty());
+    CHECK_FALSE(std::filesystem::exists(dir / "13.wav"));
+    std::ifstream reference(dir / "13.ref");
+    std::string original;
+    std::getline(reference, original);
+    CHECK(original == "12");
+    REQUIRE(reported.size() == 2);
+    CHECK(reported[1] == std::make_pair(13, 12));
+    CHECK_FALSE(options.fingerprint_index->contains(13));
+
+    // Sounds already indexed are ingested again as usual
+    CHECK(pipeline.ingest({10}, dir.string()).empty());
+    CHECK(reported.size() == 2);
+
+    std::filesystem::remove_all(dir);
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include <doctest/doctest.h>
+#include "lossless_codec.h"
+#include "test_files.h"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+    using Bytes = std::vector<uint8_t>;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    /// Chords with a little noise, full scale for the width, one tone per channel
+    std::vector<int32_t> music(size_t frames, unsigned channels, unsigned bits, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::normal_distribution<double> noise(0.0, 0.002);
+        const double peak = std::ldexp(1.0, static_cast<int>(bits) - 1) - 1.0;
+        std::vector<int32_t> samples(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            const double t = static_cast<double>(i) / 44100.0;
+            const double common = 0.3 * std::sin(2 * PI * 220.0 * t) + 0.2 * std::sin(2 * PI * 331.0 * t);
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                const double value = common + 0.1 * std::sin(2 * PI * (500.0 + 70.0 * c) * t) + noise(generator);
+                samples[i * channels + c] = static_cast<int32_t>(std::lround(peak * value));
+            }
+        }
+        return samples;
+    }
+
+    /// 44.1 kHz WAV ending in a metadata chunk that must survive the round trip
+    Bytes wav(const std::vector<int32_t>& samples, unsigned channels, unsigned bits, bool odd_tail = false)
+    {
+        return pcmWav(samples, channels, bits, 44100, {0, odd_tail, true});
+    }
+
+    Bytes aiff(const std::vector<int32_t>& samples, unsigned channels, unsigned bits)
+    {
+        return pcmAiff(samples, channels, bits, 44100);
+    }
+
+    bool roundTrips(const Bytes& file, const FreesoundDownloader::LosslessOptions& options = {})
+    {
+        using namespace FreesoundDownloader;
+        const auto packed = compressPcmFile(file.data(), file.size(), options);
+        if (!packed || !isCompressedPcmFile(packed->data(), packed->size()) || packed->size() >= file.size())
+        {
+            return false;
+        }
+        const auto unpacked = decompressPcmFile(packed->data(), packed->size(), 1);
+        const auto parallel = decompressPcmFile(packed->data(), packed->size(), 4);
+        return unpacked && parallel && *unpacked == file && *parallel == file;
+    }
+}
+
+TEST_CASE("Lossless Codec Round Trips PCM Files") {
+    using namespace FreesoundDownloader;
+
+    for (unsigned bits : {8u, 16u, 24u})
+    {
+        for (unsigned channels : {1u, 2u, 6u})
+        {
+            const auto samples = music(20011, channels, bits, bits + channels);
+            CHECK(roundTrips(wav(samples, channels, bits)));
+            CHECK(roundTrips(aiff(samples, channels, bits)));
+        }
+    }
+
+    // A trailing partial frame, small blocks, every order, all the threads
+    const auto stereo = music(9000, 2, 16, 7);
+    CHECK(roundTrips(wav(stereo, 2, 16, true)));
+    LosslessOptions options;
+    options.block_frames = 16;
+    options.max_order = 32;
+    options.threads = 3;
+    CHECK(roundTrips(wav(stereo, 2, 16), options));
+    options.block_frames = 65536;
+    options.max_order = 1;
+    CHECK(roundTrips(wav(stereo, 2, 16), options));
+
+    // Silence, identical channels, full-scale noise (which does not shrink)
+    CHECK(roundTrips(wav(std::vector<int32_t>(40000, 0), 2, 16)));
+    std::vector<int32_t> twins(stereo.size());
+    for (size_t i = 0; i < twins.size(); ++i)
+    {
+        twins[i] = stereo[i / 2 * 2];
+    }
+    CHECK(roundTrips(wav(twins, 2, 16)));
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int32_t> full(-32768, 32767);
+    std::vector<int32_t> noise(40000);
+    for (auto& sample : noise)
+    {
+        sample = full(generator);
+    }
+    const auto noisy = wav(noise, 1, 16);
+    CHECK_FALSE(compressPcmFile(noisy.data(), noisy.size()).has_value());
+
+    // Music compresses well
+    const auto file = wav(music(44100 * 2, 2, 16, 1), 2, 16);
+    const auto packed = compressPcmFile(file.data(), file.size());
+    REQUIRE(packed.has_value());
+    CHECK(packed->size() < file.size() * 6 / 10);
+
+    options = {};
+    options.block_frames = 8;
+    CHECK_THROWS_AS(compressPcmFile(file.data(), file.size(), options), std::invalid_argument);
+    options = {};
+    options.max_order = 33;
+    CHECK_THROWS_AS(compressPcmFile(file.data(), file.size(), options), std::invalid_argument);
+}
+
+TEST_CASE("Lossless Codec Rejects Other And Damaged Files") {
+    using namespace FreesoundDownloader;
+
+    // Float WAV, 32-bit PCM and non-audio are left alone
+    const auto samples = music(4000, 1, 16, 1);
+    auto file = wav(samples, 1, 16);
+    auto floats = file;
+    floats[20] = 3;
+    CHECK_FALSE(compressPcmFile(floats.data(), floats.size()).has_value());
+    const Bytes text(5000, 'x');
+    CHECK_FALSE(compressPcmFile(text.data(), text.size()).has_value());
+    CHECK_FALSE(isCompressedPcmFile(file.data(), file.size()));
+    CHECK_FALSE(decompressPcmFile(file.data(), file.size()).has_value());
+
+    const auto packed = compressPcmFile(file.data(), file.size());
+    REQUIRE(packed.has_value());
+
+    // Truncation, a wrong block table and flipped bits are noticed
+    for (size_t cut : {size_t(10), size_t(64), packed->size() / 2, packed->size() - 1})
+    {
+        CHECK_FALSE(decompressPcmFile(packed->data(), cut).has_value());
+    }
+    auto damaged = *packed;
+    damaged[36] ^= 1;
+    CHECK_FALSE(decompressPcmFile(damaged.data(), damaged.size()).has_value());
+
+    // Random damage to the block data must not crash; the result, if any, has the original size
+    std::mt19937 generator(11);
+    for (int i = 0; i < 200; ++i)
+    {
+        damaged = *packed;
+        std::uniform_int_distribution<size_t> position(200, damaged.size() - 1);
+        damaged[position(generator)] ^= static_cast<uint8_t>(1 + generator() % 255);
+        const auto result = decompressPcmFile(damaged.data(), damaged.size(), 2);
+        if (result)
+        {
+            CHECK(result->size() == file.size());
+        }
+    }
+}
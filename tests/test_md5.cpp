@@ -0,0 +1,77 @@
+#include <doctest/doctest.h>
+#include "md5.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string md5Hex(const std::string& text)
+    {
+        return FreesoundDownloader::Md5::toHex(FreesoundDownloader::Md5::hash(text.data(), text.size()));
+    }
+}
+
+TEST_CASE("MD5 Matches Reference Vectors") {
+    CHECK(md5Hex("") == "d41d8cd98f00b204e9800998ecf8427e");
+    CHECK(md5Hex("abc") == "900150983cd24fb0d6963f7d28e17f72");
+    CHECK(md5Hex("message digest") == "f96b697d7cb7938d525a2f31aaf161d0");
+    CHECK(md5Hex("The quick brown fox jumps over the lazy dog") == "9e107d9d372bb6826bd81d3542a419d6");
+    CHECK(md5Hex("12345678901234567890123456789012345678901234567890123456789012345678901234567890")
+        == "57edf4a22be3c955ac49da2e2107b67a");
+
+    // Feeding the same message in uneven pieces gives the same digest
+    std::string message;
+    for (int i = 0; i < 1000; ++i)
+    {
+        message.push_back(static_cast<char>(i * 31 + 7));
+    }
+    FreesoundDownloader::Md5 md5;
+    for (size_t offset = 0, step = 1; offset < message.size(); offset += step, step = step * 2 + 1)
+    {
+        md5.update(message.data() + offset, std::min(step, message.size() - offset));
+    }
+    CHECK(FreesoundDownloader::Md5::toHex(md5.finish()) == md5Hex(message));
+}
+
+TEST_CASE("MD5 Lanes Match Independent Hashes") {
+    // More messages than lanes, with lengths around block boundaries
+    const std::vector<size_t> lengths = {0, 1, 55, 56, 63, 64, 65, 127, 128, 1000, 4096, 4097, 70, 3};
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+        std::string message(lengths[i], '\0');
+        for (size_t j = 0; j < message.size(); ++j)
+        {
+            message[j] = static_cast<char>((i + 1) * (j + 3));
+        }
+        messages.push_back(message);
+    }
+
+    std::vector<FreesoundDownloader::Md5> hashers(messages.size());
+    std::vector<FreesoundDownloader::Md5*> lanes;
+    for (auto& hasher : hashers)
+    {
+        lanes.push_back(&hasher);
+    }
+
+    // Two rounds of lane updates: the first leaves partial blocks behind
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::vector<const uint8_t*> data;
+        std::vector<size_t> sizes;
+        for (const auto& message : messages)
+        {
+            const size_t half = message.size() / 3;
+            const size_t offset = pass == 0 ? 0 : half;
+            data.push_back(reinterpret_cast<const uint8_t*>(message.data()) + offset);
+            sizes.push_back(pass == 0 ? half : message.size() - half);
+        }
+        FreesoundDownloader::Md5::updateLanes(lanes.data(), data.data(), sizes.data(), lanes.size());
+    }
+
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        CHECK(FreesoundDownloader::Md5::toHex(hashers[i].finish()) == md5Hex(messages[i]));
+    }
+}
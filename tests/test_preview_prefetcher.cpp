@@ -0,0 +1,191 @@
+#include <doctest/doctest.h>
+#include "preview_prefetcher.h"
+#include "freesound_downloader.h"
+#include "local_http_server.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+TEST_CASE("Preview Cache Evicts The Least Recently Used Prefix") {
+    FreesoundDownloader::PreviewCache cache(250);
+    cache.put("a", std::string(100, 'a'));
+    cache.put("b", std::string(100, 'b'));
+    REQUIRE(cache.get("a"));
+
+    // "b" is now the oldest entry and makes room for "c"
+    cache.put("c", std::string(100, 'c'));
+    CHECK(cache.contains("a"));
+    CHECK_FALSE(cache.contains("b"));
+    CHECK(cache.contains("c"));
+    CHECK(cache.bytes() == 200);
+
+    // Replacing an entry does not count it twice; oversized prefixes are not cached
+    cache.put("a", std::string(50, 'A'));
+    CHECK(cache.bytes() == 150);
+    CHECK(*cache.get("a") == std::string(50, 'A'));
+    cache.put("huge", std::string(300, 'h'));
+    CHECK_FALSE(cache.contains("huge"));
+    CHECK(cache.get("missing") == nullptr);
+}
+
+#ifndef _WIN32
+
+namespace
+{
+    std::string makePreview(size_t size, char seed)
+    {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            body[i] = static_cast<char>(seed + i * 13 + i / 251);
+        }
+        return body;
+    }
+
+    bool contains(const std::vector<std::string>& requests, const std::string& request)
+    {
+        for (const auto& entry : requests)
+        {
+            if (entry == request)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+TEST_CASE("Search Prefetches Preview Prefixes That Streams Resume From") {
+    FreesoundDownloader::Testing::LocalHttpServer server;
+    const std::string first = makePreview(40 * 1024, 'a');
+    const std::string second = makePreview(40 * 1024, 'b');
+    const std::string third = makePreview(40 * 1024, 'c');
+    server.serve("/previews/1.mp3", first);
+    server.serve("/previews/2.mp3", second);
+    server.serve("/previews/3.mp3", third);
+
+    // Results without a usable preview URL do not take up prefetch slots
+    server.serve("/apiv2/search/text/", "{\"count\": 5, \"results\": ["
+        "{\"id\": 8},"
+        "{\"id\": 9, \"preview-hq-mp3\": 42},"
+        "{\"id\": 1, \"preview-hq-mp3\": \"" + server.url("/previews/1.mp3") + "\"},"
+        "{\"id\": 2, \"preview-hq-mp3\": \"" + server.url("/previews/2.mp3") + "\"},"
+        "{\"id\": 3, \"preview-hq-mp3\": \"" + server.url("/previews/3.mp3") + "\"}]}");
+
+    FreesoundDownloader::Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+    FreesoundDownloader::PrefetchPolicy policy;
+    policy.enabled = true;
+    policy.top_k = 2;
+    policy.prefix_bytes = 8 * 1024;
+    downloader.setPreviewPrefetch(policy);
+
+    REQUIRE(downloader.searchSounds("kick", std::nullopt));
+    auto prefetcher = downloader.previewPrefetcher();
+    REQUIRE(prefetcher);
+    REQUIRE(prefetcher->waitIdle(std::chrono::milliseconds(5000)));
+
+    const auto requests = server.requests();
+    CHECK(contains(requests, "/previews/1.mp3 bytes=0-8191"));
+    CHECK(contains(requests, "/previews/2.mp3 bytes=0-8191"));
+    CHECK_FALSE(contains(requests, "/previews/3.mp3 bytes=0-8191"));
+    CHECK(prefetcher->cache().bytes() == 16 * 1024);
+
+    // The prefix is playable before the stream's own request is answered
+    auto stream = downloader.streamPreview(server.url("/previews/1.mp3"));
+    REQUIRE(stream);
+    CHECK(stream->available() >= 8 * 1024);
+
+    std::string received(first.size(), '\0');
+    CHECK(stream->read(&received[0], received.size()) == first.size());
+    CHECK(received == first);
+    REQUIRE(stream->waitForData(1, std::chrono::milliseconds(5000)));
+    CHECK(stream->atEnd());
+    REQUIRE(stream->stats().content_length);
+    CHECK(*stream->stats().content_length == first.size());
+    CHECK(contains(server.requests(), "/previews/1.mp3 bytes=8192-"));
+
+    // A preview that was not prefetched streams from the start
+    auto cold = downloader.streamPreview(server.url("/previews/3.mp3"));
+    REQUIRE(cold);
+    received.assign(third.size(), '\0');
+    CHECK(cold->read(&received[0], received.size()) == third.size());
+    CHECK(received == third);
+}
+
+TEST_CASE("Foreground Traffic Pre-empts Prefetching") {
+    // 64 KiB at 1 KiB per 10 ms: a prefetch takes about 640 ms
+    FreesoundDownloader::Testing::LocalHttpServer server(1024, std::chrono::milliseconds(10));
+    const std::string preview = makePreview(64 * 1024, 'p');
+    server.serve("/previews/slow.mp3", preview);
+
+    FreesoundDownloader::PrefetchPolicy policy;
+    policy.enabled = true;
+    policy.prefix_bytes = preview.size();
+    auto owner = std::make_shared<FreesoundDownloader::PreviewPrefetcher>(policy);
+    auto& prefetcher = *owner;
+    prefetcher.prefetch({server.url("/previews/slow.mp3")});
+
+    // Let the prefetch get going, then claim the link
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server.requests().empty() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    {
+        auto foreground = prefetcher.foreground();
+        CHECK_FALSE(prefetcher.waitIdle(std::chrono::milliseconds(300)));
+        CHECK(prefetcher.preemptions() == 1);
+        CHECK_FALSE(prefetcher.cache().contains(server.url("/previews/slow.mp3")));
+        CHECK(server.requests().size() == 1);
+    }
+
+    // Once the foreground traffic is over the prefetch is retried and completes
+    REQUIRE(prefetcher.waitIdle(std::chrono::milliseconds(5000)));
+    CHECK(server.requests().size() == 2);
+    auto prefix = prefetcher.cache().get(server.url("/previews/slow.mp3"));
+    REQUIRE(prefix);
+    CHECK(*prefix == preview);
+}
+
+TEST_CASE("Streams Outlive The Prefetcher That Guarded Them") {
+    // 32 KiB at 1 KiB per 10 ms keeps each transfer running for about 320 ms
+    FreesoundDownloader::Testing::LocalHttpServer server(1024, std::chrono::milliseconds(10));
+    const std::string preview = makePreview(32 * 1024, 's');
+    server.serve("/previews/long.mp3", preview);
+
+    FreesoundDownloader::PrefetchPolicy policy;
+    policy.enabled = true;
+
+    std::unique_ptr<FreesoundDownloader::ProgressiveStream> orphaned;
+    {
+        FreesoundDownloader::Downloader downloader("test_api_key");
+        downloader.setPreviewPrefetch(policy);
+        std::weak_ptr<FreesoundDownloader::PreviewPrefetcher> first = downloader.previewPrefetcher();
+
+        // Turning prefetching off destroys the prefetcher while the stream still runs
+        auto stream = downloader.streamPreview(server.url("/previews/long.mp3"));
+        REQUIRE(stream);
+        downloader.setPreviewPrefetch(FreesoundDownloader::PrefetchPolicy{});
+        CHECK(first.expired());
+
+        std::string received(preview.size(), '\0');
+        CHECK(stream->read(&received[0], received.size()) == preview.size());
+        CHECK(received == preview);
+        stream.reset();
+
+        // Likewise for a stream that outlives the downloader itself
+        downloader.setPreviewPrefetch(policy);
+        orphaned = downloader.streamPreview(server.url("/previews/long.mp3"));
+        REQUIRE(orphaned);
+    }
+
+    std::string received(preview.size(), '\0');
+    CHECK(orphaned->read(&received[0], received.size()) == preview.size());
+    CHECK(received == preview);
+    orphaned.reset();
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include <doctest/doctest.h>
+#include "progressive_stream.h"
+#include "freesound_downloader.h"
+#include "local_http_server.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+
+namespace
+{
+    std::string makeBody(size_t size)
+    {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            body[i] = static_cast<char>((i * 31 + i / 7) & 0xFF);
+        }
+        return body;
+    }
+}
+
+TEST_CASE("Progressive Stream Starts Before The Transfer Ends") {
+    // 256 KiB at 8 KiB per 20 ms: the whole body takes about 650 ms
+    FreesoundDownloader::Testing::LocalHttpServer server(8 * 1024, std::chrono::milliseconds(20));
+    const std::string body = makeBody(256 * 1024);
+    server.serve("/preview.mp3", body);
+
+    const auto clicked = std::chrono::steady_clock::now();
+    FreesoundDownloader::ProgressiveStream stream(server.url("/preview.mp3"));
+    REQUIRE(stream.waitForData(16 * 1024, std::chrono::milliseconds(2000)));
+    const auto startup = std::chrono::steady_clock::now() - clicked;
+    CHECK(startup < std::chrono::milliseconds(250));
+    CHECK_FALSE(stream.complete());
+
+    auto stats = stream.stats();
+    CHECK(stats.fill >= 16 * 1024);
+    REQUIRE(stats.content_length);
+    CHECK(*stats.content_length == body.size());
+    REQUIRE(stats.time_to_first_byte);
+
+    std::string received(body.size() + 10, '\0');
+    CHECK(stream.read(&received[0], received.size()) == body.size());
+    received.resize(body.size());
+    CHECK(received == body);
+    CHECK(stream.complete());
+    CHECK(stream.atEnd());
+    CHECK(stream.stats().bytes_read == body.size());
+}
+
+TEST_CASE("Progressive Stream Bounds Memory And Counts Underruns") {
+    FreesoundDownloader::Testing::LocalHttpServer server;
+    const std::string body = makeBody(300 * 1024);
+    server.serve("/preview.mp3", body);
+
+    FreesoundDownloader::ProgressiveStreamOptions options;
+    options.capacity = 10 * 1024;
+    FreesoundDownloader::ProgressiveStream stream(server.url("/preview.mp3"), options);
+    CHECK(stream.stats().capacity == 16 * 1024);
+
+    // The transfer fills the ring and then waits for the reader
+    REQUIRE(stream.waitForData(16 * 1024, std::chrono::milliseconds(2000)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto stats = stream.stats();
+    CHECK(stats.fill == 16 * 1024);
+    CHECK(stats.bytes_received == 16 * 1024);
+    CHECK(stats.producer_stalls > 0);
+    CHECK(stats.underruns == 0);
+
+    // Drain with non-blocking reads the way an audio callback would
+    std::string received;
+    char block[4096];
+    while (!stream.atEnd())
+    {
+        const size_t copied = stream.tryRead(block, sizeof(block));
+        received.append(block, copied);
+        if (copied < sizeof(block))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    CHECK(received == body);
+    CHECK(stream.complete());
+    CHECK_FALSE(stream.failed());
+}
+
+TEST_CASE("Progressive Stream Reports Failures And Cancels Promptly") {
+    FreesoundDownloader::Testing::LocalHttpServer server(1024, std::chrono::milliseconds(20));
+    server.serve("/slow.mp3", makeBody(1024 * 1024));
+
+    {
+        FreesoundDownloader::ProgressiveStream missing(server.url("/missing.mp3"));
+        char byte = 0;
+        CHECK(missing.read(&byte, 1) == 0);
+        CHECK(missing.failed());
+        CHECK(missing.atEnd());
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    {
+        FreesoundDownloader::ProgressiveStream slow(server.url("/slow.mp3"));
+        REQUIRE(slow.waitForData(1, std::chrono::milliseconds(2000)));
+        char block[64];
+        CHECK(slow.tryRead(block, sizeof(block)) > 0);
+        slow.cancel();
+        while (!slow.atEnd())
+        {
+            slow.tryRead(block, sizeof(block));
+        }
+        CHECK(slow.failed());
+    }
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(2000));
+}
+
+TEST_CASE("Downloader Streams Previews From Sound Metadata") {
+    FreesoundDownloader::Testing::LocalHttpServer server;
+    const std::string body = makeBody(5000);
+    server.serve("/preview-hq.mp3", body);
+    server.serve("/apiv2/sounds/42/",
+        "{\"previews\": {\"preview-hq-mp3\": \"" + server.url("/preview-hq.mp3") + "\"}}");
+
+    FreesoundDownloader::Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+
+    auto stream = downloader.streamPreview(42);
+    REQUIRE(stream);
+    std::string received(body.size(), '\0');
+    CHECK(stream->read(&received[0], received.size()) == body.size());
+    CHECK(received == body);
+
+    CHECK_FALSE(downloader.streamPreview(43));
+}
+
+#endif
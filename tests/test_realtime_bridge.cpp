@@ -0,0 +1,188 @@
+#include <doctest/doctest.h>
+#include "realtime_bridge.h"
+#include "freesound_downloader.h"
+#include "spsc_queue.h"
+#include "local_http_server.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+
+// Counts heap activity on threads that opt in, to prove the audio path never allocates
+namespace
+{
+    thread_local bool t_count_heap = false;
+    std::atomic<size_t> g_counted_heap_calls{0};
+}
+
+void* operator new(std::size_t size)
+{
+    if (t_count_heap)
+    {
+        g_counted_heap_calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+// The replacement pairs new with malloc and delete with free, which GCC cannot see
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* memory) noexcept
+{
+    if (t_count_heap && memory)
+    {
+        g_counted_heap_calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    operator delete(memory);
+}
+
+TEST_CASE("SPSC Queue Hands Over Every Element In Order") {
+    FreesoundDownloader::SpscQueue<int> queue(3);
+    CHECK(queue.capacity() == 4);
+    CHECK_THROWS_AS(FreesoundDownloader::SpscQueue<int>(0), std::invalid_argument);
+
+    constexpr int COUNT = 200000;
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; ++i)
+        {
+            while (!queue.tryPush(int(i)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    int value = -1;
+    while (expected < COUNT)
+    {
+        if (queue.tryPop(value))
+        {
+            if (value != expected)
+            {
+                break;
+            }
+            ++expected;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(expected == COUNT);
+    CHECK_FALSE(queue.tryPop(value));
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Realtime Bridge Serves The Audio Thread Without Allocating") {
+    FreesoundDownloader::Testing::LocalHttpServer server;
+    for (int id = 1; id <= 6; ++id)
+    {
+        server.serve("/apiv2/sounds/" + std::to_string(id) + "/download/",
+            std::string(1000 * id, static_cast<char>('a' + id)));
+    }
+    server.serve("/apiv2/search/text/", "{\"count\": 0, \"results\": []}");
+
+    FreesoundDownloader::Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+
+    std::atomic<int> notifications{0};
+    FreesoundDownloader::RealtimeBridgeOptions options;
+    options.workers = 2;
+    options.max_ready = 2;
+    FreesoundDownloader::RealtimeBridge bridge(downloader, options, [&notifications]() { ++notifications; });
+
+    // The audio thread plays each sound once and hands it straight back
+    std::atomic<bool> stop{false};
+    std::atomic<int> played{0};
+    std::atomic<int> corrupt{0};
+    // The counter itself must see heap calls
+    t_count_heap = true;
+    int* volatile probe = new int(1);
+    delete probe;
+    t_count_heap = false;
+    REQUIRE(g_counted_heap_calls.load() == 2);
+
+    g_counted_heap_calls = 0;
+    std::thread audio([&]() {
+        t_count_heap = true;
+        FreesoundDownloader::ReadySound sound;
+        while (!stop.load())
+        {
+            while (bridge.pollReady(sound))
+            {
+                const char expected = static_cast<char>('a' + sound.sound_id);
+                if (sound.size != size_t(1000 * sound.sound_id) || sound.data[0] != expected
+                    || sound.data[sound.size - 1] != expected)
+                {
+                    ++corrupt;
+                }
+                ++played;
+                bridge.release(sound);
+            }
+        }
+        t_count_heap = false;
+    });
+
+    std::set<uint64_t> downloads;
+    for (int id = 1; id <= 6; ++id)
+    {
+        downloads.insert(bridge.requestDownload(id));
+    }
+    const uint64_t missing = bridge.requestDownload(99);
+    const uint64_t search = bridge.requestSearch("kick");
+
+    // Message thread: report completions until every sound has been played
+    int succeeded = 0;
+    bool missing_failed = false;
+    bool search_done = false;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((played.load() < 6 || !search_done || !missing_failed)
+        && std::chrono::steady_clock::now() < deadline)
+    {
+        bridge.dispatch([&](const FreesoundDownloader::BridgeCompletion& completion) {
+            if (completion.request == missing)
+            {
+                missing_failed = !completion.ok;
+            }
+            else if (completion.request == search)
+            {
+                search_done = completion.ok && completion.results.find("results") != std::string::npos;
+            }
+            else if (downloads.count(completion.request) && completion.ok)
+            {
+                ++succeeded;
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    audio.join();
+    bridge.dispatch(nullptr);
+
+    CHECK(succeeded == 6);
+    CHECK(played.load() == 6);
+    CHECK(corrupt.load() == 0);
+    CHECK(missing_failed);
+    CHECK(search_done);
+    CHECK(notifications.load() == 8);
+    CHECK(g_counted_heap_calls.load() == 0);
+}
+
+#endif
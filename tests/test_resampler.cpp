@@ -0,0 +1,156 @@
+#include <doctest/doctest.h>
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    std::vector<float> sine(size_t frames, unsigned channels, double frequency, double rate)
+    {
+        std::vector<float> samples(frames * channels);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            for (unsigned channel = 0; channel < channels; ++channel)
+            {
+                samples[i * channels + channel] = static_cast<float>(
+                    0.5 * std::sin(2.0 * PI * frequency * i / rate + channel));
+            }
+        }
+        return samples;
+    }
+}
+
+TEST_CASE("Resampler Output Does Not Depend On Block Sizes") {
+    CHECK_THROWS_AS(FreesoundDownloader::Resampler(0, 44100, 48000), std::invalid_argument);
+    CHECK_THROWS_AS(FreesoundDownloader::Resampler(2, 44100, 0), std::invalid_argument);
+
+    const auto input = sine(10000, 2, 440.0, 44100.0);
+
+    FreesoundDownloader::Resampler whole(2, 44100, 48000);
+    std::vector<float> expected;
+    whole.process(input.data(), 10000, expected);
+    whole.flush(expected);
+    CHECK(expected.size() == 2 * ((10000ull * 48000 + 44099) / 44100));
+    CHECK(whole.outputFrames() * 2 == expected.size());
+
+    FreesoundDownloader::Resampler pieces(2, 44100, 48000);
+    std::vector<float> actual;
+    for (size_t offset = 0, step = 1; offset < 10000; offset += step, step = step * 3 % 997 + 1)
+    {
+        const size_t frames = std::min<size_t>(step, 10000 - offset);
+        pieces.process(input.data() + offset * 2, frames, actual);
+    }
+    pieces.flush(actual);
+    CHECK(actual == expected);
+
+    // Matching rates pass the samples through untouched
+    FreesoundDownloader::Resampler same(2, 48000, 48000);
+    std::vector<float> copied;
+    same.process(input.data(), 10000, copied);
+    same.flush(copied);
+    CHECK(copied == input);
+}
+
+TEST_CASE("Resampler Preserves Tones And Rejects Aliases") {
+    // 1 kHz from 44.1 kHz to 48 kHz matches the ideal tone away from the edges
+    const auto input = sine(44100, 1, 1000.0, 44100.0);
+    FreesoundDownloader::Resampler up(1, 44100, 48000);
+    std::vector<float> output;
+    up.process(input.data(), input.size(), output);
+    up.flush(output);
+    REQUIRE(output.size() == 48000);
+    const auto ideal = sine(48000, 1, 1000.0, 48000.0);
+    double worst = 0.0;
+    for (size_t i = 1000; i < 47000; ++i)
+    {
+        worst = std::max(worst, std::abs(static_cast<double>(output[i]) - ideal[i]));
+    }
+    CHECK(worst < 1e-3);
+
+    // 30 kHz cannot exist at 48 kHz and must not fold back to 18 kHz
+    const auto ultrasonic = sine(96000, 1, 30000.0, 96000.0);
+    FreesoundDownloader::Resampler down(1, 96000, 48000);
+    std::vector<float> folded;
+    down.process(ultrasonic.data(), ultrasonic.size(), folded);
+    down.flush(folded);
+    REQUIRE(folded.size() == 48000);
+    double energy = 0.0;
+    for (size_t i = 1000; i < 47000; ++i)
+    {
+        energy += static_cast<double>(folded[i]) * folded[i];
+    }
+    CHECK(std::sqrt(energy / 46000) < 1e-3);
+}
+
+TEST_CASE("Resampler Quality Presets And Filter Banks") {
+    using FreesoundDownloader::ResamplerQuality;
+
+    // Every common pair of rates gets a precomputed bank
+    const uint32_t rates[] = {8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 192000};
+    bool banked = true;
+    for (uint32_t from : rates)
+    {
+        for (uint32_t to : rates)
+        {
+            if (from != to)
+            {
+                banked = banked && FreesoundDownloader::Resampler(2, from, to, ResamplerQuality::Best).polyphase();
+            }
+        }
+    }
+    CHECK(banked);
+
+    // A ratio with too many phases falls back to the interpolated kernel
+    FreesoundDownloader::Resampler odd(1, 44100, 47999);
+    CHECK_FALSE(odd.polyphase());
+
+    const auto input = sine(22050, 1, 1000.0, 22050.0);
+    for (ResamplerQuality quality : {ResamplerQuality::Fast, ResamplerQuality::Balanced, ResamplerQuality::Best})
+    {
+        // A constant stays constant on every phase
+        const std::vector<float> dc(4000, 0.25f);
+        FreesoundDownloader::Resampler flat(1, 44100, 48000, quality);
+        std::vector<float> level;
+        flat.process(dc.data(), dc.size(), level);
+        flat.flush(level);
+        double drift = 0.0;
+        for (size_t i = 200; i + 200 < level.size(); ++i)
+        {
+            drift = std::max(drift, std::abs(level[i] - 0.25));
+        }
+        CHECK(drift < 1e-4);
+
+        // Longer kernels track the ideal tone more closely
+        FreesoundDownloader::Resampler up(1, 22050, 44100, quality);
+        std::vector<float> output;
+        up.process(input.data(), input.size(), output);
+        up.flush(output);
+        REQUIRE(output.size() == 44100);
+        const auto ideal = sine(44100, 1, 1000.0, 44100.0);
+        double worst = 0.0;
+        for (size_t i = 1000; i < 43000; ++i)
+        {
+            worst = std::max(worst, std::abs(static_cast<double>(output[i]) - ideal[i]));
+        }
+        CHECK(worst < (quality == ResamplerQuality::Fast ? 1e-2 : 1e-3));
+    }
+
+    // The table fallback converts as accurately as a bank
+    const auto tone = sine(44100, 1, 1000.0, 44100.0);
+    std::vector<float> converted;
+    odd.process(tone.data(), tone.size(), converted);
+    odd.flush(converted);
+    REQUIRE(converted.size() == 47999);
+    const auto ideal = sine(47999, 1, 1000.0, 47999.0);
+    double worst = 0.0;
+    for (size_t i = 1000; i < 47000; ++i)
+    {
+        worst = std::max(worst, std::abs(static_cast<double>(converted[i]) - ideal[i]));
+    }
+    CHECK(worst < 1e-3);
+}
@@ -0,0 +1,149 @@
+#include <doctest/doctest.h>
+#include "sample_archive.h"
+#include "test_files.h"
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    std::string freshArchivePath(const std::string& name)
+    {
+        return (freshDir("archive_" + name) / "library.fspak").string();
+    }
+
+    bool appendString(FreesoundDownloader::SampleArchiveWriter& writer, int id, const std::string& bytes)
+    {
+        return writer.append(id, reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    }
+
+    std::string entryString(const FreesoundDownloader::ArchiveEntry& entry)
+    {
+        return std::string(reinterpret_cast<const char*>(entry.data.data()), entry.data.size());
+    }
+}
+
+TEST_CASE("Sample Archive Append And Zero-Copy Lookup") {
+    using FreesoundDownloader::AudioFormat;
+
+    const std::string path = freshArchivePath("lookup");
+    const std::string wav("RIFF\x10\0\0\0WAVEfmt payload", 23);
+    const std::string ogg("OggS vorbis payload");
+
+    {
+        FreesoundDownloader::SampleArchiveWriter writer;
+        REQUIRE(writer.open(path));
+        REQUIRE(appendString(writer, 500, wav));
+        REQUIRE(appendString(writer, 20, ogg));
+        REQUIRE(writer.finish());
+    }
+
+    // Reopening appends after the existing entries and supersedes duplicates
+    {
+        FreesoundDownloader::SampleArchiveWriter writer;
+        REQUIRE(writer.open(path));
+        CHECK(writer.contains(500));
+        REQUIRE(appendString(writer, 7, "fLaC frames"));
+        REQUIRE(appendString(writer, 20, "OggS replacement"));
+        CHECK(writer.entryCount() == 3);
+    }
+
+    FreesoundDownloader::SampleArchiveReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(reader.size() == 3);
+    CHECK(reader.entry(0).sound_id == 7);
+
+    auto sound = reader.find(500);
+    REQUIRE(sound.has_value());
+    CHECK(sound->format == AudioFormat::Wav);
+    CHECK(entryString(*sound) == wav);
+    CHECK(reinterpret_cast<uintptr_t>(sound->data.data()) % 4096 == 0);
+
+    CHECK(entryString(*reader.find(20)) == "OggS replacement");
+    CHECK(reader.find(7)->format == AudioFormat::Flac);
+    CHECK_FALSE(reader.find(8).has_value());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Sample Archive Recovers From Interrupted Writer") {
+    const std::string path = freshArchivePath("recover");
+
+    {
+        FreesoundDownloader::SampleArchiveWriter writer(64);
+        REQUIRE(writer.open(path));
+        REQUIRE(appendString(writer, 1, "first sound"));
+        REQUIRE(appendString(writer, 2, "second sound"));
+        REQUIRE(writer.finish());
+    }
+
+    // Cut off the index and part of the second entry, as a crash mid-write would
+    const auto size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 32 - 2 * 32 - 8);
+
+    FreesoundDownloader::SampleArchiveReader unfinished;
+    CHECK_FALSE(unfinished.open(path));
+
+    {
+        FreesoundDownloader::SampleArchiveWriter writer;
+        REQUIRE(writer.open(path));
+        CHECK(writer.contains(1));
+        CHECK_FALSE(writer.contains(2));
+        REQUIRE(appendString(writer, 3, "third sound"));
+    }
+
+    FreesoundDownloader::SampleArchiveReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(reader.size() == 2);
+    CHECK(entryString(*reader.find(1)) == "first sound");
+    CHECK(entryString(*reader.find(3)) == "third sound");
+
+    CHECK_THROWS_AS(FreesoundDownloader::SampleArchiveWriter(100), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Sample Archive Streams Entries In Parts") {
+    using FreesoundDownloader::AudioFormat;
+    using FreesoundDownloader::SampleArchiveWriter;
+
+    const std::string path = freshArchivePath("stream");
+    std::string wav("RIFF\x24\0\0\0WAVEfmt ", 16);
+    wav += std::string(10000, 'w');
+    const std::string discarded(20000, 'd');
+
+    {
+        SampleArchiveWriter writer;
+        REQUIRE(writer.open(path));
+        {
+            SampleArchiveWriter::EntryWriter entry(writer, 1);
+            for (size_t offset = 0; offset < wav.size(); offset += 7)
+            {
+                const size_t part = std::min<size_t>(7, wav.size() - offset);
+                REQUIRE(entry.append(reinterpret_cast<const uint8_t*>(wav.data()) + offset, part));
+            }
+            REQUIRE(entry.commit());
+        }
+
+        // An entry given up on is overwritten by the next one and cut off by finish()
+        {
+            SampleArchiveWriter::EntryWriter entry(writer, 2);
+            REQUIRE(entry.append(reinterpret_cast<const uint8_t*>(discarded.data()), discarded.size()));
+        }
+        CHECK_FALSE(writer.contains(2));
+        REQUIRE(appendString(writer, 3, "OggS"));
+        REQUIRE(writer.finish());
+    }
+
+    FreesoundDownloader::SampleArchiveReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(reader.size() == 2);
+    CHECK_FALSE(reader.find(2).has_value());
+
+    auto sound = reader.find(1);
+    REQUIRE(sound.has_value());
+    CHECK(sound->format == AudioFormat::Wav);
+    CHECK(entryString(*sound) == wav);
+    CHECK(entryString(*reader.find(3)) == "OggS");
+}
@@ -0,0 +1,223 @@
+#include <doctest/doctest.h>
+#include "similarity_index.h"
+#include "test_files.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    constexpr size_t DIMENSIONS = 30;
+
+    /// Points scattered around a few dozen centres, like embeddings of sounds of a few kinds
+    std::vector<float> makeClusteredVectors(size_t count, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::normal_distribution<float> spread(0.0f, 1.0f);
+        std::uniform_real_distribution<float> place(-10.0f, 10.0f);
+
+        std::vector<float> centres(40 * DIMENSIONS);
+        for (float& value : centres)
+        {
+            value = place(generator);
+        }
+        std::vector<float> vectors(count * DIMENSIONS);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t centre = generator() % 40;
+            for (size_t d = 0; d < DIMENSIONS; ++d)
+            {
+                vectors[i * DIMENSIONS + d] = centres[centre * DIMENSIONS + d] + spread(generator);
+            }
+        }
+        return vectors;
+    }
+
+    /// Sound IDs of the exact nearest neighbours, closest first
+    std::vector<int> bruteForce(const std::vector<float>& vectors, const float* query, size_t count)
+    {
+        std::vector<std::pair<float, int>> distances;
+        for (size_t i = 0; i < vectors.size() / DIMENSIONS; ++i)
+        {
+            float sum = 0.0f;
+            for (size_t d = 0; d < DIMENSIONS; ++d)
+            {
+                const float difference = vectors[i * DIMENSIONS + d] - query[d];
+                sum += difference * difference;
+            }
+            distances.emplace_back(sum, static_cast<int>(1000 + i));
+        }
+        std::partial_sort(distances.begin(), distances.begin() + count, distances.end());
+        std::vector<int> ids;
+        for (size_t i = 0; i < count; ++i)
+        {
+            ids.push_back(distances[i].second);
+        }
+        return ids;
+    }
+
+    /// Fraction of the exact top-10 of each query that the index returns
+    double recallAt10(const FreesoundDownloader::SimilarityIndex& index, const std::vector<float>& vectors,
+                      const std::vector<float>& queries)
+    {
+        size_t found = 0;
+        size_t total = 0;
+        for (size_t q = 0; q < queries.size() / DIMENSIONS; ++q)
+        {
+            const auto exact = bruteForce(vectors, queries.data() + q * DIMENSIONS, 10);
+            for (const auto& result : index.query(queries.data() + q * DIMENSIONS, 10))
+            {
+                found += std::count(exact.begin(), exact.end(), result.sound_id);
+            }
+            total += exact.size();
+        }
+        return static_cast<double>(found) / total;
+    }
+}
+
+TEST_CASE("Similarity Index Finds Nearest Neighbours") {
+    using FreesoundDownloader::SimilarityIndex;
+    using FreesoundDownloader::SimilarityIndexOptions;
+
+    SimilarityIndexOptions bad;
+    bad.max_links = 1;
+    CHECK_THROWS_AS(SimilarityIndex{bad}, std::invalid_argument);
+    bad = {};
+    bad.dimensions = 0;
+    CHECK_THROWS_AS(SimilarityIndex{bad}, std::invalid_argument);
+
+    SimilarityIndex index;
+    CHECK(index.dimensions() == DIMENSIONS);
+    const std::vector<float> origin(DIMENSIONS, 0.0f);
+    CHECK(index.query(origin.data(), 5).empty());
+
+    const auto vectors = makeClusteredVectors(4000, 1);
+    for (size_t i = 0; i < 4000; ++i)
+    {
+        REQUIRE(index.insert(static_cast<int>(1000 + i), vectors.data() + i * DIMENSIONS));
+    }
+    CHECK(index.size() == 4000);
+    CHECK_FALSE(index.insert(1000, origin.data()));
+    CHECK(index.size() == 4000);
+    CHECK(index.contains(4999));
+    CHECK_FALSE(index.contains(5000));
+
+    const auto queries = makeClusteredVectors(200, 2);
+    CHECK(recallAt10(index, vectors, queries) > 0.95);
+
+    // An indexed vector finds itself; "more like this" leaves it out
+    const auto self = index.query(vectors.data() + 123 * DIMENSIONS, 3);
+    REQUIRE(self.size() == 3);
+    CHECK(self[0].sound_id == 1123);
+    CHECK(self[0].distance == 0.0f);
+    CHECK(self[1].distance <= self[2].distance);
+
+    const auto similar = index.similarTo(1123, 10);
+    REQUIRE(similar.size() == 10);
+    CHECK(std::none_of(similar.begin(), similar.end(), [](const auto& s) { return s.sound_id == 1123; }));
+    const auto exact = bruteForce(vectors, vectors.data() + 123 * DIMENSIONS, 4);
+    CHECK(similar[0].sound_id == exact[1]);
+    CHECK(index.similarTo(77, 10).empty());
+
+    // Wider searches are at least as good
+    CHECK(index.query(queries.data(), 10, 400).size() == 10);
+    CHECK(index.query(queries.data(), 5000).size() == 4000);
+}
+
+TEST_CASE("Similarity Index Is Queried From A Mapped File And Keeps Growing") {
+    using FreesoundDownloader::SimilarityIndex;
+
+    const auto dir = freshDir("similarity");
+    const std::string path = (dir / "sounds.ann").string();
+
+    const auto vectors = makeClusteredVectors(3000, 3);
+    SimilarityIndex built;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        REQUIRE(built.insert(static_cast<int>(1000 + i), vectors.data() + i * DIMENSIONS));
+    }
+    REQUIRE(built.save(path));
+
+    FreesoundDownloader::SimilarityIndexOptions other;
+    other.dimensions = 4;
+    SimilarityIndex mapped(other);
+    REQUIRE(mapped.open(path));
+    CHECK(mapped.dimensions() == DIMENSIONS);
+    CHECK(mapped.size() == 2000);
+    CHECK(mapped.contains(2999));
+    CHECK_FALSE(mapped.contains(3000));
+
+    // The mapped graph answers exactly like the one it was saved from
+    const auto queries = makeClusteredVectors(50, 4);
+    bool identical = true;
+    for (size_t q = 0; q < 50; ++q)
+    {
+        const auto expected = built.query(queries.data() + q * DIMENSIONS, 10);
+        const auto actual = mapped.query(queries.data() + q * DIMENSIONS, 10);
+        identical = identical && expected.size() == actual.size()
+            && std::equal(expected.begin(), expected.end(), actual.begin(), [](const auto& a, const auto& b) {
+                   return a.sound_id == b.sound_id && a.distance == b.distance;
+               });
+    }
+    CHECK(identical);
+    CHECK(mapped.similarTo(1500, 5).size() == 5);
+
+    // Queries keep running while sounds are added
+    std::atomic<bool> done{false};
+    std::atomic<size_t> answered{0};
+    std::thread reader([&]() {
+        while (!done)
+        {
+            answered += mapped.query(queries.data(), 10).size() == 10 ? 1 : 0;
+        }
+    });
+    for (size_t i = 2000; i < 3000; ++i)
+    {
+        REQUIRE(mapped.insert(static_cast<int>(1000 + i), vectors.data() + i * DIMENSIONS));
+    }
+    done = true;
+    reader.join();
+    CHECK(answered > 0);
+    CHECK(mapped.size() == 3000);
+    CHECK(recallAt10(mapped, vectors, queries) > 0.95);
+
+    // The grown index can replace the file it was opened from
+    REQUIRE(mapped.save(path));
+    SimilarityIndex reopened;
+    REQUIRE(reopened.open(path));
+    CHECK(reopened.size() == 3000);
+    CHECK(reopened.query(vectors.data() + 2500 * DIMENSIONS, 1)[0].sound_id == 3500);
+
+    // Damaged files are rejected and leave the index as it was
+    const std::string damaged = (dir / "damaged.ann").string();
+    const auto full = std::filesystem::file_size(path);
+    std::filesystem::copy_file(path, damaged);
+    std::filesystem::resize_file(damaged, full - 4);
+    CHECK_FALSE(reopened.open(damaged));
+    std::filesystem::resize_file(damaged, full);
+    CHECK_FALSE(reopened.open(damaged));
+    std::filesystem::remove(damaged);
+    std::filesystem::copy_file(path, damaged);
+    {
+        // Point the first bottom-layer link of node 0 past the end
+        std::fstream file(damaged, std::ios::binary | std::ios::in | std::ios::out);
+        const uint32_t bogus = 999999;
+        file.seekp(64 + 3000 * DIMENSIONS * 4 + 3 * 3000 * 4 + 4);
+        file.write(reinterpret_cast<const char*>(&bogus), 4);
+    }
+    CHECK_FALSE(reopened.open(damaged));
+    CHECK_FALSE(reopened.open((dir / "missing.ann").string()));
+    CHECK(reopened.size() == 3000);
+    CHECK(reopened.contains(3500));
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,320 @@
+#include <doctest/doctest.h>
+#include "sound_store.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    bool putString(FreesoundDownloader::SoundStore& store, int id, const std::string& contents)
+    {
+        return store.put(id, reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+    }
+
+    /// A 16-bit stereo WAV of two tones
+    std::vector<uint8_t> toneWav(size_t frames)
+    {
+        std::vector<int32_t> samples;
+        samples.reserve(frames * 2);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            const double t = static_cast<double>(i) / 44100.0;
+            samples.push_back(static_cast<int32_t>(std::lround(9000.0 * std::sin(2764.6 * t))));
+            samples.push_back(static_cast<int32_t>(std::lround(7000.0 * std::sin(1382.3 * t + 0.5))));
+        }
+        return pcmWav(samples, 2, 16, 44100);
+    }
+}
+
+TEST_CASE("Audio Format Sniffing") {
+    using FreesoundDownloader::AudioFormat;
+    using FreesoundDownloader::sniffAudioFormat;
+
+    auto sniff = [](const std::string& bytes) {
+        return sniffAudioFormat(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    };
+
+    CHECK(sniff(std::string("RIFF\x24\0\0\0WAVEfmt ", 16)) == AudioFormat::Wav);
+    CHECK(sniff(std::string("FORM\0\0\0\0AIFFCOMM", 16)) == AudioFormat::Aiff);
+    CHECK(sniff("fLaC\0\0\0\x22") == AudioFormat::Flac);
+    CHECK(sniff("OggS") == AudioFormat::Ogg);
+    CHECK(sniff("ID3\x04") == AudioFormat::Mp3);
+    CHECK(sniff("\xFF\xFB\x90\x64") == AudioFormat::Mp3);
+    CHECK(sniff("hello") == AudioFormat::Unknown);
+}
+
+TEST_CASE("Sound Store Sharded Layout And Index") {
+    using FreesoundDownloader::AudioFormat;
+
+    auto root = freshDir("store_layout");
+    const std::string wav("RIFF\x04\0\0\0WAVEdata", 16);
+    const std::string flac("fLaC-streaminfo");
+
+    {
+        FreesoundDownloader::SoundStore store;
+        REQUIRE(store.open(root.string()));
+        REQUIRE(putString(store, 1234, wav));
+        REQUIRE(putString(store, 1235, flac));
+        REQUIRE(putString(store, 99, "unknown bytes"));
+        CHECK(store.remove(99));
+        CHECK_FALSE(store.remove(99));
+
+        // Consecutive IDs are spread across shards
+        const auto first = std::filesystem::path(store.pathFor(1234, AudioFormat::Wav));
+        const auto second = std::filesystem::path(store.pathFor(1235, AudioFormat::Flac));
+        CHECK(first.parent_path() != second.parent_path());
+        CHECK(first.filename() == "1234.wav");
+        CHECK(std::filesystem::relative(first, root).begin()->string().size() == 2);
+        CHECK(std::filesystem::file_size(first) == wav.size());
+    }
+
+    // Simulate a torn append after the last complete record
+    {
+        std::ofstream index(root / FreesoundDownloader::SoundStore::INDEX_FILE,
+            std::ios::binary | std::ios::app);
+        index.write("torn", 4);
+    }
+
+    FreesoundDownloader::SoundStore reopened;
+    REQUIRE(reopened.open(root.string()));
+    CHECK(reopened.size() == 2);
+
+    auto entry = reopened.find(1235);
+    REQUIRE(entry.has_value());
+    CHECK(entry->format == AudioFormat::Flac);
+    CHECK(entry->size == flac.size());
+    CHECK(entry->content_hash == FreesoundDownloader::SoundStore::contentHash(
+        reinterpret_cast<const uint8_t*>(flac.data()), flac.size()));
+    CHECK_FALSE(reopened.find(99).has_value());
+
+    // Compaction moves exactly one record per live sound into the snapshot
+    REQUIRE(reopened.compact());
+    CHECK(std::filesystem::file_size(root / FreesoundDownloader::SoundStore::INDEX_FILE) == 0);
+    CHECK(std::filesystem::file_size(root / FreesoundDownloader::SoundStore::SNAPSHOT_FILE) == 64 + 2 * 32);
+    REQUIRE(putString(reopened, 1234, flac));
+    CHECK(reopened.find(1234)->format == AudioFormat::Flac);
+    CHECK_FALSE(std::filesystem::exists(reopened.pathFor(1234, AudioFormat::Wav)));
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Sound Store Writer Streams Parts") {
+    using FreesoundDownloader::AudioFormat;
+    using FreesoundDownloader::SoundStore;
+
+    auto root = freshDir("store_writer");
+    std::string wav("RIFF\x24\0\0\0WAVEfmt ", 16);
+    wav += std::string(1000, 'x');
+
+    SoundStore store;
+    REQUIRE(store.open(root.string()));
+    {
+        SoundStore::Writer writer(store, 7);
+        for (size_t offset = 0; offset < wav.size(); offset += 5)
+        {
+            const size_t part = std::min<size_t>(5, wav.size() - offset);
+            REQUIRE(writer.append(reinterpret_cast<const uint8_t*>(wav.data()) + offset, part));
+        }
+        REQUIRE(writer.commit());
+    }
+
+    auto entry = store.find(7);
+    REQUIRE(entry.has_value());
+    CHECK(entry->format == AudioFormat::Wav);
+    CHECK(entry->size == wav.size());
+    CHECK(entry->content_hash == SoundStore::contentHash(
+        reinterpret_cast<const uint8_t*>(wav.data()), wav.size()));
+    CHECK(std::filesystem::file_size(store.pathFor(7, AudioFormat::Wav)) == wav.size());
+
+    // A writer given up on leaves neither a file nor an entry behind
+    {
+        SoundStore::Writer writer(store, 8);
+        REQUIRE(writer.append(reinterpret_cast<const uint8_t*>(wav.data()), wav.size()));
+    }
+    CHECK_FALSE(store.find(8).has_value());
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(8, AudioFormat::Wav)));
+}
+
+TEST_CASE("Sound Store Snapshot Warm Start") {
+    using FreesoundDownloader::AudioFormat;
+    using FreesoundDownloader::SoundStore;
+
+    auto root = freshDir("store_snapshot");
+    const std::string wav("RIFF\x04\0\0\0WAVEdata", 16);
+
+    {
+        SoundStore store;
+        REQUIRE(store.open(root.string()));
+        for (int id = 100; id > 0; --id)
+        {
+            REQUIRE(putString(store, id * 7, id % 2 ? wav : "odd " + std::to_string(id)));
+        }
+        REQUIRE(store.compact());
+        CHECK(store.size() == 100);
+
+        // Changes after the snapshot go to the delta log only
+        CHECK(store.remove(7));
+        CHECK(store.remove(700));
+        CHECK_FALSE(store.remove(700));
+        REQUIRE(putString(store, 14, wav));
+        REQUIRE(putString(store, 3, wav));
+        CHECK(store.size() == 99);
+    }
+
+    CHECK(std::filesystem::file_size(root / SoundStore::INDEX_FILE) == 4 * 32);
+
+    SoundStore reopened;
+    REQUIRE(reopened.open(root.string()));
+    CHECK(reopened.size() == 99);
+    CHECK_FALSE(reopened.find(7).has_value());
+    CHECK_FALSE(reopened.find(700).has_value());
+    REQUIRE(reopened.find(14).has_value());
+    CHECK(reopened.find(14)->format == AudioFormat::Wav);
+    REQUIRE(reopened.find(3).has_value());
+    REQUIRE(reopened.find(21).has_value());
+    CHECK(reopened.find(21)->format == AudioFormat::Wav);
+    CHECK(reopened.find(686)->size == std::string("odd 98").size());
+
+    // Folding the overlay in yields the same contents from the snapshot alone
+    REQUIRE(reopened.compact());
+    CHECK(reopened.size() == 99);
+    CHECK(std::filesystem::file_size(root / SoundStore::SNAPSHOT_FILE) == 64 + 99 * 32);
+    CHECK_FALSE(reopened.find(7).has_value());
+    CHECK(reopened.find(3).has_value());
+    CHECK(reopened.find(14)->format == AudioFormat::Wav);
+
+    {
+        SoundStore again;
+        REQUIRE(again.open(root.string()));
+        CHECK(again.size() == 99);
+        CHECK(again.find(686).has_value());
+    }
+
+    // A snapshot whose records no longer match the checksum is refused
+    {
+        std::fstream snapshot(root / SoundStore::SNAPSHOT_FILE, std::ios::binary | std::ios::in | std::ios::out);
+        snapshot.seekp(64 + 5 * 32 + 8);
+        snapshot.put('\x55');
+    }
+    SoundStore corrupted;
+    CHECK_FALSE(corrupted.open(root.string()));
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Sound Store Survives A Failed Compaction") {
+    using FreesoundDownloader::SoundStore;
+
+    auto root = freshDir("store_failed_compact");
+    SoundStore store;
+    REQUIRE(store.open(root.string()));
+    for (int id = 1; id <= 5; ++id)
+    {
+        REQUIRE(putString(store, id, "sound " + std::to_string(id)));
+    }
+
+    // A non-empty directory in place of the snapshot makes the rename fail
+    std::filesystem::create_directories(root / SoundStore::SNAPSHOT_FILE / "blocker");
+    CHECK_FALSE(store.compact());
+    CHECK(store.size() == 5);
+    CHECK(store.find(3).has_value());
+
+    std::filesystem::remove_all(root / SoundStore::SNAPSHOT_FILE);
+    REQUIRE(store.compact());
+    CHECK(store.size() == 5);
+    CHECK(store.find(3).has_value());
+
+    SoundStore reopened;
+    REQUIRE(reopened.open(root.string()));
+    CHECK(reopened.size() == 5);
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Sound Store Lossless Compression") {
+    using FreesoundDownloader::AudioFormat;
+    using FreesoundDownloader::SoundStore;
+
+    auto root = freshDir("store_lossless");
+    const auto wav = toneWav(30000);
+    const std::string flac("fLaC-streaminfo");
+
+    SoundStore store;
+    REQUIRE(store.open(root.string()));
+    REQUIRE(store.put(1, wav.data(), wav.size()));
+    CHECK_FALSE(store.find(1)->compressed);
+    CHECK(store.read(1) == wav);
+
+    FreesoundDownloader::LosslessOptions bad;
+    bad.max_order = 0;
+    CHECK_THROWS_AS(store.setLosslessCompression(true, bad), std::invalid_argument);
+    store.setLosslessCompression(true);
+    REQUIRE(store.put(2, wav.data(), wav.size()));
+    REQUIRE(putString(store, 3, flac));
+
+    // PCM is kept compressed under its own name; the index still describes the original
+    auto entry = store.find(2);
+    REQUIRE(entry.has_value());
+    CHECK(entry->compressed);
+    CHECK(entry->size == wav.size());
+    CHECK(store.storedPathFor(*entry) == store.pathFor(2, AudioFormat::Wav) + SoundStore::COMPRESSED_SUFFIX);
+    CHECK(std::filesystem::file_size(store.storedPathFor(*entry)) < wav.size() / 2);
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(2, AudioFormat::Wav)));
+    CHECK(store.read(2) == wav);
+    CHECK_FALSE(store.find(3)->compressed);
+    CHECK(store.read(3) == std::vector<uint8_t>(flac.begin(), flac.end()));
+
+    // A sound put again follows the current setting, and its other file goes
+    REQUIRE(store.put(1, wav.data(), wav.size()));
+    CHECK(store.find(1)->compressed);
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(1, AudioFormat::Wav)));
+    store.setLosslessCompression(false);
+    REQUIRE(store.put(1, wav.data(), wav.size()));
+    CHECK_FALSE(store.find(1)->compressed);
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(1, AudioFormat::Wav) + SoundStore::COMPRESSED_SUFFIX));
+    CHECK(store.read(1) == wav);
+
+    // A streamed download is compressed from its temporary copy on commit
+    store.setLosslessCompression(true);
+    {
+        SoundStore::Writer writer(store, 4);
+        for (size_t offset = 0; offset < wav.size(); offset += 4096)
+        {
+            REQUIRE(writer.append(wav.data() + offset, std::min<size_t>(4096, wav.size() - offset)));
+        }
+        REQUIRE(writer.commit());
+    }
+    entry = store.find(4);
+    REQUIRE(entry.has_value());
+    CHECK(entry->compressed);
+    CHECK(entry->size == wav.size());
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(4, AudioFormat::Wav)));
+    CHECK(store.read(4) == wav);
+    store.setLosslessCompression(false);
+
+    // The flag survives compaction and reopening; damage is caught by the content hash
+    REQUIRE(store.compact());
+    SoundStore reopened;
+    REQUIRE(reopened.open(root.string()));
+    CHECK(reopened.find(2)->compressed);
+    CHECK(reopened.read(2) == wav);
+    {
+        std::fstream file(reopened.storedPathFor(*reopened.find(2)), std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(400);
+        file.put('\x55');
+    }
+    CHECK_FALSE(reopened.read(2).has_value());
+    CHECK(reopened.remove(2));
+    CHECK_FALSE(std::filesystem::exists(store.pathFor(2, AudioFormat::Wav) + SoundStore::COMPRESSED_SUFFIX));
+    CHECK_FALSE(reopened.read(2).has_value());
+    CHECK_FALSE(reopened.read(404).has_value());
+
+    std::filesystem::remove_all(root);
+}
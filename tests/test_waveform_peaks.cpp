@@ -0,0 +1,149 @@
+#include <doctest/doctest.h>
+#include "waveform_peaks.h"
+#include "float_wav_writer.h"
+#include "test_files.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    std::vector<float> makeSignal(size_t frames, unsigned channels)
+    {
+        std::vector<float> samples(frames * channels);
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            samples[i] = static_cast<float>(0.9 * std::sin(0.013 * static_cast<double>(i))
+                                            * std::cos(0.0007 * static_cast<double>(i)));
+        }
+        return samples;
+    }
+}
+
+TEST_CASE("Waveform Peaks Match A Direct Scan At Every Level") {
+    using FreesoundDownloader::PeakBuilder;
+    using FreesoundDownloader::PeakOptions;
+
+    CHECK_THROWS_AS(PeakBuilder(0, 48000), std::invalid_argument);
+    PeakOptions bad;
+    bad.level_factor = 1;
+    CHECK_THROWS_AS(PeakBuilder(2, 48000, bad), std::invalid_argument);
+
+    constexpr unsigned CHANNELS = 2;
+    constexpr size_t FRAMES = 100003;
+    auto samples = makeSignal(FRAMES, CHANNELS);
+    samples[2 * 70000 + 1] = 1.5f;
+    samples[2 * 70001] = -1.0f;
+
+    PeakOptions options;
+    options.frames_per_peak = 100;
+    options.level_factor = 3;
+    options.levels = 5;
+
+    // Blocks that straddle window boundaries give the same result as one push
+    PeakBuilder builder(CHANNELS, 44100, options);
+    for (size_t offset = 0; offset < FRAMES; offset += 777)
+    {
+        builder.push(samples.data() + offset * CHANNELS, std::min<size_t>(777, FRAMES - offset));
+    }
+    const auto peaks = builder.finish();
+
+    CHECK(peaks.frames == FRAMES);
+    CHECK(peaks.channels == CHANNELS);
+    CHECK(peaks.sample_rate == 44100);
+    REQUIRE(peaks.levels.size() == 5);
+
+    uint32_t frames_per_peak = 100;
+    for (const auto& level : peaks.levels)
+    {
+        CHECK(level.frames_per_peak == frames_per_peak);
+        REQUIRE(level.size() == (FRAMES + frames_per_peak - 1) / frames_per_peak);
+        bool exact = true;
+        for (size_t p = 0; p < level.size(); ++p)
+        {
+            const auto begin = samples.begin() + p * frames_per_peak * CHANNELS;
+            const auto end = samples.begin() + std::min<size_t>(FRAMES, (p + 1) * frames_per_peak) * CHANNELS;
+            const float low = *std::min_element(begin, end);
+            const float high = *std::max_element(begin, end);
+            const int expected_min = static_cast<int>(std::max(-127.0f, std::floor(low * 127.0f)));
+            const int expected_max = static_cast<int>(std::min(127.0f, std::ceil(high * 127.0f)));
+            exact = exact && level.min[p] == expected_min && level.max[p] == expected_max;
+        }
+        CHECK(exact);
+        frames_per_peak *= 3;
+    }
+
+    const size_t clipped = 70000 / 100;
+    CHECK(peaks.levels[0].max[clipped] == 127);
+    CHECK(peaks.levels[0].min[clipped] == -127);
+
+    // The coarsest level with a peak per pixel serves a thumbnail
+    CHECK(peaks.levelFor(200) == &peaks.levels[1]);
+    CHECK(peaks.levelFor(1) == &peaks.levels[4]);
+    CHECK(peaks.levelFor(1000000) == &peaks.levels[0]);
+    CHECK(FreesoundDownloader::WaveformPeaks().levelFor(10) == nullptr);
+}
+
+TEST_CASE("Waveform Peak Files Are Generated In Parallel") {
+    const auto dir = freshDir("peaks");
+
+    std::vector<std::string> paths;
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        const unsigned channels = 1 + i % 2;
+        const auto samples = makeSignal(20000 + 1000 * i, channels);
+        FreesoundDownloader::FloatWavWriter writer;
+        paths.push_back((dir / (std::to_string(i) + ".wav")).string());
+        REQUIRE(writer.open(paths.back(), 48000, static_cast<uint16_t>(channels)));
+        REQUIRE(writer.write(samples.data(), samples.size()));
+        REQUIRE(writer.commit(false));
+    }
+    {
+        std::ofstream junk(dir / "junk.wav", std::ios::binary);
+        junk << "not audio";
+    }
+    paths.push_back((dir / "junk.wav").string());
+    paths.push_back((dir / "missing.wav").string());
+
+    CHECK(FreesoundDownloader::peakPathFor("/library/1234.wav") == "/library/1234.peaks");
+
+    const auto failed = FreesoundDownloader::generatePeakFiles(paths, {}, 3);
+    const std::vector<std::string> expected_failures = {paths[6], paths[7]};
+    CHECK(failed == expected_failures);
+
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        const auto peaks = FreesoundDownloader::WaveformPeaks::load(FreesoundDownloader::peakPathFor(paths[i]));
+        REQUIRE(peaks.has_value());
+        CHECK(peaks->frames == 20000 + 1000 * i);
+        CHECK(peaks->channels == 1 + i % 2);
+
+        // Reading back gives exactly what a builder fed the same samples produces
+        FreesoundDownloader::PeakBuilder builder(static_cast<uint16_t>(1 + i % 2), 48000);
+        const auto samples = makeSignal(20000 + 1000 * i, 1 + i % 2);
+        builder.push(samples.data(), 20000 + 1000 * i);
+        const auto direct = builder.finish();
+        REQUIRE(peaks->levels.size() == direct.levels.size());
+        for (size_t l = 0; l < direct.levels.size(); ++l)
+        {
+            CHECK(peaks->levels[l].frames_per_peak == direct.levels[l].frames_per_peak);
+            CHECK(peaks->levels[l].min == direct.levels[l].min);
+            CHECK(peaks->levels[l].max == direct.levels[l].max);
+        }
+    }
+    CHECK_FALSE(std::filesystem::exists(dir / "junk.peaks"));
+
+    // Truncated files are rejected
+    const auto full = std::filesystem::file_size(FreesoundDownloader::peakPathFor(paths[0]));
+    std::filesystem::resize_file(FreesoundDownloader::peakPathFor(paths[0]), full - 1);
+    CHECK_FALSE(FreesoundDownloader::WaveformPeaks::load(FreesoundDownloader::peakPathFor(paths[0])).has_value());
+    CHECK_FALSE(FreesoundDownloader::WaveformPeaks::load((dir / "none.peaks").string()).has_value());
+
+    std::filesystem::remove_all(dir);
+}
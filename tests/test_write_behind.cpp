@@ -0,0 +1,143 @@
+#include <doctest/doctest.h>
+#include "bounded_queue.h"
+#include "write_behind.h"
+#include "atomic_file.h"
+#include "md5.h"
+#include "test_files.h"
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+}
+
+TEST_CASE("Bounded Queue Delivers Every Element Once") {
+    FreesoundDownloader::BoundedQueue<int> queue(6);
+    CHECK(queue.capacity() == 8);
+    CHECK_THROWS_AS(FreesoundDownloader::BoundedQueue<int>(0), std::invalid_argument);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        REQUIRE(queue.tryPush(int(i)));
+    }
+    CHECK_FALSE(queue.tryPush(99));
+
+    int value = -1;
+    REQUIRE(queue.tryPop(value));
+    CHECK(value == 0);
+    while (queue.tryPop(value))
+    {
+    }
+    CHECK(value == 7);
+
+    // Four producers and four consumers share the ring
+    constexpr int PER_PRODUCER = 20000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 4; ++p)
+    {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 1; i <= PER_PRODUCER; ++i)
+            {
+                int item = p * PER_PRODUCER + i;
+                while (!queue.tryPush(std::move(item)))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&]() {
+            int item = 0;
+            while (popped.load() < 4 * PER_PRODUCER)
+            {
+                if (queue.tryPop(item))
+                {
+                    sum += item;
+                    ++popped;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    const long long n = 4LL * PER_PRODUCER;
+    CHECK(popped.load() == n);
+    CHECK(sum.load() == n * (n + 1) / 2);
+}
+
+TEST_CASE("Write Behind Streams And Hashes Files Under Backpressure") {
+    auto dir = freshDir("write_behind_streams");
+
+    FreesoundDownloader::WriteBehindOptions options;
+    options.io_threads = 2;
+    options.buffer_size = 1024;
+    options.buffer_count = 2;
+    CHECK_THROWS_AS(FreesoundDownloader::WriteBehindWriter(
+        FreesoundDownloader::WriteBehindOptions{0, 1024, 2}), std::invalid_argument);
+
+    std::vector<std::string> expected(6);
+    std::vector<int> results(expected.size(), 0);
+    std::vector<std::string> digests(expected.size());
+    {
+        FreesoundDownloader::WriteBehindWriter writer(options);
+        std::vector<std::thread> network;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            for (size_t b = 0; b < 5000 * i + 17; ++b)
+            {
+                expected[i].push_back(static_cast<char>('a' + (b * 7 + i) % 26));
+            }
+
+            network.emplace_back([&, i]() {
+                FreesoundDownloader::AtomicFile file;
+                if (!file.open((dir / (std::to_string(i) + ".wav")).string()))
+                {
+                    return;
+                }
+
+                // Odd-numbered streams are hashed on the way through
+                FreesoundDownloader::WriteBehindWriter::Stream stream(writer, file, i % 2 == 1);
+                bool ok = true;
+                for (size_t offset = 0; offset < expected[i].size(); offset += 700)
+                {
+                    const size_t chunk = std::min<size_t>(700, expected[i].size() - offset);
+                    ok = ok && stream.append(expected[i].data() + offset, chunk);
+                }
+                ok = stream.finish() && ok && stream.size() == expected[i].size();
+                if (stream.md5())
+                {
+                    digests[i] = FreesoundDownloader::Md5::toHex(*stream.md5());
+                }
+                results[i] = ok && file.commit(false) ? 1 : 0;
+            });
+        }
+        for (auto& thread : network)
+        {
+            thread.join();
+        }
+
+        // Six streams over two buffers cannot all proceed without waiting
+        CHECK(writer.stalls() > 0);
+    }
+
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        CHECK(results[i] == 1);
+        CHECK(readFile(dir / (std::to_string(i) + ".wav")) == expected[i]);
+        CHECK(digests[i] == (i % 2 == 1 ? FreesoundDownloader::Md5::toHex(
+            FreesoundDownloader::Md5::hash(expected[i].data(), expected[i].size())) : ""));
+    }
+
+    std::filesystem::remove_all(dir);
+}
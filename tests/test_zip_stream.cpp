@@ -0,0 +1,426 @@
+#include <doctest/doctest.h>
+#include "zip_stream.h"
+#include "freesound_downloader.h"
+#include "local_http_server.h"
+#include "test_files.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace FreesoundDownloader::Testing;
+
+    // Raw deflate streams made with zlib (wbits -15) from the payload() below:
+    // level 9 over all 3000 bytes (one dynamic block), and Z_FIXED over the first 400
+    const char DYNAMIC_DEFLATE[] =
+        "\x8d\x96\xeb\x8e\xe0\xb8\x0a\x84\x9f\x15\xc5\x24\x46\x72\x40\x32\x58\x91\xff\x9d\xab\xce\xd9\xdd"
+        "\x97\xde\xcf\xfd\x04\x3d\x9a\xe9\xce\xe4\x62\x0a\xa8\x2a\xf8\x47\xa8\xa7\x75\x8b\xf0\x1e\x66\x32"
+        "\x57\xbf\x6b\xc7\x34\xd3\xde\xf8\xa7\x57\x5b\xcd\xac\x0f\x0d\xe9\xab\x4a\x65\x94\xa6\x6c\x1d\xde"
+        "\xed\x5b\xe3\x2e\xc9\xd2\x4f\x9b\x9a\x58\xcb\xde\xa5\x6b\xcf\x69\xae\x15\xbc\x37\x38\x5a\xb3\xad"
+        "\xa1\xd6\xc5\xdd\x45\xaa\xda\x90\xcc\x95\xab\xa2\xa9\x5a\xab\x56\x57\x59\xbe\x97\x2d\x6f\xf2\x85"
+        "\xbe\xa1\xab\x5d\xcd\x23\xee\xfa\xc6\x25\xdb\xfb\x25\x92\x0f\xdf\x8a\x46\xc5\x14\x89\x88\x4f\xe3"
+        "\x09\x9f\x2e\x53\xb3\x67\x5e\x3a\x00\x7c\xa9\xe9\xdb\x79\xd8\xc5\x2a\x97\x7d\x9f\x90\x59\x94\xf1"
+        "\xaa\xc8\x07\xac\x0a\x57\x90\xab\xcf\x7f\x6e\x00\xd6\xa8\xbe\x23\xbd\xd2\x4d\xea\x8a\xfb\x8e\x50"
+        "\x49\x6f\xba\xc9\xd5\x4a\xae\xeb\x54\xa5\xf2\x89\xfa\x6d\x1e\x59\x51\x95\x23\x7d\x9a\x8c\x15\xd4"
+        "\xf0\x4d\xaa\xa7\xe3\x55\x9b\xd1\x55\x5a\xf8\xa3\x1e\x93\x9a\x99\xb6\x11\xb3\x8a\x32\xb5\xa1\x3a"
+        "\x42\x22\xb5\x26\xf0\x45\xbd\x51\xdb\xb9\x57\xd9\x4f\xe6\x15\xa0\x8e\x47\xf8\x42\x94\x5f\x94\x7c"
+        "\x02\xb1\xf9\x4a\x15\xe1\x99\xc4\xd6\x39\x28\xb9\x6e\x5d\xcb\x33\x2a\xa9\x0c\x67\x7b\xf4\xf3\x3f"
+        "\x2b\xcf\xe2\xa4\xf1\x2f\x62\xbc\xbd\x71\xd9\x07\x87\x4a\x9f\xda\x47\x8d\x5c\x32\x1a\xd7\x6d\x91"
+        "\xce\x4d\xf3\x74\xd1\x6b\xd7\x83\x72\x92\x40\xd1\x89\x93\xff\xb4\x10\x1f\xb2\xe0\xc2\x2a\x32\xe3"
+        "\x21\xb5\x9a\x5e\x7d\x76\xad\x35\x2c\x96\xfe\x36\x8f\x66\xc3\xaa\x69\xab\x45\x05\x44\xa1\x90\xf7"
+        "\x1f\x00\x1a\x6e\xbe\xc4\x26\xf0\xaa\xc4\x7a\xdd\x4d\x7b\x3c\x2a\x74\xad\x39\xbf\xfc\xb9\xe6\x82"
+        "\x75\xc0\xa0\x45\x6a\x3b\x56\xd4\x9e\xa0\xf8\x88\xaf\x35\xa2\x56\xbf\xa8\xf4\x58\x1b\x8e\x8f\xee"
+        "\xdd\xff\xdd\x17\x98\x02\xba\x93\x56\x15\x8d\x87\x70\x9d\xce\x71\x90\xdf\x93\x30\xfa\x12\xad\xab"
+        "\xc1\x0b\xef\x94\xb5\x87\x6a\xbe\x7e\xdb\x61\xb3\x7b\x81\xac\xa0\x67\xa5\xd4\xac\xcf\x2a\xae\x7a"
+        "\xf8\xc9\x5d\xde\x8f\x1a\x90\x47\x06\x39\x02\xb3\x83\xcc\xbf\xe2\xea\x3c\xbe\xdb\xa4\x3b\x33\xe4"
+        "\x00\xa6\x4e\xe5\x72\xc3\x51\x97\xfe\xdb\x3c\x60\xc7\xcb\x3b\xed\xd5\x98\xe9\xcb\x1e\xce\x58\x03"
+        "\x3e\x7d\xd5\x35\xbf\x49\x90\x23\x62\x25\x85\x23\x0f\x13\x0a\x8f\xfe\x0a\xb6\xeb\xf7\x9f\x44\x20"
+        "\xe1\xad\x8f\xb1\x3f\x92\xd0\xd1\x67\xd9\xbd\x61\x8b\x0a\xcd\xde\x2d\xe5\x1e\x41\x82\xc8\x06\x3c"
+        "\x85\xa6\x22\x4c\x3a\xfa\xd2\x09\x55\x33\x12\xa5\x71\x9d\x95\xa8\x5b\xdb\xb4\x3b\x69\x6f\xf9\x6c"
+        "\x3f\x5d\x95\xc3\x02\x64\x3f\xb9\xc5\xf7\x28\x23\xa1\x90\x25\xa5\x80\xf0\xc5\xc9\xd2\x32\xeb\xc1"
+        "\x55\xa2\xf5\x3c\x84\xa5\x60\x75\x13\xaa\xe9\x18\xf6\xc0\x02\x40\xd3\x6e\x44\x4e\x75\x97\x8f\x12"
+        "\x11\x3a\x97\x10\x1c\x12\x4a\xe2\x38\xbf\xce\xc3\xa4\xe9\x35\xea\x1a\xff\x35\xc0\xe8\xea\x0d\xd6"
+        "\xa0\x82\xf1\xf8\x21\x10\x25\x33\x18\xda\xa9\x97\x1b\x1a\xa1\xb1\x96\x68\x58\x3f\x1a\x41\x46\xa3"
+        "\x51\xc8\x31\x48\x1f\x32\x52\x89\x99\x68\xa8\x81\xad\xbe\x0a\x10\xb4\x98\x47\x21\x48\x2b\x37\x0a"
+        "\x9b\xed\xae\x35\x97\x79\x47\x10\x3e\xf7\x8b\xd8\x04\x97\xc0\x26\xb8\xc1\x5f\x5c\x31\x6c\xf3\xc9"
+        "\x8d\xe8\xe4\x3b\x42\x04\xc3\xc3\x11\x18\xde\x1b\xf5\xce\xf6\xd6\x87\x86\xa1\x22\x4a\x30\xf8\xd6"
+        "\x9e\x90\xbc\xe4\x10\x15\x4d\x3c\xe8\x35\xf3\x87\xb6\x76\x7a\x1b\x48\x10\xba\x45\x97\xcf\x03\xe7"
+        "\xc5\xd6\xc6\xa2\x08\xee\x78\x60\xdb\x43\xee\xdf\xe6\x91\xc6\x5b\x87\x7d\x47\xe2\x5f\x7c\x41\x9d"
+        "\xf1\x4b\xc3\x3a\x12\x93\xea\x7b\xe9\xec\x13\x32\xe8\x4b\x7f\x63\xf4\xd1\xf4\xce\x63\x9c\x67\x6a"
+        "\x2c\x82\xe5\x85\xa8\x14\x86\x3a\x27\x94\x5d\xe5\xb8\x33\x21\x32\x20\x7c\x3e\xfa\x1c\x26\x4c\x66"
+        "\xca\xc6\x57\x80\x9f\x41\x3c\x98\x0b\x6d\x13\xbd\x78\xc3\xa2\xa3\x1f\x67\x5c\x98\x66\x7f\x75\x47"
+        "\x24\xe4\x8b\xab\x27\xec\x69\xa4\x06\xbe\xb9\xf0\x01\xfb\x50\x03\x34\x07\x7a\x7d\xfd\x70\x01\x0e"
+        "\x75\xbb\xfa\xfe\xe0\xf9\x7b\x4c\x7a\x4f\xfb\x5f\x22\x1c\x46\x14\x7e\x8e\x33\x42\xb8\x23\x2f\x3d"
+        "\xf2\xec\xfc\x19\x94\x88\x47\xeb\x38\xd1\x3b\x28\x65\xab\xdf\xe6\x71\xe4\xbf\x86\x20\xaf\xfe\x53"
+        "\x30\xdf\x74\x18\xb5\x66\x7e\xc3\xee\xe3\xf6\x56\xd0\x8f\xf7\xe8\x49\x60\xa6\xf6\x4c\xc6\x89\xd6"
+        "\xbb\x5f\x3d\x26\x02\x0c\x86\x8d\x8c\x8c\xbb\x41\xfa\xae\x9f\x31\x95\xe2\xb0\xa3\x43\x09\xa2\x99"
+        "\x3e\x66\xce\x28\x44\x65\xe2\x10\x61\xd2\x6b\x6b\xcc\x12\xf4\xd0\x77\x33\xe2\x37\xca\xcf\x5c\xe3"
+        "\xb4\x1f\x97\x8d\xd8\xd5\xa5\x1d\x5e\xfc\x1f\xf1\x46\x3b\x3c\x62\x3c\xc8\x1a\xd3\x74\x31\x0d\xda"
+        "\xca\x03\x5a\x17\x36\xed\x4f\xb7\x71\x2c\xe8\x24\xd3\x1a\x61\x3f\x06\x99\x02\xd7\x10\x19\x48\xbe"
+        "\xa3\x7b\x1a\xed\xf9\x0a\xf7\xf0\x4b\x1d\x30\x0e\x4b\x27\xea\x67\xbf\xcd\x43\xe8\xa8\x31\x25\x72"
+        "\xb6\xd1\x26\x25\x3c\x1d\xb8\x98\x31\x50\x69\xca\x03\xcf\xf1\x06\x24\xe4\x1b\x1f\x3c\x63\x39\xf5"
+        "\xea\xd0\x7f\x31\xa0\x4f\xcf\xbc\x36\xfa\x88\x72\x16\x94\xb9\x79\x83\x0d\x44\xe7\xee\x71\x33\x9c"
+        "\x99\x15\xed\x8c\x33\xa1\x0e\xb7\x8e\xfb\xf2\x3f\x2c\xe9\xd2\x31\x5b\x46\x33\x5e\x75\xba\x18\xc7"
+        "\x4e\xe2\x35\xf8\x83\xa6\x26\x83\x99\x80\xdc\x74\x6a\xe3\x9b\x65\xe5\x8a\x89\x90\xed\x58\x4f\x5f"
+        "\xb9\xb7\x8d\xdd\xd8\x35\x40\x73\x6c\xf3\x24\xf9\xf6\x89\x7d\x11\x91\x6e\x98\xb5\x66\xbe\x19\x3d"
+        "\xf8\xb6\x5c\xa0\xb1\xf4\x31\x07\x9c\x43\xae\x9c\xda\x51\xab\xc2\x2b\x2e\x19\x8d\xc0\xfd\x6d\x1e"
+        "\xe0\x6e\x67\x0b\x00\xfb\xf1\x51\x73\x3e\x60\x6a\x57\x63\xd6\x6a\x63\xec\x9e\xd4\x8e\x9d\xda\x78"
+        "\x08\x02\x15\x42\x2e\x70\x91\x67\xd8\x9f\x50\x76\xb7\x53\x35\xbf\xda\x0d\x24\x87\x3b\x13\xa2\x13"
+        "\x94\x01\x46\x57\x68\xa3\x9e\xae\xf8\xd9\x87\x98\x5f\xc0\xd2\xc9\x05\x22\x26\x07\xb5\x97\x09\xcf"
+        "\x58\x61\x13\x61\xb5\x00\xf0\x42\xfc\x0d\x7b\xd0\x63\x93\xfa\x51\xb6\x65\xc7\xa9\xe0\x1c\x86\x0e"
+        "\x58\x1f\xf0\x73\x51\x93\x01\x79\xe2\x78\x0e\x6f\xe2\xd2\xf8\x1f\xb3\xa2\x70\x91\x05\x54\x06\x01"
+        "\x54\x5e\x2c\x25\x1c\x89\x71\x0f\x76\x1d\xb2\x6a\xf3\x63\x63\x79\xc9\x1f\x68\x2b\xcf\x80\x63\x2e"
+        "\xfe\x3a\x8f\x41\x35\x37\x35\x4f\xed\x7f\xf1\xd9\x3d\x76\x27\x0e\x23\x99\x6d\x22\xd9\x1a\xe9\x8c"
+        "\x1f\x7b\xb0\xa1\xec\x0c\x96\x30\x20\x5f\x65\xef\xa1\xae\xf7\xec\xdf\xaa\xd7\x26\x1b\xde\xd1\x68"
+        "\x9c\x85\xf6\xc2\x22\x81\xd7\x0f\x73\x0e\xe4\x84\xf2\xf8\x00\xcf\x21\x27\x5a\x7b\xf5\x4b\xbc\x8e"
+        "\x55\x33\x3a\xcb\x29\x14\xfa\x39\xea\x2c\x8e\x53\x07\xec\xfd\x3e\xa8\x82\xe0\xe8\x7a\x26\x16\x37"
+        "\xb9\xca\x89\x12\xa0\xcc\x98\xfd\x0c\x55\x99\xd5\xe4\x21\x6f\x1f\xfd\x61\xe2\x01\x08\x65\x9f\x3a"
+        "\xde\xf3\x3a\xcd\xd7\x78\x6f\x5a\xcd\x90\x1a\xd3\xd9\x44\x30\xa7\xf6\x8d\xd3\xaa\x97\xed\xec\xe3"
+        "\x87\x3f\x37\xb3\x5e\x91\x50\xe8\xfd\x37";
+    const char FIXED_DEFLATE[] =
+        "\x6b\xc8\x4f\xcd\x2b\xce\xcc\xc8\xcc\xcf\xcf\xcb\xc8\xcf\xcc\x4c\x2c\x2a\xcd\x48\x2b\xa9\xcc\x2f"
+        "\xca\xcc\x4c\xcd\x48\x01\xe2\xd4\xe4\x94\xd2\x94\xcc\xcc\x8c\x9c\xd4\xfc\xc4\x8c\xd2\x92\x92\xd4"
+        "\xc4\x9c\x92\xd4\xe2\xc4\xca\xd4\x9c\xbc\x8c\xcc\xf2\xd2\x9c\xb4\x92\xc4\xe2\x92\xd4\xf2\xd4\x94"
+        "\xd4\xcc\xc4\xcc\x94\xe2\x8c\x8c\xc4\x8c\xd4\x8c\xe2\xa2\xcc\xbc\xd4\x92\x7c\xa0\xba\x1c\xa0\xd1"
+        "\xa9\xc5\x29\xa5\x39\xa9\x99\x19\x89\x79\x79\x79\x89\x89\x25\x25\x29\x39\x89\xc5\xc5\xa5\xc5\xa5"
+        "\x25\xf9\x29\xa9\xa9\x99\x29\x25\x29\x25\xc9\x25\x99\xc5\xb9\xc9\x99\xa5\x79\x29\x89\xe5\xf9\xa9"
+        "\xb9\xf9\xa9\xa5\x29\xc9\x29\x79\xf9\xf9\x69\x25\xe5\x39\xc9\x89\x95\x79\x19\xc9\x89\x89\xc5\xe9"
+        "\x40\xbd\x89\xa9\xf9\x25\xf9\x45\x89\x89\xf9\xf9\xf9\xe5\xa9\xf9\xe9\xf9\x79\x45\x79\x89\x45\xa9"
+        "\xc5\x19\xc5\xc5\xc9\xa9\x39\x40\x07\x27\xa7\x66\xa6\xe6\x66\x00\x25\x33\x12\x33\x4b\x8a\x4b\x33"
+        "\xcb\xcb\x13\x81\x3e\xcb\x2f\xc9\x04\x2a\x4d\x4c\x2c\x07\x3a\xab\x24\x3f\x2f\x15\xe8\xf2\xd4\xbc"
+        "\xa2\xc6\x4a\xa0\x03\x4b\x72\x4a\x32\x2a\xf3\x8b\xf3\x4a\x8a\xf3\x32\x13\x4b\x92\xf3\xd3\xd2\xf2"
+        "\xf3\x53\x13\x8b\xf3\x52\x52\x2b\x81\x7e\xcd\x2c\x49\x4c\x4e\x06\x85\x4a\x49\x71\x7a\x7e\x09\xb1"
+        "\xfe\x28\x2e\xc9\x2f\x29\x29\xce\x29\xce\x2b\xca\x4c\xcc\x29\xcd\x07\x86\x61\x6e\x31\x30\xf4\x52"
+        "\x73\x72\x53\x33\x8b\xf2\x33\x52\x13\x53\xf2\xf3\xd2\x53\xf3\xf2\x8b\x80\x61\x96\x99\x9a\x92\x93"
+        "\x5f\x54\x52\x02\x0c\xa6\x94\x9c\xd4\xd4\x9c\x7c\x00";
+
+    /// Skewed letters with some rare bytes and repeated runs, reproducible from a small LCG
+    std::string payload(size_t size)
+    {
+        const std::string letters = "eeeeeeeeeetttttttaaaaaaooooooiiiiinnnnnsssshhhhrrrdddlllcuumwfgy";
+        std::string out;
+        uint32_t x = 12345;
+        while (out.size() < size)
+        {
+            const size_t i = out.size();
+            if (i % 300 == 299 && i >= 200)
+            {
+                out += out.substr(i - 200, 40);
+                continue;
+            }
+            if (i % 250 == 0)
+            {
+                out.push_back(static_cast<char>(128 + (i / 250) % 100));
+                continue;
+            }
+            x = (x * 1103515245u + 12345u) & 0x7FFFFFFF;
+            out.push_back(letters[(x >> 16) % 64]);
+        }
+        out.resize(size);
+        return out;
+    }
+
+    uint32_t crc32(const std::string& data)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (unsigned char byte : data)
+        {
+            crc ^= byte;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    /// Deflate stream of stored blocks of at most block bytes
+    std::string storedDeflate(const std::string& data, size_t block)
+    {
+        std::string out;
+        size_t offset = 0;
+        do
+        {
+            const size_t length = std::min(block, data.size() - offset);
+            out.push_back(offset + length == data.size() ? 1 : 0);
+            putLe(out, length, 2);
+            putLe(out, length ^ 0xFFFF, 2);
+            out += data.substr(offset, length);
+            offset += length;
+        } while (offset < data.size());
+        return out;
+    }
+
+    /**
+     * @brief Writes zip archives the way common archivers lay them out
+     */
+    class ZipWriter
+    {
+    public:
+        /**
+         * @param method 0 (stored) or 8 (deflated)
+         * @param data Member data as stored in the archive
+         * @param contents Contents the member extracts to
+         * @param descriptor Put the CRC and sizes in a data descriptor after the data
+         * @param zip64 Give the sizes in a Zip64 extra field
+         */
+        void add(const std::string& name, int method, const std::string& data, const std::string& contents,
+                 bool descriptor = false, bool zip64 = false)
+        {
+            const size_t offset = m_archive.size();
+            const uint32_t crc = crc32(contents);
+            putLe(m_archive, 0x04034b50, 4);
+            putLe(m_archive, zip64 ? 45 : 20, 2);
+            putLe(m_archive, descriptor ? 8 : 0, 2);
+            putLe(m_archive, method, 2);
+            putLe(m_archive, 0, 4);
+            putLe(m_archive, descriptor ? 0 : crc, 4);
+            putLe(m_archive, descriptor ? 0 : zip64 ? 0xFFFFFFFF : data.size(), 4);
+            putLe(m_archive, descriptor ? 0 : zip64 ? 0xFFFFFFFF : contents.size(), 4);
+            putLe(m_archive, name.size(), 2);
+            putLe(m_archive, zip64 ? 20 : 0, 2);
+            m_archive += name;
+            if (zip64)
+            {
+                putLe(m_archive, 1, 2);
+                putLe(m_archive, 16, 2);
+                putLe(m_archive, descriptor ? 0 : contents.size(), 8);
+                putLe(m_archive, descriptor ? 0 : data.size(), 8);
+            }
+            m_archive += data;
+            if (descriptor)
+            {
+                putLe(m_archive, 0x08074b50, 4);
+                putLe(m_archive, crc, 4);
+                putLe(m_archive, data.size(), zip64 ? 8 : 4);
+                putLe(m_archive, contents.size(), zip64 ? 8 : 4);
+            }
+
+            putLe(m_directory, 0x02014b50, 4);
+            putLe(m_directory, 20, 2);
+            putLe(m_directory, 20, 2);
+            putLe(m_directory, descriptor ? 8 : 0, 2);
+            putLe(m_directory, method, 2);
+            putLe(m_directory, 0, 4);
+            putLe(m_directory, crc, 4);
+            putLe(m_directory, data.size(), 4);
+            putLe(m_directory, contents.size(), 4);
+            putLe(m_directory, name.size(), 2);
+            putLe(m_directory, 0, 8);
+            putLe(m_directory, 0, 4);
+            putLe(m_directory, offset, 4);
+            m_directory += name;
+            ++m_count;
+        }
+
+        std::string finish() const
+        {
+            std::string archive = m_archive + m_directory;
+            putLe(archive, 0x06054b50, 4);
+            putLe(archive, 0, 4);
+            putLe(archive, m_count, 2);
+            putLe(archive, m_count, 2);
+            putLe(archive, m_directory.size(), 4);
+            putLe(archive, m_archive.size(), 4);
+            putLe(archive, 0, 2);
+            return archive;
+        }
+
+    private:
+        std::string m_archive;
+        std::string m_directory;
+        size_t m_count = 0;
+    };
+
+    /// Feeds an archive to an extractor in pieces of chunk bytes
+    bool extract(const std::string& archive, const std::filesystem::path& dir, size_t chunk,
+                 const FreesoundDownloader::UnzipOptions& options = {})
+    {
+        FreesoundDownloader::ZipStreamExtractor extractor(dir.string(), options);
+        bool ok = true;
+        for (size_t offset = 0; offset < archive.size() && ok; offset += chunk)
+        {
+            const size_t size = std::min(chunk, archive.size() - offset);
+            ok = extractor.push(archive.data() + offset, size);
+        }
+        return extractor.finish() && ok;
+    }
+
+    /// Archive with one member of every supported kind
+    std::string sampleArchive(std::vector<std::pair<std::string, std::string>>& expected)
+    {
+        const std::string text = payload(3000);
+        const std::string dynamic(DYNAMIC_DEFLATE, sizeof(DYNAMIC_DEFLATE) - 1);
+        const std::string fixed(FIXED_DEFLATE, sizeof(FIXED_DEFLATE) - 1);
+        std::string large;
+        for (int i = 0; i < 70000; ++i)
+        {
+            large.push_back(static_cast<char>((i * 7919) >> 5));
+        }
+
+        ZipWriter writer;
+        writer.add("pack/", 0, "", "");
+        writer.add("pack/1__user__stored.wav", 0, large, large);
+        writer.add("pack/2__user__dynamic.txt", 8, dynamic, text);
+        writer.add("pack/3__user__fixed.txt", 8, fixed, text.substr(0, 400), true);
+        writer.add("pack/4__user__blocks.wav", 8, storedDeflate(large, 65535), large, false, true);
+        writer.add("pack/5__user__zip64.txt", 8, dynamic, text, true, true);
+        writer.add("pack/6__user__stream.wav", 0, large, large, true);
+        writer.add("_readme_and_license.txt", 0, "CC0", "CC0");
+        writer.add("empty.txt", 8, storedDeflate("", 1), "");
+        expected = {{"pack/1__user__stored.wav", large},  {"pack/2__user__dynamic.txt", text},
+                    {"pack/3__user__fixed.txt", text.substr(0, 400)}, {"pack/4__user__blocks.wav", large},
+                    {"pack/5__user__zip64.txt", text}, {"pack/6__user__stream.wav", large},
+                    {"_readme_and_license.txt", "CC0"}, {"empty.txt", ""}};
+        return writer.finish();
+    }
+}
+
+TEST_CASE("Zip Stream Extracts Members As They Arrive") {
+    using namespace FreesoundDownloader;
+
+    std::vector<std::pair<std::string, std::string>> expected;
+    const std::string archive = sampleArchive(expected);
+
+    UnzipOptions options;
+    options.sync_policy = SyncPolicy::None;
+    options.max_pending_bytes = 0;
+    CHECK_THROWS_AS(ZipStreamExtractor("unused", options), std::invalid_argument);
+
+    // Byte by byte exercises every header and descriptor split; a small bound exercises the backpressure
+    for (size_t chunk : {size_t(1), size_t(7), size_t(4096), archive.size()})
+    {
+        for (unsigned threads : {1u, 4u})
+        {
+            const auto dir = freshDir("zip_members");
+            options.threads = threads;
+            options.max_pending_bytes = chunk == 7 ? 1 : 64 * 1024 * 1024;
+            FreesoundDownloader::ZipStreamExtractor extractor(dir.string(), options);
+            bool ok = true;
+            for (size_t offset = 0; offset < archive.size() && ok; offset += chunk)
+            {
+                ok = extractor.push(archive.data() + offset, std::min(chunk, archive.size() - offset));
+            }
+            CHECK(ok);
+            REQUIRE(extractor.finish());
+            REQUIRE(extractor.members().size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                const auto& member = extractor.members()[i];
+                CHECK(member.name == expected[i].first);
+                CHECK(member.size == expected[i].second.size());
+                CHECK(std::filesystem::path(member.path) == dir / expected[i].first);
+                CHECK(readFile(dir / expected[i].first) == expected[i].second);
+            }
+            CHECK(std::distance(std::filesystem::directory_iterator(dir / "pack"),
+                                std::filesystem::directory_iterator()) == 6);
+            std::filesystem::remove_all(dir);
+        }
+    }
+}
+
+TEST_CASE("Zip Stream Rejects Damaged And Unsafe Archives") {
+    using namespace FreesoundDownloader;
+
+    const std::string text = payload(3000);
+    const std::string dynamic(DYNAMIC_DEFLATE, sizeof(DYNAMIC_DEFLATE) - 1);
+    const auto dir = freshDir("zip_damaged");
+
+    // A wrong CRC, in a stored and in a deflated member, keeps the file out of place
+    for (int method : {0, 8})
+    {
+        ZipWriter writer;
+        writer.add("good.txt", 0, "fine", "fine");
+        writer.add("bad.txt", method, method == 0 ? text : dynamic, text);
+        std::string archive = writer.finish();
+        archive[archive.find("bad.txt") + 7 + 1000] ^= 0x10;
+        CHECK_FALSE(extract(archive, dir, 100));
+        CHECK(readFile(dir / "good.txt") == "fine");
+        CHECK_FALSE(std::filesystem::exists(dir / "bad.txt"));
+    }
+
+    // Truncated archives, and ones that stop before the central directory
+    std::vector<std::pair<std::string, std::string>> expected;
+    const std::string archive = sampleArchive(expected);
+    for (size_t cut : {size_t(0), size_t(20), size_t(70100), archive.size() / 2})
+    {
+        CHECK_FALSE(extract(archive.substr(0, cut), dir / "cut", 333));
+    }
+    CHECK_FALSE(extract(archive.substr(0, archive.find(std::string("PK\x01\x02", 4))), dir / "cut", 4096));
+
+    // Not a zip, an unknown method, names escaping the output directory
+    CHECK_FALSE(extract("MZ\x90\x00 this is not an archive", dir, 5));
+    ZipWriter first;
+    first.add("first.txt", 0, "ok", "ok");
+    const std::string prefix = first.finish();
+    CHECK_FALSE(extract(prefix.substr(0, prefix.find(std::string("PK\x01\x02", 4))) + "garbage", dir, 3));
+    for (const std::string name : {"../escape.txt", "/etc/escape.txt", "pack/../../escape.txt", "C:/escape.txt"})
+    {
+        ZipWriter writer;
+        writer.add(name, 0, "x", "x");
+        CHECK_FALSE(extract(writer.finish(), dir / "inner", 64));
+    }
+    CHECK_FALSE(std::filesystem::exists(dir / "escape.txt"));
+    ZipWriter writer;
+    writer.add("bzip2.txt", 12, "BZh9", "?");
+    CHECK_FALSE(extract(writer.finish(), dir, 64));
+
+    // A declared size far beyond what the data inflates to is refused without reserving it
+    ZipWriter oversized;
+    oversized.add("huge.txt", 8, dynamic, text, false, true);
+    std::string huge = oversized.finish();
+    const size_t size_field = huge.find("huge.txt") + 8 + 4;
+    huge.replace(size_field, 8, std::string("\0\0\0\0\0\x01\0\0", 8));
+    CHECK_FALSE(extract(huge, dir, 4096));
+    CHECK_FALSE(std::filesystem::exists(dir / "huge.txt"));
+
+    // Damaged deflate data must be refused without crashing
+    for (size_t i = 0; i < dynamic.size(); i += 3)
+    {
+        ZipWriter damaged;
+        std::string data = dynamic;
+        data[i] = static_cast<char>(data[i] ^ (1 << (i % 8)));
+        damaged.add("fuzz.txt", 8, data, text);
+        CHECK_FALSE(extract(damaged.finish(), dir / "fuzz", 512));
+    }
+    std::filesystem::remove_all(dir);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Download Pack Unpacks While Downloading") {
+    using namespace FreesoundDownloader;
+
+    std::vector<std::pair<std::string, std::string>> expected;
+    const std::string archive = sampleArchive(expected);
+
+    // Throttled so that members are extracted before the transfer ends
+    Testing::LocalHttpServer server(8 * 1024, std::chrono::milliseconds(1));
+    server.serve("/apiv2/packs/77/download/", archive);
+    server.serve("/apiv2/packs/78/download/", archive.substr(0, archive.size() / 3));
+
+    Downloader downloader("test_api_key");
+    downloader.setBaseUrl(server.url("/apiv2/"));
+    const auto dir = freshDir("zip_pack");
+    UnzipOptions options;
+    options.sync_policy = SyncPolicy::None;
+
+    const auto members = downloader.downloadPack(77, dir.string(), options);
+    REQUIRE(members.has_value());
+    REQUIRE(members->size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        CHECK((*members)[i].name == expected[i].first);
+        CHECK(readFile(dir / expected[i].first) == expected[i].second);
+    }
+
+    // A cut transfer and a missing pack fail
+    CHECK_FALSE(downloader.downloadPack(78, (dir / "cut").string(), options).has_value());
+    CHECK_FALSE(downloader.downloadPack(79, (dir / "missing").string(), options).has_value());
+    std::filesystem::remove_all(dir);
+}
+
+#endif